@@ -0,0 +1,494 @@
+#include "android_host.h"
+#include "../jni/time_utils.h"
+
+#include <android/configuration.h>
+#include <android/log.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct LooperFd {
+	int fd;
+	int ident;
+	int events;
+	void* data;
+};
+
+struct ALooper {
+	pthread_mutex_t mutex;
+	int wakeRead;
+	int wakeWrite;
+	LooperFd fds[HOST_LOOPER_MAX_FDS];
+	int32_t fdCount;
+	int64_t lastReturnNanoseconds;
+};
+
+struct AInputQueue {
+	pthread_mutex_t mutex;
+	AInputEvent events[HOST_INPUT_QUEUE_CAPACITY];
+	uint32_t head;
+	uint32_t tail;
+	int readFd;
+	int writeFd;
+	ALooper* looper;
+};
+
+struct AConfiguration {
+	int32_t orientation;
+};
+
+static ANativeActivityCallbacks activityCallbacks;
+static volatile bool activityFinishing;
+static HostCallbacks hostCallbacks;
+static int logPriority = ANDROID_LOG_WARN;
+static __thread ALooper* threadLooper;
+
+void initHostActivity(ANativeActivity* activity, const char* internalDataPath) {
+	memset(activity, 0, sizeof(ANativeActivity));
+	memset(&activityCallbacks, 0, sizeof(activityCallbacks));
+	activity->callbacks = &activityCallbacks;
+	activity->internalDataPath = internalDataPath;
+	activity->sdkVersion = 29;
+	activityFinishing = false;
+	// Mesa picks the platform when the display is first opened
+	setenv("EGL_PLATFORM", "surfaceless", 0);
+}
+
+bool hostActivityFinishing() {
+	return activityFinishing;
+}
+
+void setHostCallbacks(const HostCallbacks* callbacks) {
+	if (callbacks) {
+		hostCallbacks = *callbacks;
+	} else {
+		memset(&hostCallbacks, 0, sizeof(hostCallbacks));
+	}
+}
+
+void setHostLogPriority(int priority) {
+	logPriority = priority;
+}
+
+extern "C" int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+	if (prio < logPriority) {
+		return 0;
+	}
+	static const char levels[] = "??VDIWEFS";
+	char message[1024];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(message, sizeof(message), fmt, args);
+	va_end(args);
+	return fprintf(stderr, "%c/%s: %s\n", levels[prio >= 0 && prio <= ANDROID_LOG_SILENT ? prio : 0], tag, message);
+}
+
+extern "C" void ANativeActivity_finish(ANativeActivity*) {
+	__android_log_print(ANDROID_LOG_WARN, "host", "Activity finishing");
+	activityFinishing = true;
+}
+
+// --------------------------------------------------------------------
+// Looper
+// --------------------------------------------------------------------
+
+static bool createPipe(int* readFd, int* writeFd) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		__android_log_print(ANDROID_LOG_ERROR, "host", "Could not create a pipe: %s", strerror(errno));
+		return false;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	*readFd = fds[0];
+	*writeFd = fds[1];
+	return true;
+}
+
+extern "C" ALooper* ALooper_forThread(void) {
+	return threadLooper;
+}
+
+extern "C" ALooper* ALooper_prepare(int) {
+	if (threadLooper) {
+		return threadLooper;
+	}
+	ALooper* looper = static_cast<ALooper*>(calloc(1, sizeof(ALooper)));
+	pthread_mutex_init(&looper->mutex, NULL);
+	if (!createPipe(&looper->wakeRead, &looper->wakeWrite)) {
+		free(looper);
+		return NULL;
+	}
+	threadLooper = looper;
+	return looper;
+}
+
+// the app's looper lives as long as its thread and the process is short lived, so nothing is counted
+extern "C" void ALooper_acquire(ALooper*) {
+}
+
+extern "C" void ALooper_release(ALooper*) {
+}
+
+extern "C" void ALooper_wake(ALooper* looper) {
+	char c = 0;
+	if (write(looper->wakeWrite, &c, 1) != 1) {
+		__android_log_print(ANDROID_LOG_ERROR, "host", "Could not wake the looper");
+	}
+}
+
+extern "C" int ALooper_addFd(ALooper* looper, int fd, int ident, int events, ALooper_callbackFunc callback, void* data) {
+	if (callback) {
+		__android_log_print(ANDROID_LOG_ERROR, "host", "Looper callbacks are not supported");
+		return -1;
+	}
+	pthread_mutex_lock(&looper->mutex);
+	int32_t index = 0;
+	while (index < looper->fdCount && looper->fds[index].fd != fd) {
+		++index;
+	}
+	if (index == HOST_LOOPER_MAX_FDS) {
+		pthread_mutex_unlock(&looper->mutex);
+		return -1;
+	}
+	LooperFd entry = { fd, ident, events, data };
+	looper->fds[index] = entry;
+	if (index == looper->fdCount) {
+		looper->fdCount++;
+	}
+	pthread_mutex_unlock(&looper->mutex);
+	return 1;
+}
+
+extern "C" int ALooper_removeFd(ALooper* looper, int fd) {
+	pthread_mutex_lock(&looper->mutex);
+	for (int32_t i = 0; i < looper->fdCount; ++i) {
+		if (looper->fds[i].fd == fd) {
+			looper->fds[i] = looper->fds[--looper->fdCount];
+			pthread_mutex_unlock(&looper->mutex);
+			return 1;
+		}
+	}
+	pthread_mutex_unlock(&looper->mutex);
+	return 0;
+}
+
+// Without callbacks pollOnce and pollAll are the same: the first ready fd's ident is returned.
+extern "C" int ALooper_pollOnce(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
+	ALooper* looper = threadLooper;
+	if (!looper) {
+		return ALOOPER_POLL_ERROR;
+	}
+	int64_t now = nowNanoseconds();
+	if (hostCallbacks.polled && looper->lastReturnNanoseconds) {
+		hostCallbacks.polled(hostCallbacks.data, now - looper->lastReturnNanoseconds);
+	}
+
+	struct pollfd fds[HOST_LOOPER_MAX_FDS + 1];
+	LooperFd entries[HOST_LOOPER_MAX_FDS];
+	pthread_mutex_lock(&looper->mutex);
+	int32_t count = looper->fdCount;
+	memcpy(entries, looper->fds, count * sizeof(LooperFd));
+	pthread_mutex_unlock(&looper->mutex);
+	fds[0].fd = looper->wakeRead;
+	fds[0].events = POLLIN;
+	for (int32_t i = 0; i < count; ++i) {
+		fds[i + 1].fd = entries[i].fd;
+		fds[i + 1].events = POLLIN;
+	}
+
+	int result = ALOOPER_POLL_TIMEOUT;
+	int ready = poll(fds, count + 1, timeoutMillis);
+	if (ready < 0 && errno != EINTR) {
+		result = ALOOPER_POLL_ERROR;
+	} else if (ready > 0) {
+		if (fds[0].revents) {
+			char buffer[16];
+			while (read(looper->wakeRead, buffer, sizeof(buffer)) > 0) {
+			}
+			result = ALOOPER_POLL_WAKE;
+		} else {
+			for (int32_t i = 0; i < count; ++i) {
+				if (fds[i + 1].revents) {
+					if (outFd) {
+						*outFd = entries[i].fd;
+					}
+					if (outEvents) {
+						*outEvents = (fds[i + 1].revents & POLLIN ? ALOOPER_EVENT_INPUT : 0) |
+							(fds[i + 1].revents & POLLHUP ? ALOOPER_EVENT_HANGUP : 0) | (fds[i + 1].revents & POLLERR ? ALOOPER_EVENT_ERROR : 0);
+					}
+					if (outData) {
+						*outData = entries[i].data;
+					}
+					result = entries[i].ident;
+					break;
+				}
+			}
+		}
+	}
+	looper->lastReturnNanoseconds = nowNanoseconds();
+	return result;
+}
+
+extern "C" int ALooper_pollAll(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
+	return ALooper_pollOnce(timeoutMillis, outFd, outEvents, outData);
+}
+
+// --------------------------------------------------------------------
+// Input
+// --------------------------------------------------------------------
+
+AInputQueue* createHostInputQueue() {
+	AInputQueue* queue = static_cast<AInputQueue*>(calloc(1, sizeof(AInputQueue)));
+	pthread_mutex_init(&queue->mutex, NULL);
+	if (!createPipe(&queue->readFd, &queue->writeFd)) {
+		free(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+void destroyHostInputQueue(AInputQueue* queue) {
+	close(queue->readFd);
+	close(queue->writeFd);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue);
+}
+
+bool postHostInputEvent(AInputQueue* queue, const AInputEvent* event) {
+	pthread_mutex_lock(&queue->mutex);
+	// one slot stays free for the event being dispatched
+	if (queue->tail - queue->head >= HOST_INPUT_QUEUE_CAPACITY - 1) {
+		pthread_mutex_unlock(&queue->mutex);
+		return false;
+	}
+	queue->events[queue->tail % HOST_INPUT_QUEUE_CAPACITY] = *event;
+	queue->tail++;
+	char c = 0;
+	bool written = write(queue->writeFd, &c, 1) == 1;
+	pthread_mutex_unlock(&queue->mutex);
+	return written;
+}
+
+extern "C" void AInputQueue_attachLooper(AInputQueue* queue, ALooper* looper, int ident, ALooper_callbackFunc callback, void* data) {
+	queue->looper = looper;
+	ALooper_addFd(looper, queue->readFd, ident, ALOOPER_EVENT_INPUT, callback, data);
+}
+
+extern "C" void AInputQueue_detachLooper(AInputQueue* queue) {
+	if (queue->looper) {
+		ALooper_removeFd(queue->looper, queue->readFd);
+		queue->looper = NULL;
+	}
+}
+
+extern "C" int32_t AInputQueue_hasEvents(AInputQueue* queue) {
+	pthread_mutex_lock(&queue->mutex);
+	bool hasEvents = queue->head != queue->tail;
+	pthread_mutex_unlock(&queue->mutex);
+	return hasEvents ? 1 : 0;
+}
+
+extern "C" int32_t AInputQueue_getEvent(AInputQueue* queue, AInputEvent** outEvent) {
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->head == queue->tail) {
+		pthread_mutex_unlock(&queue->mutex);
+		return -1;
+	}
+	char c;
+	if (read(queue->readFd, &c, 1) != 1) {
+		__android_log_print(ANDROID_LOG_ERROR, "host", "Input queue out of step with its pipe");
+	}
+	*outEvent = &queue->events[queue->head % HOST_INPUT_QUEUE_CAPACITY];
+	queue->head++;
+	pthread_mutex_unlock(&queue->mutex);
+	return 0;
+}
+
+extern "C" int32_t AInputQueue_preDispatchEvent(AInputQueue*, AInputEvent*) {
+	return 0;
+}
+
+extern "C" void AInputQueue_finishEvent(AInputQueue*, AInputEvent*, int) {
+}
+
+extern "C" int32_t AInputEvent_getType(const AInputEvent* event) {
+	return event->type;
+}
+
+extern "C" int32_t AKeyEvent_getAction(const AInputEvent* event) {
+	return event->action;
+}
+
+extern "C" int32_t AKeyEvent_getKeyCode(const AInputEvent* event) {
+	return event->keyCode;
+}
+
+extern "C" int64_t AKeyEvent_getEventTime(const AInputEvent* event) {
+	return event->eventTime;
+}
+
+extern "C" int32_t AMotionEvent_getAction(const AInputEvent* event) {
+	return event->action;
+}
+
+extern "C" int64_t AMotionEvent_getEventTime(const AInputEvent* event) {
+	return event->eventTime;
+}
+
+extern "C" size_t AMotionEvent_getPointerCount(const AInputEvent* event) {
+	return event->pointerCount;
+}
+
+extern "C" int32_t AMotionEvent_getPointerId(const AInputEvent* event, size_t pointerIndex) {
+	return event->pointerIds[pointerIndex];
+}
+
+extern "C" float AMotionEvent_getX(const AInputEvent* event, size_t pointerIndex) {
+	return event->x[pointerIndex];
+}
+
+extern "C" float AMotionEvent_getY(const AInputEvent* event, size_t pointerIndex) {
+	return event->y[pointerIndex];
+}
+
+extern "C" size_t AMotionEvent_getHistorySize(const AInputEvent* event) {
+	return event->historySize;
+}
+
+extern "C" int64_t AMotionEvent_getHistoricalEventTime(const AInputEvent* event, size_t historyIndex) {
+	return event->historyTime[historyIndex];
+}
+
+extern "C" float AMotionEvent_getHistoricalX(const AInputEvent* event, size_t pointerIndex, size_t historyIndex) {
+	return event->historyX[historyIndex][pointerIndex];
+}
+
+extern "C" float AMotionEvent_getHistoricalY(const AInputEvent* event, size_t pointerIndex, size_t historyIndex) {
+	return event->historyY[historyIndex][pointerIndex];
+}
+
+// --------------------------------------------------------------------
+// Windows, configuration and assets
+// --------------------------------------------------------------------
+
+ANativeWindow* createHostWindow(int32_t width, int32_t height) {
+	ANativeWindow* window = static_cast<ANativeWindow*>(calloc(1, sizeof(ANativeWindow)));
+	window->width = width;
+	window->height = height;
+	return window;
+}
+
+void resizeHostWindow(ANativeWindow* window, int32_t width, int32_t height) {
+	__atomic_store_n(&window->width, width, __ATOMIC_RELAXED);
+	__atomic_store_n(&window->height, height, __ATOMIC_RELAXED);
+}
+
+void destroyHostWindow(ANativeWindow* window) {
+	free(window);
+}
+
+extern "C" int32_t ANativeWindow_getWidth(ANativeWindow* window) {
+	return __atomic_load_n(&window->width, __ATOMIC_RELAXED);
+}
+
+extern "C" int32_t ANativeWindow_getHeight(ANativeWindow* window) {
+	return __atomic_load_n(&window->height, __ATOMIC_RELAXED);
+}
+
+extern "C" int32_t ANativeWindow_getFormat(ANativeWindow* window) {
+	return window->format;
+}
+
+extern "C" int32_t ANativeWindow_setBuffersGeometry(ANativeWindow* window, int32_t, int32_t, int32_t format) {
+	window->format = format;
+	return 0;
+}
+
+extern "C" AConfiguration* AConfiguration_new(void) {
+	return static_cast<AConfiguration*>(calloc(1, sizeof(AConfiguration)));
+}
+
+extern "C" void AConfiguration_delete(AConfiguration* config) {
+	free(config);
+}
+
+extern "C" void AConfiguration_fromAssetManager(AConfiguration* out, AAssetManager*) {
+	out->orientation = ACONFIGURATION_ORIENTATION_PORT;
+}
+
+extern "C" int32_t AConfiguration_getMcc(AConfiguration*) { return 0; }
+extern "C" int32_t AConfiguration_getMnc(AConfiguration*) { return 0; }
+extern "C" void AConfiguration_getLanguage(AConfiguration*, char* outLanguage) { memcpy(outLanguage, "en", 2); }
+extern "C" void AConfiguration_getCountry(AConfiguration*, char* outCountry) { memcpy(outCountry, "US", 2); }
+extern "C" int32_t AConfiguration_getOrientation(AConfiguration* config) { return config->orientation; }
+extern "C" int32_t AConfiguration_getTouchscreen(AConfiguration*) { return 3; }
+extern "C" int32_t AConfiguration_getDensity(AConfiguration*) { return 320; }
+extern "C" int32_t AConfiguration_getKeyboard(AConfiguration*) { return 1; }
+extern "C" int32_t AConfiguration_getNavigation(AConfiguration*) { return 1; }
+extern "C" int32_t AConfiguration_getKeysHidden(AConfiguration*) { return 0; }
+extern "C" int32_t AConfiguration_getNavHidden(AConfiguration*) { return 0; }
+extern "C" int32_t AConfiguration_getSdkVersion(AConfiguration*) { return 29; }
+extern "C" int32_t AConfiguration_getScreenSize(AConfiguration*) { return 2; }
+extern "C" int32_t AConfiguration_getScreenLong(AConfiguration*) { return 2; }
+extern "C" int32_t AConfiguration_getUiModeType(AConfiguration*) { return 1; }
+extern "C" int32_t AConfiguration_getUiModeNight(AConfiguration*) { return 1; }
+
+extern "C" AAsset* AAssetManager_open(AAssetManager*, const char*, int) {
+	return NULL;
+}
+
+extern "C" const void* AAsset_getBuffer(AAsset*) {
+	return NULL;
+}
+
+extern "C" off_t AAsset_getLength(AAsset*) {
+	return 0;
+}
+
+extern "C" void AAsset_close(AAsset*) {
+}
+
+// --------------------------------------------------------------------
+// EGL windows
+// --------------------------------------------------------------------
+
+EGLSurface eglCreateWindowSurface(EGLDisplay display, EGLConfig config, EGLNativeWindowType window, const EGLint*) {
+	const EGLint pbufferAttribs[] = {
+		EGL_WIDTH, ANativeWindow_getWidth(window),
+		EGL_HEIGHT, ANativeWindow_getHeight(window),
+		EGL_NONE
+	};
+	return eglCreatePbufferSurface(display, config, pbufferAttribs);
+}
+
+EGLBoolean eglGetConfigAttrib(EGLDisplay display, EGLConfig config, EGLint attribute, EGLint* value) {
+	typedef EGLBoolean (*GetConfigAttrib)(EGLDisplay, EGLConfig, EGLint, EGLint*);
+	static GetConfigAttrib library = reinterpret_cast<GetConfigAttrib>(dlsym(RTLD_NEXT, "eglGetConfigAttrib"));
+	EGLBoolean result = library(display, config, attribute, value);
+	if (result && attribute == EGL_SURFACE_TYPE && (*value & EGL_PBUFFER_BIT)) {
+		*value |= EGL_WINDOW_BIT;
+	}
+	return result;
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+	typedef EGLBoolean (*SwapBuffers)(EGLDisplay, EGLSurface);
+	static SwapBuffers library = reinterpret_cast<SwapBuffers>(dlsym(RTLD_NEXT, "eglSwapBuffers"));
+	// swapping a pbuffer waits for nothing, so the frame is finished here to count its GPU time
+	glFinish();
+	EGLBoolean result = library(display, surface);
+	if (hostCallbacks.presented) {
+		hostCallbacks.presented(hostCallbacks.data, nowNanoseconds());
+	}
+	return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Stand-ins for the NDK that jni/android_native_app_glue.c and jni/main.cpp use, so the app runs
+// unchanged on the host: a poll() based ALooper, an AInputQueue the caller posts events to,
+// windows of a given size, a fixed AConfiguration and a log that can be quietened. Headers are in
+// host/ndk; build everything with -D__ANDROID__ -Ihost/ndk so the app takes its Android paths.
+//
+// EGL window surfaces become pbuffers of the window's size, created when the app asks for one and
+// staying that size, and every config with EGL_PBUFFER_BIT is reported as window capable too. That
+// is done by defining eglCreateWindowSurface, eglGetConfigAttrib and eglSwapBuffers here, over the
+// library's; on Mesa the surfaceless platform is used unless EGL_PLATFORM says otherwise.
+
+#include <android/input.h>
+#include <android/native_activity.h>
+
+#include <stdint.h>
+
+#define HOST_MAX_POINTERS 10
+#define HOST_MAX_HISTORY 16
+#define HOST_INPUT_QUEUE_CAPACITY 256
+#define HOST_LOOPER_MAX_FDS 8
+
+struct AInputEvent {
+	int32_t type;
+	int32_t action;
+	int32_t keyCode;
+	int64_t eventTime;
+	int32_t pointerCount;
+	int32_t pointerIds[HOST_MAX_POINTERS];
+	float x[HOST_MAX_POINTERS];
+	float y[HOST_MAX_POINTERS];
+	int32_t historySize;
+	int64_t historyTime[HOST_MAX_HISTORY];
+	float historyX[HOST_MAX_HISTORY][HOST_MAX_POINTERS];
+	float historyY[HOST_MAX_HISTORY][HOST_MAX_POINTERS];
+};
+
+struct ANativeWindow {
+	int32_t width;
+	int32_t height;
+	int32_t format;
+};
+
+// Called on the app's thread.
+struct HostCallbacks {
+	void* data;
+	// after each eglSwapBuffers has finished rendering
+	void (*presented)(void* data, int64_t nanoseconds);
+	// on entering a looper poll, with the time since the previous poll on that thread returned
+	void (*polled)(void* data, int64_t sinceLastPollNanoseconds);
+};
+
+// The callbacks member points at storage owned by the host; the glue fills it in from ANativeActivity_onCreate.
+void initHostActivity(ANativeActivity* activity, const char* internalDataPath);
+bool hostActivityFinishing();
+void setHostCallbacks(const HostCallbacks* callbacks);
+// Messages below priority are dropped; ANDROID_LOG_WARN by default.
+void setHostLogPriority(int priority);
+
+ANativeWindow* createHostWindow(int32_t width, int32_t height);
+// The app sees the new size through ANativeWindow_getWidth/Height; its surface keeps the old one.
+void resizeHostWindow(ANativeWindow* window, int32_t width, int32_t height);
+void destroyHostWindow(ANativeWindow* window);
+
+AInputQueue* createHostInputQueue();
+void destroyHostInputQueue(AInputQueue* queue);
+// Copies the event, waking the looper the queue is attached to. False if the queue is full.
+bool postHostInputEvent(AInputQueue* queue, const AInputEvent* event);
@@ -0,0 +1,330 @@
+// Bakes a synthetic set of sprites with tools/atlas_packer.cpp, with both packers, and reports the
+// packing efficiency and bake time. The MaxRects atlas is then mapped with jni/texture_atlas.cpp:
+// every image is looked up by name and its pixels and repeated edges checked against the source,
+// lookups are timed, and texture binds per frame are counted for sprite frames drawn from the atlas
+// against the same frames drawn from one texture per image.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -D__ANDROID__ -Ihost/ndk -o atlas_bench host/atlas_bench.cpp tools/atlas_packer.cpp
+//                   jni/texture_atlas.cpp host/android_host.cpp memory_tracker.o -lEGL -lGLESv2 -lpthread -ldl
+// Usage:        atlas_bench [images] [page size]
+//
+// Sizes follow a game's UI and sprites: 60% icons of 8 to 32 pixels, 30% frames of 16 to 64 and 10%
+// larger images of 32 to 128. A frame has 6 layers of 250 sprites; each layer draws from its own
+// working set of 150 images, and a third of the sprites repeat the one before, like rows of tiles.
+
+#include "android_host.h"
+#include "../jni/texture_atlas.h"
+#include "../jni/time_utils.h"
+#include "../tools/atlas_packer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+const int32_t frameCount = 120;
+const int32_t layersPerFrame = 6;
+const int32_t spritesPerLayer = 250;
+const int32_t workingSetPerLayer = 150;
+const int32_t lookupRounds = 20;
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(uint32_t range) {
+	seed = seed * 1664525u + 1013904223u;
+	return static_cast<uint32_t>((static_cast<uint64_t>(seed >> 8) * range) >> 24);
+}
+
+static void imagePixel(uint32_t index, uint32_t x, uint32_t y, uint8_t* pixel) {
+	pixel[0] = static_cast<uint8_t>(index);
+	pixel[1] = static_cast<uint8_t>(index >> 8);
+	pixel[2] = static_cast<uint8_t>(x * 7 + y * 13);
+	pixel[3] = static_cast<uint8_t>(255 - x - y);
+}
+
+static void makeImages(std::vector<AtlasImage>* images, uint32_t count) {
+	images->resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		AtlasImage* image = &(*images)[i];
+		char name[32];
+		snprintf(name, sizeof(name), "sprite%05u", i);
+		image->name = name;
+		uint32_t kind = nextRandom(10);
+		uint32_t low = kind < 6 ? 8 : kind < 9 ? 16 : 32;
+		uint32_t high = low * 4;
+		image->width = low + nextRandom(high - low + 1);
+		// mostly square, some strips
+		image->height = nextRandom(4) == 0 ? low + nextRandom(high - low + 1) : image->width;
+		image->pixels.resize(image->width * image->height * 4);
+		for (uint32_t y = 0; y < image->height; ++y) {
+			for (uint32_t x = 0; x < image->width; ++x) {
+				imagePixel(i, x, y, &image->pixels[(y * image->width + x) * 4]);
+			}
+		}
+	}
+}
+
+static bool bake(const std::vector<AtlasImage>& images, const AtlasPackOptions& options, const char* path) {
+	int64_t start = nowNanoseconds();
+	AtlasLayout layout;
+	if (!packAtlas(images, options, &layout)) {
+		printf("FAIL: could not pack %zu images\n", images.size());
+		return false;
+	}
+	int64_t packed = nowNanoseconds();
+	std::vector<std::vector<uint8_t> > pages;
+	composeAtlasPages(images, options, layout, &pages);
+	int64_t composed = nowNanoseconds();
+	size_t indexSize = 0;
+	size_t fileSize = 0;
+	if (!writeAtlas(path, images, options, layout, pages, &indexSize, &fileSize)) {
+		printf("FAIL: could not write %s\n", path);
+		return false;
+	}
+	int64_t written = nowNanoseconds();
+
+	printf("%-8s %2zu pages, %5.1f%% efficiency (%5.1f%% in cells), pack %7.1f ms, compose %6.1f ms, write %6.1f ms, total %7.1f ms\n",
+		options.skyline ? "skyline" : "MaxRects", layout.pages.size(), 100.0 * layout.imagePixels / layout.pagePixels,
+		100.0 * layout.cellPixels / layout.pagePixels, (packed - start) * 1e-6, (composed - packed) * 1e-6, (written - composed) * 1e-6, (written - start) * 1e-6);
+	printf("         pages:");
+	for (size_t i = 0; i < layout.pages.size(); ++i) {
+		printf(" %ux%u", layout.pages[i].width, layout.pages[i].height);
+	}
+	printf(", %zu byte index, %zu bytes in all\n", indexSize, fileSize);
+	return true;
+}
+
+// Every image is found by name, and its pixels and the repeated edges around them match the source.
+static bool checkAtlas(const TextureAtlas* atlas, const std::vector<AtlasImage>& images) {
+	uint32_t alignment = 1u << atlas->header->mipLevels;
+	int32_t padding = static_cast<int32_t>(atlas->header->padding);
+	for (size_t i = 0; i < images.size(); ++i) {
+		const AtlasImage& image = images[i];
+		const AtlasEntry* entry = findAtlasImage(atlas, image.name.c_str());
+		if (!entry || entry->width != image.width || entry->height != image.height) {
+			printf("FAIL: %s is missing or has the wrong size\n", image.name.c_str());
+			return false;
+		}
+		const AtlasPageDesc* page = &atlas->pages[entry->page];
+		// the UVs are exact in a power of two page
+		int32_t left = static_cast<int32_t>(entry->uv[0] * page->width);
+		int32_t top = static_cast<int32_t>(entry->uv[1] * page->height);
+		if (static_cast<uint32_t>(entry->uv[2] * page->width) != left + image.width ||
+			static_cast<uint32_t>(entry->uv[3] * page->height) != top + image.height || (left - padding) % alignment != 0 ||
+			(top - padding) % alignment != 0) {
+			printf("FAIL: %s has a misplaced or unaligned rectangle\n", image.name.c_str());
+			return false;
+		}
+		const uint8_t* pixels = atlas->data + page->pixelOffset;
+		for (int32_t y = -padding; y < static_cast<int32_t>(image.height) + padding; ++y) {
+			for (int32_t x = -padding; x < static_cast<int32_t>(image.width) + padding; ++x) {
+				uint32_t sourceX = std::min(static_cast<uint32_t>(std::max(x, 0)), image.width - 1);
+				uint32_t sourceY = std::min(static_cast<uint32_t>(std::max(y, 0)), image.height - 1);
+				const uint8_t* expected = &image.pixels[(sourceY * image.width + sourceX) * 4];
+				const uint8_t* actual = pixels + (static_cast<size_t>(top + y) * page->width + left + x) * 4;
+				if (memcmp(expected, actual, 4) != 0) {
+					printf("FAIL: %s differs at %d,%d\n", image.name.c_str(), x, y);
+					return false;
+				}
+			}
+		}
+	}
+	if (findAtlasImage(atlas, "not a sprite")) {
+		printf("FAIL: found an image that is not in the atlas\n");
+		return false;
+	}
+	printf("check: %zu images found with their pixels and borders intact\n", images.size());
+	return true;
+}
+
+static void timeLookups(const TextureAtlas* atlas, const std::vector<AtlasImage>& images) {
+	std::vector<uint64_t> hashes(images.size());
+	std::vector<uint64_t> missing(images.size());
+	std::vector<uint32_t> order(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		hashes[i] = atlasNameHash(images[i].name.c_str());
+		char name[32];
+		snprintf(name, sizeof(name), "missing%05zu", i);
+		missing[i] = atlasNameHash(name);
+		order[i] = static_cast<uint32_t>(i);
+	}
+	// in no particular order, as a frame would
+	for (size_t i = order.size(); i > 1; --i) {
+		std::swap(order[i - 1], order[nextRandom(static_cast<uint32_t>(i))]);
+	}
+	uint64_t found = 0;
+	int64_t start = nowNanoseconds();
+	for (int32_t round = 0; round < lookupRounds; ++round) {
+		for (size_t i = 0; i < order.size(); ++i) {
+			found += findAtlasImage(atlas, images[order[i]].name.c_str())->page + 1;
+		}
+	}
+	int64_t byName = nowNanoseconds();
+	for (int32_t round = 0; round < lookupRounds; ++round) {
+		for (size_t i = 0; i < order.size(); ++i) {
+			found += findAtlasEntry(atlas, hashes[order[i]])->page + 1;
+		}
+	}
+	int64_t byHash = nowNanoseconds();
+	for (int32_t round = 0; round < lookupRounds; ++round) {
+		for (size_t i = 0; i < order.size(); ++i) {
+			found += findAtlasEntry(atlas, missing[order[i]]) != NULL;
+		}
+	}
+	int64_t misses = nowNanoseconds();
+	double lookups = static_cast<double>(lookupRounds) * order.size();
+	// slots looked at to find each image
+	uint64_t probes = 0;
+	for (uint32_t slot = 0; slot <= atlas->slotMask; ++slot) {
+		if (atlas->slots[slot] != ATLAS_EMPTY_SLOT) {
+			probes += ((slot - atlasHomeSlot(hashes[atlas->slots[slot]], atlas->slotMask + 1)) & atlas->slotMask) + 1;
+		}
+	}
+	printf("lookup: %.1f ns by name, %.1f ns by hash, %.1f ns for a miss (%llu)\n", (byName - start) / lookups, (byHash - byName) / lookups,
+		(misses - byHash) / lookups, static_cast<unsigned long long>(found % 10));
+	printf("  %u slots, %.2f slots per lookup on average, %u at most\n", atlas->slotMask + 1, static_cast<double>(probes) / images.size(),
+		atlas->maxProbe + 1);
+}
+
+struct Sprite {
+	uint32_t image;
+	uint32_t page;
+};
+
+// Binds needed to draw the sprites in order, given what was bound before.
+static uint64_t countBinds(const Sprite* sprites, int32_t count, bool byPage, uint32_t* bound) {
+	uint64_t binds = 0;
+	for (int32_t i = 0; i < count; ++i) {
+		uint32_t texture = byPage ? sprites[i].page : sprites[i].image;
+		if (texture != *bound) {
+			*bound = texture;
+			++binds;
+		}
+	}
+	return binds;
+}
+
+static bool pageOrder(const Sprite& a, const Sprite& b) {
+	return a.page < b.page;
+}
+
+static bool imageOrder(const Sprite& a, const Sprite& b) {
+	return a.image < b.image;
+}
+
+// Sprites within a layer don't overlap, so a batcher may reorder them; layers stay in order.
+static void countFrameBinds(const TextureAtlas* atlas, const std::vector<AtlasImage>& images) {
+	std::vector<uint64_t> hashes(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		hashes[i] = atlasNameHash(images[i].name.c_str());
+	}
+	std::vector<uint32_t> workingSets(layersPerFrame * workingSetPerLayer);
+	for (size_t i = 0; i < workingSets.size(); ++i) {
+		workingSets[i] = nextRandom(static_cast<uint32_t>(images.size()));
+	}
+	uint64_t binds[4] = { 0, 0, 0, 0 };
+	uint32_t bound[4] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+	std::vector<Sprite> layer(spritesPerLayer);
+	int64_t lookupNanoseconds = 0;
+	for (int32_t frame = 0; frame < frameCount; ++frame) {
+		for (int32_t l = 0; l < layersPerFrame; ++l) {
+			int64_t start = nowNanoseconds();
+			for (int32_t i = 0; i < spritesPerLayer; ++i) {
+				uint32_t image = i > 0 && nextRandom(3) == 0 ? layer[i - 1].image : workingSets[l * workingSetPerLayer + nextRandom(workingSetPerLayer)];
+				layer[i].image = image;
+				layer[i].page = findAtlasEntry(atlas, hashes[image])->page;
+			}
+			lookupNanoseconds += nowNanoseconds() - start;
+			binds[0] += countBinds(layer.data(), spritesPerLayer, false, &bound[0]);
+			binds[1] += countBinds(layer.data(), spritesPerLayer, true, &bound[1]);
+			std::stable_sort(layer.begin(), layer.end(), imageOrder);
+			binds[2] += countBinds(layer.data(), spritesPerLayer, false, &bound[2]);
+			std::stable_sort(layer.begin(), layer.end(), pageOrder);
+			binds[3] += countBinds(layer.data(), spritesPerLayer, true, &bound[3]);
+		}
+	}
+	printf("binds per frame of %d sprites in %d layers (%u pages):\n", layersPerFrame * spritesPerLayer, layersPerFrame,
+		atlas->header->pageCount);
+	printf("  %-36s %7.1f in draw order, %7.1f sorted within layers\n", "a texture per image", static_cast<double>(binds[0]) / frameCount,
+		static_cast<double>(binds[2]) / frameCount);
+	printf("  %-36s %7.1f in draw order, %7.1f sorted within layers\n", "atlas pages", static_cast<double>(binds[1]) / frameCount,
+		static_cast<double>(binds[3]) / frameCount);
+	printf("  looking up the sprites: %.1f us per frame\n", lookupNanoseconds * 1e-3 / frameCount);
+}
+
+// A copy of the file with a slot past the entries, or an entry past the pages, must not open.
+static bool checkCorruptAtlas(const TextureAtlas* atlas) {
+	std::vector<uint32_t> copy((atlas->size + 3) / 4);
+	memcpy(&copy[0], atlas->data, atlas->size);
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(&copy[0]);
+	const AtlasFileHeader* header = atlas->header;
+	AtlasEntry* entries = reinterpret_cast<AtlasEntry*>(bytes + header->entriesOffset);
+	uint32_t* slots = reinterpret_cast<uint32_t*>(bytes + header->slotsOffset);
+	uint32_t slot = 0;
+	while (slots[slot] == ATLAS_EMPTY_SLOT) {
+		++slot;
+	}
+
+	TextureAtlas corrupt;
+	uint32_t index = slots[slot];
+	slots[slot] = header->entryCount;
+	bool ok = !openTextureAtlas(&corrupt, bytes, atlas->size);
+	slots[slot] = index;
+	uint16_t page = entries[0].page;
+	entries[0].page = header->pageCount;
+	ok = !openTextureAtlas(&corrupt, bytes, atlas->size) && ok;
+	entries[0].page = page;
+	ok = openTextureAtlas(&corrupt, bytes, atlas->size) && ok;
+	closeTextureAtlas(&corrupt);
+	printf("corrupt slot and page indices: %s\n", ok ? "rejected" : "FAIL: opened");
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	uint32_t count = argc >= 2 ? atoi(argv[1]) : 10000;
+	uint32_t pageSize = argc >= 3 ? atoi(argv[2]) : 2048;
+	if (count == 0 || count > 65536 || pageSize < 256 || (pageSize & (pageSize - 1)) != 0) {
+		printf("Usage: atlas_bench [images, 1 to 65536] [page size, a power of two from 256]\n");
+		return 1;
+	}
+	std::vector<AtlasImage> images;
+	makeImages(&images, count);
+	uint64_t pixels = 0;
+	for (size_t i = 0; i < images.size(); ++i) {
+		pixels += images[i].width * images[i].height;
+	}
+	printf("%u images, %.1f Mpixels, pages of up to %u, padding 2, 2 mip levels kept apart\n", count, pixels * 1e-6, pageSize);
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/atlas_bench_%d.atlas", static_cast<int32_t>(getpid()));
+	AtlasPackOptions options = { pageSize, 2, 2, true };
+	if (!bake(images, options, path)) {
+		return 1;
+	}
+	options.skyline = false;
+	if (!bake(images, options, path)) {
+		return 1;
+	}
+
+	TextureAtlas atlas;
+	int64_t start = nowNanoseconds();
+	bool mapped = mapTextureAtlasFile(&atlas, path);
+	int64_t opened = nowNanoseconds();
+	unlink(path);
+	if (!mapped) {
+		printf("FAIL: could not map the atlas\n");
+		return 1;
+	}
+	printf("mapped and opened in %.1f us\n", (opened - start) * 1e-3);
+	bool ok = checkAtlas(&atlas, images) && checkCorruptAtlas(&atlas);
+	if (ok) {
+		timeLookups(&atlas, images);
+		countFrameBinds(&atlas, images);
+	}
+	closeTextureAtlas(&atlas);
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
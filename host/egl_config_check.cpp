@@ -0,0 +1,120 @@
+// Scores sets of EGL configs, written as the attribute lists chooseEglConfig reads from a display,
+// with jni/egl_config.cpp on the host, and fails if the selection is not the expected config:
+// preferred depth and stencil sizes, falling back from multisampling, ES3 against ES2 renderables,
+// caveats, and a set where no config is usable.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o egl_config_check host/egl_config_check.cpp jni/egl_config.cpp memory_tracker.o -lEGL
+// Usage:        egl_config_check
+//
+// No EGL calls are made; the library is only needed to link chooseEglConfig.
+
+#include "../jni/egl_config.h"
+
+#include <EGL/eglext.h>
+#include <stdio.h>
+
+#define CONFIG(id, r, g, b, a, depth, stencil, samples, renderable, caveat) \
+	{ EGL_CONFIG_ID, id, EGL_RED_SIZE, r, EGL_GREEN_SIZE, g, EGL_BLUE_SIZE, b, EGL_ALPHA_SIZE, a, \
+	  EGL_DEPTH_SIZE, depth, EGL_STENCIL_SIZE, stencil, EGL_SAMPLES, samples, EGL_SURFACE_TYPE, EGL_WINDOW_BIT | EGL_PBUFFER_BIT, \
+	  EGL_RENDERABLE_TYPE, renderable, EGL_CONFIG_CAVEAT, caveat, EGL_NONE }
+
+const EGLint es2 = EGL_OPENGL_ES2_BIT;
+const EGLint es3 = EGL_OPENGL_ES2_BIT | EGL_OPENGL_ES3_BIT_KHR;
+
+// What a typical device offers: colour depths, depth and stencil combinations and MSAA, with ES3
+// only on the 8888 configs, one slow config and one that isn't conformant.
+static const EGLint deviceConfigs[][EGL_CONFIG_ATTRIBUTE_LIST_LENGTH] = {
+	CONFIG(1, 5, 6, 5, 0, 0, 0, 0, es2, EGL_NONE),
+	CONFIG(2, 5, 6, 5, 0, 16, 0, 0, es2, EGL_NONE),
+	CONFIG(3, 8, 8, 8, 8, 24, 8, 0, es3, EGL_NONE),
+	CONFIG(4, 8, 8, 8, 8, 16, 0, 0, es3, EGL_NONE),
+	CONFIG(5, 8, 8, 8, 0, 24, 8, 0, es2, EGL_NONE),
+	CONFIG(6, 8, 8, 8, 8, 0, 0, 0, es3, EGL_NONE),
+	CONFIG(7, 8, 8, 8, 8, 24, 8, 4, es3, EGL_NONE),
+	CONFIG(8, 8, 8, 8, 0, 0, 0, 0, es2, EGL_SLOW_CONFIG),
+	CONFIG(9, 8, 8, 8, 0, 16, 8, 0, es2, EGL_NON_CONFORMANT_CONFIG),
+};
+
+// Configs from a device without MSAA or ES3, every one of them 565.
+static const EGLint oldDeviceConfigs[][EGL_CONFIG_ATTRIBUTE_LIST_LENGTH] = {
+	CONFIG(1, 5, 6, 5, 0, 0, 0, 0, es2, EGL_NONE),
+	CONFIG(2, 5, 6, 5, 0, 16, 0, 0, es2, EGL_NONE),
+	CONFIG(3, 5, 6, 5, 0, 16, 8, 0, es2, EGL_NONE),
+};
+
+// Nothing here can be used for a window surface by ES2: GL only, non conformant, or pbuffer only.
+static const EGLint unusableConfigs[][EGL_CONFIG_ATTRIBUTE_LIST_LENGTH] = {
+	CONFIG(1, 8, 8, 8, 8, 24, 8, 0, EGL_OPENGL_BIT, EGL_NONE),
+	CONFIG(2, 8, 8, 8, 8, 24, 8, 0, es3, EGL_NON_CONFORMANT_CONFIG),
+	{ EGL_CONFIG_ID, 3, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+	  EGL_RENDERABLE_TYPE, es3, EGL_NONE },
+};
+
+struct SelectionCase {
+	const char* name;
+	const EGLint (*configs)[EGL_CONFIG_ATTRIBUTE_LIST_LENGTH];
+	int32_t count;
+	EglConfigRequirements requirements;
+	EGLint expectedId; // 0 when no config should be chosen
+};
+
+#define CONFIGS(configs) configs, static_cast<int32_t>(sizeof(configs) / sizeof(configs[0]))
+
+static const SelectionCase cases[] = {
+	// what the app asks for: the 2D scene has no depth, stencil or multisampling
+	{ "app, ES2", CONFIGS(deviceConfigs), { 8, 8, 8, 0, 0, 0, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 6 },
+	{ "app, ES3", CONFIGS(deviceConfigs), { 8, 8, 8, 0, 0, 0, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES3_BIT_KHR }, 6 },
+	{ "depth and stencil", CONFIGS(deviceConfigs), { 8, 8, 8, 0, 24, 8, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 5 },
+	{ "depth, no stencil", CONFIGS(deviceConfigs), { 8, 8, 8, 8, 16, 0, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 4 },
+	{ "4x MSAA", CONFIGS(deviceConfigs), { 8, 8, 8, 8, 24, 8, 4, EGL_WINDOW_BIT, EGL_OPENGL_ES3_BIT_KHR }, 7 },
+	{ "8x MSAA falls back to 4x", CONFIGS(deviceConfigs), { 8, 8, 8, 8, 24, 8, 8, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 7 },
+	{ "MSAA falls back to none", CONFIGS(oldDeviceConfigs), { 5, 6, 5, 0, 16, 0, 4, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 2 },
+	{ "888 falls back to 565", CONFIGS(oldDeviceConfigs), { 8, 8, 8, 0, 16, 8, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 3 },
+	{ "ES3 on an ES2 device", CONFIGS(oldDeviceConfigs), { 5, 6, 5, 0, 0, 0, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES3_BIT_KHR }, 0 },
+	{ "nothing usable", CONFIGS(unusableConfigs), { 8, 8, 8, 0, 0, 0, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT }, 0 },
+};
+
+static bool checkCase(const SelectionCase* c) {
+	const EGLint* configs[16];
+	for (int32_t i = 0; i < c->count; ++i) {
+		configs[i] = c->configs[i];
+	}
+	int32_t best = selectEglConfig(configs, c->count, &c->requirements);
+	EGLint id = best >= 0 ? findEglConfigAttribute(configs[best], EGL_CONFIG_ID) : 0;
+	bool ok = id == c->expectedId;
+	if (best >= 0) {
+		EglConfigAttributes config;
+		parseEglConfigAttributes(configs[best], &config);
+		printf("%-26s config %d: rgba=%d%d%d%d depth=%d stencil=%d samples=%d score=%d\n", c->name, id, config.redSize,
+			config.greenSize, config.blueSize, config.alphaSize, config.depthSize, config.stencilSize, config.samples,
+			scoreEglConfig(configs[best], &c->requirements));
+	} else {
+		printf("%-26s no config\n", c->name);
+	}
+	if (!ok) {
+		if (c->expectedId) {
+			printf("FAIL: expected config %d\n", c->expectedId);
+		} else {
+			printf("FAIL: expected no config\n");
+		}
+	}
+	return ok;
+}
+
+int main() {
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		ok = checkCase(&cases[i]) && ok;
+	}
+
+	// a slow config only wins when nothing else is usable
+	const EGLint* slowOnly[] = { deviceConfigs[7], deviceConfigs[8] };
+	const EglConfigRequirements requirements = { 8, 8, 8, 0, 0, 0, 0, EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT };
+	if (selectEglConfig(slowOnly, 2, &requirements) != 0) {
+		printf("FAIL: the slow config was not chosen over a non conformant one\n");
+		ok = false;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
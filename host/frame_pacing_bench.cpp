@@ -0,0 +1,73 @@
+// Measures the latency/throughput trade-off of the frames-in-flight limit in jni/frame_pacer.cpp
+// against the simulated GPU from jni/gpu_fence.cpp, for every depth and a few workload mixes.
+//
+// Build with:   c++ -O2 -o frame_pacing_bench host/frame_pacing_bench.cpp jni/frame_pacer.cpp jni/gpu_fence.cpp
+// Usage:        frame_pacing_bench [frames]
+//
+// Latency is from the start of a frame's CPU work to the GPU finishing it; throughput is frames
+// per second over the run. Times are real, CPU work is a busy loop and GPU waits sleep.
+
+#include "../jni/frame_pacer.h"
+#include "../jni/time_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Workload {
+	const char* name;
+	int64_t cpuNanoseconds;
+	int64_t gpuNanoseconds;
+	int64_t gpuLatencyNanoseconds; // submission to the GPU starting on it, at the least
+};
+
+static void busyWait(int64_t nanoseconds) {
+	int64_t end = nowNanoseconds() + nanoseconds;
+	while (nowNanoseconds() < end) {
+	}
+}
+
+static void runWorkload(const Workload* workload, int32_t depth, int32_t frames) {
+	SimulatedGpu gpu;
+	initSimulatedGpu(&gpu, workload->gpuLatencyNanoseconds + workload->gpuNanoseconds, workload->gpuNanoseconds);
+	GpuFenceProvider provider;
+	initSimulatedFenceProvider(&provider, &gpu);
+	FramePacer pacer;
+	initFramePacer(&pacer, &provider, depth);
+
+	double latencySum = 0.0;
+	int64_t latencyMax = 0;
+	int64_t start = nowNanoseconds();
+	for (int32_t i = 0; i < frames; ++i) {
+		beginPacedFrame(&pacer);
+		int64_t frameStart = nowNanoseconds();
+		busyWait(workload->cpuNanoseconds);
+		endPacedFrame(&pacer);
+		int64_t done = gpu.completion[(gpu.nextFence - 1) % SIMULATED_GPU_MAX_FENCES];
+		latencySum += done - frameStart;
+		if (done - frameStart > latencyMax) {
+			latencyMax = done - frameStart;
+		}
+	}
+	int64_t elapsed = nowNanoseconds() - start;
+
+	const FramePacerStats* stats = &pacer.stats;
+	printf("%-10s depth %d: %6.1f fps, latency mean %6.2f ms max %6.2f ms, waited %3llu frames, mean wait %5.2f ms\n",
+		workload->name, depth, frames * 1e9 / elapsed, latencySum * 1e-6 / frames, latencyMax * 1e-6,
+		static_cast<unsigned long long>(stats->waits), stats->waits ? stats->totalWaitNanoseconds * 1e-6 / stats->waits : 0.0);
+	termFramePacer(&pacer);
+}
+
+int main(int argc, char** argv) {
+	int32_t frames = argc > 1 ? atoi(argv[1]) : 120;
+	const Workload workloads[] = {
+		{ "gpu bound", 4000000, 8000000, 2000000 },
+		{ "cpu bound", 8000000, 4000000, 2000000 },
+		{ "balanced", 6000000, 6000000, 2000000 },
+	};
+	for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w) {
+		for (int32_t depth = 1; depth <= FRAME_PACER_MAX_DEPTH; ++depth) {
+			runWorkload(&workloads[w], depth, frames);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,523 @@
+// Loads a file written by tools/mesh_tool.cpp through jni/mesh.cpp and times it against loading the
+// same mesh in the float/uint32 layout the tool converts from: file size, load time (file read plus
+// buffer uploads) and the ACMR of the stored triangle order. Both are drawn, the file with bindMesh
+// and drawMesh, and the images compared; headers corrupted in ways loadMesh must catch are checked
+// to be rejected without creating buffers.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -D__ANDROID__ -Ihost/ndk -o mesh_bench host/mesh_bench.cpp jni/mesh.cpp
+//                   jni/gl_extensions.cpp host/android_host.cpp memory_tracker.o -lEGL -lGLESv2 -lpthread -ldl
+// Usage:        mesh_tool input.obj model.mesh && EGL_PLATFORM=surfaceless mesh_bench model.mesh
+//
+// The float layout is decoded from the file, so both hold the same vertices: positions, normals and
+// texture coordinates present as floats and 32 bit indices, as mesh_tool's size report counts them.
+
+#include "android_host.h"
+#include "../jni/gl_extensions.h"
+#include "../jni/memory_tracker.h"
+#include "../jni/mesh.h"
+#include "../jni/time_utils.h"
+
+#include <EGL/egl.h>
+#include <android/log.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+const int32_t loadRounds = 25;
+const int32_t cacheSize = 16; // mesh_tool's default FIFO
+const int32_t imageSize = 256;
+const int32_t pixelTolerance = 8;
+const double maxDifferingPixels = 0.01;
+
+static const char vertexShader[] =
+	"uniform vec3 positionScale;\n"
+	"uniform vec3 positionOffset;\n"
+	"uniform vec2 texCoordScale;\n"
+	"uniform vec2 texCoordOffset;\n"
+	"uniform vec4 fit;\n" // centre and 1 / radius of the decoded mesh
+	"attribute vec3 position;\n"
+	"attribute vec3 normal;\n"
+	"attribute vec2 texCoord;\n"
+	"varying vec4 vColor;\n"
+	"void main() {\n"
+	"	vec3 p = (position * positionScale + positionOffset - fit.xyz) * fit.w;\n"
+	"	vec2 t = clamp(texCoord * texCoordScale + texCoordOffset, 0.0, 1.0);\n"
+	"	vColor = vec4(normal * 0.25 + 0.25 + vec3(t, 0.0) * 0.5, 1.0);\n"
+	"	gl_Position = vec4(p * 0.9, 1.0);\n"
+	"}\n";
+
+static const char fragmentShader[] =
+	"precision mediump float;\n"
+	"varying vec4 vColor;\n"
+	"void main() {\n"
+	"	gl_FragColor = vColor;\n"
+	"}\n";
+
+struct FloatMesh {
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t components; // floats per vertex
+	bool hasNormals;
+	bool hasTexCoords;
+	float* vertices;
+	uint32_t* indices;
+};
+
+struct Bench {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface;
+	GLuint program;
+	GLint locations[MESH_ATTRIBUTE_COUNT];
+	GLint positionScale, positionOffset, texCoordScale, texCoordOffset, fit;
+	bool uintIndices;
+};
+
+static GLuint compileShader(GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+static bool initBench(Bench* bench) {
+	bench->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(bench->display, NULL, NULL)) {
+		printf("no EGL display; on Mesa try EGL_PLATFORM=surfaceless\n");
+		return false;
+	}
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 16,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(bench->display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+		printf("no pbuffer config\n");
+		return false;
+	}
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, imageSize, EGL_HEIGHT, imageSize, EGL_NONE };
+	bench->surface = eglCreatePbufferSurface(bench->display, config, surfaceAttribs);
+	const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+	bench->context = eglCreateContext(bench->display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (bench->surface == EGL_NO_SURFACE || bench->context == EGL_NO_CONTEXT ||
+		!eglMakeCurrent(bench->display, bench->surface, bench->surface, bench->context)) {
+		printf("could not make a context current: 0x%04x\n", eglGetError());
+		return false;
+	}
+	printf("GL %s, %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+	bench->uintIndices = hasExtension(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)), "GL_OES_element_index_uint");
+
+	bench->program = glCreateProgram();
+	glAttachShader(bench->program, compileShader(GL_VERTEX_SHADER, vertexShader));
+	glAttachShader(bench->program, compileShader(GL_FRAGMENT_SHADER, fragmentShader));
+	glLinkProgram(bench->program);
+	glUseProgram(bench->program);
+	bench->locations[MESH_ATTRIBUTE_POSITION] = glGetAttribLocation(bench->program, "position");
+	bench->locations[MESH_ATTRIBUTE_NORMAL] = glGetAttribLocation(bench->program, "normal");
+	bench->locations[MESH_ATTRIBUTE_TEXCOORD] = glGetAttribLocation(bench->program, "texCoord");
+	bench->positionScale = glGetUniformLocation(bench->program, "positionScale");
+	bench->positionOffset = glGetUniformLocation(bench->program, "positionOffset");
+	bench->texCoordScale = glGetUniformLocation(bench->program, "texCoordScale");
+	bench->texCoordOffset = glGetUniformLocation(bench->program, "texCoordOffset");
+	bench->fit = glGetUniformLocation(bench->program, "fit");
+	glViewport(0, 0, imageSize, imageSize);
+	glEnable(GL_DEPTH_TEST);
+	return true;
+}
+
+static void termBench(Bench* bench) {
+	glDeleteProgram(bench->program);
+	eglMakeCurrent(bench->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(bench->display, bench->context);
+	eglDestroySurface(bench->display, bench->surface);
+	eglTerminate(bench->display);
+}
+
+static uint8_t* readFile(FILE* file, size_t* size) {
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t* data = static_cast<uint8_t*>(malloc(length > 0 ? length : 1));
+	*size = length > 0 ? fread(data, 1, length, file) : 0;
+	return data;
+}
+
+static float halfToFloat(uint16_t half) {
+	uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+	if (exponent == 0) {
+		float value = ldexpf(static_cast<float>(mantissa), -24);
+		return sign ? -value : value;
+	}
+	uint32_t bits = sign | (exponent == 31 ? 0x7f800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// As the GL converts one attribute component, normalized values by the ES 3 rule.
+static float decodeComponent(const uint8_t* data, uint16_t type, bool normalized) {
+	switch (type) {
+	case MESH_TYPE_BYTE: {
+		int8_t v;
+		memcpy(&v, data, sizeof(v));
+		return normalized ? fmaxf(v / 127.0f, -1.0f) : v;
+	}
+	case MESH_TYPE_UNSIGNED_BYTE:
+		return normalized ? data[0] / 255.0f : data[0];
+	case MESH_TYPE_SHORT: {
+		int16_t v;
+		memcpy(&v, data, sizeof(v));
+		return normalized ? fmaxf(v / 32767.0f, -1.0f) : v;
+	}
+	case MESH_TYPE_UNSIGNED_SHORT: {
+		uint16_t v;
+		memcpy(&v, data, sizeof(v));
+		return normalized ? v / 65535.0f : v;
+	}
+	case MESH_TYPE_HALF_FLOAT_OES: {
+		uint16_t v;
+		memcpy(&v, data, sizeof(v));
+		return halfToFloat(v);
+	}
+	default: {
+		float v;
+		memcpy(&v, data, sizeof(v));
+		return v;
+	}
+	}
+}
+
+static uint32_t componentSize(uint16_t type) {
+	return type == MESH_TYPE_BYTE || type == MESH_TYPE_UNSIGNED_BYTE ? 1 : (type == MESH_TYPE_FLOAT ? 4 : 2);
+}
+
+// Decodes the file's vertices to floats, with the scale and offset applied, and widens its indices.
+static void decodeFloatMesh(const uint8_t* data, FloatMesh* mesh) {
+	MeshFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	memset(mesh, 0, sizeof(FloatMesh));
+	mesh->vertexCount = header.vertexCount;
+	mesh->indexCount = header.indexCount;
+	const MeshAttributeDesc* attributes[MESH_ATTRIBUTE_COUNT] = { NULL, NULL, NULL };
+	for (uint32_t i = 0; i < header.attributeCount; ++i) {
+		if (header.attributes[i].semantic < MESH_ATTRIBUTE_COUNT) {
+			attributes[header.attributes[i].semantic] = &header.attributes[i];
+		}
+	}
+	mesh->hasNormals = attributes[MESH_ATTRIBUTE_NORMAL] != NULL;
+	mesh->hasTexCoords = attributes[MESH_ATTRIBUTE_TEXCOORD] != NULL;
+	mesh->components = 3 + (mesh->hasNormals ? 3 : 0) + (mesh->hasTexCoords ? 2 : 0);
+	mesh->vertices = static_cast<float*>(malloc(mesh->vertexCount * mesh->components * sizeof(float)));
+	mesh->indices = static_cast<uint32_t*>(malloc(mesh->indexCount * sizeof(uint32_t)));
+
+	const int32_t sizes[MESH_ATTRIBUTE_COUNT] = { 3, 3, 2 };
+	for (uint32_t v = 0; v < mesh->vertexCount; ++v) {
+		const uint8_t* vertex = data + header.vertexDataOffset + v * header.vertexStride;
+		float* out = mesh->vertices + v * mesh->components;
+		for (int32_t semantic = 0; semantic < MESH_ATTRIBUTE_COUNT; ++semantic) {
+			const MeshAttributeDesc* attribute = attributes[semantic];
+			if (!attribute) {
+				continue;
+			}
+			for (int32_t k = 0; k < sizes[semantic]; ++k) {
+				float value = k < attribute->components ?
+					decodeComponent(vertex + attribute->offset + k * componentSize(attribute->type), attribute->type, attribute->normalized) : 0.0f;
+				if (semantic == MESH_ATTRIBUTE_POSITION) {
+					value = value * header.positionScale[k] + header.positionOffset[k];
+				} else if (semantic == MESH_ATTRIBUTE_TEXCOORD) {
+					value = value * header.texCoordScale[k] + header.texCoordOffset[k];
+				}
+				*out++ = value;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < mesh->indexCount; ++i) {
+		uint16_t index;
+		memcpy(&index, data + header.indexDataOffset + i * sizeof(uint16_t), sizeof(index));
+		mesh->indices[i] = index;
+	}
+}
+
+static double computeAcmr(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount) {
+	uint32_t* cachedAt = static_cast<uint32_t*>(calloc(vertexCount, sizeof(uint32_t)));
+	uint32_t time = 0;
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < indexCount; ++i) {
+		uint32_t v = indices[i];
+		if (cachedAt[v] == 0 || time - cachedAt[v] >= static_cast<uint32_t>(cacheSize)) {
+			cachedAt[v] = ++time;
+			++misses;
+		}
+	}
+	free(cachedAt);
+	return static_cast<double>(misses) / (indexCount / 3);
+}
+
+// Reads the float layout back from file and uploads it as is, the way loadMesh takes its format.
+static bool loadFloatMesh(FILE* file, const FloatMesh* layout, GLuint buffers[2]) {
+	size_t size = 0;
+	uint8_t* data = readFile(file, &size);
+	size_t vertexBytes = layout->vertexCount * layout->components * sizeof(float);
+	size_t indexBytes = layout->indexCount * sizeof(uint32_t);
+	bool ok = size == vertexBytes + indexBytes;
+	if (ok) {
+		glGenBuffers(2, buffers);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, data, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, data + vertexBytes, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	free(data);
+	return ok;
+}
+
+static bool loadMeshFile(FILE* file, Mesh* mesh) {
+	size_t size = 0;
+	uint8_t* data = readFile(file, &size);
+	bool ok = loadMesh(mesh, data, size);
+	free(data);
+	return ok;
+}
+
+static double median(double* values, int32_t count) {
+	std::sort(values, values + count);
+	return values[count / 2];
+}
+
+static void setFit(Bench* bench, const float center[3], float radius) {
+	glUniform4f(bench->fit, center[0], center[1], center[2], 1.0f / radius);
+}
+
+static void readImage(uint32_t* pixels) {
+	glReadPixels(0, 0, imageSize, imageSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+static void drawFloatMesh(Bench* bench, const FloatMesh* layout, const GLuint buffers[2]) {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glUniform3f(bench->positionScale, 1.0f, 1.0f, 1.0f);
+	glUniform3f(bench->positionOffset, 0.0f, 0.0f, 0.0f);
+	glUniform2f(bench->texCoordScale, 1.0f, 1.0f);
+	glUniform2f(bench->texCoordOffset, 0.0f, 0.0f);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+	GLsizei stride = layout->components * sizeof(float);
+	uintptr_t offset = 0;
+	const bool present[MESH_ATTRIBUTE_COUNT] = { true, layout->hasNormals, layout->hasTexCoords };
+	const int32_t sizes[MESH_ATTRIBUTE_COUNT] = { 3, 3, 2 };
+	for (int32_t semantic = 0; semantic < MESH_ATTRIBUTE_COUNT; ++semantic) {
+		GLint location = bench->locations[semantic];
+		if (location >= 0) {
+			glDisableVertexAttribArray(location);
+		}
+		if (!present[semantic]) {
+			continue;
+		}
+		if (location >= 0) {
+			glVertexAttribPointer(location, sizes[semantic], GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offset));
+			glEnableVertexAttribArray(location);
+		}
+		offset += sizes[semantic] * sizeof(float);
+	}
+	glDrawElements(GL_TRIANGLES, layout->indexCount, GL_UNSIGNED_INT, 0);
+}
+
+static void drawFileMesh(Bench* bench, const Mesh* mesh) {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glUniform3fv(bench->positionScale, 1, mesh->positionScale);
+	glUniform3fv(bench->positionOffset, 1, mesh->positionOffset);
+	glUniform2fv(bench->texCoordScale, 1, mesh->texCoordScale);
+	glUniform2fv(bench->texCoordOffset, 1, mesh->texCoordOffset);
+	for (int32_t semantic = 0; semantic < MESH_ATTRIBUTE_COUNT; ++semantic) {
+		if (bench->locations[semantic] >= 0) {
+			glDisableVertexAttribArray(bench->locations[semantic]);
+		}
+	}
+	bindMesh(mesh, bench->locations);
+	drawMesh(mesh);
+}
+
+// Each corruption must make loadMesh fail and leave no buffers behind.
+static bool checkRejected(const uint8_t* data, size_t size) {
+	MeshFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	uint8_t* copy = static_cast<uint8_t*>(malloc(size));
+	const char* names[] = {
+		"bad magic", "truncated index data", "32 bit indices", "attribute past the vertex stride",
+		"stride shorter than its attributes", "unknown attribute type", "too many attributes"
+	};
+	const int32_t count = sizeof(names) / sizeof(names[0]);
+	const MeshAttributeDesc* last = &header.attributes[header.attributeCount - 1];
+	bool ok = true;
+	setHostLogPriority(ANDROID_LOG_SILENT);
+	for (int32_t i = 0; i < count; ++i) {
+		memcpy(copy, data, size);
+		MeshFileHeader corrupt = header;
+		size_t corruptSize = size;
+		switch (i) {
+		case 0: corrupt.magic ^= 1; break;
+		case 1: corruptSize = size - 1; break;
+		case 2: corrupt.indexType = 0x1405; break; // GL_UNSIGNED_INT
+		case 3: corrupt.attributes[0].offset = static_cast<uint16_t>(header.vertexStride - 1); break;
+		case 4: corrupt.vertexStride = static_cast<uint16_t>(last->offset + 1); break;
+		case 5: corrupt.attributes[0].type = 0x1404; break; // GL_INT, not an ES2 attribute type
+		case 6: corrupt.attributeCount = MESH_MAX_ATTRIBUTES + 1; break;
+		}
+		memcpy(copy, &corrupt, sizeof(corrupt));
+		Mesh mesh;
+		bool loaded = loadMesh(&mesh, copy, corruptSize);
+		if (loaded || mesh.vertexBuffer != 0 || mesh.indexBuffer != 0) {
+			printf("FAIL: a mesh with %s was loaded\n", names[i]);
+			if (loaded) {
+				deleteMesh(&mesh);
+			}
+			ok = false;
+		}
+	}
+	setHostLogPriority(ANDROID_LOG_WARN);
+	free(copy);
+	if (ok) {
+		printf("rejected: %d corrupt headers\n", count);
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	if (argc != 2) {
+		printf("usage: mesh_bench model.mesh\n");
+		return 1;
+	}
+	FILE* meshFile = fopen(argv[1], "rb");
+	if (!meshFile) {
+		printf("could not open %s\n", argv[1]);
+		return 1;
+	}
+	static Bench bench;
+	if (!initBench(&bench)) {
+		fclose(meshFile);
+		return 1;
+	}
+
+	bool ok = true;
+	size_t fileSize = 0;
+	uint8_t* fileData = readFile(meshFile, &fileSize);
+	Mesh mesh;
+	if (!loadMesh(&mesh, fileData, fileSize)) {
+		printf("FAIL: %s did not load\n", argv[1]);
+		free(fileData);
+		fclose(meshFile);
+		termBench(&bench);
+		return 1;
+	}
+	deleteMesh(&mesh);
+	FloatMesh layout;
+	decodeFloatMesh(fileData, &layout);
+	size_t floatVertexBytes = layout.vertexCount * layout.components * sizeof(float);
+	size_t floatSize = floatVertexBytes + layout.indexCount * sizeof(uint32_t);
+	FILE* floatFile = tmpfile();
+	fwrite(layout.vertices, 1, floatVertexBytes, floatFile);
+	fwrite(layout.indices, sizeof(uint32_t), layout.indexCount, floatFile);
+	fflush(floatFile);
+
+	printf("%s: %u vertices, %u triangles\n", argv[1], layout.vertexCount, layout.indexCount / 3);
+	printf("size: %zu bytes as floats/uint32, %zu bytes as stored (%.1f%%)\n", floatSize, fileSize, 100.0 * fileSize / floatSize);
+	printf("ACMR (FIFO %d): %.3f\n", cacheSize, computeAcmr(layout.indices, layout.indexCount, layout.vertexCount));
+
+	double fileMs[loadRounds], floatMs[loadRounds];
+	GLuint floatBuffers[2] = { 0, 0 };
+	for (int32_t round = 0; round < loadRounds && ok; ++round) {
+		int64_t start = nowNanoseconds();
+		ok = loadMeshFile(meshFile, &mesh);
+		glFinish();
+		fileMs[round] = (nowNanoseconds() - start) * 1e-6;
+		if (ok) {
+			deleteMesh(&mesh);
+		}
+
+		start = nowNanoseconds();
+		ok = ok && loadFloatMesh(floatFile, &layout, floatBuffers);
+		glFinish();
+		floatMs[round] = (nowNanoseconds() - start) * 1e-6;
+		if (ok) {
+			glDeleteBuffers(2, floatBuffers);
+		}
+	}
+	if (!ok) {
+		printf("FAIL: a load round failed\n");
+	} else {
+		double fileMedian = median(fileMs, loadRounds);
+		double floatMedian = median(floatMs, loadRounds);
+		printf("load (median of %d, read and upload): %.3f ms as floats/uint32, %.3f ms as stored (%.2fx)\n",
+			loadRounds, floatMedian, fileMedian, floatMedian / fileMedian);
+	}
+
+	// the quantised mesh must draw what the floats it was decoded to draw
+	if (ok && bench.uintIndices) {
+		uint32_t* expected = static_cast<uint32_t*>(malloc(imageSize * imageSize * sizeof(uint32_t)));
+		uint32_t* actual = static_cast<uint32_t*>(malloc(imageSize * imageSize * sizeof(uint32_t)));
+		ok = loadMeshFile(meshFile, &mesh) && loadFloatMesh(floatFile, &layout, floatBuffers);
+		if (ok) {
+			float radius = fmaxf(fmaxf(mesh.positionScale[0], mesh.positionScale[1]), mesh.positionScale[2]);
+			setFit(&bench, mesh.positionOffset, radius);
+			drawFloatMesh(&bench, &layout, floatBuffers);
+			readImage(expected);
+			drawFileMesh(&bench, &mesh);
+			readImage(actual);
+			int32_t differing = 0, covered = 0;
+			for (int32_t i = 0; i < imageSize * imageSize; ++i) {
+				covered += ((expected[i] | actual[i]) & 0xffffff) != 0;
+				for (int32_t c = 0; c < 24; c += 8) {
+					int32_t a = (expected[i] >> c) & 0xff, b = (actual[i] >> c) & 0xff;
+					if (abs(a - b) > pixelTolerance) {
+						++differing;
+						break;
+					}
+				}
+			}
+			printf("image: %d of %d covered pixels differ from the float mesh's\n", differing, covered);
+			if (covered == 0 || differing > maxDifferingPixels * covered) {
+				printf("FAIL: the stored mesh does not draw like the float one\n");
+				ok = false;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			glDeleteBuffers(2, floatBuffers);
+			deleteMesh(&mesh);
+		} else {
+			printf("FAIL: could not load the meshes to draw\n");
+		}
+		free(expected);
+		free(actual);
+	} else if (ok) {
+		printf("image: skipped, no GL_OES_element_index_uint for the float mesh\n");
+	}
+
+	ok = checkRejected(fileData, fileSize) && ok;
+
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	if (snapshot.gpu[GPU_MEMORY_BUFFERS].liveBytes != 0) {
+		printf("FAIL: %lld bytes of mesh buffers still tracked\n", static_cast<long long>(snapshot.gpu[GPU_MEMORY_BUFFERS].liveBytes));
+		ok = false;
+	}
+
+	free(layout.vertices);
+	free(layout.indices);
+	free(fileData);
+	fclose(floatFile);
+	fclose(meshFile);
+	termBench(&bench);
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,464 @@
+// Reads snapshots from jni/metrics.c's exporter: from a Unix domain socket it is listening on, or
+// from the file it writes, and prints them. --check instead runs the registry and the exporter on
+// the host: writer threads record into counters and a histogram while a reader on the socket checks
+// every snapshot, then the totals, the JSON file target and the cost of recording.
+//
+// Build with:   cc -O2 -c jni/metrics.c
+//               c++ -O2 -o metrics_reader host/metrics_reader.cpp metrics.o -lpthread
+// Usage:        metrics_reader SOCKET        e.g. after adb forward, or @name for the abstract namespace
+//               metrics_reader --file FILE   binary or JSON
+//               metrics_reader --check [writer threads]
+//
+// The app exports JSON to files/metrics.json; to stream binary snapshots instead, start the exporter
+// with METRICS_TARGET_SOCKET on "@angles_metrics" and forward it, e.g.
+//               adb forward localfilesystem:/tmp/angles_metrics localabstract:angles_metrics
+
+#include "../jni/metrics.h"
+#include "../jni/time_utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CHECK_MAX_THREADS 16
+
+struct SnapshotMetric {
+	char name[METRICS_NAME_SIZE];
+	int32_t type;
+	uint32_t value;
+	float gauge;
+	uint32_t sum;
+	int32_t bucketCount;
+	float bounds[METRICS_MAX_BUCKETS - 1];
+	uint32_t buckets[METRICS_MAX_BUCKETS];
+};
+
+struct Snapshot {
+	int32_t version;
+	int64_t nanoseconds;
+	int32_t count;
+	SnapshotMetric metrics[METRICS_MAX];
+};
+
+struct ByteReader {
+	const uint8_t* data;
+	size_t size;
+	size_t offset;
+	bool overflow;
+};
+
+static uint64_t readUnsigned(ByteReader* reader, size_t count) {
+	if (reader->offset + count > reader->size) {
+		reader->overflow = true;
+		return 0;
+	}
+	uint64_t value = 0;
+	for (size_t i = 0; i < count; ++i) {
+		value |= static_cast<uint64_t>(reader->data[reader->offset + i]) << (i * 8);
+	}
+	reader->offset += count;
+	return value;
+}
+
+static float readFloat(ByteReader* reader) {
+	union { float f; uint32_t u; } bits;
+	bits.u = static_cast<uint32_t>(readUnsigned(reader, 4));
+	return bits.f;
+}
+
+static bool parseSnapshot(const uint8_t* data, size_t size, Snapshot* snapshot) {
+	ByteReader reader = { data, size, 0, false };
+	if (size < 4 || memcmp(data, "MTRC", 4) != 0) {
+		return false;
+	}
+	reader.offset = 4;
+	snapshot->version = static_cast<int32_t>(readUnsigned(&reader, 1));
+	snapshot->nanoseconds = static_cast<int64_t>(readUnsigned(&reader, 8));
+	snapshot->count = static_cast<int32_t>(readUnsigned(&reader, 2));
+	if (snapshot->version != METRICS_VERSION || snapshot->count > METRICS_MAX) {
+		return false;
+	}
+	for (int32_t i = 0; i < snapshot->count && !reader.overflow; ++i) {
+		SnapshotMetric* metric = &snapshot->metrics[i];
+		memset(metric, 0, sizeof(SnapshotMetric));
+		metric->type = static_cast<int32_t>(readUnsigned(&reader, 1));
+		size_t nameLength = static_cast<size_t>(readUnsigned(&reader, 1));
+		if (nameLength >= METRICS_NAME_SIZE || reader.offset + nameLength > size) {
+			return false;
+		}
+		memcpy(metric->name, data + reader.offset, nameLength);
+		reader.offset += nameLength;
+		if (metric->type == METRIC_GAUGE) {
+			metric->gauge = readFloat(&reader);
+		} else if (metric->type == METRIC_COUNTER || metric->type == METRIC_HISTOGRAM) {
+			metric->value = static_cast<uint32_t>(readUnsigned(&reader, 4));
+		} else {
+			return false;
+		}
+		if (metric->type == METRIC_HISTOGRAM) {
+			metric->sum = static_cast<uint32_t>(readUnsigned(&reader, 4));
+			metric->bucketCount = static_cast<int32_t>(readUnsigned(&reader, 1));
+			if (metric->bucketCount < 1 || metric->bucketCount > METRICS_MAX_BUCKETS) {
+				return false;
+			}
+			for (int32_t b = 0; b < metric->bucketCount - 1; ++b) {
+				metric->bounds[b] = readFloat(&reader);
+			}
+			for (int32_t b = 0; b < metric->bucketCount; ++b) {
+				metric->buckets[b] = static_cast<uint32_t>(readUnsigned(&reader, 4));
+			}
+		}
+	}
+	return !reader.overflow && reader.offset == size;
+}
+
+static void printSnapshot(const Snapshot* snapshot) {
+	printf("%.3f s, %d metrics\n", snapshot->nanoseconds * 1e-9, snapshot->count);
+	for (int32_t i = 0; i < snapshot->count; ++i) {
+		const SnapshotMetric* metric = &snapshot->metrics[i];
+		if (metric->type == METRIC_COUNTER) {
+			printf("  %-24s %u\n", metric->name, metric->value);
+		} else if (metric->type == METRIC_GAUGE) {
+			printf("  %-24s %g\n", metric->name, metric->gauge);
+		} else {
+			printf("  %-24s count %u, mean %.2f:", metric->name, metric->value, metric->value ? static_cast<double>(metric->sum) / metric->value : 0.0);
+			for (int32_t b = 0; b < metric->bucketCount; ++b) {
+				if (b < metric->bucketCount - 1) {
+					printf(" <=%g %u", metric->bounds[b], metric->buckets[b]);
+				} else {
+					printf(" more %u", metric->buckets[b]);
+				}
+			}
+			printf("\n");
+		}
+	}
+	fflush(stdout);
+}
+
+static const SnapshotMetric* findMetric(const Snapshot* snapshot, const char* name) {
+	for (int32_t i = 0; i < snapshot->count; ++i) {
+		if (strcmp(snapshot->metrics[i].name, name) == 0) {
+			return &snapshot->metrics[i];
+		}
+	}
+	return NULL;
+}
+
+static int connectMetrics(const char* path) {
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	size_t length = strlen(path);
+	if (length < 2 || length >= sizeof(address.sun_path)) {
+		return -1;
+	}
+	socklen_t addressLength;
+	if (path[0] == '@') {
+		memcpy(address.sun_path + 1, path + 1, length - 1);
+		addressLength = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + length);
+	} else {
+		memcpy(address.sun_path, path, length);
+		addressLength = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + length + 1);
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), addressLength) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+static bool readFully(int fd, uint8_t* data, size_t size) {
+	while (size > 0) {
+		ssize_t got = read(fd, data, size);
+		if (got <= 0) {
+			return false;
+		}
+		data += got;
+		size -= got;
+	}
+	return true;
+}
+
+// One length prefixed snapshot; false at the end of the stream or on a malformed one.
+static bool readSnapshot(int fd, uint8_t* buffer, size_t size, Snapshot* snapshot, bool* malformed) {
+	uint8_t prefix[4];
+	*malformed = false;
+	if (!readFully(fd, prefix, 4)) {
+		return false;
+	}
+	size_t length = prefix[0] | (prefix[1] << 8) | (prefix[2] << 16) | (static_cast<size_t>(prefix[3]) << 24);
+	if (length > size || !readFully(fd, buffer, length) || !parseSnapshot(buffer, length, snapshot)) {
+		*malformed = true;
+		return false;
+	}
+	return true;
+}
+
+static int readSocket(const char* path) {
+	int fd = connectMetrics(path);
+	if (fd < 0) {
+		printf("Could not connect to %s\n", path);
+		return 1;
+	}
+	static uint8_t buffer[METRICS_EXPORTER_BUFFER_SIZE];
+	static Snapshot snapshot;
+	bool malformed = false;
+	while (readSnapshot(fd, buffer, sizeof(buffer), &snapshot, &malformed)) {
+		printSnapshot(&snapshot);
+	}
+	close(fd);
+	if (malformed) {
+		printf("Malformed snapshot\n");
+	}
+	return malformed ? 1 : 0;
+}
+
+static int readFile(const char* path) {
+	static uint8_t buffer[METRICS_EXPORTER_BUFFER_SIZE];
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		printf("Could not open %s\n", path);
+		return 1;
+	}
+	size_t length = fread(buffer, 1, sizeof(buffer), file);
+	fclose(file);
+	if (length > 0 && buffer[0] == '{') {
+		fwrite(buffer, 1, length, stdout);
+		return 0;
+	}
+	static Snapshot snapshot;
+	if (!parseSnapshot(buffer, length, &snapshot)) {
+		printf("Malformed snapshot in %s\n", path);
+		return 1;
+	}
+	printSnapshot(&snapshot);
+	return 0;
+}
+
+const int32_t checkRecordsPerThread = 1000000;
+const float checkBounds[] = { 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f };
+
+struct CheckIds {
+	int32_t counter;
+	int32_t histogram;
+	int32_t gauge;
+};
+
+struct CheckWriters {
+	CheckIds ids;
+	int32_t threadCount;
+	pthread_t threads[CHECK_MAX_THREADS];
+	MetricsExporter* exporter;
+};
+
+static CheckIds registerCheckMetrics() {
+	CheckIds ids;
+	ids.counter = registerCounter("check.records");
+	ids.histogram = registerHistogram("check.values", checkBounds, sizeof(checkBounds) / sizeof(checkBounds[0]));
+	ids.gauge = registerGauge("check.gauge");
+	return ids;
+}
+
+// value i % 40 spreads over every bucket, the overflow one included
+static void recordValues(const CheckIds* ids, int32_t count) {
+	for (int32_t i = 0; i < count; ++i) {
+		addCounter(ids->counter, 1);
+		recordHistogram(ids->histogram, static_cast<float>(i % 40));
+		setGauge(ids->gauge, static_cast<float>(i));
+	}
+}
+
+static void* runWriter(void* data) {
+	recordValues(&static_cast<CheckWriters*>(data)->ids, checkRecordsPerThread);
+	return NULL;
+}
+
+// Joins the writers, then stops the exporter, which sends the last snapshot and hangs up.
+static void* runWriters(void* data) {
+	CheckWriters* writers = static_cast<CheckWriters*>(data);
+	for (int32_t i = 0; i < writers->threadCount; ++i) {
+		pthread_create(&writers->threads[i], NULL, runWriter, writers);
+	}
+	for (int32_t i = 0; i < writers->threadCount; ++i) {
+		pthread_join(writers->threads[i], NULL);
+	}
+	stopMetricsExporter(writers->exporter);
+	return NULL;
+}
+
+static bool checkHistogram(const SnapshotMetric* metric, uint32_t expectedCount, uint32_t expectedSum) {
+	uint32_t total = 0;
+	for (int32_t b = 0; b < metric->bucketCount; ++b) {
+		total += metric->buckets[b];
+	}
+	bool ok = total == metric->value && metric->value == expectedCount && metric->sum == expectedSum;
+	if (!ok) {
+		printf("FAIL: %s has count %u, buckets summing to %u and sum %u; expected %u and %u\n", metric->name,
+			metric->value, total, metric->sum, expectedCount, expectedSum);
+	}
+	return ok;
+}
+
+static bool checkSocket(const CheckIds* ids, int32_t threadCount) {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/metrics_check_%d.sock", static_cast<int32_t>(getpid()));
+	static MetricsExporter exporter;
+	if (!startMetricsExporter(&exporter, path, METRICS_TARGET_SOCKET, METRICS_FORMAT_BINARY, 5000000)) {
+		printf("FAIL: could not start the exporter on %s\n", path);
+		return false;
+	}
+	int fd = connectMetrics(path);
+	if (fd < 0) {
+		printf("FAIL: could not connect to %s\n", path);
+		stopMetricsExporter(&exporter);
+		return false;
+	}
+
+	CheckWriters writers;
+	writers.ids = *ids;
+	writers.threadCount = threadCount;
+	writers.exporter = &exporter;
+	pthread_t controller;
+	int64_t start = nowNanoseconds();
+	pthread_create(&controller, NULL, runWriters, &writers);
+
+	static uint8_t buffer[METRICS_EXPORTER_BUFFER_SIZE];
+	static Snapshot snapshot;
+	bool ok = true;
+	bool malformed = false;
+	int32_t snapshots = 0;
+	uint32_t lastRecords = 0;
+	uint32_t lastValues = 0;
+	while (readSnapshot(fd, buffer, sizeof(buffer), &snapshot, &malformed)) {
+		++snapshots;
+		const SnapshotMetric* records = findMetric(&snapshot, "check.records");
+		const SnapshotMetric* values = findMetric(&snapshot, "check.values");
+		if (!records || !values) {
+			printf("FAIL: a snapshot is missing the check metrics\n");
+			ok = false;
+			break;
+		}
+		// differences modulo 2^32, as the header asks of readers
+		if (records->value - lastRecords > 0x80000000u || values->value - lastValues > 0x80000000u) {
+			printf("FAIL: a count went backwards, %u to %u\n", lastRecords, records->value);
+			ok = false;
+		}
+		lastRecords = records->value;
+		lastValues = values->value;
+	}
+	pthread_join(controller, NULL);
+	double seconds = (nowNanoseconds() - start) * 1e-9;
+	close(fd);
+	if (malformed) {
+		printf("FAIL: malformed snapshot\n");
+		ok = false;
+	}
+
+	// the last snapshot comes after every writer finished, so it must be exact
+	uint32_t expected = static_cast<uint32_t>(threadCount) * checkRecordsPerThread;
+	uint32_t sumPerPass = 0;
+	for (int32_t i = 0; i < 40; ++i) {
+		sumPerPass += i;
+	}
+	const SnapshotMetric* records = findMetric(&snapshot, "check.records");
+	const SnapshotMetric* values = findMetric(&snapshot, "check.values");
+	if (ok && records->value != expected) {
+		printf("FAIL: %u records counted, %u expected\n", records->value, expected);
+		ok = false;
+	}
+	if (ok) {
+		ok = checkHistogram(values, expected, static_cast<uint32_t>(threadCount) * (checkRecordsPerThread / 40) * sumPerPass);
+	}
+	printf("socket: %d writers, %d snapshots read in %.2f s, %u records; %u failures, %.0f us longest snapshot\n", threadCount,
+		snapshots, seconds, records ? records->value : 0, exporter.stats.failures, exporter.stats.maxSnapshotNanoseconds * 1e-3);
+	if (ok && (snapshots < 2 || exporter.stats.failures != 0)) {
+		printf("FAIL: %d snapshots and %u failures; expected several and none\n", snapshots, exporter.stats.failures);
+		ok = false;
+	}
+	return ok;
+}
+
+static bool checkJsonFile(const CheckIds* ids) {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/metrics_check_%d.json", static_cast<int32_t>(getpid()));
+	static MetricsExporter exporter;
+	if (!startMetricsExporter(&exporter, path, METRICS_TARGET_FILE, METRICS_FORMAT_JSON, 1000000000LL)) {
+		printf("FAIL: could not start the exporter on %s\n", path);
+		return false;
+	}
+	resetMetrics();
+	recordValues(ids, 1000);
+	stopMetricsExporter(&exporter);
+
+	char text[METRICS_EXPORTER_BUFFER_SIZE];
+	FILE* file = fopen(path, "rb");
+	size_t length = file ? fread(text, 1, sizeof(text) - 1, file) : 0;
+	if (file) {
+		fclose(file);
+	}
+	unlink(path);
+	text[length] = '\0';
+	bool ok = length > 0 && text[length - 1] == '\n' && strstr(text, "\"check.records\":1000") != NULL &&
+		strstr(text, "\"check.gauge\":999") != NULL && strstr(text, "\"check.values\":{\"count\":1000,") != NULL;
+	printf("json file: %u bytes%s\n", static_cast<uint32_t>(length), ok ? "" : ", unexpected contents:");
+	if (!ok) {
+		printf("%s\n", text);
+	}
+	return ok;
+}
+
+static void timeRecording(const CheckIds* ids) {
+	const int32_t count = 2000000;
+	int64_t start = nowNanoseconds();
+	for (int32_t i = 0; i < count; ++i) {
+		addCounter(ids->counter, 1);
+	}
+	int64_t counters = nowNanoseconds() - start;
+	start = nowNanoseconds();
+	for (int32_t i = 0; i < count; ++i) {
+		recordHistogram(ids->histogram, static_cast<float>(i % 40));
+	}
+	int64_t histograms = nowNanoseconds() - start;
+	printf("uncontended: %.1f ns per counter add, %.1f ns per histogram sample\n",
+		static_cast<double>(counters) / count, static_cast<double>(histograms) / count);
+}
+
+static int check(int32_t threadCount) {
+	// a second registration of a name returns the same id, and of another type none
+	CheckIds ids = registerCheckMetrics();
+	CheckIds again = registerCheckMetrics();
+	bool ok = ids.counter >= 0 && ids.histogram >= 0 && ids.gauge >= 0 && memcmp(&ids, &again, sizeof(CheckIds)) == 0;
+	ok = ok && registerGauge("check.records") == -1 && registerCounter("not a name") == -1;
+	if (!ok) {
+		printf("FAIL: registration\n");
+	}
+	ok = checkSocket(&ids, threadCount) && ok;
+	ok = checkJsonFile(&ids) && ok;
+	timeRecording(&ids);
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc >= 2 && strcmp(argv[1], "--check") == 0) {
+		int32_t threadCount = argc >= 3 ? atoi(argv[2]) : 4;
+		if (threadCount < 1 || threadCount > CHECK_MAX_THREADS) {
+			printf("Writer threads must be 1 to %d\n", CHECK_MAX_THREADS);
+			return 1;
+		}
+		return check(threadCount);
+	}
+	if (argc == 3 && strcmp(argv[1], "--file") == 0) {
+		return readFile(argv[2]);
+	}
+	if (argc == 2) {
+		return readSocket(argv[1]);
+	}
+	printf("Usage: metrics_reader SOCKET | --file FILE | --check [writer threads]\n");
+	return 1;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Stand-in for the NDK header. The host has no APK, so opening an asset always fails.
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AAssetManager AAssetManager;
+typedef struct AAsset AAsset;
+
+enum {
+	AASSET_MODE_UNKNOWN = 0,
+	AASSET_MODE_RANDOM = 1,
+	AASSET_MODE_STREAMING = 2,
+	AASSET_MODE_BUFFER = 3
+};
+
+AAsset* AAssetManager_open(AAssetManager* mgr, const char* filename, int mode);
+const void* AAsset_getBuffer(AAsset* asset);
+off_t AAsset_getLength(AAsset* asset);
+void AAsset_close(AAsset* asset);
+
+#ifdef __cplusplus
+}
+#endif
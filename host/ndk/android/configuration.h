@@ -0,0 +1,44 @@
+#pragma once
+
+// Stand-in for the NDK header, implemented by host/android_host.cpp with a fixed configuration.
+
+#include <android/asset_manager.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AConfiguration AConfiguration;
+
+enum {
+	ACONFIGURATION_ORIENTATION_ANY = 0,
+	ACONFIGURATION_ORIENTATION_PORT = 1,
+	ACONFIGURATION_ORIENTATION_LAND = 2
+};
+
+AConfiguration* AConfiguration_new(void);
+void AConfiguration_delete(AConfiguration* config);
+void AConfiguration_fromAssetManager(AConfiguration* out, AAssetManager* am);
+
+int32_t AConfiguration_getMcc(AConfiguration* config);
+int32_t AConfiguration_getMnc(AConfiguration* config);
+void AConfiguration_getLanguage(AConfiguration* config, char* outLanguage);
+void AConfiguration_getCountry(AConfiguration* config, char* outCountry);
+int32_t AConfiguration_getOrientation(AConfiguration* config);
+int32_t AConfiguration_getTouchscreen(AConfiguration* config);
+int32_t AConfiguration_getDensity(AConfiguration* config);
+int32_t AConfiguration_getKeyboard(AConfiguration* config);
+int32_t AConfiguration_getNavigation(AConfiguration* config);
+int32_t AConfiguration_getKeysHidden(AConfiguration* config);
+int32_t AConfiguration_getNavHidden(AConfiguration* config);
+int32_t AConfiguration_getSdkVersion(AConfiguration* config);
+int32_t AConfiguration_getScreenSize(AConfiguration* config);
+int32_t AConfiguration_getScreenLong(AConfiguration* config);
+int32_t AConfiguration_getUiModeType(AConfiguration* config);
+int32_t AConfiguration_getUiModeNight(AConfiguration* config);
+
+#ifdef __cplusplus
+}
+#endif
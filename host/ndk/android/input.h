@@ -0,0 +1,69 @@
+#pragma once
+
+// Stand-in for the NDK header, implemented by host/android_host.cpp.
+
+#include <android/keycodes.h>
+#include <android/looper.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AInputEvent AInputEvent;
+typedef struct AInputQueue AInputQueue;
+
+enum {
+	AINPUT_EVENT_TYPE_KEY = 1,
+	AINPUT_EVENT_TYPE_MOTION = 2
+};
+
+enum {
+	AKEY_EVENT_ACTION_DOWN = 0,
+	AKEY_EVENT_ACTION_UP = 1,
+	AKEY_EVENT_ACTION_MULTIPLE = 2
+};
+
+#define AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT 8
+
+enum {
+	AMOTION_EVENT_ACTION_MASK = 0xff,
+	AMOTION_EVENT_ACTION_POINTER_INDEX_MASK = 0xff00,
+	AMOTION_EVENT_ACTION_DOWN = 0,
+	AMOTION_EVENT_ACTION_UP = 1,
+	AMOTION_EVENT_ACTION_MOVE = 2,
+	AMOTION_EVENT_ACTION_CANCEL = 3,
+	AMOTION_EVENT_ACTION_OUTSIDE = 4,
+	AMOTION_EVENT_ACTION_POINTER_DOWN = 5,
+	AMOTION_EVENT_ACTION_POINTER_UP = 6
+};
+
+int32_t AInputEvent_getType(const AInputEvent* event);
+
+int32_t AKeyEvent_getAction(const AInputEvent* key_event);
+int32_t AKeyEvent_getKeyCode(const AInputEvent* key_event);
+int64_t AKeyEvent_getEventTime(const AInputEvent* key_event);
+
+int32_t AMotionEvent_getAction(const AInputEvent* motion_event);
+int64_t AMotionEvent_getEventTime(const AInputEvent* motion_event);
+size_t AMotionEvent_getPointerCount(const AInputEvent* motion_event);
+int32_t AMotionEvent_getPointerId(const AInputEvent* motion_event, size_t pointer_index);
+float AMotionEvent_getX(const AInputEvent* motion_event, size_t pointer_index);
+float AMotionEvent_getY(const AInputEvent* motion_event, size_t pointer_index);
+size_t AMotionEvent_getHistorySize(const AInputEvent* motion_event);
+int64_t AMotionEvent_getHistoricalEventTime(const AInputEvent* motion_event, size_t history_index);
+float AMotionEvent_getHistoricalX(const AInputEvent* motion_event, size_t pointer_index, size_t history_index);
+float AMotionEvent_getHistoricalY(const AInputEvent* motion_event, size_t pointer_index, size_t history_index);
+
+void AInputQueue_attachLooper(AInputQueue* queue, ALooper* looper, int ident, ALooper_callbackFunc callback, void* data);
+void AInputQueue_detachLooper(AInputQueue* queue);
+int32_t AInputQueue_hasEvents(AInputQueue* queue);
+int32_t AInputQueue_getEvent(AInputQueue* queue, AInputEvent** outEvent);
+int32_t AInputQueue_preDispatchEvent(AInputQueue* queue, AInputEvent* event);
+void AInputQueue_finishEvent(AInputQueue* queue, AInputEvent* event, int handled);
+
+#ifdef __cplusplus
+}
+#endif
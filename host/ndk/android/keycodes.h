@@ -0,0 +1,11 @@
+#pragma once
+
+// Stand-in for the NDK header: the key codes the app looks at.
+
+enum {
+	AKEYCODE_UNKNOWN = 0,
+	AKEYCODE_BACK = 4,
+	AKEYCODE_VOLUME_UP = 24,
+	AKEYCODE_VOLUME_DOWN = 25,
+	AKEYCODE_MENU = 82
+};
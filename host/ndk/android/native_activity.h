@@ -0,0 +1,66 @@
+#pragma once
+
+// Stand-in for the NDK header. host/android_host.cpp fills in an activity and calls the callbacks
+// the glue installs, as the framework would.
+
+#include <android/asset_manager.h>
+#include <android/input.h>
+#include <android/native_window.h>
+#include <jni.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ANativeActivityCallbacks;
+
+typedef struct ANativeActivity {
+	struct ANativeActivityCallbacks* callbacks;
+	JavaVM* vm;
+	JNIEnv* env;
+	jobject clazz;
+	const char* internalDataPath;
+	const char* externalDataPath;
+	int32_t sdkVersion;
+	void* instance;
+	AAssetManager* assetManager;
+	const char* obbPath;
+} ANativeActivity;
+
+typedef struct ARect {
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+} ARect;
+
+typedef struct ANativeActivityCallbacks {
+	void (*onStart)(ANativeActivity* activity);
+	void (*onResume)(ANativeActivity* activity);
+	void* (*onSaveInstanceState)(ANativeActivity* activity, size_t* outSize);
+	void (*onPause)(ANativeActivity* activity);
+	void (*onStop)(ANativeActivity* activity);
+	void (*onDestroy)(ANativeActivity* activity);
+	void (*onWindowFocusChanged)(ANativeActivity* activity, int hasFocus);
+	void (*onNativeWindowCreated)(ANativeActivity* activity, ANativeWindow* window);
+	void (*onNativeWindowResized)(ANativeActivity* activity, ANativeWindow* window);
+	void (*onNativeWindowRedrawNeeded)(ANativeActivity* activity, ANativeWindow* window);
+	void (*onNativeWindowDestroyed)(ANativeActivity* activity, ANativeWindow* window);
+	void (*onInputQueueCreated)(ANativeActivity* activity, AInputQueue* queue);
+	void (*onInputQueueDestroyed)(ANativeActivity* activity, AInputQueue* queue);
+	void (*onContentRectChanged)(ANativeActivity* activity, const ARect* rect);
+	void (*onConfigurationChanged)(ANativeActivity* activity);
+	void (*onLowMemory)(ANativeActivity* activity);
+} ANativeActivityCallbacks;
+
+typedef void ANativeActivity_createFunc(ANativeActivity* activity, void* savedState, size_t savedStateSize);
+extern ANativeActivity_createFunc ANativeActivity_onCreate;
+
+void ANativeActivity_finish(ANativeActivity* activity);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+// Stand-in for the NDK header, implemented by host/android_host.cpp.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ANativeWindow ANativeWindow;
+
+int32_t ANativeWindow_getWidth(ANativeWindow* window);
+int32_t ANativeWindow_getHeight(ANativeWindow* window);
+int32_t ANativeWindow_getFormat(ANativeWindow* window);
+int32_t ANativeWindow_setBuffersGeometry(ANativeWindow* window, int32_t width, int32_t height, int32_t format);
+
+#ifdef __cplusplus
+}
+#endif
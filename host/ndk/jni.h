@@ -0,0 +1,7 @@
+#pragma once
+
+// Stand-in for the NDK's jni.h: only what native_activity.h refers to. Nothing on the host calls into Java.
+
+typedef void* jobject;
+typedef struct _JNIEnv JNIEnv;
+typedef struct _JavaVM JavaVM;
@@ -0,0 +1,320 @@
+// Runs jni/occlusion_culler.cpp over a synthetic city, walking a camera down its streets, and
+// reports how much is culled and what it costs per frame, single threaded and on the worker pool.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o occlusion_bench host/occlusion_bench.cpp jni/occlusion_culler.cpp jni/worker_pool.cpp
+//                   memory_tracker.o -lpthread
+// Usage:        occlusion_bench [frames] [worker threads]
+//
+// The city is a grid of blocks, each with four buildings and a scatter of street furniture. The
+// buildings near the camera are the occluders and every building and prop is tested. Every 8th
+// frame is also checked against a culler at four times the resolution, read texel by texel: a box
+// the bench culler hides must be hidden there too, or the culling is not conservative.
+
+#include "../jni/occlusion_culler.h"
+#include "../jni/time_utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+const int32_t depthWidth = 256;
+const int32_t depthHeight = 144;
+const int32_t referenceScale = 4;
+const int32_t blocksPerSide = 40;
+const float blockSize = 40.0f;
+const float streetWidth = 12.0f;
+const int32_t propsPerBlock = 12;
+const float occluderRadius = 200.0f;
+const int32_t maxOccluders = 256;
+
+// unit cube, counter-clockwise from outside; vertex i is at (i & 1, i >> 1 & 1, i >> 2 & 1)
+static const float cubePositions[] = {
+	0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,
+	0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1
+};
+static const uint16_t cubeIndices[] = {
+	0, 4, 6,  0, 6, 2,  1, 3, 7,  1, 7, 5,
+	0, 1, 5,  0, 5, 4,  2, 6, 7,  2, 7, 3,
+	0, 2, 3,  0, 3, 1,  4, 5, 7,  4, 7, 6
+};
+
+struct City {
+	std::vector<Bounds3D> objects;
+	int32_t buildingCount; // the first objects
+};
+
+static uint32_t seed = 12345;
+
+static float nextRandom() {
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static void buildCity(City* city) {
+	float lot = (blockSize - streetWidth) * 0.5f;
+	for (int32_t bz = 0; bz < blocksPerSide; ++bz) {
+		for (int32_t bx = 0; bx < blocksPerSide; ++bx) {
+			float x0 = bx * blockSize + streetWidth * 0.5f, z0 = bz * blockSize + streetWidth * 0.5f;
+			for (int32_t i = 0; i < 4; ++i) {
+				float lx = x0 + (i & 1) * lot, lz = z0 + (i >> 1) * lot;
+				float inset = 0.5f + nextRandom() * 2.0f;
+				Bounds3D b = { lx + inset, 0.0f, lz + inset, lx + lot - inset, 8.0f + nextRandom() * nextRandom() * 60.0f, lz + lot - inset };
+				city->objects.push_back(b);
+			}
+		}
+	}
+	city->buildingCount = static_cast<int32_t>(city->objects.size());
+	for (int32_t bz = 0; bz < blocksPerSide; ++bz) {
+		for (int32_t bx = 0; bx < blocksPerSide; ++bx) {
+			for (int32_t i = 0; i < propsPerBlock; ++i) {
+				// cars, lamps and benches along the streets, the odd one on a roof
+				float along = nextRandom() * blockSize;
+				float across = (nextRandom() - 0.5f) * streetWidth;
+				float x = i & 1 ? bx * blockSize + along : bx * blockSize + across;
+				float z = i & 1 ? bz * blockSize + across : bz * blockSize + along;
+				float size = 0.5f + nextRandom() * 2.0f;
+				float height = i % 5 == 4 ? 40.0f * nextRandom() : 0.0f;
+				Bounds3D b = { x, height, z, x + size, height + 0.5f + nextRandom() * 2.0f, z + size };
+				city->objects.push_back(b);
+			}
+		}
+	}
+}
+
+static void multiply(float* out, const float* a, const float* b) {
+	float result[16];
+	for (int32_t column = 0; column < 4; ++column) {
+		for (int32_t row = 0; row < 4; ++row) {
+			result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+				a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+		}
+	}
+	memcpy(out, result, sizeof(result));
+}
+
+static void perspective(float* m, float fovY, float aspect, float nearZ, float farZ) {
+	float f = 1.0f / tanf(fovY * 0.5f);
+	memset(m, 0, 16 * sizeof(float));
+	m[0] = f / aspect;
+	m[5] = f;
+	m[10] = (farZ + nearZ) / (nearZ - farZ);
+	m[11] = -1.0f;
+	m[14] = 2.0f * farZ * nearZ / (nearZ - farZ);
+}
+
+static void lookAt(float* m, const float* eye, const float* forward) {
+	// right = forward x up, with y up and forward level
+	float right[3] = { -forward[2], 0.0f, forward[0] };
+	float length = sqrtf(right[0] * right[0] + right[2] * right[2]);
+	right[0] /= length;
+	right[2] /= length;
+	float up[3] = { right[1] * forward[2] - right[2] * forward[1], right[2] * forward[0] - right[0] * forward[2], right[0] * forward[1] - right[1] * forward[0] };
+	const float rows[3][3] = { { right[0], right[1], right[2] }, { up[0], up[1], up[2] }, { -forward[0], -forward[1], -forward[2] } };
+	memset(m, 0, 16 * sizeof(float));
+	for (int32_t r = 0; r < 3; ++r) {
+		for (int32_t c = 0; c < 3; ++c) {
+			m[c * 4 + r] = rows[r][c];
+		}
+		m[12 + r] = -(rows[r][0] * eye[0] + rows[r][1] * eye[1] + rows[r][2] * eye[2]);
+	}
+	m[15] = 1.0f;
+}
+
+// Down the middle of a street at eye height, looking along it with a slow sweep to the sides.
+static void cameraAt(int32_t frame, int32_t frames, float* eye, float* forward) {
+	float t = static_cast<float>(frame) / frames;
+	eye[0] = blockSize * (2.0f + t * (blocksPerSide - 6));
+	eye[1] = 1.8f + 6.0f * (frame / 60 % 2);
+	eye[2] = blockSize * (blocksPerSide / 2);
+	float yaw = 0.7f * sinf(t * 12.0f);
+	forward[0] = cosf(yaw);
+	forward[1] = -0.05f;
+	forward[2] = sinf(yaw);
+}
+
+static void addOccluders(OcclusionCuller* culler, const City* city, const float* eye, const float* forward) {
+	const OccluderMesh cube = { cubePositions, 8, cubeIndices, 12 };
+	for (int32_t i = 0; i < city->buildingCount; ++i) {
+		const Bounds3D* b = &city->objects[i];
+		float dx = (b->minX + b->maxX) * 0.5f - eye[0], dz = (b->minZ + b->maxZ) * 0.5f - eye[2];
+		float distance = sqrtf(dx * dx + dz * dz);
+		if (distance > occluderRadius || dx * forward[0] + dz * forward[2] < -blockSize) {
+			continue;
+		}
+		float model[16] = {
+			b->maxX - b->minX, 0, 0, 0,
+			0, b->maxY - b->minY, 0, 0,
+			0, 0, b->maxZ - b->minZ, 0,
+			b->minX, b->minY, b->minZ, 1
+		};
+		if (!addOccluder(culler, &cube, model)) {
+			break;
+		}
+	}
+}
+
+// Whether any level 0 texel under the box is at least as far as its nearest point; only called for
+// boxes the reference culler has already found inside the frustum and in front of the near plane.
+static bool referenceVisible(const OcclusionCuller* culler, const Bounds3D* b) {
+	const float* m = culler->viewProjection;
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minDepth = 1e30f;
+	for (int32_t corner = 0; corner < 8; ++corner) {
+		float p[3] = { corner & 1 ? b->maxX : b->minX, corner & 2 ? b->maxY : b->minY, corner & 4 ? b->maxZ : b->minZ };
+		float x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+		float y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+		float z = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+		float w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+		minX = fminf(minX, x / w);
+		maxX = fmaxf(maxX, x / w);
+		minY = fminf(minY, y / w);
+		maxY = fmaxf(maxY, y / w);
+		minDepth = fminf(minDepth, z / w);
+	}
+	int32_t x0 = std::max(static_cast<int32_t>((minX * 0.5f + 0.5f) * culler->width), 0);
+	int32_t x1 = std::min(static_cast<int32_t>((maxX * 0.5f + 0.5f) * culler->width), culler->width - 1);
+	int32_t y0 = std::max(static_cast<int32_t>((minY * 0.5f + 0.5f) * culler->height), 0);
+	int32_t y1 = std::min(static_cast<int32_t>((maxY * 0.5f + 0.5f) * culler->height), culler->height - 1);
+	minDepth = minDepth * 0.5f + 0.5f;
+	for (int32_t y = y0; y <= y1; ++y) {
+		for (int32_t x = x0; x <= x1; ++x) {
+			if (minDepth <= culler->levels[0][y * culler->width + x]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+struct RunResult {
+	double culled; // fractions of all tested objects
+	double occluded;
+	double outside;
+	double occluders;
+	double triangles;
+	std::vector<double> milliseconds;
+	double rasterizeMilliseconds;
+	double testMilliseconds;
+	int64_t checked;
+	int64_t referenceOccluded;
+	int64_t violations;
+};
+
+static void runCity(const City* city, int32_t frames, WorkerPool* workers, RunResult* result) {
+	OcclusionCuller culler, reference;
+	if (!initOcclusionCuller(&culler, depthWidth, depthHeight, maxOccluders, maxOccluders * 12, workers) ||
+		!initOcclusionCuller(&reference, depthWidth * referenceScale, depthHeight * referenceScale, maxOccluders, maxOccluders * 12, workers)) {
+		fprintf(stderr, "Could not create the occlusion culler\n");
+		exit(1);
+	}
+	int32_t count = static_cast<int32_t>(city->objects.size());
+	std::vector<uint8_t> results(count), referenceResults(count);
+	float projection[16];
+	perspective(projection, 1.0f, static_cast<float>(depthWidth) / depthHeight, 0.5f, 1000.0f);
+
+	result->culled = result->occluded = result->outside = result->occluders = result->triangles = 0.0;
+	result->rasterizeMilliseconds = result->testMilliseconds = 0.0;
+	result->checked = result->referenceOccluded = result->violations = 0;
+	result->milliseconds.clear();
+	for (int32_t frame = 0; frame < frames; ++frame) {
+		float eye[3], forward[3], view[16], viewProjection[16];
+		cameraAt(frame, frames, eye, forward);
+		lookAt(view, eye, forward);
+		multiply(viewProjection, projection, view);
+
+		beginOcclusionFrame(&culler, viewProjection);
+		addOccluders(&culler, city, eye, forward);
+		rasterizeOccluders(&culler);
+		testOcclusion(&culler, city->objects.data(), count, results.data());
+
+		const OcclusionStats* stats = &culler.stats;
+		result->occluded += static_cast<double>(stats->occluded) / count;
+		result->outside += static_cast<double>(stats->outside) / count;
+		result->occluders += culler.occluderCount;
+		result->triangles += stats->rasterizedTriangles;
+		result->rasterizeMilliseconds += stats->rasterizeNanoseconds * 1e-6;
+		result->testMilliseconds += stats->testNanoseconds * 1e-6;
+		result->milliseconds.push_back((stats->rasterizeNanoseconds + stats->testNanoseconds) * 1e-6);
+
+		if (frame % 8 == 0) {
+			beginOcclusionFrame(&reference, viewProjection);
+			addOccluders(&reference, city, eye, forward);
+			rasterizeOccluders(&reference);
+			testOcclusion(&reference, city->objects.data(), count, referenceResults.data());
+			for (int32_t i = 0; i < count; ++i) {
+				if (referenceResults[i] == OCCLUSION_OUTSIDE) {
+					continue;
+				}
+				bool visible = referenceVisible(&reference, &city->objects[i]);
+				++result->checked;
+				result->referenceOccluded += !visible;
+				result->violations += visible && results[i] == OCCLUSION_OCCLUDED;
+			}
+		}
+	}
+	result->occluded /= frames;
+	result->outside /= frames;
+	result->culled = result->occluded + result->outside;
+	result->occluders /= frames;
+	result->triangles /= frames;
+	result->rasterizeMilliseconds /= frames;
+	result->testMilliseconds /= frames;
+
+	termOcclusionCuller(&reference);
+	termOcclusionCuller(&culler);
+}
+
+static void printResult(const char* name, RunResult* result) {
+	std::vector<double>* ms = &result->milliseconds;
+	std::sort(ms->begin(), ms->end());
+	double total = 0.0;
+	for (size_t i = 0; i < ms->size(); ++i) {
+		total += (*ms)[i];
+	}
+	printf("%-10s %7.1f%% %9.1f%% %8.1f%% %9.0f %9.0f %9.3f %8.3f %8.3f %8.3f\n", name,
+		result->culled * 100.0, result->outside * 100.0, result->occluded * 100.0, result->occluders, result->triangles,
+		result->rasterizeMilliseconds, result->testMilliseconds, total / ms->size(), (*ms)[ms->size() * 95 / 100]);
+}
+
+int main(int argc, char** argv) {
+	int32_t frames = argc > 1 ? atoi(argv[1]) : 480;
+	int32_t threads = argc > 2 ? atoi(argv[2]) : defaultWorkerThreadCount();
+	if (frames < 1 || threads < 0) {
+		printf("Usage: %s [frames] [worker threads]\n", argv[0]);
+		return 1;
+	}
+	City city;
+	buildCity(&city);
+	printf("%d objects (%d buildings), %dx%d depth, %d frames\n\n", static_cast<int32_t>(city.objects.size()),
+		city.buildingCount, depthWidth, depthHeight, frames);
+	printf("%-10s %8s %10s %9s %9s %9s %9s %8s %8s %8s\n", "threads", "culled", "frustum", "occluded",
+		"occluders", "triangles", "raster ms", "test ms", "frame ms", "p95 ms");
+
+	bool failed = false;
+	int32_t threadCounts[] = { 0, threads };
+	int32_t runs = threads > 0 ? 2 : 1;
+	for (int32_t i = 0; i < runs; ++i) {
+		WorkerPool pool;
+		if (!initWorkerPool(&pool, threadCounts[i])) {
+			fprintf(stderr, "Could not start the worker pool\n");
+			return 1;
+		}
+		RunResult result;
+		runCity(&city, frames, &pool, &result);
+		char name[32];
+		snprintf(name, sizeof(name), "1 + %d", threadCounts[i]);
+		printResult(name, &result);
+		if (i == runs - 1) {
+			printf("\n%lld boxes checked at %dx%d: %.1f%% hidden there, %lld hidden here but not there\n",
+				static_cast<long long>(result.checked), depthWidth * referenceScale, depthHeight * referenceScale,
+				100.0 * result.referenceOccluded / result.checked, static_cast<long long>(result.violations));
+		}
+		failed = failed || result.violations > 0;
+		termWorkerPool(&pool);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+// Times updateParticles in jni/particles.cpp on the host, on the calling thread and split across
+// the worker pool, for a population that lives through the run and for one where bursts die and
+// are respawned every frame, and reports particles per second. Checks that compaction keeps only
+// live particles and that a whole population is gone once its lifetime has passed.
+//
+// Build with:   cc -O2 -c jni/shader_utils.c jni/memory_tracker.c
+//               c++ -O2 -o particles_bench host/particles_bench.cpp jni/particles.cpp jni/worker_pool.cpp
+//                   jni/stream_buffer.cpp jni/gpu_fence.cpp jni/gl_extensions.cpp shader_utils.o memory_tracker.o
+//                   -lGLESv2 -lEGL -lpthread
+// Usage:        particles_bench [particles] [frames]
+//
+// No GL calls are made; the GL and EGL libraries are only needed to link drawParticles.
+
+#include "../jni/memory_tracker.h"
+#include "../jni/particles.h"
+#include "../jni/worker_pool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const float dt = 1.0f / 60.0f;
+const int32_t burstSize = 16;
+
+static bool checkParticles(const Particles* particles) {
+	for (int32_t i = 0; i < particles->count; ++i) {
+		if (!(particles->age[i] < 1.0f) || !isfinite(particles->x[i]) || !isfinite(particles->y[i]) ||
+			fabsf(particles->vertices[i].life - (1.0f - particles->age[i])) > 1e-6f) {
+			printf("FAIL: particle %d is dead or broken after compaction\n", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+// lifetime 0 keeps the population alive for the whole run; otherwise a lifetime's worth of bursts
+// is spawned up front and the dead are replaced every frame
+static bool run(int32_t count, int32_t frames, WorkerPool* workers, float lifetime) {
+	Particles particles;
+	if (!initParticles(&particles, count, workers)) {
+		printf("FAIL: could not allocate %d particles\n", count);
+		return false;
+	}
+	for (int32_t i = 0; i < count; i += burstSize) {
+		spawnParticles(&particles, 640.0f, 360.0f, burstSize, 300.0f, lifetime > 0.0f ? lifetime : 1e6f);
+	}
+	// warm up the caches and the workers
+	updateParticles(&particles, dt);
+	particles.updatedParticles = 0;
+	particles.updateNanoseconds = 0;
+
+	int64_t worst = 0;
+	for (int32_t frame = 0; frame < frames; ++frame) {
+		if (lifetime > 0.0f) {
+			spawnParticles(&particles, 640.0f, 360.0f, particles.capacity - particles.count, 300.0f, lifetime);
+		}
+		updateParticles(&particles, dt);
+		worst = particles.lastUpdateNanoseconds > worst ? particles.lastUpdateNanoseconds : worst;
+	}
+	bool ok = checkParticles(&particles);
+	printf("  %-9s %-9s %6d live, %7.3f ms per frame (worst %7.3f), %6.1f M particles/s\n", workers ? "workers" : "one thread",
+		lifetime > 0.0f ? "respawn" : "steady", particles.count, particles.updateNanoseconds * 1e-6 / frames, worst * 1e-6,
+		particles.updatedParticles * 1e3 / particles.updateNanoseconds);
+
+	if (lifetime > 0.0f) {
+		// the longest lifetime is 1.25 times the nominal one
+		for (int32_t frame = 0; frame * dt < lifetime * 1.25f + dt; ++frame) {
+			updateParticles(&particles, dt);
+		}
+		if (particles.count != 0) {
+			printf("FAIL: %d particles outlived their lifetime\n", particles.count);
+			ok = false;
+		}
+	}
+	termParticles(&particles);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	int32_t count = argc >= 2 ? atoi(argv[1]) : 100000;
+	int32_t frames = argc >= 3 ? atoi(argv[2]) : 1000;
+	if (count <= 0 || frames <= 0) {
+		printf("Usage: particles_bench [particles] [frames]\n");
+		return 1;
+	}
+	WorkerPool workers;
+	if (!initWorkerPool(&workers, defaultWorkerThreadCount())) {
+		printf("FAIL: could not start the worker pool\n");
+		return 1;
+	}
+	printf("%d particles, %d frames, %d worker threads:\n", count, frames, workers.threadCount);
+	bool ok = run(count, frames, NULL, 0.0f);
+	ok = run(count, frames, &workers, 0.0f) && ok;
+	ok = run(count, frames, NULL, 0.5f) && ok;
+	ok = run(count, frames, &workers, 0.5f) && ok;
+	termWorkerPool(&workers);
+
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	if (MEMORY_TRACKING && snapshot.heap[MEMORY_TAG_PARTICLES].liveAllocations != 0) {
+		printf("FAIL: particle arrays leaked\n");
+		ok = false;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// Reports what jni/post_process.cpp costs per frame for the app's effect chain with each combination of
+// effects on, at common resolutions: passes, pixels shaded and transient target memory, against one
+// full resolution pass per effect. With --shader it prints the fused composite shader instead.
+//
+// Build with:   cc -O2 -c jni/shader_utils.c jni/memory_tracker.c
+//               c++ -O2 -o post_process_report host/post_process_report.cpp jni/post_process.cpp jni/render_graph.cpp
+//                   shader_utils.o memory_tracker.o -lGLESv2 -lpthread
+// Usage:        post_process_report [--quarter]
+//               post_process_report --shader <effect mask>
+//
+// Only the graph is built and compiled; no GL calls are made, the library is only needed to link.
+
+#include "../jni/post_process.h"
+#include "../jni/render_graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the chain main.cpp uses, with every effect on
+static const PostEffect chain[] = {
+	{ POST_EFFECT_BLOOM, 0.6f, { 0.6f, 2.0f } },
+	{ POST_EFFECT_COLOR_GRADE, 1.0f, { 1.2f, 1.1f } },
+	{ POST_EFFECT_VIGNETTE, 0.35f, { 0.6f, 1.5f } }
+};
+const int32_t chainLength = sizeof(chain) / sizeof(chain[0]);
+
+struct Resolution {
+	int32_t width;
+	int32_t height;
+};
+
+static void report(PostProcess* post, RenderGraph* graph, uint32_t mask, const Resolution* resolution) {
+	for (int32_t i = 0; i < chainLength; ++i) {
+		setPostEffectStrength(post, chain[i].type, (mask & (1u << chain[i].type)) ? chain[i].strength : 0.0f);
+	}
+	resetRenderGraph(graph);
+	int32_t backbuffer = importRenderResource(graph, "backbuffer", resolution->width, resolution->height);
+	int32_t output = backbuffer;
+	if (activePostEffects(post)) {
+		RenderTargetDesc desc = { resolution->width, resolution->height, RENDER_TARGET_RGBA8 };
+		output = createRenderResource(graph, "sceneColor", &desc);
+	}
+	int32_t pass = addRenderPass(graph, "scene", NULL, NULL);
+	setRenderPassColor(graph, pass, output, RENDER_CLEAR, 0.0f, 0.0f, 0.0f, 1.0f);
+	PostProcessStats stats;
+	memset(&stats, 0, sizeof(stats));
+	if (activePostEffects(post)) {
+		addPostProcessPasses(post, graph, output, backbuffer, resolution->width, resolution->height);
+		stats = post->stats;
+	}
+	if (!compileRenderGraph(graph)) {
+		printf("could not compile the graph\n");
+		exit(1);
+	}
+	printf("%5dx%-5d %c%c%c  %d passes %6.2f Mpixels  unfused %d passes %6.2f Mpixels  targets %5.2f MB\n",
+		resolution->width, resolution->height, (mask & 1) ? 'B' : '-', (mask & 2) ? 'G' : '-', (mask & 4) ? 'V' : '-',
+		stats.passes, stats.pixels * 1e-6, stats.unfusedPasses, stats.unfusedPixels * 1e-6, graph->stats.targetBytes / (1024.0 * 1024.0));
+}
+
+int main(int argc, char** argv) {
+	PostEffect effects[chainLength];
+	memcpy(effects, chain, sizeof(chain));
+	bool quarter = argc > 1 && strcmp(argv[1], "--quarter") == 0;
+	if (quarter) {
+		effects[0].parameters[1] = 4.0f;
+	}
+	static PostProcess post;
+	if (!initPostProcess(&post, effects, chainLength)) {
+		return 1;
+	}
+
+	if (argc > 2 && strcmp(argv[1], "--shader") == 0) {
+		char source[2048];
+		if (!generatePostShader(&post, strtoul(argv[2], NULL, 0), source, sizeof(source))) {
+			return 1;
+		}
+		fputs(source, stdout);
+		return 0;
+	}
+
+	static RenderGraph graph;
+	initRenderGraph(&graph, NULL);
+	const Resolution resolutions[] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+	printf("bloom at 1/%d resolution; B bloom, G colour grade, V vignette\n", quarter ? 4 : 2);
+	for (size_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); ++r) {
+		for (uint32_t mask = 0; mask < 8; ++mask) {
+			report(&post, &graph, mask, &resolutions[r]);
+		}
+	}
+	return 0;
+}
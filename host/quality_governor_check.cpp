@@ -0,0 +1,235 @@
+// Drives jni/quality_governor.cpp with synthetic thermal and frame time traces on the host, prints
+// the transitions and time per tier for each and fails if a tier is not where the policy should have
+// put it, or if the governor changes tier more often than the hysteresis allows.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o quality_governor_check host/quality_governor_check.cpp jni/quality_governor.cpp
+//                   jni/thermal_provider.cpp memory_tracker.o -ldl -lpthread
+// Usage:        quality_governor_check [--verbose]
+//
+// Time is simulated: each frame's interval is its cost rounded up to whole vsyncs, and the cost
+// shrinks with the tier's render scale and the effects it drops. The last scenario goes through the
+// file stand-in for the thermal service.
+
+#include "../jni/quality_governor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHECK_MAX_POINTS 4
+
+const int64_t second = 1000000000LL;
+
+// the ladder main.cpp uses, with bit 0 standing for bloom
+static const QualityTier tiers[] = {
+	{ "high", 1.0f, 7, 1, THERMAL_STATUS_LIGHT },
+	{ "medium", 0.75f, 7, 1, THERMAL_STATUS_MODERATE },
+	{ "low", 0.5f, 6, 1, THERMAL_STATUS_SEVERE },
+	{ "minimum", 0.5f, 0, 2, THERMAL_STATUS_SHUTDOWN }
+};
+const int32_t tierCount = sizeof(tiers) / sizeof(tiers[0]);
+
+struct CheckPoint {
+	double seconds;
+	int32_t tier;
+};
+
+struct Scenario {
+	const char* name;
+	double seconds;
+	// frame cost in milliseconds: fixed, plus pixels at full scale, plus bloom when it runs
+	float fixedMilliseconds;
+	float pixelMilliseconds;
+	float bloomMilliseconds;
+	ThermalSample (*thermal)(double seconds); // NULL for no provider
+	CheckPoint points[CHECK_MAX_POINTS];
+	int32_t pointCount;
+	int32_t maxTransitions;
+	double maxHighShare; // of the time, at tier 0
+};
+
+struct TraceThermal {
+	ThermalSample (*trace)(double seconds);
+	int64_t now;
+};
+
+static bool readTrace(void* context, ThermalSample* sample) {
+	TraceThermal* trace = static_cast<TraceThermal*>(context);
+	*sample = trace->trace(trace->now * 1e-9);
+	return true;
+}
+
+static ThermalSample sample(ThermalStatus status, float headroom) {
+	ThermalSample s = { status, headroom };
+	return s;
+}
+
+static ThermalSample coolTrace(double) {
+	return sample(THERMAL_STATUS_NONE, 0.4f);
+}
+
+static ThermalSample rampTrace(double seconds) {
+	if (seconds < 60.0) {
+		return sample(THERMAL_STATUS_NONE, -1.0f);
+	}
+	if (seconds < 120.0) {
+		return sample(THERMAL_STATUS_MODERATE, -1.0f);
+	}
+	if (seconds < 180.0) {
+		return sample(THERMAL_STATUS_SEVERE, -1.0f);
+	}
+	return sample(THERMAL_STATUS_NONE, -1.0f);
+}
+
+static ThermalSample flickerTrace(double seconds) {
+	return sample(static_cast<int64_t>(seconds / 3.0) % 2 ? THERMAL_STATUS_MODERATE : THERMAL_STATUS_LIGHT, -1.0f);
+}
+
+static ThermalSample headroomTrace(double seconds) {
+	float headroom = 0.5f + 0.55f * static_cast<float>(seconds < 100.0 ? seconds / 100.0 : 1.0);
+	return sample(THERMAL_STATUS_NONE, headroom);
+}
+
+static const Scenario scenarios[] = {
+	{ "cool, light scene", 300.0, 3.0f, 6.0f, 1.0f, coolTrace,
+		{ { 299.0, 0 } }, 1, 0, 1.0 },
+	{ "cool, heavy scene", 600.0, 3.0f, 16.0f, 3.0f, coolTrace,
+		{ { 30.0, 1 }, { 599.0, 1 } }, 2, 20, 0.05 },
+	{ "thermal ramp", 300.0, 3.0f, 6.0f, 1.0f, rampTrace,
+		{ { 65.0, 1 }, { 125.0, 2 }, { 205.0, 2 }, { 299.0, 0 } }, 4, 4, 1.0 },
+	{ "flickering status", 300.0, 3.0f, 6.0f, 1.0f, flickerTrace,
+		{ { 10.0, 1 }, { 299.0, 1 } }, 2, 1, 1.0 },
+	{ "headroom forecast", 150.0, 3.0f, 6.0f, 1.0f, headroomTrace,
+		{ { 60.0, 0 }, { 70.0, 1 }, { 95.0, 2 } }, 3, 2, 1.0 },
+	{ "no thermal service, heavy scene", 300.0, 3.0f, 16.0f, 3.0f, NULL,
+		{ { 30.0, 1 } }, 1, 20, 0.05 }
+};
+const int32_t scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+
+static int64_t frameInterval(const QualityGovernor* governor, const Scenario* scenario) {
+	const QualityTier* tier = currentQualityTier(governor);
+	float milliseconds = scenario->fixedMilliseconds + scenario->pixelMilliseconds * tier->renderScale * tier->renderScale;
+	if (tier->postEffects & 1) {
+		milliseconds += scenario->bloomMilliseconds;
+	}
+	int64_t refresh = governor->config.refreshNanoseconds;
+	int64_t vsyncs = static_cast<int64_t>(ceil(milliseconds * 1e6 / refresh));
+	return (vsyncs > tier->swapInterval ? vsyncs : tier->swapInterval) * refresh;
+}
+
+static void printTimes(const QualityGovernor* governor, double seconds) {
+	printf("  %d transitions, %d failed step ups; time per tier:", governor->stats.transitions, governor->stats.failedUpgrades);
+	for (int32_t i = 0; i < governor->tierCount; ++i) {
+		printf(" %s %.1f%%", governor->tiers[i].name, 100.0 * governor->stats.tierNanoseconds[i] * 1e-9 / seconds);
+	}
+	printf("\n");
+}
+
+// Runs frames until the simulated clock reaches end, checking points on the way.
+static bool runFrames(QualityGovernor* governor, const Scenario* scenario, TraceThermal* trace, int64_t start, int64_t end) {
+	bool ok = true;
+	int32_t point = 0;
+	int64_t now = start;
+	while (now < end) {
+		int64_t interval = frameInterval(governor, scenario);
+		now += interval;
+		if (trace) {
+			trace->now = now - start;
+		}
+		updateQualityGovernor(governor, now, interval);
+		while (point < scenario->pointCount && now - start >= scenario->points[point].seconds * second) {
+			const CheckPoint* expected = &scenario->points[point++];
+			if (governor->tier != expected->tier) {
+				printf("FAIL: at %.0f s the tier is %s, expected %s\n", expected->seconds,
+					currentQualityTier(governor)->name, tiers[expected->tier].name);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+static bool checkScenario(const Scenario* scenario) {
+	TraceThermal trace = { scenario->thermal, 0 };
+	ThermalProvider provider = { &trace, readTrace };
+	QualityGovernor governor;
+	initQualityGovernor(&governor, tiers, tierCount, &defaultQualityGovernorConfig, scenario->thermal ? &provider : NULL);
+
+	printf("%s:\n", scenario->name);
+	bool ok = runFrames(&governor, scenario, scenario->thermal ? &trace : NULL, second, second + static_cast<int64_t>(scenario->seconds * second));
+	printTimes(&governor, scenario->seconds);
+	if (governor.stats.transitions > scenario->maxTransitions) {
+		printf("FAIL: %d transitions, at most %d expected\n", governor.stats.transitions, scenario->maxTransitions);
+		ok = false;
+	}
+	double highShare = governor.stats.tierNanoseconds[0] * 1e-9 / scenario->seconds;
+	if (highShare > scenario->maxHighShare) {
+		printf("FAIL: %.1f%% of the time at %s, at most %.1f%% expected\n", highShare * 100.0, tiers[0].name, scenario->maxHighShare * 100.0);
+		ok = false;
+	}
+	return ok;
+}
+
+static bool writeStatus(const char* path, const char* text) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		printf("FAIL: could not write %s\n", path);
+		return false;
+	}
+	fputs(text, file);
+	fclose(file);
+	return true;
+}
+
+// The same governor reading the stand-in file: severe for a while, then cool again.
+static bool checkFileProvider() {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/thermal_status_%d", static_cast<int32_t>(getpid()));
+	printf("stand-in file:\n");
+	ThermalProvider provider;
+	FileThermalContext context;
+	if (initFileThermalProvider(&provider, &context, path)) {
+		printf("FAIL: a missing file was accepted\n");
+		return false;
+	}
+	if (!writeStatus(path, "3 0.7\n") || !initFileThermalProvider(&provider, &context, path)) {
+		printf("FAIL: could not read %s\n", path);
+		unlink(path);
+		return false;
+	}
+	QualityGovernor governor;
+	initQualityGovernor(&governor, tiers, tierCount, &defaultQualityGovernorConfig, &provider);
+	Scenario hot = { "", 20.0, 3.0f, 6.0f, 1.0f, NULL, { { 2.0, 2 }, { 19.0, 2 } }, 2, 0, 0.0 };
+	Scenario cool = { "", 60.0, 3.0f, 6.0f, 1.0f, NULL, { { 20.0, 2 }, { 59.0, 0 } }, 2, 0, 0.0 };
+	bool ok = runFrames(&governor, &hot, NULL, second, 21 * second);
+	ok = writeStatus(path, "0\n") && ok;
+	ok = runFrames(&governor, &cool, NULL, 21 * second, 81 * second) && ok;
+	printTimes(&governor, 80.0);
+	if (governor.lastSample.status != THERMAL_STATUS_NONE || governor.lastSample.headroom >= 0.0f) {
+		printf("FAIL: last sample %s, headroom %.2f; expected none without headroom\n",
+			thermalStatusName(governor.lastSample.status), governor.lastSample.headroom);
+		ok = false;
+	}
+	unlink(path);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	// the governor logs every transition; keep the output to the summaries unless asked
+	if (argc < 2 || strcmp(argv[1], "--verbose") != 0) {
+		fflush(stderr);
+		if (!freopen("/dev/null", "w", stderr)) {
+			return 1;
+		}
+	}
+	bool ok = true;
+	for (int32_t i = 0; i < scenarioCount; ++i) {
+		ok = checkScenario(&scenarios[i]) && ok;
+	}
+	ok = checkFileProvider() && ok;
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Compiles a few representative frame graphs with jni/render_graph.cpp on the host, prints the plan
+// for each and fails if compiling is not deterministic or aliasing lets two live resources share a target.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o render_graph_check host/render_graph_check.cpp jni/render_graph.cpp memory_tracker.o -lGLESv2 -lpthread
+// Usage:        render_graph_check
+//
+// Only compileRenderGraph runs; no GL calls are made, the library is only needed to link.
+
+#include "../jni/render_graph.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const int32_t width = 1280;
+const int32_t height = 720;
+
+typedef void (*BuildGraphFunction)(RenderGraph* graph);
+
+// scene with depth, a bloom chain at half and quarter resolution, and a debug view nothing reads
+static void buildPostProcessGraph(RenderGraph* graph) {
+	const RenderTargetDesc sceneColorDesc = { width, height, RENDER_TARGET_RGBA8 };
+	const RenderTargetDesc depthDesc = { width, height, RENDER_TARGET_DEPTH16 };
+	const RenderTargetDesc halfDesc = { width / 2, height / 2, RENDER_TARGET_RGBA8 };
+	const RenderTargetDesc quarterDesc = { width / 4, height / 4, RENDER_TARGET_RGBA8 };
+
+	int32_t backbuffer = importRenderResource(graph, "backbuffer", width, height);
+	int32_t sceneColor = createRenderResource(graph, "sceneColor", &sceneColorDesc);
+	int32_t sceneDepth = createRenderResource(graph, "sceneDepth", &depthDesc);
+	int32_t bright = createRenderResource(graph, "bright", &halfDesc);
+	int32_t blurQuarter = createRenderResource(graph, "blurQuarter", &quarterDesc);
+	int32_t blurHalf = createRenderResource(graph, "blurHalf", &halfDesc);
+	int32_t debug = createRenderResource(graph, "debug", &halfDesc);
+
+	int32_t pass = addRenderPass(graph, "scene", NULL, NULL);
+	setRenderPassColor(graph, pass, sceneColor, RENDER_CLEAR, 0.0f, 0.0f, 0.0f, 1.0f);
+	setRenderPassDepth(graph, pass, sceneDepth, RENDER_CLEAR);
+	pass = addRenderPass(graph, "particles", NULL, NULL);
+	setRenderPassColor(graph, pass, sceneColor, RENDER_LOAD, 0.0f, 0.0f, 0.0f, 0.0f);
+	setRenderPassDepth(graph, pass, sceneDepth, RENDER_LOAD);
+	pass = addRenderPass(graph, "debugDepth", NULL, NULL);
+	setRenderPassColor(graph, pass, debug, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	readRenderResource(graph, pass, sceneColor);
+	pass = addRenderPass(graph, "brightPass", NULL, NULL);
+	setRenderPassColor(graph, pass, bright, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	readRenderResource(graph, pass, sceneColor);
+	pass = addRenderPass(graph, "blurDown", NULL, NULL);
+	setRenderPassColor(graph, pass, blurQuarter, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	readRenderResource(graph, pass, bright);
+	pass = addRenderPass(graph, "blurUp", NULL, NULL);
+	setRenderPassColor(graph, pass, blurHalf, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	readRenderResource(graph, pass, blurQuarter);
+	pass = addRenderPass(graph, "composite", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	readRenderResource(graph, pass, sceneColor);
+	readRenderResource(graph, pass, blurHalf);
+	pass = addRenderPass(graph, "overlay", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_LOAD, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+// a pass whose output is overwritten before anyone reads it is dead too
+static void buildOverwrittenGraph(RenderGraph* graph) {
+	int32_t backbuffer = importRenderResource(graph, "backbuffer", width, height);
+	int32_t pass = addRenderPass(graph, "stale", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_CLEAR, 1.0f, 0.0f, 0.0f, 1.0f);
+	pass = addRenderPass(graph, "scene", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_CLEAR, 0.0f, 0.0f, 0.0f, 1.0f);
+	pass = addRenderPass(graph, "overlay", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_LOAD, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+// what main.cpp builds
+static void buildAppGraph(RenderGraph* graph) {
+	int32_t backbuffer = importRenderResource(graph, "backbuffer", width, height);
+	int32_t pass = addRenderPass(graph, "scene", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	pass = addRenderPass(graph, "overlay", NULL, NULL);
+	setRenderPassColor(graph, pass, backbuffer, RENDER_LOAD, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+static bool checkAliasing(const RenderGraph* graph) {
+	for (int32_t i = 0; i < graph->resourceCount; ++i) {
+		const RenderGraphResource* a = &graph->resources[i];
+		for (int32_t j = i + 1; j < graph->resourceCount; ++j) {
+			const RenderGraphResource* b = &graph->resources[j];
+			if (a->target < 0 || a->target != b->target) {
+				continue;
+			}
+			if (a->firstPass <= b->lastPass && b->firstPass <= a->lastPass) {
+				printf("FAIL: %s and %s share target %d while both are live\n", a->name, b->name, a->target);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool sameCompilation(const RenderGraph* a, const RenderGraph* b) {
+	for (int32_t i = 0; i < a->passCount; ++i) {
+		const RenderGraphPass* p = &a->passes[i];
+		const RenderGraphPass* q = &b->passes[i];
+		if (p->culled != q->culled || p->switchesFramebuffer != q->switchesFramebuffer ||
+			p->color.clear != q->color.clear || p->color.discard != q->color.discard ||
+			p->depth.clear != q->depth.clear || p->depth.discard != q->depth.discard) {
+			return false;
+		}
+	}
+	for (int32_t i = 0; i < a->resourceCount; ++i) {
+		if (a->resources[i].target != b->resources[i].target) {
+			return false;
+		}
+	}
+	return memcmp(&a->stats, &b->stats, sizeof(RenderGraphStats)) == 0;
+}
+
+static bool checkGraph(const char* name, BuildGraphFunction build) {
+	static RenderGraph first;
+	static RenderGraph second;
+	initRenderGraph(&first, NULL);
+	initRenderGraph(&second, NULL);
+	build(&first);
+	build(&second);
+	printf("%s:\n", name);
+	if (!compileRenderGraph(&first) || !compileRenderGraph(&second)) {
+		printf("FAIL: did not compile\n");
+		return false;
+	}
+	logRenderGraph(&first);
+	if (!sameCompilation(&first, &second)) {
+		printf("FAIL: two compilations differ\n");
+		return false;
+	}
+	// compiling again with the targets the previous frame left must not change the plan
+	resetRenderGraph(&first);
+	build(&first);
+	if (!compileRenderGraph(&first) || !sameCompilation(&first, &second)) {
+		printf("FAIL: recompiling the next frame differs\n");
+		return false;
+	}
+	return checkAliasing(&first);
+}
+
+int main() {
+	// the plans are logged to stderr, keep the two in order
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	bool ok = checkGraph("post process", buildPostProcessGraph);
+	ok = checkGraph("overwritten", buildOverwrittenGraph) && ok;
+	ok = checkGraph("app", buildAppGraph) && ok;
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
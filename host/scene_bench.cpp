@@ -0,0 +1,158 @@
+// Times updateScene and cullScene in jni/scene.cpp on the host for a large scene, with a range of
+// fractions of the nodes moved each frame, and checks the world transforms and the visible set
+// against a brute force pass over every node.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o scene_bench host/scene_bench.cpp jni/scene.cpp memory_tracker.o
+// Usage:        scene_bench [nodes] [frames]
+//
+// The scene has 100 groups spread over a 4096 pixel square, each holding an equal share of the
+// leaves within 256 pixels of it; the view is a 1280x720 window panning across the square.
+
+#include "../jni/scene.h"
+#include "../jni/memory_tracker.h"
+#include "../jni/time_utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const int32_t groupCount = 100;
+const float worldSize = 4096.0f;
+const float cellSize = 128.0f;
+const float viewWidth = 1280.0f;
+const float viewHeight = 720.0f;
+
+static uint32_t seed = 12345;
+
+static float nextRandom() {
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static Transform2D translation(float x, float y) {
+	Transform2D t = { 1.0f, 0.0f, 0.0f, 1.0f, x, y };
+	return t;
+}
+
+static bool buildScene(Scene* scene, int32_t count) {
+	int32_t grid = static_cast<int32_t>(worldSize / cellSize);
+	if (!initScene(scene, count, cellSize, grid, grid)) {
+		printf("FAIL: could not allocate %d nodes\n", count);
+		return false;
+	}
+	const Bounds2D empty = { 0.0f, 0.0f, -1.0f, -1.0f };
+	const Bounds2D sprite = { -8.0f, -8.0f, 8.0f, 8.0f };
+	for (int32_t i = 0; i < groupCount; ++i) {
+		Transform2D local = translation(nextRandom() * worldSize, nextRandom() * worldSize);
+		addSceneNode(scene, -1, &local, &empty);
+	}
+	for (int32_t i = groupCount; i < count; ++i) {
+		Transform2D local = translation((nextRandom() - 0.5f) * 512.0f, (nextRandom() - 0.5f) * 512.0f);
+		addSceneNode(scene, i % groupCount, &local, &sprite);
+	}
+	updateScene(scene);
+	return true;
+}
+
+static bool checkScene(const Scene* scene, const Bounds2D* view) {
+	for (int32_t i = 0; i < scene->count; ++i) {
+		int32_t p = scene->parent[i];
+		Transform2D expected = p >= 0 ? multiplyTransforms(&scene->worldTransform[p], &scene->localTransform[i]) : scene->localTransform[i];
+		if (memcmp(&expected, &scene->worldTransform[i], sizeof(Transform2D)) != 0) {
+			printf("FAIL: node %d has a stale world transform\n", i);
+			return false;
+		}
+	}
+
+	uint8_t* visible = static_cast<uint8_t*>(calloc(static_cast<uint32_t>(scene->count), 1));
+	for (int32_t i = 0; i < scene->visibleCount; ++i) {
+		visible[scene->visible[i]] = 1;
+	}
+	bool ok = true;
+	int32_t expectedCount = 0;
+	for (int32_t i = groupCount; i < scene->count && ok; ++i) {
+		const Bounds2D* b = &scene->worldBounds[i];
+		bool overlaps = b->maxX >= view->minX && b->minX <= view->maxX && b->maxY >= view->minY && b->minY <= view->maxY;
+		expectedCount += overlaps;
+		if (overlaps != (visible[i] != 0)) {
+			printf("FAIL: node %d is %s by the grid\n", i, overlaps ? "missed" : "wrongly returned");
+			ok = false;
+		}
+	}
+	if (ok && expectedCount != scene->visibleCount) {
+		printf("FAIL: %d visible nodes, expected %d\n", scene->visibleCount, expectedCount);
+		ok = false;
+	}
+	free(visible);
+	return ok;
+}
+
+// Each frame moves dirtyRatio of the leaves a little, then updates and culls.
+static bool run(int32_t count, int32_t frames, float dirtyRatio) {
+	Scene scene;
+	if (!buildScene(&scene, count)) {
+		return false;
+	}
+	int32_t leaves = count - groupCount;
+	int32_t moved = static_cast<int32_t>(leaves * dirtyRatio);
+	int32_t stride = moved > 0 ? leaves / moved : leaves;
+
+	int64_t updateNanoseconds = 0;
+	int64_t cullNanoseconds = 0;
+	int64_t visible = 0;
+	Bounds2D view = { 0.0f, 0.0f, viewWidth, viewHeight };
+	for (int32_t frame = 0; frame < frames; ++frame) {
+		// spread the moved leaves over the scene, starting somewhere new each frame
+		int32_t first = groupCount + frame % stride;
+		for (int32_t i = 0, node = first; i < moved && node < count; ++i, node += stride) {
+			Transform2D local = scene.localTransform[node];
+			local.tx += (nextRandom() - 0.5f) * 4.0f;
+			local.ty += (nextRandom() - 0.5f) * 4.0f;
+			setSceneNodeTransform(&scene, node, &local);
+		}
+		float t = frame * 0.01f;
+		view.minX = (0.5f + 0.5f * sinf(t)) * (worldSize - viewWidth);
+		view.minY = (0.5f + 0.5f * cosf(t * 0.7f)) * (worldSize - viewHeight);
+		view.maxX = view.minX + viewWidth;
+		view.maxY = view.minY + viewHeight;
+
+		int64_t start = nowNanoseconds();
+		updateScene(&scene);
+		int64_t updated = nowNanoseconds();
+		cullScene(&scene, &view);
+		updateNanoseconds += updated - start;
+		cullNanoseconds += nowNanoseconds() - updated;
+		visible += scene.visibleCount;
+	}
+	bool ok = checkScene(&scene, &view);
+	printf("  %5.1f%% dirty: update %6.3f ms (%6d nodes), cull %6.3f ms (%5lld visible)\n", dirtyRatio * 100.0f,
+		updateNanoseconds * 1e-6 / frames, scene.updatedCount, cullNanoseconds * 1e-6 / frames, static_cast<long long>(visible / frames));
+	termScene(&scene);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	int32_t count = argc >= 2 ? atoi(argv[1]) : 100000;
+	int32_t frames = argc >= 3 ? atoi(argv[2]) : 200;
+	if (count <= groupCount || frames <= 0) {
+		printf("Usage: scene_bench [nodes, more than %d] [frames]\n", groupCount);
+		return 1;
+	}
+	printf("%d nodes, %d frames:\n", count, frames);
+	static const float dirtyRatios[] = { 0.0f, 0.01f, 0.1f, 0.5f, 1.0f };
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(dirtyRatios) / sizeof(dirtyRatios[0]); ++i) {
+		ok = run(count, frames, dirtyRatios[i]) && ok;
+	}
+
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	if (MEMORY_TRACKING && snapshot.heap[MEMORY_TAG_SCENE].liveAllocations != 0) {
+		printf("FAIL: scene arrays leaked\n");
+		ok = false;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,624 @@
+// Replays recorded sessions, lifecycle commands and input with their timings, into the unchanged app
+// through the glue and the NDK stand-ins in host/android_host.cpp. Reports for each one: frame
+// time percentiles, the time from each resume to the next presented frame, main loop stalls and
+// the longest the "UI thread" was blocked in an activity callback. Each session runs in its own
+// process, so they can't affect one another and a crash fails only that one.
+//
+// Build with:   cc -O2 -D__ANDROID__ -Ihost/ndk -c jni/android_native_app_glue.c jni/session_recorder.c
+//                   jni/startup_trace.c jni/memory_tracker.c jni/shader_utils.c jni/font8x8.c jni/metrics.c
+//               c++ -std=c++20 -O2 -D__ANDROID__ -Ihost/ndk -o session_replay host/session_replay.cpp host/android_host.cpp
+//                   jni/main.cpp jni/egl_config.cpp jni/frame_pacer.cpp jni/gl_extensions.cpp jni/gpu_fence.cpp
+//                   jni/glyph_atlas.cpp jni/particles.cpp jni/post_process.cpp jni/render_graph.cpp jni/scene.cpp
+//                   jni/scene_renderer.cpp jni/simulation.cpp jni/stream_buffer.cpp jni/text_renderer.cpp
+//                   jni/touch_predictor.cpp jni/upload_queue.cpp jni/worker_pool.cpp jni/quality_governor.cpp
+//                   jni/thermal_provider.cpp jni/looper_tasks.cpp
+//                   android_native_app_glue.o session_recorder.o startup_trace.o memory_tracker.o shader_utils.o
+//                   font8x8.o metrics.o -lEGL -lGLESv2 -lpthread -ldl
+// Usage:        session_replay [options] [session.rec...]
+// Options:      --max-p99 MS --max-resume MS --max-stalls N   fail when a session goes over
+//               --stall MS                                   main loop gap counted as a stall (default 50)
+//               --write DIR                                  save the built-in sessions as recordings
+//               --verbose                                    let the app log
+//
+// Without recordings the built-in scenarios run: a cold start, rapid pause and resume, the window
+// going and coming back mid-stroke, and rotations. Record on a device by building with
+// -DSESSION_RECORD in LOCAL_CFLAGS and pulling <internalDataPath>/session.rec.
+
+#include "android_host.h"
+#include "../jni/android_native_app_glue.h"
+#include "../jni/session_recorder.h"
+#include "../jni/time_utils.h"
+
+#include <android/log.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+struct Options {
+	double maxP99Milliseconds;
+	double maxResumeMilliseconds;
+	int32_t maxStalls;
+	int64_t stallNanoseconds;
+	bool verbose;
+};
+
+// --------------------------------------------------------------------
+// Built-in scenarios
+// --------------------------------------------------------------------
+
+struct ScenarioBuilder {
+	std::vector<SessionRecord> records;
+	int32_t width;
+	int32_t height;
+	bool window;
+	bool inputQueue;
+};
+
+static int64_t milliseconds(double ms) {
+	return static_cast<int64_t>(ms * 1e6);
+}
+
+static void addCommand(ScenarioBuilder* builder, double ms, int32_t command) {
+	if (command == APP_CMD_INIT_WINDOW) {
+		builder->window = true;
+	} else if (command == APP_CMD_TERM_WINDOW) {
+		builder->window = false;
+	} else if (command == APP_CMD_INPUT_CHANGED) {
+		builder->inputQueue = !builder->inputQueue;
+	}
+	SessionRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = SESSION_RECORD_COMMAND;
+	record.nanoseconds = milliseconds(ms);
+	record.command = command;
+	record.width = builder->window ? builder->width : 0;
+	record.height = builder->window ? builder->height : 0;
+	record.inputQueue = builder->inputQueue;
+	builder->records.push_back(record);
+}
+
+static double launch(ScenarioBuilder* builder, double ms) {
+	addCommand(builder, ms, APP_CMD_START);
+	addCommand(builder, ms + 2.0, APP_CMD_RESUME);
+	addCommand(builder, ms + 4.0, APP_CMD_INPUT_CHANGED);
+	addCommand(builder, ms + 30.0, APP_CMD_INIT_WINDOW);
+	addCommand(builder, ms + 45.0, APP_CMD_GAINED_FOCUS);
+	return ms + 45.0;
+}
+
+static double background(ScenarioBuilder* builder, double ms) {
+	addCommand(builder, ms, APP_CMD_PAUSE);
+	addCommand(builder, ms + 5.0, APP_CMD_LOST_FOCUS);
+	addCommand(builder, ms + 15.0, APP_CMD_TERM_WINDOW);
+	addCommand(builder, ms + 20.0, APP_CMD_STOP);
+	addCommand(builder, ms + 21.0, APP_CMD_SAVE_STATE);
+	return ms + 21.0;
+}
+
+static double foreground(ScenarioBuilder* builder, double ms) {
+	addCommand(builder, ms, APP_CMD_START);
+	addCommand(builder, ms + 2.0, APP_CMD_RESUME);
+	addCommand(builder, ms + 25.0, APP_CMD_INIT_WINDOW);
+	addCommand(builder, ms + 40.0, APP_CMD_GAINED_FOCUS);
+	return ms + 40.0;
+}
+
+// A finger moving from (x0, y0) to (x1, y1), reported at 120 Hz with one batched sample per event.
+static void stroke(ScenarioBuilder* builder, double ms, double durationMs, float x0, float y0, float x1, float y1) {
+	const double intervalMs = 1000.0 / 120.0;
+	const int64_t latency = milliseconds(4.0);
+	int32_t events = static_cast<int32_t>(durationMs / intervalMs);
+	for (int32_t i = 0; i <= events; ++i) {
+		SessionRecord record;
+		memset(&record, 0, sizeof(record));
+		record.type = SESSION_RECORD_MOTION;
+		record.nanoseconds = milliseconds(ms + i * intervalMs);
+		record.action = i == 0 ? AMOTION_EVENT_ACTION_DOWN : i == events ? AMOTION_EVENT_ACTION_UP : AMOTION_EVENT_ACTION_MOVE;
+		record.eventNanoseconds = -latency;
+		record.pointerCount = 1;
+		float t = static_cast<float>(i) / events;
+		record.pointers[0].x = x0 + (x1 - x0) * t;
+		record.pointers[0].y = y0 + (y1 - y0) * t;
+		if (record.action == AMOTION_EVENT_ACTION_MOVE) {
+			float previous = (i - 0.5f) / events;
+			record.historySize = 1;
+			record.historyNanoseconds[0] = -latency - milliseconds(intervalMs * 0.5);
+			record.historyX[0][0] = x0 + (x1 - x0) * previous;
+			record.historyY[0][0] = y0 + (y1 - y0) * previous;
+		}
+		builder->records.push_back(record);
+	}
+}
+
+static void rotate(ScenarioBuilder* builder, double ms) {
+	std::swap(builder->width, builder->height);
+	addCommand(builder, ms, APP_CMD_CONFIG_CHANGED);
+	addCommand(builder, ms + 16.0, APP_CMD_WINDOW_RESIZED);
+}
+
+static void buildColdStart(ScenarioBuilder* builder) {
+	launch(builder, 0.0);
+	stroke(builder, 1000.0, 600.0, 100.0f, 300.0f, 600.0f, 900.0f);
+	addCommand(builder, 2500.0, APP_CMD_PAUSE);
+}
+
+static void buildRapidPauseResume(ScenarioBuilder* builder) {
+	double ms = launch(builder, 0.0) + 1000.0;
+	for (int32_t i = 0; i < 12; ++i) {
+		addCommand(builder, ms, APP_CMD_PAUSE);
+		// every third one the app loses focus too, as it does under a notification shade
+		if (i % 3 == 2) {
+			addCommand(builder, ms + 3.0, APP_CMD_LOST_FOCUS);
+			addCommand(builder, ms + 60.0, APP_CMD_GAINED_FOCUS);
+		}
+		addCommand(builder, ms + 40.0 + (i % 4) * 20.0, APP_CMD_RESUME);
+		ms += 220.0;
+	}
+	addCommand(builder, ms + 500.0, APP_CMD_PAUSE);
+}
+
+static void buildWindowCycleTouching(ScenarioBuilder* builder) {
+	launch(builder, 0.0);
+	stroke(builder, 600.0, 3000.0, 50.0f, 100.0f, 650.0f, 1100.0f);
+	for (int32_t i = 0; i < 3; ++i) {
+		double ms = background(builder, 1000.0 + i * 900.0);
+		foreground(builder, ms + 120.0);
+	}
+	addCommand(builder, 4200.0, APP_CMD_PAUSE);
+}
+
+static void buildRotation(ScenarioBuilder* builder) {
+	launch(builder, 0.0);
+	for (int32_t i = 0; i < 4; ++i) {
+		double ms = 800.0 + i * 800.0;
+		stroke(builder, ms - 400.0, 300.0, 100.0f, 100.0f, 400.0f, 500.0f);
+		rotate(builder, ms);
+	}
+	addCommand(builder, 4000.0, APP_CMD_PAUSE);
+}
+
+struct Scenario {
+	const char* name;
+	void (*build)(ScenarioBuilder* builder);
+};
+
+static const Scenario scenarios[] = {
+	{ "cold_start", buildColdStart },
+	{ "rapid_pause_resume", buildRapidPauseResume },
+	{ "window_cycle_touching", buildWindowCycleTouching },
+	{ "rotation", buildRotation }
+};
+
+static bool lessRecordTime(const SessionRecord& a, const SessionRecord& b) {
+	return a.nanoseconds < b.nanoseconds;
+}
+
+static void buildScenario(const Scenario* scenario, std::vector<SessionRecord>* records) {
+	ScenarioBuilder builder;
+	builder.width = 720;
+	builder.height = 1280;
+	builder.window = false;
+	builder.inputQueue = false;
+	scenario->build(&builder);
+	std::stable_sort(builder.records.begin(), builder.records.end(), lessRecordTime);
+	records->swap(builder.records);
+}
+
+static bool writeRecording(const std::vector<SessionRecord>& records, const char* path) {
+	SessionRecorder recorder;
+	if (!beginSessionRecording(&recorder, fopen(path, "wb"))) {
+		return false;
+	}
+	for (size_t i = 0; i < records.size(); ++i) {
+		recordSession(&recorder, &records[i]);
+	}
+	return endSessionRecording(&recorder);
+}
+
+static bool readRecording(const char* path, std::vector<SessionRecord>* records) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "could not open %s\n", path);
+		return false;
+	}
+	SessionReader reader;
+	bool opened = openSessionReader(&reader, file);
+	SessionRecord record;
+	while (opened && readSessionRecord(&reader, &record)) {
+		records->push_back(record);
+	}
+	fclose(file);
+	return opened;
+}
+
+// --------------------------------------------------------------------
+// Replay
+// --------------------------------------------------------------------
+
+struct Replay {
+	pthread_mutex_t mutex;
+	std::vector<int64_t> presented;
+	int32_t stalls;
+	int64_t maxStallNanoseconds;
+	int64_t stallNanoseconds;
+
+	// on the replaying thread only
+	ANativeActivity activity;
+	ANativeWindow* window;
+	AInputQueue* inputQueue;
+	bool started;
+	bool resumed;
+	bool focused;
+	std::vector<int64_t> resumes;
+	std::vector<int64_t> breaks; // the app stops drawing: pause, focus or window lost
+	int64_t maxCallbackNanoseconds;
+	int32_t droppedEvents;
+};
+
+static void framePresented(void* data, int64_t nanoseconds) {
+	Replay* replay = static_cast<Replay*>(data);
+	pthread_mutex_lock(&replay->mutex);
+	replay->presented.push_back(nanoseconds);
+	pthread_mutex_unlock(&replay->mutex);
+}
+
+static void loopPolled(void* data, int64_t sinceLastPollNanoseconds) {
+	Replay* replay = static_cast<Replay*>(data);
+	if (sinceLastPollNanoseconds < replay->stallNanoseconds) {
+		return;
+	}
+	pthread_mutex_lock(&replay->mutex);
+	replay->stalls++;
+	replay->maxStallNanoseconds = std::max(replay->maxStallNanoseconds, sinceLastPollNanoseconds);
+	pthread_mutex_unlock(&replay->mutex);
+}
+
+static void postInput(Replay* replay, const SessionRecord* record, int64_t origin) {
+	if (!replay->inputQueue) {
+		return;
+	}
+	AInputEvent event;
+	memset(&event, 0, sizeof(event));
+	int64_t processed = origin + record->nanoseconds;
+	event.eventTime = processed + record->eventNanoseconds;
+	event.action = record->action;
+	if (record->type == SESSION_RECORD_KEY) {
+		event.type = AINPUT_EVENT_TYPE_KEY;
+		event.keyCode = record->keyCode;
+	} else {
+		event.type = AINPUT_EVENT_TYPE_MOTION;
+		event.pointerCount = std::min(record->pointerCount, HOST_MAX_POINTERS);
+		for (int32_t i = 0; i < event.pointerCount; ++i) {
+			event.pointerIds[i] = record->pointers[i].id;
+			event.x[i] = record->pointers[i].x;
+			event.y[i] = record->pointers[i].y;
+		}
+		event.historySize = std::min(record->historySize, HOST_MAX_HISTORY);
+		for (int32_t h = 0; h < event.historySize; ++h) {
+			event.historyTime[h] = processed + record->historyNanoseconds[h];
+			for (int32_t i = 0; i < event.pointerCount; ++i) {
+				event.historyX[h][i] = record->historyX[h][i];
+				event.historyY[h][i] = record->historyY[h][i];
+			}
+		}
+	}
+	if (!postHostInputEvent(replay->inputQueue, &event)) {
+		replay->droppedEvents++;
+	}
+}
+
+// Calls the callback the framework would have for a recorded command, which makes the glue send it.
+static void dispatchCommand(Replay* replay, const SessionRecord* record) {
+	ANativeActivity* activity = &replay->activity;
+	ANativeActivityCallbacks* callbacks = activity->callbacks;
+	int64_t start = nowNanoseconds();
+	switch (record->command) {
+	case APP_CMD_START:
+		replay->started = true;
+		callbacks->onStart(activity);
+		break;
+	case APP_CMD_RESUME:
+		replay->resumed = true;
+		replay->resumes.push_back(start);
+		callbacks->onResume(activity);
+		break;
+	case APP_CMD_PAUSE:
+		replay->resumed = false;
+		replay->breaks.push_back(start);
+		callbacks->onPause(activity);
+		break;
+	case APP_CMD_STOP:
+		replay->started = false;
+		callbacks->onStop(activity);
+		break;
+	case APP_CMD_SAVE_STATE: {
+		size_t size = 0;
+		free(callbacks->onSaveInstanceState(activity, &size));
+		break;
+	}
+	case APP_CMD_GAINED_FOCUS:
+	case APP_CMD_LOST_FOCUS:
+		replay->focused = record->command == APP_CMD_GAINED_FOCUS;
+		if (!replay->focused) {
+			replay->breaks.push_back(start);
+		}
+		callbacks->onWindowFocusChanged(activity, replay->focused);
+		break;
+	case APP_CMD_INIT_WINDOW:
+		if (replay->window) {
+			callbacks->onNativeWindowDestroyed(activity, replay->window);
+			destroyHostWindow(replay->window);
+		}
+		replay->window = createHostWindow(record->width > 0 ? record->width : 720, record->height > 0 ? record->height : 1280);
+		callbacks->onNativeWindowCreated(activity, replay->window);
+		break;
+	case APP_CMD_TERM_WINDOW:
+		if (replay->window) {
+			replay->breaks.push_back(start);
+			callbacks->onNativeWindowDestroyed(activity, replay->window);
+			destroyHostWindow(replay->window);
+			replay->window = NULL;
+		}
+		break;
+	case APP_CMD_WINDOW_RESIZED:
+	case APP_CMD_CONFIG_CHANGED:
+		if (replay->window && record->width > 0 && record->height > 0) {
+			resizeHostWindow(replay->window, record->width, record->height);
+		}
+		if (record->command == APP_CMD_CONFIG_CHANGED) {
+			callbacks->onConfigurationChanged(activity);
+		} else if (callbacks->onNativeWindowResized && replay->window) {
+			callbacks->onNativeWindowResized(activity, replay->window);
+		}
+		break;
+	case APP_CMD_INPUT_CHANGED:
+		if (record->inputQueue && !replay->inputQueue) {
+			replay->inputQueue = createHostInputQueue();
+			callbacks->onInputQueueCreated(activity, replay->inputQueue);
+		} else if (!record->inputQueue && replay->inputQueue) {
+			callbacks->onInputQueueDestroyed(activity, replay->inputQueue);
+			destroyHostInputQueue(replay->inputQueue);
+			replay->inputQueue = NULL;
+		}
+		break;
+	case APP_CMD_LOW_MEMORY:
+		callbacks->onLowMemory(activity);
+		break;
+	case APP_CMD_DESTROY:
+		break;
+	default:
+		return;
+	}
+	replay->maxCallbackNanoseconds = std::max(replay->maxCallbackNanoseconds, nowNanoseconds() - start);
+}
+
+static void dispatch(Replay* replay, int32_t command) {
+	SessionRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = SESSION_RECORD_COMMAND;
+	record.command = command;
+	dispatchCommand(replay, &record);
+}
+
+static void sleepUntil(int64_t nanoseconds) {
+	int64_t remaining = nanoseconds - nowNanoseconds();
+	if (remaining > 0) {
+		struct timespec duration = { static_cast<time_t>(remaining / 1000000000), static_cast<long>(remaining % 1000000000) };
+		nanosleep(&duration, NULL);
+	}
+}
+
+static double percentile(std::vector<int64_t>* values, double fraction) {
+	if (values->empty()) {
+		return 0.0;
+	}
+	size_t index = std::min(values->size() - 1, static_cast<size_t>(fraction * values->size()));
+	std::nth_element(values->begin(), values->begin() + index, values->end());
+	return (*values)[index] * 1e-6;
+}
+
+// Runs in the session's own process; returns its exit code.
+static int replaySession(const char* name, const std::vector<SessionRecord>& records, const Options* options) {
+	static Replay replay;
+	pthread_mutex_init(&replay.mutex, NULL);
+	replay.stallNanoseconds = options->stallNanoseconds;
+	setHostLogPriority(options->verbose ? ANDROID_LOG_INFO : ANDROID_LOG_ERROR);
+	HostCallbacks callbacks = { &replay, framePresented, loopPolled };
+	setHostCallbacks(&callbacks);
+	initHostActivity(&replay.activity, NULL);
+
+	int64_t origin = nowNanoseconds();
+	ANativeActivity_onCreate(&replay.activity, NULL, 0);
+	for (size_t i = 0; i < records.size() && !hostActivityFinishing(); ++i) {
+		const SessionRecord* record = &records[i];
+		sleepUntil(origin + record->nanoseconds);
+		if (record->type == SESSION_RECORD_COMMAND) {
+			if (record->command == APP_CMD_DESTROY) {
+				break;
+			}
+			dispatchCommand(&replay, record);
+		} else {
+			postInput(&replay, record, origin);
+		}
+	}
+	// end the session the way the framework would, however the recording stopped
+	if (replay.resumed) {
+		dispatch(&replay, APP_CMD_PAUSE);
+	}
+	if (replay.focused) {
+		dispatch(&replay, APP_CMD_LOST_FOCUS);
+	}
+	if (replay.window) {
+		dispatch(&replay, APP_CMD_TERM_WINDOW);
+	}
+	if (replay.started) {
+		dispatch(&replay, APP_CMD_STOP);
+	}
+	if (replay.inputQueue) {
+		SessionRecord record;
+		memset(&record, 0, sizeof(record));
+		record.command = APP_CMD_INPUT_CHANGED;
+		dispatchCommand(&replay, &record);
+	}
+	replay.activity.callbacks->onDestroy(&replay.activity);
+	int64_t elapsed = nowNanoseconds() - origin;
+
+	// frame times between consecutive presents, unless the app was told to stop drawing in between
+	pthread_mutex_lock(&replay.mutex);
+	std::vector<int64_t> presented = replay.presented;
+	int32_t stalls = replay.stalls;
+	int64_t maxStall = replay.maxStallNanoseconds;
+	pthread_mutex_unlock(&replay.mutex);
+	std::vector<int64_t> frameTimes;
+	size_t nextBreak = 0;
+	for (size_t i = 1; i < presented.size(); ++i) {
+		bool interrupted = false;
+		while (nextBreak < replay.breaks.size() && replay.breaks[nextBreak] <= presented[i]) {
+			interrupted |= replay.breaks[nextBreak] > presented[i - 1];
+			++nextBreak;
+		}
+		if (!interrupted) {
+			frameTimes.push_back(presented[i] - presented[i - 1]);
+		}
+	}
+
+	// resume to the first frame presented before the next pause; the first one is the cold start
+	double coldResume = -1.0;
+	double warmResumeSum = 0.0;
+	double warmResumeMax = 0.0;
+	int32_t warmResumes = 0;
+	for (size_t i = 0; i < replay.resumes.size(); ++i) {
+		int64_t resume = replay.resumes[i];
+		std::vector<int64_t>::const_iterator frame = std::upper_bound(presented.begin(), presented.end(), resume);
+		std::vector<int64_t>::const_iterator pause = std::upper_bound(replay.breaks.begin(), replay.breaks.end(), resume);
+		if (frame == presented.end() || (pause != replay.breaks.end() && *pause < *frame)) {
+			continue;
+		}
+		double ms = (*frame - resume) * 1e-6;
+		if (i == 0) {
+			coldResume = ms;
+		} else {
+			warmResumeSum += ms;
+			warmResumeMax = std::max(warmResumeMax, ms);
+			warmResumes++;
+		}
+	}
+
+	double p50 = percentile(&frameTimes, 0.5);
+	double p90 = percentile(&frameTimes, 0.9);
+	double p99 = percentile(&frameTimes, 0.99);
+	double frameMax = percentile(&frameTimes, 1.0);
+	printf("%-22s %5.1f s %5zu frames  p50 %6.2f  p90 %6.2f  p99 %6.2f  max %7.2f ms  resume cold %7.2f  warm %6.2f avg %6.2f max ms"
+		"  stalls %3d max %7.2f ms  callback max %6.2f ms%s\n",
+		name, elapsed * 1e-9, presented.size(), p50, p90, p99, frameMax, coldResume,
+		warmResumes ? warmResumeSum / warmResumes : 0.0, warmResumeMax, stalls, maxStall * 1e-6, replay.maxCallbackNanoseconds * 1e-6,
+		replay.droppedEvents ? "  (input queue overflowed)" : "");
+
+	bool failed = false;
+	if (presented.empty()) {
+		printf("%-22s FAIL no frames presented\n", name);
+		failed = true;
+	}
+	if (options->maxP99Milliseconds > 0.0 && p99 > options->maxP99Milliseconds) {
+		printf("%-22s FAIL p99 %.2f ms over %.2f ms\n", name, p99, options->maxP99Milliseconds);
+		failed = true;
+	}
+	double worstResume = std::max(coldResume, warmResumeMax);
+	if (options->maxResumeMilliseconds > 0.0 && worstResume > options->maxResumeMilliseconds) {
+		printf("%-22s FAIL resume to first frame %.2f ms over %.2f ms\n", name, worstResume, options->maxResumeMilliseconds);
+		failed = true;
+	}
+	if (options->maxStalls >= 0 && stalls > options->maxStalls) {
+		printf("%-22s FAIL %d stalls, at most %d allowed\n", name, stalls, options->maxStalls);
+		failed = true;
+	}
+	return failed ? 1 : 0;
+}
+
+static bool runSession(const char* name, const std::vector<SessionRecord>& records, const Options* options) {
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return false;
+	}
+	if (pid == 0) {
+		int code = replaySession(name, records, options);
+		fflush(stdout);
+		_exit(code);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (WIFSIGNALED(status)) {
+		printf("%-22s FAIL crashed with signal %d\n", name, WTERMSIG(status));
+		return false;
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char** argv) {
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	Options options;
+	memset(&options, 0, sizeof(options));
+	options.maxStalls = -1;
+	options.stallNanoseconds = milliseconds(50.0);
+	const char* writeDirectory = NULL;
+	int32_t first = 1;
+	for (; first < argc && strncmp(argv[first], "--", 2) == 0; ++first) {
+		const char* option = argv[first];
+		bool hasValue = first + 1 < argc;
+		if (strcmp(option, "--verbose") == 0) {
+			options.verbose = true;
+		} else if (strcmp(option, "--max-p99") == 0 && hasValue) {
+			options.maxP99Milliseconds = atof(argv[++first]);
+		} else if (strcmp(option, "--max-resume") == 0 && hasValue) {
+			options.maxResumeMilliseconds = atof(argv[++first]);
+		} else if (strcmp(option, "--max-stalls") == 0 && hasValue) {
+			options.maxStalls = atoi(argv[++first]);
+		} else if (strcmp(option, "--stall") == 0 && hasValue) {
+			options.stallNanoseconds = milliseconds(atof(argv[++first]));
+		} else if (strcmp(option, "--write") == 0 && hasValue) {
+			writeDirectory = argv[++first];
+		} else {
+			fprintf(stderr, "unknown option %s\n", option);
+			return 2;
+		}
+	}
+
+	bool passed = true;
+	if (first < argc) {
+		for (int32_t i = first; i < argc; ++i) {
+			std::vector<SessionRecord> records;
+			if (!readRecording(argv[i], &records)) {
+				passed = false;
+				continue;
+			}
+			const char* name = strrchr(argv[i], '/');
+			passed &= runSession(name ? name + 1 : argv[i], records, &options);
+		}
+		return passed ? 0 : 1;
+	}
+
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+		std::vector<SessionRecord> records;
+		buildScenario(&scenarios[i], &records);
+		if (writeDirectory) {
+			char path[512];
+			snprintf(path, sizeof(path), "%s/%s.rec", writeDirectory, scenarios[i].name);
+			if (!writeRecording(records, path)) {
+				fprintf(stderr, "could not write %s\n", path);
+				return 1;
+			}
+			printf("wrote %s\n", path);
+			continue;
+		}
+		passed &= runSession(scenarios[i].name, records, &options);
+	}
+	return passed ? 0 : 1;
+}
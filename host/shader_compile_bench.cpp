@@ -0,0 +1,175 @@
+// Compares compiling the readable shaders in jni/shaders with compiling the sources
+// tools/shader_tool.cpp generates from them, program by program, on the host's GLES driver.
+//
+// Build with:   c++ -O2 -o shader_compile_bench host/shader_compile_bench.cpp -lGLESv2 -lEGL
+// Usage:        EGL_PLATFORM=surfaceless shader_compile_bench [iterations]   (from the repository root)
+//
+// Each program is compiled and linked iterations times with the driver's shader cache off,
+// alternating readable and generated sources, and the medians are printed with the source sizes.
+// Both must link; run shader_tool --check first, since a stale header measures the wrong thing.
+// Desktop drivers ignore precision qualifiers, so what this shows is the front end's share:
+// parsing, folding and dead code the driver no longer has to find.
+
+#include "../jni/shaders/blur.h"
+#include "../jni/shaders/bright.h"
+#include "../jni/shaders/full_screen.h"
+#include "../jni/shaders/particle.h"
+#include "../jni/shaders/scene_es2.h"
+#include "../jni/shaders/scene_es3.h"
+#include "../jni/shaders/text.h"
+#include "../jni/time_utils.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct BenchProgram {
+	const char* name;
+	const char* vertexPath;
+	const char* fragmentPath;
+	const char* vertexShader;
+	const char* fragmentShader;
+};
+
+static const BenchProgram programs[] = {
+	{ "scene es2", "jni/shaders/scene_es2.vert", "jni/shaders/scene_es2.frag", sceneEs2VertexShader, sceneEs2FragmentShader },
+	{ "scene es3", "jni/shaders/scene_es3.vert", "jni/shaders/scene_es3.frag", sceneEs3VertexShader, sceneEs3FragmentShader },
+	{ "text", "jni/shaders/text.vert", "jni/shaders/text.frag", textVertexShader, textFragmentShader },
+	{ "particle", "jni/shaders/particle.vert", "jni/shaders/particle.frag", particleVertexShader, particleFragmentShader },
+	{ "bright", "jni/shaders/full_screen.vert", "jni/shaders/bright.frag", fullScreenVertexShader, brightFragmentShader },
+	{ "blur", "jni/shaders/full_screen.vert", "jni/shaders/blur.frag", fullScreenVertexShader, blurFragmentShader }
+};
+const int32_t programCount = sizeof(programs) / sizeof(programs[0]);
+
+static bool readFile(const char* path, std::string* text) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		printf("could not open %s; run from the repository root\n", path);
+		return false;
+	}
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		text->append(buffer, read);
+	}
+	fclose(file);
+	return true;
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+// Nanoseconds to compile and link, or -1 if it failed.
+static int64_t buildProgram(const char* vertexSource, const char* fragmentSource, const char* name) {
+	int64_t start = nowNanoseconds();
+	GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	int64_t elapsed = nowNanoseconds() - start;
+	if (!linked) {
+		char log[1024] = "";
+		glGetShaderInfoLog(vertex, sizeof(log), NULL, log);
+		printf("%s: vertex shader: %s\n", name, log);
+		glGetShaderInfoLog(fragment, sizeof(log), NULL, log);
+		printf("%s: fragment shader: %s\n", name, log);
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		printf("%s: program: %s\n", name, log);
+	}
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	glDeleteProgram(program);
+	return linked ? elapsed : -1;
+}
+
+static double median(std::vector<int64_t>* values) {
+	std::sort(values->begin(), values->end());
+	return (*values)[values->size() / 2] * 1e-6;
+}
+
+int main(int argc, char** argv) {
+	int32_t iterations = argc > 1 ? atoi(argv[1]) : 50;
+	if (iterations < 1) {
+		printf("Usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+	// otherwise every compile after the first is a cache hit
+	setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(display, NULL, NULL)) {
+		printf("no EGL display; on Mesa try EGL_PLATFORM=surfaceless\n");
+		return 1;
+	}
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, 0x40, // EGL_OPENGL_ES3_BIT_KHR, for the scene es3 program
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+		printf("no OpenGL ES 3 capable config\n");
+		return 1;
+	}
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+	const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+		printf("could not make a context current: 0x%04x\n", eglGetError());
+		return 1;
+	}
+	printf("%s, %d iterations\n\n", glGetString(GL_RENDERER), iterations);
+	printf("%-10s %14s %14s %12s %12s\n", "program", "source bytes", "generated", "compile ms", "generated");
+
+	bool failed = false;
+	double totalBefore = 0.0, totalAfter = 0.0;
+	for (int32_t p = 0; p < programCount; ++p) {
+		const BenchProgram* program = &programs[p];
+		std::string vertexSource, fragmentSource;
+		if (!readFile(program->vertexPath, &vertexSource) || !readFile(program->fragmentPath, &fragmentSource)) {
+			return 1;
+		}
+		std::vector<int64_t> before, after;
+		for (int32_t i = 0; i < iterations && !failed; ++i) {
+			int64_t readable = buildProgram(vertexSource.c_str(), fragmentSource.c_str(), program->name);
+			int64_t generated = buildProgram(program->vertexShader, program->fragmentShader, program->name);
+			failed = readable < 0 || generated < 0;
+			before.push_back(readable);
+			after.push_back(generated);
+		}
+		if (failed) {
+			break;
+		}
+		double beforeMilliseconds = median(&before), afterMilliseconds = median(&after);
+		totalBefore += beforeMilliseconds;
+		totalAfter += afterMilliseconds;
+		printf("%-10s %14zu %14zu %12.3f %12.3f\n", program->name, vertexSource.size() + fragmentSource.size(),
+			strlen(program->vertexShader) + strlen(program->fragmentShader), beforeMilliseconds, afterMilliseconds);
+	}
+	if (!failed) {
+		printf("%-10s %14s %14s %12.3f %12.3f  (%.1f%%)\n", "total", "", "", totalBefore, totalAfter,
+			100.0 * (totalAfter - totalBefore) / totalBefore);
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglDestroySurface(display, surface);
+	eglTerminate(display);
+	return failed ? 1 : 0;
+}
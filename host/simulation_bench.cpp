@@ -0,0 +1,119 @@
+// Times the fixed-timestep stage in jni/simulation.cpp on the host: the cost of a tick and of the
+// render interpolation for a large entity count, with and without wrapping, and checks that the
+// interpolated positions stay on the entities' paths.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o simulation_bench host/simulation_bench.cpp jni/simulation.cpp memory_tracker.o
+// Usage:        simulation_bench [entities] [frames]
+
+#include "../jni/simulation.h"
+#include "../jni/memory_tracker.h"
+#include "../jni/time_utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const int32_t ticksPerSecond = 60;
+const float boundsSize = 1000.0f;
+
+static uint32_t seed = 12345;
+
+static float nextRandom() {
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static bool fillSimulation(Simulation* simulation, int32_t count) {
+	if (!initSimulation(simulation, count, ticksPerSecond, 5)) {
+		printf("FAIL: could not allocate %d entities\n", count);
+		return false;
+	}
+	for (int32_t i = 0; i < count; ++i) {
+		addSimulationEntity(simulation, nextRandom() * boundsSize, nextRandom() * boundsSize, (nextRandom() - 0.5f) * 400.0f,
+			(nextRandom() - 0.5f) * 400.0f);
+	}
+	return true;
+}
+
+// Render positions must lie between the last two ticks, or be a wrap away from that.
+static bool checkInterpolation(const Simulation* simulation) {
+	const SimulationEntities* e = &simulation->entities;
+	for (int32_t i = 0; i < e->count; ++i) {
+		float expectedX = e->prevX[i] + (e->currX[i] - e->prevX[i]) * simulation->alpha;
+		float expectedY = e->prevY[i] + (e->currY[i] - e->prevY[i]) * simulation->alpha;
+		if (fabsf(e->renderX[i] - expectedX) > 1e-3f || fabsf(e->renderY[i] - expectedY) > 1e-3f ||
+			fabsf(e->currX[i] - e->prevX[i]) > 400.0f / ticksPerSecond || fabsf(e->currY[i] - e->prevY[i]) > 400.0f / ticksPerSecond) {
+			printf("FAIL: entity %d is off its path\n", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool run(int32_t count, int32_t frames, bool wrap) {
+	Simulation simulation;
+	if (!fillSimulation(&simulation, count)) {
+		return false;
+	}
+	if (wrap) {
+		setSimulationBounds(&simulation, boundsSize, boundsSize);
+	}
+	// warm up the caches
+	stepSimulation(&simulation);
+	interpolateSimulation(&simulation, 0.5f);
+
+	int64_t tickNanoseconds = 0;
+	int64_t interpolateNanoseconds = 0;
+	for (int32_t frame = 0; frame < frames; ++frame) {
+		int64_t start = nowNanoseconds();
+		stepSimulation(&simulation);
+		int64_t stepped = nowNanoseconds();
+		interpolateSimulation(&simulation, (frame % 16) / 16.0f);
+		tickNanoseconds += stepped - start;
+		interpolateNanoseconds += nowNanoseconds() - stepped;
+	}
+	bool ok = checkInterpolation(&simulation);
+	printf("  %-12s tick %7.3f ms (%5.2f ns per entity), interpolation %7.3f ms (%5.2f ns per entity)\n", wrap ? "wrapping" : "unbounded",
+		tickNanoseconds * 1e-6 / frames, static_cast<double>(tickNanoseconds) / frames / count, interpolateNanoseconds * 1e-6 / frames,
+		static_cast<double>(interpolateNanoseconds) / frames / count);
+	termSimulation(&simulation);
+	return ok;
+}
+
+// A frame loop that falls behind runs at most the cap and drops the rest.
+static bool checkCatchUp() {
+	Simulation simulation;
+	if (!fillSimulation(&simulation, 4)) {
+		return false;
+	}
+	int64_t tick = simulation.tickNanoseconds;
+	advanceSimulation(&simulation, tick);
+	int32_t ticks = advanceSimulation(&simulation, tick * 21 + tick / 2);
+	bool ok = ticks == 5 && simulation.droppedTicks == 15 && fabsf(simulation.alpha - 0.5f) < 1e-3f;
+	printf("catch up: %s\n", ok ? "capped at 5 ticks, the backlog dropped" : "FAIL: wrong ticks after a stall");
+	termSimulation(&simulation);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	int32_t count = argc >= 2 ? atoi(argv[1]) : 100000;
+	int32_t frames = argc >= 3 ? atoi(argv[2]) : 1000;
+	if (count <= 0 || frames <= 0) {
+		printf("Usage: simulation_bench [entities] [frames]\n");
+		return 1;
+	}
+	bool ok = checkCatchUp();
+	printf("%d entities, %d frames of one tick each:\n", count, frames);
+	ok = run(count, frames, false) && ok;
+	ok = run(count, frames, true) && ok;
+
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	if (MEMORY_TRACKING && snapshot.heap[MEMORY_TAG_SIMULATION].liveAllocations != 0) {
+		printf("FAIL: simulation arrays leaked\n");
+		ok = false;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
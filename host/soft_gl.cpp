@@ -0,0 +1,458 @@
+#include "soft_gl.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool growArray(void** array, int32_t* capacity, int32_t needed, size_t elementSize) {
+	if (needed <= *capacity) {
+		return true;
+	}
+	int32_t newCapacity = *capacity ? *capacity : 64;
+	while (newCapacity < needed) {
+		newCapacity *= 2;
+	}
+	void* grown = realloc(*array, newCapacity * elementSize);
+	if (!grown) {
+		return false;
+	}
+	*array = grown;
+	*capacity = newCapacity;
+	return true;
+}
+
+static uint32_t packColor(const float c[4]) {
+	uint32_t packed = 0;
+	for (int i = 0; i < 4; ++i) {
+		float v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+		packed |= static_cast<uint32_t>(v * 255.0f + 0.5f) << (i * 8);
+	}
+	return packed;
+}
+
+static void unpackColor(uint32_t packed, float c[4]) {
+	for (int i = 0; i < 4; ++i) {
+		c[i] = ((packed >> (i * 8)) & 0xff) * (1.0f / 255.0f);
+	}
+}
+
+bool initSoftContext(SoftContext* context, int32_t width, int32_t height, WorkerPool* workers) {
+	memset(context, 0, sizeof(SoftContext));
+	context->width = width;
+	context->height = height;
+	context->tilesX = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	context->tilesY = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	context->color = static_cast<uint32_t*>(calloc(width * height, sizeof(uint32_t)));
+	context->bins = static_cast<SoftTileBin*>(calloc(context->tilesX * context->tilesY, sizeof(SoftTileBin)));
+	context->tileStats = static_cast<SoftStats*>(calloc(context->tilesX * context->tilesY, sizeof(SoftStats)));
+	if (!context->color || !context->bins || !context->tileStats) {
+		termSoftContext(context);
+		return false;
+	}
+	context->viewportWidth = width;
+	context->viewportHeight = height;
+	context->scissorWidth = width;
+	context->scissorHeight = height;
+	context->workers = workers;
+	return true;
+}
+
+void termSoftContext(SoftContext* context) {
+	if (context->bins) {
+		for (int32_t i = 0; i < context->tilesX * context->tilesY; ++i) {
+			free(context->bins[i].triangles);
+		}
+	}
+	free(context->bins);
+	free(context->tileStats);
+	free(context->color);
+	free(context->triangles);
+	free(context->commands);
+	free(context->uniforms);
+	free(context->vertices);
+	memset(context, 0, sizeof(SoftContext));
+}
+
+void softViewport(SoftContext* context, int32_t x, int32_t y, int32_t width, int32_t height) {
+	context->viewportX = x;
+	context->viewportY = y;
+	context->viewportWidth = width;
+	context->viewportHeight = height;
+}
+
+void softScissor(SoftContext* context, int32_t x, int32_t y, int32_t width, int32_t height) {
+	context->scissorX = x;
+	context->scissorY = y;
+	context->scissorWidth = width;
+	context->scissorHeight = height;
+}
+
+void softEnableScissor(SoftContext* context, bool enabled) {
+	context->scissorEnabled = enabled;
+}
+
+void softClearColor(SoftContext* context, float r, float g, float b, float a) {
+	context->clearColor[0] = r;
+	context->clearColor[1] = g;
+	context->clearColor[2] = b;
+	context->clearColor[3] = a;
+}
+
+void softBlend(SoftContext* context, SoftBlend blend) {
+	context->blend = blend;
+}
+
+static bool clipRect(const SoftContext* context, bool viewport, SoftCommand* command) {
+	command->minX = 0;
+	command->minY = 0;
+	command->maxX = context->width - 1;
+	command->maxY = context->height - 1;
+	if (context->scissorEnabled) {
+		if (context->scissorX > command->minX) command->minX = context->scissorX;
+		if (context->scissorY > command->minY) command->minY = context->scissorY;
+		if (context->scissorX + context->scissorWidth - 1 < command->maxX) command->maxX = context->scissorX + context->scissorWidth - 1;
+		if (context->scissorY + context->scissorHeight - 1 < command->maxY) command->maxY = context->scissorY + context->scissorHeight - 1;
+	}
+	if (viewport) {
+		if (context->viewportX > command->minX) command->minX = context->viewportX;
+		if (context->viewportY > command->minY) command->minY = context->viewportY;
+		if (context->viewportX + context->viewportWidth - 1 < command->maxX) command->maxX = context->viewportX + context->viewportWidth - 1;
+		if (context->viewportY + context->viewportHeight - 1 < command->maxY) command->maxY = context->viewportY + context->viewportHeight - 1;
+	}
+	return command->minX <= command->maxX && command->minY <= command->maxY;
+}
+
+static SoftCommand* appendCommand(SoftContext* context) {
+	if (!growArray(reinterpret_cast<void**>(&context->commands), &context->commandCapacity, context->commandCount + 1, sizeof(SoftCommand))) {
+		return NULL;
+	}
+	SoftCommand* command = &context->commands[context->commandCount];
+	memset(command, 0, sizeof(SoftCommand));
+	return command;
+}
+
+void softClear(SoftContext* context) {
+	SoftCommand* command = appendCommand(context);
+	if (!command || !clipRect(context, false, command)) {
+		return;
+	}
+	command->type = SOFT_COMMAND_CLEAR;
+	command->clearColor = packColor(context->clearColor);
+	++context->commandCount;
+}
+
+static void binTriangle(SoftContext* context, SoftTriangle* triangle, const SoftCommand* command, int32_t index) {
+	float minX = fminf(triangle->x[0], fminf(triangle->x[1], triangle->x[2]));
+	float maxX = fmaxf(triangle->x[0], fmaxf(triangle->x[1], triangle->x[2]));
+	float minY = fminf(triangle->y[0], fminf(triangle->y[1], triangle->y[2]));
+	float maxY = fmaxf(triangle->y[0], fmaxf(triangle->y[1], triangle->y[2]));
+	// pixels whose centres can be covered
+	triangle->minX = static_cast<int32_t>(ceilf(minX - 0.5f));
+	triangle->maxX = static_cast<int32_t>(floorf(maxX - 0.5f));
+	triangle->minY = static_cast<int32_t>(ceilf(minY - 0.5f));
+	triangle->maxY = static_cast<int32_t>(floorf(maxY - 0.5f));
+	if (triangle->minX < command->minX) triangle->minX = command->minX;
+	if (triangle->minY < command->minY) triangle->minY = command->minY;
+	if (triangle->maxX > command->maxX) triangle->maxX = command->maxX;
+	if (triangle->maxY > command->maxY) triangle->maxY = command->maxY;
+	if (triangle->minX > triangle->maxX || triangle->minY > triangle->maxY) {
+		return;
+	}
+
+	for (int32_t ty = triangle->minY / SOFT_TILE_SIZE; ty <= triangle->maxY / SOFT_TILE_SIZE; ++ty) {
+		for (int32_t tx = triangle->minX / SOFT_TILE_SIZE; tx <= triangle->maxX / SOFT_TILE_SIZE; ++tx) {
+			SoftTileBin* bin = &context->bins[ty * context->tilesX + tx];
+			if (growArray(reinterpret_cast<void**>(&bin->triangles), &bin->capacity, bin->count + 1, sizeof(int32_t))) {
+				bin->triangles[bin->count++] = index;
+				++context->stats.binnedTriangles;
+			}
+		}
+	}
+}
+
+static void toWindow(const SoftContext* context, const SoftVertexOutput* v, float* x, float* y) {
+	float invW = 1.0f / v->position[3];
+	*x = context->viewportX + (v->position[0] * invW * 0.5f + 0.5f) * context->viewportWidth;
+	*y = context->viewportY + (v->position[1] * invW * 0.5f + 0.5f) * context->viewportHeight;
+}
+
+static SoftTriangle* appendTriangle(SoftContext* context) {
+	if (!growArray(reinterpret_cast<void**>(&context->triangles), &context->triangleCapacity, context->triangleCount + 1, sizeof(SoftTriangle))) {
+		return NULL;
+	}
+	return &context->triangles[context->triangleCount];
+}
+
+static void setupTriangle(SoftContext* context, SoftCommand* command, const SoftVertexOutput* const v[3]) {
+	// no clipping: the app's programs keep w = 1, so only fully behind-the-eye triangles need rejecting
+	if (v[0]->position[3] <= 0.0f || v[1]->position[3] <= 0.0f || v[2]->position[3] <= 0.0f) {
+		return;
+	}
+	SoftTriangle* triangle = appendTriangle(context);
+	if (!triangle) {
+		return;
+	}
+	for (int k = 0; k < 3; ++k) {
+		toWindow(context, v[k], &triangle->x[k], &triangle->y[k]);
+		memcpy(triangle->varyings[k], v[k]->varyings, command->program->varyingCount * sizeof(float));
+	}
+	binTriangle(context, triangle, command, context->triangleCount++);
+	++command->triangleCount;
+	++context->stats.triangles;
+}
+
+static void setupPoint(SoftContext* context, SoftCommand* command, const SoftVertexOutput* v) {
+	if (v->position[3] <= 0.0f) {
+		return;
+	}
+	float x, y;
+	toWindow(context, v, &x, &y);
+	float h = v->pointSize * 0.5f;
+	// corners top left, top right, bottom left, bottom right; gl_PointCoord has t pointing down
+	const float cx[4] = { x - h, x + h, x - h, x + h };
+	const float cy[4] = { y + h, y + h, y - h, y - h };
+	const float s[4] = { 0.0f, 1.0f, 0.0f, 1.0f };
+	const float t[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	const int corners[2][3] = { { 0, 2, 1 }, { 1, 2, 3 } };
+	int32_t varyingCount = command->program->varyingCount;
+	for (int i = 0; i < 2; ++i) {
+		SoftTriangle* triangle = appendTriangle(context);
+		if (!triangle) {
+			return;
+		}
+		for (int k = 0; k < 3; ++k) {
+			int c = corners[i][k];
+			triangle->x[k] = cx[c];
+			triangle->y[k] = cy[c];
+			memcpy(triangle->varyings[k], v->varyings, varyingCount * sizeof(float));
+			triangle->varyings[k][varyingCount] = s[c];
+			triangle->varyings[k][varyingCount + 1] = t[c];
+		}
+		binTriangle(context, triangle, command, context->triangleCount++);
+		++command->triangleCount;
+		++context->stats.triangles;
+	}
+}
+
+void softDrawArrays(SoftContext* context, const SoftProgram* program, const void* uniforms, SoftPrimitive primitive,
+	const float* attributes, int32_t stride, int32_t first, int32_t count) {
+	SoftCommand* command = appendCommand(context);
+	if (!command || !clipRect(context, true, command)) {
+		return;
+	}
+	++context->stats.draws;
+
+	size_t uniformOffset = (context->uniformsUsed + 15) & ~static_cast<size_t>(15);
+	if (uniformOffset + program->uniformSize > context->uniformsCapacity) {
+		size_t capacity = context->uniformsCapacity ? context->uniformsCapacity : 4096;
+		while (capacity < uniformOffset + program->uniformSize) {
+			capacity *= 2;
+		}
+		uint8_t* grown = static_cast<uint8_t*>(realloc(context->uniforms, capacity));
+		if (!grown) {
+			return;
+		}
+		context->uniforms = grown;
+		context->uniformsCapacity = capacity;
+	}
+	memcpy(context->uniforms + uniformOffset, uniforms, program->uniformSize);
+	context->uniformsUsed = uniformOffset + program->uniformSize;
+
+	command->type = SOFT_COMMAND_DRAW;
+	command->program = program;
+	command->uniformOffset = uniformOffset;
+	command->firstTriangle = context->triangleCount;
+	command->blend = context->blend;
+	command->point = primitive == SOFT_POINTS;
+	++context->commandCount;
+
+	if (!growArray(reinterpret_cast<void**>(&context->vertices), &context->vertexCapacity, count, sizeof(SoftVertexOutput))) {
+		return;
+	}
+	for (int32_t i = 0; i < count; ++i) {
+		memset(&context->vertices[i], 0, sizeof(SoftVertexOutput));
+		context->vertices[i].pointSize = 1.0f;
+		program->vertex(uniforms, attributes + (first + i) * stride, &context->vertices[i]);
+	}
+
+	if (primitive == SOFT_POINTS) {
+		for (int32_t i = 0; i < count; ++i) {
+			setupPoint(context, command, &context->vertices[i]);
+		}
+	} else {
+		for (int32_t i = 0; i + 2 < count; i += 3) {
+			const SoftVertexOutput* v[3] = { &context->vertices[i], &context->vertices[i + 1], &context->vertices[i + 2] };
+			setupTriangle(context, command, v);
+		}
+	}
+}
+
+static bool isTopLeft(float ax, float ay, float bx, float by) {
+	float dx = bx - ax;
+	float dy = by - ay;
+	return dy < 0.0f || (dy == 0.0f && dx < 0.0f);
+}
+
+static void rasterizeTriangle(SoftContext* context, const SoftCommand* command, const SoftTriangle* triangle,
+	int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, SoftStats* stats) {
+	int i0 = 0, i1 = 1, i2 = 2;
+	float area = (triangle->x[1] - triangle->x[0]) * (triangle->y[2] - triangle->y[0]) -
+		(triangle->x[2] - triangle->x[0]) * (triangle->y[1] - triangle->y[0]);
+	if (area == 0.0f) {
+		return;
+	}
+	if (area < 0.0f) {
+		// no face culling in the app, so make every triangle counter-clockwise
+		i1 = 2;
+		i2 = 1;
+		area = -area;
+	}
+	const float x0 = triangle->x[i0], y0 = triangle->y[i0];
+	const float x1 = triangle->x[i1], y1 = triangle->y[i1];
+	const float x2 = triangle->x[i2], y2 = triangle->y[i2];
+	const float invArea = 1.0f / area;
+	const bool topLeft12 = isTopLeft(x1, y1, x2, y2);
+	const bool topLeft20 = isTopLeft(x2, y2, x0, y0);
+	const bool topLeft01 = isTopLeft(x0, y0, x1, y1);
+
+	const SoftProgram* program = command->program;
+	const void* uniforms = context->uniforms + command->uniformOffset;
+	const int32_t varyingCount = program->varyingCount + (command->point ? 2 : 0);
+	float varyings[SOFT_MAX_VARYINGS + 2];
+	float pointCoord[2] = { 0.0f, 0.0f };
+
+	for (int32_t py = minY; py <= maxY; ++py) {
+		float sy = py + 0.5f;
+		uint32_t* row = context->color + (context->height - 1 - py) * context->width;
+		for (int32_t px = minX; px <= maxX; ++px) {
+			float sx = px + 0.5f;
+			float e12 = (x2 - x1) * (sy - y1) - (y2 - y1) * (sx - x1);
+			float e20 = (x0 - x2) * (sy - y2) - (y0 - y2) * (sx - x2);
+			float e01 = (x1 - x0) * (sy - y0) - (y1 - y0) * (sx - x0);
+			if (e12 < 0.0f || e20 < 0.0f || e01 < 0.0f ||
+				(e12 == 0.0f && !topLeft12) || (e20 == 0.0f && !topLeft20) || (e01 == 0.0f && !topLeft01)) {
+				continue;
+			}
+			float b0 = e12 * invArea;
+			float b1 = e20 * invArea;
+			float b2 = e01 * invArea;
+			for (int32_t k = 0; k < varyingCount; ++k) {
+				varyings[k] = b0 * triangle->varyings[i0][k] + b1 * triangle->varyings[i1][k] + b2 * triangle->varyings[i2][k];
+			}
+			if (command->point) {
+				pointCoord[0] = varyings[program->varyingCount];
+				pointCoord[1] = varyings[program->varyingCount + 1];
+			}
+
+			float color[4];
+			++stats->fragmentsShaded;
+			if (!program->fragment(uniforms, varyings, pointCoord, color)) {
+				continue;
+			}
+			if (command->blend != SOFT_BLEND_NONE) {
+				float dst[4];
+				unpackColor(row[px], dst);
+				float a = color[3] < 0.0f ? 0.0f : (color[3] > 1.0f ? 1.0f : color[3]);
+				float dstFactor = command->blend == SOFT_BLEND_ALPHA ? 1.0f - a : 1.0f;
+				for (int k = 0; k < 4; ++k) {
+					color[k] = color[k] * a + dst[k] * dstFactor;
+				}
+			}
+			row[px] = packColor(color);
+			++stats->pixelsWritten;
+		}
+	}
+}
+
+static void rasterizeTiles(void* data, int32_t begin, int32_t end) {
+	SoftContext* context = static_cast<SoftContext*>(data);
+	for (int32_t tile = begin; tile < end; ++tile) {
+		int32_t tileMinX = (tile % context->tilesX) * SOFT_TILE_SIZE;
+		int32_t tileMinY = (tile / context->tilesX) * SOFT_TILE_SIZE;
+		int32_t tileMaxX = tileMinX + SOFT_TILE_SIZE - 1 < context->width - 1 ? tileMinX + SOFT_TILE_SIZE - 1 : context->width - 1;
+		int32_t tileMaxY = tileMinY + SOFT_TILE_SIZE - 1 < context->height - 1 ? tileMinY + SOFT_TILE_SIZE - 1 : context->height - 1;
+		const SoftTileBin* bin = &context->bins[tile];
+		SoftStats* stats = &context->tileStats[tile];
+		int32_t cursor = 0;
+
+		for (int32_t c = 0; c < context->commandCount; ++c) {
+			const SoftCommand* command = &context->commands[c];
+			int32_t minX = command->minX > tileMinX ? command->minX : tileMinX;
+			int32_t minY = command->minY > tileMinY ? command->minY : tileMinY;
+			int32_t maxX = command->maxX < tileMaxX ? command->maxX : tileMaxX;
+			int32_t maxY = command->maxY < tileMaxY ? command->maxY : tileMaxY;
+
+			if (command->type == SOFT_COMMAND_CLEAR) {
+				for (int32_t y = minY; y <= maxY; ++y) {
+					uint32_t* row = context->color + (context->height - 1 - y) * context->width;
+					for (int32_t x = minX; x <= maxX; ++x) {
+						row[x] = command->clearColor;
+					}
+				}
+				if (maxX >= minX && maxY >= minY) {
+					stats->clearedPixels += static_cast<uint64_t>(maxX - minX + 1) * (maxY - minY + 1);
+				}
+				continue;
+			}
+
+			// bins hold triangle indices in submission order, so one cursor walks them alongside the commands
+			int32_t end = command->firstTriangle + command->triangleCount;
+			for (; cursor < bin->count && bin->triangles[cursor] < end; ++cursor) {
+				const SoftTriangle* triangle = &context->triangles[bin->triangles[cursor]];
+				rasterizeTriangle(context, command, triangle,
+					triangle->minX > minX ? triangle->minX : minX, triangle->minY > minY ? triangle->minY : minY,
+					triangle->maxX < maxX ? triangle->maxX : maxX, triangle->maxY < maxY ? triangle->maxY : maxY, stats);
+			}
+		}
+	}
+}
+
+void softFinish(SoftContext* context) {
+	int32_t tileCount = context->tilesX * context->tilesY;
+	memset(context->tileStats, 0, tileCount * sizeof(SoftStats));
+	if (context->workers) {
+		runParallel(context->workers, rasterizeTiles, context, tileCount, 1);
+	} else {
+		rasterizeTiles(context, 0, tileCount);
+	}
+
+	for (int32_t i = 0; i < tileCount; ++i) {
+		context->stats.fragmentsShaded += context->tileStats[i].fragmentsShaded;
+		context->stats.pixelsWritten += context->tileStats[i].pixelsWritten;
+		context->stats.clearedPixels += context->tileStats[i].clearedPixels;
+		context->bins[i].count = 0;
+	}
+	context->triangleCount = 0;
+	context->commandCount = 0;
+	context->uniformsUsed = 0;
+}
+
+int64_t compareSoftImages(const uint32_t* a, const uint32_t* b, int32_t width, int32_t height, int32_t tolerance) {
+	int64_t mismatches = 0;
+	for (int64_t i = 0; i < static_cast<int64_t>(width) * height; ++i) {
+		for (int k = 0; k < 4; ++k) {
+			int32_t ca = (a[i] >> (k * 8)) & 0xff;
+			int32_t cb = (b[i] >> (k * 8)) & 0xff;
+			if (ca - cb > tolerance || cb - ca > tolerance) {
+				++mismatches;
+				break;
+			}
+		}
+	}
+	return mismatches;
+}
+
+bool writeSoftImagePPM(const SoftContext* context, const char* path) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", context->width, context->height);
+	for (int32_t i = 0; i < context->width * context->height; ++i) {
+		uint32_t c = context->color[i];
+		unsigned char rgb[3] = { static_cast<unsigned char>(c), static_cast<unsigned char>(c >> 8), static_cast<unsigned char>(c >> 16) };
+		fwrite(rgb, 1, 3, file);
+	}
+	return fclose(file) == 0;
+}
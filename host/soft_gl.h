@@ -0,0 +1,137 @@
+#pragma once
+
+// Software implementation of the GLES2 subset the app uses, for headless correctness and
+// performance tests on the host. Shaders are plain C++ functions mirroring the GLSL in jni/.
+//
+// Draws are recorded, vertex shaded and binned into screen tiles as they are submitted;
+// softFinish() then rasterizes and shades every tile in parallel, replaying clears and
+// draws per tile in submission order. Interpolation is linear in screen space, which is
+// exact for the app's programs since they all output w = 1.
+
+#include "../jni/worker_pool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SOFT_MAX_VARYINGS 8
+#define SOFT_TILE_SIZE 64
+
+enum SoftPrimitive {
+	SOFT_TRIANGLES,
+	SOFT_POINTS
+};
+
+enum SoftBlend {
+	SOFT_BLEND_NONE,
+	SOFT_BLEND_ALPHA, // SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+	SOFT_BLEND_ADDITIVE // SRC_ALPHA, ONE
+};
+
+struct SoftVertexOutput {
+	float position[4];
+	float pointSize;
+	float varyings[SOFT_MAX_VARYINGS];
+};
+
+typedef void (*SoftVertexShader)(const void* uniforms, const float* attributes, SoftVertexOutput* out);
+// Returns false to discard the fragment. pointCoord is (0, 0) for triangles.
+typedef bool (*SoftFragmentShader)(const void* uniforms, const float* varyings, const float pointCoord[2], float color[4]);
+
+struct SoftProgram {
+	SoftVertexShader vertex;
+	SoftFragmentShader fragment;
+	int32_t varyingCount;
+	size_t uniformSize;
+};
+
+struct SoftStats {
+	uint64_t draws;
+	uint64_t triangles;
+	uint64_t binnedTriangles; // one per tile a triangle touches
+	uint64_t fragmentsShaded;
+	uint64_t pixelsWritten;
+	uint64_t clearedPixels;
+};
+
+struct SoftTriangle {
+	float x[3];
+	float y[3];
+	float varyings[3][SOFT_MAX_VARYINGS + 2]; // point sprites append gl_PointCoord
+	int32_t minX, minY, maxX, maxY;
+};
+
+enum SoftCommandType {
+	SOFT_COMMAND_CLEAR,
+	SOFT_COMMAND_DRAW
+};
+
+struct SoftCommand {
+	SoftCommandType type;
+	int32_t minX, minY, maxX, maxY; // inclusive, window coordinates with y up
+	uint32_t clearColor;
+	const SoftProgram* program;
+	size_t uniformOffset;
+	int32_t firstTriangle;
+	int32_t triangleCount;
+	SoftBlend blend;
+	bool point;
+};
+
+struct SoftTileBin {
+	int32_t* triangles;
+	int32_t count;
+	int32_t capacity;
+};
+
+struct SoftContext {
+	int32_t width;
+	int32_t height;
+	uint32_t* color; // RGBA8, red in the low byte, top row first
+	int32_t tilesX;
+	int32_t tilesY;
+	SoftTileBin* bins;
+	SoftStats* tileStats;
+
+	SoftTriangle* triangles;
+	int32_t triangleCount;
+	int32_t triangleCapacity;
+	SoftCommand* commands;
+	int32_t commandCount;
+	int32_t commandCapacity;
+	uint8_t* uniforms;
+	size_t uniformsUsed;
+	size_t uniformsCapacity;
+	SoftVertexOutput* vertices;
+	int32_t vertexCapacity;
+
+	int32_t viewportX, viewportY, viewportWidth, viewportHeight;
+	bool scissorEnabled;
+	int32_t scissorX, scissorY, scissorWidth, scissorHeight;
+	float clearColor[4];
+	SoftBlend blend;
+
+	WorkerPool* workers;
+	SoftStats stats;
+};
+
+// workers may be NULL to rasterize on the calling thread.
+bool initSoftContext(SoftContext* context, int32_t width, int32_t height, WorkerPool* workers);
+void termSoftContext(SoftContext* context);
+
+void softViewport(SoftContext* context, int32_t x, int32_t y, int32_t width, int32_t height);
+void softScissor(SoftContext* context, int32_t x, int32_t y, int32_t width, int32_t height);
+void softEnableScissor(SoftContext* context, bool enabled);
+void softClearColor(SoftContext* context, float r, float g, float b, float a);
+void softClear(SoftContext* context);
+void softBlend(SoftContext* context, SoftBlend blend);
+
+// attributes holds count vertices of stride floats each, starting at vertex first.
+void softDrawArrays(SoftContext* context, const SoftProgram* program, const void* uniforms, SoftPrimitive primitive,
+	const float* attributes, int32_t stride, int32_t first, int32_t count);
+
+// Executes everything recorded since the last call, like glFinish.
+void softFinish(SoftContext* context);
+
+// Golden image helpers: count pixels where any channel differs by more than tolerance.
+int64_t compareSoftImages(const uint32_t* a, const uint32_t* b, int32_t width, int32_t height, int32_t tolerance);
+bool writeSoftImagePPM(const SoftContext* context, const char* path);
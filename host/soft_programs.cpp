@@ -0,0 +1,82 @@
+#include "soft_programs.h"
+
+#include <string.h>
+
+static void pixelToClip(const float* screenSize, float x, float y, SoftVertexOutput* out) {
+	out->position[0] = x / screenSize[0] * 2.0f - 1.0f;
+	out->position[1] = 1.0f - y / screenSize[1] * 2.0f;
+	out->position[2] = 0.0f;
+	out->position[3] = 1.0f;
+}
+
+static float clamp01(float v) {
+	return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static void sceneVertex(const void* uniforms, const float* attributes, SoftVertexOutput* out) {
+	const SoftSceneUniforms* u = static_cast<const SoftSceneUniforms*>(uniforms);
+	// position is a vec4 fed from two components, so z = 0
+	out->varyings[0] = attributes[0] * 0.5f + 0.5f;
+	out->varyings[1] = attributes[1] * 0.5f + 0.5f;
+	out->varyings[2] = 0.5f;
+	float x = u->transformX[0] * attributes[0] + u->transformX[1] * attributes[1] + u->transformX[2];
+	float y = u->transformY[0] * attributes[0] + u->transformY[1] * attributes[1] + u->transformY[2];
+	pixelToClip(u->screenSize, x, y, out);
+}
+
+static bool sceneFragment(const void*, const float* varyings, const float*, float color[4]) {
+	color[0] = varyings[0];
+	color[1] = varyings[1];
+	color[2] = varyings[2];
+	color[3] = 1.0f;
+	return true;
+}
+
+static void particleVertex(const void* uniforms, const float* attributes, SoftVertexOutput* out) {
+	const SoftParticleUniforms* u = static_cast<const SoftParticleUniforms*>(uniforms);
+	float life = attributes[2];
+	out->varyings[0] = life;
+	out->pointSize = u->pointSize * (0.5f + 0.5f * life);
+	pixelToClip(u->screenSize, attributes[0], attributes[1], out);
+}
+
+static bool particleFragment(const void*, const float* varyings, const float* pointCoord, float color[4]) {
+	float dx = pointCoord[0] - 0.5f;
+	float dy = pointCoord[1] - 0.5f;
+	float a = clamp01(1.0f - (dx * dx + dy * dy) * 4.0f);
+	float life = varyings[0];
+	color[0] = 1.0f;
+	color[1] = 0.6f + 0.4f * life;
+	color[2] = 0.2f;
+	color[3] = a * life;
+	return true;
+}
+
+static void textVertex(const void* uniforms, const float* attributes, SoftVertexOutput* out) {
+	const SoftTextUniforms* u = static_cast<const SoftTextUniforms*>(uniforms);
+	uint32_t packed;
+	memcpy(&packed, &attributes[4], sizeof(packed));
+	out->varyings[0] = attributes[2];
+	out->varyings[1] = attributes[3];
+	for (int i = 0; i < 4; ++i) {
+		out->varyings[2 + i] = ((packed >> (i * 8)) & 0xff) * (1.0f / 255.0f);
+	}
+	pixelToClip(u->screenSize, attributes[0], attributes[1], out);
+}
+
+static bool textFragment(const void* uniforms, const float* varyings, const float*, float color[4]) {
+	const SoftTexture* atlas = &static_cast<const SoftTextUniforms*>(uniforms)->atlas;
+	int32_t x = static_cast<int32_t>(varyings[0] * atlas->width);
+	int32_t y = static_cast<int32_t>(varyings[1] * atlas->height);
+	x = x < 0 ? 0 : (x >= atlas->width ? atlas->width - 1 : x);
+	y = y < 0 ? 0 : (y >= atlas->height ? atlas->height - 1 : y);
+	color[0] = varyings[2];
+	color[1] = varyings[3];
+	color[2] = varyings[4];
+	color[3] = varyings[5] * atlas->alpha[y * atlas->width + x] * (1.0f / 255.0f);
+	return true;
+}
+
+const SoftProgram softSceneProgram = { sceneVertex, sceneFragment, 3, sizeof(SoftSceneUniforms) };
+const SoftProgram softParticleProgram = { particleVertex, particleFragment, 1, sizeof(SoftParticleUniforms) };
+const SoftProgram softTextProgram = { textVertex, textFragment, 6, sizeof(SoftTextUniforms) };
@@ -0,0 +1,36 @@
+#pragma once
+
+// Software versions of the app's GLSL programs, see scene_es2, particle and text in
+// jni/shaders. Keep both in sync.
+
+#include "soft_gl.h"
+
+// attributes: position.xy (stride 2)
+struct SoftSceneUniforms {
+	float transformX[3];
+	float transformY[3];
+	float screenSize[2];
+};
+
+// attributes: ParticleVertex (stride 3)
+struct SoftParticleUniforms {
+	float screenSize[2];
+	float pointSize;
+};
+
+// Single channel texture sampled with GL_NEAREST and GL_CLAMP_TO_EDGE
+struct SoftTexture {
+	const uint8_t* alpha;
+	int32_t width;
+	int32_t height;
+};
+
+// attributes: TextVertex (stride 5, color read as packed RGBA8)
+struct SoftTextUniforms {
+	float screenSize[2];
+	SoftTexture atlas;
+};
+
+extern const SoftProgram softSceneProgram;
+extern const SoftProgram softParticleProgram;
+extern const SoftProgram softTextProgram;
@@ -0,0 +1,275 @@
+// Renders the app's frame on the host with the software rasterizer in host/soft_gl.cpp: the scene,
+// particles and text are set up with the app's own jni/ code, as drawFrame does, and their draws
+// replayed through softDrawArrays with the programs in host/soft_programs.cpp. Each frame is
+// compared with its reference image in host/reference, and the check fails if more pixels differ
+// than the tolerance allows. With --write the references are written instead.
+//
+// Build with:   cc -O2 -c jni/font8x8.c jni/shader_utils.c jni/memory_tracker.c
+//               c++ -O2 -o soft_render_check host/soft_render_check.cpp host/soft_gl.cpp host/soft_programs.cpp
+//                   jni/worker_pool.cpp jni/scene.cpp jni/particles.cpp jni/simulation.cpp jni/text_renderer.cpp
+//                   jni/glyph_atlas.cpp jni/stream_buffer.cpp jni/gpu_fence.cpp jni/gl_extensions.cpp
+//                   jni/upload_queue.cpp font8x8.o shader_utils.o memory_tracker.o -lGLESv2 -lEGL -lpthread
+// Usage:        soft_render_check [--write] [reference directory]
+//
+// Rewrite the references only after checking the new images by eye; a difference is either a
+// change to the app's rendering, which the shaders in host/soft_programs.cpp must follow, or a bug.
+
+#include "soft_gl.h"
+#include "soft_programs.h"
+#include "../jni/font8x8.h"
+#include "../jni/particles.h"
+#include "../jni/scene.h"
+#include "../jni/simulation.h"
+#include "../jni/text_renderer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// as in jni/main.cpp
+const float movingBlockSpeed = 60.0f;
+const int32_t particlesPerMotionSample = 16;
+const float particleSpeed = 200.0f;
+const float particleLifetime = 1.5f;
+const float particleSize = 12.0f;
+const int32_t textScale = 2;
+const Bounds2D triangleBounds = { -0.5f, -0.5f, 0.5f, 0.5f };
+static const float triangleVertices[] = {
+	 0.0f,  0.5f,
+	-0.5f, -0.5f,
+	 0.5f, -0.5f
+};
+
+const int32_t width = 256;
+const int32_t height = 192;
+// channel differences up to this are rounding; a few pixels may differ by more at triangle edges
+const int32_t channelTolerance = 4;
+const int64_t maxMismatchedPixels = width * height / 1000;
+
+struct FrameDesc {
+	const char* name;
+	float pointerX; // window pixels, y down, as the motion events give them
+	float pointerY;
+	int32_t touchSamples; // motion samples, each a burst of particles at the pointer
+	int32_t ticks; // simulation ticks run after the samples
+};
+
+static const FrameDesc frames[] = {
+	{ "idle", 64.0f, 48.0f, 0, 1 },
+	{ "touch", 160.0f, 120.0f, 4, 12 },
+};
+
+struct App {
+	Simulation simulation;
+	Scene scene;
+	Particles particles;
+	TextRenderer text;
+	int32_t movingBlock;
+	int32_t viewportNode;
+};
+
+static bool initApp(App* app) {
+	memset(app, 0, sizeof(App));
+	if (!initSimulation(&app->simulation, 1, 60, 5) || !initScene(&app->scene, 16, 64.0f, 8, 8) ||
+		!initParticles(&app->particles, 4096, NULL) || !initTextRenderer(&app->text, 256, 256)) {
+		return false;
+	}
+	app->movingBlock = addSimulationEntity(&app->simulation, 0.0f, 0.0f, movingBlockSpeed, 0.0f);
+	for (uint32_t c = FONT8X8_FIRST_CHAR; c <= FONT8X8_LAST_CHAR; ++c) {
+		findOrAddGlyph(&app->text.atlas, c, textScale);
+	}
+	const Bounds2D noBounds = { 0.0f, 0.0f, -1.0f, -1.0f };
+	app->viewportNode = addSceneNode(&app->scene, -1, &identityTransform, &noBounds);
+	addSceneNode(&app->scene, app->viewportNode, &identityTransform, &triangleBounds);
+	Transform2D viewport = { width * 0.5f, 0.0f, 0.0f, height * -0.5f, width * 0.5f, height * 0.5f };
+	setSceneNodeTransform(&app->scene, app->viewportNode, &viewport);
+	return true;
+}
+
+static void termApp(App* app) {
+	termTextRenderer(&app->text);
+	termParticles(&app->particles);
+	termScene(&app->scene);
+	termSimulation(&app->simulation);
+}
+
+static void clearRect(SoftContext* context, float x, float y, int32_t size, float value) {
+	softEnableScissor(context, true);
+	softScissor(context, static_cast<int32_t>(x), static_cast<int32_t>(y), size, size);
+	softClearColor(context, value, value, value, 1.0f);
+	softClear(context);
+	softEnableScissor(context, false);
+}
+
+// drawScenePass and drawOverlayPass at full resolution, with the draws going to the rasterizer
+static void renderFrame(App* app, SoftContext* context, const FrameDesc* desc) {
+	for (int32_t i = 0; i < desc->touchSamples; ++i) {
+		spawnParticles(&app->particles, desc->pointerX + i * 4.0f, desc->pointerY, particlesPerMotionSample, particleSpeed, particleLifetime);
+	}
+	for (int32_t i = 0; i < desc->ticks; ++i) {
+		stepSimulation(&app->simulation);
+	}
+	interpolateSimulation(&app->simulation, 0.5f);
+	updateParticles(&app->particles, desc->ticks * app->simulation.tickNanoseconds * 1e-9f);
+	float x = desc->pointerX / width;
+	float y = desc->pointerY / height;
+
+	softViewport(context, 0, 0, width, height);
+	softBlend(context, SOFT_BLEND_NONE);
+	softClearColor(context, x, 1.0f - y, 0.5f, 1.0f);
+	softClear(context);
+
+	updateScene(&app->scene);
+	Bounds2D view = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height) };
+	cullScene(&app->scene, &view);
+	SoftSceneUniforms sceneUniforms;
+	sceneUniforms.screenSize[0] = width;
+	sceneUniforms.screenSize[1] = height;
+	for (int32_t i = 0; i < app->scene.visibleCount; ++i) {
+		const Transform2D* t = &app->scene.worldTransform[app->scene.visible[i]];
+		sceneUniforms.transformX[0] = t->a;
+		sceneUniforms.transformX[1] = t->c;
+		sceneUniforms.transformX[2] = t->tx;
+		sceneUniforms.transformY[0] = t->b;
+		sceneUniforms.transformY[1] = t->d;
+		sceneUniforms.transformY[2] = t->ty;
+		softDrawArrays(context, &softSceneProgram, &sceneUniforms, SOFT_TRIANGLES, triangleVertices, 2, 0, 3);
+	}
+
+	if (app->particles.count > 0) {
+		SoftParticleUniforms particleUniforms = { { static_cast<float>(width), static_cast<float>(height) }, particleSize };
+		softBlend(context, SOFT_BLEND_ADDITIVE);
+		softDrawArrays(context, &softParticleProgram, &particleUniforms, SOFT_POINTS,
+			reinterpret_cast<const float*>(app->particles.vertices), 3, 0, app->particles.count);
+		softBlend(context, SOFT_BLEND_NONE);
+	}
+
+	// overlay: the moving block, the pointer marker and its label
+	const SimulationEntities* entities = &app->simulation.entities;
+	clearRect(context, entities->renderX[app->movingBlock], entities->renderY[app->movingBlock], 8, 0.0f);
+	float pointerX = x * width;
+	float pointerY = (1.0f - y) * height;
+	clearRect(context, pointerX, pointerY, 8, 0.0f);
+	clearRect(context, pointerX + 2, pointerY + 2, 4, 1.0f);
+
+	beginText(&app->text);
+	char label[64];
+	snprintf(label, sizeof(label), "pointer %.0f, %.0f", desc->pointerX, desc->pointerY);
+	TextStyle style = { textScale, 0xffffffff };
+	drawText(&app->text, label, 8.0f, 8.0f, &style);
+	SoftTextUniforms textUniforms = { { static_cast<float>(width), static_cast<float>(height) },
+		{ app->text.atlas.pixels, app->text.atlas.width, app->text.atlas.height } };
+	softBlend(context, SOFT_BLEND_ALPHA);
+	softDrawArrays(context, &softTextProgram, &textUniforms, SOFT_TRIANGLES, reinterpret_cast<const float*>(app->text.batch.vertices),
+		sizeof(TextVertex) / sizeof(float), 0, app->text.batch.vertexCount);
+	softBlend(context, SOFT_BLEND_NONE);
+
+	softFinish(context);
+}
+
+// Reads a binary PPM as written by writeSoftImagePPM, with alpha set to 255.
+static uint32_t* readPPM(const char* path, int32_t* imageWidth, int32_t* imageHeight) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return NULL;
+	}
+	int32_t maxValue = 0;
+	uint32_t* pixels = NULL;
+	if (fscanf(file, "P6 %d %d %d", imageWidth, imageHeight, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF &&
+		*imageWidth > 0 && *imageHeight > 0) {
+		int32_t count = *imageWidth * *imageHeight;
+		pixels = static_cast<uint32_t*>(malloc(count * sizeof(uint32_t)));
+		for (int32_t i = 0; pixels && i < count; ++i) {
+			unsigned char rgb[3];
+			if (fread(rgb, 1, 3, file) != 3) {
+				free(pixels);
+				pixels = NULL;
+				break;
+			}
+			pixels[i] = rgb[0] | (rgb[1] << 8) | (rgb[2] << 16) | 0xff000000u;
+		}
+	}
+	fclose(file);
+	return pixels;
+}
+
+static bool checkFrame(SoftContext* context, const FrameDesc* desc, const char* directory, bool write) {
+	App* app = static_cast<App*>(malloc(sizeof(App)));
+	if (!app || !initApp(app)) {
+		printf("FAIL: could not set up the app state\n");
+		free(app);
+		return false;
+	}
+	renderFrame(app, context, desc);
+	termApp(app);
+	free(app);
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s.ppm", directory, desc->name);
+	if (write) {
+		bool ok = writeSoftImagePPM(context, path);
+		printf("%-8s %s %s\n", desc->name, ok ? "wrote" : "FAIL: could not write", path);
+		return ok;
+	}
+
+	int32_t referenceWidth = 0;
+	int32_t referenceHeight = 0;
+	uint32_t* reference = readPPM(path, &referenceWidth, &referenceHeight);
+	if (!reference) {
+		printf("FAIL: could not read %s\n", path);
+		return false;
+	}
+	if (referenceWidth != width || referenceHeight != height) {
+		printf("FAIL: %s is %dx%d, the frame is %dx%d\n", path, referenceWidth, referenceHeight, width, height);
+		free(reference);
+		return false;
+	}
+	// PPM has no alpha
+	uint32_t* rendered = static_cast<uint32_t*>(malloc(width * height * sizeof(uint32_t)));
+	for (int32_t i = 0; i < width * height; ++i) {
+		rendered[i] = context->color[i] | 0xff000000u;
+	}
+	int64_t mismatches = compareSoftImages(rendered, reference, width, height, channelTolerance);
+	bool ok = mismatches <= maxMismatchedPixels;
+	printf("%-8s %lld pixels differ from %s by more than %d%s\n", desc->name, static_cast<long long>(mismatches), path,
+		channelTolerance, ok ? "" : ", FAIL");
+	if (!ok) {
+		snprintf(path, sizeof(path), "%s.actual.ppm", desc->name);
+		if (writeSoftImagePPM(context, path)) {
+			printf("         the frame is in %s\n", path);
+		}
+	}
+	free(rendered);
+	free(reference);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	bool write = false;
+	const char* directory = "host/reference";
+	for (int32_t i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--write") == 0) {
+			write = true;
+		} else if (argv[i][0] == '-') {
+			printf("Usage: soft_render_check [--write] [reference directory]\n");
+			return 1;
+		} else {
+			directory = argv[i];
+		}
+	}
+
+	WorkerPool workers;
+	SoftContext context;
+	if (!initWorkerPool(&workers, defaultWorkerThreadCount()) || !initSoftContext(&context, width, height, &workers)) {
+		printf("FAIL: could not create the software context\n");
+		return 1;
+	}
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); ++i) {
+		ok = checkFrame(&context, &frames[i], directory, write) && ok;
+	}
+	termSoftContext(&context);
+	termWorkerPool(&workers);
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+// Runs the app's frame on the host, as drawFrame in jni/main.cpp builds it: simulation, particles,
+// touch prediction, the render graph with the scene, post process and overlay passes, the pointer
+// label the overlay draws and the text flush through the vertex stream. Fails if steady state frames
+// allocate, if GL reports an error, or if anything leaks, GL objects included.
+//
+// Build with:   cc -O2 -c jni/font8x8.c jni/shader_utils.c jni/memory_tracker.c
+//               c++ -O2 -o steady_state_bench host/steady_state_bench.cpp jni/simulation.cpp jni/particles.cpp
+//                   jni/scene.cpp jni/scene_renderer.cpp jni/render_graph.cpp jni/post_process.cpp
+//                   jni/text_renderer.cpp jni/glyph_atlas.cpp jni/touch_predictor.cpp jni/worker_pool.cpp
+//                   jni/stream_buffer.cpp jni/gpu_fence.cpp jni/gl_extensions.cpp jni/upload_queue.cpp
+//                   jni/frame_pacer.cpp font8x8.o shader_utils.o memory_tracker.o -lGLESv2 -lEGL -lpthread
+// Usage:        EGL_PLATFORM=surfaceless steady_state_bench [frames]
+//
+// Heap tracking must be on, which it is unless NDEBUG is defined. The frame renders into a pbuffer
+// through a real context, so an EGL display with pbuffers is needed; Mesa's surfaceless platform
+// has one. Only the app's own allocations are counted, not the driver's.
+
+#include "../jni/font8x8.h"
+#include "../jni/frame_pacer.h"
+#include "../jni/gpu_fence.h"
+#include "../jni/memory_tracker.h"
+#include "../jni/particles.h"
+#include "../jni/post_process.h"
+#include "../jni/render_graph.h"
+#include "../jni/scene.h"
+#include "../jni/scene_renderer.h"
+#include "../jni/simulation.h"
+#include "../jni/stream_buffer.h"
+#include "../jni/text_renderer.h"
+#include "../jni/time_utils.h"
+#include "../jni/touch_predictor.h"
+#include "../jni/upload_queue.h"
+#include "../jni/worker_pool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !MEMORY_TRACKING
+#error steady_state_bench needs MEMORY_TRACKING
+#endif
+
+const int32_t warmupFrames = 240;
+const int64_t frameNanoseconds = 16666667;
+const int32_t width = 640;
+const int32_t height = 360;
+const int32_t entityCount = 64;
+
+// as in jni/main.cpp
+const int32_t particlesPerMotionSample = 16;
+const float particleSpeed = 200.0f;
+const float particleLifetime = 1.5f;
+const float particleSize = 12.0f;
+const int32_t maxParticles = 100000;
+const int32_t textAtlasSize = 256;
+const int32_t textMaxRuns = 256;
+const int32_t textScale = 2;
+const int32_t framesInFlight = 2;
+const GLsizeiptr vertexStreamSegmentSize = 2 * 1024 * 1024;
+const int32_t vertexStreamSegments = 3;
+const int64_t uploadBudgetNanoseconds = 2000000;
+const PostEffect postEffects[] = {
+	{ POST_EFFECT_BLOOM, 0.6f, { 0.6f, 2.0f } },
+	{ POST_EFFECT_COLOR_GRADE, 0.0f, { 1.2f, 1.1f } },
+	{ POST_EFFECT_VIGNETTE, 0.35f, { 0.6f, 1.5f } }
+};
+
+struct Frame {
+	EGLDisplay display;
+	EGLSurface surface;
+	EGLContext context;
+	GLExtensions extensions;
+	EglFenceContext eglFences;
+	GpuFenceProvider fenceProvider;
+	bool hasFences;
+
+	Simulation simulation;
+	WorkerPool workers;
+	Particles particles;
+	Scene scene;
+	TextRenderer text;
+	TouchPredictor touch;
+	int32_t nodes[entityCount];
+	SceneRenderer sceneRenderer;
+	PostProcess postProcess;
+	RenderGraph renderGraph;
+	StreamBuffer vertexStream;
+	UploadQueue uploads;
+	FramePacer framePacer;
+
+	// what the overlay shows: the last touch sample in window pixels, as the app's saved state
+	float pointerX;
+	float pointerY;
+	int64_t now;
+};
+
+static bool initContext(Frame* frame) {
+	frame->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(frame->display, NULL, NULL)) {
+		printf("no EGL display; on Mesa try EGL_PLATFORM=surfaceless\n");
+		return false;
+	}
+	// the app prefers a 3.0 context, which picks the instanced scene renderer
+	EGLint clientVersion = 3;
+	EGLConfig config;
+	EGLint configCount = 0;
+	for (; clientVersion >= 2 && configCount == 0; --clientVersion) {
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, clientVersion == 3 ? EGL_OPENGL_ES3_BIT_KHR : EGL_OPENGL_ES2_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+			EGL_NONE
+		};
+		eglChooseConfig(frame->display, configAttribs, &config, 1, &configCount);
+	}
+	if (configCount == 0) {
+		printf("no pbuffer config\n");
+		return false;
+	}
+	++clientVersion;
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+	frame->surface = eglCreatePbufferSurface(frame->display, config, surfaceAttribs);
+	const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, clientVersion, EGL_NONE };
+	frame->context = eglCreateContext(frame->display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (frame->surface == EGL_NO_SURFACE || frame->context == EGL_NO_CONTEXT ||
+		!eglMakeCurrent(frame->display, frame->surface, frame->surface, frame->context)) {
+		printf("could not make a context current: 0x%04x\n", eglGetError());
+		return false;
+	}
+	printf("GL %s, %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+	loadGLExtensions(&frame->extensions, frame->display);
+	glViewport(0, 0, width, height);
+
+	frame->hasFences = initEglFenceProvider(&frame->fenceProvider, &frame->eglFences, frame->display, &frame->extensions);
+	const GpuFenceProvider* provider = frame->hasFences ? &frame->fenceProvider : NULL;
+	initUploadQueue(&frame->uploads, frame->display, frame->context, clientVersion,
+		clientVersion == 3 ? EGL_OPENGL_ES3_BIT_KHR : EGL_OPENGL_ES2_BIT, provider);
+	initRenderGraph(&frame->renderGraph, &frame->extensions);
+	initFramePacer(&frame->framePacer, provider, framesInFlight);
+	if (!initSceneRendererGL(&frame->sceneRenderer, &frame->extensions) || !initPostProcessGL(&frame->postProcess) ||
+		!initParticlesGL(&frame->particles) || !initTextRendererGL(&frame->text, &frame->uploads) ||
+		!finishSceneRendererGL(&frame->sceneRenderer) || !finishPostProcessGL(&frame->postProcess) ||
+		!finishParticlesGL(&frame->particles) || !finishTextRendererGL(&frame->text)) {
+		printf("could not create the programs\n");
+		return false;
+	}
+	if (!initStreamBuffer(&frame->vertexStream, GL_ARRAY_BUFFER, vertexStreamSegmentSize, vertexStreamSegments,
+		&frame->extensions, provider)) {
+		printf("could not create the vertex stream\n");
+		return false;
+	}
+	return true;
+}
+
+static bool initFrame(Frame* frame) {
+	if (!initSimulation(&frame->simulation, entityCount, 60, 5) || !initWorkerPool(&frame->workers, defaultWorkerThreadCount()) ||
+		!initParticles(&frame->particles, maxParticles, &frame->workers) || !initScene(&frame->scene, 1024, 256.0f, 16, 16) ||
+		!initTextRenderer(&frame->text, textAtlasSize, textMaxRuns)) {
+		return false;
+	}
+	for (uint32_t c = FONT8X8_FIRST_CHAR; c <= FONT8X8_LAST_CHAR; ++c) {
+		findOrAddGlyph(&frame->text.atlas, c, textScale);
+	}
+	for (int32_t i = 0; i < entityCount; ++i) {
+		addSimulationEntity(&frame->simulation, i * 10.0f, i * 5.0f, 60.0f, 30.0f);
+	}
+	setSimulationBounds(&frame->simulation, width, height);
+	// a viewport node mapping [-1:1] onto the window, as in the app, with a triangle per entity
+	const Bounds2D noBounds = { 0.0f, 0.0f, -1.0f, -1.0f };
+	const Bounds2D triangleBounds = { -0.5f, -0.5f, 0.5f, 0.5f };
+	Transform2D viewport = { width * 0.5f, 0.0f, 0.0f, height * -0.5f, width * 0.5f, height * 0.5f };
+	int32_t root = addSceneNode(&frame->scene, -1, &viewport, &noBounds);
+	for (int32_t i = 0; i < entityCount; ++i) {
+		frame->nodes[i] = addSceneNode(&frame->scene, root, &identityTransform, &triangleBounds);
+	}
+	initTouchPredictor(&frame->touch, &defaultTouchPredictorConfig);
+	initPostProcess(&frame->postProcess, postEffects, sizeof(postEffects) / sizeof(postEffects[0]));
+	return initContext(frame);
+}
+
+// Returns how many kinds of GL object were left undeleted.
+static int32_t termFrame(Frame* frame) {
+	termUploadQueue(&frame->uploads);
+	termFramePacer(&frame->framePacer);
+	termSceneRendererGL(&frame->sceneRenderer);
+	termRenderGraphGL(&frame->renderGraph);
+	termPostProcessGL(&frame->postProcess);
+	termStreamBuffer(&frame->vertexStream);
+	termTextRendererGL(&frame->text);
+	termParticlesGL(&frame->particles);
+	eglMakeCurrent(frame->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(frame->display, frame->context);
+	eglDestroySurface(frame->display, frame->surface);
+	eglTerminate(frame->display);
+	int32_t glLeaks = clearGpuMemory();
+
+	termTextRenderer(&frame->text);
+	termScene(&frame->scene);
+	termParticles(&frame->particles);
+	termWorkerPool(&frame->workers);
+	termSimulation(&frame->simulation);
+	return glLeaks;
+}
+
+static void drawScenePass(void* data, const RenderGraph*, int32_t) {
+	Frame* frame = static_cast<Frame*>(data);
+	glClearColor(frame->pointerX / width, 1.0f - frame->pointerY / height, 0.5f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	updateScene(&frame->scene);
+	Bounds2D view = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height) };
+	cullScene(&frame->scene, &view);
+	drawSceneNodes(&frame->sceneRenderer, &frame->vertexStream, frame->scene.worldTransform, frame->scene.visible,
+		frame->scene.visibleCount, width, height);
+	drawParticles(&frame->particles, &frame->vertexStream, width, height, particleSize);
+}
+
+static void drawOverlayPass(void* data, const RenderGraph*, int32_t) {
+	Frame* frame = static_cast<Frame*>(data);
+	beginText(&frame->text);
+
+	float predictedX, predictedY;
+	if (predictTouch(&frame->touch, frame->now + 2 * frameNanoseconds, &predictedX, &predictedY)) {
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(predictedX, height - predictedY, 8, 8);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+	}
+
+	// the label changes with every touch sample, so most frames lay out a new string
+	char text[64];
+	snprintf(text, sizeof(text), "pointer %.0f, %.0f", frame->pointerX, frame->pointerY);
+	TextStyle style = { textScale, 0xffffffff };
+	drawText(&frame->text, text, 8.0f, 8.0f, &style);
+	flushText(&frame->text, &frame->vertexStream, width, height);
+}
+
+static void runFrame(Frame* frame, int64_t now) {
+	beginPacedFrame(&frame->framePacer);
+	pollUploads(&frame->uploads, uploadBudgetNanoseconds);
+	beginStreamFrame(&frame->vertexStream);
+	frame->now = now;
+
+	// a finger moving in a circle, sampled twice per frame
+	for (int32_t s = 0; s < 2; ++s) {
+		int64_t t = now - frameNanoseconds / 2 * (1 - s);
+		float angle = t * 1e-9f * 3.0f;
+		frame->pointerX = width * 0.5f + 100.0f * cosf(angle);
+		frame->pointerY = height * 0.5f + 100.0f * sinf(angle);
+		addTouchSample(&frame->touch, frame->pointerX, frame->pointerY, t);
+		spawnParticles(&frame->particles, frame->pointerX, frame->pointerY, particlesPerMotionSample, particleSpeed, particleLifetime);
+	}
+
+	int32_t ticks = advanceSimulation(&frame->simulation, now);
+	updateParticles(&frame->particles, ticks * frame->simulation.tickNanoseconds * 1e-9f);
+	const SimulationEntities* e = &frame->simulation.entities;
+	for (int32_t i = 0; i < entityCount; ++i) {
+		Transform2D local = { 16.0f / width, 0.0f, 0.0f, 16.0f / height, e->renderX[i] * 2.0f / width - 1.0f,
+			1.0f - e->renderY[i] * 2.0f / height };
+		setSceneNodeTransform(&frame->scene, frame->nodes[i], &local);
+	}
+
+	RenderGraph* graph = &frame->renderGraph;
+	resetRenderGraph(graph);
+	int32_t backbuffer = importRenderResource(graph, "backbuffer", width, height);
+	RenderTargetDesc sceneDesc = { width, height, RENDER_TARGET_RGBA8 };
+	int32_t sceneColor = createRenderResource(graph, "sceneColor", &sceneDesc);
+	int32_t scenePass = addRenderPass(graph, "scene", drawScenePass, frame);
+	setRenderPassColor(graph, scenePass, sceneColor, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	addPostProcessPasses(&frame->postProcess, graph, sceneColor, backbuffer, width, height);
+	int32_t overlayPass = addRenderPass(graph, "overlay", drawOverlayPass, frame);
+	setRenderPassColor(graph, overlayPass, backbuffer, RENDER_LOAD, 0.0f, 0.0f, 0.0f, 0.0f);
+	if (compileRenderGraph(graph)) {
+		executeRenderGraph(graph);
+	}
+
+	endStreamFrame(&frame->vertexStream);
+	endPacedFrame(&frame->framePacer);
+	eglSwapBuffers(frame->display, frame->surface);
+}
+
+int main(int argc, char** argv) {
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	int32_t frames = argc > 1 ? atoi(argv[1]) : 600;
+	Frame* frame = static_cast<Frame*>(calloc(1, sizeof(Frame)));
+	if (!frame || !initFrame(frame)) {
+		fprintf(stderr, "Could not initialise\n");
+		return 1;
+	}
+
+	int64_t now = 1000000000;
+	resetSimulationClock(&frame->simulation, now);
+	for (int32_t i = 0; i < warmupFrames; ++i) {
+		now += frameNanoseconds;
+		runFrame(frame, now);
+	}
+
+	uint64_t allocationsBefore = memoryAllocationCount();
+	int64_t start = nowNanoseconds();
+	for (int32_t i = 0; i < frames; ++i) {
+		now += frameNanoseconds;
+		runFrame(frame, now);
+	}
+	glFinish();
+	int64_t elapsed = nowNanoseconds() - start;
+	uint64_t allocations = memoryAllocationCount() - allocationsBefore;
+	GLenum error = glGetError();
+
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	logMemorySnapshot(&snapshot, NULL);
+	printf("%d frames, %.3f ms per frame, %d particles, %d render passes, %llu allocations in steady state\n", frames,
+		elapsed * 1e-6 / frames, frame->particles.count, frame->renderGraph.stats.passes, static_cast<unsigned long long>(allocations));
+
+	int32_t glLeaks = termFrame(frame);
+	free(frame);
+	int32_t leaks = reportMemoryLeaks(NULL) + glLeaks;
+	if (error != GL_NO_ERROR) {
+		printf("GL error 0x%04x\n", error);
+	}
+	if (allocations > 0 || leaks > 0 || error != GL_NO_ERROR) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("PASSED\n");
+	return 0;
+}
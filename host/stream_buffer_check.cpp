@@ -0,0 +1,184 @@
+// Drives the mapped path of jni/stream_buffer.cpp against the simulated GPU from jni/gpu_fence.cpp
+// at several latencies. The stream buffer must never wait on a fence: while the latency fits in the
+// ring every segment's fence has signaled by the time it comes round again, and beyond that the
+// segment is orphaned and counted as a stall instead. Also checks that a failed map leaves the
+// segment and the statistics untouched.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o stream_buffer_check host/stream_buffer_check.cpp jni/stream_buffer.cpp jni/gpu_fence.cpp
+//                   memory_tracker.o
+// Usage:        stream_buffer_check [frames]
+//
+// GL is replaced by entry points that keep each buffer's storage in memory. Times are real: each
+// frame sleeps for its interval, so a run takes about a second.
+
+#include "../jni/gpu_fence.h"
+#include "../jni/stream_buffer.h"
+#include "../jni/time_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const int32_t segmentCount = 3;
+const GLsizeiptr segmentSize = 64 * 1024;
+const int64_t frameInterval = 4000000;
+const int64_t gpuFrameNanoseconds = 1000000;
+
+struct HostBuffer {
+	uint8_t data[segmentSize];
+	bool mapped;
+};
+
+static HostBuffer buffers[segmentCount + 1];
+static GLuint boundBuffer;
+static GLuint nextName = 1;
+static uint32_t orphans;
+static bool failMaps;
+
+extern "C" {
+void glBindBuffer(GLenum, GLuint buffer) { boundBuffer = buffer; }
+void glBufferData(GLenum, GLsizeiptr, const void*, GLenum) { ++orphans; }
+void glBufferSubData(GLenum, GLintptr offset, GLsizeiptr size, const void* data) { memcpy(buffers[boundBuffer].data + offset, data, size); }
+void glDeleteBuffers(GLsizei, const GLuint*) {}
+void glGenBuffers(GLsizei n, GLuint* names) { for (GLsizei i = 0; i < n; ++i) names[i] = nextName++; }
+GLenum glGetError() { return GL_NO_ERROR; }
+}
+
+static void* GL_APIENTRY mapBufferRange(GLenum, GLintptr offset, GLsizeiptr, GLbitfield) {
+	if (failMaps || buffers[boundBuffer].mapped) {
+		return NULL;
+	}
+	buffers[boundBuffer].mapped = true;
+	return buffers[boundBuffer].data + offset;
+}
+
+static GLboolean GL_APIENTRY unmapBuffer(GLenum) {
+	buffers[boundBuffer].mapped = false;
+	return GL_TRUE;
+}
+
+// The simulated provider, with waits counted; the stream buffer must never make one.
+static GpuFenceProvider simulated;
+static uint32_t waits;
+
+static bool countedWait(void* context, GpuFence fence, int64_t timeoutNanoseconds) {
+	++waits;
+	return simulated.wait(context, fence, timeoutNanoseconds);
+}
+
+static void sleepUntil(int64_t time) {
+	int64_t sleep = time - nowNanoseconds();
+	if (sleep > 0) {
+		struct timespec ts = { static_cast<time_t>(sleep / 1000000000LL), static_cast<long>(sleep % 1000000000LL) };
+		nanosleep(&ts, NULL);
+	}
+}
+
+static bool initStream(StreamBuffer* stream, GLExtensions* extensions, GpuFenceProvider* provider, SimulatedGpu* gpu,
+	int64_t latencyNanoseconds) {
+	memset(extensions, 0, sizeof(GLExtensions));
+	extensions->mapBufferRange = true;
+	extensions->mapBufferRangeEXT = mapBufferRange;
+	extensions->unmapBufferOES = unmapBuffer;
+	initSimulatedGpu(gpu, latencyNanoseconds, gpuFrameNanoseconds);
+	initSimulatedFenceProvider(&simulated, gpu);
+	*provider = simulated;
+	provider->wait = countedWait;
+	nextName = 1;
+	return initStreamBuffer(stream, GL_ARRAY_BUFFER, segmentSize, segmentCount, extensions, provider) && stream->mapped;
+}
+
+// A segment comes round again segmentCount intervals after its fence was created. Latencies up to
+// one interval short of that must never stall, and from one interval beyond it must always stall.
+static bool run(int64_t latencyNanoseconds, int32_t frames) {
+	StreamBuffer stream;
+	GLExtensions extensions;
+	GpuFenceProvider provider;
+	SimulatedGpu gpu;
+	if (!initStream(&stream, &extensions, &provider, &gpu, latencyNanoseconds)) {
+		printf("FAIL: the stream buffer did not take the mapped path\n");
+		return false;
+	}
+	waits = 0;
+	orphans = 0;
+	bool ok = true;
+	int64_t next = nowNanoseconds();
+	for (int32_t frame = 0; frame < frames && ok; ++frame) {
+		beginStreamFrame(&stream);
+		for (int32_t i = 0; i < 8; ++i) {
+			StreamAllocation allocation;
+			uint8_t* data = static_cast<uint8_t*>(allocStream(&stream, 1000, 16, &allocation));
+			if (!data) {
+				printf("FAIL: allocation %d of frame %d failed\n", i, frame);
+				ok = false;
+				break;
+			}
+			memset(data, frame & 0xff, allocation.size);
+			commitStream(&stream, &allocation);
+		}
+		endStreamFrame(&stream);
+		next += frameInterval;
+		sleepUntil(next);
+	}
+
+	bool fits = latencyNanoseconds <= (segmentCount - 1) * frameInterval;
+	bool overlaps = latencyNanoseconds >= (segmentCount + 1) * frameInterval;
+	uint32_t stalls = stream.stats.fenceStalls;
+	printf("  latency %5.1f ms: %3u fence stalls, %3u orphaned segments, %u waits\n", latencyNanoseconds * 1e-6, stalls,
+		orphans, waits);
+	if (waits != 0) {
+		printf("FAIL: the stream buffer waited on a fence\n");
+		ok = false;
+	}
+	if (fits && stalls != 0) {
+		printf("FAIL: segments stalled although the latency fits in the ring\n");
+		ok = false;
+	}
+	if (overlaps && stalls < static_cast<uint32_t>(frames - segmentCount) / 2) {
+		printf("FAIL: segments still in use were not orphaned\n");
+		ok = false;
+	}
+	termStreamBuffer(&stream);
+	return ok;
+}
+
+// A failed map returns NULL and leaves the head, the statistics and the frame's fence as they were.
+static bool checkFailedMap() {
+	StreamBuffer stream;
+	GLExtensions extensions;
+	GpuFenceProvider provider;
+	SimulatedGpu gpu;
+	if (!initStream(&stream, &extensions, &provider, &gpu, 0)) {
+		printf("FAIL: the stream buffer did not take the mapped path\n");
+		return false;
+	}
+	beginStreamFrame(&stream);
+	failMaps = true;
+	StreamAllocation allocation;
+	void* data = allocStream(&stream, 1000, 16, &allocation);
+	failMaps = false;
+	bool ok = !data && stream.head == 0 && stream.stats.frameBytes == 0 && stream.stats.totalBytes == 0;
+	endStreamFrame(&stream);
+	ok = ok && !stream.fences[stream.segment];
+	printf("failed map: %s\n", ok ? "nothing committed" : "FAIL: the failed allocation was committed");
+	termStreamBuffer(&stream);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	int32_t frames = argc >= 2 ? atoi(argv[1]) : 40;
+	if (frames <= segmentCount) {
+		printf("Usage: stream_buffer_check [frames, more than %d]\n", segmentCount);
+		return 1;
+	}
+	bool ok = checkFailedMap();
+	printf("%d segments, a frame every %.1f ms, %d frames:\n", segmentCount, frameInterval * 1e-6, frames);
+	static const int64_t latencies[] = { 0, 4000000, 8000000, 12000000, 16000000, 24000000 };
+	for (size_t i = 0; i < sizeof(latencies) / sizeof(latencies[0]); ++i) {
+		ok = run(latencies[i], frames) && ok;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
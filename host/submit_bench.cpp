@@ -0,0 +1,141 @@
+// Compares the CPU cost of submitting the scene through the OpenGL ES 2.0 and 3.0 backends of
+// jni/scene_renderer.cpp, for a range of visible node counts.
+//
+// Build with:   cc -O2 -c jni/shader_utils.c jni/memory_tracker.c
+//               c++ -O2 -o submit_bench host/submit_bench.cpp jni/scene_renderer.cpp jni/stream_buffer.cpp
+//                   jni/gpu_fence.cpp jni/scene.cpp shader_utils.o memory_tracker.o -lpthread
+// Usage:        submit_bench [frames]
+//
+// GL is replaced by entry points that only count calls, so the times are the app's own submission
+// work; a driver adds a roughly fixed cost per call on top, which is what the call counts are for.
+
+#include "../jni/scene.h"
+#include "../jni/scene_renderer.h"
+#include "../jni/stream_buffer.h"
+#include "../jni/time_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t glCalls;
+static uint64_t glDraws;
+static GLuint nextName = 1;
+
+extern "C" {
+void glAttachShader(GLuint, GLuint) { ++glCalls; }
+void glBindBuffer(GLenum, GLuint) { ++glCalls; }
+void glBufferData(GLenum, GLsizeiptr, const void*, GLenum) { ++glCalls; }
+void glBufferSubData(GLenum, GLintptr, GLsizeiptr, const void*) { ++glCalls; }
+void glCompileShader(GLuint) { ++glCalls; }
+GLuint glCreateProgram() { ++glCalls; return nextName++; }
+GLuint glCreateShader(GLenum) { ++glCalls; return nextName++; }
+void glDeleteBuffers(GLsizei, const GLuint*) { ++glCalls; }
+void glDeleteProgram(GLuint) { ++glCalls; }
+void glDeleteShader(GLuint) { ++glCalls; }
+void glDetachShader(GLuint, GLuint) { ++glCalls; }
+void glDisableVertexAttribArray(GLuint) { ++glCalls; }
+void glDrawArrays(GLenum, GLint, GLsizei) { ++glCalls; ++glDraws; }
+void glEnableVertexAttribArray(GLuint) { ++glCalls; }
+void glGenBuffers(GLsizei n, GLuint* buffers) { ++glCalls; for (GLsizei i = 0; i < n; ++i) buffers[i] = nextName++; }
+void glGetAttachedShaders(GLuint, GLsizei, GLsizei* count, GLuint*) { ++glCalls; if (count) *count = 0; }
+GLint glGetAttribLocation(GLuint, const GLchar* name) { ++glCalls; return strcmp(name, "position") == 0 ? 0 : strcmp(name, "transformX") == 0 ? 1 : 2; }
+GLenum glGetError() { return GL_NO_ERROR; }
+void glGetProgramInfoLog(GLuint, GLsizei, GLsizei* length, GLchar*) { if (length) *length = 0; }
+void glGetProgramiv(GLuint, GLenum, GLint* value) { ++glCalls; *value = GL_TRUE; }
+void glGetShaderInfoLog(GLuint, GLsizei, GLsizei* length, GLchar*) { if (length) *length = 0; }
+void glGetShaderiv(GLuint, GLenum, GLint* value) { ++glCalls; *value = GL_TRUE; }
+GLint glGetUniformLocation(GLuint, const GLchar*) { ++glCalls; return 0; }
+void glLinkProgram(GLuint) { ++glCalls; }
+void glShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) { ++glCalls; }
+void glUniform2f(GLint, GLfloat, GLfloat) { ++glCalls; }
+void glUniform3f(GLint, GLfloat, GLfloat, GLfloat) { ++glCalls; }
+void glUseProgram(GLuint) { ++glCalls; }
+void glVertexAttrib3f(GLuint, GLfloat, GLfloat, GLfloat) { ++glCalls; }
+void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { ++glCalls; }
+}
+
+static void GL_APIENTRY genVertexArrays(GLsizei n, GLuint* arrays) { ++glCalls; for (GLsizei i = 0; i < n; ++i) arrays[i] = nextName++; }
+static void GL_APIENTRY deleteVertexArrays(GLsizei, const GLuint*) { ++glCalls; }
+static void GL_APIENTRY bindVertexArray(GLuint) { ++glCalls; }
+static void GL_APIENTRY vertexAttribDivisor(GLuint, GLuint) { ++glCalls; }
+static void GL_APIENTRY drawArraysInstanced(GLenum, GLint, GLsizei, GLsizei) { ++glCalls; ++glDraws; }
+static void GL_APIENTRY bindBufferBase(GLenum, GLuint, GLuint) { ++glCalls; }
+static GLuint GL_APIENTRY getUniformBlockIndex(GLuint, const GLchar*) { ++glCalls; return 0; }
+static void GL_APIENTRY uniformBlockBinding(GLuint, GLuint, GLuint) { ++glCalls; }
+
+const float sceneSize = 2048.0f;
+
+static bool buildScene(Scene* scene, int32_t nodes) {
+	if (!initScene(scene, nodes + 1, 256.0f, 8, 8)) {
+		return false;
+	}
+	const Bounds2D noBounds = { 0.0f, 0.0f, -1.0f, -1.0f };
+	const Bounds2D bounds = { -0.5f, -0.5f, 0.5f, 0.5f };
+	int32_t root = addSceneNode(scene, -1, &identityTransform, &noBounds);
+	uint32_t random = 1;
+	for (int32_t i = 0; i < nodes; ++i) {
+		random = random * 1664525u + 1013904223u;
+		Transform2D t = { 32.0f, 0.0f, 0.0f, 32.0f, (random >> 8) % 2000 + 24.0f, (random >> 20) % 2000 + 24.0f };
+		addSceneNode(scene, root, &t, &bounds);
+	}
+	updateScene(scene);
+	Bounds2D view = { 0.0f, 0.0f, sceneSize, sceneSize };
+	cullScene(scene, &view);
+	return true;
+}
+
+static void runBackend(bool es3, Scene* scene, int32_t frames) {
+	GLExtensions extensions;
+	memset(&extensions, 0, sizeof(extensions));
+	if (es3) {
+		extensions.es3 = true;
+		extensions.genVertexArrays = genVertexArrays;
+		extensions.deleteVertexArrays = deleteVertexArrays;
+		extensions.bindVertexArray = bindVertexArray;
+		extensions.vertexAttribDivisor = vertexAttribDivisor;
+		extensions.drawArraysInstanced = drawArraysInstanced;
+		extensions.bindBufferBase = bindBufferBase;
+		extensions.getUniformBlockIndex = getUniformBlockIndex;
+		extensions.uniformBlockBinding = uniformBlockBinding;
+	}
+	SceneRenderer renderer;
+	StreamBuffer stream;
+	if (!initSceneRendererGL(&renderer, &extensions) || !finishSceneRendererGL(&renderer) ||
+		!initStreamBuffer(&stream, GL_ARRAY_BUFFER, 2 * 1024 * 1024, 3, &extensions, NULL)) {
+		fprintf(stderr, "Could not create the renderer\n");
+		exit(1);
+	}
+
+	glCalls = 0;
+	glDraws = 0;
+	int64_t start = nowNanoseconds();
+	for (int32_t i = 0; i < frames; ++i) {
+		beginStreamFrame(&stream);
+		drawSceneNodes(&renderer, &stream, scene->worldTransform, scene->visible, scene->visibleCount, sceneSize, sceneSize);
+		endStreamFrame(&stream);
+	}
+	int64_t elapsed = nowNanoseconds() - start;
+	printf("  ES %d.0: %8.2f us/frame, %6.1f GL calls/frame, %6.1f draws/frame\n", renderer.apiVersion,
+		elapsed * 1e-3 / frames, static_cast<double>(glCalls) / frames, static_cast<double>(glDraws) / frames);
+
+	termStreamBuffer(&stream);
+	termSceneRendererGL(&renderer);
+}
+
+int main(int argc, char** argv) {
+	int32_t frames = argc > 1 ? atoi(argv[1]) : 2000;
+	const int32_t nodeCounts[] = { 1, 16, 256, 1024 };
+	for (size_t i = 0; i < sizeof(nodeCounts) / sizeof(nodeCounts[0]); ++i) {
+		Scene scene;
+		if (!buildScene(&scene, nodeCounts[i])) {
+			fprintf(stderr, "Could not create the scene\n");
+			return 1;
+		}
+		printf("%d visible nodes\n", scene.visibleCount);
+		runBackend(false, &scene, frames);
+		runBackend(true, &scene, frames);
+		termScene(&scene);
+	}
+	return 0;
+}
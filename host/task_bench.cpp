@@ -0,0 +1,281 @@
+// Runs jni/looper_tasks.cpp on the host looper from host/android_host.cpp. Checks the order tasks
+// resume in, file reads and shutdown, then times an await against the same work written as
+// callbacks: frame waits, round trips to a task thread, jobs run inline without threads and many
+// tasks in flight at once. Fails if a check fails or a task frame is left allocated.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -std=c++20 -O2 -D__ANDROID__ -Ihost/ndk -o task_bench host/task_bench.cpp host/android_host.cpp
+//                   jni/looper_tasks.cpp memory_tracker.o -lEGL -lGLESv2 -lpthread -ldl
+// Usage:        task_bench [awaits] [task threads]
+
+#include "android_host.h"
+#include "../jni/looper_tasks.h"
+#include "../jni/memory_tracker.h"
+#include "../jni/time_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHECK_MAX_EVENTS 16
+
+const int32_t concurrentTasks = 64;
+
+// Polls the looper, processing the task source, until *running drops to 0.
+static void pollUntilDone(const int32_t* running) {
+	while (*running > 0) {
+		android_poll_source* source = NULL;
+		if (ALooper_pollAll(-1, NULL, NULL, reinterpret_cast<void**>(&source)) == LOOPER_ID_USER && source) {
+			source->process(NULL, source);
+		}
+	}
+}
+
+struct EventLog {
+	int32_t events[CHECK_MAX_EVENTS];
+	int32_t count;
+};
+
+static void logEvent(EventLog* log, int32_t event) {
+	if (log->count < CHECK_MAX_EVENTS) {
+		log->events[log->count++] = event;
+	}
+}
+
+static void emptyJob(void*) {
+}
+
+static void slowJob(void*) {
+	usleep(2000);
+}
+
+static Task child(TaskLooper* tasks, EventLog* log, int32_t first) {
+	logEvent(log, first);
+	co_await runOnTaskThread(tasks, slowJob, NULL);
+	logEvent(log, first + 1);
+}
+
+static Task parent(TaskLooper* tasks, EventLog* log, int32_t* running) {
+	logEvent(log, 0);
+	co_await child(tasks, log, 1);
+	co_await nextFrame(tasks);
+	logEvent(log, 3);
+	co_await child(tasks, log, 4);
+	logEvent(log, 6);
+	--*running;
+}
+
+static bool checkOrder(TaskLooper* tasks) {
+	EventLog log;
+	memset(&log, 0, sizeof(log));
+	int32_t running = 1;
+	startTask(parent(tasks, &log, &running));
+	// the frame wait only resumes once advanced, so alternate like a main loop would
+	while (running > 0) {
+		android_poll_source* source = NULL;
+		if (ALooper_pollAll(1, NULL, NULL, reinterpret_cast<void**>(&source)) == LOOPER_ID_USER && source) {
+			source->process(NULL, source);
+		}
+		advanceTaskFrame(tasks);
+	}
+	bool ok = log.count == 7;
+	for (int32_t i = 0; i < log.count; ++i) {
+		ok = ok && log.events[i] == i;
+	}
+	printf("order: %s\n", ok ? "nested tasks resume in order" : "FAIL: nested tasks resumed out of order");
+	return ok;
+}
+
+static Task readFiles(TaskLooper* tasks, const char* path, bool* ok, int32_t* running) {
+	char buffer[64];
+	memset(buffer, 0, sizeof(buffer));
+	int64_t bytes = co_await readFileAsync(tasks, path, buffer, sizeof(buffer));
+	*ok = bytes == 12 && memcmp(buffer, "hello, tasks", 12) == 0;
+	int64_t missing = co_await readFileAsync(tasks, "/nonexistent/task_bench", buffer, sizeof(buffer));
+	*ok = *ok && missing == -1;
+	--*running;
+}
+
+static bool checkFileRead(TaskLooper* tasks) {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/task_bench_%d", static_cast<int32_t>(getpid()));
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		printf("FAIL: could not write %s\n", path);
+		return false;
+	}
+	fputs("hello, tasks", file);
+	fclose(file);
+	bool ok = false;
+	int32_t running = 1;
+	startTask(readFiles(tasks, path, &ok, &running));
+	pollUntilDone(&running);
+	unlink(path);
+	printf("file read: %s\n", ok ? "contents and a missing file as expected" : "FAIL: unexpected result");
+	return ok;
+}
+
+// Waits for frames until told the looper is going.
+static Task waitForShutdown(TaskLooper* tasks, int32_t* frames, bool* returned) {
+	while (true) {
+		// not in the loop condition, which GCC 12 gets wrong
+		bool frame = co_await nextFrame(tasks);
+		if (!frame) {
+			break;
+		}
+		++*frames;
+	}
+	co_await runOnTaskThread(tasks, emptyJob, NULL);
+	*returned = true;
+}
+
+static bool checkShutdown(int32_t threadCount) {
+	TaskLooper tasks;
+	if (!initTaskLooper(&tasks, ALooper_forThread(), threadCount)) {
+		printf("FAIL: could not start the looper\n");
+		return false;
+	}
+	int32_t frames = 0;
+	bool returned = false;
+	startTask(waitForShutdown(&tasks, &frames, &returned));
+	for (int32_t i = 0; i < 3; ++i) {
+		advanceTaskFrame(&tasks);
+	}
+	termTaskLooper(&tasks);
+	bool ok = returned && frames == 3 && tasks.pending == 0;
+	printf("shutdown: %s\n", ok ? "a waiting task is cancelled and returns" : "FAIL: a task did not return");
+	return ok;
+}
+
+static Task awaitJobs(TaskLooper* tasks, int32_t count, int32_t* running) {
+	for (int32_t i = 0; i < count; ++i) {
+		co_await runOnTaskThread(tasks, emptyJob, NULL);
+	}
+	--*running;
+}
+
+static Task awaitFrames(TaskLooper* tasks, int32_t count, int32_t* running) {
+	for (int32_t i = 0; i < count; ++i) {
+		co_await nextFrame(tasks);
+	}
+	--*running;
+}
+
+// The callback equivalent: each completion submits the next job or wait itself.
+struct CallbackChain {
+	TaskLooper* tasks;
+	TaskJob job;
+	int32_t remaining;
+	int32_t* running;
+};
+
+static void jobCompleted(void* data) {
+	CallbackChain* chain = static_cast<CallbackChain*>(data);
+	if (--chain->remaining > 0) {
+		submitTaskJob(chain->tasks, &chain->job);
+	} else {
+		--*chain->running;
+	}
+}
+
+static void frameCompleted(void* data) {
+	CallbackChain* chain = static_cast<CallbackChain*>(data);
+	if (--chain->remaining > 0) {
+		waitTaskFrame(chain->tasks, &chain->job);
+	} else {
+		--*chain->running;
+	}
+}
+
+static void startChain(CallbackChain* chain, TaskLooper* tasks, int32_t count, int32_t* running, bool frames) {
+	chain->tasks = tasks;
+	chain->job = TaskJob();
+	chain->job.run = emptyJob;
+	chain->job.complete = frames ? frameCompleted : jobCompleted;
+	chain->job.data = chain;
+	chain->remaining = count;
+	chain->running = running;
+	if (frames) {
+		waitTaskFrame(tasks, &chain->job);
+	} else {
+		submitTaskJob(tasks, &chain->job);
+	}
+}
+
+// Nanoseconds per await for count awaits split over taskCount tasks, or callback chains.
+static double timeJobs(TaskLooper* tasks, int32_t count, int32_t taskCount, bool callbacks) {
+	static CallbackChain chains[concurrentTasks];
+	int32_t running = taskCount;
+	int64_t start = nowNanoseconds();
+	for (int32_t i = 0; i < taskCount; ++i) {
+		if (callbacks) {
+			startChain(&chains[i], tasks, count / taskCount, &running, false);
+		} else {
+			startTask(awaitJobs(tasks, count / taskCount, &running));
+		}
+	}
+	pollUntilDone(&running);
+	return static_cast<double>(nowNanoseconds() - start) / (count / taskCount * taskCount);
+}
+
+static double timeFrames(TaskLooper* tasks, int32_t count, bool callbacks) {
+	CallbackChain chain;
+	int32_t running = 1;
+	int64_t start = nowNanoseconds();
+	if (callbacks) {
+		startChain(&chain, tasks, count, &running, true);
+	} else {
+		startTask(awaitFrames(tasks, count, &running));
+	}
+	while (running > 0) {
+		advanceTaskFrame(tasks);
+	}
+	return static_cast<double>(nowNanoseconds() - start) / count;
+}
+
+static void printTiming(const char* name, double coroutine, double callback) {
+	printf("  %-28s %8.1f ns per await, %8.1f ns per callback (%+.1f ns)\n", name, coroutine, callback, coroutine - callback);
+}
+
+int main(int argc, char** argv) {
+	int32_t count = argc >= 2 ? atoi(argv[1]) : 200000;
+	int32_t threadCount = argc >= 3 ? atoi(argv[2]) : 1;
+	if (count < concurrentTasks || threadCount < 1 || threadCount > TASK_LOOPER_MAX_THREADS) {
+		printf("Usage: task_bench [awaits, at least %d] [task threads, 1 to %d]\n", concurrentTasks, TASK_LOOPER_MAX_THREADS);
+		return 1;
+	}
+	ALooper* looper = ALooper_prepare(0);
+	TaskLooper threaded;
+	TaskLooper inlined;
+	if (!initTaskLooper(&threaded, looper, threadCount) || !initTaskLooper(&inlined, looper, 0)) {
+		printf("FAIL: could not start the loopers\n");
+		return 1;
+	}
+
+	bool ok = checkOrder(&threaded);
+	ok = checkFileRead(&threaded) && ok;
+	ok = checkShutdown(threadCount) && ok;
+	ok = checkShutdown(0) && ok;
+
+	printf("%d awaits, %d task threads:\n", count, threadCount);
+	// warm up the threads and the allocator
+	timeJobs(&threaded, count / 10, 1, false);
+	printTiming("next frame", timeFrames(&inlined, count, false), timeFrames(&inlined, count, true));
+	printTiming("inline job", timeJobs(&inlined, count, 1, false), timeJobs(&inlined, count, 1, true));
+	printTiming("task thread round trip", timeJobs(&threaded, count / 10, 1, false), timeJobs(&threaded, count / 10, 1, true));
+	printTiming("task thread, 64 in flight", timeJobs(&threaded, count, concurrentTasks, false), timeJobs(&threaded, count, concurrentTasks, true));
+	printf("  %llu wake ups for %llu completions\n", static_cast<unsigned long long>(threaded.stats.wakeups),
+		static_cast<unsigned long long>(threaded.stats.completions));
+
+	termTaskLooper(&threaded);
+	termTaskLooper(&inlined);
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	if (MEMORY_TRACKING && snapshot.heap[MEMORY_TAG_TASKS].liveAllocations != 0) {
+		printf("FAIL: %lld task frames still allocated\n", static_cast<long long>(snapshot.heap[MEMORY_TAG_TASKS].liveAllocations));
+		ok = false;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Times the text path in jni/text_renderer.cpp on the host for 10k labels a frame: packing glyphs
+// into the atlas, laying out labels cold and from the run cache, building the batch, and a frame
+// where a tenth of the labels change, as counters do. Fails if warm frames allocate, if a long
+// string drawn in pieces differs from a cached run, or if anything leaks.
+//
+// Build with:   cc -O2 -c jni/font8x8.c jni/shader_utils.c jni/memory_tracker.c
+//               c++ -O2 -o text_bench host/text_bench.cpp jni/text_renderer.cpp jni/glyph_atlas.cpp
+//                   jni/stream_buffer.cpp jni/gpu_fence.cpp jni/gl_extensions.cpp jni/upload_queue.cpp
+//                   font8x8.o shader_utils.o memory_tracker.o -lGLESv2 -lEGL -lpthread
+// Usage:        text_bench [labels] [frames]
+//
+// No GL calls are made; flushText is not timed, its cost is one copy of the batch into the stream.
+
+#include "../jni/memory_tracker.h"
+#include "../jni/text_renderer.h"
+#include "../jni/time_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const int32_t atlasSize = 1024;
+const int32_t labelLength = 24;
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom() {
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+struct Label {
+	char text[labelLength];
+	TextStyle style;
+	float x;
+	float y;
+};
+
+static void fillLabels(Label* labels, int32_t count) {
+	static const char* const names[] = { "health", "ammo", "score", "wave", "enemy", "gold", "time", "level" };
+	static const uint32_t colors[] = { 0xffffffff, 0xff00ffff, 0xff4080ff, 0xff80ff80 };
+	for (int32_t i = 0; i < count; ++i) {
+		Label* label = &labels[i];
+		snprintf(label->text, labelLength, "%s %d", names[nextRandom() % 8], i);
+		label->style.scale = 1 + nextRandom() % 3;
+		label->style.color = colors[nextRandom() % 4];
+		label->x = nextRandom() % 1920;
+		label->y = nextRandom() % 1080;
+	}
+}
+
+static void drawLabels(TextRenderer* text, const Label* labels, int32_t count) {
+	beginText(text);
+	for (int32_t i = 0; i < count; ++i) {
+		drawText(text, labels[i].text, labels[i].x, labels[i].y, &labels[i].style);
+	}
+}
+
+// Every printable character at every scale the labels use.
+static bool packAtlas(TextRenderer* text) {
+	int64_t start = nowNanoseconds();
+	for (int32_t scale = 1; scale <= 3; ++scale) {
+		for (uint32_t c = 33; c < 127; ++c) {
+			if (!findOrAddGlyph(&text->atlas, c, scale)) {
+				printf("FAIL: no room for '%c' at scale %d\n", c, scale);
+				return false;
+			}
+		}
+	}
+	int64_t elapsed = nowNanoseconds() - start;
+	const GlyphAtlas* atlas = &text->atlas;
+	int32_t usedRows = atlas->shelfCount ? atlas->shelves[atlas->shelfCount - 1].y + atlas->shelves[atlas->shelfCount - 1].height : 0;
+	printf("atlas:    %d glyphs in %.3f ms (%.0f ns each), %d shelves, %d of %d rows\n", atlas->glyphCount, elapsed * 1e-6,
+		static_cast<double>(elapsed) / atlas->glyphCount, atlas->shelfCount, usedRows, atlas->height);
+	return true;
+}
+
+// A string too long for a run goes through the scratch quads and must come out the same as the
+// same glyphs laid out as cached pieces side by side.
+static bool checkLongText(TextRenderer* text) {
+	char longText[TEXT_RUN_MAX_LENGTH * 2 + 8];
+	for (int32_t i = 0; i < TEXT_RUN_MAX_LENGTH * 2 + 7; ++i) {
+		longText[i] = 'a' + i % 26;
+	}
+	longText[TEXT_RUN_MAX_LENGTH * 2 + 7] = '\0';
+	TextStyle style = { 2, 0xffffffff };
+
+	beginText(text);
+	drawText(text, longText, 10.0f, 20.0f, &style);
+	int32_t vertexCount = text->batch.vertexCount;
+	TextVertex* uncached = static_cast<TextVertex*>(malloc(vertexCount * sizeof(TextVertex)));
+	memcpy(uncached, text->batch.vertices, vertexCount * sizeof(TextVertex));
+
+	beginText(text);
+	float x = 10.0f;
+	for (int32_t start = 0; start < TEXT_RUN_MAX_LENGTH * 2 + 7; start += TEXT_RUN_MAX_LENGTH) {
+		char piece[TEXT_RUN_MAX_LENGTH + 1];
+		int32_t pieceLength = strlen(longText + start) < TEXT_RUN_MAX_LENGTH ? strlen(longText + start) : TEXT_RUN_MAX_LENGTH;
+		memcpy(piece, longText + start, pieceLength);
+		piece[pieceLength] = '\0';
+		const TextRun* run = layoutText(text, piece, &style);
+		drawText(text, piece, x, 20.0f, &style);
+		x += run ? run->width : 0.0f;
+	}
+	bool ok = text->batch.vertexCount == vertexCount && memcmp(uncached, text->batch.vertices, vertexCount * sizeof(TextVertex)) == 0;
+	if (!ok) {
+		printf("FAIL: long text differs from the same text drawn in cached pieces\n");
+	}
+	free(uncached);
+	return ok;
+}
+
+static bool run(int32_t count, int32_t frames) {
+	TextRenderer* text = static_cast<TextRenderer*>(calloc(1, sizeof(TextRenderer)));
+	Label* labels = static_cast<Label*>(calloc(count, sizeof(Label)));
+	// room for a frame of labels and a frame of changed ones before anything is stale
+	if (!text || !labels || !initTextRenderer(text, atlasSize, count + count / 2)) {
+		printf("FAIL: could not allocate the renderer for %d labels\n", count);
+		free(text);
+		free(labels);
+		return false;
+	}
+	fillLabels(labels, count);
+	bool ok = packAtlas(text) && checkLongText(text);
+
+	int64_t start = nowNanoseconds();
+	drawLabels(text, labels, count);
+	int64_t cold = nowNanoseconds() - start;
+	printf("cold:     %7.3f ms (%5.0f ns per label), %d vertices\n", cold * 1e-6, static_cast<double>(cold) / count,
+		text->batch.vertexCount);
+
+	uint64_t allocationsBefore = memoryAllocationCount();
+	uint64_t hitsBefore = text->cache.hits;
+	start = nowNanoseconds();
+	for (int32_t frame = 0; frame < frames; ++frame) {
+		drawLabels(text, labels, count);
+	}
+	int64_t warm = nowNanoseconds() - start;
+	uint64_t warmAllocations = memoryAllocationCount() - allocationsBefore;
+	printf("warm:     %7.3f ms (%5.0f ns per label), %.1f%% hits, %llu allocations\n", warm * 1e-6 / frames,
+		static_cast<double>(warm) / frames / count, 100.0 * (text->cache.hits - hitsBefore) / (static_cast<double>(count) * frames),
+		static_cast<unsigned long long>(warmAllocations));
+	if (MEMORY_TRACKING && warmAllocations != 0) {
+		printf("FAIL: warm frames allocated\n");
+		ok = false;
+	}
+
+	// a tenth of the labels get a new value every frame; the old strings go stale and are evicted.
+	// The first ten frames turn every label into a value, which may grow the batch, so are not counted.
+	uint64_t missesBefore = 0;
+	uint64_t evictionsBefore = 0;
+	for (int32_t frame = 0; frame < frames + 10; ++frame) {
+		if (frame == 10) {
+			missesBefore = text->cache.misses;
+			evictionsBefore = text->cache.evictions;
+			allocationsBefore = memoryAllocationCount();
+			start = nowNanoseconds();
+		}
+		for (int32_t i = frame % 10; i < count; i += 10) {
+			snprintf(labels[i].text, labelLength, "value %07d", (frame * count + i) % 10000000);
+		}
+		drawLabels(text, labels, count);
+	}
+	int64_t churn = nowNanoseconds() - start;
+	uint64_t churnAllocations = memoryAllocationCount() - allocationsBefore;
+	printf("changing: %7.3f ms (%5.0f ns per label), %llu misses and %llu evictions a frame, %llu allocations\n",
+		churn * 1e-6 / frames, static_cast<double>(churn) / frames / count,
+		static_cast<unsigned long long>((text->cache.misses - missesBefore) / frames),
+		static_cast<unsigned long long>((text->cache.evictions - evictionsBefore) / frames), static_cast<unsigned long long>(churnAllocations));
+	if (MEMORY_TRACKING && churnAllocations != 0) {
+		printf("FAIL: changing labels allocated\n");
+		ok = false;
+	}
+
+	termTextRenderer(text);
+	free(text);
+	free(labels);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	int32_t count = argc >= 2 ? atoi(argv[1]) : 10000;
+	int32_t frames = argc >= 3 ? atoi(argv[2]) : 100;
+	if (count <= 0 || frames <= 0) {
+		printf("Usage: text_bench [labels] [frames]\n");
+		return 1;
+	}
+	printf("%d labels, %d frames:\n", count, frames);
+	bool ok = run(count, frames);
+
+	MemorySnapshot snapshot;
+	takeMemorySnapshot(&snapshot);
+	if (MEMORY_TRACKING && snapshot.heap[MEMORY_TAG_TEXT].liveAllocations != 0) {
+		printf("FAIL: text storage leaked\n");
+		ok = false;
+	}
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+// Measures what texture uploads cost the render thread with jni/upload_queue.cpp's loader thread,
+// against creating the same textures on the render thread as frames go: frame times, hitches over
+// a 60 Hz frame, upload throughput and submit to ready latency. Also checks that jobs still queued
+// at shutdown complete as cancelled.
+//
+// Build with:   cc -O2 -c jni/memory_tracker.c
+//               c++ -O2 -o upload_bench host/upload_bench.cpp jni/upload_queue.cpp jni/gpu_fence.cpp
+//                   jni/gl_extensions.cpp memory_tracker.o -lGLESv2 -lEGL -lpthread
+// Usage:        EGL_PLATFORM=surfaceless upload_bench [textures] [size]
+//
+// Needs an EGL display with pbuffers and shared contexts; Mesa's surfaceless platform has both, so
+// the loader runs with a real second context as it would on a device. Each frame burns a few ms of
+// CPU, draws with the newest ready texture and finishes; a burst of textures is requested every
+// burstInterval frames.
+
+#include "../jni/gl_extensions.h"
+#include "../jni/gpu_fence.h"
+#include "../jni/memory_tracker.h"
+#include "../jni/time_utils.h"
+#include "../jni/upload_queue.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const int32_t burstSize = 4;
+const int32_t burstInterval = 10; // frames
+const int64_t frameCpuNanoseconds = 3000000;
+const int64_t hitchNanoseconds = 16666667;
+#define BENCH_MAX_TEXTURES 256
+#define BENCH_MAX_FRAMES 4096
+
+static const char vertexShader[] =
+	"attribute vec2 position;\n"
+	"varying vec2 vTexCoord;\n"
+	"void main() {\n"
+	"	vTexCoord = position * 0.5 + 0.5;\n"
+	"	gl_Position = vec4(position, 0.0, 1.0);\n"
+	"}\n";
+
+static const char fragmentShader[] =
+	"precision mediump float;\n"
+	"uniform sampler2D image;\n"
+	"varying vec2 vTexCoord;\n"
+	"void main() {\n"
+	"	gl_FragColor = texture2D(image, vTexCoord);\n"
+	"}\n";
+
+struct Bench {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface;
+	EGLint clientVersion;
+	GLExtensions extensions;
+	EglFenceContext eglFences;
+	GpuFenceProvider fenceProvider;
+	GLuint program;
+	int32_t size;
+	int32_t count;
+	uint8_t* pixels;
+	UploadJob jobs[BENCH_MAX_TEXTURES];
+	GLuint shown; // newest ready texture
+	int32_t ready;
+	int64_t frameNanoseconds[BENCH_MAX_FRAMES];
+};
+
+static void busyWait(int64_t nanoseconds) {
+	int64_t end = nowNanoseconds() + nanoseconds;
+	while (nowNanoseconds() < end) {
+	}
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+static bool initBench(Bench* bench) {
+	bench->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (!eglInitialize(bench->display, NULL, NULL)) {
+		printf("no EGL display; on Mesa try EGL_PLATFORM=surfaceless\n");
+		return false;
+	}
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(bench->display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+		printf("no pbuffer config\n");
+		return false;
+	}
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, 256, EGL_HEIGHT, 256, EGL_NONE };
+	bench->surface = eglCreatePbufferSurface(bench->display, config, surfaceAttribs);
+	bench->clientVersion = 2;
+	const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, bench->clientVersion, EGL_NONE };
+	bench->context = eglCreateContext(bench->display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (bench->surface == EGL_NO_SURFACE || bench->context == EGL_NO_CONTEXT ||
+		!eglMakeCurrent(bench->display, bench->surface, bench->surface, bench->context)) {
+		printf("could not make a context current: 0x%04x\n", eglGetError());
+		return false;
+	}
+	printf("GL %s, %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+	loadGLExtensions(&bench->extensions, bench->display);
+
+	bench->program = glCreateProgram();
+	glAttachShader(bench->program, compileShader(GL_VERTEX_SHADER, vertexShader));
+	glAttachShader(bench->program, compileShader(GL_FRAGMENT_SHADER, fragmentShader));
+	glBindAttribLocation(bench->program, 0, "position");
+	glLinkProgram(bench->program);
+	glUseProgram(bench->program);
+
+	bench->pixels = static_cast<uint8_t*>(malloc(4 * bench->size * bench->size));
+	for (int32_t i = 0; i < 4 * bench->size * bench->size; ++i) {
+		bench->pixels[i] = static_cast<uint8_t>(i * 7);
+	}
+	return true;
+}
+
+static void termBench(Bench* bench) {
+	free(bench->pixels);
+	eglMakeCurrent(bench->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(bench->display, bench->context);
+	eglDestroySurface(bench->display, bench->surface);
+	eglTerminate(bench->display);
+}
+
+static void showTexture(Bench* bench, GLuint texture) {
+	// only the newest is drawn; dropping the rest keeps memory flat over long runs
+	if (bench->shown) {
+		glDeleteTextures(1, &bench->shown);
+		trackGpuMemory(GPU_MEMORY_TEXTURES, -4LL * bench->size * bench->size);
+	}
+	bench->shown = texture;
+	bench->ready++;
+}
+
+static void completeTexture(void* data, UploadJob* job) {
+	Bench* bench = static_cast<Bench*>(data);
+	if (job->state == UPLOAD_READY) {
+		showTexture(bench, job->name);
+	}
+}
+
+static void drawFrame(Bench* bench) {
+	busyWait(frameCpuNanoseconds);
+	static const float quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+	glClear(GL_COLOR_BUFFER_BIT);
+	if (bench->shown) {
+		glBindTexture(GL_TEXTURE_2D, bench->shown);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, quad);
+		glEnableVertexAttribArray(0);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+	// stands in for the swap, which a pbuffer doesn't wait for
+	glFinish();
+}
+
+static int compareTimes(const void* a, const void* b) {
+	int64_t x = *static_cast<const int64_t*>(a);
+	int64_t y = *static_cast<const int64_t*>(b);
+	return x < y ? -1 : x > y;
+}
+
+static void report(Bench* bench, const char* name, int32_t frames, int64_t elapsed, const UploadStats* stats, double latencyMs, double maxLatencyMs) {
+	int32_t hitches = 0;
+	for (int32_t i = 0; i < frames; ++i) {
+		hitches += bench->frameNanoseconds[i] > hitchNanoseconds;
+	}
+	qsort(bench->frameNanoseconds, frames, sizeof(int64_t), compareTimes);
+	double megabytes = 4.0 * bench->size * bench->size * bench->ready / (1024.0 * 1024.0);
+	printf("%-13s %4d frames  p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms  hitches %3d  %7.1f MB/s  latency %6.2f ms avg %7.2f ms max  render thread %7.2f ms\n",
+		name, frames, bench->frameNanoseconds[frames / 2] * 1e-6, bench->frameNanoseconds[frames * 99 / 100] * 1e-6,
+		bench->frameNanoseconds[frames - 1] * 1e-6, hitches, megabytes / (elapsed * 1e-9), latencyMs, maxLatencyMs,
+		stats->pollNanoseconds * 1e-6);
+}
+
+// What the app did before the queue: each requested texture is created during the frame that asks for it.
+static void runRenderThread(Bench* bench) {
+	showTexture(bench, 0);
+	bench->ready = 0;
+	UploadStats stats;
+	memset(&stats, 0, sizeof(stats));
+	int32_t submitted = 0;
+	int32_t frames = 0;
+	double latencySum = 0.0;
+	int64_t latencyMax = 0;
+	int64_t start = nowNanoseconds();
+	while (bench->ready < bench->count && frames < BENCH_MAX_FRAMES) {
+		int64_t frameStart = nowNanoseconds();
+		if (frames % burstInterval == 0) {
+			for (int32_t i = 0; i < burstSize && submitted < bench->count; ++i, ++submitted) {
+				int64_t uploadStart = nowNanoseconds();
+				GLuint texture;
+				glGenTextures(1, &texture);
+				glBindTexture(GL_TEXTURE_2D, texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, bench->size, bench->size, 0, GL_RGBA, GL_UNSIGNED_BYTE, bench->pixels);
+				trackGpuMemory(GPU_MEMORY_TEXTURES, 4LL * bench->size * bench->size);
+				showTexture(bench, texture);
+				int64_t uploadTime = nowNanoseconds() - uploadStart;
+				stats.pollNanoseconds += uploadTime;
+				latencySum += uploadTime;
+				latencyMax = uploadTime > latencyMax ? uploadTime : latencyMax;
+			}
+		}
+		drawFrame(bench);
+		bench->frameNanoseconds[frames++] = nowNanoseconds() - frameStart;
+	}
+	report(bench, "render thread", frames, nowNanoseconds() - start, &stats, latencySum * 1e-6 / bench->ready, latencyMax * 1e-6);
+}
+
+static bool runLoader(Bench* bench, bool fenced) {
+	showTexture(bench, 0);
+	bench->ready = 0;
+	bool hasFences = fenced && initEglFenceProvider(&bench->fenceProvider, &bench->eglFences, bench->display, &bench->extensions);
+	if (fenced && !hasFences) {
+		printf("no EGL_KHR_fence_sync, skipping fenced run\n");
+		return true;
+	}
+	static UploadQueue queue;
+	if (!initUploadQueue(&queue, bench->display, bench->context, bench->clientVersion, EGL_OPENGL_ES2_BIT,
+		hasFences ? &bench->fenceProvider : NULL)) {
+		printf("could not start the loader\n");
+		return false;
+	}
+	int32_t submitted = 0;
+	int32_t frames = 0;
+	int64_t start = nowNanoseconds();
+	while (bench->ready < bench->count && frames < BENCH_MAX_FRAMES) {
+		int64_t frameStart = nowNanoseconds();
+		if (frames % burstInterval == 0) {
+			for (int32_t i = 0; i < burstSize && submitted < bench->count; ++i, ++submitted) {
+				UploadJob* job = &bench->jobs[submitted];
+				memset(job, 0, sizeof(UploadJob));
+				job->type = UPLOAD_TEXTURE;
+				job->format = GL_RGBA;
+				job->filter = GL_LINEAR;
+				job->width = bench->size;
+				job->height = bench->size;
+				job->data = bench->pixels;
+				job->complete = completeTexture;
+				job->completeData = bench;
+				submitUpload(&queue, job);
+			}
+		}
+		pollUploads(&queue, 0);
+		drawFrame(bench);
+		bench->frameNanoseconds[frames++] = nowNanoseconds() - frameStart;
+	}
+	int64_t elapsed = nowNanoseconds() - start;
+	termUploadQueue(&queue);
+	const UploadStats* stats = &queue.stats;
+	report(bench, fenced ? "loader, fence" : "loader, finish", frames, elapsed, stats,
+		stats->jobs ? stats->totalLatencyNanoseconds * 1e-6 / stats->jobs : 0.0, stats->maxLatencyNanoseconds * 1e-6);
+	return stats->failed == 0;
+}
+
+static void countCancelled(void* data, UploadJob* job) {
+	int32_t* cancelled = static_cast<int32_t*>(data);
+	*cancelled += job->state == UPLOAD_CANCELLED && job->name == 0;
+}
+
+// Jobs still queued when the queue shuts down complete as cancelled, with nothing created.
+static bool checkCancelled(Bench* bench) {
+	static UploadQueue queue;
+	// no display: the loader can't start, so nothing is uploaded until pollUploads
+	initUploadQueue(&queue, EGL_NO_DISPLAY, EGL_NO_CONTEXT, bench->clientVersion, EGL_OPENGL_ES2_BIT, NULL);
+	int32_t cancelled = 0;
+	const int32_t count = 4;
+	for (int32_t i = 0; i < count; ++i) {
+		UploadJob* job = &bench->jobs[i];
+		memset(job, 0, sizeof(UploadJob));
+		job->type = UPLOAD_TEXTURE;
+		job->format = GL_RGBA;
+		job->filter = GL_LINEAR;
+		job->width = bench->size;
+		job->height = bench->size;
+		job->data = bench->pixels;
+		job->complete = countCancelled;
+		job->completeData = &cancelled;
+		submitUpload(&queue, job);
+	}
+	termUploadQueue(&queue);
+	bool ok = cancelled == count && queue.stats.cancelled == static_cast<uint32_t>(count) && queue.stats.jobs == 0;
+	printf("shutdown: %d of %d queued jobs cancelled%s\n", cancelled, count, ok ? "" : ", FAILED");
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	static Bench bench;
+	bench.count = argc > 1 ? atoi(argv[1]) : 32;
+	bench.size = argc > 2 ? atoi(argv[2]) : 1024;
+	if (bench.count < 1 || bench.count > BENCH_MAX_TEXTURES || bench.size < 1) {
+		printf("usage: upload_bench [textures up to %d] [size]\n", BENCH_MAX_TEXTURES);
+		return 1;
+	}
+	if (!initBench(&bench)) {
+		return 1;
+	}
+	printf("%d textures of %dx%d RGBA, %d every %d frames, %.1f ms of CPU per frame\n",
+		bench.count, bench.size, bench.size, burstSize, burstInterval, frameCpuNanoseconds * 1e-6);
+	runRenderThread(&bench);
+	bool ok = runLoader(&bench, false) && runLoader(&bench, true) && checkCancelled(&bench);
+	showTexture(&bench, 0);
+	termBench(&bench);
+	return ok ? 0 : 1;
+}
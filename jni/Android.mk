@@ -1,7 +1,7 @@
 LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 LOCAL_MODULE := Angles
-LOCAL_SRC_FILES := main.cpp shader_utils.c android_native_app_glue.c
-LOCAL_LDLIBS := -llog -landroid -lEGL -lGLESv2
+LOCAL_SRC_FILES := main.cpp shader_utils.c android_native_app_glue.c simulation.cpp glyph_atlas.cpp text_renderer.cpp font8x8.c worker_pool.cpp particles.cpp scene.cpp gl_extensions.cpp gpu_fence.cpp stream_buffer.cpp mesh.cpp egl_config.cpp startup_trace.c touch_predictor.cpp memory_tracker.c frame_pacer.cpp scene_renderer.cpp render_graph.cpp post_process.cpp upload_queue.cpp session_recorder.c occlusion_culler.cpp thermal_provider.cpp quality_governor.cpp metrics.c looper_tasks.cpp texture_atlas.cpp
+LOCAL_LDLIBS := -llog -landroid -lEGL -lGLESv2 -ldl
 include $(BUILD_SHARED_LIBRARY)
 $(call import-module,android/native_app_glue)
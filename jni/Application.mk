@@ -1 +1,5 @@
-APP_PLATFORM := android-10
+# NDK r25 is the first whose libc++ has <coroutine>, and its lowest platform is android-19
+APP_PLATFORM := android-19
+# libc++ for <coroutine>; the rest of the code uses no standard library
+APP_STL := c++_static
+APP_CPPFLAGS := -std=c++20
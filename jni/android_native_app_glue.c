@@ -23,11 +23,21 @@
 #include <sys/resource.h>
 
 #include "android_native_app_glue.h"
+#include "memory_tracker.h"
+#include "metrics.h"
+#include "startup_trace.h"
+#include "time_utils.h"
 #include <android/log.h>
 
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "threaded_app", __VA_ARGS__))
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "threaded_app", __VA_ARGS__))
 
+#ifdef SESSION_RECORD
+#include "session_recorder.h"
+
+#include <stdio.h>
+#endif
+
 /* For debug builds, always enable the debug traces in this library */
 #ifndef NDEBUG
 #	define LOGV(...)  ((void)__android_log_print(ANDROID_LOG_VERBOSE, "threaded_app", __VA_ARGS__))
@@ -170,14 +180,109 @@ void app_dummy() {
 
 }
 
+#ifdef SESSION_RECORD
+// Everything the main thread processes goes to <internalDataPath>/session.rec, for host/session_replay.cpp.
+static struct SessionRecorder session_recorder;
+static int64_t session_origin;
+
+static void begin_session_recording(struct android_app* android_app) {
+	const char* dataPath = android_app->activity->internalDataPath;
+	if (dataPath == NULL) {
+		return;
+	}
+	char path[256];
+	snprintf(path, sizeof(path), "%s/session.rec", dataPath);
+	session_origin = nowNanoseconds();
+	if (beginSessionRecording(&session_recorder, fopen(path, "wb"))) {
+		LOGI("Recording session to %s", path);
+	} else {
+		LOGE("Could not record session to %s", path);
+	}
+}
+
+static void record_cmd(struct android_app* android_app, int8_t cmd) {
+	struct SessionRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = SESSION_RECORD_COMMAND;
+	record.nanoseconds = nowNanoseconds() - session_origin;
+	record.command = cmd;
+	// pre_exec has run, so an initialised window is already set and a terminated one not gone yet
+	if (android_app->window != NULL && cmd != APP_CMD_TERM_WINDOW) {
+		record.width = ANativeWindow_getWidth(android_app->window);
+		record.height = ANativeWindow_getHeight(android_app->window);
+	}
+	record.inputQueue = android_app->inputQueue != NULL;
+	recordSession(&session_recorder, &record);
+}
+
+static void record_input(const AInputEvent* event) {
+	struct SessionRecord record;
+	memset(&record, 0, sizeof(record));
+	int64_t now = nowNanoseconds();
+	record.nanoseconds = now - session_origin;
+	if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_KEY) {
+		record.type = SESSION_RECORD_KEY;
+		record.keyCode = AKeyEvent_getKeyCode(event);
+		record.action = AKeyEvent_getAction(event);
+		record.eventNanoseconds = AKeyEvent_getEventTime(event) - now;
+	} else if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION) {
+		record.type = SESSION_RECORD_MOTION;
+		record.action = AMotionEvent_getAction(event);
+		record.eventNanoseconds = AMotionEvent_getEventTime(event) - now;
+		size_t pointerCount = AMotionEvent_getPointerCount(event);
+		record.pointerCount = pointerCount < SESSION_MAX_POINTERS ? (int32_t)pointerCount : SESSION_MAX_POINTERS;
+		for (int32_t i = 0; i < record.pointerCount; ++i) {
+			record.pointers[i].id = AMotionEvent_getPointerId(event, i);
+			record.pointers[i].x = AMotionEvent_getX(event, i);
+			record.pointers[i].y = AMotionEvent_getY(event, i);
+		}
+		// only the newest of a long batch are kept
+		size_t historySize = AMotionEvent_getHistorySize(event);
+		size_t first = historySize > SESSION_MAX_HISTORY ? historySize - SESSION_MAX_HISTORY : 0;
+		record.historySize = (int32_t)(historySize - first);
+		for (int32_t h = 0; h < record.historySize; ++h) {
+			record.historyNanoseconds[h] = AMotionEvent_getHistoricalEventTime(event, first + h) - now;
+			for (int32_t i = 0; i < record.pointerCount; ++i) {
+				record.historyX[h][i] = AMotionEvent_getHistoricalX(event, i, first + h);
+				record.historyY[h][i] = AMotionEvent_getHistoricalY(event, i, first + h);
+			}
+		}
+	} else {
+		return;
+	}
+	recordSession(&session_recorder, &record);
+}
+#endif
+
+// Registry ids, shared by every activity the process creates.
+static int32_t glue_commands_metric = -1;
+static int32_t glue_command_ms_metric = -1;
+static int32_t glue_input_events_metric = -1;
+static int32_t glue_activity_block_ms_metric = -1;
+
+static void register_glue_metrics(void) {
+	static const float milliseconds[] = { 0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 33.0f, 66.0f, 133.0f, 266.0f, 500.0f, 1000.0f };
+	const int32_t count = sizeof(milliseconds) / sizeof(milliseconds[0]);
+	glue_commands_metric = registerCounter("glue.commands");
+	glue_command_ms_metric = registerHistogram("glue.command_ms", milliseconds, count);
+	glue_input_events_metric = registerCounter("glue.input_events");
+	// how long each activity callback holds up the UI thread waiting for the app thread
+	glue_activity_block_ms_metric = registerHistogram("glue.activity_block_ms", milliseconds, count);
+}
+
 static void android_app_destroy(struct android_app* android_app) {
 	LOGV("android_app_destroy!");
 	free_saved_state(android_app);
+	// the android_app itself is freed later, by onDestroy
+	reportMemoryLeaks(android_app);
 	pthread_mutex_lock(&android_app->mutex);
 	if (android_app->inputQueue != NULL) {
 		AInputQueue_detachLooper(android_app->inputQueue);
 	}
 	AConfiguration_delete(android_app->config);
+#ifdef SESSION_RECORD
+	endSessionRecording(&session_recorder);
+#endif
 	android_app->destroyed = 1;
 	pthread_cond_broadcast(&android_app->cond);
 	pthread_mutex_unlock(&android_app->mutex);
@@ -188,6 +293,10 @@ static void process_input(struct android_app* app, struct android_poll_source* s
 	AInputEvent* event = NULL;
 	while (AInputQueue_getEvent(app->inputQueue, &event) >= 0) {
 		LOGV("New input event: type=%d\n", AInputEvent_getType(event));
+#ifdef SESSION_RECORD
+		record_input(event);
+#endif
+		addCounter(glue_input_events_metric, 1);
 		if (AInputQueue_preDispatchEvent(app->inputQueue, event)) {
 			continue;
 		}
@@ -198,19 +307,21 @@ static void process_input(struct android_app* app, struct android_poll_source* s
 }
 
 static void process_cmd(struct android_app* app, struct android_poll_source* source) {
+	int64_t start = nowNanoseconds();
 	int8_t cmd = android_app_read_cmd(app);
 	android_app_pre_exec_cmd(app, cmd);
+#ifdef SESSION_RECORD
+	record_cmd(app, cmd);
+#endif
 	if (app->onAppCmd != NULL) app->onAppCmd(app, cmd);
 	android_app_post_exec_cmd(app, cmd);
+	addCounter(glue_commands_metric, 1);
+	recordHistogram(glue_command_ms_metric, (nowNanoseconds() - start) * 1e-6f);
 }
 
 static void* android_app_entry(void* param) {
 	struct android_app* android_app = (struct android_app*)param;
-
-	android_app->config = AConfiguration_new();
-	AConfiguration_fromAssetManager(android_app->config, android_app->activity->assetManager);
-
-	print_cur_config(android_app);
+	markStartupMilestone("native thread start");
 
 	android_app->cmdPollSource.id = LOOPER_ID_MAIN;
 	android_app->cmdPollSource.app = android_app;
@@ -227,7 +338,18 @@ static void* android_app_entry(void* param) {
 	android_app->running = 1;
 	pthread_cond_broadcast(&android_app->cond);
 	pthread_mutex_unlock(&android_app->mutex);
+	markStartupMilestone("looper ready");
+#ifdef SESSION_RECORD
+	begin_session_recording(android_app);
+#endif
+
+	// only this thread reads the config, so onCreate need not wait for it
+	android_app->config = AConfiguration_new();
+	AConfiguration_fromAssetManager(android_app->config, android_app->activity->assetManager);
+
+	print_cur_config(android_app);
 
+	markStartupMilestone("android_main");
 	android_main(android_app);
 
 	android_app_destroy(android_app);
@@ -239,9 +361,10 @@ static void* android_app_entry(void* param) {
 // --------------------------------------------------------------------
 
 static struct android_app* android_app_create(ANativeActivity* activity, void* savedState, size_t savedStateSize) {
-	struct android_app* android_app = (struct android_app*)malloc(sizeof(struct android_app));
+	struct android_app* android_app = (struct android_app*)MEMORY_ALLOC(MEMORY_TAG_GLUE, sizeof(struct android_app));
 	memset(android_app, 0, sizeof(struct android_app));
 	android_app->activity = activity;
+	register_glue_metrics();
 
 	pthread_mutex_init(&android_app->mutex, NULL);
 	pthread_cond_init(&android_app->cond, NULL);
@@ -282,6 +405,7 @@ static void android_app_write_cmd(struct android_app* android_app, int8_t cmd) {
 }
 
 static void android_app_set_input(struct android_app* android_app, AInputQueue* inputQueue) {
+	int64_t start = nowNanoseconds();
 	pthread_mutex_lock(&android_app->mutex);
 	android_app->pendingInputQueue = inputQueue;
 	android_app_write_cmd(android_app, APP_CMD_INPUT_CHANGED);
@@ -289,9 +413,11 @@ static void android_app_set_input(struct android_app* android_app, AInputQueue*
 		pthread_cond_wait(&android_app->cond, &android_app->mutex);
 	}
 	pthread_mutex_unlock(&android_app->mutex);
+	recordHistogram(glue_activity_block_ms_metric, (nowNanoseconds() - start) * 1e-6f);
 }
 
 static void android_app_set_window(struct android_app* android_app, ANativeWindow* window) {
+	int64_t start = nowNanoseconds();
 	pthread_mutex_lock(&android_app->mutex);
 	if (android_app->pendingWindow != NULL) {
 		android_app_write_cmd(android_app, APP_CMD_TERM_WINDOW);
@@ -304,15 +430,18 @@ static void android_app_set_window(struct android_app* android_app, ANativeWindo
 		pthread_cond_wait(&android_app->cond, &android_app->mutex);
 	}
 	pthread_mutex_unlock(&android_app->mutex);
+	recordHistogram(glue_activity_block_ms_metric, (nowNanoseconds() - start) * 1e-6f);
 }
 
 static void android_app_set_activity_state(struct android_app* android_app, int8_t cmd) {
+	int64_t start = nowNanoseconds();
 	pthread_mutex_lock(&android_app->mutex);
 	android_app_write_cmd(android_app, cmd);
 	while (android_app->activityState != cmd) {
 		pthread_cond_wait(&android_app->cond, &android_app->mutex);
 	}
 	pthread_mutex_unlock(&android_app->mutex);
+	recordHistogram(glue_activity_block_ms_metric, (nowNanoseconds() - start) * 1e-6f);
 }
 
 static void android_app_free(struct android_app* android_app) {
@@ -327,7 +456,7 @@ static void android_app_free(struct android_app* android_app) {
 	close(android_app->msgwrite);
 	pthread_cond_destroy(&android_app->cond);
 	pthread_mutex_destroy(&android_app->mutex);
-	free(android_app);
+	MEMORY_FREE(android_app);
 }
 
 static void onDestroy(ANativeActivity* activity) {
@@ -418,6 +547,8 @@ static void onInputQueueDestroyed(ANativeActivity* activity, AInputQueue* queue)
 }
 
 void ANativeActivity_onCreate(ANativeActivity* activity, void* savedState, size_t savedStateSize) {
+	beginStartupTrace();
+	markStartupMilestone("activity create");
 	LOGV("Creating: %p\n", activity);
 	activity->callbacks->onDestroy = onDestroy;
 	activity->callbacks->onStart = onStart;
@@ -434,4 +565,5 @@ void ANativeActivity_onCreate(ANativeActivity* activity, void* savedState, size_
 	activity->callbacks->onInputQueueDestroyed = onInputQueueDestroyed;
 
 	activity->instance = android_app_create(activity, savedState, savedStateSize);
+	markStartupMilestone("activity created");
 }
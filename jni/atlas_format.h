@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+// Texture atlas files written by tools/atlas_tool.cpp: a header, the page table, the images' UV
+// rectangles and an open addressing hash table from name hash to image, followed by each page's
+// RGBA8 pixels. Everything is stored as the runtime uses it, so the file is mapped and read in
+// place; the pixels start on page boundaries so they can be uploaded straight from the mapping.
+//
+// Images are packed into power-of-two pages in cells aligned to 2^mipLevels pixels, with their
+// edges repeated to fill the cell, so the first mipLevels levels of the mip chain never mix
+// neighbouring images.
+
+#define ATLAS_FILE_MAGIC 0x534c5441 // "ATLS"
+#define ATLAS_FILE_VERSION 1
+#define ATLAS_MAX_PAGES 16
+#define ATLAS_EMPTY_SLOT 0xffffffffu
+#define ATLAS_PIXEL_ALIGNMENT 4096
+
+struct AtlasFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pageCount;
+	uint32_t entryCount;
+	uint32_t slotCount; // a power of two, at least twice entryCount
+	uint32_t maxProbe; // the longest run of slots any lookup has to look at, minus one
+	uint32_t padding; // pixels of repeated edge around each image, at least
+	uint32_t mipLevels;
+	uint32_t pagesOffset;
+	uint32_t entriesOffset;
+	uint32_t slotsOffset;
+	uint32_t reserved;
+};
+
+struct AtlasPageDesc {
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixelOffset; // RGBA8, rows top to bottom
+	uint32_t pixelSize;
+};
+
+// uv is u0, v0, u1, v1 of the image's own pixels, with v = 0 at the first row. The hash is split
+// so the file only needs the 4 byte alignment zipalign gives uncompressed assets.
+struct AtlasEntry {
+	uint32_t nameHashLow;
+	uint32_t nameHashHigh;
+	float uv[4];
+	uint16_t page;
+	uint16_t width;
+	uint16_t height;
+	uint16_t reserved;
+};
+
+// 64-bit FNV-1a of an image's name, its file name without the extension.
+static inline uint64_t atlasNameHash(const char* name) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (const unsigned char* c = (const unsigned char*)name; *c; ++c) {
+		hash = (hash ^ *c) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+// The slot a hash's probe starts at.
+static inline uint32_t atlasHomeSlot(uint64_t nameHash, uint32_t slotCount) {
+	return (uint32_t)(nameHash ^ (nameHash >> 32)) & (slotCount - 1);
+}
@@ -0,0 +1,133 @@
+#include "egl_config.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <stdlib.h>
+
+static const EGLint scoredAttributes[EGL_CONFIG_SCORED_ATTRIBUTES] = {
+	EGL_CONFIG_ID, EGL_RED_SIZE, EGL_GREEN_SIZE, EGL_BLUE_SIZE, EGL_ALPHA_SIZE, EGL_DEPTH_SIZE,
+	EGL_STENCIL_SIZE, EGL_SAMPLES, EGL_SURFACE_TYPE, EGL_RENDERABLE_TYPE, EGL_CONFIG_CAVEAT
+};
+
+EGLint findEglConfigAttribute(const EGLint* attributes, EGLint name) {
+	for (const EGLint* a = attributes; a[0] != EGL_NONE; a += 2) {
+		if (a[0] == name) {
+			return a[1];
+		}
+	}
+	return 0;
+}
+
+void parseEglConfigAttributes(const EGLint* attributes, EglConfigAttributes* config) {
+	config->configId = findEglConfigAttribute(attributes, EGL_CONFIG_ID);
+	config->redSize = findEglConfigAttribute(attributes, EGL_RED_SIZE);
+	config->greenSize = findEglConfigAttribute(attributes, EGL_GREEN_SIZE);
+	config->blueSize = findEglConfigAttribute(attributes, EGL_BLUE_SIZE);
+	config->alphaSize = findEglConfigAttribute(attributes, EGL_ALPHA_SIZE);
+	config->depthSize = findEglConfigAttribute(attributes, EGL_DEPTH_SIZE);
+	config->stencilSize = findEglConfigAttribute(attributes, EGL_STENCIL_SIZE);
+	config->samples = findEglConfigAttribute(attributes, EGL_SAMPLES);
+	config->surfaceType = findEglConfigAttribute(attributes, EGL_SURFACE_TYPE);
+	config->renderableType = findEglConfigAttribute(attributes, EGL_RENDERABLE_TYPE);
+	config->caveat = findEglConfigAttribute(attributes, EGL_CONFIG_CAVEAT);
+}
+
+int32_t scoreEglConfig(const EGLint* attributes, const EglConfigRequirements* requirements) {
+	EglConfigAttributes config;
+	parseEglConfigAttributes(attributes, &config);
+	if ((config.surfaceType & requirements->surfaceType) != requirements->surfaceType ||
+		(config.renderableType & requirements->renderableType) != requirements->renderableType ||
+		config.caveat == EGL_NON_CONFORMANT_CONFIG) {
+		return -1;
+	}
+
+	int32_t score = 0;
+	const EGLint have[] = { config.redSize, config.greenSize, config.blueSize, config.alphaSize, config.depthSize, config.stencilSize };
+	const EGLint want[] = { requirements->redSize, requirements->greenSize, requirements->blueSize, requirements->alphaSize, requirements->depthSize, requirements->stencilSize };
+	for (size_t i = 0; i < sizeof(have) / sizeof(have[0]); ++i) {
+		if (have[i] < want[i]) {
+			// usable but visibly worse, e.g. 565 when 888 was asked for
+			score += 1000 * (want[i] - have[i]);
+		} else {
+			// every unused bit is storage the GPU may have to load and store
+			score += 10 * (have[i] - want[i]);
+		}
+	}
+
+	if (config.samples < requirements->samples) {
+		// fall back to the most samples there are
+		score += 5000 + 500 * (requirements->samples - config.samples);
+	} else {
+		score += 2000 * (config.samples - requirements->samples);
+	}
+
+	if (config.caveat == EGL_SLOW_CONFIG) {
+		score += 100000;
+	}
+	return score;
+}
+
+int32_t selectEglConfig(const EGLint* const* configs, int32_t count, const EglConfigRequirements* requirements) {
+	int32_t best = -1;
+	int32_t bestScore = 0;
+	for (int32_t i = 0; i < count; ++i) {
+		int32_t score = scoreEglConfig(configs[i], requirements);
+		if (score >= 0 && (best < 0 || score < bestScore)) {
+			best = i;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+// Fills attributes with EGL_CONFIG_ATTRIBUTE_LIST_LENGTH values.
+static void readEglConfigAttributeList(EGLDisplay display, EGLConfig config, EGLint* attributes) {
+	for (int32_t i = 0; i < EGL_CONFIG_SCORED_ATTRIBUTES; ++i) {
+		attributes[2 * i] = scoredAttributes[i];
+		attributes[2 * i + 1] = 0;
+		eglGetConfigAttrib(display, config, scoredAttributes[i], &attributes[2 * i + 1]);
+	}
+	attributes[2 * EGL_CONFIG_SCORED_ATTRIBUTES] = EGL_NONE;
+}
+
+bool chooseEglConfig(EGLDisplay display, const EglConfigRequirements* requirements, EGLConfig* config, EglConfigAttributes* attributes) {
+	EGLint count = 0;
+	if (!eglGetConfigs(display, NULL, 0, &count) || count <= 0) {
+		LOGE("eglGetConfigs failed with error 0x%04x", eglGetError());
+		return false;
+	}
+
+	EGLConfig* configs = static_cast<EGLConfig*>(MEMORY_ALLOC(MEMORY_TAG_EGL, count * sizeof(EGLConfig)));
+	EGLint* lists = static_cast<EGLint*>(MEMORY_ALLOC(MEMORY_TAG_EGL, count * EGL_CONFIG_ATTRIBUTE_LIST_LENGTH * sizeof(EGLint)));
+	const EGLint** candidates = static_cast<const EGLint**>(MEMORY_ALLOC(MEMORY_TAG_EGL, count * sizeof(EGLint*)));
+	if (!configs || !lists || !candidates) {
+		MEMORY_FREE(configs);
+		MEMORY_FREE(lists);
+		MEMORY_FREE(candidates);
+		return false;
+	}
+
+	eglGetConfigs(display, configs, count, &count);
+	for (EGLint i = 0; i < count; ++i) {
+		EGLint* list = lists + i * EGL_CONFIG_ATTRIBUTE_LIST_LENGTH;
+		readEglConfigAttributeList(display, configs[i], list);
+		candidates[i] = list;
+	}
+
+	int32_t best = selectEglConfig(candidates, count, requirements);
+	if (best >= 0) {
+		*config = configs[best];
+		parseEglConfigAttributes(candidates[best], attributes);
+		LOGI("EGL config %d of %d: id=%d rgba=%d%d%d%d depth=%d stencil=%d samples=%d score=%d",
+			best, count, attributes->configId, attributes->redSize, attributes->greenSize, attributes->blueSize,
+			attributes->alphaSize, attributes->depthSize, attributes->stencilSize, attributes->samples,
+			scoreEglConfig(candidates[best], requirements));
+	} else {
+		LOGE("None of %d EGL configs is usable", count);
+	}
+
+	MEMORY_FREE(configs);
+	MEMORY_FREE(lists);
+	MEMORY_FREE(candidates);
+	return best >= 0;
+}
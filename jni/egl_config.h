@@ -0,0 +1,51 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <stdint.h>
+
+// What the renderer actually uses. Anything a config has beyond this costs memory and,
+// on tilers, bandwidth whenever the buffers are resolved to memory.
+struct EglConfigRequirements {
+	EGLint redSize;
+	EGLint greenSize;
+	EGLint blueSize;
+	EGLint alphaSize;
+	EGLint depthSize;
+	EGLint stencilSize;
+	EGLint samples;
+	EGLint surfaceType;
+	EGLint renderableType;
+};
+
+struct EglConfigAttributes {
+	EGLint configId;
+	EGLint redSize;
+	EGLint greenSize;
+	EGLint blueSize;
+	EGLint alphaSize;
+	EGLint depthSize;
+	EGLint stencilSize;
+	EGLint samples;
+	EGLint surfaceType;
+	EGLint renderableType;
+	EGLint caveat;
+};
+
+// chooseEglConfig reads each config as a list of the attributes scoring uses.
+#define EGL_CONFIG_SCORED_ATTRIBUTES 11
+#define EGL_CONFIG_ATTRIBUTE_LIST_LENGTH (2 * EGL_CONFIG_SCORED_ATTRIBUTES + 1)
+
+// Config attributes as plain name/value pairs ending with EGL_NONE, the layout of an
+// eglChooseConfig attribute list, so configs can be scored without a display. Missing
+// attributes read as 0.
+EGLint findEglConfigAttribute(const EGLint* attributes, EGLint name);
+void parseEglConfigAttributes(const EGLint* attributes, EglConfigAttributes* config);
+
+// Lower is better; -1 means the config cannot be used at all.
+int32_t scoreEglConfig(const EGLint* attributes, const EglConfigRequirements* requirements);
+
+// Returns the index of the best config, or -1 if none is usable. Ties go to the earlier config.
+int32_t selectEglConfig(const EGLint* const* configs, int32_t count, const EglConfigRequirements* requirements);
+
+// Scores every config the display offers and logs the choice.
+bool chooseEglConfig(EGLDisplay display, const EglConfigRequirements* requirements, EGLConfig* config, EglConfigAttributes* attributes);
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FONT8X8_FIRST_CHAR 0x20
+#define FONT8X8_LAST_CHAR 0x7e
+
+// 8x8 bitmaps for printable ASCII, one byte per row, bit 0 is the leftmost pixel.
+extern const unsigned char font8x8Basic[FONT8X8_LAST_CHAR - FONT8X8_FIRST_CHAR + 1][8];
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,88 @@
+#include "frame_pacer.h"
+#include "time_utils.h"
+#include "log.h"
+
+#include <string.h>
+
+// long enough for any real frame; a fence that takes longer is dropped rather than hang the app
+static const int64_t defaultTimeoutNanoseconds = 100000000;
+
+void initFramePacer(FramePacer* pacer, const GpuFenceProvider* provider, int32_t depth) {
+	memset(pacer, 0, sizeof(FramePacer));
+	pacer->provider = provider;
+	pacer->timeoutNanoseconds = defaultTimeoutNanoseconds;
+	setFramePacerDepth(pacer, depth);
+}
+
+static void popOldestFence(FramePacer* pacer) {
+	destroyGpuFence(pacer->provider, pacer->fences[pacer->oldest]);
+	pacer->fences[pacer->oldest] = NULL;
+	pacer->oldest = (pacer->oldest + 1) % FRAME_PACER_MAX_DEPTH;
+	--pacer->count;
+}
+
+void termFramePacer(FramePacer* pacer) {
+	while (pacer->count > 0) {
+		popOldestFence(pacer);
+	}
+	memset(pacer, 0, sizeof(FramePacer));
+}
+
+void setFramePacerDepth(FramePacer* pacer, int32_t depth) {
+	pacer->depth = depth < 1 ? 1 : (depth > FRAME_PACER_MAX_DEPTH ? FRAME_PACER_MAX_DEPTH : depth);
+}
+
+int64_t beginPacedFrame(FramePacer* pacer) {
+	++pacer->stats.frames;
+	pacer->stats.lastWaitNanoseconds = 0;
+	if (!pacer->provider) {
+		return 0;
+	}
+
+	int64_t start = nowNanoseconds();
+	bool waited = false;
+	while (pacer->count >= pacer->depth) {
+		GpuFence oldest = pacer->fences[pacer->oldest];
+		if (!isGpuFenceSignaled(pacer->provider, oldest)) {
+			waited = true;
+			if (!waitGpuFence(pacer->provider, oldest, pacer->timeoutNanoseconds)) {
+				++pacer->stats.timeouts;
+			}
+		}
+		popOldestFence(pacer);
+	}
+	// also retire anything that finished early, so the queue reflects what is really in flight
+	while (pacer->count > 0 && isGpuFenceSignaled(pacer->provider, pacer->fences[pacer->oldest])) {
+		popOldestFence(pacer);
+	}
+	if (!waited) {
+		return 0;
+	}
+
+	int64_t wait = nowNanoseconds() - start;
+	FramePacerStats* stats = &pacer->stats;
+	++stats->waits;
+	stats->lastWaitNanoseconds = wait;
+	stats->totalWaitNanoseconds += wait;
+	if (wait > stats->maxWaitNanoseconds) {
+		stats->maxWaitNanoseconds = wait;
+	}
+	return wait;
+}
+
+void endPacedFrame(FramePacer* pacer) {
+	if (!pacer->provider) {
+		return;
+	}
+	if (pacer->count == FRAME_PACER_MAX_DEPTH) {
+		// only if beginPacedFrame was skipped
+		popOldestFence(pacer);
+	}
+	GpuFence fence = createGpuFence(pacer->provider);
+	if (!fence) {
+		LOGW("Could not create frame fence");
+		return;
+	}
+	pacer->fences[(pacer->oldest + pacer->count) % FRAME_PACER_MAX_DEPTH] = fence;
+	++pacer->count;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "gpu_fence.h"
+
+#include <stdint.h>
+
+#define FRAME_PACER_MAX_DEPTH 3
+
+struct FramePacerStats {
+	uint64_t frames;
+	uint64_t waits; // frames that had to wait for the GPU
+	uint32_t timeouts;
+	int64_t lastWaitNanoseconds;
+	int64_t totalWaitNanoseconds;
+	int64_t maxWaitNanoseconds;
+};
+
+// Bounds how many frames the CPU may queue ahead of the GPU. Each frame is fenced when it is
+// submitted, and a new frame only starts once at most depth - 1 earlier frames are still
+// unfinished, waiting on the oldest fence if need be. Depth 1 gives the lowest latency, 3 the
+// most CPU/GPU overlap. Without a fence provider the pacer does nothing and the driver decides.
+struct FramePacer {
+	const GpuFenceProvider* provider;
+	int32_t depth;
+	GpuFence fences[FRAME_PACER_MAX_DEPTH];
+	int32_t oldest;
+	int32_t count;
+	int64_t timeoutNanoseconds;
+	FramePacerStats stats;
+};
+
+void initFramePacer(FramePacer* pacer, const GpuFenceProvider* provider, int32_t depth);
+void termFramePacer(FramePacer* pacer);
+
+// Clamped to [1, FRAME_PACER_MAX_DEPTH]; takes effect at the next frame.
+void setFramePacerDepth(FramePacer* pacer, int32_t depth);
+
+// Call before any CPU work for the frame. Returns the time spent waiting for the GPU.
+int64_t beginPacedFrame(FramePacer* pacer);
+
+// Call after the frame's last GL command, before eglSwapBuffers.
+void endPacedFrame(FramePacer* pacer);
@@ -0,0 +1,95 @@
+#include "gl_extensions.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool hasExtension(const char* extensions, const char* name) {
+	if (!extensions) {
+		return false;
+	}
+	size_t length = strlen(name);
+	for (const char* p = strstr(extensions, name); p; p = strstr(p + length, name)) {
+		// match whole names only, GL_EXT_foo must not match GL_EXT_foo_bar
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void loadGLExtensions(GLExtensions* extensions, EGLDisplay display) {
+	memset(extensions, 0, sizeof(GLExtensions));
+	const char* gl = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+	const char* egl = eglQueryString(display, EGL_EXTENSIONS);
+	const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	// "OpenGL ES N.M ..."; a 3.x context can still come back from a version 2 request
+	int major = 0;
+	if (version && sscanf(version, "OpenGL ES %d", &major) == 1 && major >= 3) {
+		extensions->genVertexArrays = reinterpret_cast<PFNGLGENVERTEXARRAYSPROC>(eglGetProcAddress("glGenVertexArrays"));
+		extensions->deleteVertexArrays = reinterpret_cast<PFNGLDELETEVERTEXARRAYSPROC>(eglGetProcAddress("glDeleteVertexArrays"));
+		extensions->bindVertexArray = reinterpret_cast<PFNGLBINDVERTEXARRAYPROC>(eglGetProcAddress("glBindVertexArray"));
+		extensions->vertexAttribDivisor = reinterpret_cast<PFNGLVERTEXATTRIBDIVISORPROC>(eglGetProcAddress("glVertexAttribDivisor"));
+		extensions->drawArraysInstanced = reinterpret_cast<PFNGLDRAWARRAYSINSTANCEDPROC>(eglGetProcAddress("glDrawArraysInstanced"));
+		extensions->bindBufferBase = reinterpret_cast<PFNGLBINDBUFFERBASEPROC>(eglGetProcAddress("glBindBufferBase"));
+		extensions->getUniformBlockIndex = reinterpret_cast<PFNGLGETUNIFORMBLOCKINDEXPROC>(eglGetProcAddress("glGetUniformBlockIndex"));
+		extensions->uniformBlockBinding = reinterpret_cast<PFNGLUNIFORMBLOCKBINDINGPROC>(eglGetProcAddress("glUniformBlockBinding"));
+		extensions->es3 = extensions->genVertexArrays && extensions->deleteVertexArrays && extensions->bindVertexArray &&
+			extensions->vertexAttribDivisor && extensions->drawArraysInstanced && extensions->bindBufferBase &&
+			extensions->getUniformBlockIndex && extensions->uniformBlockBinding;
+	}
+
+	if (hasExtension(gl, "GL_EXT_map_buffer_range")) {
+		extensions->mapBufferRangeEXT = reinterpret_cast<PFNGLMAPBUFFERRANGEEXTPROC>(eglGetProcAddress("glMapBufferRangeEXT"));
+		extensions->unmapBufferOES = reinterpret_cast<PFNGLUNMAPBUFFEROESPROC>(eglGetProcAddress("glUnmapBufferOES"));
+		extensions->mapBufferRange = extensions->mapBufferRangeEXT && extensions->unmapBufferOES;
+	}
+	if (!extensions->mapBufferRange && extensions->es3) {
+		// core in 3.0 with the same signatures and tokens, and drivers often stop listing the extension
+		extensions->mapBufferRangeEXT = reinterpret_cast<PFNGLMAPBUFFERRANGEEXTPROC>(eglGetProcAddress("glMapBufferRange"));
+		extensions->unmapBufferOES = reinterpret_cast<PFNGLUNMAPBUFFEROESPROC>(eglGetProcAddress("glUnmapBuffer"));
+		extensions->mapBufferRange = extensions->mapBufferRangeEXT && extensions->unmapBufferOES;
+	}
+
+	if (hasExtension(gl, "GL_EXT_discard_framebuffer")) {
+		extensions->discardFramebufferEXT = reinterpret_cast<PFNGLDISCARDFRAMEBUFFEREXTPROC>(eglGetProcAddress("glDiscardFramebufferEXT"));
+		extensions->discardFramebuffer = extensions->discardFramebufferEXT != NULL;
+	}
+
+	if (hasExtension(gl, "GL_KHR_parallel_shader_compile")) {
+		extensions->maxShaderCompilerThreadsKHR = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+		extensions->parallelShaderCompile = extensions->maxShaderCompilerThreadsKHR != NULL;
+		if (extensions->parallelShaderCompile) {
+			// let the driver pick how many threads to use
+			extensions->maxShaderCompilerThreadsKHR(0xffffffffu);
+		}
+	}
+
+	if (hasExtension(egl, "EGL_KHR_fence_sync")) {
+		extensions->createSyncKHR = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(eglGetProcAddress("eglCreateSyncKHR"));
+		extensions->destroySyncKHR = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(eglGetProcAddress("eglDestroySyncKHR"));
+		extensions->clientWaitSyncKHR = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(eglGetProcAddress("eglClientWaitSyncKHR"));
+		extensions->getSyncAttribKHR = reinterpret_cast<PFNEGLGETSYNCATTRIBKHRPROC>(eglGetProcAddress("eglGetSyncAttribKHR"));
+		extensions->fenceSync = extensions->createSyncKHR && extensions->destroySyncKHR &&
+			extensions->clientWaitSyncKHR && extensions->getSyncAttribKHR;
+	}
+
+	LOGI("OpenGL ES 3.0: %s, GL_EXT_map_buffer_range: %s, GL_EXT_discard_framebuffer: %s, GL_KHR_parallel_shader_compile: %s, EGL_KHR_fence_sync: %s",
+		extensions->es3 ? "yes" : "no", extensions->mapBufferRange ? "yes" : "no", extensions->discardFramebuffer ? "yes" : "no",
+		extensions->parallelShaderCompile ? "yes" : "no", extensions->fenceSync ? "yes" : "no");
+}
+
+void discardDefaultFramebuffer(const GLExtensions* extensions, bool depth, bool stencil) {
+	GLenum attachments[2];
+	GLsizei count = 0;
+	if (depth) {
+		attachments[count++] = GL_DEPTH_EXT;
+	}
+	if (stencil) {
+		attachments[count++] = GL_STENCIL_EXT;
+	}
+	if (count > 0 && extensions->discardFramebuffer) {
+		extensions->discardFramebufferEXT(GL_FRAMEBUFFER, count, attachments);
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (GL_APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
+
+// The app links only libGLESv2 so it still runs on ES2 devices, so the few OpenGL ES 3.0 core entry
+// points the ES3 path uses are declared here and resolved at run time.
+#ifndef GL_ES_VERSION_3_0
+#define GL_UNIFORM_BUFFER 0x8A11
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+typedef void (GL_APIENTRYP PFNGLGENVERTEXARRAYSPROC)(GLsizei n, GLuint* arrays);
+typedef void (GL_APIENTRYP PFNGLDELETEVERTEXARRAYSPROC)(GLsizei n, const GLuint* arrays);
+typedef void (GL_APIENTRYP PFNGLBINDVERTEXARRAYPROC)(GLuint array);
+typedef void (GL_APIENTRYP PFNGLVERTEXATTRIBDIVISORPROC)(GLuint index, GLuint divisor);
+typedef void (GL_APIENTRYP PFNGLDRAWARRAYSINSTANCEDPROC)(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+typedef void (GL_APIENTRYP PFNGLBINDBUFFERBASEPROC)(GLenum target, GLuint index, GLuint buffer);
+typedef GLuint (GL_APIENTRYP PFNGLGETUNIFORMBLOCKINDEXPROC)(GLuint program, const GLchar* uniformBlockName);
+typedef void (GL_APIENTRYP PFNGLUNIFORMBLOCKBINDINGPROC)(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+#endif
+
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR 0x0040
+#endif
+
+// Optional GL and EGL features, resolved once per context. Missing entry points are left NULL.
+struct GLExtensions {
+	// OpenGL ES 3.0 core, only set when the context reports version 3 or later
+	bool es3;
+	PFNGLGENVERTEXARRAYSPROC genVertexArrays;
+	PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+	PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+	PFNGLVERTEXATTRIBDIVISORPROC vertexAttribDivisor;
+	PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+	PFNGLBINDBUFFERBASEPROC bindBufferBase;
+	PFNGLGETUNIFORMBLOCKINDEXPROC getUniformBlockIndex;
+	PFNGLUNIFORMBLOCKBINDINGPROC uniformBlockBinding;
+
+	bool mapBufferRange;
+	PFNGLMAPBUFFERRANGEEXTPROC mapBufferRangeEXT;
+	PFNGLUNMAPBUFFEROESPROC unmapBufferOES;
+
+	bool discardFramebuffer;
+	PFNGLDISCARDFRAMEBUFFEREXTPROC discardFramebufferEXT;
+
+	bool parallelShaderCompile;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreadsKHR;
+
+	bool fenceSync;
+	PFNEGLCREATESYNCKHRPROC createSyncKHR;
+	PFNEGLDESTROYSYNCKHRPROC destroySyncKHR;
+	PFNEGLCLIENTWAITSYNCKHRPROC clientWaitSyncKHR;
+	PFNEGLGETSYNCATTRIBKHRPROC getSyncAttribKHR;
+};
+
+bool hasExtension(const char* extensions, const char* name);
+
+// Requires a current context.
+void loadGLExtensions(GLExtensions* extensions, EGLDisplay display);
+
+// Tells a tiler that the default framebuffer's depth and/or stencil contents need not be written back.
+void discardDefaultFramebuffer(const GLExtensions* extensions, bool depth, bool stencil);
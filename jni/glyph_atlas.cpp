@@ -0,0 +1,141 @@
+#include "glyph_atlas.h"
+#include "font8x8.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const int32_t glyphPadding = 1;
+
+static uint32_t glyphKey(uint32_t character, int32_t scale) {
+	return (static_cast<uint32_t>(scale) << 24) | (character & 0xffffff);
+}
+
+static uint32_t hashGlyphKey(uint32_t key) {
+	key ^= key >> 16;
+	key *= 0x7feb352d;
+	key ^= key >> 15;
+	return key;
+}
+
+bool initGlyphAtlas(GlyphAtlas* atlas, int32_t width, int32_t height) {
+	memset(atlas, 0, sizeof(GlyphAtlas));
+	atlas->width = width;
+	atlas->height = height;
+	atlas->maxShelves = height / (8 + glyphPadding);
+	atlas->glyphCapacity = 1024;
+	atlas->pixels = static_cast<uint8_t*>(MEMORY_CALLOC(MEMORY_TAG_TEXT, width * height, 1));
+	atlas->shelves = static_cast<GlyphShelf*>(MEMORY_CALLOC(MEMORY_TAG_TEXT, atlas->maxShelves, sizeof(GlyphShelf)));
+	atlas->glyphs = static_cast<Glyph*>(MEMORY_CALLOC(MEMORY_TAG_TEXT, atlas->glyphCapacity, sizeof(Glyph)));
+	if (!atlas->pixels || !atlas->shelves || !atlas->glyphs) {
+		termGlyphAtlas(atlas);
+		return false;
+	}
+	return true;
+}
+
+void termGlyphAtlas(GlyphAtlas* atlas) {
+	MEMORY_FREE(atlas->pixels);
+	MEMORY_FREE(atlas->shelves);
+	MEMORY_FREE(atlas->glyphs);
+	memset(atlas, 0, sizeof(GlyphAtlas));
+}
+
+static bool allocateGlyphRect(GlyphAtlas* atlas, int32_t width, int32_t height, uint16_t* outX, uint16_t* outY) {
+	int32_t paddedWidth = width + glyphPadding;
+	int32_t paddedHeight = height + glyphPadding;
+
+	// best fit: the shortest existing shelf tall enough with room left
+	GlyphShelf* best = NULL;
+	for (int32_t i = 0; i < atlas->shelfCount; ++i) {
+		GlyphShelf* shelf = &atlas->shelves[i];
+		if (shelf->height >= paddedHeight && shelf->nextX + paddedWidth <= atlas->width &&
+			(!best || shelf->height < best->height)) {
+			best = shelf;
+		}
+	}
+
+	if (!best) {
+		int32_t top = 0;
+		if (atlas->shelfCount > 0) {
+			GlyphShelf* last = &atlas->shelves[atlas->shelfCount - 1];
+			top = last->y + last->height;
+		}
+		if (atlas->shelfCount == atlas->maxShelves || top + paddedHeight > atlas->height || paddedWidth > atlas->width) {
+			return false;
+		}
+		best = &atlas->shelves[atlas->shelfCount++];
+		best->y = top;
+		best->height = paddedHeight;
+		best->nextX = 0;
+	}
+
+	*outX = best->nextX;
+	*outY = best->y;
+	best->nextX += paddedWidth;
+	return true;
+}
+
+static void rasterizeGlyph(GlyphAtlas* atlas, const unsigned char* bitmap, const Glyph* glyph, int32_t scale) {
+	for (int32_t y = 0; y < glyph->height; ++y) {
+		uint8_t* row = atlas->pixels + (glyph->y + y) * atlas->width + glyph->x;
+		unsigned char bits = bitmap[y / scale];
+		for (int32_t x = 0; x < glyph->width; ++x) {
+			row[x] = ((bits >> (x / scale)) & 1) ? 0xff : 0x00;
+		}
+	}
+	if (atlas->dirtyMinY == atlas->dirtyMaxY) {
+		atlas->dirtyMinY = glyph->y;
+		atlas->dirtyMaxY = glyph->y + glyph->height;
+	} else {
+		if (glyph->y < atlas->dirtyMinY) atlas->dirtyMinY = glyph->y;
+		if (glyph->y + glyph->height > atlas->dirtyMaxY) atlas->dirtyMaxY = glyph->y + glyph->height;
+	}
+}
+
+const Glyph* findOrAddGlyph(GlyphAtlas* atlas, uint32_t character, int32_t scale) {
+	if (character < FONT8X8_FIRST_CHAR || character > FONT8X8_LAST_CHAR || scale < 1 || scale > 255) {
+		return NULL;
+	}
+
+	uint32_t key = glyphKey(character, scale);
+	uint32_t mask = atlas->glyphCapacity - 1;
+	uint32_t slot = hashGlyphKey(key) & mask;
+	while (atlas->glyphs[slot].key != 0) {
+		if (atlas->glyphs[slot].key == key) {
+			return &atlas->glyphs[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	if (atlas->full || atlas->glyphCount * 4 >= atlas->glyphCapacity * 3) {
+		return NULL;
+	}
+
+	Glyph glyph;
+	glyph.key = key;
+	glyph.width = 8 * scale;
+	glyph.height = 8 * scale;
+	glyph.advance = 8 * scale;
+	if (!allocateGlyphRect(atlas, glyph.width, glyph.height, &glyph.x, &glyph.y)) {
+		LOGW("Glyph atlas is full (%d glyphs)", atlas->glyphCount);
+		atlas->full = true;
+		return NULL;
+	}
+
+	rasterizeGlyph(atlas, font8x8Basic[character - FONT8X8_FIRST_CHAR], &glyph, scale);
+	atlas->glyphs[slot] = glyph;
+	++atlas->glyphCount;
+	return &atlas->glyphs[slot];
+}
+
+void markGlyphAtlasDirty(GlyphAtlas* atlas) {
+	atlas->dirtyMinY = 0;
+	atlas->dirtyMaxY = atlas->height;
+}
+
+void clearGlyphAtlasDirty(GlyphAtlas* atlas) {
+	atlas->dirtyMinY = 0;
+	atlas->dirtyMaxY = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+struct Glyph {
+	uint32_t key;
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+	uint16_t advance;
+};
+
+struct GlyphShelf {
+	uint16_t y;
+	uint16_t height;
+	uint16_t nextX;
+};
+
+// Single channel glyph atlas packed on demand with a shelf packer. Glyphs are never evicted;
+// the working set for a bitmap font is a few hundred entries per scale.
+struct GlyphAtlas {
+	int32_t width;
+	int32_t height;
+	uint8_t* pixels;
+	GlyphShelf* shelves;
+	int32_t shelfCount;
+	int32_t maxShelves;
+	Glyph* glyphs; // open addressing table, key 0 is empty
+	int32_t glyphCapacity;
+	int32_t glyphCount;
+	int32_t dirtyMinY; // rows that changed since the last upload, [dirtyMinY, dirtyMaxY)
+	int32_t dirtyMaxY;
+	bool full;
+};
+
+bool initGlyphAtlas(GlyphAtlas* atlas, int32_t width, int32_t height);
+void termGlyphAtlas(GlyphAtlas* atlas);
+
+// Returns the glyph for the character at the given integer scale, rasterizing it
+// into the atlas on first use. Returns NULL if the character has no bitmap or the atlas is full.
+const Glyph* findOrAddGlyph(GlyphAtlas* atlas, uint32_t character, int32_t scale);
+
+void markGlyphAtlasDirty(GlyphAtlas* atlas);
+void clearGlyphAtlasDirty(GlyphAtlas* atlas);
@@ -0,0 +1,99 @@
+#include "gpu_fence.h"
+#include "time_utils.h"
+
+#include <string.h>
+#include <time.h>
+
+static GpuFence eglCreateFence(void* context) {
+	EglFenceContext* egl = static_cast<EglFenceContext*>(context);
+	EGLSyncKHR sync = egl->extensions->createSyncKHR(egl->display, EGL_SYNC_FENCE_KHR, NULL);
+	return sync == EGL_NO_SYNC_KHR ? NULL : sync;
+}
+
+static bool eglIsFenceSignaled(void* context, GpuFence fence) {
+	EglFenceContext* egl = static_cast<EglFenceContext*>(context);
+	EGLint status = EGL_UNSIGNALED_KHR;
+	egl->extensions->getSyncAttribKHR(egl->display, fence, EGL_SYNC_STATUS_KHR, &status);
+	return status == EGL_SIGNALED_KHR;
+}
+
+static bool eglWaitFence(void* context, GpuFence fence, int64_t timeoutNanoseconds) {
+	EglFenceContext* egl = static_cast<EglFenceContext*>(context);
+	// flush so the fence is guaranteed to reach the GPU, or the wait could never finish
+	EGLint result = egl->extensions->clientWaitSyncKHR(egl->display, fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, timeoutNanoseconds);
+	return result == EGL_CONDITION_SATISFIED_KHR;
+}
+
+static void eglDestroyFence(void* context, GpuFence fence) {
+	EglFenceContext* egl = static_cast<EglFenceContext*>(context);
+	egl->extensions->destroySyncKHR(egl->display, fence);
+}
+
+bool initEglFenceProvider(GpuFenceProvider* provider, EglFenceContext* context, EGLDisplay display, const GLExtensions* extensions) {
+	memset(provider, 0, sizeof(GpuFenceProvider));
+	if (!extensions->fenceSync) {
+		return false;
+	}
+	context->display = display;
+	context->extensions = extensions;
+	provider->context = context;
+	provider->create = eglCreateFence;
+	provider->isSignaled = eglIsFenceSignaled;
+	provider->wait = eglWaitFence;
+	provider->destroy = eglDestroyFence;
+	return true;
+}
+
+// Simulated fences are slot indices offset by one so that NULL stays invalid.
+static int64_t* simulatedCompletion(SimulatedGpu* gpu, GpuFence fence) {
+	uintptr_t id = reinterpret_cast<uintptr_t>(fence) - 1;
+	return &gpu->completion[id % SIMULATED_GPU_MAX_FENCES];
+}
+
+static GpuFence simulatedCreateFence(void* context) {
+	SimulatedGpu* gpu = static_cast<SimulatedGpu*>(context);
+	int64_t now = nowNanoseconds();
+	int64_t start = gpu->busyUntilNanoseconds > now ? gpu->busyUntilNanoseconds : now;
+	gpu->busyUntilNanoseconds = start + gpu->frameNanoseconds;
+	int64_t done = now + gpu->latencyNanoseconds;
+	if (gpu->busyUntilNanoseconds > done) {
+		done = gpu->busyUntilNanoseconds;
+	}
+
+	uint32_t id = gpu->nextFence++;
+	gpu->completion[id % SIMULATED_GPU_MAX_FENCES] = done;
+	return reinterpret_cast<GpuFence>(static_cast<uintptr_t>(id % SIMULATED_GPU_MAX_FENCES) + 1);
+}
+
+static bool simulatedIsFenceSignaled(void* context, GpuFence fence) {
+	return nowNanoseconds() >= *simulatedCompletion(static_cast<SimulatedGpu*>(context), fence);
+}
+
+static bool simulatedWaitFence(void* context, GpuFence fence, int64_t timeoutNanoseconds) {
+	int64_t now = nowNanoseconds();
+	int64_t done = *simulatedCompletion(static_cast<SimulatedGpu*>(context), fence);
+	if (done <= now) {
+		return true;
+	}
+	int64_t sleep = done - now < timeoutNanoseconds ? done - now : timeoutNanoseconds;
+	struct timespec ts = { static_cast<time_t>(sleep / 1000000000LL), static_cast<long>(sleep % 1000000000LL) };
+	nanosleep(&ts, NULL);
+	return nowNanoseconds() >= done;
+}
+
+static void simulatedDestroyFence(void*, GpuFence) {
+}
+
+void initSimulatedGpu(SimulatedGpu* gpu, int64_t latencyNanoseconds, int64_t frameNanoseconds) {
+	memset(gpu, 0, sizeof(SimulatedGpu));
+	gpu->latencyNanoseconds = latencyNanoseconds;
+	gpu->frameNanoseconds = frameNanoseconds;
+}
+
+void initSimulatedFenceProvider(GpuFenceProvider* provider, SimulatedGpu* gpu) {
+	provider->context = gpu;
+	provider->create = simulatedCreateFence;
+	provider->isSignaled = simulatedIsFenceSignaled;
+	provider->wait = simulatedWaitFence;
+	provider->destroy = simulatedDestroyFence;
+}
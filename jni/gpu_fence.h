@@ -0,0 +1,57 @@
+#pragma once
+
+#include "gl_extensions.h"
+
+#include <stdint.h>
+
+typedef void* GpuFence;
+
+// Fences mark a point in the GPU command stream. The provider is either backed by
+// EGL_KHR_fence_sync or by a simulated GPU, so fence-driven code can be exercised off device.
+struct GpuFenceProvider {
+	void* context;
+	GpuFence (*create)(void* context);
+	bool (*isSignaled)(void* context, GpuFence fence);
+	// Returns true if the fence signaled within the timeout.
+	bool (*wait)(void* context, GpuFence fence, int64_t timeoutNanoseconds);
+	void (*destroy)(void* context, GpuFence fence);
+};
+
+struct EglFenceContext {
+	EGLDisplay display;
+	const GLExtensions* extensions;
+};
+
+// Returns false if the display doesn't support EGL_KHR_fence_sync.
+bool initEglFenceProvider(GpuFenceProvider* provider, EglFenceContext* context, EGLDisplay display, const GLExtensions* extensions);
+
+#define SIMULATED_GPU_MAX_FENCES 64
+
+// Models a GPU that executes submitted frames one after another, each taking frameNanoseconds,
+// and finishes them latencyNanoseconds after submission at the earliest.
+struct SimulatedGpu {
+	int64_t latencyNanoseconds;
+	int64_t frameNanoseconds;
+	int64_t busyUntilNanoseconds;
+	int64_t completion[SIMULATED_GPU_MAX_FENCES];
+	uint32_t nextFence;
+};
+
+void initSimulatedGpu(SimulatedGpu* gpu, int64_t latencyNanoseconds, int64_t frameNanoseconds);
+void initSimulatedFenceProvider(GpuFenceProvider* provider, SimulatedGpu* gpu);
+
+static inline GpuFence createGpuFence(const GpuFenceProvider* provider) {
+	return provider->create(provider->context);
+}
+
+static inline bool isGpuFenceSignaled(const GpuFenceProvider* provider, GpuFence fence) {
+	return provider->isSignaled(provider->context, fence);
+}
+
+static inline bool waitGpuFence(const GpuFenceProvider* provider, GpuFence fence, int64_t timeoutNanoseconds) {
+	return provider->wait(provider->context, fence, timeoutNanoseconds);
+}
+
+static inline void destroyGpuFence(const GpuFenceProvider* provider, GpuFence fence) {
+	provider->destroy(provider->context, fence);
+}
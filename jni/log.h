@@ -1,5 +1,14 @@
+#ifdef __ANDROID__
 #include <android/log.h>
 
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "Angles", __VA_ARGS__))
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "Angles", __VA_ARGS__))
 #define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, "Angles", __VA_ARGS__))
+#else
+// host builds of the shared sources (see host/)
+#include <stdio.h>
+
+#define LOGE(...) ((void)fprintf(stderr, "E/Angles: " __VA_ARGS__), (void)fputc('\n', stderr))
+#define LOGI(...) ((void)fprintf(stderr, "I/Angles: " __VA_ARGS__), (void)fputc('\n', stderr))
+#define LOGW(...) ((void)fprintf(stderr, "W/Angles: " __VA_ARGS__), (void)fputc('\n', stderr))
+#endif
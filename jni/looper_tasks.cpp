@@ -0,0 +1,290 @@
+#include "looper_tasks.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+// rounds of processing termTaskLooper allows for tasks to return
+const int32_t taskLooperTermRounds = 1000;
+
+static void appendJob(TaskJob** head, TaskJob** tail, TaskJob* job) {
+	job->next = NULL;
+	if (*tail) {
+		(*tail)->next = job;
+	} else {
+		*head = job;
+	}
+	*tail = job;
+}
+
+// Called with the mutex held; the caller signals the pipe if this returns true.
+static bool completeJobLocked(TaskLooper* tasks, TaskJob* job) {
+	bool wasEmpty = tasks->completed == NULL;
+	appendJob(&tasks->completed, &tasks->completedTail, job);
+	return wasEmpty;
+}
+
+static void signalCompletion(TaskLooper* tasks) {
+	char c = 0;
+	if (write(tasks->writeFd, &c, 1) != 1) {
+		LOGE("signalCompletion: could not write to the pipe: %s", strerror(errno));
+	}
+}
+
+static void* runTaskThread(void* data) {
+	TaskLooper* tasks = static_cast<TaskLooper*>(data);
+	pthread_mutex_lock(&tasks->mutex);
+	while (true) {
+		while (!tasks->queued && !tasks->quit) {
+			pthread_cond_wait(&tasks->cond, &tasks->mutex);
+		}
+		// queued jobs still run when quitting
+		TaskJob* job = tasks->queued;
+		if (!job) {
+			break;
+		}
+		tasks->queued = job->next;
+		if (!tasks->queued) {
+			tasks->queuedTail = NULL;
+		}
+		pthread_mutex_unlock(&tasks->mutex);
+		job->run(job->data);
+		pthread_mutex_lock(&tasks->mutex);
+		// the job may be gone as soon as the looper thread sees it
+		if (completeJobLocked(tasks, job)) {
+			signalCompletion(tasks);
+		}
+	}
+	pthread_mutex_unlock(&tasks->mutex);
+	return NULL;
+}
+
+static void processTaskSource(android_app*, android_poll_source* source) {
+	processTaskLooper(reinterpret_cast<TaskLooper*>(source));
+}
+
+bool initTaskLooper(TaskLooper* tasks, ALooper* looper, int32_t threadCount) {
+	memset(tasks, 0, sizeof(TaskLooper));
+	tasks->readFd = -1;
+	tasks->writeFd = -1;
+	int pipeFds[2];
+	if (pipe(pipeFds) != 0) {
+		LOGE("initTaskLooper: could not create the pipe: %s", strerror(errno));
+		return false;
+	}
+	tasks->readFd = pipeFds[0];
+	tasks->writeFd = pipeFds[1];
+	// drained until empty on each wake up
+	fcntl(tasks->readFd, F_SETFL, fcntl(tasks->readFd, F_GETFL) | O_NONBLOCK);
+	pthread_mutex_init(&tasks->mutex, NULL);
+	pthread_cond_init(&tasks->cond, NULL);
+
+	tasks->pollSource.id = LOOPER_ID_USER;
+	tasks->pollSource.process = processTaskSource;
+	tasks->looper = looper;
+	if (ALooper_addFd(looper, tasks->readFd, LOOPER_ID_USER, ALOOPER_EVENT_INPUT, NULL, &tasks->pollSource) != 1) {
+		LOGE("initTaskLooper: could not add the pipe to the looper");
+		termTaskLooper(tasks);
+		return false;
+	}
+
+	if (threadCount > TASK_LOOPER_MAX_THREADS) {
+		threadCount = TASK_LOOPER_MAX_THREADS;
+	}
+	for (int32_t i = 0; i < threadCount; ++i) {
+		if (pthread_create(&tasks->threads[i], NULL, runTaskThread, tasks) != 0) {
+			LOGW("initTaskLooper: started %d of %d threads", i, threadCount);
+			break;
+		}
+		++tasks->threadCount;
+	}
+	return true;
+}
+
+void termTaskLooper(TaskLooper* tasks) {
+	if (tasks->readFd < 0) {
+		return;
+	}
+	pthread_mutex_lock(&tasks->mutex);
+	tasks->quit = true;
+	pthread_cond_broadcast(&tasks->cond);
+	pthread_mutex_unlock(&tasks->mutex);
+	for (int32_t i = 0; i < tasks->threadCount; ++i) {
+		pthread_join(tasks->threads[i], NULL);
+	}
+	// from here on jobs run inline
+	tasks->threadCount = 0;
+
+	int32_t rounds = 0;
+	while (tasks->pending > 0 && rounds++ < taskLooperTermRounds) {
+		processTaskLooper(tasks);
+		advanceTaskFrame(tasks);
+	}
+	if (tasks->pending > 0) {
+		LOGW("termTaskLooper: %d jobs and frame waits still pending", tasks->pending);
+	}
+
+	if (tasks->looper) {
+		ALooper_removeFd(tasks->looper, tasks->readFd);
+	}
+	close(tasks->readFd);
+	close(tasks->writeFd);
+	tasks->readFd = -1;
+	tasks->writeFd = -1;
+	pthread_cond_destroy(&tasks->cond);
+	pthread_mutex_destroy(&tasks->mutex);
+}
+
+void submitTaskJob(TaskLooper* tasks, TaskJob* job) {
+	++tasks->pending;
+	++tasks->stats.jobs;
+	if (tasks->threadCount == 0) {
+		// completes on a later poll all the same, so a task never resumes inside its own await
+		job->run(job->data);
+		pthread_mutex_lock(&tasks->mutex);
+		bool signal = completeJobLocked(tasks, job);
+		pthread_mutex_unlock(&tasks->mutex);
+		if (signal) {
+			signalCompletion(tasks);
+		}
+		return;
+	}
+	pthread_mutex_lock(&tasks->mutex);
+	appendJob(&tasks->queued, &tasks->queuedTail, job);
+	pthread_cond_signal(&tasks->cond);
+	pthread_mutex_unlock(&tasks->mutex);
+}
+
+void waitTaskFrame(TaskLooper* tasks, TaskJob* job) {
+	++tasks->pending;
+	++tasks->stats.frameWaits;
+	job->cancelled = false;
+	appendJob(&tasks->frameWaits, &tasks->frameWaitsTail, job);
+}
+
+static void completeJobs(TaskLooper* tasks, TaskJob* job) {
+	while (job) {
+		// resuming may free the job, and may queue new ones
+		TaskJob* next = job->next;
+		--tasks->pending;
+		++tasks->stats.completions;
+		if (job->complete) {
+			job->complete(job->data);
+		} else {
+			job->continuation.resume();
+		}
+		job = next;
+	}
+}
+
+void processTaskLooper(TaskLooper* tasks) {
+	char buffer[64];
+	ssize_t bytes;
+	while ((bytes = read(tasks->readFd, buffer, sizeof(buffer))) > 0) {
+		++tasks->stats.wakeups;
+	}
+	pthread_mutex_lock(&tasks->mutex);
+	TaskJob* completed = tasks->completed;
+	tasks->completed = NULL;
+	tasks->completedTail = NULL;
+	pthread_mutex_unlock(&tasks->mutex);
+	completeJobs(tasks, completed);
+}
+
+void advanceTaskFrame(TaskLooper* tasks) {
+	// waits made while these resume are for the frame after
+	TaskJob* waits = tasks->frameWaits;
+	tasks->frameWaits = NULL;
+	tasks->frameWaitsTail = NULL;
+	for (TaskJob* job = waits; job; job = job->next) {
+		job->cancelled = tasks->quit;
+	}
+	completeJobs(tasks, waits);
+}
+
+void* allocateTaskFrame(size_t size) {
+	void* frame = MEMORY_ALLOC(MEMORY_TAG_TASKS, size);
+	if (!frame) {
+		LOGE("allocateTaskFrame: out of memory for a %d byte task", static_cast<int32_t>(size));
+	}
+	return frame;
+}
+
+void freeTaskFrame(void* frame) {
+	MEMORY_FREE(frame);
+}
+
+bool startTask(Task task) {
+	Task::Handle handle = task.handle;
+	if (!handle) {
+		return false;
+	}
+	task.handle = Task::Handle();
+	handle.promise().detached = true;
+	handle.resume();
+	return true;
+}
+
+TaskJobAwaiter runOnTaskThread(TaskLooper* tasks, TaskFunction function, void* data) {
+	TaskJobAwaiter awaiter;
+	awaiter.job = TaskJob();
+	awaiter.tasks = tasks;
+	awaiter.job.run = function;
+	awaiter.job.data = data;
+	return awaiter;
+}
+
+static void readFileJob(void* data) {
+	FileReadAwaiter* file = static_cast<FileReadAwaiter*>(data);
+	file->result = -1;
+	int fd = open(file->path, O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	size_t total = 0;
+	while (total < file->size) {
+		ssize_t bytes = read(fd, static_cast<char*>(file->buffer) + total, file->size - total);
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes < 0) {
+			close(fd);
+			return;
+		}
+		if (bytes == 0) {
+			break;
+		}
+		total += bytes;
+	}
+	close(fd);
+	file->result = static_cast<int64_t>(total);
+}
+
+void FileReadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+	// the awaiter has reached its place in the coroutine frame by now
+	job.data = this;
+	job.continuation = handle;
+	submitTaskJob(tasks, &job);
+}
+
+FileReadAwaiter readFileAsync(TaskLooper* tasks, const char* path, void* buffer, size_t size) {
+	FileReadAwaiter awaiter;
+	awaiter.job = TaskJob();
+	awaiter.tasks = tasks;
+	awaiter.job.run = readFileJob;
+	awaiter.path = path;
+	awaiter.buffer = buffer;
+	awaiter.size = size;
+	awaiter.result = -1;
+	return awaiter;
+}
+
+FrameAwaiter nextFrame(TaskLooper* tasks) {
+	FrameAwaiter awaiter;
+	awaiter.job = TaskJob();
+	awaiter.tasks = tasks;
+	return awaiter;
+}
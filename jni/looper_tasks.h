@@ -0,0 +1,238 @@
+#pragma once
+
+// C++20 coroutines whose continuations run on the looper thread, so long operations can be written
+// as straight-line code without blocking the main loop.
+//
+// Blocking work runs on the looper's own threads. A finished job is queued back, and a byte on a
+// pipe registered with ALooper_addFd, like the glue's command pipe, wakes the loop. Its poll source
+// then resumes the waiting coroutines in order. Frame waits resume from advanceTaskFrame. Awaiting
+// allocates nothing: each await's job lives in the coroutine frame. The frames are allocated with
+// MEMORY_TAG_TASKS. Everything except the job functions runs on the looper thread.
+//
+//	Task loadLevel(AppState* appState) {
+//		int64_t bytes = co_await readFileAsync(&appState->tasks, path, buffer, size);
+//		co_await runOnTaskThread(&appState->tasks, decompressJob, &level);
+//		while (!uploaded(&level)) {
+//			bool frame = co_await nextFrame(&appState->tasks);
+//			if (!frame) {
+//				co_return; // shutting down
+//			}
+//		}
+//	}
+//	startTask(loadLevel(appState));
+
+#include "android_native_app_glue.h"
+
+#include <coroutine>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TASK_LOOPER_MAX_THREADS 4
+
+typedef void (*TaskFunction)(void* data);
+
+// Work for a task thread, or a wait for the next frame. The job is owned by the caller and must
+// stay alive until it has completed. Completion resumes continuation or, if it is set, calls
+// complete instead.
+struct TaskJob {
+	TaskFunction run; // on a task thread; inline on the looper thread if there are none
+	TaskFunction complete; // on the looper thread
+	void* data;
+	std::coroutine_handle<> continuation;
+	bool cancelled; // frame waits: the looper is shutting down
+	TaskJob* next;
+};
+
+struct TaskLooperStats {
+	uint64_t jobs;
+	uint64_t frameWaits;
+	uint64_t wakeups; // of the looper, by the completion pipe
+	uint64_t completions;
+};
+
+struct TaskLooper {
+	// first, so process can get back from the source to the looper
+	android_poll_source pollSource;
+	ALooper* looper;
+	int readFd;
+	int writeFd;
+	pthread_t threads[TASK_LOOPER_MAX_THREADS];
+	int32_t threadCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool quit;
+	TaskJob* queued; // for the task threads
+	TaskJob* queuedTail;
+	TaskJob* completed; // for the looper thread
+	TaskJob* completedTail;
+	TaskJob* frameWaits; // only touched by the looper thread
+	TaskJob* frameWaitsTail;
+	int32_t pending; // jobs and frame waits not completed yet
+	TaskLooperStats stats;
+};
+
+// Registers the completion pipe with looper under LOOPER_ID_USER; the loop calls pollSource's
+// process like the glue's sources. threadCount is clamped to TASK_LOOPER_MAX_THREADS; with 0
+// jobs run on the looper thread, still completing on a later poll.
+bool initTaskLooper(TaskLooper* tasks, ALooper* looper, int32_t threadCount);
+// Finishes the queued jobs, resumes the frame waits cancelled and keeps processing until nothing
+// is pending, so tasks get to return. Tasks must not wait for frames once cancelled.
+void termTaskLooper(TaskLooper* tasks);
+
+void submitTaskJob(TaskLooper* tasks, TaskJob* job);
+void waitTaskFrame(TaskLooper* tasks, TaskJob* job);
+// Completes the finished jobs; called by pollSource's process.
+void processTaskLooper(TaskLooper* tasks);
+// Completes the frame waits made before this call. Call once per frame, after the swap.
+void advanceTaskFrame(TaskLooper* tasks);
+
+void* allocateTaskFrame(size_t size);
+void freeTaskFrame(void* frame);
+
+// A coroutine that starts suspended and is either started, detached, by startTask, or awaited by
+// another task, which then continues when it returns.
+struct Task {
+	struct promise_type;
+	typedef std::coroutine_handle<promise_type> Handle;
+
+	struct FinalAwaiter {
+		bool await_ready() const noexcept {
+			return false;
+		}
+		std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+			promise_type& promise = handle.promise();
+			if (promise.continuation) {
+				return promise.continuation;
+			}
+			if (promise.detached) {
+				handle.destroy();
+			}
+			return std::noop_coroutine();
+		}
+		void await_resume() const noexcept {
+		}
+	};
+
+	struct promise_type {
+		std::coroutine_handle<> continuation;
+		bool detached;
+
+		promise_type() : detached(false) {
+		}
+		Task get_return_object() {
+			return Task(Handle::from_promise(*this));
+		}
+		// without exceptions a frame that can't be allocated gives a null task
+		static Task get_return_object_on_allocation_failure() {
+			return Task(Handle());
+		}
+		std::suspend_always initial_suspend() const noexcept {
+			return std::suspend_always();
+		}
+		FinalAwaiter final_suspend() const noexcept {
+			return FinalAwaiter();
+		}
+		void return_void() {
+		}
+		void unhandled_exception() {
+			abort();
+		}
+		static void* operator new(size_t size) noexcept {
+			return allocateTaskFrame(size);
+		}
+		static void operator delete(void* frame) {
+			freeTaskFrame(frame);
+		}
+	};
+
+	Handle handle;
+
+	explicit Task(Handle handle) : handle(handle) {
+	}
+	Task(Task&& other) : handle(other.handle) {
+		other.handle = Handle();
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	// awaited by another task: runs now and resumes the awaiting one when it returns
+	bool await_ready() const noexcept {
+		return !handle;
+	}
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	void await_resume() const noexcept {
+	}
+};
+
+// Runs the task on the calling thread until it first suspends; its frame is freed when it returns.
+// False if the frame could not be allocated.
+bool startTask(Task task);
+
+struct TaskJobAwaiter {
+	TaskLooper* tasks;
+	TaskJob job;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> handle) {
+		job.continuation = handle;
+		submitTaskJob(tasks, &job);
+	}
+	void await_resume() const noexcept {
+	}
+};
+
+// Calls function(data) on a task thread; data must stay valid until the await returns.
+TaskJobAwaiter runOnTaskThread(TaskLooper* tasks, TaskFunction function, void* data);
+
+struct FileReadAwaiter {
+	TaskLooper* tasks;
+	TaskJob job;
+	const char* path;
+	void* buffer;
+	size_t size;
+	int64_t result;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> handle);
+	int64_t await_resume() const noexcept {
+		return result;
+	}
+};
+
+// Reads up to size bytes from the start of the file at path on a task thread. The await returns
+// the bytes read, or -1 if the file could not be read.
+FileReadAwaiter readFileAsync(TaskLooper* tasks, const char* path, void* buffer, size_t size);
+
+struct FrameAwaiter {
+	TaskLooper* tasks;
+	TaskJob job;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> handle) {
+		job.continuation = handle;
+		waitTaskFrame(tasks, &job);
+	}
+	// false when the looper is shutting down instead
+	bool await_resume() const noexcept {
+		return !job.cancelled;
+	}
+};
+
+// Resumes after the next advanceTaskFrame.
+FrameAwaiter nextFrame(TaskLooper* tasks);
@@ -1,44 +1,131 @@
 #include "log.h"
 #include "android_native_app_glue.h"
+#include "egl_config.h"
+#include "font8x8.h"
+#include "frame_pacer.h"
+#include "gl_extensions.h"
+#include "gpu_fence.h"
+#include "looper_tasks.h"
+#include "memory_tracker.h"
+#include "metrics.h"
+#include "particles.h"
+#include "post_process.h"
+#include "quality_governor.h"
+#include "render_graph.h"
+#include "scene.h"
+#include "scene_renderer.h"
 #include "shader_utils.h"
+#include "simulation.h"
+#include "startup_trace.h"
+#include "stream_buffer.h"
+#include "text_renderer.h"
+#include "thermal_provider.h"
+#include "time_utils.h"
+#include "touch_predictor.h"
+#include "upload_queue.h"
+#include "worker_pool.h"
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+const int32_t simulationTicksPerSecond = 60;
+const int32_t simulationMaxTicksPerFrame = 5;
+const float movingBlockSpeed = 60.0f; // pixels per second
+
+const int32_t maxParticles = 100000;
+const int32_t particlesPerMotionSample = 16;
+const float particleSpeed = 200.0f; // pixels per second
+const float particleLifetime = 1.5f; // seconds
+const float particleSize = 12.0f; // pixels
+
+// the frame being drawn typically reaches the display this many frame intervals after it starts
+const float touchDisplayLatencyFrames = 2.0f;
+const int64_t initialFrameIntervalNanoseconds = 16666667;
+
+const int32_t textAtlasSize = 256;
+const int32_t textMaxRuns = 256;
+const int32_t textScale = 2;
+
+// every visible scene node is drawn as scene_renderer's triangle
+const Bounds2D triangleBounds = { -0.5f, -0.5f, 0.5f, 0.5f };
+
+// frames the CPU may queue ahead of the GPU: 1 for the lowest latency, up to 3 for throughput
+const int32_t framesInFlight = 2;
+const uint64_t framePacingLogInterval = 600; // frames
+
+const GLsizeiptr vertexStreamSegmentSize = 2 * 1024 * 1024;
+const int32_t vertexStreamSegments = 3;
+// only spent when there is no loader thread and uploads happen on the render thread
+const int64_t uploadBudgetNanoseconds = 2000000;
+
+// in order; a strength of 0 turns an effect and any passes it needs off
+const PostEffect postEffects[] = {
+	{ POST_EFFECT_BLOOM, 0.6f, { 0.6f, 2.0f } }, // threshold, half resolution
+	{ POST_EFFECT_COLOR_GRADE, 0.0f, { 1.2f, 1.1f } }, // saturation, contrast
+	{ POST_EFFECT_VIGNETTE, 0.35f, { 0.6f, 1.5f } } // inner and outer radius
+};
 
-const char vertexShader[] = 
-	"attribute vec4 position;\n"
-	"varying vec3 color;\n"
-	"void main() {\n"
-	"	color = position.xyz*0.5 + vec3(0.5);\n"
-	"	gl_Position = position;\n"
-	"}\n";
-
-const char fragmentShader[] = 
-	"precision mediump float;\n"
-	"varying vec3 color;\n"
-	"void main() {\n"
-	"	gl_FragColor = vec4(color, 1.0);\n"
-	"}\n";
-
-const GLfloat triangleVertices[] = {
-	 0.0f,  0.5f,
-	-0.5f, -0.5f,
-	 0.5f, -0.5f
+// best first; a tier runs the post effects whose bit it has, at their strength above
+const uint32_t allPostEffects = (1u << POST_EFFECT_BLOOM) | (1u << POST_EFFECT_COLOR_GRADE) | (1u << POST_EFFECT_VIGNETTE);
+const QualityTier qualityTiers[] = {
+	{ "high", 1.0f, allPostEffects, 1, THERMAL_STATUS_LIGHT },
+	{ "medium", 0.75f, allPostEffects, 1, THERMAL_STATUS_MODERATE },
+	{ "low", 0.5f, allPostEffects & ~(1u << POST_EFFECT_BLOOM), 1, THERMAL_STATUS_SEVERE },
+	{ "minimum", 0.5f, 0, 2, THERMAL_STATUS_SHUTDOWN } // half the refresh rate
 };
+// in internalDataPath, read instead of the platform's thermal status where that is missing
+const char* const thermalStandInFile = "thermal_status";
+
+// written to internalDataPath every interval until the app is destroyed
+const char* const metricsFile = "metrics.json";
+const int64_t metricsIntervalNanoseconds = 1000000000LL;
+// histogram upper bounds, around the 60, 30 and 15 Hz frame times
+const float frameMillisecondBounds[] = { 2.0f, 4.0f, 8.0f, 12.0f, 16.7f, 20.0f, 25.0f, 33.3f, 50.0f, 66.7f, 100.0f, 250.0f };
+const float inputLatencyMillisecondBounds[] = { 1.0f, 2.0f, 4.0f, 8.0f, 12.0f, 16.7f, 25.0f, 33.3f, 50.0f, 100.0f };
+
+// for file writes and other blocking work started from the main loop
+const int32_t taskThreads = 1;
+
+const int32_t maxSceneNodes = 1024;
+const float sceneCellSize = 256.0f;
+const int32_t sceneGridSize = 16;
 
 struct SavedState {
 	float x;
 	float y;
 };
 
-struct GLObjects {
-	GLuint program;
-	GLuint positionLocation;
+// Ids into the metrics registry; -1 if the registry was full.
+struct AppMetrics {
+	int32_t frames;
+	int32_t frameInterval;
+	int32_t frameCpu; // from the end of the pacer's wait to the swap
+	int32_t pacerWait;
+	int32_t qualityTier;
+	int32_t particles;
+	int32_t visibleNodes;
+	int32_t motionEvents;
+	int32_t keyEvents;
+	int32_t inputLatency; // from the event's timestamp to the app handling it
+};
+
+// Window independent setup, run on its own thread from the start of android_main so that it
+// overlaps window creation and EGL initialisation.
+struct StartupTasks {
+	pthread_t thread;
+	bool started;
+	bool joined;
+	bool succeeded;
 };
 
 struct AppState {
 	android_app* app;
+	StartupTasks startup;
+	bool firstFramePresented;
 	bool windowInitialized;
 	bool resumed;
 	bool focused;
@@ -49,7 +136,38 @@ struct AppState {
 	int32_t width;
 	int32_t height;
 	SavedState savedState;
-	GLObjects glObjects;
+	EglConfigAttributes configAttributes;
+	GLExtensions glExtensions;
+	EglFenceContext eglFences;
+	GpuFenceProvider fenceProvider;
+	UploadQueue uploads;
+	FramePacer framePacer;
+	RenderGraph renderGraph;
+	RenderGraphStats renderGraphStats; // the last ones logged
+	PostProcess postProcess;
+	ThermalProvider thermal;
+	AndroidThermalContext androidThermal;
+	FileThermalContext fileThermal;
+	QualityGovernor quality;
+	StreamBuffer vertexStream;
+	Simulation simulation;
+	int32_t movingBlock;
+	TextRenderer textRenderer;
+	WorkerPool workers;
+	Particles particles;
+	Scene scene;
+	SceneRenderer sceneRenderer;
+	int32_t viewportNode;
+	int32_t triangleNode;
+	TouchPredictor touchPredictor;
+	bool touchActive;
+	int32_t touchPointerId;
+	int64_t lastFrameNanoseconds;
+	float frameIntervalNanoseconds; // moving average
+	MemorySnapshot memorySnapshot; // the last one exported, for allocation rates
+	AppMetrics metrics;
+	MetricsExporter metricsExporter;
+	TaskLooper tasks;
 };
 
 void printGLString(const char* name, GLenum e) {
@@ -57,22 +175,92 @@ void printGLString(const char* name, GLenum e) {
 	LOGI("GL %s = %s", name, s);
 }
 
-bool initDisplay(AppState* appState) {
+static void* runStartupTasks(void* data) {
+	AppState* appState = static_cast<AppState*>(data);
+	markStartupMilestone("startup tasks begin");
+	appState->startup.succeeded = false;
+
+	if (!initSimulation(&appState->simulation, 1, simulationTicksPerSecond, simulationMaxTicksPerFrame)) {
+		LOGE("Could not create simulation");
+		return NULL;
+	}
+	appState->movingBlock = addSimulationEntity(&appState->simulation, 0.0f, 0.0f, movingBlockSpeed, 0.0f);
+
+	if (!initTextRenderer(&appState->textRenderer, textAtlasSize, textMaxRuns)) {
+		LOGE("Could not create text renderer");
+		return NULL;
+	}
+	// rasterize the glyphs up front, the first frame then only uploads the atlas
+	for (uint32_t c = FONT8X8_FIRST_CHAR; c <= FONT8X8_LAST_CHAR; ++c) {
+		findOrAddGlyph(&appState->textRenderer.atlas, c, textScale);
+	}
+
+	if (!initScene(&appState->scene, maxSceneNodes, sceneCellSize, sceneGridSize, sceneGridSize)) {
+		LOGE("Could not create scene");
+		return NULL;
+	}
+	const Bounds2D noBounds = { 0.0f, 0.0f, -1.0f, -1.0f };
+	appState->viewportNode = addSceneNode(&appState->scene, -1, &identityTransform, &noBounds);
+	appState->triangleNode = addSceneNode(&appState->scene, appState->viewportNode, &identityTransform, &triangleBounds);
+
+	if (!initWorkerPool(&appState->workers, defaultWorkerThreadCount()) ||
+		!initParticles(&appState->particles, maxParticles, &appState->workers)) {
+		LOGE("Could not create particle system");
+		return NULL;
+	}
+
+	appState->startup.succeeded = true;
+	markStartupMilestone("startup tasks end");
+	return NULL;
+}
+
+bool startStartupTasks(AppState* appState) {
+	if (pthread_create(&appState->startup.thread, NULL, runStartupTasks, appState) != 0) {
+		LOGE("Could not create startup thread");
+		return false;
+	}
+	appState->startup.started = true;
+	return true;
+}
+
+// Everything the startup tasks create may only be touched once this returned true.
+bool joinStartupTasks(AppState* appState) {
+	if (appState->startup.started && !appState->startup.joined) {
+		pthread_join(appState->startup.thread, NULL);
+		appState->startup.joined = true;
+		markStartupMilestone("startup tasks joined");
+		if (!appState->startup.succeeded) {
+			ANativeActivity_finish(appState->app->activity);
+		}
+	}
+	return appState->startup.joined && appState->startup.succeeded;
+}
+
+// Records each EGL object in appState as soon as it exists, so termDisplay can unwind a failure.
+static bool createDisplay(AppState* appState) {
 	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 	eglInitialize(display, 0, 0);
+	appState->display = display;
 
-	const EGLint configAttribs[] = {
-		//		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-		//		EGL_CONFORMANT, EGL_OPENGL_ES2_BIT,
-		//		EGL_BLUE_SIZE, 8,
-		//		EGL_GREEN_SIZE, 8,
-		//		EGL_RED_SIZE, 8,
-		EGL_NONE
+	// no depth, stencil or multisampling: the scene is 2D and none of it would be used
+	EglConfigRequirements configRequirements = {
+		8, 8, 8, 0,
+		0, 0, 0,
+		EGL_WINDOW_BIT, EGL_OPENGL_ES2_BIT
 	};
+	// prefer a 3.0 context, which needs EGL_KHR_create_context to ask for on EGL 1.4
+	EGLint clientVersion = 2;
 	EGLConfig config;
-	EGLint numConfigs;
-	eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+	if (hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_create_context")) {
+		EglConfigRequirements es3Requirements = configRequirements;
+		es3Requirements.renderableType = EGL_OPENGL_ES3_BIT_KHR;
+		if (chooseEglConfig(display, &es3Requirements, &config, &appState->configAttributes)) {
+			clientVersion = 3;
+		}
+	}
+	if (clientVersion == 2 && !chooseEglConfig(display, &configRequirements, &config, &appState->configAttributes)) {
+		return false;
+	}
 
 	EGLint format;
 	eglGetConfigAttrib(display, config, EGL_NATIVE_VISUAL_ID, &format);
@@ -80,40 +268,72 @@ bool initDisplay(AppState* appState) {
 	ANativeWindow_setBuffersGeometry(appState->app->window, 0, 0, format);
 
 	EGLSurface surface = eglCreateWindowSurface(display, config, appState->app->window, NULL);
+	appState->surface = surface;
 
 	EGLint contextAttribs[] = {
-		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_CONTEXT_CLIENT_VERSION, clientVersion,
 		EGL_NONE
 	};
 
 	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT && clientVersion == 3 && (appState->configAttributes.renderableType & EGL_OPENGL_ES2_BIT)) {
+		LOGW("OpenGL ES 3.0 context failed with error 0x%04x, falling back to 2.0", eglGetError());
+		contextAttribs[1] = 2;
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	}
 	if (context == EGL_NO_CONTEXT) {
 		LOGE("eglCreateContext failed with error 0x%04x", eglGetError());
 		return false;
 	}
+	appState->context = context;
 
 	if (eglMakeCurrent(display, surface, surface, context) == EGL_FALSE) {
 		LOGE("eglMakeCurrent failed with error 0x%04x", eglGetError());
 		return false;
 	}
 
-	appState->display = display;
-	appState->context = context;
-	appState->surface = surface;
+	markStartupMilestone("egl context");
 
 	printGLString("Version", GL_VERSION);
 	printGLString("Vendor", GL_VENDOR);
 	printGLString("Renderer", GL_RENDERER);
+#ifndef NDEBUG
 	printGLString("Extensions", GL_EXTENSIONS);
+#endif
+
+	// submit every program before any other setup and only wait for them at the end, so the
+	// compiles overlap the rest of initialisation
+	loadGLExtensions(&appState->glExtensions, display);
+	initRenderGraph(&appState->renderGraph, &appState->glExtensions);
+	memset(&appState->renderGraphStats, 0, sizeof(RenderGraphStats));
+	if (!initSceneRendererGL(&appState->sceneRenderer, &appState->glExtensions) || !initPostProcessGL(&appState->postProcess)) {
+		return false;
+	}
 
-	GLuint program = createProgram(vertexShader, fragmentShader);
-	if (!program) {
-		LOGE("Could not create program");
+	// the loader context starts while those compile; the text atlas is its first upload
+	bool hasFences = initEglFenceProvider(&appState->fenceProvider, &appState->eglFences, display, &appState->glExtensions);
+	initUploadQueue(&appState->uploads, display, context, contextAttribs[1],
+		contextAttribs[1] == 3 ? EGL_OPENGL_ES3_BIT_KHR : EGL_OPENGL_ES2_BIT, hasFences ? &appState->fenceProvider : NULL);
+	// the text renderer and particles are created by the startup tasks, so their programs wait for the join
+	if (!joinStartupTasks(appState) || !initTextRendererGL(&appState->textRenderer, &appState->uploads) ||
+		!initParticlesGL(&appState->particles)) {
+		return false;
+	}
+	markStartupMilestone("programs submitted");
+
+	// a new surface starts at a swap interval of 1
+	eglSwapInterval(display, currentQualityTier(&appState->quality)->swapInterval);
+	initFramePacer(&appState->framePacer, hasFences ? &appState->fenceProvider : NULL, framesInFlight);
+	if (!initStreamBuffer(&appState->vertexStream, GL_ARRAY_BUFFER, vertexStreamSegmentSize, vertexStreamSegments,
+		&appState->glExtensions, hasFences ? &appState->fenceProvider : NULL)) {
+		LOGE("Could not create vertex stream");
 		return false;
 	}
 
-	appState->glObjects.program = program;
-	appState->glObjects.positionLocation = glGetAttribLocation(program, "position");
+	if (!finishSceneRendererGL(&appState->sceneRenderer) || !finishPostProcessGL(&appState->postProcess) || !finishTextRendererGL(&appState->textRenderer) || !finishParticlesGL(&appState->particles)) {
+		return false;
+	}
+	markStartupMilestone("programs linked");
 
 	return true;
 }
@@ -127,60 +347,273 @@ void updateViewportIfNecessary(AppState* appState) {
 		appState->width = w;
 		appState->height = h;
 		glViewport(0, 0, w, h);
+
+		// assumes triple buffering; the driver may use fewer or more
+		const EglConfigAttributes* config = &appState->configAttributes;
+		int32_t bitsPerPixel = config->redSize + config->greenSize + config->blueSize + config->alphaSize + config->depthSize + config->stencilSize;
+		setGpuMemory(GPU_MEMORY_WINDOW, 3LL * w * h * bitsPerPixel / 8);
+		setSimulationBounds(&appState->simulation, w, 0.0f);
+
+		// maps [-1:1] with y up onto the window in pixels with y down
+		Transform2D viewport = { w * 0.5f, 0.0f, 0.0f, h * -0.5f, w * 0.5f, h * 0.5f };
+		setSceneNodeTransform(&appState->scene, appState->viewportNode, &viewport);
 	}
 }
 
-void drawFrame(AppState* appState) {
-	updateViewportIfNecessary(appState);
+void logFramePacing(AppState* appState) {
+	FramePacerStats* stats = &appState->framePacer.stats;
+	LOGI("Frame pacing: %d in flight, %llu of %llu frames waited, mean %.2f ms, max %.2f ms, %u timeouts",
+		appState->framePacer.depth, static_cast<unsigned long long>(stats->waits), static_cast<unsigned long long>(stats->frames),
+		stats->waits ? stats->totalWaitNanoseconds * 1e-6 / stats->waits : 0.0, stats->maxWaitNanoseconds * 1e-6, stats->timeouts);
+	memset(stats, 0, sizeof(FramePacerStats));
+}
 
-	float x = appState->savedState.x;
-	float y = appState->savedState.y;
-	if (x > 1.0f && y > 1.0f) { 
-		x /= appState->width;
-		y /= appState->height;
-	} else {
-		// assume stick in range [-1:1]
-		x = x * 0.5f + 0.5f;
-		y = y * 0.5f + 0.5f;
+void applyQualityTier(AppState* appState) {
+	const QualityTier* tier = currentQualityTier(&appState->quality);
+	for (size_t i = 0; i < sizeof(postEffects) / sizeof(postEffects[0]); ++i) {
+		bool allowed = (tier->postEffects & (1u << postEffects[i].type)) != 0;
+		setPostEffectStrength(&appState->postProcess, postEffects[i].type, allowed ? postEffects[i].strength : 0.0f);
 	}
+	if (appState->display != EGL_NO_DISPLAY) {
+		eglSwapInterval(appState->display, tier->swapInterval);
+	}
+}
+
+// The platform's thermal status where there is one, otherwise the stand-in file if it exists.
+void initThermal(AppState* appState) {
+	if (initAndroidThermalProvider(&appState->thermal, &appState->androidThermal)) {
+		LOGI("Thermal status from the platform");
+		return;
+	}
+	const char* dataPath = appState->app->activity->internalDataPath;
+	if (dataPath) {
+		char path[FILE_THERMAL_MAX_PATH];
+		snprintf(path, sizeof(path), "%s/%s", dataPath, thermalStandInFile);
+		if (initFileThermalProvider(&appState->thermal, &appState->fileThermal, path)) {
+			LOGI("Thermal status from %s", path);
+			return;
+		}
+	}
+	appState->thermal.read = NULL;
+	LOGI("No thermal status; quality follows frame times only");
+}
 
-	glClearColor(x, 1.0f - y, 0.5f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+// What the passes need from drawFrame; only valid while the frame's graph executes.
+struct FrameContext {
+	AppState* appState;
+	float x; // pointer position in [0:1]
+	float y;
+	int64_t frameNanoseconds;
+	float renderScale; // scene pixels per window pixel
+};
 
-	glUseProgram(appState->glObjects.program);
-	glVertexAttribPointer(appState->glObjects.positionLocation, 2, GL_FLOAT, GL_FALSE, 0, triangleVertices);
-	glEnableVertexAttribArray(appState->glObjects.positionLocation);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
+static void drawScenePass(void* data, const RenderGraph*, int32_t) {
+	const FrameContext* frame = static_cast<const FrameContext*>(data);
+	AppState* appState = frame->appState;
+
+	// clearing every attachment the config has lets a tiler skip loading the previous frame
+	GLbitfield clearMask = GL_COLOR_BUFFER_BIT;
+	if (appState->configAttributes.depthSize > 0) {
+		clearMask |= GL_DEPTH_BUFFER_BIT;
+	}
+	if (appState->configAttributes.stencilSize > 0) {
+		clearMask |= GL_STENCIL_BUFFER_BIT;
+	}
+	glClearColor(frame->x, 1.0f - frame->y, 0.5f, 1.0f);
+	glClear(clearMask);
+
+	updateScene(&appState->scene);
+	Bounds2D view = { 0.0f, 0.0f, static_cast<float>(appState->width), static_cast<float>(appState->height) };
+	cullScene(&appState->scene, &view);
+
+	drawSceneNodes(&appState->sceneRenderer, &appState->vertexStream, appState->scene.worldTransform,
+		appState->scene.visible, appState->scene.visibleCount, appState->width, appState->height);
+
+	drawParticles(&appState->particles, &appState->vertexStream, appState->width, appState->height, particleSize * frame->renderScale);
+}
+
+static void drawOverlayPass(void* data, const RenderGraph*, int32_t) {
+	const FrameContext* frame = static_cast<const FrameContext*>(data);
+	AppState* appState = frame->appState;
 
 	bool drawMovingBlock = true;
 	bool drawPointer = true;
+	bool drawPointerText = true;
+
+	beginText(&appState->textRenderer);
 
 	if (drawMovingBlock) {
-		static int blockX = 0;
+		const SimulationEntities* entities = &appState->simulation.entities;
 		glEnable(GL_SCISSOR_TEST);
-		glScissor(blockX, 0, 8, 8);
+		glScissor(entities->renderX[appState->movingBlock], entities->renderY[appState->movingBlock], 8, 8);
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 		glDisable(GL_SCISSOR_TEST);
-		blockX = (blockX + 1) % appState->width;
 	}
 
 	if (drawPointer) {
+		// draw where the finger will be when the frame is displayed, not where it was last sampled
+		float pointerX = frame->x * appState->width;
+		float pointerY = (1.0f - frame->y) * appState->height;
+		float predictedX, predictedY;
+		int64_t displayNanoseconds = frame->frameNanoseconds + static_cast<int64_t>(appState->frameIntervalNanoseconds * touchDisplayLatencyFrames);
+		if (appState->touchActive && predictTouch(&appState->touchPredictor, displayNanoseconds, &predictedX, &predictedY)) {
+			pointerX = predictedX;
+			pointerY = appState->height - predictedY;
+		}
 		glEnable(GL_SCISSOR_TEST);
-		glScissor(x*appState->width, (1.0f - y)*appState->height, 8, 8);
+		glScissor(pointerX, pointerY, 8, 8);
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
-		glScissor(x*appState->width + 2, (1.0f - y)*appState->height + 2, 4, 4);
+		glScissor(pointerX + 2, pointerY + 2, 4, 4);
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 		glDisable(GL_SCISSOR_TEST);
 	}
 
+	if (drawPointerText) {
+		char text[64];
+		snprintf(text, sizeof(text), "pointer %.0f, %.0f", appState->savedState.x, appState->savedState.y);
+		TextStyle style = { textScale, 0xffffffff };
+		drawText(&appState->textRenderer, text, 8.0f, 8.0f, &style);
+	}
+	flushText(&appState->textRenderer, &appState->vertexStream, appState->width, appState->height);
+}
+
+static void writeStartupTraceJob(void* data) {
+	writeStartupTrace(static_cast<const char*>(data));
+}
+
+// Written on a task thread, so the second frame doesn't wait for the file.
+static Task exportStartupTrace(AppState* appState) {
+	// internalDataPath is NULL on some 2.3 devices
+	const char* dataPath = appState->app->activity->internalDataPath;
+	if (dataPath) {
+		char path[256];
+		snprintf(path, sizeof(path), "%s/startup_trace.json", dataPath);
+		co_await runOnTaskThread(&appState->tasks, writeStartupTraceJob, path);
+	}
+}
+
+void drawFrame(AppState* appState) {
+	// wait for the GPU before sampling input and time, so the frame is built from the freshest state
+	int64_t pacerWaitNanoseconds = beginPacedFrame(&appState->framePacer);
+	if (appState->framePacer.stats.frames == framePacingLogInterval) {
+		logFramePacing(appState);
+	}
+	updateViewportIfNecessary(appState);
+	pollUploads(&appState->uploads, uploadBudgetNanoseconds);
+	beginStreamFrame(&appState->vertexStream);
+	int64_t frameNanoseconds = nowNanoseconds();
+	if (appState->lastFrameNanoseconds > 0) {
+		float interval = static_cast<float>(frameNanoseconds - appState->lastFrameNanoseconds);
+		appState->frameIntervalNanoseconds += (interval - appState->frameIntervalNanoseconds) * 0.1f;
+		if (updateQualityGovernor(&appState->quality, frameNanoseconds, frameNanoseconds - appState->lastFrameNanoseconds)) {
+			applyQualityTier(appState);
+		}
+		recordHistogram(appState->metrics.frameInterval, interval * 1e-6f);
+	}
+	appState->lastFrameNanoseconds = frameNanoseconds;
+	int32_t ticks = advanceSimulation(&appState->simulation, frameNanoseconds);
+	updateParticles(&appState->particles, ticks * appState->simulation.tickNanoseconds * 1e-9f);
+
+	float x = appState->savedState.x;
+	float y = appState->savedState.y;
+	if (x > 1.0f && y > 1.0f) { 
+		x /= appState->width;
+		y /= appState->height;
+	} else {
+		// assume stick in range [-1:1]
+		x = x * 0.5f + 0.5f;
+		y = y * 0.5f + 0.5f;
+	}
+
+	const QualityTier* tier = currentQualityTier(&appState->quality);
+	int32_t sceneWidth = static_cast<int32_t>(appState->width * tier->renderScale);
+	int32_t sceneHeight = static_cast<int32_t>(appState->height * tier->renderScale);
+	if (sceneWidth < 1 || sceneHeight < 1) {
+		sceneWidth = appState->width;
+		sceneHeight = appState->height;
+	}
+
+	FrameContext frame = { appState, x, y, frameNanoseconds, static_cast<float>(sceneWidth) / appState->width };
+	RenderGraph* graph = &appState->renderGraph;
+	resetRenderGraph(graph);
+	int32_t backbuffer = importRenderResource(graph, "backbuffer", appState->width, appState->height);
+	// with no effects at full resolution the scene goes straight to the window; otherwise the composite scales it up
+	bool postProcess = activePostEffects(&appState->postProcess) != 0 || sceneWidth != appState->width || sceneHeight != appState->height;
+	int32_t sceneColor = backbuffer;
+	if (postProcess) {
+		RenderTargetDesc sceneDesc = { sceneWidth, sceneHeight, RENDER_TARGET_RGBA8 };
+		sceneColor = createRenderResource(graph, "sceneColor", &sceneDesc);
+	}
+	// the scene pass clears for itself, along with whatever depth and stencil the config has
+	int32_t scenePass = addRenderPass(graph, "scene", drawScenePass, &frame);
+	setRenderPassColor(graph, scenePass, sceneColor, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	if (postProcess) {
+		addPostProcessPasses(&appState->postProcess, graph, sceneColor, backbuffer, appState->width, appState->height);
+	}
+	// text and markers go on top of the effects
+	int32_t overlayPass = addRenderPass(graph, "overlay", drawOverlayPass, &frame);
+	setRenderPassColor(graph, overlayPass, backbuffer, RENDER_LOAD, 0.0f, 0.0f, 0.0f, 0.0f);
+	if (compileRenderGraph(graph)) {
+		if (memcmp(&graph->stats, &appState->renderGraphStats, sizeof(RenderGraphStats)) != 0) {
+			logRenderGraph(graph);
+			appState->renderGraphStats = graph->stats;
+			if (postProcess) {
+				const PostProcessStats* stats = &appState->postProcess.stats;
+				LOGI("Post process: %d passes, %.2f Mpixels per frame (%d passes, %.2f Mpixels unfused at full resolution)",
+					stats->passes, stats->pixels * 1e-6, stats->unfusedPasses, stats->unfusedPixels * 1e-6);
+			}
+		}
+		executeRenderGraph(graph);
+	}
+
+	endStreamFrame(&appState->vertexStream);
+	discardDefaultFramebuffer(&appState->glExtensions, appState->configAttributes.depthSize > 0, appState->configAttributes.stencilSize > 0);
+	endPacedFrame(&appState->framePacer);
 	eglSwapBuffers(appState->display, appState->surface);
+
+	const AppMetrics* metrics = &appState->metrics;
+	addCounter(metrics->frames, 1);
+	recordHistogram(metrics->frameCpu, (nowNanoseconds() - frameNanoseconds) * 1e-6f);
+	recordHistogram(metrics->pacerWait, pacerWaitNanoseconds * 1e-6f);
+	setGauge(metrics->qualityTier, static_cast<float>(appState->quality.tier));
+	setGauge(metrics->particles, static_cast<float>(appState->particles.count));
+	setGauge(metrics->visibleNodes, static_cast<float>(appState->scene.visibleCount));
+
+	if (!appState->firstFramePresented) {
+		appState->firstFramePresented = true;
+		markStartupMilestone("first frame");
+		LOGI("Time to first frame: %.1f ms", startupElapsedNanoseconds() * 1e-6);
+		logStartupTrace();
+		startTask(exportStartupTrace(appState));
+	}
 }
 
 void termDisplay(AppState* appState) {
 	if (appState->display != EGL_NO_DISPLAY) {
+		if (appState->context != EGL_NO_CONTEXT) {
+			termUploadQueue(&appState->uploads);
+			const UploadStats* uploads = &appState->uploads.stats;
+			if (uploads->jobs > 0) {
+				LOGI("Uploads: %llu jobs, %.2f MB, %u failed, %u cancelled, %.2f ms uploading, %.2f ms on the render thread, latency %.2f ms average %.2f ms max",
+					static_cast<unsigned long long>(uploads->jobs), uploads->bytes / (1024.0 * 1024.0), uploads->failed, uploads->cancelled,
+					uploads->uploadNanoseconds * 1e-6, uploads->pollNanoseconds * 1e-6,
+					uploads->totalLatencyNanoseconds * 1e-6 / uploads->jobs, uploads->maxLatencyNanoseconds * 1e-6);
+			}
+			logQualityGovernor(&appState->quality);
+			termFramePacer(&appState->framePacer);
+			termSceneRendererGL(&appState->sceneRenderer);
+			termRenderGraphGL(&appState->renderGraph);
+			termPostProcessGL(&appState->postProcess);
+			termStreamBuffer(&appState->vertexStream);
+			// the startup thread owns these until it has been joined, and they have no GL objects before
+			if (appState->startup.joined) {
+				termTextRendererGL(&appState->textRenderer);
+				termParticlesGL(&appState->particles);
+			}
+		}
 		eglMakeCurrent(appState->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 		if (appState->context != EGL_NO_CONTEXT) {
 			eglDestroyContext(appState->display, appState->context);
@@ -189,30 +622,119 @@ void termDisplay(AppState* appState) {
 			eglDestroySurface(appState->display, appState->surface);
 		}
 		eglTerminate(appState->display);
+		clearGpuMemory();
 	}
 	appState->display = EGL_NO_DISPLAY;
 	appState->context = EGL_NO_CONTEXT;
 	appState->surface = EGL_NO_SURFACE;
+	// the next window sets its memory estimate and viewport even if it has the same size
+	appState->width = 0;
+	appState->height = 0;
+}
+
+// On failure everything created so far is torn down again, so the next window starts clean.
+bool initDisplay(AppState* appState) {
+	if (!createDisplay(appState)) {
+		termDisplay(appState);
+		return false;
+	}
+	return true;
+}
+
+void trackTouch(AppState* appState, AInputEvent* event) {
+	TouchPredictor* predictor = &appState->touchPredictor;
+	int32_t action = AMotionEvent_getAction(event) & AMOTION_EVENT_ACTION_MASK;
+	if (action == AMOTION_EVENT_ACTION_DOWN) {
+		resetTouchPredictor(predictor);
+		appState->touchActive = true;
+		appState->touchPointerId = AMotionEvent_getPointerId(event, 0);
+	}
+	if (!appState->touchActive) {
+		return;
+	}
+
+	size_t pointerCount = AMotionEvent_getPointerCount(event);
+	for (size_t i = 0; i < pointerCount; ++i) {
+		if (AMotionEvent_getPointerId(event, i) != appState->touchPointerId) {
+			continue;
+		}
+		// samples batched since the previous event, oldest first
+		size_t historySize = AMotionEvent_getHistorySize(event);
+		for (size_t h = 0; h < historySize; ++h) {
+			addTouchSample(predictor, AMotionEvent_getHistoricalX(event, i, h), AMotionEvent_getHistoricalY(event, i, h),
+				AMotionEvent_getHistoricalEventTime(event, h));
+#ifdef TOUCH_TRACE
+			LOGI("touch move %lld %.2f %.2f", static_cast<long long>(AMotionEvent_getHistoricalEventTime(event, h)),
+				AMotionEvent_getHistoricalX(event, i, h), AMotionEvent_getHistoricalY(event, i, h));
+#endif
+		}
+		addTouchSample(predictor, AMotionEvent_getX(event, i), AMotionEvent_getY(event, i), AMotionEvent_getEventTime(event));
+#ifdef TOUCH_TRACE
+		// input for tools/touch_replay
+		LOGI("touch %s %lld %.2f %.2f", action == AMOTION_EVENT_ACTION_DOWN ? "down" :
+			(action == AMOTION_EVENT_ACTION_UP || action == AMOTION_EVENT_ACTION_CANCEL ? "up" : "move"),
+			static_cast<long long>(AMotionEvent_getEventTime(event)), AMotionEvent_getX(event, i), AMotionEvent_getY(event, i));
+#endif
+	}
+
+	if (action == AMOTION_EVENT_ACTION_UP || action == AMOTION_EVENT_ACTION_CANCEL) {
+		const TouchPredictionStats* stats = &predictor->stats;
+		LOGI("Touch prediction error: mean %.1f px, max %.1f px, without prediction mean %.1f px, max %.1f px (%u frames)",
+			meanTouchPredictionError(stats), stats->maxError, meanTouchBaselineError(stats), stats->maxBaselineError, stats->count);
+		appState->touchActive = false;
+	}
+}
+
+struct MemorySnapshotFile {
+	MemorySnapshot snapshot;
+	char path[256];
+};
+
+static void writeMemorySnapshotJob(void* data) {
+	MemorySnapshotFile* file = static_cast<MemorySnapshotFile*>(data);
+	writeMemorySnapshot(&file->snapshot, file->path);
+}
+
+// Logged at once and written on a task thread.
+Task exportMemorySnapshot(AppState* appState) {
+	MemorySnapshotFile file;
+	takeMemorySnapshot(&file.snapshot);
+	logMemorySnapshot(&file.snapshot, appState->memorySnapshot.nanoseconds ? &appState->memorySnapshot : NULL);
+	appState->memorySnapshot = file.snapshot;
+	const char* dataPath = appState->app->activity->internalDataPath;
+	if (dataPath) {
+		snprintf(file.path, sizeof(file.path), "%s/memory_snapshot.json", dataPath);
+		co_await runOnTaskThread(&appState->tasks, writeMemorySnapshotJob, &file);
+	}
 }
 
 int32_t onInputEvent(android_app* app, AInputEvent* event) {
+	AppState* appState = static_cast<AppState*>(app->userData);
 	if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION) {
+		addCounter(appState->metrics.motionEvents, 1);
+		recordHistogram(appState->metrics.inputLatency, (nowNanoseconds() - AMotionEvent_getEventTime(event)) * 1e-6f);
+		trackTouch(appState, event);
+		if (!joinStartupTasks(appState)) {
+			return 0;
+		}
 		size_t pointerCount = AMotionEvent_getPointerCount(event);
 
 		for (size_t i = 0; i < pointerCount; ++i) {
-			int32_t pointerId = AMotionEvent_getPointerId(event, i);
 			float x = AMotionEvent_getX(event, i);
 			float y = AMotionEvent_getY(event, i);
 
-			LOGI("Received motion event from pointer %d: (%.2f, %.2f)", pointerId, x, y);
-
-			AppState* appState = static_cast<AppState*>(app->userData);
 			appState->savedState.x = x;
 			appState->savedState.y = y;
+			spawnParticles(&appState->particles, x, y, particlesPerMotionSample, particleSpeed, particleLifetime);
 		}
 		return 1;
 	} else if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_KEY) {
 		LOGI("Received key event: %d", AKeyEvent_getKeyCode(event));
+		addCounter(appState->metrics.keyEvents, 1);
+		recordHistogram(appState->metrics.inputLatency, (nowNanoseconds() - AKeyEvent_getEventTime(event)) * 1e-6f);
+		if (AKeyEvent_getKeyCode(event) == AKEYCODE_MENU && AKeyEvent_getAction(event) == AKEY_EVENT_ACTION_UP) {
+			startTask(exportMemorySnapshot(appState));
+		}
 		return 1;
 	}
 	return 0;
@@ -249,10 +771,12 @@ static void onAppCmd(android_app* app, int32_t cmd) {
 		break;
 	case APP_CMD_INIT_WINDOW:
 		LOGI("APP_CMD_INIT_WINDOW");
-		if (appState->app->window != NULL) {
-			initDisplay(appState);
+		markStartupMilestone("init window");
+		// without a display nothing may draw; the next window tries again
+		appState->windowInitialized = appState->app->window != NULL && initDisplay(appState);
+		if (!appState->windowInitialized) {
+			LOGE("Could not initialise the display");
 		}
-		appState->windowInitialized = true;
 		break;
 	case APP_CMD_WINDOW_RESIZED:
 		LOGI("APP_CMD_WINDOW_RESIZED");
@@ -265,6 +789,7 @@ static void onAppCmd(android_app* app, int32_t cmd) {
 
 	case APP_CMD_SAVE_STATE:
 		LOGI("APP_CMD_SAVE_STATE");
+		// not tracked, the framework frees it
 		appState->app->savedState = malloc(sizeof(SavedState));
 		appState->app->savedStateSize = sizeof(SavedState);
 		*static_cast<SavedState*>(appState->app->savedState) = appState->savedState;
@@ -272,10 +797,50 @@ static void onAppCmd(android_app* app, int32_t cmd) {
 	case APP_CMD_CONFIG_CHANGED:
 		LOGI("APP_CMD_CONFIG_CHANGED");
 		break;
+	case APP_CMD_LOW_MEMORY:
+		LOGI("APP_CMD_LOW_MEMORY");
+		startTask(exportMemorySnapshot(appState));
+		break;
 	default:
 		LOGI("Unknown CMD: %d", cmd);
 	}
-	appState->running = (appState->resumed && appState->windowInitialized && appState->focused);
+	bool wasRunning = appState->running;
+	appState->running = (appState->resumed && appState->windowInitialized && appState->focused && joinStartupTasks(appState));
+	if (appState->running && !wasRunning) {
+		// don't simulate the time spent paused
+		resetSimulationClock(&appState->simulation, nowNanoseconds());
+		appState->lastFrameNanoseconds = 0;
+	} else if (!appState->running && wasRunning) {
+		pauseQualityGovernor(&appState->quality);
+	}
+}
+
+static void registerAppMetrics(AppMetrics* metrics) {
+	const int32_t frameBounds = sizeof(frameMillisecondBounds) / sizeof(frameMillisecondBounds[0]);
+	metrics->frames = registerCounter("frame.count");
+	metrics->frameInterval = registerHistogram("frame.interval_ms", frameMillisecondBounds, frameBounds);
+	metrics->frameCpu = registerHistogram("frame.cpu_ms", frameMillisecondBounds, frameBounds);
+	metrics->pacerWait = registerHistogram("frame.pacer_wait_ms", frameMillisecondBounds, frameBounds);
+	metrics->qualityTier = registerGauge("frame.quality_tier");
+	metrics->particles = registerGauge("frame.particles");
+	metrics->visibleNodes = registerGauge("frame.visible_nodes");
+	metrics->motionEvents = registerCounter("input.motion_events");
+	metrics->keyEvents = registerCounter("input.key_events");
+	metrics->inputLatency = registerHistogram("input.latency_ms", inputLatencyMillisecondBounds,
+		sizeof(inputLatencyMillisecondBounds) / sizeof(inputLatencyMillisecondBounds[0]));
+}
+
+static void startMetrics(AppState* appState) {
+	registerAppMetrics(&appState->metrics);
+	const char* dataPath = appState->app->activity->internalDataPath;
+	if (!dataPath) {
+		return;
+	}
+	char path[METRICS_EXPORTER_MAX_PATH];
+	snprintf(path, sizeof(path), "%s/%s", dataPath, metricsFile);
+	if (startMetricsExporter(&appState->metricsExporter, path, METRICS_TARGET_FILE, METRICS_FORMAT_JSON, metricsIntervalNanoseconds)) {
+		LOGI("Metrics: writing to %s every %.1f s", path, metricsIntervalNanoseconds * 1e-9);
+	}
 }
 
 void android_main(android_app* app) {
@@ -295,6 +860,20 @@ void android_main(android_app* app) {
 		appState.savedState = *static_cast<SavedState*>(app->savedState);
 	}
 
+	initTouchPredictor(&appState.touchPredictor, &defaultTouchPredictorConfig);
+	initPostProcess(&appState.postProcess, postEffects, sizeof(postEffects) / sizeof(postEffects[0]));
+	appState.frameIntervalNanoseconds = initialFrameIntervalNanoseconds;
+	initThermal(&appState);
+	initQualityGovernor(&appState.quality, qualityTiers, sizeof(qualityTiers) / sizeof(qualityTiers[0]),
+		&defaultQualityGovernorConfig, appState.thermal.read ? &appState.thermal : NULL);
+	applyQualityTier(&appState);
+
+	if (!startStartupTasks(&appState)) {
+		return;
+	}
+	startMetrics(&appState);
+	initTaskLooper(&appState.tasks, app->looper, taskThreads);
+
 	while (true) {
 		int ident;
 		int fd;
@@ -309,12 +888,24 @@ void android_main(android_app* app) {
 
 			if (app->destroyRequested != 0) {
 				termDisplay(&appState);
+				termTaskLooper(&appState.tasks);
+				stopMetricsExporter(&appState.metricsExporter);
+				termAndroidThermalProvider(&appState.androidThermal);
+				if (!joinStartupTasks(&appState)) {
+					return;
+				}
+				termSimulation(&appState.simulation);
+				termTextRenderer(&appState.textRenderer);
+				termParticles(&appState.particles);
+				termWorkerPool(&appState.workers);
+				termScene(&appState.scene);
 				return;
 			}
 		}
 
 		if (appState.running) {
 			drawFrame(&appState);
+			advanceTaskFrame(&appState.tasks);
 		}
 	}
 }
@@ -0,0 +1,266 @@
+#include "memory_tracker.h"
+#include "log.h"
+#include "time_utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_REPORTED_LEAKS 32
+
+static const char* const memoryTagNames[MEMORY_TAG_COUNT] = {
+	"glue", "shaders", "egl", "simulation", "text", "particles", "scene", "stream", "tasks"
+};
+
+static const char* const gpuMemoryTypeNames[GPU_MEMORY_TYPE_COUNT] = {
+	"buffers", "textures", "window"
+};
+
+struct MemoryBlockHeader {
+	struct MemoryBlockHeader* prev;
+	struct MemoryBlockHeader* next;
+	size_t size;
+	const char* file;
+	int32_t line;
+	MemoryTag tag;
+};
+
+// keeps the block after the header aligned like malloc's
+#define MEMORY_HEADER_SIZE ((sizeof(struct MemoryBlockHeader) + 15) & ~(size_t)15)
+
+static pthread_mutex_t memoryMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct MemoryBlockHeader* liveBlocks;
+static MemoryCounters heapCounters[MEMORY_TAG_COUNT];
+static MemoryCounters gpuCounters[GPU_MEMORY_TYPE_COUNT];
+
+static void countGpuAllocation(MemoryCounters* counters, int64_t bytes) {
+	counters->liveBytes += bytes;
+	++counters->liveAllocations;
+	++counters->allocations;
+	counters->allocatedBytes += bytes;
+	if (counters->liveBytes > counters->peakBytes) {
+		counters->peakBytes = counters->liveBytes;
+	}
+}
+
+// Called with the mutex held.
+static void insertBlock(struct MemoryBlockHeader* header) {
+	header->prev = NULL;
+	header->next = liveBlocks;
+	if (liveBlocks) {
+		liveBlocks->prev = header;
+	}
+	liveBlocks = header;
+	MemoryCounters* counters = &heapCounters[header->tag];
+	counters->liveBytes += header->size;
+	++counters->liveAllocations;
+	if (counters->liveBytes > counters->peakBytes) {
+		counters->peakBytes = counters->liveBytes;
+	}
+}
+
+// Called with the mutex held.
+static void removeBlock(struct MemoryBlockHeader* header) {
+	if (header->prev) {
+		header->prev->next = header->next;
+	} else {
+		liveBlocks = header->next;
+	}
+	if (header->next) {
+		header->next->prev = header->prev;
+	}
+	MemoryCounters* counters = &heapCounters[header->tag];
+	counters->liveBytes -= header->size;
+	--counters->liveAllocations;
+}
+
+static void* addBlock(struct MemoryBlockHeader* header, MemoryTag tag, size_t size, const char* file, int line) {
+	header->size = size;
+	header->file = file;
+	header->line = line;
+	header->tag = tag;
+
+	pthread_mutex_lock(&memoryMutex);
+	insertBlock(header);
+	++heapCounters[tag].allocations;
+	heapCounters[tag].allocatedBytes += size;
+	pthread_mutex_unlock(&memoryMutex);
+	return (uint8_t*)header + MEMORY_HEADER_SIZE;
+}
+
+static struct MemoryBlockHeader* blockHeader(void* pointer) {
+	return (struct MemoryBlockHeader*)((uint8_t*)pointer - MEMORY_HEADER_SIZE);
+}
+
+void* trackedMalloc(MemoryTag tag, size_t size, const char* file, int line) {
+	struct MemoryBlockHeader* header = malloc(MEMORY_HEADER_SIZE + size);
+	return header ? addBlock(header, tag, size, file, line) : NULL;
+}
+
+void* trackedCalloc(MemoryTag tag, size_t count, size_t size, const char* file, int line) {
+	if (size && count > (SIZE_MAX - MEMORY_HEADER_SIZE) / size) {
+		return NULL;
+	}
+	struct MemoryBlockHeader* header = calloc(1, MEMORY_HEADER_SIZE + count * size);
+	return header ? addBlock(header, tag, count * size, file, line) : NULL;
+}
+
+void* trackedRealloc(MemoryTag tag, void* pointer, size_t size, const char* file, int line) {
+	if (!pointer) {
+		return trackedMalloc(tag, size, file, line);
+	}
+	// out of the list while realloc may move it
+	struct MemoryBlockHeader* header = blockHeader(pointer);
+	pthread_mutex_lock(&memoryMutex);
+	removeBlock(header);
+	pthread_mutex_unlock(&memoryMutex);
+
+	struct MemoryBlockHeader* grown = realloc(header, MEMORY_HEADER_SIZE + size);
+	if (!grown) {
+		pthread_mutex_lock(&memoryMutex);
+		insertBlock(header);
+		pthread_mutex_unlock(&memoryMutex);
+		return NULL;
+	}
+	return addBlock(grown, tag, size, file, line);
+}
+
+void trackedFree(void* pointer) {
+	if (!pointer) {
+		return;
+	}
+	struct MemoryBlockHeader* header = blockHeader(pointer);
+	pthread_mutex_lock(&memoryMutex);
+	removeBlock(header);
+	pthread_mutex_unlock(&memoryMutex);
+	free(header);
+}
+
+void trackGpuMemory(GpuMemoryType type, int64_t deltaBytes) {
+	pthread_mutex_lock(&memoryMutex);
+	MemoryCounters* counters = &gpuCounters[type];
+	if (deltaBytes > 0) {
+		countGpuAllocation(counters, deltaBytes);
+	} else {
+		counters->liveBytes += deltaBytes;
+		--counters->liveAllocations;
+	}
+	pthread_mutex_unlock(&memoryMutex);
+}
+
+void setGpuMemory(GpuMemoryType type, int64_t bytes) {
+	pthread_mutex_lock(&memoryMutex);
+	MemoryCounters* counters = &gpuCounters[type];
+	counters->liveBytes = 0;
+	counters->liveAllocations = 0;
+	countGpuAllocation(counters, bytes);
+	pthread_mutex_unlock(&memoryMutex);
+}
+
+int32_t clearGpuMemory(void) {
+	int32_t leaks = 0;
+	pthread_mutex_lock(&memoryMutex);
+	for (int i = 0; i < GPU_MEMORY_TYPE_COUNT; ++i) {
+		// the window's buffers go with the surface, nothing deletes them
+		if (i != GPU_MEMORY_WINDOW && (gpuCounters[i].liveBytes != 0 || gpuCounters[i].liveAllocations != 0)) {
+			LOGW("GL %s not deleted before the context: %lld bytes in %lld", gpuMemoryTypeNames[i],
+				(long long)gpuCounters[i].liveBytes, (long long)gpuCounters[i].liveAllocations);
+			++leaks;
+		}
+		gpuCounters[i].liveBytes = 0;
+		gpuCounters[i].liveAllocations = 0;
+	}
+	pthread_mutex_unlock(&memoryMutex);
+	return leaks;
+}
+
+uint64_t memoryAllocationCount(void) {
+	uint64_t count = 0;
+	pthread_mutex_lock(&memoryMutex);
+	for (int i = 0; i < MEMORY_TAG_COUNT; ++i) {
+		count += heapCounters[i].allocations;
+	}
+	pthread_mutex_unlock(&memoryMutex);
+	return count;
+}
+
+void takeMemorySnapshot(MemorySnapshot* snapshot) {
+	pthread_mutex_lock(&memoryMutex);
+	snapshot->nanoseconds = nowNanoseconds();
+	memcpy(snapshot->heap, heapCounters, sizeof(heapCounters));
+	memcpy(snapshot->gpu, gpuCounters, sizeof(gpuCounters));
+	pthread_mutex_unlock(&memoryMutex);
+}
+
+static void logCounters(const char* kind, const char* name, const MemoryCounters* counters, const MemoryCounters* previous, double seconds) {
+	double rate = previous && seconds > 0.0 ? (counters->allocations - previous->allocations) / seconds : 0.0;
+	LOGI("%s %-10s live %9lld bytes in %6lld, peak %9lld bytes, %8llu allocations (%.1f/s)", kind, name,
+		(long long)counters->liveBytes, (long long)counters->liveAllocations, (long long)counters->peakBytes,
+		(unsigned long long)counters->allocations, rate);
+}
+
+void logMemorySnapshot(const MemorySnapshot* snapshot, const MemorySnapshot* previous) {
+	double seconds = previous ? (snapshot->nanoseconds - previous->nanoseconds) * 1e-9 : 0.0;
+	if (!MEMORY_TRACKING) {
+		LOGI("Heap tracking is disabled in this build");
+	}
+	for (int i = 0; i < MEMORY_TAG_COUNT; ++i) {
+		logCounters("Heap", memoryTagNames[i], &snapshot->heap[i], previous ? &previous->heap[i] : NULL, seconds);
+	}
+	for (int i = 0; i < GPU_MEMORY_TYPE_COUNT; ++i) {
+		logCounters("GL  ", gpuMemoryTypeNames[i], &snapshot->gpu[i], previous ? &previous->gpu[i] : NULL, seconds);
+	}
+}
+
+static void writeCounters(FILE* file, const char* name, const MemoryCounters* counters, bool last) {
+	fprintf(file, "\t\t\"%s\": {\"liveBytes\": %lld, \"peakBytes\": %lld, \"liveAllocations\": %lld, \"allocations\": %llu, \"allocatedBytes\": %llu}%s\n",
+		name, (long long)counters->liveBytes, (long long)counters->peakBytes, (long long)counters->liveAllocations,
+		(unsigned long long)counters->allocations, (unsigned long long)counters->allocatedBytes, last ? "" : ",");
+}
+
+bool writeMemorySnapshot(const MemorySnapshot* snapshot, const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		LOGW("Could not write memory snapshot to %s", path);
+		return false;
+	}
+	fprintf(file, "{\n\t\"nanoseconds\": %lld,\n\t\"heapTracking\": %s,\n\t\"heap\": {\n",
+		(long long)snapshot->nanoseconds, MEMORY_TRACKING ? "true" : "false");
+	for (int i = 0; i < MEMORY_TAG_COUNT; ++i) {
+		writeCounters(file, memoryTagNames[i], &snapshot->heap[i], i + 1 == MEMORY_TAG_COUNT);
+	}
+	fprintf(file, "\t},\n\t\"gl\": {\n");
+	for (int i = 0; i < GPU_MEMORY_TYPE_COUNT; ++i) {
+		writeCounters(file, gpuMemoryTypeNames[i], &snapshot->gpu[i], i + 1 == GPU_MEMORY_TYPE_COUNT);
+	}
+	fprintf(file, "\t}\n}\n");
+	if (fclose(file) != 0) {
+		LOGW("Could not write memory snapshot to %s", path);
+		return false;
+	}
+	LOGI("Wrote memory snapshot to %s", path);
+	return true;
+}
+
+int32_t reportMemoryLeaks(const void* ignore) {
+	int32_t leaks = 0;
+	int64_t bytes = 0;
+	pthread_mutex_lock(&memoryMutex);
+	for (const struct MemoryBlockHeader* header = liveBlocks; header; header = header->next) {
+		if ((const uint8_t*)header + MEMORY_HEADER_SIZE == ignore) {
+			continue;
+		}
+		if (leaks < MAX_REPORTED_LEAKS) {
+			LOGW("Leaked %zu bytes (%s) allocated at %s:%d", header->size, memoryTagNames[header->tag], header->file, header->line);
+		}
+		++leaks;
+		bytes += header->size;
+	}
+	pthread_mutex_unlock(&memoryMutex);
+	if (leaks > 0) {
+		LOGW("%d blocks, %lld bytes leaked", leaks, (long long)bytes);
+	} else if (MEMORY_TRACKING) {
+		LOGI("No heap leaks");
+	}
+	return leaks;
+}
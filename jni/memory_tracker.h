@@ -0,0 +1,99 @@
+#pragma once
+
+// Tagged heap accounting and estimated GL memory.
+//
+// With MEMORY_TRACKING (the default unless NDEBUG), MEMORY_ALLOC and friends prefix every block
+// with a header recording its tag, size and allocation site, keep per tag counters, and link
+// live blocks so leaks can be listed at shutdown. Without it they are plain malloc/free and the
+// heap counters stay zero. GL memory is estimated from the sizes passed to the GL in either case.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef MEMORY_TRACKING
+#ifdef NDEBUG
+#define MEMORY_TRACKING 0
+#else
+#define MEMORY_TRACKING 1
+#endif
+#endif
+
+typedef enum MemoryTag {
+	MEMORY_TAG_GLUE,
+	MEMORY_TAG_SHADERS,
+	MEMORY_TAG_EGL,
+	MEMORY_TAG_SIMULATION,
+	MEMORY_TAG_TEXT,
+	MEMORY_TAG_PARTICLES,
+	MEMORY_TAG_SCENE,
+	MEMORY_TAG_STREAM,
+	MEMORY_TAG_TASKS,
+	MEMORY_TAG_COUNT
+} MemoryTag;
+
+typedef enum GpuMemoryType {
+	GPU_MEMORY_BUFFERS,
+	GPU_MEMORY_TEXTURES,
+	GPU_MEMORY_WINDOW, // the window surface's colour, depth and stencil buffers
+	GPU_MEMORY_TYPE_COUNT
+} GpuMemoryType;
+
+typedef struct MemoryCounters {
+	int64_t liveBytes;
+	int64_t peakBytes;
+	int64_t liveAllocations;
+	uint64_t allocations; // since startup, for the allocation rate
+	uint64_t allocatedBytes;
+} MemoryCounters;
+
+typedef struct MemorySnapshot {
+	int64_t nanoseconds;
+	MemoryCounters heap[MEMORY_TAG_COUNT];
+	MemoryCounters gpu[GPU_MEMORY_TYPE_COUNT];
+} MemorySnapshot;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if MEMORY_TRACKING
+#define MEMORY_ALLOC(tag, size) trackedMalloc((tag), (size), __FILE__, __LINE__)
+#define MEMORY_CALLOC(tag, count, size) trackedCalloc((tag), (count), (size), __FILE__, __LINE__)
+#define MEMORY_REALLOC(tag, pointer, size) trackedRealloc((tag), (pointer), (size), __FILE__, __LINE__)
+#define MEMORY_FREE(pointer) trackedFree(pointer)
+#else
+#define MEMORY_ALLOC(tag, size) malloc(size)
+#define MEMORY_CALLOC(tag, count, size) calloc((count), (size))
+#define MEMORY_REALLOC(tag, pointer, size) realloc((pointer), (size))
+#define MEMORY_FREE(pointer) free(pointer)
+#endif
+
+void* trackedMalloc(MemoryTag tag, size_t size, const char* file, int line);
+void* trackedCalloc(MemoryTag tag, size_t count, size_t size, const char* file, int line);
+void* trackedRealloc(MemoryTag tag, void* pointer, size_t size, const char* file, int line);
+void trackedFree(void* pointer);
+
+// Adjusts the estimate for one kind of GL object by the bytes created or deleted.
+void trackGpuMemory(GpuMemoryType type, int64_t deltaBytes);
+void setGpuMemory(GpuMemoryType type, int64_t bytes);
+// Every GL object goes when its context is destroyed, so call this once they have all been deleted.
+// Logs each type other than the window that still has objects tracked, which nobody deleted, and
+// returns how many there were.
+int32_t clearGpuMemory(void);
+
+// Heap allocations of every tag since startup; a steady state frame should not change it.
+uint64_t memoryAllocationCount(void);
+
+void takeMemorySnapshot(MemorySnapshot* snapshot);
+// Allocation rates are per second since previous, which may be NULL.
+void logMemorySnapshot(const MemorySnapshot* snapshot, const MemorySnapshot* previous);
+bool writeMemorySnapshot(const MemorySnapshot* snapshot, const char* path);
+
+// Logs every live heap block other than ignore, returns how many there were.
+int32_t reportMemoryLeaks(const void* ignore);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,144 @@
+#include "mesh.h"
+#include "gl_extensions.h"
+#include "time_utils.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <string.h>
+
+static uint32_t meshTypeSize(uint16_t type) {
+	switch (type) {
+	case MESH_TYPE_BYTE:
+	case MESH_TYPE_UNSIGNED_BYTE:
+		return 1;
+	case MESH_TYPE_SHORT:
+	case MESH_TYPE_UNSIGNED_SHORT:
+	case MESH_TYPE_HALF_FLOAT_OES:
+		return 2;
+	case MESH_TYPE_FLOAT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static bool validateMeshHeader(const MeshFileHeader* header, size_t size) {
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION) {
+		LOGE("Not a mesh file or unsupported version");
+		return false;
+	}
+	if (header->attributeCount > MESH_MAX_ATTRIBUTES) {
+		return false;
+	}
+	// only 16 bit indices, 32 bit ones need GL_OES_element_index_uint on ES2
+	if (header->indexType != MESH_TYPE_UNSIGNED_SHORT) {
+		LOGE("Unsupported mesh index type 0x%04x", header->indexType);
+		return false;
+	}
+	for (uint32_t i = 0; i < header->attributeCount; ++i) {
+		const MeshAttributeDesc* attribute = &header->attributes[i];
+		uint32_t typeSize = meshTypeSize(attribute->type);
+		if (typeSize == 0 || attribute->components < 1 || attribute->components > 4) {
+			LOGE("Unsupported mesh attribute: %u components of type 0x%04x", attribute->components, attribute->type);
+			return false;
+		}
+		// the GL would read past the vertex, into the next one or off the end of the buffer
+		if (attribute->offset + attribute->components * typeSize > header->vertexStride) {
+			LOGE("Mesh attribute at offset %u does not fit the %u byte vertex", attribute->offset, header->vertexStride);
+			return false;
+		}
+		if (attribute->type == MESH_TYPE_HALF_FLOAT_OES &&
+			!hasExtension(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)), "GL_OES_vertex_half_float")) {
+			LOGE("Mesh uses half float attributes but GL_OES_vertex_half_float is missing");
+			return false;
+		}
+	}
+	uint64_t vertexBytes = static_cast<uint64_t>(header->vertexCount) * header->vertexStride;
+	uint64_t indexBytes = static_cast<uint64_t>(header->indexCount) * sizeof(uint16_t);
+	if (header->vertexDataOffset + vertexBytes > size || header->indexDataOffset + indexBytes > size) {
+		LOGE("Truncated mesh file");
+		return false;
+	}
+	return true;
+}
+
+bool loadMesh(Mesh* mesh, const void* data, size_t size) {
+	memset(mesh, 0, sizeof(Mesh));
+	if (size < sizeof(MeshFileHeader)) {
+		return false;
+	}
+	MeshFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (!validateMeshHeader(&header, size)) {
+		return false;
+	}
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	mesh->vertexBufferSize = header.vertexCount * header.vertexStride;
+	mesh->indexBufferSize = header.indexCount * sizeof(uint16_t);
+	glGenBuffers(1, &mesh->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh->vertexBufferSize, bytes + header.vertexDataOffset, GL_STATIC_DRAW);
+	glGenBuffers(1, &mesh->indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBufferSize, bytes + header.indexDataOffset, GL_STATIC_DRAW);
+	trackGpuMemory(GPU_MEMORY_BUFFERS, mesh->vertexBufferSize);
+	trackGpuMemory(GPU_MEMORY_BUFFERS, mesh->indexBufferSize);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	mesh->indexCount = header.indexCount;
+	mesh->indexType = header.indexType;
+	mesh->vertexStride = header.vertexStride;
+	mesh->attributeCount = header.attributeCount;
+	memcpy(mesh->attributes, header.attributes, sizeof(mesh->attributes));
+	memcpy(mesh->positionScale, header.positionScale, sizeof(mesh->positionScale));
+	memcpy(mesh->positionOffset, header.positionOffset, sizeof(mesh->positionOffset));
+	memcpy(mesh->texCoordScale, header.texCoordScale, sizeof(mesh->texCoordScale));
+	memcpy(mesh->texCoordOffset, header.texCoordOffset, sizeof(mesh->texCoordOffset));
+	return true;
+}
+
+bool loadMeshAsset(Mesh* mesh, AAssetManager* assetManager, const char* path) {
+	int64_t start = nowNanoseconds();
+	AAsset* asset = AAssetManager_open(assetManager, path, AASSET_MODE_BUFFER);
+	if (!asset) {
+		LOGE("Could not open mesh %s", path);
+		return false;
+	}
+	// uncompressed assets are memory mapped, so this is the only copy made on the CPU side
+	const void* data = AAsset_getBuffer(asset);
+	bool loaded = data && loadMesh(mesh, data, AAsset_getLength(asset));
+	AAsset_close(asset);
+	if (loaded) {
+		LOGI("Loaded mesh %s: %d indices in %.2f ms", path, mesh->indexCount, (nowNanoseconds() - start) * 1e-6);
+	}
+	return loaded;
+}
+
+void deleteMesh(Mesh* mesh) {
+	glDeleteBuffers(1, &mesh->vertexBuffer);
+	glDeleteBuffers(1, &mesh->indexBuffer);
+	trackGpuMemory(GPU_MEMORY_BUFFERS, -mesh->vertexBufferSize);
+	trackGpuMemory(GPU_MEMORY_BUFFERS, -mesh->indexBufferSize);
+	memset(mesh, 0, sizeof(Mesh));
+}
+
+void bindMesh(const Mesh* mesh, const GLint locations[MESH_ATTRIBUTE_COUNT]) {
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	for (uint32_t i = 0; i < mesh->attributeCount; ++i) {
+		const MeshAttributeDesc* attribute = &mesh->attributes[i];
+		GLint location = attribute->semantic < MESH_ATTRIBUTE_COUNT ? locations[attribute->semantic] : -1;
+		if (location < 0) {
+			continue;
+		}
+		glVertexAttribPointer(location, attribute->components, attribute->type, attribute->normalized ? GL_TRUE : GL_FALSE,
+			mesh->vertexStride, reinterpret_cast<const void*>(static_cast<uintptr_t>(attribute->offset)));
+		glEnableVertexAttribArray(location);
+	}
+}
+
+void drawMesh(const Mesh* mesh) {
+	glDrawElements(GL_TRIANGLES, mesh->indexCount, mesh->indexType, 0);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "mesh_format.h"
+
+#include <android/asset_manager.h>
+#include <GLES2/gl2.h>
+#include <stddef.h>
+
+struct Mesh {
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	GLsizeiptr vertexBufferSize;
+	GLsizeiptr indexBufferSize;
+	GLsizei indexCount;
+	GLenum indexType;
+	GLsizei vertexStride;
+	uint32_t attributeCount;
+	MeshAttributeDesc attributes[MESH_MAX_ATTRIBUTES];
+	float positionScale[3];
+	float positionOffset[3];
+	float texCoordScale[2];
+	float texCoordOffset[2];
+};
+
+// Uploads a mesh file image straight into GL buffers.
+bool loadMesh(Mesh* mesh, const void* data, size_t size);
+bool loadMeshAsset(Mesh* mesh, AAssetManager* assetManager, const char* path);
+void deleteMesh(Mesh* mesh);
+
+// locations are indexed by MeshAttributeSemantic; -1 skips an attribute the program doesn't use.
+void bindMesh(const Mesh* mesh, const GLint locations[MESH_ATTRIBUTE_COUNT]);
+void drawMesh(const Mesh* mesh);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary mesh files written by tools/mesh_tool.cpp. Vertex and index data are stored exactly as
+// GL consumes them, so loading is a validation of the header and two buffer uploads.
+
+#define MESH_FILE_MAGIC 0x4853454d // "MESH"
+#define MESH_FILE_VERSION 1
+#define MESH_MAX_ATTRIBUTES 4
+
+// GL enum values, repeated here so the offline tool doesn't need GL headers
+#define MESH_TYPE_BYTE 0x1400
+#define MESH_TYPE_UNSIGNED_BYTE 0x1401
+#define MESH_TYPE_SHORT 0x1402
+#define MESH_TYPE_UNSIGNED_SHORT 0x1403
+#define MESH_TYPE_FLOAT 0x1406
+#define MESH_TYPE_HALF_FLOAT_OES 0x8d61
+
+enum MeshAttributeSemantic {
+	MESH_ATTRIBUTE_POSITION,
+	MESH_ATTRIBUTE_NORMAL,
+	MESH_ATTRIBUTE_TEXCOORD,
+	MESH_ATTRIBUTE_COUNT
+};
+
+struct MeshAttributeDesc {
+	uint16_t semantic;
+	uint16_t type;
+	uint8_t components;
+	uint8_t normalized;
+	uint16_t offset;
+};
+
+// Quantised positions decode as position * positionScale + positionOffset, texture coordinates likewise.
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint16_t vertexStride;
+	uint16_t indexType;
+	uint32_t attributeCount;
+	MeshAttributeDesc attributes[MESH_MAX_ATTRIBUTES];
+	float positionScale[3];
+	float positionOffset[3];
+	float texCoordScale[2];
+	float texCoordOffset[2];
+	uint32_t vertexDataOffset;
+	uint32_t indexDataOffset;
+};
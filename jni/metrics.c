@@ -0,0 +1,422 @@
+#include "metrics.h"
+#include "log.h"
+#include "time_utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct Metric metricsTable[METRICS_MAX];
+// published with release, so a reader that sees the count sees the metrics it covers filled in
+static int32_t metricCount;
+static pthread_mutex_t registryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// names go into JSON unescaped
+static bool validMetricName(const char* name) {
+	size_t length = strlen(name);
+	if (length == 0 || length >= METRICS_NAME_SIZE) {
+		return false;
+	}
+	for (size_t i = 0; i < length; ++i) {
+		char c = name[i];
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '-')) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int32_t registerMetric(const char* name, int32_t type, const float* bounds, int32_t boundCount) {
+	if (!validMetricName(name) || boundCount < 0 || boundCount > METRICS_MAX_BUCKETS - 1) {
+		LOGE("registerMetric: invalid metric %s", name);
+		return -1;
+	}
+	pthread_mutex_lock(&registryMutex);
+	int32_t id = -1;
+	for (int32_t i = 0; i < metricCount; ++i) {
+		if (strcmp(metricsTable[i].name, name) == 0) {
+			if (metricsTable[i].type == type) {
+				id = i;
+			} else {
+				LOGE("registerMetric: %s is already registered as another type", name);
+			}
+			pthread_mutex_unlock(&registryMutex);
+			return id;
+		}
+	}
+	if (metricCount == METRICS_MAX) {
+		LOGE("registerMetric: no room for %s, at most %d metrics", name, METRICS_MAX);
+	} else {
+		id = metricCount;
+		struct Metric* metric = &metricsTable[id];
+		memset(metric, 0, sizeof(struct Metric));
+		strcpy(metric->name, name);
+		metric->type = type;
+		if (type == METRIC_HISTOGRAM) {
+			metric->bucketCount = boundCount + 1;
+			memcpy(metric->bounds, bounds, boundCount * sizeof(float));
+		}
+		__atomic_store_n(&metricCount, id + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&registryMutex);
+	return id;
+}
+
+int32_t registerCounter(const char* name) {
+	return registerMetric(name, METRIC_COUNTER, NULL, 0);
+}
+
+int32_t registerGauge(const char* name) {
+	return registerMetric(name, METRIC_GAUGE, NULL, 0);
+}
+
+int32_t registerHistogram(const char* name, const float* bounds, int32_t boundCount) {
+	for (int32_t i = 1; i < boundCount; ++i) {
+		if (!(bounds[i] > bounds[i - 1])) {
+			LOGE("registerHistogram: bounds of %s are not increasing", name);
+			return -1;
+		}
+	}
+	return registerMetric(name, METRIC_HISTOGRAM, bounds, boundCount);
+}
+
+int32_t registeredMetrics(void) {
+	return __atomic_load_n(&metricCount, __ATOMIC_ACQUIRE);
+}
+
+void resetMetrics(void) {
+	int32_t count = registeredMetrics();
+	for (int32_t i = 0; i < count; ++i) {
+		struct Metric* metric = &metricsTable[i];
+		__atomic_store_n(&metric->value, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&metric->sum, 0, __ATOMIC_RELAXED);
+		for (int32_t b = 0; b < metric->bucketCount; ++b) {
+			__atomic_store_n(&metric->buckets[b], 0, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static uint32_t loadRelaxed(const uint32_t* cell) {
+	return __atomic_load_n(cell, __ATOMIC_RELAXED);
+}
+
+static float gaugeValue(const struct Metric* metric) {
+	union { float f; uint32_t u; } bits;
+	bits.u = loadRelaxed(&metric->value);
+	return bits.f;
+}
+
+struct ByteWriter {
+	uint8_t* data;
+	size_t size;
+	size_t length;
+	bool overflow;
+};
+
+static void putBytes(struct ByteWriter* writer, const void* bytes, size_t count) {
+	if (writer->length + count > writer->size) {
+		writer->overflow = true;
+		return;
+	}
+	memcpy(writer->data + writer->length, bytes, count);
+	writer->length += count;
+}
+
+static void putUnsigned(struct ByteWriter* writer, uint64_t value, size_t count) {
+	uint8_t bytes[8];
+	for (size_t i = 0; i < count; ++i) {
+		bytes[i] = (uint8_t)(value >> (i * 8));
+	}
+	putBytes(writer, bytes, count);
+}
+
+static void putFloat(struct ByteWriter* writer, float value) {
+	union { float f; uint32_t u; } bits;
+	bits.f = value;
+	putUnsigned(writer, bits.u, 4);
+}
+
+size_t writeMetricsBinary(uint8_t* buffer, size_t size, int64_t nanoseconds) {
+	struct ByteWriter writer = { buffer, size, 0, false };
+	int32_t count = registeredMetrics();
+	putBytes(&writer, "MTRC", 4);
+	putUnsigned(&writer, METRICS_VERSION, 1);
+	putUnsigned(&writer, (uint64_t)nanoseconds, 8);
+	putUnsigned(&writer, (uint64_t)count, 2);
+	for (int32_t i = 0; i < count; ++i) {
+		const struct Metric* metric = &metricsTable[i];
+		size_t nameLength = strlen(metric->name);
+		putUnsigned(&writer, (uint64_t)metric->type, 1);
+		putUnsigned(&writer, nameLength, 1);
+		putBytes(&writer, metric->name, nameLength);
+		if (metric->type == METRIC_GAUGE) {
+			putFloat(&writer, gaugeValue(metric));
+		} else {
+			putUnsigned(&writer, loadRelaxed(&metric->value), 4);
+		}
+		if (metric->type == METRIC_HISTOGRAM) {
+			putUnsigned(&writer, loadRelaxed(&metric->sum), 4);
+			putUnsigned(&writer, (uint64_t)metric->bucketCount, 1);
+			for (int32_t b = 0; b < metric->bucketCount - 1; ++b) {
+				putFloat(&writer, metric->bounds[b]);
+			}
+			for (int32_t b = 0; b < metric->bucketCount; ++b) {
+				putUnsigned(&writer, loadRelaxed(&metric->buckets[b]), 4);
+			}
+		}
+	}
+	return writer.overflow ? 0 : writer.length;
+}
+
+struct TextWriter {
+	char* data;
+	size_t size;
+	size_t length;
+	bool overflow;
+};
+
+static void appendText(struct TextWriter* writer, const char* format, ...) {
+	if (writer->overflow) {
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(writer->data + writer->length, writer->size - writer->length, format, args);
+	va_end(args);
+	if (written < 0 || (size_t)written >= writer->size - writer->length) {
+		writer->overflow = true;
+		return;
+	}
+	writer->length += written;
+}
+
+size_t writeMetricsJson(char* buffer, size_t size, int64_t nanoseconds) {
+	struct TextWriter writer = { buffer, size, 0, size == 0 };
+	int32_t count = registeredMetrics();
+	appendText(&writer, "{\"version\":%d,\"nanoseconds\":%lld", METRICS_VERSION, (long long)nanoseconds);
+	static const char* const sections[] = { "counters", "gauges", "histograms" };
+	for (int32_t type = METRIC_COUNTER; type <= METRIC_HISTOGRAM; ++type) {
+		appendText(&writer, ",\"%s\":{", sections[type - METRIC_COUNTER]);
+		bool first = true;
+		for (int32_t i = 0; i < count; ++i) {
+			const struct Metric* metric = &metricsTable[i];
+			if (metric->type != type) {
+				continue;
+			}
+			appendText(&writer, "%s\"%s\":", first ? "" : ",", metric->name);
+			first = false;
+			if (type == METRIC_COUNTER) {
+				appendText(&writer, "%u", loadRelaxed(&metric->value));
+			} else if (type == METRIC_GAUGE) {
+				appendText(&writer, "%.9g", gaugeValue(metric));
+			} else {
+				appendText(&writer, "{\"count\":%u,\"sum\":%u,\"bounds\":[", loadRelaxed(&metric->value), loadRelaxed(&metric->sum));
+				for (int32_t b = 0; b < metric->bucketCount - 1; ++b) {
+					appendText(&writer, "%s%.9g", b > 0 ? "," : "", metric->bounds[b]);
+				}
+				appendText(&writer, "],\"buckets\":[");
+				for (int32_t b = 0; b < metric->bucketCount; ++b) {
+					appendText(&writer, "%s%u", b > 0 ? "," : "", loadRelaxed(&metric->buckets[b]));
+				}
+				appendText(&writer, "]}");
+			}
+		}
+		appendText(&writer, "}");
+	}
+	appendText(&writer, "}\n");
+	return writer.overflow ? 0 : writer.length;
+}
+
+static socklen_t socketAddress(const char* path, struct sockaddr_un* address) {
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+	size_t length = strlen(path);
+	if (path[0] == '@') {
+		// abstract: a leading NUL and no terminator
+		memcpy(address->sun_path + 1, path + 1, length - 1);
+		return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length);
+	}
+	memcpy(address->sun_path, path, length);
+	return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length + 1);
+}
+
+static bool listenMetricsSocket(struct MetricsExporter* exporter) {
+	struct sockaddr_un address;
+	socklen_t addressLength = socketAddress(exporter->path, &address);
+	if (exporter->path[0] != '@') {
+		unlink(exporter->path);
+	}
+	exporter->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (exporter->listenFd < 0) {
+		LOGE("Metrics: socket failed: %s", strerror(errno));
+		return false;
+	}
+	fcntl(exporter->listenFd, F_SETFL, fcntl(exporter->listenFd, F_GETFL) | O_NONBLOCK);
+	if (bind(exporter->listenFd, (struct sockaddr*)&address, addressLength) != 0 ||
+		listen(exporter->listenFd, METRICS_EXPORTER_MAX_CLIENTS) != 0) {
+		LOGE("Metrics: could not listen on %s: %s", exporter->path, strerror(errno));
+		close(exporter->listenFd);
+		exporter->listenFd = -1;
+		return false;
+	}
+	return true;
+}
+
+static void acceptMetricsReaders(struct MetricsExporter* exporter) {
+	for (int32_t i = 0; i < METRICS_EXPORTER_MAX_CLIENTS; ++i) {
+		if (exporter->clients[i] >= 0) {
+			continue;
+		}
+		int fd = accept(exporter->listenFd, NULL, NULL);
+		if (fd < 0) {
+			return;
+		}
+		exporter->clients[i] = fd;
+		++exporter->stats.readers;
+	}
+}
+
+// A reader that can't take a whole snapshot without blocking is dropped rather than let it stall the exporter.
+static void sendToReaders(struct MetricsExporter* exporter, const void* data, size_t length) {
+	for (int32_t i = 0; i < METRICS_EXPORTER_MAX_CLIENTS; ++i) {
+		if (exporter->clients[i] < 0) {
+			continue;
+		}
+		ssize_t sent = send(exporter->clients[i], data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (sent != (ssize_t)length) {
+			close(exporter->clients[i]);
+			exporter->clients[i] = -1;
+			++exporter->stats.failures;
+		}
+	}
+}
+
+static bool writeMetricsFile(const char* path, const void* data, size_t length) {
+	char temporary[METRICS_EXPORTER_MAX_PATH + 4];
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+	FILE* file = fopen(temporary, "wb");
+	if (!file) {
+		return false;
+	}
+	bool written = fwrite(data, 1, length, file) == length;
+	written = fclose(file) == 0 && written;
+	return written && rename(temporary, path) == 0;
+}
+
+static void exportSnapshot(struct MetricsExporter* exporter) {
+	int64_t start = nowNanoseconds();
+	uint8_t* data = exporter->buffer;
+	size_t length;
+	if (exporter->format == METRICS_FORMAT_JSON) {
+		length = writeMetricsJson((char*)data, sizeof(exporter->buffer), start);
+	} else if (exporter->target == METRICS_TARGET_SOCKET) {
+		// streamed snapshots carry their length
+		length = writeMetricsBinary(data + 4, sizeof(exporter->buffer) - 4, start);
+		for (int32_t i = 0; i < 4; ++i) {
+			data[i] = (uint8_t)(length >> (i * 8));
+		}
+		length = length > 0 ? length + 4 : 0;
+	} else {
+		length = writeMetricsBinary(data, sizeof(exporter->buffer), start);
+	}
+
+	bool written = length > 0;
+	if (written && exporter->target == METRICS_TARGET_FILE) {
+		written = writeMetricsFile(exporter->path, data, length);
+	} else if (written) {
+		acceptMetricsReaders(exporter);
+		sendToReaders(exporter, data, length);
+	}
+	if (written) {
+		++exporter->stats.snapshots;
+	} else {
+		++exporter->stats.failures;
+	}
+	int64_t elapsed = nowNanoseconds() - start;
+	if (elapsed > exporter->stats.maxSnapshotNanoseconds) {
+		exporter->stats.maxSnapshotNanoseconds = elapsed;
+	}
+}
+
+static void* runMetricsExporter(void* data) {
+	struct MetricsExporter* exporter = (struct MetricsExporter*)data;
+	bool quit = false;
+	while (!quit) {
+		// condition variables time out against the wall clock
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		int64_t nanoseconds = deadline.tv_nsec + exporter->intervalNanoseconds;
+		deadline.tv_sec += (time_t)(nanoseconds / 1000000000LL);
+		deadline.tv_nsec = (long)(nanoseconds % 1000000000LL);
+		pthread_mutex_lock(&exporter->mutex);
+		while (!exporter->quit && pthread_cond_timedwait(&exporter->cond, &exporter->mutex, &deadline) != ETIMEDOUT) {
+		}
+		quit = exporter->quit;
+		pthread_mutex_unlock(&exporter->mutex);
+		// including once more on the way out, even if stopped before the first interval
+		exportSnapshot(exporter);
+	}
+	return NULL;
+}
+
+bool startMetricsExporter(struct MetricsExporter* exporter, const char* path, enum MetricsTarget target, enum MetricsFormat format, int64_t intervalNanoseconds) {
+	memset(exporter, 0, sizeof(struct MetricsExporter));
+	exporter->listenFd = -1;
+	for (int32_t i = 0; i < METRICS_EXPORTER_MAX_CLIENTS; ++i) {
+		exporter->clients[i] = -1;
+	}
+	if (strlen(path) < 2 || strlen(path) >= sizeof(exporter->path) || intervalNanoseconds <= 0) {
+		LOGE("startMetricsExporter: invalid path %s or interval", path);
+		return false;
+	}
+	strcpy(exporter->path, path);
+	exporter->target = target;
+	exporter->format = format;
+	exporter->intervalNanoseconds = intervalNanoseconds;
+	if (target == METRICS_TARGET_SOCKET && !listenMetricsSocket(exporter)) {
+		return false;
+	}
+	pthread_mutex_init(&exporter->mutex, NULL);
+	pthread_cond_init(&exporter->cond, NULL);
+	if (pthread_create(&exporter->thread, NULL, runMetricsExporter, exporter) != 0) {
+		LOGE("startMetricsExporter: could not start the thread");
+		pthread_cond_destroy(&exporter->cond);
+		pthread_mutex_destroy(&exporter->mutex);
+		if (exporter->listenFd >= 0) {
+			close(exporter->listenFd);
+		}
+		return false;
+	}
+	exporter->started = true;
+	return true;
+}
+
+void stopMetricsExporter(struct MetricsExporter* exporter) {
+	if (!exporter->started) {
+		return;
+	}
+	pthread_mutex_lock(&exporter->mutex);
+	exporter->quit = true;
+	pthread_cond_signal(&exporter->cond);
+	pthread_mutex_unlock(&exporter->mutex);
+	pthread_join(exporter->thread, NULL);
+	pthread_cond_destroy(&exporter->cond);
+	pthread_mutex_destroy(&exporter->mutex);
+	for (int32_t i = 0; i < METRICS_EXPORTER_MAX_CLIENTS; ++i) {
+		if (exporter->clients[i] >= 0) {
+			close(exporter->clients[i]);
+		}
+	}
+	if (exporter->listenFd >= 0) {
+		close(exporter->listenFd);
+		if (exporter->path[0] != '@') {
+			unlink(exporter->path);
+		}
+	}
+	exporter->started = false;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+// Named counters, gauges and fixed-bucket histograms that any thread can record into, and an
+// exporter thread that snapshots them at a fixed interval to a file or a Unix domain socket.
+//
+// Recording is a relaxed atomic add or store on a 32-bit cell: no locks, no fences, and no 64-bit
+// atomics, which armeabi would need a helper for. Counters and histogram sums wrap, so readers take
+// differences between snapshots modulo 2^32. Registration takes a lock and belongs at startup; an
+// id of -1, from a full registry, makes every recording call a no-op.
+//
+// The binary snapshot is little-endian: "MTRC", a version byte, the time in nanoseconds (u64) and
+// the metric count (u16), then per metric its type (u8), name length (u8) and name, followed by a
+// u32 for counters, an f32 for gauges, or for histograms the count and sum (u32), the bucket count
+// (u8), the upper bounds (f32, one fewer than the buckets) and the bucket counts (u32). On a
+// socket each snapshot is preceded by its length (u32); JSON snapshots are one line each.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_MAX 64
+#define METRICS_MAX_BUCKETS 16
+#define METRICS_NAME_SIZE 32
+#define METRICS_VERSION 1
+#define METRICS_EXPORTER_MAX_CLIENTS 4
+#define METRICS_EXPORTER_MAX_PATH 108 // sun_path
+#define METRICS_EXPORTER_BUFFER_SIZE 32768
+
+enum MetricType {
+	METRIC_COUNTER = 1,
+	METRIC_GAUGE = 2,
+	METRIC_HISTOGRAM = 3
+};
+
+struct Metric {
+	char name[METRICS_NAME_SIZE];
+	int32_t type;
+	int32_t bucketCount; // histograms: the bounds plus one overflow bucket
+	float bounds[METRICS_MAX_BUCKETS - 1]; // increasing upper bounds, inclusive
+	uint32_t value; // counter total, gauge float bits or histogram sample count
+	uint32_t sum; // histograms: sum of the samples rounded to integers
+	uint32_t buckets[METRICS_MAX_BUCKETS];
+};
+
+enum MetricsFormat {
+	METRICS_FORMAT_BINARY,
+	METRICS_FORMAT_JSON
+};
+
+enum MetricsTarget {
+	// the snapshot replaces the file's contents, through a rename so readers never see half of one
+	METRICS_TARGET_FILE,
+	// the exporter listens and sends every snapshot to each connected reader; a path starting
+	// with '@' is in the abstract namespace, e.g. for adb forward tcp:7000 localabstract:name
+	METRICS_TARGET_SOCKET
+};
+
+struct MetricsExporterStats {
+	uint32_t snapshots;
+	uint32_t failures; // snapshots that could not be written, and readers dropped
+	uint32_t readers; // accepted so far
+	int64_t maxSnapshotNanoseconds; // to serialise and write one
+};
+
+struct MetricsExporter {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool started;
+	bool quit;
+	char path[METRICS_EXPORTER_MAX_PATH];
+	enum MetricsTarget target;
+	enum MetricsFormat format;
+	int64_t intervalNanoseconds;
+	int listenFd;
+	int clients[METRICS_EXPORTER_MAX_CLIENTS];
+	struct MetricsExporterStats stats;
+	uint8_t buffer[METRICS_EXPORTER_BUFFER_SIZE];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern struct Metric metricsTable[METRICS_MAX];
+
+// Returns the existing id if the name is already registered with the same type.
+int32_t registerCounter(const char* name);
+int32_t registerGauge(const char* name);
+// At most METRICS_MAX_BUCKETS - 1 bounds; samples above the last go into the overflow bucket.
+int32_t registerHistogram(const char* name, const float* bounds, int32_t boundCount);
+
+// Metrics registered so far; their ids are 0 to this - 1.
+int32_t registeredMetrics(void);
+// Clears every value, keeping the registrations. Not atomic with respect to concurrent recording.
+void resetMetrics(void);
+
+// Snapshot of every metric. Each value is read atomically, but not all of them at the same instant.
+// Return the length, or 0 if the buffer was too small.
+size_t writeMetricsBinary(uint8_t* buffer, size_t size, int64_t nanoseconds);
+size_t writeMetricsJson(char* buffer, size_t size, int64_t nanoseconds);
+
+bool startMetricsExporter(struct MetricsExporter* exporter, const char* path, enum MetricsTarget target, enum MetricsFormat format, int64_t intervalNanoseconds);
+// Writes a last snapshot, then joins the thread and closes the sockets.
+void stopMetricsExporter(struct MetricsExporter* exporter);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline void addCounter(int32_t id, uint32_t amount) {
+	if (id >= 0) {
+		__atomic_fetch_add(&metricsTable[id].value, amount, __ATOMIC_RELAXED);
+	}
+}
+
+static inline void setGauge(int32_t id, float value) {
+	if (id >= 0) {
+		union { float f; uint32_t u; } bits;
+		bits.f = value;
+		__atomic_store_n(&metricsTable[id].value, bits.u, __ATOMIC_RELAXED);
+	}
+}
+
+static inline void recordHistogram(int32_t id, float value) {
+	if (id >= 0) {
+		struct Metric* metric = &metricsTable[id];
+		int32_t bucket = 0;
+		while (bucket < metric->bucketCount - 1 && value > metric->bounds[bucket]) {
+			++bucket;
+		}
+		__atomic_fetch_add(&metric->buckets[bucket], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&metric->value, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&metric->sum, value > 0.0f ? (uint32_t)(value + 0.5f) : 0u, __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,469 @@
+#include "occlusion_culler.h"
+#include "time_utils.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OCCLUSION_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+// triangle setup and box tests are cheap per item, so hand them out in larger chunks
+static const int32_t setupParallelGrain = 64;
+static const int32_t testParallelGrain = 256;
+
+struct OcclusionTest {
+	const OcclusionCuller* culler;
+	const Bounds3D* bounds;
+	uint8_t* results;
+};
+
+struct ClipVertex {
+	float x, y, z, w;
+};
+
+// fminf and fmaxf are library calls unless NaNs are ruled out
+static inline float minFloat(float a, float b) {
+	return a < b ? a : b;
+}
+
+static inline float maxFloat(float a, float b) {
+	return a > b ? a : b;
+}
+
+static void multiplyMatrices(float* out, const float* a, const float* b) {
+	for (int32_t column = 0; column < 4; ++column) {
+		for (int32_t row = 0; row < 4; ++row) {
+			out[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+				a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+		}
+	}
+}
+
+static ClipVertex transformPoint(const float* m, const float* p) {
+	ClipVertex v;
+	v.x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+	v.y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+	v.z = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+	v.w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+	return v;
+}
+
+static ClipVertex lerpVertex(const ClipVertex* a, const ClipVertex* b, float t) {
+	ClipVertex v;
+	v.x = a->x + (b->x - a->x) * t;
+	v.y = a->y + (b->y - a->y) * t;
+	v.z = a->z + (b->z - a->z) * t;
+	v.w = a->w + (b->w - a->w) * t;
+	return v;
+}
+
+// Sets up one screen space triangle; returns false if nothing of it can be drawn.
+static bool setupTriangle(const OcclusionCuller* culler, const ClipVertex* clip0, const ClipVertex* clip1, const ClipVertex* clip2, OccluderTriangle* tri) {
+	const ClipVertex* clip[3] = { clip0, clip1, clip2 };
+	float x[3], y[3], z[3];
+	for (int32_t i = 0; i < 3; ++i) {
+		if (clip[i]->w <= 1e-6f) {
+			return false;
+		}
+		float invW = 1.0f / clip[i]->w;
+		x[i] = (clip[i]->x * invW * 0.5f + 0.5f) * culler->width;
+		y[i] = (clip[i]->y * invW * 0.5f + 0.5f) * culler->height;
+		z[i] = clip[i]->z * invW * 0.5f + 0.5f;
+	}
+
+	// counter-clockwise with y up is positive; back faces and slivers are dropped
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 1e-6f)) {
+		return false;
+	}
+
+	float minX = minFloat(x[0], minFloat(x[1], x[2])), maxX = maxFloat(x[0], maxFloat(x[1], x[2]));
+	float minY = minFloat(y[0], minFloat(y[1], y[2])), maxY = maxFloat(y[0], maxFloat(y[1], y[2]));
+	// pixels whose centre is inside the bounds
+	tri->minX = static_cast<int32_t>(maxFloat(ceilf(minX - 0.5f), 0.0f));
+	tri->minY = static_cast<int32_t>(maxFloat(ceilf(minY - 0.5f), 0.0f));
+	tri->maxX = static_cast<int32_t>(minFloat(floorf(maxX - 0.5f), culler->width - 1.0f));
+	tri->maxY = static_cast<int32_t>(minFloat(floorf(maxY - 0.5f), culler->height - 1.0f));
+	if (tri->minX > tri->maxX || tri->minY > tri->maxY) {
+		return false;
+	}
+
+	// edge functions are evaluated at integer pixel coordinates, so the half pixel to the
+	// centre is folded into c, and so is the margin that makes a pass mean the whole pixel is inside
+	for (int32_t i = 0; i < 3; ++i) {
+		int32_t j = i == 2 ? 0 : i + 1;
+		float a = y[i] - y[j];
+		float b = x[j] - x[i];
+		float c = x[i] * y[j] - x[j] * y[i];
+		tri->edgeA[i] = a;
+		tri->edgeB[i] = b;
+		tri->edgeC[i] = c + 0.5f * (a + b) - 0.5f * (fabsf(a) + fabsf(b));
+	}
+
+	// depth is affine in screen space; take its farthest value over each pixel
+	float invArea = 1.0f / area;
+	float depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * invArea;
+	float depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * invArea;
+	tri->depthA = depthA;
+	tri->depthB = depthB;
+	tri->depthC = z[0] - depthA * x[0] - depthB * y[0] + 0.5f * (depthA + depthB) + 0.5f * (fabsf(depthA) + fabsf(depthB));
+	tri->maxDepth = maxFloat(z[0], maxFloat(z[1], z[2]));
+	return true;
+}
+
+static void setupJob(void* data, int32_t begin, int32_t end) {
+	OcclusionCuller* culler = static_cast<OcclusionCuller*>(data);
+	int32_t occluder = 0;
+	for (int32_t t = begin; t < end; ++t) {
+		// occluders are few, so a forward scan from the last one found is enough
+		while (t >= culler->firstTriangle[occluder + 1]) {
+			++occluder;
+		}
+		const OccluderMesh* mesh = &culler->occluders[occluder];
+		const float* matrix = culler->occluderMatrices + occluder * 16;
+		const uint16_t* indices = mesh->indices + (t - culler->firstTriangle[occluder]) * 3;
+		culler->triangleValid[t * 2] = 0;
+		culler->triangleValid[t * 2 + 1] = 0;
+
+		ClipVertex in[3];
+		float distance[3];
+		int32_t inFront = 0;
+		for (int32_t i = 0; i < 3; ++i) {
+			in[i] = transformPoint(matrix, mesh->positions + indices[i] * 3);
+			distance[i] = in[i].z + in[i].w;
+			inFront += distance[i] >= 0.0f;
+		}
+		if (inFront == 0) {
+			continue;
+		}
+
+		// clip against the near plane, which leaves a triangle or a quad
+		ClipVertex out[4];
+		int32_t outCount = 0;
+		for (int32_t i = 0; i < 3; ++i) {
+			int32_t j = i == 2 ? 0 : i + 1;
+			if (distance[i] >= 0.0f) {
+				out[outCount++] = in[i];
+			}
+			if ((distance[i] >= 0.0f) != (distance[j] >= 0.0f)) {
+				out[outCount++] = lerpVertex(&in[i], &in[j], distance[i] / (distance[i] - distance[j]));
+			}
+		}
+		if (setupTriangle(culler, &out[0], &out[1], &out[2], &culler->triangles[t * 2])) {
+			culler->triangleValid[t * 2] = 1;
+		}
+		if (outCount == 4 && setupTriangle(culler, &out[0], &out[2], &out[3], &culler->triangles[t * 2 + 1])) {
+			culler->triangleValid[t * 2 + 1] = 1;
+		}
+	}
+}
+
+// Writes the triangle's depth into pixels [xBegin, xEnd) of one row, four at a time.
+static void rasterizeSpan(float* row, const OccluderTriangle* tri, int32_t y, int32_t xBegin, int32_t xEnd) {
+	float fy = static_cast<float>(y);
+#if defined(OCCLUSION_NEON)
+	float32x4_t a0 = vdupq_n_f32(tri->edgeA[0]), a1 = vdupq_n_f32(tri->edgeA[1]), a2 = vdupq_n_f32(tri->edgeA[2]);
+	float32x4_t c0 = vdupq_n_f32(tri->edgeB[0] * fy + tri->edgeC[0]);
+	float32x4_t c1 = vdupq_n_f32(tri->edgeB[1] * fy + tri->edgeC[1]);
+	float32x4_t c2 = vdupq_n_f32(tri->edgeB[2] * fy + tri->edgeC[2]);
+	float32x4_t depthA = vdupq_n_f32(tri->depthA), depthC = vdupq_n_f32(tri->depthB * fy + tri->depthC);
+	float32x4_t maxDepth = vdupq_n_f32(tri->maxDepth), zero = vdupq_n_f32(0.0f), four = vdupq_n_f32(4.0f);
+	const float offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	float32x4_t x = vaddq_f32(vdupq_n_f32(static_cast<float>(xBegin)), vld1q_f32(offsets));
+	for (int32_t px = xBegin; px < xEnd; px += 4) {
+		uint32x4_t inside = vandq_u32(vandq_u32(
+			vcgeq_f32(vmlaq_f32(c0, a0, x), zero),
+			vcgeq_f32(vmlaq_f32(c1, a1, x), zero)),
+			vcgeq_f32(vmlaq_f32(c2, a2, x), zero));
+		float32x4_t depth = vminq_f32(vmlaq_f32(depthC, depthA, x), maxDepth);
+		float32x4_t old = vld1q_f32(row + px);
+		vst1q_f32(row + px, vbslq_f32(inside, vminq_f32(old, depth), old));
+		x = vaddq_f32(x, four);
+	}
+#elif defined(OCCLUSION_SSE)
+	__m128 a0 = _mm_set1_ps(tri->edgeA[0]), a1 = _mm_set1_ps(tri->edgeA[1]), a2 = _mm_set1_ps(tri->edgeA[2]);
+	__m128 c0 = _mm_set1_ps(tri->edgeB[0] * fy + tri->edgeC[0]);
+	__m128 c1 = _mm_set1_ps(tri->edgeB[1] * fy + tri->edgeC[1]);
+	__m128 c2 = _mm_set1_ps(tri->edgeB[2] * fy + tri->edgeC[2]);
+	__m128 depthA = _mm_set1_ps(tri->depthA), depthC = _mm_set1_ps(tri->depthB * fy + tri->depthC);
+	__m128 maxDepth = _mm_set1_ps(tri->maxDepth), zero = _mm_setzero_ps(), four = _mm_set1_ps(4.0f);
+	__m128 x = _mm_add_ps(_mm_set1_ps(static_cast<float>(xBegin)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+	for (int32_t px = xBegin; px < xEnd; px += 4) {
+		__m128 inside = _mm_and_ps(_mm_and_ps(
+			_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, x), c0), zero),
+			_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, x), c1), zero)),
+			_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, x), c2), zero));
+		if (_mm_movemask_ps(inside) != 0) {
+			__m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthA, x), depthC), maxDepth);
+			__m128 old = _mm_loadu_ps(row + px);
+			_mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, depth)), _mm_andnot_ps(inside, old)));
+		}
+		x = _mm_add_ps(x, four);
+	}
+#else
+	float c0 = tri->edgeB[0] * fy + tri->edgeC[0];
+	float c1 = tri->edgeB[1] * fy + tri->edgeC[1];
+	float c2 = tri->edgeB[2] * fy + tri->edgeC[2];
+	float depthC = tri->depthB * fy + tri->depthC;
+	for (int32_t px = xBegin; px < xEnd; ++px) {
+		float x = static_cast<float>(px);
+		if (tri->edgeA[0] * x + c0 >= 0.0f && tri->edgeA[1] * x + c1 >= 0.0f && tri->edgeA[2] * x + c2 >= 0.0f) {
+			float depth = minFloat(tri->depthA * x + depthC, tri->maxDepth);
+			if (depth < row[px]) {
+				row[px] = depth;
+			}
+		}
+	}
+#endif
+}
+
+// Each texel of level + 1 holds the farthest of the four below it; odd sizes repeat the last row or column.
+static void downsampleRows(OcclusionCuller* culler, int32_t level, int32_t rowBegin, int32_t rowEnd) {
+	const float* source = culler->levels[level];
+	float* target = culler->levels[level + 1];
+	int32_t sourceWidth = culler->levelWidth[level], sourceHeight = culler->levelHeight[level];
+	int32_t targetWidth = culler->levelWidth[level + 1];
+	for (int32_t y = rowBegin; y < rowEnd; ++y) {
+		const float* row0 = source + (y * 2) * sourceWidth;
+		const float* row1 = y * 2 + 1 < sourceHeight ? row0 + sourceWidth : row0;
+		float* out = target + y * targetWidth;
+		for (int32_t x = 0; x < targetWidth; ++x) {
+			int32_t x0 = x * 2, x1 = x * 2 + 1 < sourceWidth ? x * 2 + 1 : x * 2;
+			out[x] = maxFloat(maxFloat(row0[x0], row0[x1]), maxFloat(row1[x0], row1[x1]));
+		}
+	}
+}
+
+static void rasterizeBandJob(void* data, int32_t begin, int32_t end) {
+	OcclusionCuller* culler = static_cast<OcclusionCuller*>(data);
+	int32_t triangleSlots = culler->firstTriangle[culler->occluderCount] * 2;
+	for (int32_t band = begin; band < end; ++band) {
+		int32_t rowBegin = band * OCCLUSION_BAND_ROWS, rowEnd = rowBegin + OCCLUSION_BAND_ROWS;
+		float* depth = culler->levels[0];
+		for (int32_t i = rowBegin * culler->width; i < rowEnd * culler->width; ++i) {
+			depth[i] = 1.0f;
+		}
+
+		for (int32_t t = 0; t < triangleSlots; ++t) {
+			const OccluderTriangle* tri = &culler->triangles[t];
+			if (!culler->triangleValid[t] || tri->maxY < rowBegin || tri->minY >= rowEnd) {
+				continue;
+			}
+			int32_t yBegin = tri->minY > rowBegin ? tri->minY : rowBegin;
+			int32_t yEnd = tri->maxY + 1 < rowEnd ? tri->maxY + 1 : rowEnd;
+			// the width is a multiple of four, so whole groups never run past the row
+			int32_t xBegin = tri->minX & ~3, xEnd = (tri->maxX + 4) & ~3;
+			for (int32_t y = yBegin; y < yEnd; ++y) {
+				rasterizeSpan(depth + y * culler->width, tri, y, xBegin, xEnd);
+			}
+		}
+
+		for (int32_t level = 0; level < OCCLUSION_BAND_LEVELS && level + 1 < culler->levelCount; ++level) {
+			downsampleRows(culler, level, rowBegin >> (level + 1), rowEnd >> (level + 1));
+		}
+	}
+}
+
+static void testJob(void* data, int32_t begin, int32_t end) {
+	OcclusionTest* test = static_cast<OcclusionTest*>(data);
+	for (int32_t i = begin; i < end; ++i) {
+		test->results[i] = static_cast<uint8_t>(testOcclusionBox(test->culler, &test->bounds[i]));
+	}
+}
+
+bool initOcclusionCuller(OcclusionCuller* culler, int32_t width, int32_t height, int32_t maxOccluders, int32_t maxTriangles, WorkerPool* workers) {
+	memset(culler, 0, sizeof(OcclusionCuller));
+	width = (width + OCCLUSION_BAND_ROWS - 1) & ~(OCCLUSION_BAND_ROWS - 1);
+	height = (height + OCCLUSION_BAND_ROWS - 1) & ~(OCCLUSION_BAND_ROWS - 1);
+	if (width <= 0 || height <= 0 || maxOccluders <= 0 || maxTriangles <= 0) {
+		LOGE("initOcclusionCuller: invalid size %dx%d, %d occluders, %d triangles", width, height, maxOccluders, maxTriangles);
+		return false;
+	}
+	culler->width = width;
+	culler->height = height;
+	culler->maxOccluders = maxOccluders;
+	culler->maxTriangles = maxTriangles;
+	culler->workers = workers;
+
+	int32_t levelWidth = width, levelHeight = height;
+	while (culler->levelCount < OCCLUSION_MAX_LEVELS) {
+		int32_t level = culler->levelCount++;
+		culler->levelWidth[level] = levelWidth;
+		culler->levelHeight[level] = levelHeight;
+		culler->levels[level] = static_cast<float*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, levelWidth * levelHeight * sizeof(float)));
+		if (!culler->levels[level]) {
+			termOcclusionCuller(culler);
+			return false;
+		}
+		if (levelWidth == 1 && levelHeight == 1) {
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	culler->occluders = static_cast<OccluderMesh*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, maxOccluders * sizeof(OccluderMesh)));
+	culler->occluderMatrices = static_cast<float*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, maxOccluders * 16 * sizeof(float)));
+	culler->firstTriangle = static_cast<int32_t*>(MEMORY_CALLOC(MEMORY_TAG_SCENE, maxOccluders + 1, sizeof(int32_t)));
+	culler->triangles = static_cast<OccluderTriangle*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, maxTriangles * 2 * sizeof(OccluderTriangle)));
+	culler->triangleValid = static_cast<uint8_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, maxTriangles * 2));
+	if (!culler->occluders || !culler->occluderMatrices || !culler->firstTriangle || !culler->triangles || !culler->triangleValid) {
+		termOcclusionCuller(culler);
+		return false;
+	}
+	LOGI("occlusion culler: %dx%d depth, %d levels", width, height, culler->levelCount);
+	return true;
+}
+
+void termOcclusionCuller(OcclusionCuller* culler) {
+	for (int32_t level = 0; level < culler->levelCount; ++level) {
+		MEMORY_FREE(culler->levels[level]);
+	}
+	MEMORY_FREE(culler->occluders);
+	MEMORY_FREE(culler->occluderMatrices);
+	MEMORY_FREE(culler->firstTriangle);
+	MEMORY_FREE(culler->triangles);
+	MEMORY_FREE(culler->triangleValid);
+	memset(culler, 0, sizeof(OcclusionCuller));
+}
+
+void beginOcclusionFrame(OcclusionCuller* culler, const float viewProjection[16]) {
+	memcpy(culler->viewProjection, viewProjection, sizeof(culler->viewProjection));
+	culler->occluderCount = 0;
+	culler->firstTriangle[0] = 0;
+	memset(&culler->stats, 0, sizeof(OcclusionStats));
+}
+
+bool addOccluder(OcclusionCuller* culler, const OccluderMesh* mesh, const float modelMatrix[16]) {
+	int32_t count = culler->occluderCount;
+	if (count == culler->maxOccluders || culler->firstTriangle[count] + mesh->triangleCount > culler->maxTriangles) {
+		return false;
+	}
+	culler->occluders[count] = *mesh;
+	multiplyMatrices(culler->occluderMatrices + count * 16, culler->viewProjection, modelMatrix);
+	culler->firstTriangle[count + 1] = culler->firstTriangle[count] + mesh->triangleCount;
+	culler->occluderCount = count + 1;
+	culler->stats.occluderTriangles += mesh->triangleCount;
+	return true;
+}
+
+void rasterizeOccluders(OcclusionCuller* culler) {
+	int64_t start = nowNanoseconds();
+	int32_t triangleCount = culler->firstTriangle[culler->occluderCount];
+	int32_t bandCount = culler->height / OCCLUSION_BAND_ROWS;
+	if (culler->workers) {
+		runParallel(culler->workers, setupJob, culler, triangleCount, setupParallelGrain);
+		runParallel(culler->workers, rasterizeBandJob, culler, bandCount, 1);
+	} else {
+		setupJob(culler, 0, triangleCount);
+		rasterizeBandJob(culler, 0, bandCount);
+	}
+	// the bands built the first levels; the rest are small
+	for (int32_t level = OCCLUSION_BAND_LEVELS; level + 1 < culler->levelCount; ++level) {
+		downsampleRows(culler, level, 0, culler->levelHeight[level + 1]);
+	}
+
+	for (int32_t t = 0; t < triangleCount * 2; ++t) {
+		culler->stats.rasterizedTriangles += culler->triangleValid[t];
+	}
+	culler->stats.rasterizeNanoseconds = nowNanoseconds() - start;
+}
+
+void testOcclusion(OcclusionCuller* culler, const Bounds3D* bounds, int32_t count, uint8_t* results) {
+	int64_t start = nowNanoseconds();
+	OcclusionTest test = { culler, bounds, results };
+	if (culler->workers) {
+		runParallel(culler->workers, testJob, &test, count, testParallelGrain);
+	} else {
+		testJob(&test, 0, count);
+	}
+	for (int32_t i = 0; i < count; ++i) {
+		culler->stats.occluded += results[i] == OCCLUSION_OCCLUDED;
+		culler->stats.outside += results[i] == OCCLUSION_OUTSIDE;
+	}
+	culler->stats.tested += count;
+	culler->stats.testNanoseconds += nowNanoseconds() - start;
+}
+
+OcclusionResult testOcclusionBox(const OcclusionCuller* culler, const Bounds3D* bounds) {
+	// the corners are the min corner plus any combination of the three edge vectors
+	const float* m = culler->viewProjection;
+	float extent[3] = { bounds->maxX - bounds->minX, bounds->maxY - bounds->minY, bounds->maxZ - bounds->minZ };
+	const float minCorner[3] = { bounds->minX, bounds->minY, bounds->minZ };
+	ClipVertex origin = transformPoint(m, minCorner);
+	ClipVertex edges[3];
+	for (int32_t axis = 0; axis < 3; ++axis) {
+		edges[axis].x = m[axis * 4] * extent[axis];
+		edges[axis].y = m[axis * 4 + 1] * extent[axis];
+		edges[axis].z = m[axis * 4 + 2] * extent[axis];
+		edges[axis].w = m[axis * 4 + 3] * extent[axis];
+	}
+
+	// frustum outcodes first, so that boxes off screen never pay for the divides
+	ClipVertex corners[8];
+	uint32_t allOutside = 0x3f, anyBehindNear = 0;
+	for (int32_t corner = 0; corner < 8; ++corner) {
+		ClipVertex v = origin;
+		for (int32_t axis = 0; axis < 3; ++axis) {
+			if (corner & (1 << axis)) {
+				v.x += edges[axis].x;
+				v.y += edges[axis].y;
+				v.z += edges[axis].z;
+				v.w += edges[axis].w;
+			}
+		}
+		uint32_t outcode = (v.x < -v.w) | (v.x > v.w) << 1 | (v.y < -v.w) << 2 | (v.y > v.w) << 3 |
+			(v.z < -v.w || v.w <= 1e-6f) << 4 | (v.z > v.w) << 5;
+		allOutside &= outcode;
+		anyBehindNear |= outcode & 0x10;
+		corners[corner] = v;
+	}
+	if (allOutside) {
+		return OCCLUSION_OUTSIDE;
+	}
+	if (anyBehindNear) {
+		// the box reaches the camera; its screen rectangle is unbounded
+		return OCCLUSION_VISIBLE;
+	}
+
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minDepth = 1e30f;
+	for (int32_t corner = 0; corner < 8; ++corner) {
+		float invW = 1.0f / corners[corner].w;
+		minX = minFloat(minX, corners[corner].x * invW);
+		maxX = maxFloat(maxX, corners[corner].x * invW);
+		minY = minFloat(minY, corners[corner].y * invW);
+		maxY = maxFloat(maxY, corners[corner].y * invW);
+		minDepth = minFloat(minDepth, corners[corner].z * invW);
+	}
+
+	float width = static_cast<float>(culler->width), height = static_cast<float>(culler->height);
+	int32_t x0 = static_cast<int32_t>(maxFloat((minX * 0.5f + 0.5f) * width, 0.0f));
+	int32_t x1 = static_cast<int32_t>(minFloat((maxX * 0.5f + 0.5f) * width, width - 1.0f));
+	int32_t y0 = static_cast<int32_t>(maxFloat((minY * 0.5f + 0.5f) * height, 0.0f));
+	int32_t y1 = static_cast<int32_t>(minFloat((maxY * 0.5f + 0.5f) * height, height - 1.0f));
+	minDepth = minDepth * 0.5f + 0.5f;
+
+	// the coarsest level where the rectangle spans at most three texels a side
+	int32_t span = x1 - x0 > y1 - y0 ? x1 - x0 : y1 - y0;
+	int32_t level = 0;
+	while ((span >> level) > 1 && level + 1 < culler->levelCount) {
+		++level;
+	}
+	const float* depth = culler->levels[level];
+	int32_t levelWidth = culler->levelWidth[level];
+	for (int32_t y = y0 >> level; y <= y1 >> level; ++y) {
+		for (int32_t x = x0 >> level; x <= x1 >> level; ++x) {
+			if (minDepth <= depth[y * levelWidth + x]) {
+				return OCCLUSION_VISIBLE;
+			}
+		}
+	}
+	return OCCLUSION_OCCLUDED;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "worker_pool.h"
+
+#include <stdint.h>
+
+#define OCCLUSION_MAX_LEVELS 12
+// rows of the depth buffer rasterised by one job; the buffer is padded to a multiple of this
+#define OCCLUSION_BAND_ROWS 16
+// pyramid levels each band builds itself, while its rows are still in cache
+#define OCCLUSION_BAND_LEVELS 4
+
+struct Bounds3D {
+	float minX, minY, minZ;
+	float maxX, maxY, maxZ;
+};
+
+// An occluder's triangles in model space, front faces counter-clockwise.
+struct OccluderMesh {
+	const float* positions; // x, y, z per vertex
+	int32_t vertexCount;
+	const uint16_t* indices;
+	int32_t triangleCount;
+};
+
+enum OcclusionResult {
+	OCCLUSION_VISIBLE,
+	OCCLUSION_OCCLUDED,
+	OCCLUSION_OUTSIDE // outside the view frustum
+};
+
+// Screen space triangle, set up once per frame for every band it touches.
+struct OccluderTriangle {
+	float edgeA[3], edgeB[3], edgeC[3]; // inside where a*x + b*y + c >= 0 at pixel centres
+	float depthA, depthB, depthC; // farthest depth within a pixel, before the clamp
+	float maxDepth;
+	int32_t minX, minY, maxX, maxY; // inclusive pixel bounds
+};
+
+struct OcclusionStats {
+	int32_t occluderTriangles; // submitted this frame
+	int32_t rasterizedTriangles; // after clipping and back face culling
+	int32_t tested;
+	int32_t occluded;
+	int32_t outside;
+	int64_t rasterizeNanoseconds; // setup, rasterisation and the pyramid
+	int64_t testNanoseconds;
+};
+
+// Software occlusion culling: occluders are rasterised conservatively into a small depth
+// buffer, so a pixel is only written where a triangle covers all of it and only with the
+// farthest depth the triangle has there. A max pyramid over that buffer then answers box
+// queries with a handful of texel reads. Depth runs from 0 at the near plane to 1 at the
+// far plane, and everything that cannot be answered safely is reported visible.
+struct OcclusionCuller {
+	int32_t width;
+	int32_t height;
+	int32_t levelCount;
+	int32_t levelWidth[OCCLUSION_MAX_LEVELS];
+	int32_t levelHeight[OCCLUSION_MAX_LEVELS];
+	float* levels[OCCLUSION_MAX_LEVELS]; // level 0 is the depth buffer
+
+	float viewProjection[16];
+	int32_t occluderCount;
+	int32_t maxOccluders;
+	OccluderMesh* occluders;
+	float* occluderMatrices; // model view projection, 16 per occluder
+	int32_t* firstTriangle; // prefix sum over the occluders' triangle counts
+	int32_t maxTriangles;
+	OccluderTriangle* triangles; // two per source triangle, for near plane clipping
+	uint8_t* triangleValid;
+
+	WorkerPool* workers;
+	OcclusionStats stats;
+};
+
+// The depth buffer is width x height rounded up to OCCLUSION_BAND_ROWS; maxTriangles bounds the sum of all occluders per frame.
+bool initOcclusionCuller(OcclusionCuller* culler, int32_t width, int32_t height, int32_t maxOccluders, int32_t maxTriangles, WorkerPool* workers);
+void termOcclusionCuller(OcclusionCuller* culler);
+
+// Matrices are column-major, as for glUniformMatrix4fv.
+void beginOcclusionFrame(OcclusionCuller* culler, const float viewProjection[16]);
+// Returns false, and drops the occluder, when the frame's occluder or triangle budget is used up.
+bool addOccluder(OcclusionCuller* culler, const OccluderMesh* mesh, const float modelMatrix[16]);
+// Clears the depth buffer, rasterises the occluders and builds the pyramid.
+void rasterizeOccluders(OcclusionCuller* culler);
+
+// Writes an OcclusionResult per world space box and updates the frame's stats.
+void testOcclusion(OcclusionCuller* culler, const Bounds3D* bounds, int32_t count, uint8_t* results);
+OcclusionResult testOcclusionBox(const OcclusionCuller* culler, const Bounds3D* bounds);
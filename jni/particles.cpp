@@ -0,0 +1,255 @@
+#include "particles.h"
+#include "shader_utils.h"
+#include "time_utils.h"
+#include "log.h"
+#include "memory_tracker.h"
+#include "shaders/particle.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PARTICLES_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define PARTICLES_SSE 1
+#endif
+
+// below this many particles the hand-off to worker threads costs more than it saves
+static const int32_t particlesParallelGrain = 8192;
+
+struct ParticleUpdate {
+	Particles* particles;
+	float dt;
+};
+
+static float nextRandom(Particles* particles) {
+	// xorshift32, uniform in [-1, 1)
+	uint32_t r = particles->random;
+	r ^= r << 13;
+	r ^= r >> 17;
+	r ^= r << 5;
+	particles->random = r;
+	return static_cast<int32_t>(r) * (1.0f / 2147483648.0f);
+}
+
+bool initParticles(Particles* particles, int32_t capacity, WorkerPool* workers) {
+	memset(particles, 0, sizeof(Particles));
+	capacity = (capacity + 3) & ~3;
+
+	float** arrays[] = {
+		&particles->x, &particles->y, &particles->velocityX, &particles->velocityY,
+		&particles->age, &particles->invLifetime
+	};
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+		*arrays[i] = static_cast<float*>(MEMORY_CALLOC(MEMORY_TAG_PARTICLES, capacity, sizeof(float)));
+		if (!*arrays[i]) {
+			termParticles(particles);
+			return false;
+		}
+	}
+	particles->vertices = static_cast<ParticleVertex*>(MEMORY_ALLOC(MEMORY_TAG_PARTICLES, capacity * sizeof(ParticleVertex)));
+	if (!particles->vertices) {
+		termParticles(particles);
+		return false;
+	}
+
+	particles->capacity = capacity;
+	particles->random = 0x9e3779b9;
+	particles->gravity = 400.0f;
+	particles->drag = 1.0f;
+	particles->workers = workers;
+	return true;
+}
+
+void termParticles(Particles* particles) {
+	MEMORY_FREE(particles->x);
+	MEMORY_FREE(particles->y);
+	MEMORY_FREE(particles->velocityX);
+	MEMORY_FREE(particles->velocityY);
+	MEMORY_FREE(particles->age);
+	MEMORY_FREE(particles->invLifetime);
+	MEMORY_FREE(particles->vertices);
+	memset(particles, 0, sizeof(Particles));
+}
+
+bool initParticlesGL(Particles* particles) {
+	particles->program = beginProgram(particleVertexShader, particleFragmentShader);
+	return particles->program != 0;
+}
+
+bool finishParticlesGL(Particles* particles) {
+	GLuint program = finishProgram(particles->program);
+	if (!program) {
+		LOGE("Could not create particle program");
+		particles->program = 0;
+		return false;
+	}
+	particles->positionLocation = glGetAttribLocation(program, "position");
+	particles->lifeLocation = glGetAttribLocation(program, "life");
+	particles->screenSizeLocation = glGetUniformLocation(program, "screenSize");
+	particles->pointSizeLocation = glGetUniformLocation(program, "pointSize");
+	return true;
+}
+
+void termParticlesGL(Particles* particles) {
+	if (particles->program) {
+		glDeleteProgram(particles->program);
+		particles->program = 0;
+	}
+}
+
+void spawnParticles(Particles* particles, float x, float y, int32_t count, float speed, float lifetime) {
+	if (count > particles->capacity - particles->count) {
+		count = particles->capacity - particles->count;
+	}
+	float invLifetime = 1.0f / lifetime;
+	for (int32_t i = particles->count; i < particles->count + count; ++i) {
+		particles->x[i] = x;
+		particles->y[i] = y;
+		particles->velocityX[i] = nextRandom(particles) * speed;
+		particles->velocityY[i] = nextRandom(particles) * speed;
+		particles->age[i] = 0.0f;
+		// vary lifetimes a little so bursts don't vanish all at once
+		particles->invLifetime[i] = invLifetime * (1.0f + 0.25f * nextRandom(particles));
+	}
+	particles->count += count;
+}
+
+// Integrates [begin, end); begin is a multiple of 4 and the arrays are padded, so end can be rounded up.
+static void integrateParticles(void* data, int32_t begin, int32_t end) {
+	const ParticleUpdate* update = static_cast<const ParticleUpdate*>(data);
+	Particles* p = update->particles;
+	const float dt = update->dt;
+	const float gravityStep = p->gravity * dt;
+	const float damping = 1.0f - p->drag * dt > 0.0f ? 1.0f - p->drag * dt : 0.0f;
+	float* __restrict x = p->x;
+	float* __restrict y = p->y;
+	float* __restrict velocityX = p->velocityX;
+	float* __restrict velocityY = p->velocityY;
+	float* __restrict age = p->age;
+	const float* __restrict invLifetime = p->invLifetime;
+	end = (end + 3) & ~3;
+
+#if defined(PARTICLES_NEON)
+	const float32x4_t vDt = vdupq_n_f32(dt);
+	const float32x4_t vGravity = vdupq_n_f32(gravityStep);
+	const float32x4_t vDamping = vdupq_n_f32(damping);
+	for (int32_t i = begin; i < end; i += 4) {
+		float32x4_t vx = vmulq_f32(vld1q_f32(velocityX + i), vDamping);
+		float32x4_t vy = vaddq_f32(vmulq_f32(vld1q_f32(velocityY + i), vDamping), vGravity);
+		vst1q_f32(velocityX + i, vx);
+		vst1q_f32(velocityY + i, vy);
+		vst1q_f32(x + i, vmlaq_f32(vld1q_f32(x + i), vx, vDt));
+		vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), vy, vDt));
+		vst1q_f32(age + i, vmlaq_f32(vld1q_f32(age + i), vld1q_f32(invLifetime + i), vDt));
+	}
+#elif defined(PARTICLES_SSE)
+	const __m128 vDt = _mm_set1_ps(dt);
+	const __m128 vGravity = _mm_set1_ps(gravityStep);
+	const __m128 vDamping = _mm_set1_ps(damping);
+	for (int32_t i = begin; i < end; i += 4) {
+		__m128 vx = _mm_mul_ps(_mm_loadu_ps(velocityX + i), vDamping);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(velocityY + i), vDamping), vGravity);
+		_mm_storeu_ps(velocityX + i, vx);
+		_mm_storeu_ps(velocityY + i, vy);
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(vx, vDt)));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(vy, vDt)));
+		_mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), _mm_mul_ps(_mm_loadu_ps(invLifetime + i), vDt)));
+	}
+#else
+	for (int32_t i = begin; i < end; ++i) {
+		velocityX[i] *= damping;
+		velocityY[i] = velocityY[i] * damping + gravityStep;
+		x[i] += velocityX[i] * dt;
+		y[i] += velocityY[i] * dt;
+		age[i] += invLifetime[i] * dt;
+	}
+#endif
+}
+
+static void compactParticles(Particles* p) {
+	// swap the last live particle into each dead slot; order does not matter for additive sprites
+	int32_t count = p->count;
+	for (int32_t i = 0; i < count; ) {
+		if (p->age[i] < 1.0f) {
+			++i;
+			continue;
+		}
+		int32_t last = --count;
+		p->x[i] = p->x[last];
+		p->y[i] = p->y[last];
+		p->velocityX[i] = p->velocityX[last];
+		p->velocityY[i] = p->velocityY[last];
+		p->age[i] = p->age[last];
+		p->invLifetime[i] = p->invLifetime[last];
+	}
+	p->count = count;
+}
+
+void updateParticles(Particles* particles, float dt) {
+	int64_t start = nowNanoseconds();
+
+	if (dt > 0.0f && particles->count > 0) {
+		ParticleUpdate update = { particles, dt };
+		if (particles->workers) {
+			runParallel(particles->workers, integrateParticles, &update, particles->count, particlesParallelGrain);
+		} else {
+			integrateParticles(&update, 0, particles->count);
+		}
+		compactParticles(particles);
+	}
+
+	ParticleVertex* __restrict vertices = particles->vertices;
+	const float* __restrict x = particles->x;
+	const float* __restrict y = particles->y;
+	const float* __restrict age = particles->age;
+	for (int32_t i = 0; i < particles->count; ++i) {
+		vertices[i].x = x[i];
+		vertices[i].y = y[i];
+		vertices[i].life = 1.0f - age[i];
+	}
+
+	particles->lastUpdateNanoseconds = nowNanoseconds() - start;
+	particles->updateNanoseconds += particles->lastUpdateNanoseconds;
+	particles->updatedParticles += particles->count;
+}
+
+void drawParticles(Particles* particles, StreamBuffer* stream, int32_t screenWidth, int32_t screenHeight, float pointSize) {
+	if (particles->count == 0) {
+		return;
+	}
+
+	GLsizeiptr size = particles->count * sizeof(ParticleVertex);
+	StreamAllocation allocation;
+	const char* base = NULL;
+	void* data = allocStream(stream, size, sizeof(float), &allocation);
+	if (data) {
+		memcpy(data, particles->vertices, size);
+		commitStream(stream, &allocation);
+		base = reinterpret_cast<const char*>(allocation.offset);
+	} else {
+		// doesn't fit this frame's segment; fall back to a client-side array
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		base = reinterpret_cast<const char*>(particles->vertices);
+	}
+
+	glUseProgram(particles->program);
+	glUniform2f(particles->screenSizeLocation, screenWidth, screenHeight);
+	glUniform1f(particles->pointSizeLocation, pointSize);
+	glVertexAttribPointer(particles->positionLocation, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), base + offsetof(ParticleVertex, x));
+	glVertexAttribPointer(particles->lifeLocation, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), base + offsetof(ParticleVertex, life));
+	glEnableVertexAttribArray(particles->positionLocation);
+	glEnableVertexAttribArray(particles->lifeLocation);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDrawArrays(GL_POINTS, 0, particles->count);
+	glDisable(GL_BLEND);
+
+	glDisableVertexAttribArray(particles->positionLocation);
+	glDisableVertexAttribArray(particles->lifeLocation);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
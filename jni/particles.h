@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stream_buffer.h"
+#include "worker_pool.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+struct ParticleVertex {
+	float x;
+	float y;
+	float life; // 1 when spawned, 0 when it dies
+};
+
+// Particle state as separate arrays (structure of arrays), padded to a multiple of 4 for the SIMD kernels.
+// Dead particles are compacted in place, so the arrays are allocated once at init.
+struct Particles {
+	int32_t count;
+	int32_t capacity;
+	float* x;
+	float* y;
+	float* velocityX;
+	float* velocityY;
+	float* age;
+	float* invLifetime;
+	ParticleVertex* vertices;
+	uint32_t random;
+	float gravity;
+	float drag;
+	WorkerPool* workers;
+	int64_t lastUpdateNanoseconds;
+	uint64_t updatedParticles;
+	uint64_t updateNanoseconds;
+	GLuint program;
+	GLint positionLocation;
+	GLint lifeLocation;
+	GLint screenSizeLocation;
+	GLint pointSizeLocation;
+};
+
+// workers may be NULL to update on the calling thread only.
+bool initParticles(Particles* particles, int32_t capacity, WorkerPool* workers);
+void termParticles(Particles* particles);
+
+// Creates the GL objects; call again whenever a new context is made current. The program is only
+// submitted for compilation until finishParticlesGL, which must be called before drawing.
+bool initParticlesGL(Particles* particles);
+bool finishParticlesGL(Particles* particles);
+// Deletes the GL objects; call before the context goes away.
+void termParticlesGL(Particles* particles);
+
+// Emits count particles at (x, y) in window pixels with random velocities up to speed pixels per second.
+void spawnParticles(Particles* particles, float x, float y, int32_t count, float speed, float lifetime);
+
+void updateParticles(Particles* particles, float dt);
+
+// Streams this frame's vertices through the stream buffer and draws them as point sprites.
+void drawParticles(Particles* particles, StreamBuffer* stream, int32_t screenWidth, int32_t screenHeight, float pointSize);
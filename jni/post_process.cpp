@@ -0,0 +1,374 @@
+#include "post_process.h"
+#include "log.h"
+#include "memory_tracker.h"
+#include "shader_utils.h"
+#include "shaders/blur.h"
+#include "shaders/bright.h"
+#include "shaders/full_screen.h"
+
+#include <string.h>
+
+static const char compositeHeader[] =
+	"precision mediump float;\n"
+	"varying vec2 uv;\n"
+	"uniform sampler2D scene;\n";
+
+static const char compositeMain[] =
+	"void main() {\n"
+	"	vec3 c = texture2D(scene, uv).rgb;\n";
+
+static const char compositeFooter[] =
+	"	gl_FragColor = vec4(c, 1.0);\n"
+	"}\n";
+
+// the uniforms and the code each effect contributes to the composite shader
+struct PostEffectSource {
+	const char* declarations;
+	const char* code;
+};
+
+static const PostEffectSource effectSources[POST_EFFECT_TYPE_COUNT] = {
+	{
+		"uniform sampler2D bloom;\n"
+		"uniform float bloomStrength;\n",
+		"	c += texture2D(bloom, uv).rgb * bloomStrength;\n"
+	},
+	{
+		"uniform vec3 grade;\n",
+		"	vec3 graded = mix(vec3(dot(c, vec3(0.299, 0.587, 0.114))), c, grade.x);\n"
+		"	graded = (graded - vec3(0.5)) * grade.y + vec3(0.5);\n"
+		"	c = mix(c, graded, grade.z);\n"
+	},
+	{
+		"uniform vec4 vignette;\n",
+		"	vec2 centre = (uv - vec2(0.5)) * vec2(vignette.w, 1.0) * 2.0;\n"
+		"	c *= 1.0 - vignette.z * smoothstep(vignette.x, vignette.y, length(centre));\n"
+	}
+};
+
+// a triangle covering the screen, so there is no diagonal seam for the rasterizer to shade twice
+static const GLfloat fullScreenTriangle[] = {
+	-1.0f, -1.0f,
+	 3.0f, -1.0f,
+	-1.0f,  3.0f
+};
+
+bool initPostProcess(PostProcess* post, const PostEffect* chain, int32_t count) {
+	memset(post, 0, sizeof(PostProcess));
+	if (count > POST_PROCESS_MAX_EFFECTS) {
+		LOGE("Post process chain of %d effects is too long", count);
+		return false;
+	}
+	uint32_t seen = 0;
+	for (int32_t i = 0; i < count; ++i) {
+		uint32_t bit = 1u << chain[i].type;
+		if (seen & bit) {
+			LOGE("Post effect %d appears twice", chain[i].type);
+			return false;
+		}
+		seen |= bit;
+	}
+	memcpy(post->chain, chain, count * sizeof(PostEffect));
+	post->count = count;
+	post->sceneColor = -1;
+	post->bloomSource = -1;
+	post->bloomBlurred = -1;
+	post->bloomScratch = -1;
+	return true;
+}
+
+void setPostEffectStrength(PostProcess* post, PostEffectType type, float strength) {
+	for (int32_t i = 0; i < post->count; ++i) {
+		if (post->chain[i].type == type) {
+			post->chain[i].strength = strength;
+		}
+	}
+}
+
+uint32_t activePostEffects(const PostProcess* post) {
+	uint32_t mask = 0;
+	for (int32_t i = 0; i < post->count; ++i) {
+		if (post->chain[i].strength != 0.0f) {
+			mask |= 1u << post->chain[i].type;
+		}
+	}
+	return mask;
+}
+
+static const PostEffect* findPostEffect(const PostProcess* post, PostEffectType type) {
+	for (int32_t i = 0; i < post->count; ++i) {
+		if (post->chain[i].type == type) {
+			return &post->chain[i];
+		}
+	}
+	return NULL;
+}
+
+static bool appendSource(char* buffer, size_t size, size_t* length, const char* text) {
+	size_t textLength = strlen(text);
+	if (*length + textLength + 1 > size) {
+		return false;
+	}
+	memcpy(buffer + *length, text, textLength + 1);
+	*length += textLength;
+	return true;
+}
+
+size_t generatePostShader(const PostProcess* post, uint32_t mask, char* buffer, size_t size) {
+	size_t length = 0;
+	bool fits = appendSource(buffer, size, &length, compositeHeader);
+	for (int32_t i = 0; i < post->count; ++i) {
+		if (mask & (1u << post->chain[i].type)) {
+			fits = fits && appendSource(buffer, size, &length, effectSources[post->chain[i].type].declarations);
+		}
+	}
+	fits = fits && appendSource(buffer, size, &length, compositeMain);
+	for (int32_t i = 0; i < post->count; ++i) {
+		if (mask & (1u << post->chain[i].type)) {
+			fits = fits && appendSource(buffer, size, &length, effectSources[post->chain[i].type].code);
+		}
+	}
+	fits = fits && appendSource(buffer, size, &length, compositeFooter);
+	return fits ? length : 0;
+}
+
+static bool beginPostProgram(PostProcess* post, PostProgram* program, uint32_t mask) {
+	char source[2048];
+	if (!generatePostShader(post, mask, source, sizeof(source))) {
+		LOGE("Post process shader for effects 0x%x is too long", mask);
+		return false;
+	}
+	memset(program, 0, sizeof(PostProgram));
+	program->mask = mask;
+	program->program = beginProgram(fullScreenVertexShader, source);
+	return program->program != 0;
+}
+
+static bool finishPostProgram(PostProgram* program) {
+	GLuint linked = finishProgram(program->program);
+	if (!linked) {
+		LOGE("Could not create post process program for effects 0x%x", program->mask);
+		program->program = 0;
+		return false;
+	}
+	program->positionLocation = glGetAttribLocation(linked, "position");
+	program->sceneLocation = glGetUniformLocation(linked, "scene");
+	program->bloomLocation = glGetUniformLocation(linked, "bloom");
+	program->bloomStrengthLocation = glGetUniformLocation(linked, "bloomStrength");
+	program->gradeLocation = glGetUniformLocation(linked, "grade");
+	program->vignetteLocation = glGetUniformLocation(linked, "vignette");
+	return true;
+}
+
+bool initPostProcessGL(PostProcess* post) {
+	post->brightProgram = beginProgram(fullScreenVertexShader, brightFragmentShader);
+	post->blurProgram = beginProgram(fullScreenVertexShader, blurFragmentShader);
+	// the composite for the starting effects; others are built the first time they are used
+	post->programCount = 0;
+	if (!post->brightProgram || !post->blurProgram || !beginPostProgram(post, &post->programs[0], activePostEffects(post))) {
+		return false;
+	}
+	post->programCount = 1;
+
+	glGenBuffers(1, &post->quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, post->quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(fullScreenTriangle), fullScreenTriangle, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	trackGpuMemory(GPU_MEMORY_BUFFERS, sizeof(fullScreenTriangle));
+	return true;
+}
+
+bool finishPostProcessGL(PostProcess* post) {
+	post->brightProgram = finishProgram(post->brightProgram);
+	post->blurProgram = finishProgram(post->blurProgram);
+	if (!post->brightProgram || !post->blurProgram || !finishPostProgram(&post->programs[0])) {
+		LOGE("Could not create post process programs");
+		return false;
+	}
+	post->brightPositionLocation = glGetAttribLocation(post->brightProgram, "position");
+	post->brightSourceLocation = glGetUniformLocation(post->brightProgram, "source");
+	post->brightTexelLocation = glGetUniformLocation(post->brightProgram, "texel");
+	post->brightThresholdLocation = glGetUniformLocation(post->brightProgram, "threshold");
+	post->blurPositionLocation = glGetAttribLocation(post->blurProgram, "position");
+	post->blurSourceLocation = glGetUniformLocation(post->blurProgram, "source");
+	post->blurStepLocation = glGetUniformLocation(post->blurProgram, "direction");
+	return true;
+}
+
+void termPostProcessGL(PostProcess* post) {
+	for (int32_t i = 0; i < post->programCount; ++i) {
+		if (post->programs[i].program) {
+			glDeleteProgram(post->programs[i].program);
+		}
+	}
+	post->programCount = 0;
+	if (post->brightProgram) {
+		glDeleteProgram(post->brightProgram);
+	}
+	if (post->blurProgram) {
+		glDeleteProgram(post->blurProgram);
+	}
+	if (post->quadBuffer) {
+		glDeleteBuffers(1, &post->quadBuffer);
+		trackGpuMemory(GPU_MEMORY_BUFFERS, -static_cast<int64_t>(sizeof(fullScreenTriangle)));
+	}
+	post->brightProgram = 0;
+	post->blurProgram = 0;
+	post->quadBuffer = 0;
+}
+
+static const PostProgram* findOrCreatePostProgram(PostProcess* post, uint32_t mask) {
+	for (int32_t i = 0; i < post->programCount; ++i) {
+		if (post->programs[i].mask == mask) {
+			return post->programs[i].program ? &post->programs[i] : NULL;
+		}
+	}
+	if (post->programCount == POST_PROCESS_MAX_PROGRAMS) {
+		return NULL;
+	}
+	// compiles on the frame the combination first appears; a failure is remembered so it isn't retried
+	LOGI("Compiling post process program for effects 0x%x", mask);
+	PostProgram* program = &post->programs[post->programCount++];
+	if (!beginPostProgram(post, program, mask) || !finishPostProgram(program)) {
+		program->mask = mask;
+		program->program = 0;
+		return NULL;
+	}
+	return program;
+}
+
+static void drawFullScreen(const PostProcess* post, GLint positionLocation) {
+	glBindBuffer(GL_ARRAY_BUFFER, post->quadBuffer);
+	glVertexAttribPointer(positionLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(positionLocation);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisableVertexAttribArray(positionLocation);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void drawBrightPass(void* data, const RenderGraph* graph, int32_t) {
+	const PostProcess* post = static_cast<const PostProcess*>(data);
+	const PostEffect* bloom = findPostEffect(post, POST_EFFECT_BLOOM);
+	const RenderTargetDesc* scene = &graph->resources[post->sceneColor].desc;
+	glUseProgram(post->brightProgram);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, renderResourceTexture(graph, post->sceneColor));
+	glUniform1i(post->brightSourceLocation, 0);
+	glUniform2f(post->brightTexelLocation, 1.0f / scene->width, 1.0f / scene->height);
+	glUniform1f(post->brightThresholdLocation, bloom->parameters[0]);
+	drawFullScreen(post, post->brightPositionLocation);
+}
+
+static void drawBlur(const PostProcess* post, const RenderGraph* graph, int32_t source, float x, float y) {
+	const RenderTargetDesc* desc = &graph->resources[source].desc;
+	glUseProgram(post->blurProgram);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, renderResourceTexture(graph, source));
+	glUniform1i(post->blurSourceLocation, 0);
+	glUniform2f(post->blurStepLocation, x / desc->width, y / desc->height);
+	drawFullScreen(post, post->blurPositionLocation);
+}
+
+static void drawBlurHorizontalPass(void* data, const RenderGraph* graph, int32_t) {
+	const PostProcess* post = static_cast<const PostProcess*>(data);
+	drawBlur(post, graph, post->bloomSource, 1.0f, 0.0f);
+}
+
+static void drawBlurVerticalPass(void* data, const RenderGraph* graph, int32_t) {
+	const PostProcess* post = static_cast<const PostProcess*>(data);
+	drawBlur(post, graph, post->bloomScratch, 0.0f, 1.0f);
+}
+
+static void drawCompositePass(void* data, const RenderGraph* graph, int32_t) {
+	PostProcess* post = static_cast<PostProcess*>(data);
+	const PostProgram* program = findOrCreatePostProgram(post, post->frameMask);
+	if (!program) {
+		return;
+	}
+	glUseProgram(program->program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, renderResourceTexture(graph, post->sceneColor));
+	glUniform1i(program->sceneLocation, 0);
+
+	const PostEffect* bloom = findPostEffect(post, POST_EFFECT_BLOOM);
+	if (program->bloomLocation >= 0) {
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, renderResourceTexture(graph, post->bloomBlurred));
+		glUniform1i(program->bloomLocation, 1);
+		glUniform1f(program->bloomStrengthLocation, bloom->strength);
+	}
+	const PostEffect* grade = findPostEffect(post, POST_EFFECT_COLOR_GRADE);
+	if (program->gradeLocation >= 0) {
+		glUniform3f(program->gradeLocation, grade->parameters[0], grade->parameters[1], grade->strength);
+	}
+	const PostEffect* vignette = findPostEffect(post, POST_EFFECT_VIGNETTE);
+	if (program->vignetteLocation >= 0) {
+		const RenderTargetDesc* scene = &graph->resources[post->sceneColor].desc;
+		glUniform4f(program->vignetteLocation, vignette->parameters[0], vignette->parameters[1], vignette->strength,
+			static_cast<float>(scene->width) / scene->height);
+	}
+	drawFullScreen(post, program->positionLocation);
+
+	if (program->bloomLocation >= 0) {
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void addPostProcessPasses(PostProcess* post, RenderGraph* graph, int32_t sceneColor, int32_t output, int32_t width, int32_t height) {
+	uint32_t mask = activePostEffects(post);
+	PostProcessStats* stats = &post->stats;
+	memset(stats, 0, sizeof(PostProcessStats));
+	post->frameMask = mask;
+	post->sceneColor = sceneColor;
+	post->bloomSource = -1;
+	post->bloomScratch = -1;
+	post->bloomBlurred = -1;
+	int64_t fullPixels = static_cast<int64_t>(width) * height;
+
+	if (mask & (1u << POST_EFFECT_BLOOM)) {
+		const PostEffect* bloom = findPostEffect(post, POST_EFFECT_BLOOM);
+		int32_t downsample = bloom->parameters[1] >= 4.0f ? 4 : 2;
+		RenderTargetDesc desc = { (width + downsample - 1) / downsample, (height + downsample - 1) / downsample, RENDER_TARGET_RGB565 };
+		post->bloomSource = createRenderResource(graph, "bloomSource", &desc);
+		post->bloomScratch = createRenderResource(graph, "bloomScratch", &desc);
+		post->bloomBlurred = createRenderResource(graph, "bloomBlurred", &desc);
+
+		int32_t pass = addRenderPass(graph, "bloomBright", drawBrightPass, post);
+		setRenderPassColor(graph, pass, post->bloomSource, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+		readRenderResource(graph, pass, sceneColor);
+		pass = addRenderPass(graph, "bloomBlurX", drawBlurHorizontalPass, post);
+		setRenderPassColor(graph, pass, post->bloomScratch, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+		readRenderResource(graph, pass, post->bloomSource);
+		pass = addRenderPass(graph, "bloomBlurY", drawBlurVerticalPass, post);
+		setRenderPassColor(graph, pass, post->bloomBlurred, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+		readRenderResource(graph, pass, post->bloomScratch);
+
+		stats->passes += 3;
+		stats->pixels += 3LL * desc.width * desc.height;
+		// bright pass, two blurs and adding it back, all at full resolution
+		stats->unfusedPasses += 4;
+		stats->unfusedPixels += 4 * fullPixels;
+	}
+	if (mask & (1u << POST_EFFECT_COLOR_GRADE)) {
+		stats->unfusedPasses += 1;
+		stats->unfusedPixels += fullPixels;
+	}
+	if (mask & (1u << POST_EFFECT_VIGNETTE)) {
+		stats->unfusedPasses += 1;
+		stats->unfusedPixels += fullPixels;
+	}
+
+	// everything per pixel, and the copy to the output, in one pass
+	int32_t pass = addRenderPass(graph, "composite", drawCompositePass, post);
+	setRenderPassColor(graph, pass, output, RENDER_DONT_CARE, 0.0f, 0.0f, 0.0f, 0.0f);
+	readRenderResource(graph, pass, sceneColor);
+	readRenderResource(graph, pass, post->bloomBlurred);
+	stats->passes += 1;
+	stats->pixels += fullPixels;
+	if (!mask) {
+		stats->unfusedPasses += 1;
+		stats->unfusedPixels += fullPixels;
+	}
+}
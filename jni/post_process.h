@@ -0,0 +1,92 @@
+#pragma once
+
+#include "render_graph.h"
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POST_PROCESS_MAX_EFFECTS 8
+#define POST_PROCESS_MAX_PROGRAMS 8
+
+enum PostEffectType {
+	POST_EFFECT_BLOOM, // parameters: threshold, downsample factor (2 or 4)
+	POST_EFFECT_COLOR_GRADE, // parameters: saturation, contrast
+	POST_EFFECT_VIGNETTE, // parameters: inner radius, outer radius (in half screen heights)
+	POST_EFFECT_TYPE_COUNT
+};
+
+struct PostEffect {
+	PostEffectType type;
+	float strength; // 0 skips the effect and every pass it needs
+	float parameters[2];
+};
+
+// A generated composite program and its uniforms; locations of effects it wasn't generated for are -1.
+struct PostProgram {
+	uint32_t mask;
+	GLuint program;
+	GLint positionLocation;
+	GLint sceneLocation;
+	GLint bloomLocation;
+	GLint bloomStrengthLocation;
+	GLint gradeLocation; // saturation, contrast, strength
+	GLint vignetteLocation; // inner radius, outer radius, strength, aspect ratio
+};
+
+struct PostProcessStats {
+	int32_t passes;
+	int64_t pixels; // fragments shaded by the passes
+	// the same chain with one full resolution pass per effect, for comparison
+	int32_t unfusedPasses;
+	int64_t unfusedPixels;
+};
+
+// Full screen effects over the scene. Everything per pixel is fused into one composite shader that is
+// generated from the chain, in chain order, for whichever effects have a non-zero strength; only bloom
+// adds passes, a bright pass and a separable blur at a fraction of the resolution. With every strength
+// at zero no passes are added and the scene can render straight to the window.
+struct PostProcess {
+	PostEffect chain[POST_PROCESS_MAX_EFFECTS];
+	int32_t count;
+	PostProcessStats stats; // of the last addPostProcessPasses
+
+	PostProgram programs[POST_PROCESS_MAX_PROGRAMS];
+	int32_t programCount;
+	GLuint brightProgram;
+	GLint brightPositionLocation;
+	GLint brightSourceLocation;
+	GLint brightTexelLocation;
+	GLint brightThresholdLocation;
+	GLuint blurProgram;
+	GLint blurPositionLocation;
+	GLint blurSourceLocation;
+	GLint blurStepLocation;
+	GLuint quadBuffer;
+
+	// the frame being declared, for the pass functions
+	uint32_t frameMask;
+	int32_t sceneColor;
+	int32_t bloomSource;
+	int32_t bloomBlurred;
+	int32_t bloomScratch;
+};
+
+// Each effect type may appear once.
+bool initPostProcess(PostProcess* post, const PostEffect* chain, int32_t count);
+void setPostEffectStrength(PostProcess* post, PostEffectType type, float strength);
+
+// Bit (1 << type) for every effect in the chain with a non-zero strength.
+uint32_t activePostEffects(const PostProcess* post);
+
+// Writes the fused composite fragment shader for the effects in mask. Returns the length, or 0 if it didn't fit.
+size_t generatePostShader(const PostProcess* post, uint32_t mask, char* buffer, size_t size);
+
+// Submits the fixed programs and the composite for the current effects; finishPostProcessGL waits for them.
+bool initPostProcessGL(PostProcess* post);
+bool finishPostProcessGL(PostProcess* post);
+void termPostProcessGL(PostProcess* post);
+
+// Declares the passes that turn sceneColor into the finished image in output and updates post->stats.
+// Needs no GL, so cost can be estimated on the host; executing the passes does.
+void addPostProcessPasses(PostProcess* post, RenderGraph* graph, int32_t sceneColor, int32_t output, int32_t width, int32_t height);
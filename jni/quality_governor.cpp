@@ -0,0 +1,185 @@
+#include "quality_governor.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const QualityGovernorConfig defaultQualityGovernorConfig = {
+	16666667, // 60 Hz
+	1.2f,
+	0.25f,
+	0.02f,
+	2000000000LL,
+	10000000000LL,
+	160000000000LL,
+	10000000000LL,
+	30000000000LL,
+	1000000000LL,
+	0.85f,
+	1.0f
+};
+
+static const char* const changeReasonNames[] = { "none", "thermal", "frames missed", "steady" };
+
+bool initQualityGovernor(QualityGovernor* governor, const QualityTier* tiers, int32_t count, const QualityGovernorConfig* config, const ThermalProvider* thermal) {
+	memset(governor, 0, sizeof(QualityGovernor));
+	if (count < 1 || count > QUALITY_MAX_TIERS) {
+		LOGE("initQualityGovernor: %d tiers, at most %d supported", count, QUALITY_MAX_TIERS);
+		return false;
+	}
+	memcpy(governor->tiers, tiers, count * sizeof(QualityTier));
+	governor->tierCount = count;
+	governor->config = *config;
+	governor->thermal = thermal;
+	governor->lastSample.status = THERMAL_STATUS_UNKNOWN;
+	governor->lastSample.headroom = -1.0f;
+	governor->thermalStatus = THERMAL_STATUS_NONE;
+	governor->upgradeDelayNanoseconds = config->upgradeDelayNanoseconds;
+	return true;
+}
+
+static void updateThermalStatus(QualityGovernor* governor, int64_t now) {
+	if (!governor->thermal || now < governor->nextThermalPollNanoseconds) {
+		return;
+	}
+	const QualityGovernorConfig* config = &governor->config;
+	governor->nextThermalPollNanoseconds = now + config->thermalPollNanoseconds;
+	ThermalSample sample;
+	if (!readThermalSample(governor->thermal, &sample)) {
+		return;
+	}
+	governor->lastSample = sample;
+
+	// the forecast lets the tier drop before the platform starts throttling
+	ThermalStatus pressure = sample.status;
+	if (sample.headroom >= config->severeHeadroom && pressure < THERMAL_STATUS_SEVERE) {
+		pressure = THERMAL_STATUS_SEVERE;
+	} else if (sample.headroom >= config->moderateHeadroom && pressure < THERMAL_STATUS_MODERATE) {
+		pressure = THERMAL_STATUS_MODERATE;
+	}
+
+	if (pressure > governor->thermalStatus) {
+		LOGI("Thermal: %s -> %s (headroom %.2f)", thermalStatusName(governor->thermalStatus), thermalStatusName(pressure), sample.headroom);
+		governor->thermalStatus = pressure;
+		governor->lowerStatusSinceNanoseconds = 0;
+	} else if (pressure < governor->thermalStatus) {
+		if (governor->lowerStatusSinceNanoseconds == 0) {
+			governor->lowerStatusSinceNanoseconds = now;
+		} else if (now - governor->lowerStatusSinceNanoseconds >= config->coolDownNanoseconds) {
+			LOGI("Thermal: %s -> %s (headroom %.2f)", thermalStatusName(governor->thermalStatus), thermalStatusName(pressure), sample.headroom);
+			governor->thermalStatus = pressure;
+			governor->lowerStatusSinceNanoseconds = 0;
+		}
+	} else {
+		governor->lowerStatusSinceNanoseconds = 0;
+	}
+
+	governor->thermalCap = governor->tierCount - 1;
+	for (int32_t i = 0; i < governor->tierCount; ++i) {
+		if (governor->tiers[i].maxThermalStatus >= governor->thermalStatus) {
+			governor->thermalCap = i;
+			break;
+		}
+	}
+}
+
+static void clearFrameWindow(QualityGovernor* governor) {
+	memset(governor->missed, 0, sizeof(governor->missed));
+	governor->frameCount = 0;
+	governor->nextFrame = 0;
+	governor->missCount = 0;
+}
+
+static void recordFrame(QualityGovernor* governor, int64_t intervalNanoseconds) {
+	const QualityTier* tier = currentQualityTier(governor);
+	float target = static_cast<float>(governor->config.refreshNanoseconds) * tier->swapInterval;
+	uint8_t missed = intervalNanoseconds > target * governor->config.missTolerance;
+	governor->missCount += missed - governor->missed[governor->nextFrame];
+	governor->missed[governor->nextFrame] = missed;
+	governor->nextFrame = (governor->nextFrame + 1) % QUALITY_FRAME_WINDOW;
+	if (governor->frameCount < QUALITY_FRAME_WINDOW) {
+		++governor->frameCount;
+	}
+}
+
+bool updateQualityGovernor(QualityGovernor* governor, int64_t nowNanoseconds, int64_t frameIntervalNanoseconds) {
+	const QualityGovernorConfig* config = &governor->config;
+	if (governor->lastUpdateNanoseconds > 0 && nowNanoseconds > governor->lastUpdateNanoseconds) {
+		governor->stats.tierNanoseconds[governor->tier] += nowNanoseconds - governor->lastUpdateNanoseconds;
+	}
+	governor->lastUpdateNanoseconds = nowNanoseconds;
+	if (governor->tierStartNanoseconds == 0) {
+		governor->tierStartNanoseconds = nowNanoseconds;
+	}
+	updateThermalStatus(governor, nowNanoseconds);
+	if (frameIntervalNanoseconds > 0) {
+		recordFrame(governor, frameIntervalNanoseconds);
+	}
+	if (governor->upgradeNanoseconds > 0 && nowNanoseconds - governor->upgradeNanoseconds >= config->probeNanoseconds) {
+		// the step up held, so the next one need not wait as long
+		governor->upgradeNanoseconds = 0;
+		governor->upgradeDelayNanoseconds = config->upgradeDelayNanoseconds;
+	}
+
+	int64_t inTier = nowNanoseconds - governor->tierStartNanoseconds;
+	bool windowFull = governor->frameCount == QUALITY_FRAME_WINDOW;
+	int32_t next = governor->tier;
+	QualityChangeReason reason = QUALITY_CHANGE_NONE;
+	if (governor->tier < governor->thermalCap) {
+		next = governor->thermalCap;
+		reason = QUALITY_CHANGE_THERMAL;
+	} else if (inTier >= config->minTierNanoseconds && governor->tier + 1 < governor->tierCount &&
+		governor->missCount >= config->degradeMissRatio * QUALITY_FRAME_WINDOW) {
+		// counted against the whole window, so a bad stretch can step down before the window fills
+		next = governor->tier + 1;
+		reason = QUALITY_CHANGE_FRAMES_MISSED;
+	} else if (windowFull && governor->tier > governor->thermalCap && inTier >= governor->upgradeDelayNanoseconds &&
+		governor->missCount <= config->upgradeMissRatio * QUALITY_FRAME_WINDOW) {
+		next = governor->tier - 1;
+		reason = QUALITY_CHANGE_STEADY;
+	}
+	if (reason == QUALITY_CHANGE_NONE) {
+		return false;
+	}
+
+	if (reason == QUALITY_CHANGE_STEADY) {
+		governor->upgradeNanoseconds = nowNanoseconds;
+	} else {
+		if (reason == QUALITY_CHANGE_FRAMES_MISSED && governor->upgradeNanoseconds > 0) {
+			++governor->stats.failedUpgrades;
+			governor->upgradeDelayNanoseconds *= 2;
+			if (governor->upgradeDelayNanoseconds > config->maxUpgradeDelayNanoseconds) {
+				governor->upgradeDelayNanoseconds = config->maxUpgradeDelayNanoseconds;
+			}
+		}
+		governor->upgradeNanoseconds = 0;
+	}
+	LOGI("Quality: %s -> %s (%s: thermal %s, %d of %d frames missed, %.1f s in tier)", governor->tiers[governor->tier].name,
+		governor->tiers[next].name, changeReasonNames[reason], thermalStatusName(governor->thermalStatus),
+		governor->missCount, governor->frameCount, inTier * 1e-9);
+	governor->tier = next;
+	governor->tierStartNanoseconds = nowNanoseconds;
+	governor->lastReason = reason;
+	++governor->stats.transitions;
+	// intervals measured against the old target say nothing about the new one
+	clearFrameWindow(governor);
+	return true;
+}
+
+void pauseQualityGovernor(QualityGovernor* governor) {
+	clearFrameWindow(governor);
+	governor->lastUpdateNanoseconds = 0;
+	governor->tierStartNanoseconds = 0;
+}
+
+void logQualityGovernor(const QualityGovernor* governor) {
+	char times[256];
+	size_t length = 0;
+	times[0] = '\0';
+	for (int32_t i = 0; i < governor->tierCount && length < sizeof(times); ++i) {
+		length += snprintf(times + length, sizeof(times) - length, "%s%s %.1f s", i > 0 ? ", " : "",
+			governor->tiers[i].name, governor->stats.tierNanoseconds[i] * 1e-9);
+	}
+	LOGI("Quality: %s, %d transitions, %d failed step ups, thermal %s; time per tier: %s", currentQualityTier(governor)->name,
+		governor->stats.transitions, governor->stats.failedUpgrades, thermalStatusName(governor->thermalStatus), times);
+}
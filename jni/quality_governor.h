@@ -0,0 +1,95 @@
+#pragma once
+
+#include "thermal_provider.h"
+
+#include <stdint.h>
+
+#define QUALITY_MAX_TIERS 8
+// frames in the rolling window the miss ratio is taken over
+#define QUALITY_FRAME_WINDOW 120
+
+// One rung of the quality ladder; tier 0 is the best.
+struct QualityTier {
+	const char* name;
+	float renderScale; // of the window size, for the scene
+	uint32_t postEffects; // bit (1 << PostEffectType) for each effect allowed to run
+	int32_t swapInterval; // vsyncs per frame, so the target frame rate is the refresh rate over this
+	ThermalStatus maxThermalStatus; // the highest status the tier may run under
+};
+
+struct QualityGovernorConfig {
+	int64_t refreshNanoseconds;
+	float missTolerance; // a frame misses when its interval is over the tier's target by this factor
+	float degradeMissRatio; // stepping down once this share of the window misses
+	float upgradeMissRatio; // stepping up is only tried below this share
+	int64_t minTierNanoseconds; // frame driven changes are at least this far apart
+	int64_t upgradeDelayNanoseconds; // on target this long before trying the tier above
+	int64_t maxUpgradeDelayNanoseconds; // the delay doubles each time a step up fails, up to this
+	int64_t probeNanoseconds; // a step up that has to step down again within this failed
+	int64_t coolDownNanoseconds; // a lower thermal status must hold this long to count
+	int64_t thermalPollNanoseconds;
+	float moderateHeadroom; // forecast headroom that counts as moderate or severe pressure
+	float severeHeadroom;
+};
+
+extern const QualityGovernorConfig defaultQualityGovernorConfig;
+
+enum QualityChangeReason {
+	QUALITY_CHANGE_NONE,
+	QUALITY_CHANGE_THERMAL,
+	QUALITY_CHANGE_FRAMES_MISSED,
+	QUALITY_CHANGE_STEADY
+};
+
+struct QualityGovernorStats {
+	int32_t transitions;
+	int32_t failedUpgrades;
+	int64_t tierNanoseconds[QUALITY_MAX_TIERS];
+};
+
+// Picks a quality tier from the device's thermal state and the frame intervals the main loop sees.
+// Thermal pressure caps the tier at once and only lifts the cap once the lower status has held for
+// the cool down. Within the cap, a window with too many missed frames steps down a tier, and a
+// long run on target steps back up; a step up that fails soon after doubles the wait for the next.
+struct QualityGovernor {
+	QualityGovernorConfig config;
+	QualityTier tiers[QUALITY_MAX_TIERS];
+	int32_t tierCount;
+	const ThermalProvider* thermal; // may be NULL
+
+	int32_t tier;
+	int64_t tierStartNanoseconds;
+	int64_t lastUpdateNanoseconds;
+	QualityChangeReason lastReason;
+
+	ThermalSample lastSample;
+	ThermalStatus thermalStatus; // with the cool down applied
+	int64_t lowerStatusSinceNanoseconds; // 0 unless a lower status is waiting out the cool down
+	int64_t nextThermalPollNanoseconds;
+	int32_t thermalCap; // the best tier thermalStatus allows
+
+	uint8_t missed[QUALITY_FRAME_WINDOW];
+	int32_t frameCount;
+	int32_t nextFrame;
+	int32_t missCount;
+
+	int64_t upgradeDelayNanoseconds;
+	int64_t upgradeNanoseconds; // when the last step up happened, 0 once it has held for the probe time
+
+	QualityGovernorStats stats;
+};
+
+// Tiers run from best to worst; thermal may be NULL, which leaves only the frame times.
+bool initQualityGovernor(QualityGovernor* governor, const QualityTier* tiers, int32_t count, const QualityGovernorConfig* config, const ThermalProvider* thermal);
+
+// Call once per presented frame with the interval since the previous one. Returns true if the tier changed.
+bool updateQualityGovernor(QualityGovernor* governor, int64_t nowNanoseconds, int64_t frameIntervalNanoseconds);
+
+// Forgets the frame window and stops the clock for time per tier, e.g. while paused.
+void pauseQualityGovernor(QualityGovernor* governor);
+
+static inline const QualityTier* currentQualityTier(const QualityGovernor* governor) {
+	return &governor->tiers[governor->tier];
+}
+
+void logQualityGovernor(const QualityGovernor* governor);
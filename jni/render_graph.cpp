@@ -0,0 +1,486 @@
+#include "render_graph.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <string.h>
+
+void initRenderGraph(RenderGraph* graph, const GLExtensions* extensions) {
+	memset(graph, 0, sizeof(RenderGraph));
+	graph->extensions = extensions;
+}
+
+static void deleteRenderTarget(RenderGraph* graph, RenderTarget* target) {
+	// framebuffers that used it can't be bound again
+	int32_t kept = 0;
+	for (int32_t i = 0; i < graph->framebufferCount; ++i) {
+		RenderFramebuffer* framebuffer = &graph->framebuffers[i];
+		if ((target->texture && framebuffer->colorTarget == target->texture) ||
+			(target->renderbuffer && framebuffer->depthTarget == target->renderbuffer)) {
+			glDeleteFramebuffers(1, &framebuffer->framebuffer);
+		} else {
+			graph->framebuffers[kept++] = *framebuffer;
+		}
+	}
+	graph->framebufferCount = kept;
+
+	if (target->texture) {
+		glDeleteTextures(1, &target->texture);
+		trackGpuMemory(GPU_MEMORY_TEXTURES, -renderTargetBytes(&target->desc));
+	}
+	if (target->renderbuffer) {
+		glDeleteRenderbuffers(1, &target->renderbuffer);
+		trackGpuMemory(GPU_MEMORY_TEXTURES, -renderTargetBytes(&target->desc));
+	}
+	memset(target, 0, sizeof(RenderTarget));
+	target->lastResource = -1;
+	target->lastPass = -1;
+}
+
+void termRenderGraphGL(RenderGraph* graph) {
+	for (int32_t i = 0; i < graph->targetCount; ++i) {
+		deleteRenderTarget(graph, &graph->targets[i]);
+	}
+	for (int32_t i = 0; i < graph->framebufferCount; ++i) {
+		glDeleteFramebuffers(1, &graph->framebuffers[i].framebuffer);
+	}
+	graph->targetCount = 0;
+	graph->framebufferCount = 0;
+	resetRenderGraph(graph);
+}
+
+void resetRenderGraph(RenderGraph* graph) {
+	graph->passCount = 0;
+	graph->resourceCount = 0;
+	graph->compiled = false;
+	memset(&graph->stats, 0, sizeof(RenderGraphStats));
+}
+
+static int32_t addRenderResource(RenderGraph* graph, const char* name, const RenderTargetDesc* desc, bool imported) {
+	if (graph->resourceCount == RENDER_GRAPH_MAX_RESOURCES) {
+		LOGE("Render graph: too many resources for %s", name);
+		return -1;
+	}
+	RenderGraphResource* resource = &graph->resources[graph->resourceCount];
+	memset(resource, 0, sizeof(RenderGraphResource));
+	resource->name = name;
+	resource->desc = *desc;
+	resource->imported = imported;
+	resource->output = imported;
+	resource->firstPass = -1;
+	resource->lastPass = -1;
+	resource->target = -1;
+	return graph->resourceCount++;
+}
+
+int32_t importRenderResource(RenderGraph* graph, const char* name, int32_t width, int32_t height) {
+	RenderTargetDesc desc = { width, height, RENDER_TARGET_RGBA8 };
+	return addRenderResource(graph, name, &desc, true);
+}
+
+int32_t createRenderResource(RenderGraph* graph, const char* name, const RenderTargetDesc* desc) {
+	return addRenderResource(graph, name, desc, false);
+}
+
+int32_t addRenderPass(RenderGraph* graph, const char* name, RenderPassFunction execute, void* data) {
+	if (graph->passCount == RENDER_GRAPH_MAX_PASSES) {
+		LOGE("Render graph: too many passes for %s", name);
+		return -1;
+	}
+	RenderGraphPass* pass = &graph->passes[graph->passCount];
+	memset(pass, 0, sizeof(RenderGraphPass));
+	pass->name = name;
+	pass->execute = execute;
+	pass->data = data;
+	pass->color.resource = -1;
+	pass->depth.resource = -1;
+	return graph->passCount++;
+}
+
+void markRenderOutput(RenderGraph* graph, int32_t resource) {
+	if (resource >= 0) {
+		graph->resources[resource].output = true;
+	}
+}
+
+void setRenderPassColor(RenderGraph* graph, int32_t pass, int32_t resource, RenderLoadOp loadOp, float r, float g, float b, float a) {
+	if (pass < 0) {
+		return;
+	}
+	RenderGraphPass* p = &graph->passes[pass];
+	p->color.resource = resource;
+	p->color.loadOp = loadOp;
+	p->clearColor[0] = r;
+	p->clearColor[1] = g;
+	p->clearColor[2] = b;
+	p->clearColor[3] = a;
+}
+
+void setRenderPassDepth(RenderGraph* graph, int32_t pass, int32_t resource, RenderLoadOp loadOp) {
+	if (pass < 0) {
+		return;
+	}
+	graph->passes[pass].depth.resource = resource;
+	graph->passes[pass].depth.loadOp = loadOp;
+}
+
+void readRenderResource(RenderGraph* graph, int32_t pass, int32_t resource) {
+	if (pass < 0 || resource < 0) {
+		return;
+	}
+	RenderGraphPass* p = &graph->passes[pass];
+	if (p->readCount == RENDER_GRAPH_MAX_PASS_READS) {
+		LOGE("Render graph: too many reads in %s", p->name);
+		return;
+	}
+	p->reads[p->readCount++] = resource;
+}
+
+void setRenderPassSideEffects(RenderGraph* graph, int32_t pass) {
+	if (pass >= 0) {
+		graph->passes[pass].sideEffects = true;
+	}
+}
+
+int64_t renderTargetBytes(const RenderTargetDesc* desc) {
+	int64_t bytesPerPixel = desc->format == RENDER_TARGET_RGBA8 ? 4 : 2;
+	return bytesPerPixel * desc->width * desc->height;
+}
+
+static bool sameDesc(const RenderTargetDesc* a, const RenderTargetDesc* b) {
+	return a->width == b->width && a->height == b->height && a->format == b->format;
+}
+
+static void useResource(RenderGraph* graph, int32_t resource, int32_t pass) {
+	RenderGraphResource* r = &graph->resources[resource];
+	if (r->firstPass < 0) {
+		r->firstPass = pass;
+	}
+	r->lastPass = pass;
+}
+
+// Walks back from the outputs: a pass survives if it writes something still needed, and an attachment
+// it clears or overwrites makes the contents earlier passes left there dead.
+static void cullRenderPasses(RenderGraph* graph) {
+	bool needed[RENDER_GRAPH_MAX_RESOURCES];
+	for (int32_t i = 0; i < graph->resourceCount; ++i) {
+		needed[i] = graph->resources[i].output;
+	}
+	for (int32_t i = graph->passCount - 1; i >= 0; --i) {
+		RenderGraphPass* pass = &graph->passes[i];
+		bool keep = pass->sideEffects ||
+			(pass->color.resource >= 0 && needed[pass->color.resource]) ||
+			(pass->depth.resource >= 0 && needed[pass->depth.resource]);
+		pass->culled = !keep;
+		if (!keep) {
+			continue;
+		}
+		if (pass->color.resource >= 0) {
+			needed[pass->color.resource] = pass->color.loadOp == RENDER_LOAD;
+		}
+		if (pass->depth.resource >= 0) {
+			needed[pass->depth.resource] = pass->depth.loadOp == RENDER_LOAD;
+		}
+		for (int32_t r = 0; r < pass->readCount; ++r) {
+			needed[pass->reads[r]] = true;
+		}
+	}
+}
+
+// A resource's previous contents only matter if it was written earlier this frame and the pass loads
+// them. Anything else starts with a clear when asked for, or when loading would read undefined memory,
+// and is discarded after its last use unless it outlives the frame.
+static void planAttachment(RenderGraph* graph, RenderPassAttachment* attachment, int32_t pass, bool* written) {
+	if (attachment->resource < 0) {
+		return;
+	}
+	const RenderGraphResource* resource = &graph->resources[attachment->resource];
+	bool fresh = !written[attachment->resource];
+	attachment->clear = attachment->loadOp == RENDER_CLEAR || (attachment->loadOp == RENDER_LOAD && fresh);
+	attachment->discard = !resource->output && !resource->imported && resource->lastPass == pass;
+	written[attachment->resource] = true;
+	graph->stats.clears += attachment->clear;
+	graph->stats.discards += attachment->discard;
+}
+
+// Greedy by first use, which packs each group of identical descriptions onto the fewest targets.
+// Targets of the right description, which usually hold GL objects already, are preferred over empty slots.
+static bool aliasRenderResources(RenderGraph* graph) {
+	for (int32_t t = 0; t < graph->targetCount; ++t) {
+		graph->targets[t].lastResource = -1;
+		graph->targets[t].lastPass = -1;
+	}
+	for (int32_t pass = 0; pass < graph->passCount; ++pass) {
+		for (int32_t i = 0; i < graph->resourceCount; ++i) {
+			RenderGraphResource* resource = &graph->resources[i];
+			if (resource->imported || resource->firstPass != pass) {
+				continue;
+			}
+			graph->stats.transientResources++;
+			graph->stats.unaliasedBytes += renderTargetBytes(&resource->desc);
+
+			int32_t match = -1;
+			int32_t empty = -1;
+			for (int32_t t = 0; t < graph->targetCount && match < 0; ++t) {
+				RenderTarget* target = &graph->targets[t];
+				if (target->lastPass >= pass) {
+					continue;
+				}
+				bool allocated = target->texture || target->renderbuffer;
+				if (sameDesc(&target->desc, &resource->desc)) {
+					match = t;
+				} else if (!allocated && target->lastResource < 0 && empty < 0) {
+					empty = t;
+				}
+			}
+			if (match < 0 && empty >= 0) {
+				match = empty;
+				graph->targets[match].desc = resource->desc;
+			}
+			if (match < 0) {
+				if (graph->targetCount == RENDER_GRAPH_MAX_TARGETS) {
+					LOGE("Render graph: out of targets for %s", resource->name);
+					return false;
+				}
+				match = graph->targetCount++;
+				memset(&graph->targets[match], 0, sizeof(RenderTarget));
+				graph->targets[match].desc = resource->desc;
+				graph->targets[match].lastResource = -1;
+			}
+			RenderTarget* target = &graph->targets[match];
+			if (target->lastResource < 0) {
+				graph->stats.targets++;
+				graph->stats.targetBytes += renderTargetBytes(&target->desc);
+			}
+			target->lastResource = i;
+			target->lastPass = resource->lastPass;
+			resource->target = match;
+		}
+	}
+	return true;
+}
+
+bool compileRenderGraph(RenderGraph* graph) {
+	memset(&graph->stats, 0, sizeof(RenderGraphStats));
+	graph->stats.passes = graph->passCount;
+	graph->compiled = false;
+	cullRenderPasses(graph);
+
+	for (int32_t i = 0; i < graph->resourceCount; ++i) {
+		graph->resources[i].firstPass = -1;
+		graph->resources[i].lastPass = -1;
+		graph->resources[i].target = -1;
+	}
+	for (int32_t i = 0; i < graph->passCount; ++i) {
+		RenderGraphPass* pass = &graph->passes[i];
+		if (pass->culled) {
+			graph->stats.culledPasses++;
+			continue;
+		}
+		if (pass->color.resource >= 0 && graph->resources[pass->color.resource].imported && pass->depth.resource >= 0) {
+			LOGE("Render graph: %s can't combine the default framebuffer with a depth target", pass->name);
+			return false;
+		}
+		if (pass->color.resource >= 0) {
+			useResource(graph, pass->color.resource, i);
+		}
+		if (pass->depth.resource >= 0) {
+			useResource(graph, pass->depth.resource, i);
+		}
+		for (int32_t r = 0; r < pass->readCount; ++r) {
+			useResource(graph, pass->reads[r], i);
+		}
+	}
+
+	if (!aliasRenderResources(graph)) {
+		return false;
+	}
+
+	bool written[RENDER_GRAPH_MAX_RESOURCES];
+	memset(written, 0, sizeof(written));
+	int32_t boundColor = -2;
+	int32_t boundDepth = -2;
+	for (int32_t i = 0; i < graph->passCount; ++i) {
+		RenderGraphPass* pass = &graph->passes[i];
+		if (pass->culled) {
+			continue;
+		}
+		planAttachment(graph, &pass->color, i, written);
+		planAttachment(graph, &pass->depth, i, written);
+		if (pass->color.resource < 0 && pass->depth.resource < 0) {
+			continue;
+		}
+
+		// the default framebuffer is -1; consecutive passes on the same targets share one bind
+		int32_t color = pass->color.resource >= 0 ? graph->resources[pass->color.resource].target : -2;
+		int32_t depth = pass->depth.resource >= 0 ? graph->resources[pass->depth.resource].target : -2;
+		pass->switchesFramebuffer = color != boundColor || depth != boundDepth;
+		graph->stats.framebufferSwitches += pass->switchesFramebuffer;
+		boundColor = color;
+		boundDepth = depth;
+	}
+	graph->compiled = true;
+	return true;
+}
+
+static bool createRenderTarget(RenderTarget* target) {
+	const RenderTargetDesc* desc = &target->desc;
+	if (desc->format == RENDER_TARGET_DEPTH16) {
+		glGenRenderbuffers(1, &target->renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, target->renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, desc->width, desc->height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	} else {
+		glGenTextures(1, &target->texture);
+		glBindTexture(GL_TEXTURE_2D, target->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (desc->format == RENDER_TARGET_RGB565) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, desc->width, desc->height, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
+		} else {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, desc->width, desc->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		LOGE("Could not create %dx%d render target, error 0x%04x", desc->width, desc->height, error);
+		return false;
+	}
+	trackGpuMemory(GPU_MEMORY_TEXTURES, renderTargetBytes(desc));
+	return true;
+}
+
+static GLuint findOrCreateFramebuffer(RenderGraph* graph, const RenderTarget* color, const RenderTarget* depth) {
+	GLuint colorName = color ? color->texture : 0;
+	GLuint depthName = depth ? depth->renderbuffer : 0;
+	for (int32_t i = 0; i < graph->framebufferCount; ++i) {
+		const RenderFramebuffer* framebuffer = &graph->framebuffers[i];
+		if (framebuffer->colorTarget == colorName && framebuffer->depthTarget == depthName) {
+			return framebuffer->framebuffer;
+		}
+	}
+	if (graph->framebufferCount == RENDER_GRAPH_MAX_FRAMEBUFFERS) {
+		// drop the oldest
+		glDeleteFramebuffers(1, &graph->framebuffers[0].framebuffer);
+		memmove(graph->framebuffers, graph->framebuffers + 1, (RENDER_GRAPH_MAX_FRAMEBUFFERS - 1) * sizeof(RenderFramebuffer));
+		--graph->framebufferCount;
+	}
+	RenderFramebuffer* framebuffer = &graph->framebuffers[graph->framebufferCount++];
+	framebuffer->colorTarget = colorName;
+	framebuffer->depthTarget = depthName;
+	glGenFramebuffers(1, &framebuffer->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->framebuffer);
+	if (colorName) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorName, 0);
+	}
+	if (depthName) {
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthName);
+	}
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		LOGE("Render graph framebuffer incomplete: 0x%04x", status);
+	}
+	return framebuffer->framebuffer;
+}
+
+void executeRenderGraph(RenderGraph* graph) {
+	if (!graph->compiled) {
+		return;
+	}
+	for (int32_t t = 0; t < graph->targetCount; ++t) {
+		RenderTarget* target = &graph->targets[t];
+		bool allocated = target->texture || target->renderbuffer;
+		if (target->lastResource < 0 && allocated) {
+			deleteRenderTarget(graph, target);
+		} else if (target->lastResource >= 0 && !allocated && !createRenderTarget(target)) {
+			return;
+		}
+	}
+
+	for (int32_t i = 0; i < graph->passCount; ++i) {
+		const RenderGraphPass* pass = &graph->passes[i];
+		if (pass->culled) {
+			continue;
+		}
+		const RenderGraphResource* color = pass->color.resource >= 0 ? &graph->resources[pass->color.resource] : NULL;
+		const RenderGraphResource* depth = pass->depth.resource >= 0 ? &graph->resources[pass->depth.resource] : NULL;
+		if (!color && !depth) {
+			if (pass->execute) {
+				pass->execute(pass->data, graph, i);
+			}
+			continue;
+		}
+		bool offscreen = !color || !color->imported;
+		if (pass->switchesFramebuffer) {
+			GLuint framebuffer = 0;
+			if (offscreen) {
+				framebuffer = findOrCreateFramebuffer(graph, color ? &graph->targets[color->target] : NULL,
+					depth ? &graph->targets[depth->target] : NULL);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		}
+		const RenderTargetDesc* size = color ? &color->desc : &depth->desc;
+		glViewport(0, 0, size->width, size->height);
+
+		GLbitfield clearMask = 0;
+		if (pass->color.clear) {
+			glClearColor(pass->clearColor[0], pass->clearColor[1], pass->clearColor[2], pass->clearColor[3]);
+			clearMask |= GL_COLOR_BUFFER_BIT;
+		}
+		if (pass->depth.clear) {
+			clearMask |= GL_DEPTH_BUFFER_BIT;
+		}
+		if (clearMask) {
+			glClear(clearMask);
+		}
+
+		if (pass->execute) {
+			pass->execute(pass->data, graph, i);
+		}
+
+		GLenum attachments[2];
+		GLsizei count = 0;
+		if (pass->color.discard) {
+			attachments[count++] = GL_COLOR_ATTACHMENT0;
+		}
+		if (pass->depth.discard) {
+			attachments[count++] = GL_DEPTH_ATTACHMENT;
+		}
+		if (count > 0 && offscreen && graph->extensions && graph->extensions->discardFramebuffer) {
+			graph->extensions->discardFramebufferEXT(GL_FRAMEBUFFER, count, attachments);
+		}
+	}
+}
+
+GLuint renderResourceTexture(const RenderGraph* graph, int32_t resource) {
+	if (resource < 0 || graph->resources[resource].target < 0) {
+		return 0;
+	}
+	return graph->targets[graph->resources[resource].target].texture;
+}
+
+static const char* resourceName(const RenderGraph* graph, int32_t resource) {
+	return resource >= 0 ? graph->resources[resource].name : "-";
+}
+
+void logRenderGraph(const RenderGraph* graph) {
+	for (int32_t i = 0; i < graph->passCount; ++i) {
+		const RenderGraphPass* pass = &graph->passes[i];
+		if (pass->culled) {
+			LOGI("  %-12s culled", pass->name);
+			continue;
+		}
+		const RenderGraphResource* color = pass->color.resource >= 0 ? &graph->resources[pass->color.resource] : NULL;
+		const RenderGraphResource* depth = pass->depth.resource >= 0 ? &graph->resources[pass->depth.resource] : NULL;
+		LOGI("  %-12s %s color %s@%d%s%s, depth %s@%d%s%s, reads %s %s", pass->name, pass->switchesFramebuffer ? "bind" : "    ",
+			resourceName(graph, pass->color.resource), color ? color->target : -1, pass->color.clear ? " clear" : "", pass->color.discard ? " discard" : "",
+			resourceName(graph, pass->depth.resource), depth ? depth->target : -1, pass->depth.clear ? " clear" : "", pass->depth.discard ? " discard" : "",
+			resourceName(graph, pass->readCount > 0 ? pass->reads[0] : -1), resourceName(graph, pass->readCount > 1 ? pass->reads[1] : -1));
+	}
+	const RenderGraphStats* stats = &graph->stats;
+	LOGI("Render graph: %d passes (%d culled), %d transient resources on %d targets, %.2f MB (%.2f MB unaliased), %d framebuffer switches, %d clears, %d discards",
+		stats->passes, stats->culledPasses, stats->transientResources, stats->targets, stats->targetBytes / (1024.0 * 1024.0),
+		stats->unaliasedBytes / (1024.0 * 1024.0), stats->framebufferSwitches, stats->clears, stats->discards);
+}
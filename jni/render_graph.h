@@ -0,0 +1,147 @@
+#pragma once
+
+#include "gl_extensions.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#define RENDER_GRAPH_MAX_PASSES 32
+#define RENDER_GRAPH_MAX_RESOURCES 32
+#define RENDER_GRAPH_MAX_PASS_READS 4
+#define RENDER_GRAPH_MAX_TARGETS 16
+#define RENDER_GRAPH_MAX_FRAMEBUFFERS 16
+
+enum RenderTargetFormat {
+	RENDER_TARGET_RGBA8, // texture
+	RENDER_TARGET_RGB565, // texture
+	RENDER_TARGET_DEPTH16 // renderbuffer, can't be read
+};
+
+struct RenderTargetDesc {
+	int32_t width;
+	int32_t height;
+	RenderTargetFormat format;
+};
+
+// What a pass needs from an attachment's previous contents.
+enum RenderLoadOp {
+	RENDER_LOAD, // keeps what earlier passes wrote
+	RENDER_CLEAR, // clears to the pass's clear value
+	RENDER_DONT_CARE // the pass overwrites every pixel
+};
+
+struct RenderGraph;
+
+typedef void (*RenderPassFunction)(void* data, const RenderGraph* graph, int32_t pass);
+
+struct RenderPassAttachment {
+	int32_t resource; // -1 if none
+	RenderLoadOp loadOp;
+	// set by compileRenderGraph
+	bool clear;
+	bool discard; // nothing later needs the contents
+};
+
+struct RenderGraphPass {
+	const char* name;
+	RenderPassFunction execute;
+	void* data;
+	RenderPassAttachment color;
+	RenderPassAttachment depth;
+	float clearColor[4];
+	int32_t reads[RENDER_GRAPH_MAX_PASS_READS];
+	int32_t readCount;
+	bool sideEffects; // kept even if nothing reads its output
+	// set by compileRenderGraph
+	bool culled;
+	bool switchesFramebuffer;
+};
+
+struct RenderGraphResource {
+	const char* name;
+	RenderTargetDesc desc;
+	bool imported; // the default framebuffer, owned by EGL
+	bool output; // needed after the frame, so never culled or discarded
+	// set by compileRenderGraph
+	int32_t firstPass; // -1 if no kept pass uses it
+	int32_t lastPass;
+	int32_t target; // index into targets, -1 if imported or unused
+};
+
+// A GL texture or renderbuffer. Targets outlive frames and are matched to resources by description.
+struct RenderTarget {
+	RenderTargetDesc desc;
+	GLuint texture;
+	GLuint renderbuffer;
+	int32_t lastResource; // the last resource aliased onto it while compiling, -1 if free this frame
+	int32_t lastPass;
+};
+
+struct RenderFramebuffer {
+	GLuint framebuffer;
+	GLuint colorTarget; // GL names, 0 for none
+	GLuint depthTarget;
+};
+
+struct RenderGraphStats {
+	int32_t passes;
+	int32_t culledPasses;
+	int32_t transientResources;
+	int32_t targets; // after aliasing
+	int64_t targetBytes;
+	int64_t unaliasedBytes; // what one target per resource would have cost
+	int32_t framebufferSwitches;
+	int32_t clears;
+	int32_t discards;
+};
+
+// A frame graph: each frame the passes are declared with the targets they render to and read from,
+// then compiled and executed. Compiling culls passes nothing needed, places transient resources onto
+// as few targets as their lifetimes allow, and works out which attachments to clear at the start of a
+// pass and discard at the end of one. It makes no GL calls and always gives the same result for the
+// same declarations. Everything lives in fixed arrays, so building a frame does not allocate.
+struct RenderGraph {
+	RenderGraphPass passes[RENDER_GRAPH_MAX_PASSES];
+	int32_t passCount;
+	RenderGraphResource resources[RENDER_GRAPH_MAX_RESOURCES];
+	int32_t resourceCount;
+	RenderTarget targets[RENDER_GRAPH_MAX_TARGETS];
+	int32_t targetCount;
+	RenderFramebuffer framebuffers[RENDER_GRAPH_MAX_FRAMEBUFFERS];
+	int32_t framebufferCount;
+	const GLExtensions* extensions;
+	bool compiled;
+	RenderGraphStats stats;
+};
+
+// extensions may be NULL if the graph is only compiled, e.g. on the host.
+void initRenderGraph(RenderGraph* graph, const GLExtensions* extensions);
+// Deletes the GL objects; call before the context goes away.
+void termRenderGraphGL(RenderGraph* graph);
+
+// Starts declaring a new frame. Targets are kept for reuse.
+void resetRenderGraph(RenderGraph* graph);
+
+// Return -1 when the graph is full.
+int32_t importRenderResource(RenderGraph* graph, const char* name, int32_t width, int32_t height);
+int32_t createRenderResource(RenderGraph* graph, const char* name, const RenderTargetDesc* desc);
+int32_t addRenderPass(RenderGraph* graph, const char* name, RenderPassFunction execute, void* data);
+
+void markRenderOutput(RenderGraph* graph, int32_t resource);
+void setRenderPassColor(RenderGraph* graph, int32_t pass, int32_t resource, RenderLoadOp loadOp, float r, float g, float b, float a);
+void setRenderPassDepth(RenderGraph* graph, int32_t pass, int32_t resource, RenderLoadOp loadOp);
+void readRenderResource(RenderGraph* graph, int32_t pass, int32_t resource);
+void setRenderPassSideEffects(RenderGraph* graph, int32_t pass);
+
+// Returns false if there are more live transient resources than targets.
+bool compileRenderGraph(RenderGraph* graph);
+
+// Creates any missing targets, deletes the ones this frame did not use and runs the kept passes.
+void executeRenderGraph(RenderGraph* graph);
+
+// The texture backing a resource, for passes to sample; 0 for imported or depth resources.
+GLuint renderResourceTexture(const RenderGraph* graph, int32_t resource);
+
+int64_t renderTargetBytes(const RenderTargetDesc* desc);
+// One line per pass with its attachments, clears and discards, then the stats.
+void logRenderGraph(const RenderGraph* graph);
@@ -0,0 +1,208 @@
+#include "scene.h"
+#include "memory_tracker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const Transform2D identityTransform = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+
+Transform2D multiplyTransforms(const Transform2D* p, const Transform2D* l) {
+	Transform2D r;
+	r.a = p->a * l->a + p->c * l->b;
+	r.b = p->b * l->a + p->d * l->b;
+	r.c = p->a * l->c + p->c * l->d;
+	r.d = p->b * l->c + p->d * l->d;
+	r.tx = p->a * l->tx + p->c * l->ty + p->tx;
+	r.ty = p->b * l->tx + p->d * l->ty + p->ty;
+	return r;
+}
+
+static Bounds2D transformBounds(const Transform2D* t, const Bounds2D* b) {
+	// transform the centre and project the half extents onto the axes
+	float cx = (b->minX + b->maxX) * 0.5f;
+	float cy = (b->minY + b->maxY) * 0.5f;
+	float hx = (b->maxX - b->minX) * 0.5f;
+	float hy = (b->maxY - b->minY) * 0.5f;
+	float wcx = t->a * cx + t->c * cy + t->tx;
+	float wcy = t->b * cx + t->d * cy + t->ty;
+	float whx = (t->a < 0 ? -t->a : t->a) * hx + (t->c < 0 ? -t->c : t->c) * hy;
+	float why = (t->b < 0 ? -t->b : t->b) * hx + (t->d < 0 ? -t->d : t->d) * hy;
+	Bounds2D r = { wcx - whx, wcy - why, wcx + whx, wcy + why };
+	return r;
+}
+
+static int32_t clampCell(int32_t v, int32_t size) {
+	return v < 0 ? 0 : (v >= size ? size - 1 : v);
+}
+
+static int32_t cellIndex(const Scene* scene, float x, float y) {
+	int32_t cx = clampCell(static_cast<int32_t>(x / scene->cellSize), scene->gridWidth);
+	int32_t cy = clampCell(static_cast<int32_t>(y / scene->cellSize), scene->gridHeight);
+	return cy * scene->gridWidth + cx;
+}
+
+static void unlinkFromCell(Scene* scene, int32_t node) {
+	int32_t cell = scene->nodeCell[node];
+	if (cell < 0) {
+		return;
+	}
+	int32_t prev = scene->cellPrev[node];
+	int32_t next = scene->cellNext[node];
+	if (prev >= 0) {
+		scene->cellNext[prev] = next;
+	} else {
+		scene->cellHead[cell] = next;
+	}
+	if (next >= 0) {
+		scene->cellPrev[next] = prev;
+	}
+	scene->nodeCell[node] = -1;
+}
+
+static void linkToCell(Scene* scene, int32_t node, int32_t cell) {
+	int32_t head = scene->cellHead[cell];
+	scene->cellPrev[node] = -1;
+	scene->cellNext[node] = head;
+	if (head >= 0) {
+		scene->cellPrev[head] = node;
+	}
+	scene->cellHead[cell] = node;
+	scene->nodeCell[node] = cell;
+}
+
+bool initScene(Scene* scene, int32_t capacity, float cellSize, int32_t gridWidth, int32_t gridHeight) {
+	memset(scene, 0, sizeof(Scene));
+	scene->parent = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(int32_t)));
+	scene->localTransform = static_cast<Transform2D*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(Transform2D)));
+	scene->worldTransform = static_cast<Transform2D*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(Transform2D)));
+	scene->localBounds = static_cast<Bounds2D*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(Bounds2D)));
+	scene->worldBounds = static_cast<Bounds2D*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(Bounds2D)));
+	scene->dirty = static_cast<uint8_t*>(MEMORY_CALLOC(MEMORY_TAG_SCENE, capacity, 1));
+	scene->cellHead = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, gridWidth * gridHeight * sizeof(int32_t)));
+	scene->cellNext = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(int32_t)));
+	scene->cellPrev = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(int32_t)));
+	scene->nodeCell = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(int32_t)));
+	scene->visible = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_SCENE, capacity * sizeof(int32_t)));
+	if (!scene->parent || !scene->localTransform || !scene->worldTransform || !scene->localBounds ||
+		!scene->worldBounds || !scene->dirty || !scene->cellHead || !scene->cellNext ||
+		!scene->cellPrev || !scene->nodeCell || !scene->visible) {
+		termScene(scene);
+		return false;
+	}
+	memset(scene->cellHead, 0xff, gridWidth * gridHeight * sizeof(int32_t));
+	scene->capacity = capacity;
+	scene->cellSize = cellSize;
+	scene->gridWidth = gridWidth;
+	scene->gridHeight = gridHeight;
+	scene->firstDirty = capacity;
+	return true;
+}
+
+void termScene(Scene* scene) {
+	MEMORY_FREE(scene->parent);
+	MEMORY_FREE(scene->localTransform);
+	MEMORY_FREE(scene->worldTransform);
+	MEMORY_FREE(scene->localBounds);
+	MEMORY_FREE(scene->worldBounds);
+	MEMORY_FREE(scene->dirty);
+	MEMORY_FREE(scene->cellHead);
+	MEMORY_FREE(scene->cellNext);
+	MEMORY_FREE(scene->cellPrev);
+	MEMORY_FREE(scene->nodeCell);
+	MEMORY_FREE(scene->visible);
+	memset(scene, 0, sizeof(Scene));
+}
+
+int32_t addSceneNode(Scene* scene, int32_t parent, const Transform2D* local, const Bounds2D* bounds) {
+	if (scene->count == scene->capacity || parent >= scene->count) {
+		return -1;
+	}
+	int32_t node = scene->count++;
+	scene->parent[node] = parent;
+	scene->localTransform[node] = *local;
+	scene->localBounds[node] = *bounds;
+	scene->nodeCell[node] = -1;
+	scene->dirty[node] = 1;
+	if (node < scene->firstDirty) {
+		scene->firstDirty = node;
+	}
+	return node;
+}
+
+void setSceneNodeTransform(Scene* scene, int32_t node, const Transform2D* local) {
+	scene->localTransform[node] = *local;
+	scene->dirty[node] = 1;
+	if (node < scene->firstDirty) {
+		scene->firstDirty = node;
+	}
+}
+
+void updateScene(Scene* scene) {
+	const int32_t* __restrict parent = scene->parent;
+	uint8_t* __restrict dirty = scene->dirty;
+	int32_t updated = 0;
+
+	// parents precede children, so a dirty parent has already set its flag when the child is reached
+	for (int32_t i = scene->firstDirty; i < scene->count; ++i) {
+		int32_t p = parent[i];
+		if (p >= 0) {
+			dirty[i] |= dirty[p];
+		}
+		if (!dirty[i]) {
+			continue;
+		}
+
+		scene->worldTransform[i] = p >= 0 ? multiplyTransforms(&scene->worldTransform[p], &scene->localTransform[i]) : scene->localTransform[i];
+		++updated;
+
+		const Bounds2D* local = &scene->localBounds[i];
+		if (local->maxX < local->minX || local->maxY < local->minY) {
+			continue;
+		}
+		Bounds2D world = transformBounds(&scene->worldTransform[i], local);
+		scene->worldBounds[i] = world;
+
+		float halfExtent = (world.maxX - world.minX) * 0.5f;
+		if ((world.maxY - world.minY) * 0.5f > halfExtent) {
+			halfExtent = (world.maxY - world.minY) * 0.5f;
+		}
+		if (halfExtent > scene->maxHalfExtent) {
+			scene->maxHalfExtent = halfExtent;
+		}
+
+		int32_t cell = cellIndex(scene, (world.minX + world.maxX) * 0.5f, (world.minY + world.maxY) * 0.5f);
+		if (cell != scene->nodeCell[i]) {
+			unlinkFromCell(scene, i);
+			linkToCell(scene, i, cell);
+		}
+	}
+
+	// flags are only cleared once all descendants have seen them
+	if (scene->firstDirty < scene->count) {
+		memset(dirty + scene->firstDirty, 0, scene->count - scene->firstDirty);
+	}
+	scene->firstDirty = scene->capacity;
+	scene->updatedCount = updated;
+}
+
+void cullScene(Scene* scene, const Bounds2D* view) {
+	// widen the query so nodes filed in a neighbouring cell but overlapping the view are found
+	float pad = scene->maxHalfExtent;
+	int32_t x0 = clampCell(static_cast<int32_t>((view->minX - pad) / scene->cellSize), scene->gridWidth);
+	int32_t y0 = clampCell(static_cast<int32_t>((view->minY - pad) / scene->cellSize), scene->gridHeight);
+	int32_t x1 = clampCell(static_cast<int32_t>((view->maxX + pad) / scene->cellSize), scene->gridWidth);
+	int32_t y1 = clampCell(static_cast<int32_t>((view->maxY + pad) / scene->cellSize), scene->gridHeight);
+
+	int32_t visibleCount = 0;
+	for (int32_t cy = y0; cy <= y1; ++cy) {
+		for (int32_t cx = x0; cx <= x1; ++cx) {
+			for (int32_t node = scene->cellHead[cy * scene->gridWidth + cx]; node >= 0; node = scene->cellNext[node]) {
+				const Bounds2D* b = &scene->worldBounds[node];
+				if (b->maxX >= view->minX && b->minX <= view->maxX && b->maxY >= view->minY && b->minY <= view->maxY) {
+					scene->visible[visibleCount++] = node;
+				}
+			}
+		}
+	}
+	scene->visibleCount = visibleCount;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+// 2D affine transform: x' = a*x + c*y + tx, y' = b*x + d*y + ty
+struct Transform2D {
+	float a, b, c, d;
+	float tx, ty;
+};
+
+struct Bounds2D {
+	float minX, minY;
+	float maxX, maxY;
+};
+
+// Nodes live in flat arrays ordered so that every parent comes before its children,
+// which lets one forward pass propagate world transforms. Culling goes through a loose
+// uniform grid: each node is filed under the cell holding its bounds centre and queries
+// are widened by the largest half extent seen, so moving a node is an O(1) relink.
+struct Scene {
+	int32_t count;
+	int32_t capacity;
+	int32_t* parent; // -1 for roots
+	Transform2D* localTransform;
+	Transform2D* worldTransform;
+	Bounds2D* localBounds;
+	Bounds2D* worldBounds;
+	uint8_t* dirty;
+	int32_t firstDirty;
+
+	float cellSize;
+	int32_t gridWidth;
+	int32_t gridHeight;
+	int32_t* cellHead;
+	int32_t* cellNext;
+	int32_t* cellPrev;
+	int32_t* nodeCell; // -1 until the node's bounds are known
+	float maxHalfExtent;
+
+	int32_t* visible;
+	int32_t visibleCount;
+	int32_t updatedCount;
+};
+
+extern const Transform2D identityTransform;
+
+// The grid covers gridWidth x gridHeight cells of cellSize from the origin; nodes outside land in the border cells.
+bool initScene(Scene* scene, int32_t capacity, float cellSize, int32_t gridWidth, int32_t gridHeight);
+void termScene(Scene* scene);
+
+// The parent must already exist. Empty bounds (max < min) make a node that is never visible, e.g. a pure group.
+int32_t addSceneNode(Scene* scene, int32_t parent, const Transform2D* local, const Bounds2D* bounds);
+void setSceneNodeTransform(Scene* scene, int32_t node, const Transform2D* local);
+
+// Recomputes world transforms and bounds of dirty nodes and their descendants.
+void updateScene(Scene* scene);
+
+// Fills scene->visible with the nodes whose world bounds overlap the view rectangle.
+void cullScene(Scene* scene, const Bounds2D* view);
+
+Transform2D multiplyTransforms(const Transform2D* parent, const Transform2D* local);
@@ -0,0 +1,195 @@
+#include "scene_renderer.h"
+#include "log.h"
+#include "memory_tracker.h"
+#include "shader_utils.h"
+#include "shaders/scene_es2.h"
+#include "shaders/scene_es3.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static const GLfloat triangleVertices[] = {
+	 0.0f,  0.5f,
+	-0.5f, -0.5f,
+	 0.5f, -0.5f
+};
+
+// the rows of a Transform2D, as the shaders take them
+struct SceneInstance {
+	float transformX[3];
+	float transformY[3];
+};
+
+// std140 layout of the Frame block
+struct FrameUniforms {
+	float screenSize[2];
+	float padding[2];
+};
+
+const GLuint frameUniformBinding = 0;
+
+static void drawSceneNodesEs2(SceneRenderer* renderer, StreamBuffer*, const Transform2D* worldTransforms,
+	const int32_t* nodes, int32_t count, int32_t screenWidth, int32_t screenHeight) {
+	if (count == 0) {
+		return;
+	}
+	glUseProgram(renderer->program);
+	glUniform2f(renderer->screenSizeLocation, screenWidth, screenHeight);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer->vertexBuffer);
+	glVertexAttribPointer(renderer->positionLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(renderer->positionLocation);
+	for (int32_t i = 0; i < count; ++i) {
+		const Transform2D* t = &worldTransforms[nodes[i]];
+		glUniform3f(renderer->transformXLocation, t->a, t->c, t->tx);
+		glUniform3f(renderer->transformYLocation, t->b, t->d, t->ty);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glDisableVertexAttribArray(renderer->positionLocation);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void drawSceneNodesEs3(SceneRenderer* renderer, StreamBuffer* stream, const Transform2D* worldTransforms,
+	const int32_t* nodes, int32_t count, int32_t screenWidth, int32_t screenHeight) {
+	if (count == 0) {
+		return;
+	}
+	const GLExtensions* gl = renderer->extensions;
+
+	// the block is shared by binding point, so it only needs uploading when the window changes size
+	if (renderer->frameUniformWidth != screenWidth || renderer->frameUniformHeight != screenHeight) {
+		FrameUniforms uniforms = { { static_cast<float>(screenWidth), static_cast<float>(screenHeight) }, { 0.0f, 0.0f } };
+		glBindBuffer(GL_UNIFORM_BUFFER, renderer->frameUniformBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		renderer->frameUniformWidth = screenWidth;
+		renderer->frameUniformHeight = screenHeight;
+	}
+
+	StreamAllocation allocation;
+	SceneInstance* instances = static_cast<SceneInstance*>(allocStream(stream, count * sizeof(SceneInstance), sizeof(float), &allocation));
+	if (instances) {
+		for (int32_t i = 0; i < count; ++i) {
+			const Transform2D* t = &worldTransforms[nodes[i]];
+			SceneInstance* instance = &instances[i];
+			instance->transformX[0] = t->a;
+			instance->transformX[1] = t->c;
+			instance->transformX[2] = t->tx;
+			instance->transformY[0] = t->b;
+			instance->transformY[1] = t->d;
+			instance->transformY[2] = t->ty;
+		}
+		commitStream(stream, &allocation);
+	}
+
+	glUseProgram(renderer->program);
+	gl->bindBufferBase(GL_UNIFORM_BUFFER, frameUniformBinding, renderer->frameUniformBuffer);
+	gl->bindVertexArray(renderer->vertexArray);
+	if (instances) {
+		// the stream's segment and offset change every frame, so only these two pointers are respecified
+		const char* base = reinterpret_cast<const char*>(allocation.offset);
+		glVertexAttribPointer(renderer->transformXLocation, 3, GL_FLOAT, GL_FALSE, sizeof(SceneInstance), base + offsetof(SceneInstance, transformX));
+		glVertexAttribPointer(renderer->transformYLocation, 3, GL_FLOAT, GL_FALSE, sizeof(SceneInstance), base + offsetof(SceneInstance, transformY));
+		gl->drawArraysInstanced(GL_TRIANGLES, 0, 3, count);
+	} else {
+		// doesn't fit this frame's segment: feed the transforms as constant attributes instead
+		glDisableVertexAttribArray(renderer->transformXLocation);
+		glDisableVertexAttribArray(renderer->transformYLocation);
+		for (int32_t i = 0; i < count; ++i) {
+			const Transform2D* t = &worldTransforms[nodes[i]];
+			glVertexAttrib3f(renderer->transformXLocation, t->a, t->c, t->tx);
+			glVertexAttrib3f(renderer->transformYLocation, t->b, t->d, t->ty);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		glEnableVertexAttribArray(renderer->transformXLocation);
+		glEnableVertexAttribArray(renderer->transformYLocation);
+	}
+	gl->bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool initSceneRendererGL(SceneRenderer* renderer, const GLExtensions* extensions) {
+	memset(renderer, 0, sizeof(SceneRenderer));
+	renderer->extensions = extensions;
+	renderer->apiVersion = extensions->es3 ? 3 : 2;
+	renderer->draw = extensions->es3 ? drawSceneNodesEs3 : drawSceneNodesEs2;
+	renderer->program = extensions->es3 ? beginProgram(sceneEs3VertexShader, sceneEs3FragmentShader) : beginProgram(sceneEs2VertexShader, sceneEs2FragmentShader);
+	if (!renderer->program) {
+		return false;
+	}
+
+	glGenBuffers(1, &renderer->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	trackGpuMemory(GPU_MEMORY_BUFFERS, sizeof(triangleVertices));
+
+	if (extensions->es3) {
+		glGenBuffers(1, &renderer->frameUniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, renderer->frameUniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		trackGpuMemory(GPU_MEMORY_BUFFERS, sizeof(FrameUniforms));
+		renderer->frameUniformWidth = -1;
+		renderer->frameUniformHeight = -1;
+	}
+	LOGI("Scene renderer: OpenGL ES %d.0 backend", renderer->apiVersion);
+	return true;
+}
+
+bool finishSceneRendererGL(SceneRenderer* renderer) {
+	GLuint program = finishProgram(renderer->program);
+	if (!program) {
+		LOGE("Could not create scene program");
+		renderer->program = 0;
+		return false;
+	}
+	renderer->positionLocation = glGetAttribLocation(program, "position");
+	if (renderer->apiVersion == 2) {
+		renderer->transformXLocation = glGetUniformLocation(program, "transformX");
+		renderer->transformYLocation = glGetUniformLocation(program, "transformY");
+		renderer->screenSizeLocation = glGetUniformLocation(program, "screenSize");
+		return true;
+	}
+
+	const GLExtensions* gl = renderer->extensions;
+	renderer->transformXLocation = glGetAttribLocation(program, "transformX");
+	renderer->transformYLocation = glGetAttribLocation(program, "transformY");
+	GLuint frameBlock = gl->getUniformBlockIndex(program, "Frame");
+	if (frameBlock == GL_INVALID_INDEX || renderer->positionLocation < 0 || renderer->transformXLocation < 0 || renderer->transformYLocation < 0) {
+		LOGE("Scene program is missing inputs");
+		return false;
+	}
+	gl->uniformBlockBinding(program, frameBlock, frameUniformBinding);
+
+	// everything but the per-instance pointers is recorded once
+	gl->genVertexArrays(1, &renderer->vertexArray);
+	gl->bindVertexArray(renderer->vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer->vertexBuffer);
+	glVertexAttribPointer(renderer->positionLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(renderer->positionLocation);
+	glEnableVertexAttribArray(renderer->transformXLocation);
+	glEnableVertexAttribArray(renderer->transformYLocation);
+	gl->vertexAttribDivisor(renderer->transformXLocation, 1);
+	gl->vertexAttribDivisor(renderer->transformYLocation, 1);
+	gl->bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void termSceneRendererGL(SceneRenderer* renderer) {
+	if (renderer->vertexArray) {
+		renderer->extensions->deleteVertexArrays(1, &renderer->vertexArray);
+	}
+	if (renderer->frameUniformBuffer) {
+		glDeleteBuffers(1, &renderer->frameUniformBuffer);
+		trackGpuMemory(GPU_MEMORY_BUFFERS, -static_cast<int64_t>(sizeof(FrameUniforms)));
+	}
+	if (renderer->vertexBuffer) {
+		glDeleteBuffers(1, &renderer->vertexBuffer);
+		trackGpuMemory(GPU_MEMORY_BUFFERS, -static_cast<int64_t>(sizeof(triangleVertices)));
+	}
+	if (renderer->program) {
+		glDeleteProgram(renderer->program);
+	}
+	memset(renderer, 0, sizeof(SceneRenderer));
+}
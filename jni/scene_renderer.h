@@ -0,0 +1,46 @@
+#pragma once
+
+#include "gl_extensions.h"
+#include "scene.h"
+#include "stream_buffer.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+struct SceneRenderer;
+
+typedef void (*DrawSceneNodesFunction)(SceneRenderer* renderer, StreamBuffer* stream, const Transform2D* worldTransforms,
+	const int32_t* nodes, int32_t count, int32_t screenWidth, int32_t screenHeight);
+
+// Draws scene nodes as the triangle mesh. The backend is picked once per context: on OpenGL ES 3.0
+// the mesh lives in a vertex array object, the screen size in a uniform buffer and every node goes
+// out in one instanced draw with its transform streamed as per-instance attributes; on 2.0 each node
+// sets two uniforms and draws. Drawing calls straight into the chosen backend, there is no per-draw
+// check of the API version.
+struct SceneRenderer {
+	int32_t apiVersion; // 2 or 3
+	const GLExtensions* extensions;
+	DrawSceneNodesFunction draw;
+	GLuint program;
+	GLuint vertexBuffer;
+	GLint positionLocation;
+	GLint transformXLocation; // uniforms on 2.0, per-instance attributes on 3.0
+	GLint transformYLocation;
+	GLint screenSizeLocation; // 2.0 only
+	GLuint vertexArray; // 3.0 only
+	GLuint frameUniformBuffer; // 3.0 only
+	int32_t frameUniformWidth;
+	int32_t frameUniformHeight;
+};
+
+// Uses the ES3 backend if extensions->es3 is set. As with the other renderers the program is only
+// submitted for compilation until finishSceneRendererGL, which must be called before drawing.
+bool initSceneRendererGL(SceneRenderer* renderer, const GLExtensions* extensions);
+bool finishSceneRendererGL(SceneRenderer* renderer);
+void termSceneRendererGL(SceneRenderer* renderer);
+
+// nodes index worldTransforms; an ES3 frame whose instances don't fit the stream falls back to one draw per node.
+inline void drawSceneNodes(SceneRenderer* renderer, StreamBuffer* stream, const Transform2D* worldTransforms,
+	const int32_t* nodes, int32_t count, int32_t screenWidth, int32_t screenHeight) {
+	renderer->draw(renderer, stream, worldTransforms, nodes, count, screenWidth, screenHeight);
+}
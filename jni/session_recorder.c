@@ -0,0 +1,226 @@
+#include "session_recorder.h"
+#include "log.h"
+
+#include <string.h>
+
+static const char sessionMagic[4] = { 'S', 'R', 'E', 'C' };
+
+static void writeVarint(FILE* file, uint64_t value) {
+	uint8_t bytes[10];
+	int32_t count = 0;
+	do {
+		bytes[count] = (uint8_t)(value & 0x7f);
+		value >>= 7;
+		if (value) {
+			bytes[count] |= 0x80;
+		}
+		++count;
+	} while (value);
+	fwrite(bytes, 1, count, file);
+}
+
+static void writeSigned(FILE* file, int64_t value) {
+	writeVarint(file, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void writeFloat(FILE* file, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint8_t bytes[4] = { (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24) };
+	fwrite(bytes, 1, 4, file);
+}
+
+static bool readVarint(FILE* file, uint64_t* value) {
+	*value = 0;
+	for (int32_t shift = 0; shift < 64; shift += 7) {
+		int c = fgetc(file);
+		if (c == EOF) {
+			return false;
+		}
+		*value |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool readSigned(FILE* file, int64_t* value) {
+	uint64_t zigzag;
+	if (!readVarint(file, &zigzag)) {
+		return false;
+	}
+	*value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+	return true;
+}
+
+static bool readInt(FILE* file, int32_t* value) {
+	int64_t wide;
+	if (!readSigned(file, &wide)) {
+		return false;
+	}
+	*value = (int32_t)wide;
+	return true;
+}
+
+static bool readFloat(FILE* file, float* value) {
+	uint8_t bytes[4];
+	if (fread(bytes, 1, 4, file) != 4) {
+		return false;
+	}
+	uint32_t bits = bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+	memcpy(value, &bits, sizeof(bits));
+	return true;
+}
+
+bool beginSessionRecording(struct SessionRecorder* recorder, FILE* file) {
+	memset(recorder, 0, sizeof(struct SessionRecorder));
+	recorder->file = file;
+	if (!file) {
+		recorder->failed = true;
+		return false;
+	}
+	fwrite(sessionMagic, 1, sizeof(sessionMagic), file);
+	fputc(SESSION_RECORD_VERSION, file);
+	return !ferror(file);
+}
+
+void recordSession(struct SessionRecorder* recorder, const struct SessionRecord* record) {
+	FILE* file = recorder->file;
+	if (!file || recorder->failed) {
+		return;
+	}
+	int64_t micros = (record->nanoseconds - recorder->previousNanoseconds) / 1000;
+	if (micros < 0) {
+		micros = 0;
+	}
+	// keep the rounding from drifting over a long session
+	recorder->previousNanoseconds += micros * 1000;
+
+	fputc(record->type, file);
+	writeVarint(file, (uint64_t)micros);
+	if (record->type == SESSION_RECORD_COMMAND) {
+		writeSigned(file, record->command);
+		writeSigned(file, record->width);
+		writeSigned(file, record->height);
+		fputc(record->inputQueue ? 1 : 0, file);
+		fflush(file);
+	} else if (record->type == SESSION_RECORD_KEY) {
+		writeSigned(file, record->keyCode);
+		writeSigned(file, record->action);
+		writeSigned(file, record->eventNanoseconds / 1000);
+	} else {
+		int32_t pointerCount = record->pointerCount < SESSION_MAX_POINTERS ? record->pointerCount : SESSION_MAX_POINTERS;
+		int32_t historySize = record->historySize < SESSION_MAX_HISTORY ? record->historySize : SESSION_MAX_HISTORY;
+		writeSigned(file, record->action);
+		writeSigned(file, record->eventNanoseconds / 1000);
+		fputc(pointerCount, file);
+		fputc(historySize, file);
+		for (int32_t i = 0; i < pointerCount; ++i) {
+			writeSigned(file, record->pointers[i].id);
+			writeFloat(file, record->pointers[i].x);
+			writeFloat(file, record->pointers[i].y);
+		}
+		for (int32_t h = 0; h < historySize; ++h) {
+			writeSigned(file, record->historyNanoseconds[h] / 1000);
+			for (int32_t i = 0; i < pointerCount; ++i) {
+				writeFloat(file, record->historyX[h][i]);
+				writeFloat(file, record->historyY[h][i]);
+			}
+		}
+	}
+	if (ferror(file)) {
+		LOGW("Session recording failed after %u records", recorder->records);
+		recorder->failed = true;
+		return;
+	}
+	recorder->records++;
+}
+
+bool endSessionRecording(struct SessionRecorder* recorder) {
+	if (!recorder->file) {
+		return false;
+	}
+	bool succeeded = fclose(recorder->file) == 0 && !recorder->failed;
+	recorder->file = NULL;
+	return succeeded;
+}
+
+bool openSessionReader(struct SessionReader* reader, FILE* file) {
+	memset(reader, 0, sizeof(struct SessionReader));
+	reader->file = file;
+	char magic[4];
+	if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, sessionMagic, sizeof(magic)) != 0) {
+		LOGE("Not a session recording");
+		return false;
+	}
+	int version = fgetc(file);
+	if (version != SESSION_RECORD_VERSION) {
+		LOGE("Session recording version %d, expected %d", version, SESSION_RECORD_VERSION);
+		return false;
+	}
+	return true;
+}
+
+bool readSessionRecord(struct SessionReader* reader, struct SessionRecord* record) {
+	FILE* file = reader->file;
+	int type = fgetc(file);
+	if (type == EOF) {
+		return false;
+	}
+	memset(record, 0, sizeof(struct SessionRecord));
+	record->type = type;
+	uint64_t micros;
+	if (!readVarint(file, &micros)) {
+		return false;
+	}
+	reader->nanoseconds += (int64_t)micros * 1000;
+	record->nanoseconds = reader->nanoseconds;
+
+	int64_t relative;
+	if (type == SESSION_RECORD_COMMAND) {
+		int flag;
+		if (!readInt(file, &record->command) || !readInt(file, &record->width) || !readInt(file, &record->height) ||
+			(flag = fgetc(file)) == EOF) {
+			return false;
+		}
+		record->inputQueue = flag != 0;
+	} else if (type == SESSION_RECORD_KEY) {
+		if (!readInt(file, &record->keyCode) || !readInt(file, &record->action) || !readSigned(file, &relative)) {
+			return false;
+		}
+		record->eventNanoseconds = relative * 1000;
+	} else if (type == SESSION_RECORD_MOTION) {
+		if (!readInt(file, &record->action) || !readSigned(file, &relative)) {
+			return false;
+		}
+		record->eventNanoseconds = relative * 1000;
+		record->pointerCount = fgetc(file);
+		record->historySize = fgetc(file);
+		if (record->pointerCount < 0 || record->pointerCount > SESSION_MAX_POINTERS ||
+			record->historySize < 0 || record->historySize > SESSION_MAX_HISTORY) {
+			return false;
+		}
+		for (int32_t i = 0; i < record->pointerCount; ++i) {
+			if (!readInt(file, &record->pointers[i].id) || !readFloat(file, &record->pointers[i].x) || !readFloat(file, &record->pointers[i].y)) {
+				return false;
+			}
+		}
+		for (int32_t h = 0; h < record->historySize; ++h) {
+			if (!readSigned(file, &relative)) {
+				return false;
+			}
+			record->historyNanoseconds[h] = relative * 1000;
+			for (int32_t i = 0; i < record->pointerCount; ++i) {
+				if (!readFloat(file, &record->historyX[h][i]) || !readFloat(file, &record->historyY[h][i])) {
+					return false;
+				}
+			}
+		}
+	} else {
+		LOGE("Unknown session record type %d after %u records", type, reader->records);
+		return false;
+	}
+	reader->records++;
+	return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// Records the lifecycle commands and input events the glue processes, with their timings, to a
+// compact binary file that host/session_replay.cpp feeds back into android_main. The glue
+// records when built with -DSESSION_RECORD; everything else here is plain C for the host.
+//
+// A file is a header ("SREC" and a version byte) followed by records. Each record is a type byte
+// and the time since the previous record in microseconds as a varint, then its payload: varints
+// for integers, zigzag varints for times relative to the record, little-endian floats for
+// coordinates.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SESSION_RECORD_VERSION 1
+#define SESSION_MAX_POINTERS 10
+#define SESSION_MAX_HISTORY 16
+
+enum SessionRecordType {
+	SESSION_RECORD_COMMAND = 1,
+	SESSION_RECORD_MOTION = 2,
+	SESSION_RECORD_KEY = 3
+};
+
+struct SessionPointer {
+	int32_t id;
+	float x;
+	float y;
+};
+
+struct SessionRecord {
+	int32_t type;
+	int64_t nanoseconds; // since the recording began, when the main thread processed it
+
+	// commands
+	int32_t command; // APP_CMD_*
+	int32_t width; // of the window once the command has run, 0 without one
+	int32_t height;
+	bool inputQueue; // whether there is an input queue once the command has run
+
+	// input events
+	int32_t action;
+	int32_t keyCode;
+	int64_t eventNanoseconds; // event time relative to nanoseconds, usually negative
+	int32_t pointerCount;
+	struct SessionPointer pointers[SESSION_MAX_POINTERS];
+	int32_t historySize; // the newest samples batched into the event, oldest first
+	int64_t historyNanoseconds[SESSION_MAX_HISTORY]; // relative to nanoseconds
+	float historyX[SESSION_MAX_HISTORY][SESSION_MAX_POINTERS];
+	float historyY[SESSION_MAX_HISTORY][SESSION_MAX_POINTERS];
+};
+
+struct SessionRecorder {
+	FILE* file;
+	int64_t previousNanoseconds;
+	uint32_t records;
+	bool failed;
+};
+
+struct SessionReader {
+	FILE* file;
+	int64_t nanoseconds;
+	uint32_t records;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Takes ownership of file and writes the header.
+bool beginSessionRecording(struct SessionRecorder* recorder, FILE* file);
+// Records must come in time order. Commands are flushed straight away, since the process can be
+// killed at any point after it stops; input is left to the stdio buffer.
+void recordSession(struct SessionRecorder* recorder, const struct SessionRecord* record);
+// Closes the file; false if anything failed to write.
+bool endSessionRecording(struct SessionRecorder* recorder);
+
+// Reads the header; the file stays owned by the caller.
+bool openSessionReader(struct SessionReader* reader, FILE* file);
+// False at the end of the file or on a malformed record.
+bool readSessionRecord(struct SessionReader* reader, struct SessionRecord* record);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,64 +1,68 @@
 #include "shader_utils.h"
 #include "log.h"
+#include "memory_tracker.h"
 
 #include <stdlib.h>
 
-GLuint compileShader(GLenum type, const char* source) {
-	GLuint shader = glCreateShader(type);
-	if (!shader) {
-		return 0;
-	}
-
-	glShaderSource(shader, 1, &source, NULL);
-	glCompileShader(shader);
+static void logShaderInfo(GLuint shader) {
 	GLint compileStatus;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
-
 	if (compileStatus == GL_TRUE) {
-		return shader;
+		return;
 	}
 
+	GLint type = 0;
 	GLint infoLogLength = 0;
+	glGetShaderiv(shader, GL_SHADER_TYPE, &type);
 	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
 	if (infoLogLength) {
-		char* infoLog = malloc(infoLogLength);
+		char* infoLog = MEMORY_ALLOC(MEMORY_TAG_SHADERS, infoLogLength);
 		if (infoLog) {
 			glGetShaderInfoLog(shader, infoLogLength, NULL, infoLog);
 			LOGE("Could not compile shader %d:\n%s", type, infoLog);
-			free(infoLog);
+			MEMORY_FREE(infoLog);
 		}
-		glDeleteShader(shader);
 	}
-	return 0;
 }
 
-GLuint createProgram(const char* vertexSource, const char* fragmentSource) {
-	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-	if (!vertexShader) {
-		return 0;
-	}
-
-	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-	if (!fragmentShader) {
-		return 0;
-	}
-
+GLuint beginProgram(const char* vertexSource, const char* fragmentSource) {
 	GLuint program = glCreateProgram();
 	if (!program) {
 		return 0;
 	}
 
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	const char* sources[2] = { vertexSource, fragmentSource };
+	for (int i = 0; i < 2; ++i) {
+		GLuint shader = glCreateShader(types[i]);
+		if (!shader) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		glShaderSource(shader, 1, &sources[i], NULL);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		// flagged for deletion, freed once detached in finishProgram
+		glDeleteShader(shader);
+	}
 	glLinkProgram(program);
+	return program;
+}
 
-	glDetachShader(program, vertexShader);
-	glDetachShader(program, fragmentShader);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-
+GLuint finishProgram(GLuint program) {
 	GLint linkStatus;
 	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+
+	GLuint shaders[2];
+	GLsizei shaderCount = 0;
+	glGetAttachedShaders(program, 2, &shaderCount, shaders);
+	for (GLsizei i = 0; i < shaderCount; ++i) {
+		if (linkStatus != GL_TRUE) {
+			logShaderInfo(shaders[i]);
+		}
+		glDetachShader(program, shaders[i]);
+	}
+
 	if (linkStatus == GL_TRUE) {
 		return program;
 	}
@@ -66,13 +70,18 @@ GLuint createProgram(const char* vertexSource, const char* fragmentSource) {
 	GLint infoLogLength = 0;
 	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
 	if (infoLogLength) {
-		char* infoLog = malloc(infoLogLength);
+		char* infoLog = MEMORY_ALLOC(MEMORY_TAG_SHADERS, infoLogLength);
 		if (infoLog) {
 			glGetProgramInfoLog(program, infoLogLength, NULL, infoLog);
 			LOGE("Could not link program:\n%s", infoLog);
-			free(infoLog);
+			MEMORY_FREE(infoLog);
 		}
 	}
 	glDeleteProgram(program);
 	return 0;
 }
+
+GLuint createProgram(const char* vertexSource, const char* fragmentSource) {
+	GLuint program = beginProgram(vertexSource, fragmentSource);
+	return program ? finishProgram(program) : 0;
+}
@@ -8,6 +8,13 @@ extern "C" {
 
 GLuint createProgram(const char* vertexSource, const char* fragmentSource);
 
+// Two phase creation: beginProgram compiles and links without querying any status, so a driver
+// can work on several programs at once (GL_KHR_parallel_shader_compile, or deferred compilation)
+// while the caller does other setup. finishProgram blocks until linked and returns the program,
+// or 0 after logging the errors.
+GLuint beginProgram(const char* vertexSource, const char* fragmentSource);
+GLuint finishProgram(GLuint program);
+
 #ifdef __cplusplus
 }
 #endif
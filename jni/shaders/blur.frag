@@ -0,0 +1,24 @@
+precision mediump float;
+
+// 9 tap Gaussian in 5 bilinear taps along direction. The weights are the middle of binomial row 12
+// (924, 792, 495, 220, 66) over their sum; each pair of outer taps is merged into one placed at
+// their weighted centre.
+varying vec2 uv;
+uniform sampler2D source;
+uniform vec2 direction; // one texel along the blur axis
+
+#define WEIGHT_SUM 4070.0
+const float centerWeight = 924.0 / WEIGHT_SUM;
+const float nearWeight = (792.0 + 495.0) / WEIGHT_SUM;
+const float farWeight = (220.0 + 66.0) / WEIGHT_SUM;
+const float nearOffset = (1.0 * 792.0 + 2.0 * 495.0) / (792.0 + 495.0);
+const float farOffset = (3.0 * 220.0 + 4.0 * 66.0) / (220.0 + 66.0);
+
+void main() {
+	vec2 near = direction * nearOffset;
+	vec2 far = direction * farOffset;
+	vec3 c = texture2D(source, uv).rgb * centerWeight;
+	c += (texture2D(source, uv + near).rgb + texture2D(source, uv - near).rgb) * nearWeight;
+	c += (texture2D(source, uv + far).rgb + texture2D(source, uv - far).rgb) * farWeight;
+	gl_FragColor = vec4(c, 1.0);
+}
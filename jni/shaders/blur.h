@@ -0,0 +1,12 @@
+// Generated by tools/shader_tool.cpp from blur.frag; do not edit.
+// input hash 0x2f517f25d9aad3b7
+
+#pragma once
+
+#define BLUR_SOURCE_HASH 0xfba63906aa204805ull
+
+static const char blurFragmentShader[] =
+	"precision mediump float;varying vec2 uv;uniform sampler2D source;uniform vec2 direction;"
+	"void main(){vec2 a=direction*1.3846154;vec2 b=direction*3.2307692;lowp vec3 c=texture2D(source,uv).rgb*.22702703;"
+	"c+=(texture2D(source,uv+a).rgb+texture2D(source,uv-a).rgb)*.31621622;c+=(texture2D(source,uv+b).rgb+texture2D(source,uv-b).rgb)*.07027027;"
+	"gl_FragColor=vec4(c,1.);}\n";
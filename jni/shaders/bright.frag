@@ -0,0 +1,18 @@
+precision mediump float;
+
+// Averages 4x4 source pixels with four bilinear taps, then keeps only what is brighter than the
+// threshold.
+varying vec2 uv;
+uniform sampler2D source;
+uniform vec2 texel;
+uniform float threshold;
+
+const float tapWeight = 1.0 / 4.0;
+
+void main() {
+	vec3 c = texture2D(source, uv + vec2(-texel.x, -texel.y)).rgb;
+	c += texture2D(source, uv + vec2(texel.x, -texel.y)).rgb;
+	c += texture2D(source, uv + vec2(-texel.x, texel.y)).rgb;
+	c += texture2D(source, uv + vec2(texel.x, texel.y)).rgb;
+	gl_FragColor = vec4(max(c * tapWeight - vec3(threshold), vec3(0.0)), 1.0);
+}
@@ -0,0 +1,12 @@
+// Generated by tools/shader_tool.cpp from bright.frag; do not edit.
+// input hash 0x333654a5874b2367
+
+#pragma once
+
+#define BRIGHT_SOURCE_HASH 0x1983f378cadf809bull
+
+static const char brightFragmentShader[] =
+	"precision mediump float;varying vec2 uv;uniform sampler2D source;uniform vec2 texel;"
+	"uniform float threshold;void main(){vec3 a=texture2D(source,uv+vec2(-texel.x,-texel.y)).rgb;"
+	"a+=texture2D(source,uv+vec2(texel.x,-texel.y)).rgb;a+=texture2D(source,uv+vec2(-texel.x,texel.y)).rgb;"
+	"a+=texture2D(source,uv+vec2(texel.x,texel.y)).rgb;gl_FragColor=vec4(max(a*.25-vec3(threshold),vec3(0.)),1.);}\n";
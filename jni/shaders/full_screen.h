@@ -0,0 +1,9 @@
+// Generated by tools/shader_tool.cpp from full_screen.vert; do not edit.
+// input hash 0x3a942685f35a8871
+
+#pragma once
+
+#define FULL_SCREEN_SOURCE_HASH 0x893eb8c238cd9248ull
+
+static const char fullScreenVertexShader[] =
+	"attribute vec2 position;varying vec2 uv;void main(){uv=position*.5+vec2(.5);gl_Position=vec4(position,0.,1.);}\n";
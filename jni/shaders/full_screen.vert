@@ -0,0 +1,8 @@
+// A triangle strip quad covering the viewport, with texture coordinates over the whole target.
+attribute vec2 position; // range: -1 1
+varying vec2 uv;
+
+void main() {
+	uv = position * 0.5 + vec2(0.5);
+	gl_Position = vec4(position, 0.0, 1.0);
+}
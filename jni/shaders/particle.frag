@@ -0,0 +1,16 @@
+precision mediump float;
+
+varying float vLife;
+
+// a soft disc, fading to transparent at the sprite's edge
+const float falloff = 4.0;
+// fades from orange to yellow over the particle's life
+const vec3 youngColor = vec3(1.0, 1.0, 0.2);
+const float oldGreen = 0.6;
+
+void main() {
+	vec2 d = gl_PointCoord - vec2(0.5);
+	float a = clamp(1.0 - dot(d, d) * falloff, 0.0, 1.0);
+	float green = oldGreen + (youngColor.g - oldGreen) * vLife;
+	gl_FragColor = vec4(youngColor.r, green, youngColor.b, a * vLife);
+}
@@ -0,0 +1,15 @@
+// Generated by tools/shader_tool.cpp from particle.vert and particle.frag; do not edit.
+// input hash 0xad4490e931f68218
+
+#pragma once
+
+#define PARTICLE_SOURCE_HASH 0x03152597141442ffull
+
+static const char particleVertexShader[] =
+	"attribute vec2 position;attribute float life;uniform vec2 screenSize;uniform float pointSize;"
+	"varying lowp float vLife;void main(){vLife=life;gl_PointSize=pointSize*(.5+.5*life);"
+	"gl_Position=vec4(position.x/screenSize.x*2.-1.,1.-position.y/screenSize.y*2.,0.,1.);}\n";
+
+static const char particleFragmentShader[] =
+	"precision mediump float;varying lowp float vLife;void main(){lowp vec2 a=gl_PointCoord-vec2(.5);"
+	"lowp float c=clamp(1.-dot(a,a)*4.,0.,1.);lowp float d=.6+.4*vLife;gl_FragColor=vec4(1.,d,.2,c*vLife);}\n";
@@ -0,0 +1,14 @@
+// Point sprites in window pixels (y down) that shrink to half size as their life runs out.
+attribute vec2 position;
+attribute float life; // range: 0 1
+uniform vec2 screenSize;
+uniform float pointSize;
+varying float vLife;
+
+const float minimumScale = 0.5;
+
+void main() {
+	vLife = life;
+	gl_PointSize = pointSize * (minimumScale + (1.0 - minimumScale) * life);
+	gl_Position = vec4(position.x / screenSize.x * 2.0 - 1.0, 1.0 - position.y / screenSize.y * 2.0, 0.0, 1.0);
+}
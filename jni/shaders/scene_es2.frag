@@ -0,0 +1,7 @@
+precision mediump float;
+
+varying vec3 color;
+
+void main() {
+	gl_FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,14 @@
+// Generated by tools/shader_tool.cpp from scene_es2.vert and scene_es2.frag; do not edit.
+// input hash 0xc1391fc36f266fa3
+
+#pragma once
+
+#define SCENE_ES2_SOURCE_HASH 0xc73cd744be80a65eull
+
+static const char sceneEs2VertexShader[] =
+	"attribute vec4 position;uniform vec3 transformX;uniform vec3 transformY;uniform vec2 screenSize;"
+	"varying lowp vec3 color;void main(){color=position.xyz*.5+vec3(.5);vec3 a=vec3(position.xy,1.);"
+	"vec2 b=vec2(dot(transformX,a),dot(transformY,a));gl_Position=vec4(b.x/screenSize.x*2.-1.,1.-b.y/screenSize.y*2.,0.,1.);}\n";
+
+static const char sceneEs2FragmentShader[] =
+	"precision mediump float;varying lowp vec3 color;void main(){gl_FragColor=vec4(color,1.);}\n";
@@ -0,0 +1,17 @@
+// Scene nodes: each node's 2D world transform places the shared triangle in window pixels
+// (y down), which are then mapped to clip space.
+attribute vec4 position; // range: -1 1
+uniform vec3 transformX; // rows of the world transform
+uniform vec3 transformY;
+uniform vec2 screenSize;
+varying vec3 color;
+
+// the triangle's corners double as its colours
+const float colorScale = 0.5;
+
+void main() {
+	color = position.xyz * colorScale + vec3(colorScale);
+	vec3 p = vec3(position.xy, 1.0);
+	vec2 pixel = vec2(dot(transformX, p), dot(transformY, p));
+	gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+}
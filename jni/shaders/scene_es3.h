@@ -0,0 +1,16 @@
+// Generated by tools/shader_tool.cpp from scene_es3.vert and scene_es3.frag; do not edit.
+// input hash 0xcd82d58f8a9ae017
+
+#pragma once
+
+#define SCENE_ES3_SOURCE_HASH 0x10d042d6c3cb456full
+
+static const char sceneEs3VertexShader[] =
+	"#version 300 es\n"
+	"in vec4 position;in vec3 transformX;in vec3 transformY;layout(std140)uniform Frame{"
+	"vec2 screenSize;};out lowp vec3 color;void main(){color=position.xyz*.5+vec3(.5);"
+	"vec3 a=vec3(position.xy,1.);vec2 b=vec2(dot(transformX,a),dot(transformY,a));gl_Position=vec4(b.x/screenSize.x*2.-1.,1.-b.y/screenSize.y*2.,0.,1.);}\n";
+
+static const char sceneEs3FragmentShader[] =
+	"#version 300 es\n"
+	"precision mediump float;in lowp vec3 color;out vec4 fragColor;void main(){fragColor=vec4(color,1.);}\n";
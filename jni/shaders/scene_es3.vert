@@ -0,0 +1,19 @@
+#version 300 es
+// Instanced scene nodes: the world transform rows are per instance attributes and the screen
+// size comes from the per frame uniform block; otherwise as scene_es2.vert.
+in vec4 position; // range: -1 1
+in vec3 transformX;
+in vec3 transformY;
+layout(std140) uniform Frame {
+	vec2 screenSize;
+};
+out vec3 color;
+
+const float colorScale = 0.5;
+
+void main() {
+	color = position.xyz * colorScale + vec3(colorScale);
+	vec3 p = vec3(position.xy, 1.0);
+	vec2 pixel = vec2(dot(transformX, p), dot(transformY, p));
+	gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+}
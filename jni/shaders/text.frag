@@ -0,0 +1,11 @@
+precision mediump float;
+
+// single channel glyph coverage
+uniform sampler2D atlas;
+varying vec2 vTexCoord;
+varying vec4 vColor;
+
+void main() {
+	float coverage = texture2D(atlas, vTexCoord).a;
+	gl_FragColor = vec4(vColor.rgb, vColor.a * coverage);
+}
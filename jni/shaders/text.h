@@ -0,0 +1,15 @@
+// Generated by tools/shader_tool.cpp from text.vert and text.frag; do not edit.
+// input hash 0x5bb6c2f75247a3b9
+
+#pragma once
+
+#define TEXT_SOURCE_HASH 0x15f9ba10298d2fdcull
+
+static const char textVertexShader[] =
+	"attribute vec2 position;attribute vec2 texCoord;attribute vec4 color;uniform vec2 screenSize;"
+	"varying mediump vec2 vTexCoord;varying lowp vec4 vColor;void main(){vTexCoord=texCoord;"
+	"vColor=color;gl_Position=vec4(position.x/screenSize.x*2.-1.,1.-position.y/screenSize.y*2.,0.,1.);}\n";
+
+static const char textFragmentShader[] =
+	"precision mediump float;uniform sampler2D atlas;varying vec2 vTexCoord;varying lowp vec4 vColor;"
+	"void main(){lowp float b=texture2D(atlas,vTexCoord).a;gl_FragColor=vec4(vColor.rgb,vColor.a*b);}\n";
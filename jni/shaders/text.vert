@@ -0,0 +1,13 @@
+// Glyph quads in window pixels (y down), with atlas coordinates and a colour per vertex.
+attribute vec2 position;
+attribute vec2 texCoord; // range: 0 1
+attribute vec4 color; // range: 0 1, normalized unsigned bytes
+uniform vec2 screenSize;
+varying vec2 vTexCoord;
+varying vec4 vColor;
+
+void main() {
+	vTexCoord = texCoord;
+	vColor = color;
+	gl_Position = vec4(position.x / screenSize.x * 2.0 - 1.0, 1.0 - position.y / screenSize.y * 2.0, 0.0, 1.0);
+}
@@ -0,0 +1,149 @@
+#include "simulation.h"
+#include "memory_tracker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void wrapAxis(float* __restrict curr, float* __restrict prev, int32_t count, float bound) {
+	if (bound <= 0.0f) {
+		return;
+	}
+	for (int32_t i = 0; i < count; ++i) {
+		// shift both samples by the same amount so the interpolated path stays continuous
+		float shift = 0.0f;
+		if (curr[i] >= bound) {
+			shift = -bound;
+		} else if (curr[i] < 0.0f) {
+			shift = bound;
+		}
+		curr[i] += shift;
+		prev[i] += shift;
+	}
+}
+
+bool initSimulation(Simulation* simulation, int32_t capacity, int32_t ticksPerSecond, int32_t maxTicksPerFrame) {
+	memset(simulation, 0, sizeof(Simulation));
+
+	// round up so vectorised loops never need a scalar tail on the padded arrays
+	capacity = (capacity + 3) & ~3;
+
+	float** arrays[] = {
+		&simulation->entities.prevX, &simulation->entities.prevY,
+		&simulation->entities.currX, &simulation->entities.currY,
+		&simulation->entities.velocityX, &simulation->entities.velocityY,
+		&simulation->entities.renderX, &simulation->entities.renderY
+	};
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+		*arrays[i] = static_cast<float*>(MEMORY_CALLOC(MEMORY_TAG_SIMULATION, capacity, sizeof(float)));
+		if (!*arrays[i]) {
+			termSimulation(simulation);
+			return false;
+		}
+	}
+
+	simulation->entities.capacity = capacity;
+	simulation->tickNanoseconds = 1000000000LL / ticksPerSecond;
+	simulation->maxTicksPerFrame = maxTicksPerFrame;
+	return true;
+}
+
+void termSimulation(Simulation* simulation) {
+	SimulationEntities* e = &simulation->entities;
+	MEMORY_FREE(e->prevX);
+	MEMORY_FREE(e->prevY);
+	MEMORY_FREE(e->currX);
+	MEMORY_FREE(e->currY);
+	MEMORY_FREE(e->velocityX);
+	MEMORY_FREE(e->velocityY);
+	MEMORY_FREE(e->renderX);
+	MEMORY_FREE(e->renderY);
+	memset(e, 0, sizeof(SimulationEntities));
+}
+
+int32_t addSimulationEntity(Simulation* simulation, float x, float y, float velocityX, float velocityY) {
+	SimulationEntities* e = &simulation->entities;
+	if (e->count >= e->capacity) {
+		return -1;
+	}
+	int32_t i = e->count++;
+	e->prevX[i] = e->currX[i] = e->renderX[i] = x;
+	e->prevY[i] = e->currY[i] = e->renderY[i] = y;
+	e->velocityX[i] = velocityX;
+	e->velocityY[i] = velocityY;
+	return i;
+}
+
+void setSimulationBounds(Simulation* simulation, float boundsX, float boundsY) {
+	simulation->boundsX = boundsX;
+	simulation->boundsY = boundsY;
+}
+
+void resetSimulationClock(Simulation* simulation, int64_t nowNanoseconds) {
+	simulation->lastTimeNanoseconds = nowNanoseconds;
+	simulation->accumulatorNanoseconds = 0;
+}
+
+void stepSimulation(Simulation* simulation) {
+	SimulationEntities* e = &simulation->entities;
+	const float dt = simulation->tickNanoseconds * 1e-9f;
+	const int32_t count = e->count;
+
+	// the current state becomes the previous one by swapping arrays rather than copying
+	float* t = e->prevX; e->prevX = e->currX; e->currX = t;
+	t = e->prevY; e->prevY = e->currY; e->currY = t;
+
+	const float* __restrict prevX = e->prevX;
+	const float* __restrict prevY = e->prevY;
+	const float* __restrict velocityX = e->velocityX;
+	const float* __restrict velocityY = e->velocityY;
+	float* __restrict currX = e->currX;
+	float* __restrict currY = e->currY;
+	for (int32_t i = 0; i < count; ++i) {
+		currX[i] = prevX[i] + velocityX[i] * dt;
+		currY[i] = prevY[i] + velocityY[i] * dt;
+	}
+
+	wrapAxis(e->currX, e->prevX, count, simulation->boundsX);
+	wrapAxis(e->currY, e->prevY, count, simulation->boundsY);
+	++simulation->tickCount;
+}
+
+void interpolateSimulation(Simulation* simulation, float alpha) {
+	SimulationEntities* e = &simulation->entities;
+	const int32_t count = e->count;
+	const float* __restrict prevX = e->prevX;
+	const float* __restrict prevY = e->prevY;
+	const float* __restrict currX = e->currX;
+	const float* __restrict currY = e->currY;
+	float* __restrict renderX = e->renderX;
+	float* __restrict renderY = e->renderY;
+	for (int32_t i = 0; i < count; ++i) {
+		renderX[i] = prevX[i] + (currX[i] - prevX[i]) * alpha;
+		renderY[i] = prevY[i] + (currY[i] - prevY[i]) * alpha;
+	}
+	simulation->alpha = alpha;
+}
+
+int32_t advanceSimulation(Simulation* simulation, int64_t nowNanoseconds) {
+	if (simulation->lastTimeNanoseconds == 0) {
+		resetSimulationClock(simulation, nowNanoseconds);
+	}
+	simulation->accumulatorNanoseconds += nowNanoseconds - simulation->lastTimeNanoseconds;
+	simulation->lastTimeNanoseconds = nowNanoseconds;
+
+	int32_t ticks = 0;
+	while (simulation->accumulatorNanoseconds >= simulation->tickNanoseconds) {
+		if (ticks == simulation->maxTicksPerFrame) {
+			// too far behind to catch up; drop the backlog instead of spiralling
+			simulation->droppedTicks += simulation->accumulatorNanoseconds / simulation->tickNanoseconds;
+			simulation->accumulatorNanoseconds %= simulation->tickNanoseconds;
+			break;
+		}
+		stepSimulation(simulation);
+		simulation->accumulatorNanoseconds -= simulation->tickNanoseconds;
+		++ticks;
+	}
+
+	interpolateSimulation(simulation, static_cast<float>(simulation->accumulatorNanoseconds) / simulation->tickNanoseconds);
+	return ticks;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+// Entity state is kept as separate arrays (structure of arrays) so that stepping
+// and interpolation are straight loops the compiler can vectorise.
+struct SimulationEntities {
+	int32_t count;
+	int32_t capacity;
+	float* prevX;
+	float* prevY;
+	float* currX;
+	float* currY;
+	float* velocityX;
+	float* velocityY;
+	float* renderX;
+	float* renderY;
+};
+
+struct Simulation {
+	SimulationEntities entities;
+	float boundsX;
+	float boundsY;
+	int64_t tickNanoseconds;
+	int64_t accumulatorNanoseconds;
+	int64_t lastTimeNanoseconds;
+	int32_t maxTicksPerFrame;
+	uint64_t tickCount;
+	uint64_t droppedTicks;
+	float alpha;
+};
+
+bool initSimulation(Simulation* simulation, int32_t capacity, int32_t ticksPerSecond, int32_t maxTicksPerFrame);
+void termSimulation(Simulation* simulation);
+
+// Returns the index of the new entity, or -1 if the simulation is full.
+int32_t addSimulationEntity(Simulation* simulation, float x, float y, float velocityX, float velocityY);
+
+// Positions wrap around [0, bounds) on each axis; a bound of 0 disables wrapping.
+void setSimulationBounds(Simulation* simulation, float boundsX, float boundsY);
+
+// Forgets elapsed time, e.g. after the app was paused, so the next frame does not try to catch up.
+void resetSimulationClock(Simulation* simulation, int64_t nowNanoseconds);
+
+// Runs as many fixed ticks as the elapsed time allows (capped at maxTicksPerFrame),
+// then interpolates render positions between the last two ticks. Returns the number of ticks run.
+int32_t advanceSimulation(Simulation* simulation, int64_t nowNanoseconds);
+
+void stepSimulation(Simulation* simulation);
+void interpolateSimulation(Simulation* simulation, float alpha);
@@ -0,0 +1,71 @@
+#include "startup_trace.h"
+#include "log.h"
+#include "time_utils.h"
+
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct StartupMilestone {
+	const char* name;
+	int64_t nanoseconds;
+	int32_t thread;
+};
+
+static int64_t traceOrigin;
+static struct StartupMilestone milestones[STARTUP_TRACE_MAX_MILESTONES];
+static int32_t milestoneCount;
+
+void beginStartupTrace(void) {
+	traceOrigin = nowNanoseconds();
+	milestoneCount = 0;
+	__sync_synchronize();
+}
+
+void markStartupMilestone(const char* name) {
+	int32_t index = __sync_fetch_and_add(&milestoneCount, 1);
+	if (index >= STARTUP_TRACE_MAX_MILESTONES) {
+		return;
+	}
+	milestones[index].name = name;
+	milestones[index].nanoseconds = nowNanoseconds() - traceOrigin;
+	milestones[index].thread = (int32_t)syscall(__NR_gettid);
+}
+
+int64_t startupElapsedNanoseconds(void) {
+	return nowNanoseconds() - traceOrigin;
+}
+
+static int32_t recordedMilestones(void) {
+	__sync_synchronize();
+	return milestoneCount < STARTUP_TRACE_MAX_MILESTONES ? milestoneCount : STARTUP_TRACE_MAX_MILESTONES;
+}
+
+void logStartupTrace(void) {
+	int32_t count = recordedMilestones();
+	for (int32_t i = 0; i < count; ++i) {
+		LOGI("Startup %8.2f ms  %-24s (thread %d)", milestones[i].nanoseconds * 1e-6, milestones[i].name, milestones[i].thread);
+	}
+}
+
+bool writeStartupTrace(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		LOGW("Could not write startup trace to %s", path);
+		return false;
+	}
+	int32_t count = recordedMilestones();
+	int pid = getpid();
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (int32_t i = 0; i < count; ++i) {
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}%s\n",
+			milestones[i].name, milestones[i].nanoseconds * 1e-3, pid, milestones[i].thread, i + 1 < count ? "," : "");
+	}
+	fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+	if (fclose(file) != 0) {
+		LOGW("Could not write startup trace to %s", path);
+		return false;
+	}
+	LOGI("Wrote startup trace to %s", path);
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Timestamped cold start milestones, from ANativeActivity_onCreate to the first presented frame.
+// Milestones may be marked from any thread; names must be string literals.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STARTUP_TRACE_MAX_MILESTONES 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Restarts the trace; everything is timed relative to this call.
+void beginStartupTrace(void);
+void markStartupMilestone(const char* name);
+int64_t startupElapsedNanoseconds(void);
+
+void logStartupTrace(void);
+// Chrome trace event format, viewable in chrome://tracing or Perfetto.
+bool writeStartupTrace(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+#include "stream_buffer.h"
+#include "log.h"
+#include "memory_tracker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool initStreamBuffer(StreamBuffer* stream, GLenum target, GLsizeiptr segmentSize, int32_t segmentCount,
+	const GLExtensions* extensions, const GpuFenceProvider* fenceProvider) {
+	memset(stream, 0, sizeof(StreamBuffer));
+	if (segmentCount > STREAM_BUFFER_MAX_SEGMENTS) {
+		segmentCount = STREAM_BUFFER_MAX_SEGMENTS;
+	}
+	stream->target = target;
+	stream->segmentSize = segmentSize;
+	stream->segmentCount = segmentCount;
+	stream->extensions = extensions;
+	stream->fenceProvider = fenceProvider;
+	stream->mapped = extensions->mapBufferRange && fenceProvider;
+	stream->segment = segmentCount - 1;
+
+	if (!stream->mapped) {
+		stream->staging = static_cast<uint8_t*>(MEMORY_ALLOC(MEMORY_TAG_STREAM, segmentSize));
+		if (!stream->staging) {
+			return false;
+		}
+	}
+
+	glGenBuffers(segmentCount, stream->buffers);
+	for (int32_t i = 0; i < segmentCount; ++i) {
+		glBindBuffer(target, stream->buffers[i]);
+		glBufferData(target, segmentSize, NULL, GL_STREAM_DRAW);
+		trackGpuMemory(GPU_MEMORY_BUFFERS, segmentSize);
+	}
+	glBindBuffer(target, 0);
+
+	LOGI("Stream buffer: %d x %ld bytes, %s", segmentCount, static_cast<long>(segmentSize),
+		stream->mapped ? "mapped with fences" : "orphaned");
+	return true;
+}
+
+void termStreamBuffer(StreamBuffer* stream) {
+	for (int32_t i = 0; i < stream->segmentCount; ++i) {
+		if (stream->fences[i]) {
+			destroyGpuFence(stream->fenceProvider, stream->fences[i]);
+		}
+	}
+	if (stream->segmentCount > 0) {
+		glDeleteBuffers(stream->segmentCount, stream->buffers);
+	}
+	for (int32_t i = 0; i < stream->segmentCount; ++i) {
+		trackGpuMemory(GPU_MEMORY_BUFFERS, -stream->segmentSize);
+	}
+	MEMORY_FREE(stream->staging);
+	memset(stream, 0, sizeof(StreamBuffer));
+}
+
+void beginStreamFrame(StreamBuffer* stream) {
+	stream->segment = (stream->segment + 1) % stream->segmentCount;
+	if (stream->segment == 0) {
+		++stream->stats.wraps;
+	}
+	stream->head = 0;
+	stream->stats.frameBytes = 0;
+
+	GLuint buffer = stream->buffers[stream->segment];
+	GpuFence fence = stream->fences[stream->segment];
+	bool orphan = !stream->mapped;
+	if (fence) {
+		if (!isGpuFenceSignaled(stream->fenceProvider, fence)) {
+			++stream->stats.fenceStalls;
+			orphan = true;
+		}
+		destroyGpuFence(stream->fenceProvider, fence);
+		stream->fences[stream->segment] = NULL;
+	}
+
+	if (orphan) {
+		glBindBuffer(stream->target, buffer);
+		glBufferData(stream->target, stream->segmentSize, NULL, GL_STREAM_DRAW);
+	}
+}
+
+void endStreamFrame(StreamBuffer* stream) {
+	if (stream->mapped && stream->stats.frameBytes > 0) {
+		stream->fences[stream->segment] = createGpuFence(stream->fenceProvider);
+	}
+	stream->stats.lastFrameBytes = stream->stats.frameBytes;
+}
+
+void* allocStream(StreamBuffer* stream, GLsizeiptr size, GLsizeiptr alignment, StreamAllocation* allocation) {
+	GLsizeiptr offset = (stream->head + alignment - 1) / alignment * alignment;
+	if (offset + size > stream->segmentSize) {
+		++stream->stats.overflows;
+		return NULL;
+	}
+
+	allocation->buffer = stream->buffers[stream->segment];
+	allocation->offset = offset;
+	allocation->size = size;
+	glBindBuffer(stream->target, allocation->buffer);
+	if (stream->mapped) {
+		// the segment's fence has signaled (or it was orphaned), so nothing the GPU reads overlaps this range
+		allocation->data = stream->extensions->mapBufferRangeEXT(stream->target, offset, size,
+			GL_MAP_WRITE_BIT_EXT | GL_MAP_INVALIDATE_RANGE_BIT_EXT | GL_MAP_UNSYNCHRONIZED_BIT_EXT);
+		if (!allocation->data) {
+			// the range is left free, so a failed map doesn't leave a hole or a fence on an empty frame
+			LOGE("glMapBufferRangeEXT failed with error 0x%04x", glGetError());
+			return NULL;
+		}
+	} else {
+		allocation->data = stream->staging + offset;
+	}
+	stream->head = offset + size;
+	stream->stats.frameBytes += size;
+	stream->stats.totalBytes += size;
+	return allocation->data;
+}
+
+void commitStream(StreamBuffer* stream, const StreamAllocation* allocation) {
+	glBindBuffer(stream->target, allocation->buffer);
+	if (stream->mapped) {
+		stream->extensions->unmapBufferOES(stream->target);
+	} else {
+		glBufferSubData(stream->target, allocation->offset, allocation->size, allocation->data);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "gl_extensions.h"
+#include "gpu_fence.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#define STREAM_BUFFER_MAX_SEGMENTS 4
+
+struct StreamAllocation {
+	GLuint buffer;
+	GLintptr offset;
+	GLsizeiptr size;
+	void* data;
+};
+
+struct StreamBufferStats {
+	GLsizeiptr frameBytes;
+	GLsizeiptr lastFrameBytes;
+	uint64_t totalBytes;
+	uint32_t wraps;
+	uint32_t fenceStalls; // segments still in use by the GPU when their turn came round again
+	uint32_t overflows; // allocations that did not fit in the frame's segment
+};
+
+// Per-frame geometry is sub-allocated linearly from one segment of a ring of GL buffers,
+// one segment per frame. With GL_EXT_map_buffer_range and fences, writes go straight into
+// unsynchronized mappings and each segment is fenced when its frame ends; otherwise the
+// segment is orphaned at the start of the frame and filled with glBufferSubData from a
+// CPU staging copy. Either way the CPU never blocks on the GPU: a segment whose fence has
+// not signaled is orphaned instead of waited on, and counted as a fence stall.
+struct StreamBuffer {
+	GLenum target;
+	GLsizeiptr segmentSize;
+	int32_t segmentCount;
+	GLuint buffers[STREAM_BUFFER_MAX_SEGMENTS];
+	GpuFence fences[STREAM_BUFFER_MAX_SEGMENTS];
+	int32_t segment;
+	GLsizeiptr head;
+	bool mapped;
+	uint8_t* staging;
+	const GLExtensions* extensions;
+	const GpuFenceProvider* fenceProvider;
+	StreamBufferStats stats;
+};
+
+// fenceProvider may be NULL, which selects the orphaning path.
+bool initStreamBuffer(StreamBuffer* stream, GLenum target, GLsizeiptr segmentSize, int32_t segmentCount,
+	const GLExtensions* extensions, const GpuFenceProvider* fenceProvider);
+void termStreamBuffer(StreamBuffer* stream);
+
+void beginStreamFrame(StreamBuffer* stream);
+void endStreamFrame(StreamBuffer* stream);
+
+// Returns memory to write size bytes into, or NULL if the frame's segment is full.
+// The buffer is bound to the stream's target afterwards.
+void* allocStream(StreamBuffer* stream, GLsizeiptr size, GLsizeiptr alignment, StreamAllocation* allocation);
+
+// Makes the written data visible to GL; the allocation's buffer stays bound.
+void commitStream(StreamBuffer* stream, const StreamAllocation* allocation);
@@ -0,0 +1,382 @@
+#include "text_renderer.h"
+#include "shader_utils.h"
+#include "log.h"
+#include "memory_tracker.h"
+#include "shaders/text.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t hashText(const char* text, int32_t length, const TextStyle* style) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (int32_t i = 0; i < length; ++i) {
+		hash = (hash ^ static_cast<uint8_t>(text[i])) * 16777619u;
+	}
+	hash = (hash ^ static_cast<uint32_t>(style->scale)) * 16777619u;
+	hash = (hash ^ style->color) * 16777619u;
+	return hash;
+}
+
+static bool runMatches(const TextRun* run, uint32_t hash, const char* text, int32_t length, const TextStyle* style) {
+	return run->hash == hash && run->length == length && run->style.scale == style->scale &&
+		run->style.color == style->color && memcmp(run->text, text, length) == 0;
+}
+
+// The slot holding the matching run, or the empty slot where it would go.
+static int32_t* findRunSlot(TextRunCache* cache, uint32_t hash, const char* text, int32_t length, const TextStyle* style) {
+	uint32_t mask = cache->capacity - 1;
+	uint32_t slot = hash & mask;
+	while (cache->slots[slot] >= 0 && !runMatches(&cache->runs[cache->slots[slot]], hash, text, length, style)) {
+		slot = (slot + 1) & mask;
+	}
+	return &cache->slots[slot];
+}
+
+bool initTextRenderer(TextRenderer* renderer, int32_t atlasSize, int32_t maxRuns) {
+	memset(renderer, 0, sizeof(TextRenderer));
+
+	TextRunCache* cache = &renderer->cache;
+	int32_t capacity = 16;
+	while (capacity < maxRuns * 2) {
+		capacity *= 2;
+	}
+	cache->capacity = capacity;
+	cache->maxRuns = maxRuns;
+	cache->runs = static_cast<TextRun*>(MEMORY_CALLOC(MEMORY_TAG_TEXT, maxRuns, sizeof(TextRun)));
+	cache->quads = static_cast<TextQuad*>(MEMORY_ALLOC(MEMORY_TAG_TEXT, maxRuns * TEXT_RUN_MAX_LENGTH * sizeof(TextQuad)));
+	cache->freeRuns = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_TEXT, maxRuns * sizeof(int32_t)));
+	cache->slots = static_cast<int32_t*>(MEMORY_ALLOC(MEMORY_TAG_TEXT, capacity * sizeof(int32_t)));
+	if (!cache->runs || !cache->quads || !cache->freeRuns || !cache->slots || !initGlyphAtlas(&renderer->atlas, atlasSize, atlasSize)) {
+		termTextRenderer(renderer);
+		return false;
+	}
+	// popped from the end, so runs are handed out from the start of the pool
+	for (int32_t i = 0; i < maxRuns; ++i) {
+		cache->runs[i].quads = cache->quads + i * TEXT_RUN_MAX_LENGTH;
+		cache->freeRuns[i] = maxRuns - 1 - i;
+	}
+	cache->freeCount = maxRuns;
+	memset(cache->slots, 0xff, capacity * sizeof(int32_t));
+	return true;
+}
+
+void termTextRenderer(TextRenderer* renderer) {
+	MEMORY_FREE(renderer->cache.runs);
+	MEMORY_FREE(renderer->cache.quads);
+	MEMORY_FREE(renderer->cache.freeRuns);
+	MEMORY_FREE(renderer->cache.slots);
+	MEMORY_FREE(renderer->batch.vertices);
+	MEMORY_FREE(renderer->atlasSnapshot);
+	termGlyphAtlas(&renderer->atlas);
+	memset(renderer, 0, sizeof(TextRenderer));
+}
+
+static void createAtlasTexture(TextRenderer* renderer) {
+	glGenTextures(1, &renderer->texture);
+	glBindTexture(GL_TEXTURE_2D, renderer->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, renderer->atlas.width, renderer->atlas.height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, NULL);
+	trackGpuMemory(GPU_MEMORY_TEXTURES, renderer->atlas.width * renderer->atlas.height);
+
+	// the new texture is empty, so everything rasterized so far has to go up again
+	markGlyphAtlasDirty(&renderer->atlas);
+}
+
+static void completeAtlasUpload(void* data, UploadJob* job) {
+	TextRenderer* renderer = static_cast<TextRenderer*>(data);
+	MEMORY_FREE(renderer->atlasSnapshot);
+	renderer->atlasSnapshot = NULL;
+	if (job->state == UPLOAD_READY) {
+		renderer->texture = job->name;
+	} else if (job->state == UPLOAD_FAILED) {
+		LOGW("Text atlas upload failed, creating it on the render thread");
+		createAtlasTexture(renderer);
+	}
+}
+
+bool initTextRendererGL(TextRenderer* renderer, UploadQueue* uploads) {
+	renderer->program = beginProgram(textVertexShader, textFragmentShader);
+	if (!renderer->program) {
+		return false;
+	}
+
+	renderer->texture = 0;
+	GlyphAtlas* atlas = &renderer->atlas;
+	int32_t atlasBytes = atlas->width * atlas->height;
+	// glyphs can be rasterized while the upload is in flight, so the queue gets a copy
+	if (uploads && !renderer->atlasSnapshot) {
+		renderer->atlasSnapshot = static_cast<uint8_t*>(MEMORY_ALLOC(MEMORY_TAG_TEXT, atlasBytes));
+	}
+	if (!uploads || !renderer->atlasSnapshot) {
+		createAtlasTexture(renderer);
+		return true;
+	}
+	memcpy(renderer->atlasSnapshot, atlas->pixels, atlasBytes);
+	UploadJob* job = &renderer->atlasUpload;
+	memset(job, 0, sizeof(UploadJob));
+	job->type = UPLOAD_TEXTURE;
+	job->format = GL_ALPHA;
+	job->filter = GL_NEAREST;
+	job->width = atlas->width;
+	job->height = atlas->height;
+	job->data = renderer->atlasSnapshot;
+	job->complete = completeAtlasUpload;
+	job->completeData = renderer;
+	submitUpload(uploads, job);
+	clearGlyphAtlasDirty(atlas);
+	return true;
+}
+
+bool finishTextRendererGL(TextRenderer* renderer) {
+	GLuint program = finishProgram(renderer->program);
+	if (!program) {
+		LOGE("Could not create text program");
+		renderer->program = 0;
+		return false;
+	}
+	renderer->positionLocation = glGetAttribLocation(program, "position");
+	renderer->texCoordLocation = glGetAttribLocation(program, "texCoord");
+	renderer->colorLocation = glGetAttribLocation(program, "color");
+	renderer->screenSizeLocation = glGetUniformLocation(program, "screenSize");
+	renderer->atlasLocation = glGetUniformLocation(program, "atlas");
+	return true;
+}
+
+void termTextRendererGL(TextRenderer* renderer) {
+	if (renderer->texture) {
+		glDeleteTextures(1, &renderer->texture);
+		trackGpuMemory(GPU_MEMORY_TEXTURES, -static_cast<int64_t>(renderer->atlas.width) * renderer->atlas.height);
+		renderer->texture = 0;
+	}
+	if (renderer->program) {
+		glDeleteProgram(renderer->program);
+		renderer->program = 0;
+	}
+}
+
+struct TextPen {
+	float x;
+	float y;
+	float width;
+};
+
+// Lays out glyphs from the pen position into quads, which has room for length quads, and returns
+// how many were written; spaces and missing glyphs only move the pen.
+static int32_t shapeText(GlyphAtlas* atlas, const char* text, int32_t length, const TextStyle* style, TextPen* pen, TextQuad* quads) {
+	const float invWidth = 1.0f / atlas->width;
+	const float invHeight = 1.0f / atlas->height;
+	const float lineHeight = 8.0f * style->scale;
+	int32_t quadCount = 0;
+	for (int32_t i = 0; i < length; ++i) {
+		uint32_t c = static_cast<uint8_t>(text[i]);
+		if (c == '\n') {
+			pen->x = 0.0f;
+			pen->y += lineHeight;
+			continue;
+		}
+		const Glyph* glyph = findOrAddGlyph(atlas, c, style->scale);
+		if (!glyph) {
+			pen->x += lineHeight;
+			continue;
+		}
+		if (c != ' ') {
+			TextQuad* quad = &quads[quadCount++];
+			quad->x0 = pen->x;
+			quad->y0 = pen->y;
+			quad->x1 = pen->x + glyph->width;
+			quad->y1 = pen->y + glyph->height;
+			quad->u0 = glyph->x * invWidth;
+			quad->v0 = glyph->y * invHeight;
+			quad->u1 = (glyph->x + glyph->width) * invWidth;
+			quad->v1 = (glyph->y + glyph->height) * invHeight;
+		}
+		pen->x += glyph->advance;
+		if (pen->x > pen->width) {
+			pen->width = pen->x;
+		}
+	}
+	return quadCount;
+}
+
+const TextRun* layoutText(TextRenderer* renderer, const char* text, const TextStyle* style) {
+	TextRunCache* cache = &renderer->cache;
+	int32_t length = strlen(text);
+	if (length > TEXT_RUN_MAX_LENGTH) {
+		++cache->misses;
+		return NULL;
+	}
+	uint32_t hash = hashText(text, length, style);
+
+	int32_t* slot = findRunSlot(cache, hash, text, length, style);
+	if (*slot >= 0) {
+		TextRun* run = &cache->runs[*slot];
+		run->lastUsedFrame = cache->frame;
+		++cache->hits;
+		return run;
+	}
+
+	++cache->misses;
+	if (cache->freeCount == 0) {
+		// every run is in use this frame; the caller lays out without caching rather than thrash
+		return NULL;
+	}
+	int32_t index = cache->freeRuns[--cache->freeCount];
+	TextRun* run = &cache->runs[index];
+	TextPen pen = { 0.0f, 0.0f, 0.0f };
+	run->quadCount = shapeText(&renderer->atlas, text, length, style, &pen, run->quads);
+	run->width = pen.width;
+	run->height = pen.y + 8.0f * style->scale;
+	run->hash = hash;
+	run->style = *style;
+	run->length = length;
+	memcpy(run->text, text, length);
+	run->text[length] = '\0';
+	run->lastUsedFrame = cache->frame;
+	run->live = true;
+	*slot = index;
+	++cache->count;
+	return run;
+}
+
+// Frees the runs not used in the last frame and reinserts the rest into the emptied table.
+static void evictStaleRuns(TextRunCache* cache) {
+	memset(cache->slots, 0xff, cache->capacity * sizeof(int32_t));
+	cache->count = 0;
+	for (int32_t i = 0; i < cache->maxRuns; ++i) {
+		TextRun* run = &cache->runs[i];
+		if (!run->live) {
+			continue;
+		}
+		if (run->lastUsedFrame + 1 < cache->frame) {
+			run->live = false;
+			cache->freeRuns[cache->freeCount++] = i;
+			++cache->evictions;
+			continue;
+		}
+		*findRunSlot(cache, run->hash, run->text, run->length, &run->style) = i;
+		++cache->count;
+	}
+}
+
+void beginText(TextRenderer* renderer) {
+	TextRunCache* cache = &renderer->cache;
+	++cache->frame;
+	if (cache->count * 4 >= cache->maxRuns * 3) {
+		evictStaleRuns(cache);
+	}
+	renderer->batch.vertexCount = 0;
+}
+
+static bool reserveTextVertices(TextBatch* batch, int32_t count) {
+	if (batch->vertexCount + count <= batch->vertexCapacity) {
+		return true;
+	}
+	int32_t capacity = batch->vertexCapacity ? batch->vertexCapacity : 6 * 256;
+	while (capacity < batch->vertexCount + count) {
+		capacity *= 2;
+	}
+	TextVertex* vertices = static_cast<TextVertex*>(MEMORY_REALLOC(MEMORY_TAG_TEXT, batch->vertices, capacity * sizeof(TextVertex)));
+	if (!vertices) {
+		return false;
+	}
+	batch->vertices = vertices;
+	batch->vertexCapacity = capacity;
+	return true;
+}
+
+static void appendTextRun(TextBatch* batch, const TextQuad* quads, int32_t quadCount, float x, float y, uint32_t color) {
+	if (!reserveTextVertices(batch, quadCount * 6)) {
+		return;
+	}
+	TextVertex* v = batch->vertices + batch->vertexCount;
+	for (int32_t i = 0; i < quadCount; ++i, v += 6) {
+		const TextQuad* q = &quads[i];
+		float x0 = x + q->x0, y0 = y + q->y0, x1 = x + q->x1, y1 = y + q->y1;
+		v[0].x = x0; v[0].y = y0; v[0].u = q->u0; v[0].v = q->v0; v[0].color = color;
+		v[1].x = x0; v[1].y = y1; v[1].u = q->u0; v[1].v = q->v1; v[1].color = color;
+		v[2].x = x1; v[2].y = y0; v[2].u = q->u1; v[2].v = q->v0; v[2].color = color;
+		v[3] = v[2];
+		v[4] = v[1];
+		v[5].x = x1; v[5].y = y1; v[5].u = q->u1; v[5].v = q->v1; v[5].color = color;
+	}
+	batch->vertexCount += quadCount * 6;
+}
+
+void drawText(TextRenderer* renderer, const char* text, float x, float y, const TextStyle* style) {
+	const TextRun* run = layoutText(renderer, text, style);
+	if (run) {
+		appendTextRun(&renderer->batch, run->quads, run->quadCount, x, y, style->color);
+		return;
+	}
+
+	// too long or the cache is full: lay out a piece at a time into the scratch quads
+	TextPen pen = { 0.0f, 0.0f, 0.0f };
+	int32_t length = strlen(text);
+	for (int32_t start = 0; start < length; start += TEXT_RUN_MAX_LENGTH) {
+		int32_t pieceLength = length - start < TEXT_RUN_MAX_LENGTH ? length - start : TEXT_RUN_MAX_LENGTH;
+		int32_t quadCount = shapeText(&renderer->atlas, text + start, pieceLength, style, &pen, renderer->scratchQuads);
+		appendTextRun(&renderer->batch, renderer->scratchQuads, quadCount, x, y, style->color);
+	}
+}
+
+void flushText(TextRenderer* renderer, StreamBuffer* stream, int32_t screenWidth, int32_t screenHeight) {
+	GlyphAtlas* atlas = &renderer->atlas;
+	TextBatch* batch = &renderer->batch;
+	if (!renderer->texture) {
+		// the atlas is still uploading; whatever was rasterized meanwhile stays dirty
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, renderer->texture);
+	if (atlas->dirtyMaxY > atlas->dirtyMinY) {
+		// ES2 has no GL_UNPACK_ROW_LENGTH, so whole rows go up
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, atlas->dirtyMinY, atlas->width, atlas->dirtyMaxY - atlas->dirtyMinY,
+			GL_ALPHA, GL_UNSIGNED_BYTE, atlas->pixels + atlas->dirtyMinY * atlas->width);
+		clearGlyphAtlasDirty(atlas);
+	}
+
+	if (batch->vertexCount == 0) {
+		return;
+	}
+
+	glUseProgram(renderer->program);
+	glUniform2f(renderer->screenSizeLocation, screenWidth, screenHeight);
+	glUniform1i(renderer->atlasLocation, 0);
+
+	GLsizeiptr size = batch->vertexCount * sizeof(TextVertex);
+	StreamAllocation allocation;
+	const char* base = NULL;
+	void* data = allocStream(stream, size, sizeof(float), &allocation);
+	if (data) {
+		memcpy(data, batch->vertices, size);
+		commitStream(stream, &allocation);
+		base = reinterpret_cast<const char*>(allocation.offset);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		base = reinterpret_cast<const char*>(batch->vertices);
+	}
+
+	glVertexAttribPointer(renderer->positionLocation, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), base + offsetof(TextVertex, x));
+	glVertexAttribPointer(renderer->texCoordLocation, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), base + offsetof(TextVertex, u));
+	glVertexAttribPointer(renderer->colorLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), base + offsetof(TextVertex, color));
+	glEnableVertexAttribArray(renderer->positionLocation);
+	glEnableVertexAttribArray(renderer->texCoordLocation);
+	glEnableVertexAttribArray(renderer->colorLocation);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDrawArrays(GL_TRIANGLES, 0, batch->vertexCount);
+	glDisable(GL_BLEND);
+
+	glDisableVertexAttribArray(renderer->positionLocation);
+	glDisableVertexAttribArray(renderer->texCoordLocation);
+	glDisableVertexAttribArray(renderer->colorLocation);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "glyph_atlas.h"
+#include "stream_buffer.h"
+#include "upload_queue.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+struct TextStyle {
+	int32_t scale;
+	uint32_t color; // RGBA, red in the low byte
+};
+
+// Glyph quad relative to the run origin, in pixels, with atlas texture coordinates.
+struct TextQuad {
+	float x0, y0, x1, y1;
+	float u0, v0, u1, v1;
+};
+
+// Longer strings are laid out every time they are drawn.
+#define TEXT_RUN_MAX_LENGTH 48
+
+// A laid out string. Runs are cached by string and style so unchanged labels are not laid out again.
+struct TextRun {
+	uint32_t hash;
+	TextStyle style;
+	int32_t length;
+	TextQuad* quads; // TEXT_RUN_MAX_LENGTH of them, in the cache's quad pool
+	int32_t quadCount;
+	float width;
+	float height;
+	uint32_t lastUsedFrame;
+	bool live;
+	char text[TEXT_RUN_MAX_LENGTH + 1];
+};
+
+// Runs and their quads are allocated once, for maxRuns runs; eviction frees stale runs to the free
+// list and rebuilds the index table in place, so laying out text never allocates.
+struct TextRunCache {
+	TextRun* runs;
+	TextQuad* quads;
+	int32_t* freeRuns; // a stack of indices into runs
+	int32_t freeCount;
+	int32_t maxRuns;
+	int32_t* slots; // open addressing table of indices into runs, -1 is empty
+	int32_t capacity;
+	int32_t count;
+	uint32_t frame;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+
+struct TextVertex {
+	float x, y;
+	float u, v;
+	uint32_t color;
+};
+
+struct TextBatch {
+	TextVertex* vertices;
+	int32_t vertexCount;
+	int32_t vertexCapacity;
+};
+
+struct TextRenderer {
+	GlyphAtlas atlas;
+	TextRunCache cache;
+	TextBatch batch;
+	GLuint program;
+	GLuint texture; // 0 until the atlas upload completes
+	UploadJob atlasUpload;
+	uint8_t* atlasSnapshot; // the atlas as submitted, kept until the upload completes
+	TextQuad scratchQuads[TEXT_RUN_MAX_LENGTH]; // for text drawn without a cached run
+	GLint positionLocation;
+	GLint texCoordLocation;
+	GLint colorLocation;
+	GLint screenSizeLocation;
+	GLint atlasLocation;
+};
+
+bool initTextRenderer(TextRenderer* renderer, int32_t atlasSize, int32_t maxRuns);
+void termTextRenderer(TextRenderer* renderer);
+
+// Creates the GL objects; call again whenever a new context is made current. The program is only
+// submitted for compilation until finishTextRendererGL, which must be called before drawing. With
+// uploads the atlas texture is created through the queue and text is skipped until it is ready.
+bool initTextRendererGL(TextRenderer* renderer, UploadQueue* uploads);
+bool finishTextRendererGL(TextRenderer* renderer);
+// Deletes the GL objects; call before the context goes away, after termUploadQueue has completed
+// any atlas upload still in flight.
+void termTextRendererGL(TextRenderer* renderer);
+
+// NULL if the text is longer than TEXT_RUN_MAX_LENGTH or every run is in use this frame.
+const TextRun* layoutText(TextRenderer* renderer, const char* text, const TextStyle* style);
+
+// Starts a new frame of text, dropping runs that were not used recently if the cache is filling up.
+void beginText(TextRenderer* renderer);
+
+// Appends the text to this frame's batch with its top left corner at (x, y) in window pixels.
+void drawText(TextRenderer* renderer, const char* text, float x, float y, const TextStyle* style);
+
+// Uploads new glyphs and draws all text appended since beginText with a single draw call.
+void flushText(TextRenderer* renderer, StreamBuffer* stream, int32_t screenWidth, int32_t screenHeight);
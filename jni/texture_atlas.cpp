@@ -0,0 +1,197 @@
+#include "texture_atlas.h"
+#include "log.h"
+#include "memory_tracker.h"
+#include "time_utils.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+static bool validateAtlasHeader(const AtlasFileHeader* header, size_t size) {
+	if (header->magic != ATLAS_FILE_MAGIC || header->version != ATLAS_FILE_VERSION) {
+		LOGE("Not an atlas file or unsupported version");
+		return false;
+	}
+	if (header->pageCount > ATLAS_MAX_PAGES || header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0 ||
+		header->entryCount > header->slotCount || header->maxProbe >= header->slotCount) {
+		LOGE("Corrupt atlas header");
+		return false;
+	}
+	uint64_t pagesEnd = header->pagesOffset + static_cast<uint64_t>(header->pageCount) * sizeof(AtlasPageDesc);
+	uint64_t entriesEnd = header->entriesOffset + static_cast<uint64_t>(header->entryCount) * sizeof(AtlasEntry);
+	uint64_t slotsEnd = header->slotsOffset + static_cast<uint64_t>(header->slotCount) * sizeof(uint32_t);
+	// the tables are read in place, so they have to be aligned in the file
+	if (pagesEnd > size || entriesEnd > size || slotsEnd > size || header->pagesOffset % 4 != 0 ||
+		header->entriesOffset % 4 != 0 || header->slotsOffset % 4 != 0) {
+		LOGE("Truncated atlas file");
+		return false;
+	}
+	return true;
+}
+
+bool openTextureAtlas(TextureAtlas* atlas, const void* data, size_t size) {
+	memset(atlas, 0, sizeof(TextureAtlas));
+	if (size < sizeof(AtlasFileHeader) || reinterpret_cast<uintptr_t>(data) % 4 != 0) {
+		return false;
+	}
+	const AtlasFileHeader* header = static_cast<const AtlasFileHeader*>(data);
+	if (!validateAtlasHeader(header, size)) {
+		return false;
+	}
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const AtlasPageDesc* pages = reinterpret_cast<const AtlasPageDesc*>(bytes + header->pagesOffset);
+	for (uint32_t i = 0; i < header->pageCount; ++i) {
+		if (static_cast<uint64_t>(pages[i].width) * pages[i].height * 4 != pages[i].pixelSize ||
+			static_cast<uint64_t>(pages[i].pixelOffset) + pages[i].pixelSize > size) {
+			LOGE("Truncated atlas page %u", i);
+			return false;
+		}
+	}
+	// checked once here so lookups and binds can index straight into the mapping
+	const AtlasEntry* entries = reinterpret_cast<const AtlasEntry*>(bytes + header->entriesOffset);
+	const uint32_t* slots = reinterpret_cast<const uint32_t*>(bytes + header->slotsOffset);
+	for (uint32_t i = 0; i < header->entryCount; ++i) {
+		if (entries[i].page >= header->pageCount) {
+			LOGE("Atlas entry %u is on page %u of %u", i, entries[i].page, header->pageCount);
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->slotCount; ++i) {
+		if (slots[i] != ATLAS_EMPTY_SLOT && slots[i] >= header->entryCount) {
+			LOGE("Atlas slot %u points at entry %u of %u", i, slots[i], header->entryCount);
+			return false;
+		}
+	}
+	atlas->data = bytes;
+	atlas->size = size;
+	atlas->header = header;
+	atlas->pages = pages;
+	atlas->entries = entries;
+	atlas->slots = slots;
+	atlas->slotMask = header->slotCount - 1;
+	atlas->maxProbe = header->maxProbe;
+	return true;
+}
+
+bool mapTextureAtlasFile(TextureAtlas* atlas, const char* path) {
+	memset(atlas, 0, sizeof(TextureAtlas));
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		LOGE("Could not open atlas %s", path);
+		return false;
+	}
+	struct stat st;
+	void* mapping = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// the mapping keeps the file
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		LOGE("Could not map atlas %s", path);
+		return false;
+	}
+	if (!openTextureAtlas(atlas, mapping, st.st_size)) {
+		munmap(mapping, st.st_size);
+		return false;
+	}
+	atlas->mapping = mapping;
+	return true;
+}
+
+bool openTextureAtlasAsset(TextureAtlas* atlas, AAssetManager* assetManager, const char* path) {
+	memset(atlas, 0, sizeof(TextureAtlas));
+	AAsset* asset = AAssetManager_open(assetManager, path, AASSET_MODE_BUFFER);
+	if (!asset) {
+		LOGE("Could not open atlas %s", path);
+		return false;
+	}
+	// uncompressed assets are memory mapped; store .atlas files uncompressed in the APK
+	const void* data = AAsset_getBuffer(asset);
+	if (!data || !openTextureAtlas(atlas, data, AAsset_getLength(asset))) {
+		AAsset_close(asset);
+		return false;
+	}
+	atlas->asset = asset;
+	return true;
+}
+
+void closeTextureAtlas(TextureAtlas* atlas) {
+	if (atlas->textures[0]) {
+		glDeleteTextures(atlas->header->pageCount, atlas->textures);
+		trackGpuMemory(GPU_MEMORY_TEXTURES, -atlas->textureBytes);
+	}
+	if (atlas->mapping) {
+		munmap(atlas->mapping, atlas->size);
+	}
+	if (atlas->asset) {
+		AAsset_close(atlas->asset);
+	}
+	memset(atlas, 0, sizeof(TextureAtlas));
+}
+
+const AtlasEntry* findAtlasEntry(const TextureAtlas* atlas, uint64_t nameHash) {
+	if (!atlas->header) {
+		return NULL;
+	}
+	uint32_t low = static_cast<uint32_t>(nameHash);
+	uint32_t high = static_cast<uint32_t>(nameHash >> 32);
+	uint32_t slot = atlasHomeSlot(nameHash, atlas->slotMask + 1);
+	// no lookup has to go further than the longest probe the baker saw
+	for (uint32_t probe = 0; probe <= atlas->maxProbe; ++probe) {
+		uint32_t index = atlas->slots[slot];
+		if (index == ATLAS_EMPTY_SLOT) {
+			return NULL;
+		}
+		const AtlasEntry* entry = &atlas->entries[index];
+		if (entry->nameHashLow == low && entry->nameHashHigh == high) {
+			return entry;
+		}
+		slot = (slot + 1) & atlas->slotMask;
+	}
+	return NULL;
+}
+
+bool uploadAtlasPages(TextureAtlas* atlas, const GLExtensions* extensions, bool mipmaps) {
+	if (!atlas->header) {
+		return false;
+	}
+	int64_t start = nowNanoseconds();
+	uint32_t pageCount = atlas->header->pageCount;
+	glGenTextures(pageCount, atlas->textures);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (uint32_t i = 0; i < pageCount; ++i) {
+		const AtlasPageDesc* page = &atlas->pages[i];
+		glBindTexture(GL_TEXTURE_2D, atlas->textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, page->width, page->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas->data + page->pixelOffset);
+		int64_t bytes = page->pixelSize;
+		if (mipmaps) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+			if (extensions->es3) {
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlas->header->mipLevels);
+			}
+			// the rest of the chain adds a third
+			bytes += bytes / 3;
+		}
+		atlas->textureBytes += bytes;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	trackGpuMemory(GPU_MEMORY_TEXTURES, atlas->textureBytes);
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		LOGE("Upload of %u atlas pages failed with error 0x%04x", pageCount, error);
+		return false;
+	}
+	LOGI("Uploaded %u atlas pages, %u images, in %.2f ms", pageCount, atlas->header->entryCount, (nowNanoseconds() - start) * 1e-6);
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "atlas_format.h"
+#include "gl_extensions.h"
+
+#include <android/asset_manager.h>
+#include <stddef.h>
+
+// An atlas file baked by tools/atlas_tool.cpp, read in place from a memory mapping. Nothing is
+// copied on load; images are looked up by name hash in the file's own hash table, which the baker
+// keeps at most half full so a lookup touches one or two slots.
+struct TextureAtlas {
+	const uint8_t* data;
+	size_t size;
+	void* mapping; // from mapTextureAtlasFile
+	AAsset* asset; // from openTextureAtlasAsset, kept open while the buffer is used
+	const AtlasFileHeader* header;
+	const AtlasPageDesc* pages;
+	const AtlasEntry* entries;
+	const uint32_t* slots;
+	uint32_t slotMask;
+	uint32_t maxProbe;
+	GLuint textures[ATLAS_MAX_PAGES];
+	int64_t textureBytes;
+};
+
+// Validates an atlas file image; data must stay valid until closeTextureAtlas.
+bool openTextureAtlas(TextureAtlas* atlas, const void* data, size_t size);
+bool mapTextureAtlasFile(TextureAtlas* atlas, const char* path);
+bool openTextureAtlasAsset(TextureAtlas* atlas, AAssetManager* assetManager, const char* path);
+// Deletes the page textures too, so call it with the context current if they were uploaded.
+void closeTextureAtlas(TextureAtlas* atlas);
+
+// NULL if no image has the hash.
+const AtlasEntry* findAtlasEntry(const TextureAtlas* atlas, uint64_t nameHash);
+
+static inline const AtlasEntry* findAtlasImage(const TextureAtlas* atlas, const char* name) {
+	return findAtlasEntry(atlas, atlasNameHash(name));
+}
+
+// Uploads every page as an RGBA texture, with a mip chain if mipmaps is set. On ES3 sampling is
+// limited to the levels the baker kept apart; on ES2 deeper levels can blend neighbouring images.
+bool uploadAtlasPages(TextureAtlas* atlas, const GLExtensions* extensions, bool mipmaps);
+static inline GLuint atlasPageTexture(const TextureAtlas* atlas, const AtlasEntry* entry) {
+	return atlas->textures[entry->page];
+}
@@ -0,0 +1,98 @@
+#include "thermal_provider.h"
+#include "log.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool androidReadThermal(void* context, ThermalSample* sample) {
+	AndroidThermalContext* android = static_cast<AndroidThermalContext*>(context);
+	int status = android->getCurrentThermalStatus(android->manager);
+	if (status < THERMAL_STATUS_NONE || status > THERMAL_STATUS_SHUTDOWN) {
+		return false;
+	}
+	sample->status = static_cast<ThermalStatus>(status);
+	sample->headroom = -1.0f;
+	if (android->getThermalHeadroom) {
+		// NaN when asked more than about once a second
+		float headroom = android->getThermalHeadroom(android->manager, 10);
+		if (headroom == headroom) {
+			sample->headroom = headroom;
+		}
+	}
+	return true;
+}
+
+bool initAndroidThermalProvider(ThermalProvider* provider, AndroidThermalContext* context) {
+	memset(provider, 0, sizeof(ThermalProvider));
+	memset(context, 0, sizeof(AndroidThermalContext));
+	context->library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+	if (!context->library) {
+		return false;
+	}
+	void* (*acquireManager)() = reinterpret_cast<void* (*)()>(dlsym(context->library, "AThermal_acquireManager"));
+	context->getCurrentThermalStatus = reinterpret_cast<int (*)(void*)>(dlsym(context->library, "AThermal_getCurrentThermalStatus"));
+	context->getThermalHeadroom = reinterpret_cast<float (*)(void*, int)>(dlsym(context->library, "AThermal_getThermalHeadroom"));
+	context->releaseManager = reinterpret_cast<void (*)(void*)>(dlsym(context->library, "AThermal_releaseManager"));
+	if (!acquireManager || !context->getCurrentThermalStatus || !context->releaseManager) {
+		termAndroidThermalProvider(context);
+		return false;
+	}
+	context->manager = acquireManager();
+	if (!context->manager) {
+		termAndroidThermalProvider(context);
+		return false;
+	}
+	provider->context = context;
+	provider->read = androidReadThermal;
+	return true;
+}
+
+void termAndroidThermalProvider(AndroidThermalContext* context) {
+	if (context->manager) {
+		context->releaseManager(context->manager);
+	}
+	if (context->library) {
+		dlclose(context->library);
+	}
+	memset(context, 0, sizeof(AndroidThermalContext));
+}
+
+static bool fileReadThermal(void* context, ThermalSample* sample) {
+	FileThermalContext* file = static_cast<FileThermalContext*>(context);
+	FILE* f = fopen(file->path, "r");
+	if (!f) {
+		return false;
+	}
+	int status = THERMAL_STATUS_UNKNOWN;
+	float headroom = -1.0f;
+	int fields = fscanf(f, "%d %f", &status, &headroom);
+	fclose(f);
+	if (fields < 1 || status < THERMAL_STATUS_NONE || status > THERMAL_STATUS_SHUTDOWN) {
+		return false;
+	}
+	sample->status = static_cast<ThermalStatus>(status);
+	sample->headroom = fields == 2 ? headroom : -1.0f;
+	return true;
+}
+
+bool initFileThermalProvider(ThermalProvider* provider, FileThermalContext* context, const char* path) {
+	memset(provider, 0, sizeof(ThermalProvider));
+	if (strlen(path) >= sizeof(context->path)) {
+		LOGE("initFileThermalProvider: path too long: %s", path);
+		return false;
+	}
+	strcpy(context->path, path);
+	provider->context = context;
+	provider->read = fileReadThermal;
+	ThermalSample sample;
+	return fileReadThermal(context, &sample);
+}
+
+const char* thermalStatusName(ThermalStatus status) {
+	static const char* const names[] = { "none", "light", "moderate", "severe", "critical", "emergency", "shutdown" };
+	if (status < THERMAL_STATUS_NONE || status > THERMAL_STATUS_SHUTDOWN) {
+		return "unknown";
+	}
+	return names[status];
+}
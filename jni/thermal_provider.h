@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// Values match AThermalStatus in the NDK's android/thermal.h.
+enum ThermalStatus {
+	THERMAL_STATUS_UNKNOWN = -1,
+	THERMAL_STATUS_NONE = 0,
+	THERMAL_STATUS_LIGHT,
+	THERMAL_STATUS_MODERATE,
+	THERMAL_STATUS_SEVERE,
+	THERMAL_STATUS_CRITICAL,
+	THERMAL_STATUS_EMERGENCY,
+	THERMAL_STATUS_SHUTDOWN
+};
+
+struct ThermalSample {
+	ThermalStatus status;
+	// forecast fraction of the throttling threshold, where 1 means throttling; negative if unknown
+	float headroom;
+};
+
+// Thermal state comes either from the platform's thermal service or from a text file, which
+// stands in for it on the host and lets a recorded trace be replayed on a device.
+struct ThermalProvider {
+	void* context;
+	// Returns false if nothing could be read; the sample is untouched then.
+	bool (*read)(void* context, ThermalSample* sample);
+};
+
+// The NDK thermal API (API level 30, headroom 31) resolved from libandroid.so at run time,
+// since the android-19 headers predate it.
+struct AndroidThermalContext {
+	void* library;
+	void* manager;
+	int (*getCurrentThermalStatus)(void* manager);
+	float (*getThermalHeadroom)(void* manager, int forecastSeconds); // NULL before API level 31
+	void (*releaseManager)(void* manager);
+};
+
+// Returns false if the platform has no thermal API.
+bool initAndroidThermalProvider(ThermalProvider* provider, AndroidThermalContext* context);
+void termAndroidThermalProvider(AndroidThermalContext* context);
+
+#define FILE_THERMAL_MAX_PATH 256
+
+struct FileThermalContext {
+	char path[FILE_THERMAL_MAX_PATH];
+};
+
+// The file holds a status, optionally followed by a headroom: "2 0.85". It is read again on every
+// call, so whatever writes it drives the provider. Returns false if the file can't be read now.
+bool initFileThermalProvider(ThermalProvider* provider, FileThermalContext* context, const char* path);
+
+static inline bool readThermalSample(const ThermalProvider* provider, ThermalSample* sample) {
+	return provider->read(provider->context, sample);
+}
+
+const char* thermalStatusName(ThermalStatus status);
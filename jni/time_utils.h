@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t nowNanoseconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
@@ -0,0 +1,208 @@
+#include "touch_predictor.h"
+
+#include <math.h>
+#include <string.h>
+
+const TouchPredictorConfig defaultTouchPredictorConfig = {
+	50000000, // 50 ms fit window
+	50000000, // 50 ms horizon
+	1,
+	0.8f,
+	8000.0f
+};
+
+void initTouchPredictor(TouchPredictor* predictor, const TouchPredictorConfig* config) {
+	memset(predictor, 0, sizeof(TouchPredictor));
+	predictor->config = *config;
+}
+
+void resetTouchPredictor(TouchPredictor* predictor) {
+	predictor->historyCount = 0;
+	predictor->historyHead = 0;
+	predictor->pendingCount = 0;
+}
+
+static const TouchSample* historySample(const TouchPredictor* predictor, int32_t age) {
+	return &predictor->history[(predictor->historyHead - age + TOUCH_HISTORY_SIZE) % TOUCH_HISTORY_SIZE];
+}
+
+static void scorePendingPredictions(TouchPredictor* predictor, const TouchSample* previous, const TouchSample* sample) {
+	int32_t kept = 0;
+	for (int32_t i = 0; i < predictor->pendingCount; ++i) {
+		const TouchPrediction* prediction = &predictor->pending[i];
+		if (prediction->targetNanoseconds > sample->nanoseconds) {
+			predictor->pending[kept++] = *prediction;
+			continue;
+		}
+		if (prediction->targetNanoseconds < previous->nanoseconds) {
+			// target fell in a gap before the samples we have, nothing to compare against
+			continue;
+		}
+		int64_t span = sample->nanoseconds - previous->nanoseconds;
+		float t = span > 0 ? static_cast<float>(prediction->targetNanoseconds - previous->nanoseconds) / span : 1.0f;
+		float actualX = previous->x + (sample->x - previous->x) * t;
+		float actualY = previous->y + (sample->y - previous->y) * t;
+
+		float error = hypotf(prediction->x - actualX, prediction->y - actualY);
+		float baselineError = hypotf(prediction->baselineX - actualX, prediction->baselineY - actualY);
+		TouchPredictionStats* stats = &predictor->stats;
+		++stats->count;
+		stats->errorSum += error;
+		stats->errorSquaredSum += static_cast<double>(error) * error;
+		stats->baselineErrorSum += baselineError;
+		if (error > stats->maxError) {
+			stats->maxError = error;
+		}
+		if (baselineError > stats->maxBaselineError) {
+			stats->maxBaselineError = baselineError;
+		}
+	}
+	predictor->pendingCount = kept;
+}
+
+void addTouchSample(TouchPredictor* predictor, float x, float y, int64_t nanoseconds) {
+	if (predictor->historyCount > 0) {
+		const TouchSample* newest = historySample(predictor, 0);
+		if (nanoseconds < newest->nanoseconds) {
+			return;
+		}
+		if (nanoseconds == newest->nanoseconds) {
+			// coalesced duplicate, keep the latest position
+			predictor->history[predictor->historyHead].x = x;
+			predictor->history[predictor->historyHead].y = y;
+			return;
+		}
+	}
+
+	predictor->historyHead = (predictor->historyHead + 1) % TOUCH_HISTORY_SIZE;
+	TouchSample* sample = &predictor->history[predictor->historyHead];
+	sample->x = x;
+	sample->y = y;
+	sample->nanoseconds = nanoseconds;
+	if (predictor->historyCount < TOUCH_HISTORY_SIZE) {
+		++predictor->historyCount;
+	}
+
+	if (predictor->historyCount > 1) {
+		scorePendingPredictions(predictor, historySample(predictor, 1), sample);
+	}
+}
+
+// Least squares fit of p(t) = p0 + v t + a t^2 / 2 with t relative to the newest sample, solved
+// with the normal equations. order selects how many of the terms are fitted.
+static void fitHistory(const TouchPredictor* predictor, int32_t samples, int32_t order, float velocity[2], float acceleration[2]) {
+	const TouchSample* newest = historySample(predictor, 0);
+	double m[3][3] = { { 0 } };
+	double rhs[2][3] = { { 0 } };
+	for (int32_t i = 0; i < samples; ++i) {
+		const TouchSample* sample = historySample(predictor, i);
+		double t = (sample->nanoseconds - newest->nanoseconds) * 1e-9;
+		double basis[3] = { 1.0, t, 0.5 * t * t };
+		for (int r = 0; r <= order; ++r) {
+			for (int c = 0; c <= order; ++c) {
+				m[r][c] += basis[r] * basis[c];
+			}
+			rhs[0][r] += basis[r] * sample->x;
+			rhs[1][r] += basis[r] * sample->y;
+		}
+	}
+
+	// Gaussian elimination on the (order + 1) square system, both axes at once
+	int32_t n = order + 1;
+	for (int32_t k = 0; k < n; ++k) {
+		if (fabs(m[k][k]) < 1e-18) {
+			velocity[0] = velocity[1] = acceleration[0] = acceleration[1] = 0.0f;
+			return;
+		}
+		for (int32_t r = k + 1; r < n; ++r) {
+			double f = m[r][k] / m[k][k];
+			for (int32_t c = k; c < n; ++c) {
+				m[r][c] -= f * m[k][c];
+			}
+			rhs[0][r] -= f * rhs[0][k];
+			rhs[1][r] -= f * rhs[1][k];
+		}
+	}
+	double solution[2][3] = { { 0 } };
+	for (int32_t axis = 0; axis < 2; ++axis) {
+		for (int32_t r = n - 1; r >= 0; --r) {
+			double sum = rhs[axis][r];
+			for (int32_t c = r + 1; c < n; ++c) {
+				sum -= m[r][c] * solution[axis][c];
+			}
+			solution[axis][r] = sum / m[r][r];
+		}
+		velocity[axis] = static_cast<float>(solution[axis][1]);
+		acceleration[axis] = static_cast<float>(solution[axis][2]);
+	}
+}
+
+bool predictTouch(TouchPredictor* predictor, int64_t targetNanoseconds, float* x, float* y) {
+	if (predictor->historyCount == 0) {
+		return false;
+	}
+	const TouchPredictorConfig* config = &predictor->config;
+	const TouchSample* newest = historySample(predictor, 0);
+
+	int32_t samples = 1;
+	while (samples < predictor->historyCount &&
+		newest->nanoseconds - historySample(predictor, samples)->nanoseconds <= config->fitWindowNanoseconds) {
+		++samples;
+	}
+	// a fit with order + 1 terms needs at least as many samples
+	int32_t order = config->order;
+	if (order > samples - 1) {
+		order = samples - 1;
+	}
+
+	float px = newest->x;
+	float py = newest->y;
+	int64_t horizon = targetNanoseconds - newest->nanoseconds;
+	if (horizon > config->maxHorizonNanoseconds) {
+		horizon = config->maxHorizonNanoseconds;
+	}
+	if (order > 0 && horizon > 0) {
+		float velocity[2], acceleration[2];
+		fitHistory(predictor, samples, order, velocity, acceleration);
+		float t = horizon * 1e-9f;
+		float dx = velocity[0] * t;
+		float dy = velocity[1] * t;
+		if (order > 1) {
+			dx += 0.5f * acceleration[0] * t * t;
+			dy += 0.5f * acceleration[1] * t * t;
+		}
+		dx *= config->gain;
+		dy *= config->gain;
+
+		float distance = hypotf(dx, dy);
+		float maxDistance = config->maxSpeed * t;
+		if (distance > maxDistance) {
+			dx *= maxDistance / distance;
+			dy *= maxDistance / distance;
+		}
+		px += dx;
+		py += dy;
+	}
+	*x = px;
+	*y = py;
+
+	if (predictor->pendingCount == TOUCH_MAX_PENDING_PREDICTIONS) {
+		memmove(&predictor->pending[0], &predictor->pending[1], (TOUCH_MAX_PENDING_PREDICTIONS - 1) * sizeof(TouchPrediction));
+		--predictor->pendingCount;
+	}
+	TouchPrediction* prediction = &predictor->pending[predictor->pendingCount++];
+	prediction->targetNanoseconds = targetNanoseconds;
+	prediction->x = px;
+	prediction->y = py;
+	prediction->baselineX = newest->x;
+	prediction->baselineY = newest->y;
+	return true;
+}
+
+float meanTouchPredictionError(const TouchPredictionStats* stats) {
+	return stats->count ? static_cast<float>(stats->errorSum / stats->count) : 0.0f;
+}
+
+float meanTouchBaselineError(const TouchPredictionStats* stats) {
+	return stats->count ? static_cast<float>(stats->baselineErrorSum / stats->count) : 0.0f;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#define TOUCH_HISTORY_SIZE 32
+#define TOUCH_MAX_PENDING_PREDICTIONS 8
+
+struct TouchSample {
+	float x;
+	float y;
+	int64_t nanoseconds;
+};
+
+struct TouchPredictorConfig {
+	int64_t fitWindowNanoseconds; // samples older than this, relative to the newest, are ignored
+	int64_t maxHorizonNanoseconds; // never extrapolate further ahead than this
+	int32_t order; // 0 holds the last sample, 1 fits velocity, 2 fits velocity and acceleration
+	float gain; // fraction of the extrapolated displacement applied, 0..1
+	float maxSpeed; // pixels per second, limits the extrapolated displacement
+};
+
+// Prediction error, measured once real samples arrive that bracket a prediction's target time.
+// The baseline is the error of drawing the last known sample instead, i.e. no prediction.
+struct TouchPredictionStats {
+	uint32_t count;
+	double errorSum;
+	double errorSquaredSum;
+	float maxError;
+	double baselineErrorSum;
+	float maxBaselineError;
+};
+
+struct TouchPrediction {
+	int64_t targetNanoseconds;
+	float x, y;
+	float baselineX, baselineY;
+};
+
+// Extrapolates a pointer to the time a frame will reach the display, from a least squares fit
+// of its recent history. One stroke at a time: reset it on pointer down, up and cancel.
+struct TouchPredictor {
+	TouchPredictorConfig config;
+	TouchSample history[TOUCH_HISTORY_SIZE];
+	int32_t historyCount;
+	int32_t historyHead; // index of the newest sample
+	TouchPrediction pending[TOUCH_MAX_PENDING_PREDICTIONS];
+	int32_t pendingCount;
+	TouchPredictionStats stats;
+};
+
+extern const TouchPredictorConfig defaultTouchPredictorConfig;
+
+void initTouchPredictor(TouchPredictor* predictor, const TouchPredictorConfig* config);
+void resetTouchPredictor(TouchPredictor* predictor);
+
+// Samples must arrive in time order; historical samples first.
+void addTouchSample(TouchPredictor* predictor, float x, float y, int64_t nanoseconds);
+
+// Returns false if there is no history yet. The prediction is kept for error measurement.
+bool predictTouch(TouchPredictor* predictor, int64_t targetNanoseconds, float* x, float* y);
+
+float meanTouchPredictionError(const TouchPredictionStats* stats);
+float meanTouchBaselineError(const TouchPredictionStats* stats);
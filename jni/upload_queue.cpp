@@ -0,0 +1,312 @@
+#include "upload_queue.h"
+#include "log.h"
+#include "memory_tracker.h"
+#include "time_utils.h"
+
+#include <string.h>
+
+const int64_t uploadFenceTimeoutNanoseconds = 1000000000LL;
+
+int64_t uploadJobBytes(const UploadJob* job) {
+	if (job->type == UPLOAD_BUFFER) {
+		return job->size;
+	}
+	int64_t bytesPerPixel = job->format == GL_RGBA ? 4 : job->format == GL_RGB ? 3 : 1;
+	return bytesPerPixel * job->width * job->height;
+}
+
+// Runs on whichever thread has a context current: the loader, or the poller as a fallback.
+static void createUploadObject(UploadJob* job) {
+	int64_t start = nowNanoseconds();
+	if (job->type == UPLOAD_TEXTURE) {
+		glGenTextures(1, &job->name);
+		glBindTexture(GL_TEXTURE_2D, job->name);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, job->filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, job->filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, job->format, job->width, job->height, 0, job->format, GL_UNSIGNED_BYTE, job->data);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	} else {
+		glGenBuffers(1, &job->name);
+		glBindBuffer(job->target, job->name);
+		glBufferData(job->target, job->size, job->data, GL_STATIC_DRAW);
+		glBindBuffer(job->target, 0);
+	}
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		LOGE("Upload of %lld bytes failed with error 0x%04x", static_cast<long long>(uploadJobBytes(job)), error);
+		if (job->type == UPLOAD_TEXTURE) {
+			glDeleteTextures(1, &job->name);
+		} else {
+			glDeleteBuffers(1, &job->name);
+		}
+		job->name = 0;
+		job->state = UPLOAD_FAILED;
+	} else {
+		trackGpuMemory(job->type == UPLOAD_TEXTURE ? GPU_MEMORY_TEXTURES : GPU_MEMORY_BUFFERS, uploadJobBytes(job));
+		job->state = UPLOAD_FENCED;
+	}
+	job->uploadNanoseconds = nowNanoseconds() - start;
+}
+
+static void* runLoader(void* data) {
+	UploadQueue* queue = static_cast<UploadQueue*>(data);
+	bool current = eglMakeCurrent(queue->display, queue->surface, queue->surface, queue->context) == EGL_TRUE;
+	pthread_mutex_lock(&queue->mutex);
+	queue->loaderStatus = current ? 1 : -1;
+	pthread_cond_broadcast(&queue->cond);
+	if (!current) {
+		LOGE("Loader eglMakeCurrent failed with error 0x%04x", eglGetError());
+		pthread_mutex_unlock(&queue->mutex);
+		return NULL;
+	}
+
+	while (!queue->quit) {
+		UploadJob* job = queue->queued;
+		if (!job) {
+			pthread_cond_wait(&queue->cond, &queue->mutex);
+			continue;
+		}
+		queue->queued = job->next;
+		if (!queue->queued) {
+			queue->queuedTail = NULL;
+		}
+		pthread_mutex_unlock(&queue->mutex);
+
+		createUploadObject(job);
+		if (job->state == UPLOAD_FENCED) {
+			if (queue->fenceProvider) {
+				job->fence = createGpuFence(queue->fenceProvider);
+				// the fence has to reach the GPU before another context can wait on it
+				glFlush();
+			} else {
+				glFinish();
+			}
+		}
+
+		pthread_mutex_lock(&queue->mutex);
+		job->next = NULL;
+		if (queue->uploadedTail) {
+			queue->uploadedTail->next = job;
+		} else {
+			queue->uploaded = job;
+		}
+		queue->uploadedTail = job;
+	}
+
+	// whatever was never started is cancelled; the caller gets it back from termUploadQueue
+	for (UploadJob* job = queue->queued; job; job = job->next) {
+		job->state = UPLOAD_CANCELLED;
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	eglMakeCurrent(queue->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	return NULL;
+}
+
+static void releaseLoader(UploadQueue* queue) {
+	if (queue->threaded) {
+		pthread_mutex_lock(&queue->mutex);
+		queue->quit = true;
+		pthread_cond_broadcast(&queue->cond);
+		pthread_mutex_unlock(&queue->mutex);
+		pthread_join(queue->thread, NULL);
+		queue->threaded = false;
+	}
+	if (queue->context != EGL_NO_CONTEXT) {
+		eglDestroyContext(queue->display, queue->context);
+		queue->context = EGL_NO_CONTEXT;
+	}
+	if (queue->surface != EGL_NO_SURFACE) {
+		eglDestroySurface(queue->display, queue->surface);
+		queue->surface = EGL_NO_SURFACE;
+	}
+	queue->quit = false;
+}
+
+bool initUploadQueue(UploadQueue* queue, EGLDisplay display, EGLContext shareContext, EGLint clientVersion,
+	EGLint renderableType, const GpuFenceProvider* fenceProvider) {
+	memset(queue, 0, sizeof(UploadQueue));
+	queue->display = display;
+	queue->fenceProvider = fenceProvider;
+	queue->context = EGL_NO_CONTEXT;
+	queue->surface = EGL_NO_SURFACE;
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	queue->initialized = true;
+
+	// not every driver can make a context current without a surface, so the loader gets a 1x1 pbuffer
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, renderableType,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+		LOGW("No pbuffer config for the loader, uploading on the render thread");
+		return false;
+	}
+	const EGLint surfaceAttribs[] = {
+		EGL_WIDTH, 1,
+		EGL_HEIGHT, 1,
+		EGL_NONE
+	};
+	queue->surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, clientVersion,
+		EGL_NONE
+	};
+	queue->context = eglCreateContext(display, config, shareContext, contextAttribs);
+	if (queue->surface == EGL_NO_SURFACE || queue->context == EGL_NO_CONTEXT) {
+		LOGW("Could not create the loader context (error 0x%04x), uploading on the render thread", eglGetError());
+		releaseLoader(queue);
+		return false;
+	}
+
+	if (pthread_create(&queue->thread, NULL, runLoader, queue) != 0) {
+		LOGW("Could not start the loader thread, uploading on the render thread");
+		releaseLoader(queue);
+		return false;
+	}
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->loaderStatus == 0) {
+		pthread_cond_wait(&queue->cond, &queue->mutex);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	queue->threaded = true;
+	if (queue->loaderStatus < 0) {
+		releaseLoader(queue);
+		return false;
+	}
+	LOGI("Upload queue: loader thread with a shared context, %s", fenceProvider ? "fenced" : "finished");
+	return true;
+}
+
+static void completeUpload(UploadQueue* queue, UploadJob* job) {
+	if (job->state == UPLOAD_CANCELLED) {
+		queue->stats.cancelled++;
+		if (job->complete) {
+			job->complete(job->completeData, job);
+		}
+		return;
+	}
+	int64_t latency = nowNanoseconds() - job->submitNanoseconds;
+	if (job->state == UPLOAD_FENCED) {
+		job->state = UPLOAD_READY;
+	}
+	UploadStats* stats = &queue->stats;
+	stats->jobs++;
+	if (job->state == UPLOAD_READY) {
+		stats->bytes += uploadJobBytes(job);
+	} else {
+		stats->failed++;
+	}
+	stats->uploadNanoseconds += job->uploadNanoseconds;
+	stats->totalLatencyNanoseconds += latency;
+	if (latency > stats->maxLatencyNanoseconds) {
+		stats->maxLatencyNanoseconds = latency;
+	}
+	if (job->complete) {
+		job->complete(job->completeData, job);
+	}
+}
+
+// Moves what the loader finished onto the fenced list and completes the ones the GPU is done with.
+// With wait set every fence is waited on, for shutting down.
+static void completeFencedUploads(UploadQueue* queue, bool wait) {
+	pthread_mutex_lock(&queue->mutex);
+	UploadJob* uploaded = queue->uploaded;
+	queue->uploaded = NULL;
+	queue->uploadedTail = NULL;
+	pthread_mutex_unlock(&queue->mutex);
+
+	// keep submission order: fenced jobs first, then the new ones
+	UploadJob** tail = &queue->fenced;
+	while (*tail) {
+		tail = &(*tail)->next;
+	}
+	*tail = uploaded;
+
+	UploadJob** link = &queue->fenced;
+	while (*link) {
+		UploadJob* job = *link;
+		if (job->fence) {
+			bool signaled = wait ? waitGpuFence(queue->fenceProvider, job->fence, uploadFenceTimeoutNanoseconds) :
+				isGpuFenceSignaled(queue->fenceProvider, job->fence);
+			if (!signaled) {
+				link = &job->next;
+				continue;
+			}
+			destroyGpuFence(queue->fenceProvider, job->fence);
+			job->fence = NULL;
+		}
+		*link = job->next;
+		job->next = NULL;
+		completeUpload(queue, job);
+	}
+}
+
+void termUploadQueue(UploadQueue* queue) {
+	// never initialised, or already terminated
+	if (!queue->initialized) {
+		return;
+	}
+	releaseLoader(queue);
+	completeFencedUploads(queue, true);
+	// queued jobs are cancelled rather than left dangling; their handlers must not create anything
+	// while the display is going away
+	while (queue->queued) {
+		UploadJob* job = queue->queued;
+		queue->queued = job->next;
+		job->next = NULL;
+		job->state = UPLOAD_CANCELLED;
+		completeUpload(queue, job);
+	}
+	queue->queuedTail = NULL;
+	pthread_cond_destroy(&queue->cond);
+	pthread_mutex_destroy(&queue->mutex);
+	queue->initialized = false;
+}
+
+void submitUpload(UploadQueue* queue, UploadJob* job) {
+	job->state = UPLOAD_QUEUED;
+	job->name = 0;
+	job->fence = NULL;
+	job->uploadNanoseconds = 0;
+	job->submitNanoseconds = nowNanoseconds();
+	job->next = NULL;
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->queuedTail) {
+		queue->queuedTail->next = job;
+	} else {
+		queue->queued = job;
+	}
+	queue->queuedTail = job;
+	pthread_cond_signal(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+void pollUploads(UploadQueue* queue, int64_t budgetNanoseconds) {
+	int64_t start = nowNanoseconds();
+	if (queue->threaded) {
+		completeFencedUploads(queue, false);
+	} else {
+		// no loader: spread the work over frames instead
+		while (queue->queued) {
+			UploadJob* job = queue->queued;
+			queue->queued = job->next;
+			job->next = NULL;
+			createUploadObject(job);
+			completeUpload(queue, job);
+			if (nowNanoseconds() - start >= budgetNanoseconds) {
+				break;
+			}
+		}
+		if (!queue->queued) {
+			queue->queuedTail = NULL;
+		}
+	}
+	queue->stats.pollNanoseconds += nowNanoseconds() - start;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "gpu_fence.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <pthread.h>
+#include <stdint.h>
+
+enum UploadType {
+	UPLOAD_TEXTURE,
+	UPLOAD_BUFFER
+};
+
+enum UploadState {
+	UPLOAD_IDLE,
+	UPLOAD_QUEUED,
+	UPLOAD_FENCED, // created, waiting for the GPU to finish with it
+	UPLOAD_READY,
+	UPLOAD_FAILED,
+	UPLOAD_CANCELLED // never started because the queue was shut down; nothing was created
+};
+
+struct UploadJob;
+
+typedef void (*UploadCompleteFunction)(void* data, UploadJob* job);
+
+// Owned by the caller and must stay alive, with its data unchanged, until complete has been called.
+struct UploadJob {
+	UploadType type;
+	GLenum format; // textures: GL_RGBA, GL_RGB, GL_LUMINANCE or GL_ALPHA, in unsigned bytes
+	GLint filter; // textures
+	int32_t width;
+	int32_t height;
+	GLenum target; // buffers: GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+	GLsizeiptr size; // buffers
+	const void* data;
+	UploadCompleteFunction complete; // runs on the thread calling pollUploads, with state READY, FAILED or CANCELLED
+	void* completeData;
+
+	// set by the queue
+	UploadState state;
+	GLuint name;
+	GpuFence fence;
+	int64_t submitNanoseconds;
+	int64_t uploadNanoseconds; // spent creating the object
+	UploadJob* next;
+};
+
+struct UploadStats {
+	uint64_t jobs;
+	uint64_t bytes;
+	uint32_t failed;
+	uint32_t cancelled; // not counted in jobs
+	int64_t uploadNanoseconds;
+	int64_t totalLatencyNanoseconds; // submit to complete
+	int64_t maxLatencyNanoseconds;
+	int64_t pollNanoseconds; // spent in pollUploads, i.e. on the render thread
+};
+
+// Creates GL textures and buffers on a loader thread whose context shares objects with the render
+// context, so uploads stay out of frame time. Each object is fenced after creation and only handed
+// back, by pollUploads on the render thread, once the fence has signaled; without fences the loader
+// finishes every upload instead. If the loader can't be set up the queue still works, uploading on
+// the polling thread.
+struct UploadQueue {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool initialized; // the mutex and cond exist; cleared by termUploadQueue
+	bool threaded;
+	bool quit;
+	int32_t loaderStatus; // 0 while the loader starts, 1 once its context is current, -1 if that failed
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface;
+	const GpuFenceProvider* fenceProvider;
+	UploadJob* queued; // for the loader
+	UploadJob* queuedTail;
+	UploadJob* uploaded; // by the loader, not seen by pollUploads yet
+	UploadJob* uploadedTail;
+	UploadJob* fenced; // only touched by the polling thread
+	UploadStats stats;
+};
+
+// shareContext must be current on the calling thread, which is the one that polls. Returns true if
+// the loader thread is running. fenceProvider may be NULL.
+bool initUploadQueue(UploadQueue* queue, EGLDisplay display, EGLContext shareContext, EGLint clientVersion,
+	EGLint renderableType, const GpuFenceProvider* fenceProvider);
+// Stops the loader and completes everything it already created; the share context must still be current.
+// Jobs it never started complete as CANCELLED, which their handlers should treat as nothing to do.
+// Does nothing on a zeroed queue or one already terminated.
+void termUploadQueue(UploadQueue* queue);
+
+void submitUpload(UploadQueue* queue, UploadJob* job);
+
+// Completes the jobs whose objects are ready. Without a loader thread this uploads queued jobs
+// instead, until budgetNanoseconds is used up (but at least one).
+void pollUploads(UploadQueue* queue, int64_t budgetNanoseconds);
+
+int64_t uploadJobBytes(const UploadJob* job);
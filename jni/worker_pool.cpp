@@ -0,0 +1,111 @@
+#include "worker_pool.h"
+#include "log.h"
+
+#include <string.h>
+#include <unistd.h>
+
+// Called and returns with the mutex held.
+static void runChunks(WorkerPool* pool) {
+	while (pool->nextIndex < pool->count) {
+		int32_t begin = pool->nextIndex;
+		int32_t end = begin + pool->grain < pool->count ? begin + pool->grain : pool->count;
+		pool->nextIndex = end;
+		ParallelJob job = pool->job;
+		void* data = pool->data;
+
+		pthread_mutex_unlock(&pool->mutex);
+		job(data, begin, end);
+		pthread_mutex_lock(&pool->mutex);
+
+		pool->completed += end - begin;
+		if (pool->completed == pool->count) {
+			pthread_cond_broadcast(&pool->doneCond);
+		}
+	}
+}
+
+static void* workerMain(void* param) {
+	WorkerPool* pool = static_cast<WorkerPool*>(param);
+	pthread_mutex_lock(&pool->mutex);
+	while (true) {
+		while (!pool->quit && pool->nextIndex >= pool->count) {
+			pthread_cond_wait(&pool->workCond, &pool->mutex);
+		}
+		if (pool->quit) {
+			break;
+		}
+		runChunks(pool);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+bool initWorkerPool(WorkerPool* pool, int32_t threadCount) {
+	memset(pool, 0, sizeof(WorkerPool));
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->workCond, NULL);
+	pthread_cond_init(&pool->doneCond, NULL);
+
+	if (threadCount > WORKER_POOL_MAX_THREADS) {
+		threadCount = WORKER_POOL_MAX_THREADS;
+	}
+	for (int32_t i = 0; i < threadCount; ++i) {
+		if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) {
+			LOGE("Could not start worker thread %d", i);
+			termWorkerPool(pool);
+			return false;
+		}
+		pool->threadCount = i + 1;
+	}
+	return true;
+}
+
+void termWorkerPool(WorkerPool* pool) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->workCond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (int32_t i = 0; i < pool->threadCount; ++i) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->doneCond);
+	pthread_cond_destroy(&pool->workCond);
+	pthread_mutex_destroy(&pool->mutex);
+	pool->threadCount = 0;
+}
+
+int32_t defaultWorkerThreadCount() {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores <= 1) {
+		return 0;
+	}
+	return cores - 1 < WORKER_POOL_MAX_THREADS ? cores - 1 : WORKER_POOL_MAX_THREADS;
+}
+
+void runParallel(WorkerPool* pool, ParallelJob job, void* data, int32_t count, int32_t grain) {
+	if (count <= 0) {
+		return;
+	}
+	if (grain < 1) {
+		grain = 1;
+	}
+	if (pool->threadCount == 0 || count <= grain) {
+		job(data, 0, count);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->job = job;
+	pool->data = data;
+	pool->count = count;
+	pool->grain = grain;
+	pool->nextIndex = 0;
+	pool->completed = 0;
+	pthread_cond_broadcast(&pool->workCond);
+
+	runChunks(pool);
+	while (pool->completed < pool->count) {
+		pthread_cond_wait(&pool->doneCond, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
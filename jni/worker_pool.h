@@ -0,0 +1,35 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define WORKER_POOL_MAX_THREADS 8
+
+// Processes the index range [begin, end).
+typedef void (*ParallelJob)(void* data, int32_t begin, int32_t end);
+
+// Fixed set of threads that help the calling thread with one data-parallel job at a time.
+struct WorkerPool {
+	pthread_t threads[WORKER_POOL_MAX_THREADS];
+	int32_t threadCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t workCond;
+	pthread_cond_t doneCond;
+	ParallelJob job;
+	void* data;
+	int32_t count;
+	int32_t grain;
+	int32_t nextIndex;
+	int32_t completed;
+	bool quit;
+};
+
+// Starts threadCount helper threads, clamped to WORKER_POOL_MAX_THREADS; 0 runs everything on the caller.
+bool initWorkerPool(WorkerPool* pool, int32_t threadCount);
+void termWorkerPool(WorkerPool* pool);
+
+// Number of helper threads worth starting on this device, leaving one core for the caller.
+int32_t defaultWorkerThreadCount();
+
+// Splits [0, count) into chunks of grain items and returns once all of them have run.
+void runParallel(WorkerPool* pool, ParallelJob job, void* data, int32_t count, int32_t grain);
@@ -0,0 +1,436 @@
+#include "atlas_packer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Rectangles here are in cells of the mip alignment.
+struct PackRect {
+	uint32_t x, y, width, height;
+};
+
+struct SkylineNode {
+	uint32_t x, y, width;
+};
+
+struct PackPage {
+	std::vector<PackRect> freeRects; // MaxRects: the maximal free rectangles
+	std::vector<SkylineNode> skyline;
+	uint32_t usedWidth;
+	uint32_t usedHeight;
+};
+
+static uint32_t nextPowerOfTwo(uint32_t value) {
+	uint32_t power = 1;
+	while (power < value) {
+		power <<= 1;
+	}
+	return power;
+}
+
+static bool contains(const PackRect& outer, const PackRect& inner) {
+	return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width &&
+		inner.y + inner.height <= outer.y + outer.height;
+}
+
+static void initPage(PackPage* page, uint32_t width, uint32_t height, bool skyline) {
+	page->usedWidth = 0;
+	page->usedHeight = 0;
+	if (skyline) {
+		SkylineNode node = { 0, 0, width };
+		page->skyline.push_back(node);
+	} else {
+		PackRect rect = { 0, 0, width, height };
+		page->freeRects.push_back(rect);
+	}
+}
+
+// Best short side fit: the free rectangle that leaves the least on its shorter side, then on its
+// longer side.
+static bool findMaxRectsPosition(const PackPage& page, uint32_t width, uint32_t height, PackRect* found) {
+	uint32_t bestShort = UINT32_MAX;
+	uint32_t bestLong = UINT32_MAX;
+	for (size_t i = 0; i < page.freeRects.size(); ++i) {
+		const PackRect& free = page.freeRects[i];
+		if (free.width < width || free.height < height) {
+			continue;
+		}
+		uint32_t leftX = free.width - width;
+		uint32_t leftY = free.height - height;
+		uint32_t shortSide = std::min(leftX, leftY);
+		uint32_t longSide = std::max(leftX, leftY);
+		if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+			bestShort = shortSide;
+			bestLong = longSide;
+			found->x = free.x;
+			found->y = free.y;
+		}
+	}
+	found->width = width;
+	found->height = height;
+	return bestShort != UINT32_MAX;
+}
+
+static void placeMaxRects(PackPage* page, const PackRect& used) {
+	std::vector<PackRect> kept;
+	std::vector<PackRect> added;
+	kept.reserve(page->freeRects.size());
+	for (size_t i = 0; i < page->freeRects.size(); ++i) {
+		const PackRect& free = page->freeRects[i];
+		if (used.x >= free.x + free.width || used.x + used.width <= free.x || used.y >= free.y + free.height ||
+			used.y + used.height <= free.y) {
+			kept.push_back(free);
+			continue;
+		}
+		// up to four maximal rectangles around the used one
+		if (used.x > free.x) {
+			PackRect rect = { free.x, free.y, used.x - free.x, free.height };
+			added.push_back(rect);
+		}
+		if (used.x + used.width < free.x + free.width) {
+			PackRect rect = { used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height };
+			added.push_back(rect);
+		}
+		if (used.y > free.y) {
+			PackRect rect = { free.x, free.y, free.width, used.y - free.y };
+			added.push_back(rect);
+		}
+		if (used.y + used.height < free.y + free.height) {
+			PackRect rect = { free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height };
+			added.push_back(rect);
+		}
+	}
+	// the kept rectangles were maximal already, so only the new ones can be redundant
+	for (size_t i = 0; i < added.size(); ++i) {
+		bool redundant = false;
+		for (size_t j = 0; j < kept.size() && !redundant; ++j) {
+			redundant = contains(kept[j], added[i]);
+		}
+		for (size_t j = 0; j < added.size() && !redundant; ++j) {
+			// of two equal rectangles, keep the first
+			redundant = j != i && contains(added[j], added[i]) && (j < i || !contains(added[i], added[j]));
+		}
+		if (!redundant) {
+			kept.push_back(added[i]);
+		}
+	}
+	page->freeRects.swap(kept);
+}
+
+// Bottom-left: the position with the lowest top, then the leftmost.
+static bool findSkylinePosition(const PackPage& page, uint32_t pageWidth, uint32_t pageHeight, uint32_t width, uint32_t height, PackRect* found,
+	size_t* foundNode) {
+	uint32_t bestTop = UINT32_MAX;
+	for (size_t i = 0; i < page.skyline.size(); ++i) {
+		uint32_t x = page.skyline[i].x;
+		if (x + width > pageWidth) {
+			break;
+		}
+		uint32_t y = 0;
+		uint32_t covered = 0;
+		for (size_t j = i; covered < width; ++j) {
+			y = std::max(y, page.skyline[j].y);
+			covered += page.skyline[j].width;
+		}
+		if (y + height <= pageHeight && y + height < bestTop) {
+			bestTop = y + height;
+			found->x = x;
+			found->y = y;
+			*foundNode = i;
+		}
+	}
+	found->width = width;
+	found->height = height;
+	return bestTop != UINT32_MAX;
+}
+
+static void placeSkyline(PackPage* page, const PackRect& used, size_t node) {
+	std::vector<SkylineNode>& skyline = page->skyline;
+	SkylineNode top = { used.x, used.y + used.height, used.width };
+	skyline.insert(skyline.begin() + node, top);
+	// trim or remove the nodes the new one covers
+	size_t i = node + 1;
+	while (i < skyline.size() && skyline[i].x < used.x + used.width) {
+		uint32_t end = skyline[i].x + skyline[i].width;
+		if (end <= used.x + used.width) {
+			skyline.erase(skyline.begin() + i);
+		} else {
+			skyline[i].width = end - (used.x + used.width);
+			skyline[i].x = used.x + used.width;
+			break;
+		}
+	}
+	for (size_t j = 0; j + 1 < skyline.size();) {
+		if (skyline[j].y == skyline[j + 1].y) {
+			skyline[j].width += skyline[j + 1].width;
+			skyline.erase(skyline.begin() + j + 1);
+		} else {
+			++j;
+		}
+	}
+}
+
+// Packs the cells in order, first fit over the pages and opening a new one when none has room. On
+// success cells[i] holds the position of cell order[i] and pages[i] the page it is on.
+static bool packCells(const std::vector<uint32_t>& order, std::vector<PackRect>* cells, std::vector<uint32_t>* cellPages,
+	std::vector<PackPage>* pages, uint32_t pageWidth, uint32_t pageHeight, size_t maxPages, bool skyline) {
+	pages->clear();
+	for (size_t i = 0; i < order.size(); ++i) {
+		PackRect* used = &(*cells)[order[i]];
+		if (used->width > pageWidth || used->height > pageHeight) {
+			return false;
+		}
+		size_t node = 0;
+		size_t page = 0;
+		for (;; ++page) {
+			if (page == pages->size()) {
+				if (pages->size() == maxPages) {
+					return false;
+				}
+				pages->push_back(PackPage());
+				initPage(&pages->back(), pageWidth, pageHeight, skyline);
+			}
+			bool found = skyline ? findSkylinePosition((*pages)[page], pageWidth, pageHeight, used->width, used->height, used, &node) :
+				findMaxRectsPosition((*pages)[page], used->width, used->height, used);
+			if (found) {
+				break;
+			}
+		}
+		PackPage* target = &(*pages)[page];
+		if (skyline) {
+			placeSkyline(target, *used, node);
+		} else {
+			placeMaxRects(target, *used);
+		}
+		target->usedWidth = std::max(target->usedWidth, used->x + used->width);
+		target->usedHeight = std::max(target->usedHeight, used->y + used->height);
+		(*cellPages)[order[i]] = static_cast<uint32_t>(page);
+	}
+	return true;
+}
+
+// The smallest power of two page the last page's cells fit, tried from the smallest area up; a
+// page that is filled first fit has its cells spread over all of it.
+static void shrinkLastPage(const std::vector<uint32_t>& order, std::vector<PackRect>* cells, std::vector<uint32_t>* cellPages,
+	std::vector<PackPage>* pages, uint32_t pageCells, bool skyline) {
+	uint32_t last = static_cast<uint32_t>(pages->size() - 1);
+	std::vector<uint32_t> lastOrder;
+	uint64_t area = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if ((*cellPages)[order[i]] == last) {
+			lastOrder.push_back(order[i]);
+			area += static_cast<uint64_t>((*cells)[order[i]].width) * (*cells)[order[i]].height;
+		}
+	}
+	std::vector<PackRect> sizes;
+	for (uint32_t width = 1; width <= pageCells; width <<= 1) {
+		for (uint32_t height = std::max(width / 2, 1u); height <= std::min(width * 2, pageCells); height <<= 1) {
+			PackRect size = { 0, 0, width, height };
+			if (static_cast<uint64_t>(width) * height >= area && static_cast<uint64_t>(width) * height < static_cast<uint64_t>(pageCells) * pageCells) {
+				sizes.push_back(size);
+			}
+		}
+	}
+	std::stable_sort(sizes.begin(), sizes.end(), [](const PackRect& a, const PackRect& b) {
+		return a.width * a.height < b.width * b.height;
+	});
+	std::vector<PackRect> trial(*cells);
+	std::vector<uint32_t> trialPages(*cellPages);
+	std::vector<PackPage> trialPage;
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		if (packCells(lastOrder, &trial, &trialPages, &trialPage, sizes[i].width, sizes[i].height, 1, skyline)) {
+			for (size_t j = 0; j < lastOrder.size(); ++j) {
+				(*cells)[lastOrder[j]] = trial[lastOrder[j]];
+			}
+			(*pages)[last] = trialPage[0];
+			return;
+		}
+	}
+}
+
+bool packAtlas(const std::vector<AtlasImage>& images, const AtlasPackOptions& options, AtlasLayout* layout) {
+	uint32_t alignment = 1u << options.mipLevels;
+	// a bilinear sample at the image's edge reaches half a texel out, on every level kept apart
+	layout->padding = std::max(options.padding, options.mipLevels > 0 ? alignment / 2 : 0);
+	layout->placements.assign(images.size(), AtlasPlacement());
+	layout->pages.clear();
+	layout->imagePixels = 0;
+	layout->cellPixels = 0;
+	layout->pagePixels = 0;
+	uint32_t pageCells = options.pageSize / alignment;
+
+	std::vector<PackRect> cells(images.size());
+	std::vector<uint32_t> order(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		const AtlasImage& image = images[i];
+		cells[i].width = (image.width + 2 * layout->padding + alignment - 1) / alignment;
+		cells[i].height = (image.height + 2 * layout->padding + alignment - 1) / alignment;
+		if (image.width == 0 || image.height == 0 || cells[i].width > pageCells || cells[i].height > pageCells) {
+			fprintf(stderr, "%s: %ux%u with padding does not fit a %u page\n", image.name.c_str(), image.width, image.height, options.pageSize);
+			return false;
+		}
+		layout->imagePixels += static_cast<uint64_t>(image.width) * image.height;
+		layout->cellPixels += static_cast<uint64_t>(cells[i].width) * cells[i].height * alignment * alignment;
+		order[i] = static_cast<uint32_t>(i);
+	}
+	// larger sides first, so small images fill the gaps the large ones leave
+	std::stable_sort(order.begin(), order.end(), [&cells](uint32_t a, uint32_t b) {
+		uint32_t sideA = std::max(cells[a].width, cells[a].height);
+		uint32_t sideB = std::max(cells[b].width, cells[b].height);
+		if (sideA != sideB) {
+			return sideA > sideB;
+		}
+		return cells[a].width * cells[a].height > cells[b].width * cells[b].height;
+	});
+
+	std::vector<uint32_t> cellPages(images.size());
+	std::vector<PackPage> pages;
+	if (!packCells(order, &cells, &cellPages, &pages, pageCells, pageCells, ATLAS_MAX_PAGES, options.skyline)) {
+		fprintf(stderr, "the images need more than %d pages of %u\n", ATLAS_MAX_PAGES, options.pageSize);
+		return false;
+	}
+	if (!pages.empty()) {
+		shrinkLastPage(order, &cells, &cellPages, &pages, pageCells, options.skyline);
+	}
+
+	for (size_t i = 0; i < images.size(); ++i) {
+		AtlasPlacement* placement = &layout->placements[i];
+		placement->page = cellPages[i];
+		placement->x = cells[i].x * alignment + layout->padding;
+		placement->y = cells[i].y * alignment + layout->padding;
+	}
+	// pages are cut down to the power of two extents their cells cover
+	for (size_t i = 0; i < pages.size(); ++i) {
+		AtlasPageSize size;
+		size.width = nextPowerOfTwo(pages[i].usedWidth * alignment);
+		size.height = nextPowerOfTwo(pages[i].usedHeight * alignment);
+		layout->pages.push_back(size);
+		layout->pagePixels += static_cast<uint64_t>(size.width) * size.height;
+	}
+	return true;
+}
+
+void composeAtlasPages(const std::vector<AtlasImage>& images, const AtlasPackOptions& options, const AtlasLayout& layout,
+	std::vector<std::vector<uint8_t> >* pages) {
+	uint32_t alignment = 1u << options.mipLevels;
+	pages->resize(layout.pages.size());
+	for (size_t i = 0; i < layout.pages.size(); ++i) {
+		(*pages)[i].assign(static_cast<size_t>(layout.pages[i].width) * layout.pages[i].height * 4, 0);
+	}
+	for (size_t i = 0; i < images.size(); ++i) {
+		const AtlasImage& image = images[i];
+		const AtlasPlacement& placement = layout.placements[i];
+		uint32_t pageWidth = layout.pages[placement.page].width;
+		uint8_t* page = &(*pages)[placement.page][0];
+		uint32_t cellX = placement.x - layout.padding;
+		uint32_t cellY = placement.y - layout.padding;
+		uint32_t cellWidth = (image.width + 2 * layout.padding + alignment - 1) / alignment * alignment;
+		uint32_t cellHeight = (image.height + 2 * layout.padding + alignment - 1) / alignment * alignment;
+		uint32_t left = placement.x - cellX;
+		uint32_t right = cellWidth - left - image.width;
+		for (uint32_t y = 0; y < cellHeight; ++y) {
+			// rows above and below repeat the first and last rows
+			uint32_t sourceY = y < layout.padding ? 0 : std::min(y - layout.padding, image.height - 1);
+			const uint8_t* source = &image.pixels[static_cast<size_t>(sourceY) * image.width * 4];
+			uint8_t* row = page + (static_cast<size_t>(cellY + y) * pageWidth + cellX) * 4;
+			for (uint32_t x = 0; x < left; ++x) {
+				memcpy(row + x * 4, source, 4);
+			}
+			memcpy(row + left * 4, source, image.width * 4);
+			const uint8_t* last = source + (image.width - 1) * 4;
+			for (uint32_t x = 0; x < right; ++x) {
+				memcpy(row + (left + image.width + x) * 4, last, 4);
+			}
+		}
+	}
+}
+
+static size_t alignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool writeAtlas(const char* path, const std::vector<AtlasImage>& images, const AtlasPackOptions& options, const AtlasLayout& layout,
+	const std::vector<std::vector<uint8_t> >& pages, size_t* indexSize, size_t* fileSize) {
+	AtlasFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = ATLAS_FILE_MAGIC;
+	header.version = ATLAS_FILE_VERSION;
+	header.pageCount = static_cast<uint32_t>(layout.pages.size());
+	header.entryCount = static_cast<uint32_t>(images.size());
+	// at most half full, so probes stay short
+	header.slotCount = 2;
+	while (header.slotCount < 2 * header.entryCount) {
+		header.slotCount <<= 1;
+	}
+	header.padding = layout.padding;
+	header.mipLevels = options.mipLevels;
+	header.pagesOffset = sizeof(AtlasFileHeader);
+	header.entriesOffset = header.pagesOffset + header.pageCount * sizeof(AtlasPageDesc);
+	header.slotsOffset = header.entriesOffset + header.entryCount * sizeof(AtlasEntry);
+
+	std::vector<AtlasEntry> entries(images.size());
+	std::vector<uint32_t> slots(header.slotCount, ATLAS_EMPTY_SLOT);
+	for (size_t i = 0; i < images.size(); ++i) {
+		const AtlasImage& image = images[i];
+		const AtlasPlacement& placement = layout.placements[i];
+		const AtlasPageSize& page = layout.pages[placement.page];
+		uint64_t hash = atlasNameHash(image.name.c_str());
+		AtlasEntry* entry = &entries[i];
+		memset(entry, 0, sizeof(AtlasEntry));
+		entry->nameHashLow = static_cast<uint32_t>(hash);
+		entry->nameHashHigh = static_cast<uint32_t>(hash >> 32);
+		entry->uv[0] = static_cast<float>(placement.x) / page.width;
+		entry->uv[1] = static_cast<float>(placement.y) / page.height;
+		entry->uv[2] = static_cast<float>(placement.x + image.width) / page.width;
+		entry->uv[3] = static_cast<float>(placement.y + image.height) / page.height;
+		entry->page = static_cast<uint16_t>(placement.page);
+		entry->width = static_cast<uint16_t>(image.width);
+		entry->height = static_cast<uint16_t>(image.height);
+
+		uint32_t slot = atlasHomeSlot(hash, header.slotCount);
+		uint32_t probe = 0;
+		for (; slots[slot] != ATLAS_EMPTY_SLOT; ++probe) {
+			const AtlasEntry& other = entries[slots[slot]];
+			if (other.nameHashLow == entry->nameHashLow && other.nameHashHigh == entry->nameHashHigh) {
+				fprintf(stderr, "%s and %s have the same name hash; rename one\n", images[slots[slot]].name.c_str(), image.name.c_str());
+				return false;
+			}
+			slot = (slot + 1) & (header.slotCount - 1);
+		}
+		slots[slot] = static_cast<uint32_t>(i);
+		header.maxProbe = std::max(header.maxProbe, probe);
+	}
+
+	*indexSize = header.slotsOffset + header.slotCount * sizeof(uint32_t);
+	std::vector<AtlasPageDesc> descs(layout.pages.size());
+	size_t offset = alignUp(*indexSize, ATLAS_PIXEL_ALIGNMENT);
+	for (size_t i = 0; i < descs.size(); ++i) {
+		descs[i].width = layout.pages[i].width;
+		descs[i].height = layout.pages[i].height;
+		descs[i].pixelOffset = static_cast<uint32_t>(offset);
+		descs[i].pixelSize = static_cast<uint32_t>(pages[i].size());
+		offset = alignUp(offset + pages[i].size(), ATLAS_PIXEL_ALIGNMENT);
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(descs.data(), sizeof(AtlasPageDesc), descs.size(), file);
+	fwrite(entries.data(), sizeof(AtlasEntry), entries.size(), file);
+	fwrite(slots.data(), sizeof(uint32_t), slots.size(), file);
+	for (size_t i = 0; i < pages.size(); ++i) {
+		fseek(file, descs[i].pixelOffset, SEEK_SET);
+		fwrite(pages[i].data(), 1, pages[i].size(), file);
+	}
+	*fileSize = descs.empty() ? *indexSize : descs.back().pixelOffset + descs.back().pixelSize;
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "Could not write %s\n", path);
+	}
+	return ok;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Packs RGBA8 images into power-of-two atlas pages and writes them in the format in
+// jni/atlas_format.h. Used by tools/atlas_tool.cpp and host/atlas_bench.cpp.
+//
+// Each image gets a cell of its size plus padding on every side, rounded up to the mip alignment
+// of 2^mipLevels pixels, and the cells are packed on a grid of that alignment. The image's edges
+// are repeated over the rest of its cell. A texel of any of the first mipLevels levels then covers
+// a single cell, and so does a bilinear sample at the image's edge as long as the padding is at
+// least half a texel of the deepest of those levels, which packAtlas makes sure of.
+
+#include "../jni/atlas_format.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+struct AtlasImage {
+	std::string name;
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> pixels; // RGBA8, rows top to bottom
+};
+
+struct AtlasPackOptions {
+	uint32_t pageSize; // the largest page, a power of two
+	uint32_t padding;
+	uint32_t mipLevels;
+	bool skyline; // skyline bottom-left instead of MaxRects best short side fit
+};
+
+struct AtlasPlacement {
+	uint32_t page;
+	uint32_t x; // of the image's first pixel, not of its cell
+	uint32_t y;
+};
+
+struct AtlasPageSize {
+	uint32_t width;
+	uint32_t height;
+};
+
+struct AtlasLayout {
+	uint32_t padding; // the padding used, which can be more than asked for
+	std::vector<AtlasPlacement> placements; // one per image, in the order given
+	std::vector<AtlasPageSize> pages;
+	uint64_t imagePixels;
+	uint64_t cellPixels; // the images with their padding and alignment
+	uint64_t pagePixels;
+};
+
+// Fails if an image does not fit a page or more than ATLAS_MAX_PAGES are needed.
+bool packAtlas(const std::vector<AtlasImage>& images, const AtlasPackOptions& options, AtlasLayout* layout);
+void composeAtlasPages(const std::vector<AtlasImage>& images, const AtlasPackOptions& options, const AtlasLayout& layout,
+	std::vector<std::vector<uint8_t> >* pages);
+// Fails if two names have the same hash. indexSize is the size of everything but the pixels.
+bool writeAtlas(const char* path, const std::vector<AtlasImage>& images, const AtlasPackOptions& options, const AtlasLayout& layout,
+	const std::vector<std::vector<uint8_t> >& pages, size_t* indexSize, size_t* fileSize);
@@ -0,0 +1,210 @@
+// Offline texture atlas baker: packs images into power-of-two pages and writes them with an index
+// of their UV rectangles, in the format in jni/atlas_format.h.
+//
+// Build on the host with:   c++ -O2 -o atlas_tool tools/atlas_tool.cpp tools/atlas_packer.cpp
+// Usage:                    atlas_tool [--size N] [--padding N] [--mip-levels N] [--skyline] [--pages prefix]
+//                                      output.atlas input.ppm|input.pam ...
+//
+// Inputs are binary PPM (P6) or PAM (P7, RGB or RGB_ALPHA) with 8 bit channels, and each image is
+// named after its file without the directory and extension. Images are packed with MaxRects, or
+// a skyline packer with --skyline, into pages of at most --size pixels a side (2048 by default).
+// --mip-levels keeps that many levels of the mip chain free of neighbouring images (2 by default),
+// raising the padding (2 by default) if it has to. --pages writes each page as prefixN.ppm, without
+// alpha, for inspection.
+
+#include "atlas_packer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct Options {
+	AtlasPackOptions pack;
+	const char* pagesPrefix;
+	const char* output;
+	int firstInput;
+};
+
+static double nowSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The next whitespace separated token of a PNM header, skipping comments.
+static bool readToken(FILE* file, char* token, size_t size) {
+	int c = fgetc(file);
+	while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#') {
+		if (c == '#') {
+			while (c != '\n' && c != EOF) {
+				c = fgetc(file);
+			}
+		}
+		c = fgetc(file);
+	}
+	size_t length = 0;
+	while (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+		if (length + 1 < size) {
+			token[length++] = static_cast<char>(c);
+		}
+		c = fgetc(file);
+	}
+	token[length] = '\0';
+	return length > 0;
+}
+
+static bool loadImage(const char* path, AtlasImage* image) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+	char token[64];
+	uint32_t width = 0, height = 0, channels = 0, maxValue = 0;
+	readToken(file, token, sizeof(token));
+	if (strcmp(token, "P6") == 0) {
+		channels = 3;
+		if (readToken(file, token, sizeof(token))) width = atoi(token);
+		if (readToken(file, token, sizeof(token))) height = atoi(token);
+		if (readToken(file, token, sizeof(token))) maxValue = atoi(token);
+	} else if (strcmp(token, "P7") == 0) {
+		while (readToken(file, token, sizeof(token)) && strcmp(token, "ENDHDR") != 0) {
+			char value[64];
+			if (!readToken(file, value, sizeof(value))) {
+				break;
+			}
+			if (strcmp(token, "WIDTH") == 0) width = atoi(value);
+			else if (strcmp(token, "HEIGHT") == 0) height = atoi(value);
+			else if (strcmp(token, "DEPTH") == 0) channels = atoi(value);
+			else if (strcmp(token, "MAXVAL") == 0) maxValue = atoi(value);
+		}
+	}
+	if (width == 0 || height == 0 || width > 65535 || height > 65535 || (channels != 3 && channels != 4) || maxValue != 255) {
+		fprintf(stderr, "%s: not an 8 bit RGB or RGBA PPM or PAM image\n", path);
+		fclose(file);
+		return false;
+	}
+	std::vector<uint8_t> source(static_cast<size_t>(width) * height * channels);
+	bool complete = fread(source.data(), 1, source.size(), file) == source.size();
+	fclose(file);
+	if (!complete) {
+		fprintf(stderr, "%s: truncated image\n", path);
+		return false;
+	}
+
+	const char* name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+	const char* extension = strrchr(name, '.');
+	image->name.assign(name, extension ? extension - name : strlen(name));
+	image->width = width;
+	image->height = height;
+	image->pixels.resize(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+		memcpy(&image->pixels[i * 4], &source[i * channels], 3);
+		image->pixels[i * 4 + 3] = channels == 4 ? source[i * 4 + 3] : 255;
+	}
+	return true;
+}
+
+static bool writePagePPM(const char* path, const std::vector<uint8_t>& pixels, const AtlasPageSize& size) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not write %s\n", path);
+		return false;
+	}
+	fprintf(file, "P6\n%u %u\n255\n", size.width, size.height);
+	std::vector<uint8_t> row(size.width * 3);
+	for (uint32_t y = 0; y < size.height; ++y) {
+		for (uint32_t x = 0; x < size.width; ++x) {
+			memcpy(&row[x * 3], &pixels[(static_cast<size_t>(y) * size.width + x) * 4], 3);
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	return fclose(file) == 0;
+}
+
+static bool parseOptions(int argc, char** argv, Options* options) {
+	memset(options, 0, sizeof(Options));
+	options->pack.pageSize = 2048;
+	options->pack.padding = 2;
+	options->pack.mipLevels = 2;
+	int i = 1;
+	for (; i < argc && strncmp(argv[i], "--", 2) == 0; ++i) {
+		if (strcmp(argv[i], "--skyline") == 0) {
+			options->pack.skyline = true;
+		} else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			options->pack.pageSize = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--padding") == 0 && i + 1 < argc) {
+			options->pack.padding = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--mip-levels") == 0 && i + 1 < argc) {
+			options->pack.mipLevels = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+			options->pagesPrefix = argv[++i];
+		} else {
+			return false;
+		}
+	}
+	if (i + 1 >= argc) {
+		return false;
+	}
+	options->output = argv[i];
+	options->firstInput = i + 1;
+	uint32_t size = options->pack.pageSize;
+	return size >= 64 && size <= 16384 && (size & (size - 1)) == 0 && options->pack.mipLevels <= 6 && options->pack.padding <= 64;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, &options)) {
+		fprintf(stderr, "Usage: %s [--size N] [--padding N] [--mip-levels N] [--skyline] [--pages prefix] output.atlas input.ppm|input.pam ...\n",
+			argv[0]);
+		return 1;
+	}
+
+	std::vector<AtlasImage> images(argc - options.firstInput);
+	for (size_t i = 0; i < images.size(); ++i) {
+		if (!loadImage(argv[options.firstInput + i], &images[i])) {
+			return 1;
+		}
+	}
+
+	double start = nowSeconds();
+	AtlasLayout layout;
+	if (!packAtlas(images, options.pack, &layout)) {
+		return 1;
+	}
+	double packed = nowSeconds();
+	std::vector<std::vector<uint8_t> > pages;
+	composeAtlasPages(images, options.pack, layout, &pages);
+	double composed = nowSeconds();
+	size_t indexSize = 0;
+	size_t fileSize = 0;
+	if (!writeAtlas(options.output, images, options.pack, layout, pages, &indexSize, &fileSize)) {
+		return 1;
+	}
+	double written = nowSeconds();
+
+	if (options.pagesPrefix) {
+		for (size_t i = 0; i < pages.size(); ++i) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s%zu.ppm", options.pagesPrefix, i);
+			if (!writePagePPM(path, pages[i], layout.pages[i])) {
+				return 1;
+			}
+		}
+	}
+
+	printf("%zu images, padding %u, %u mip levels kept apart, %s\n", images.size(), layout.padding, options.pack.mipLevels,
+		options.pack.skyline ? "skyline" : "MaxRects");
+	for (size_t i = 0; i < layout.pages.size(); ++i) {
+		printf("page %zu: %ux%u\n", i, layout.pages[i].width, layout.pages[i].height);
+	}
+	double pagePixels = layout.pagePixels ? static_cast<double>(layout.pagePixels) : 1.0;
+	printf("efficiency: %.1f%% of page pixels are image pixels, %.1f%% are in cells\n", 100.0 * layout.imagePixels / pagePixels,
+		100.0 * layout.cellPixels / pagePixels);
+	printf("size: %zu byte index, %zu bytes in all\n", indexSize, fileSize);
+	printf("packed in %.2f ms, composed in %.2f ms, written in %.2f ms\n", (packed - start) * 1e3, (composed - packed) * 1e3,
+		(written - composed) * 1e3);
+	return 0;
+}
@@ -0,0 +1,465 @@
+// Offline mesh optimiser: converts a Wavefront OBJ into the binary format in jni/mesh_format.h.
+//
+// Build on the host with:   c++ -O2 -o mesh_tool tools/mesh_tool.cpp
+// Usage:                    mesh_tool [--half-uv] [--cache-size N] input.obj output.mesh
+//
+// Steps: deduplicate vertices, reorder triangles for the post-transform vertex cache
+// (Forsyth's linear-speed algorithm), renumber vertices in first-use order for fetch
+// locality, then quantise positions to normalized shorts, normals to normalized bytes and
+// texture coordinates to normalized unsigned shorts or, with --half-uv, half floats
+// (which need GL_OES_vertex_half_float on the device).
+
+#include "../jni/mesh_format.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <vector>
+
+struct Vertex {
+	float position[3];
+	float normal[3];
+	float texCoord[2];
+};
+
+struct VertexKey {
+	int position, texCoord, normal;
+	bool operator<(const VertexKey& o) const {
+		if (position != o.position) return position < o.position;
+		if (texCoord != o.texCoord) return texCoord < o.texCoord;
+		return normal < o.normal;
+	}
+};
+
+struct Options {
+	bool halfTexCoords;
+	int cacheSize;
+	const char* input;
+	const char* output;
+};
+
+static double nowSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int resolveIndex(int index, size_t count) {
+	// OBJ indices are 1-based, negative ones count back from the end
+	return index < 0 ? static_cast<int>(count) + index : index - 1;
+}
+
+static bool loadObj(const char* path, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, bool* hasNormals, bool* hasTexCoords) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+
+	std::vector<float> positions, normals, texCoords;
+	std::map<VertexKey, uint32_t> unique;
+	char line[1024];
+	*hasNormals = false;
+	*hasTexCoords = false;
+	while (fgets(line, sizeof(line), file)) {
+		float a, b, c;
+		if (line[0] == 'v' && line[1] == ' ' && sscanf(line + 2, "%f %f %f", &a, &b, &c) == 3) {
+			positions.push_back(a); positions.push_back(b); positions.push_back(c);
+		} else if (line[0] == 'v' && line[1] == 'n' && sscanf(line + 3, "%f %f %f", &a, &b, &c) == 3) {
+			normals.push_back(a); normals.push_back(b); normals.push_back(c);
+		} else if (line[0] == 'v' && line[1] == 't' && sscanf(line + 3, "%f %f", &a, &b) == 2) {
+			texCoords.push_back(a); texCoords.push_back(b);
+		} else if (line[0] == 'f' && line[1] == ' ') {
+			std::vector<uint32_t> face;
+			char* token = strtok(line + 2, " \t\r\n");
+			for (; token; token = strtok(NULL, " \t\r\n")) {
+				VertexKey key = { 0, -1, -1 };
+				int p = 0, t = 0, n = 0;
+				if (sscanf(token, "%d/%d/%d", &p, &t, &n) == 3) {
+				} else if (sscanf(token, "%d//%d", &p, &n) == 2) {
+					t = 0;
+				} else if (sscanf(token, "%d/%d", &p, &t) == 2) {
+					n = 0;
+				} else if (sscanf(token, "%d", &p) != 1) {
+					continue;
+				}
+				key.position = resolveIndex(p, positions.size() / 3);
+				key.texCoord = t ? resolveIndex(t, texCoords.size() / 2) : -1;
+				key.normal = n ? resolveIndex(n, normals.size() / 3) : -1;
+				if (key.position < 0 || key.position * 3 >= static_cast<int>(positions.size())) {
+					fprintf(stderr, "Bad position index in %s", line);
+					fclose(file);
+					return false;
+				}
+
+				std::map<VertexKey, uint32_t>::iterator it = unique.find(key);
+				if (it == unique.end()) {
+					Vertex v;
+					memset(&v, 0, sizeof(v));
+					memcpy(v.position, &positions[key.position * 3], sizeof(v.position));
+					if (key.normal >= 0 && key.normal * 3 < static_cast<int>(normals.size())) {
+						memcpy(v.normal, &normals[key.normal * 3], sizeof(v.normal));
+						*hasNormals = true;
+					}
+					if (key.texCoord >= 0 && key.texCoord * 2 < static_cast<int>(texCoords.size())) {
+						memcpy(v.texCoord, &texCoords[key.texCoord * 2], sizeof(v.texCoord));
+						*hasTexCoords = true;
+					}
+					it = unique.insert(std::make_pair(key, static_cast<uint32_t>(vertices->size()))).first;
+					vertices->push_back(v);
+				}
+				face.push_back(it->second);
+			}
+			for (size_t i = 2; i < face.size(); ++i) {
+				indices->push_back(face[0]);
+				indices->push_back(face[i - 1]);
+				indices->push_back(face[i]);
+			}
+		}
+	}
+	fclose(file);
+	return !indices->empty();
+}
+
+// Average number of vertex shader invocations per triangle with a FIFO post-transform cache.
+static double computeAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize) {
+	std::vector<uint32_t> cachedAt(vertexCount, 0);
+	uint32_t time = 0;
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); ++i) {
+		uint32_t v = indices[i];
+		if (cachedAt[v] == 0 || time - cachedAt[v] >= static_cast<uint32_t>(cacheSize)) {
+			cachedAt[v] = ++time;
+			++misses;
+		}
+	}
+	return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006).
+static const int forsythCacheSize = 32;
+
+static float forsythVertexScore(int cachePosition, int remainingTriangles) {
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			score = 0.75f;
+		} else {
+			score = powf(1.0f - (cachePosition - 3) / static_cast<float>(forsythCacheSize - 3), 1.5f);
+		}
+	}
+	return score + 2.0f * powf(static_cast<float>(remainingTriangles), -0.5f);
+}
+
+static void optimizeVertexCache(std::vector<uint32_t>* indices, size_t vertexCount) {
+	size_t triangleCount = indices->size() / 3;
+	std::vector<int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indices->size(); ++i) {
+		++remaining[(*indices)[i]];
+	}
+	std::vector<int> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+	}
+	std::vector<int> adjacency(indices->size());
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; ++t) {
+		for (int k = 0; k < 3; ++k) {
+			adjacency[fill[(*indices)[t * 3 + k]]++] = static_cast<int>(t);
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+	}
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = vertexScore[(*indices)[t * 3]] + vertexScore[(*indices)[t * 3 + 1]] + vertexScore[(*indices)[t * 3 + 2]];
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(indices->size());
+	std::vector<uint32_t> cache;
+	size_t scanPosition = 0;
+	int best = -1;
+	while (output.size() < indices->size()) {
+		if (best < 0) {
+			// nothing in the cache is adjacent to a remaining triangle: take the best one left anywhere
+			float bestScore = -1.0f;
+			for (; scanPosition < triangleCount && emitted[scanPosition]; ++scanPosition) {
+			}
+			for (size_t t = scanPosition; t < triangleCount; ++t) {
+				if (!emitted[t] && triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = static_cast<int>(t);
+				}
+			}
+		}
+
+		emitted[best] = true;
+		std::vector<uint32_t> newCache;
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = (*indices)[best * 3 + k];
+			output.push_back(v);
+			newCache.push_back(v);
+			// drop the triangle from the vertex's adjacency list
+			int* begin = &adjacency[adjacencyStart[v]];
+			int* end = begin + remaining[v];
+			for (int* a = begin; a < end; ++a) {
+				if (*a == best) {
+					*a = *(end - 1);
+					break;
+				}
+			}
+			--remaining[v];
+		}
+		for (size_t i = 0; i < cache.size(); ++i) {
+			uint32_t v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+				newCache.push_back(v);
+			}
+		}
+
+		for (size_t i = 0; i < newCache.size(); ++i) {
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < static_cast<size_t>(forsythCacheSize) ? static_cast<int>(i) : -1;
+			vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+		}
+		if (newCache.size() > static_cast<size_t>(forsythCacheSize)) {
+			newCache.resize(forsythCacheSize);
+		}
+		cache.swap(newCache);
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < cache.size(); ++i) {
+			uint32_t v = cache[i];
+			for (int a = 0; a < remaining[v]; ++a) {
+				int t = adjacency[adjacencyStart[v] + a];
+				float score = vertexScore[(*indices)[t * 3]] + vertexScore[(*indices)[t * 3 + 1]] + vertexScore[(*indices)[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+	}
+	indices->swap(output);
+}
+
+static void optimizeVertexFetch(std::vector<Vertex>* vertices, std::vector<uint32_t>* indices) {
+	std::vector<uint32_t> remap(vertices->size(), 0xffffffffu);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices->size());
+	for (size_t i = 0; i < indices->size(); ++i) {
+		uint32_t& index = (*indices)[i];
+		if (remap[index] == 0xffffffffu) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back((*vertices)[index]);
+		}
+		index = remap[index];
+	}
+	// vertices no triangle references are dropped
+	vertices->swap(reordered);
+}
+
+static uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+	if (exponent <= 0) {
+		if (exponent < -10) {
+			return static_cast<uint16_t>(sign);
+		}
+		mantissa |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+	}
+	if (exponent >= 31) {
+		return static_cast<uint16_t>(sign | 0x7c00);
+	}
+	uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	// round to nearest, a carry into the exponent is still correct
+	return static_cast<uint16_t>(half + ((mantissa >> 12) & 1));
+}
+
+static int16_t quantizeSnorm16(float v) {
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return static_cast<int16_t>(lrintf(v * 32767.0f));
+}
+
+static int8_t quantizeSnorm8(float v) {
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return static_cast<int8_t>(lrintf(v * 127.0f));
+}
+
+static uint16_t quantizeUnorm16(float v) {
+	v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+	return static_cast<uint16_t>(lrintf(v * 65535.0f));
+}
+
+static bool writeMesh(const Options* options, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	bool hasNormals, bool hasTexCoords, size_t* fileSize) {
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.indexType = MESH_TYPE_UNSIGNED_SHORT;
+
+	float minP[3] = { INFINITY, INFINITY, INFINITY }, maxP[3] = { -INFINITY, -INFINITY, -INFINITY };
+	float minT[2] = { INFINITY, INFINITY }, maxT[2] = { -INFINITY, -INFINITY };
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		for (int k = 0; k < 3; ++k) {
+			minP[k] = fminf(minP[k], vertices[i].position[k]);
+			maxP[k] = fmaxf(maxP[k], vertices[i].position[k]);
+		}
+		for (int k = 0; k < 2; ++k) {
+			minT[k] = fminf(minT[k], vertices[i].texCoord[k]);
+			maxT[k] = fmaxf(maxT[k], vertices[i].texCoord[k]);
+		}
+	}
+	for (int k = 0; k < 3; ++k) {
+		header.positionOffset[k] = (minP[k] + maxP[k]) * 0.5f;
+		header.positionScale[k] = (maxP[k] - minP[k]) * 0.5f > 0.0f ? (maxP[k] - minP[k]) * 0.5f : 1.0f;
+	}
+	for (int k = 0; k < 2; ++k) {
+		header.texCoordOffset[k] = options->halfTexCoords ? 0.0f : minT[k];
+		header.texCoordScale[k] = options->halfTexCoords || maxT[k] <= minT[k] ? 1.0f : maxT[k] - minT[k];
+	}
+
+	// positions as 4 shorts (w unused) so every attribute starts 4-byte aligned
+	uint16_t stride = 0;
+	MeshAttributeDesc position = { MESH_ATTRIBUTE_POSITION, MESH_TYPE_SHORT, 3, 1, stride };
+	header.attributes[header.attributeCount++] = position;
+	stride += 8;
+	if (hasNormals) {
+		MeshAttributeDesc normal = { MESH_ATTRIBUTE_NORMAL, MESH_TYPE_BYTE, 3, 1, stride };
+		header.attributes[header.attributeCount++] = normal;
+		stride += 4;
+	}
+	if (hasTexCoords) {
+		MeshAttributeDesc texCoord = { MESH_ATTRIBUTE_TEXCOORD,
+			static_cast<uint16_t>(options->halfTexCoords ? MESH_TYPE_HALF_FLOAT_OES : MESH_TYPE_UNSIGNED_SHORT), 2,
+			static_cast<uint8_t>(options->halfTexCoords ? 0 : 1), stride };
+		header.attributes[header.attributeCount++] = texCoord;
+		stride += 4;
+	}
+	header.vertexStride = stride;
+	header.vertexDataOffset = sizeof(MeshFileHeader);
+	header.indexDataOffset = header.vertexDataOffset + header.vertexCount * stride;
+
+	std::vector<uint8_t> vertexData(header.vertexCount * stride, 0);
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		uint8_t* out = &vertexData[i * stride];
+		const Vertex& v = vertices[i];
+		int16_t p[4] = { 0, 0, 0, 0 };
+		for (int k = 0; k < 3; ++k) {
+			p[k] = quantizeSnorm16((v.position[k] - header.positionOffset[k]) / header.positionScale[k]);
+		}
+		memcpy(out, p, sizeof(p));
+		uint16_t offset = 8;
+		if (hasNormals) {
+			int8_t n[4] = { quantizeSnorm8(v.normal[0]), quantizeSnorm8(v.normal[1]), quantizeSnorm8(v.normal[2]), 0 };
+			memcpy(out + offset, n, sizeof(n));
+			offset += 4;
+		}
+		if (hasTexCoords) {
+			uint16_t t[2];
+			for (int k = 0; k < 2; ++k) {
+				t[k] = options->halfTexCoords ? floatToHalf(v.texCoord[k]) :
+					quantizeUnorm16((v.texCoord[k] - header.texCoordOffset[k]) / header.texCoordScale[k]);
+			}
+			memcpy(out + offset, t, sizeof(t));
+		}
+	}
+	std::vector<uint16_t> indexData(indices.begin(), indices.end());
+
+	FILE* file = fopen(options->output, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not create %s\n", options->output);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(vertexData.data(), 1, vertexData.size(), file) == vertexData.size() &&
+		fwrite(indexData.data(), sizeof(uint16_t), indexData.size(), file) == indexData.size();
+	fclose(file);
+	*fileSize = sizeof(header) + vertexData.size() + indexData.size() * sizeof(uint16_t);
+	return ok;
+}
+
+static bool parseOptions(int argc, char** argv, Options* options) {
+	memset(options, 0, sizeof(Options));
+	options->cacheSize = 16;
+	int positional = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--half-uv") == 0) {
+			options->halfTexCoords = true;
+		} else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+			options->cacheSize = atoi(argv[++i]);
+		} else if (positional == 0) {
+			options->input = argv[i];
+			++positional;
+		} else if (positional == 1) {
+			options->output = argv[i];
+			++positional;
+		} else {
+			return false;
+		}
+	}
+	return options->input && options->output && options->cacheSize > 0;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, &options)) {
+		fprintf(stderr, "Usage: %s [--half-uv] [--cache-size N] input.obj output.mesh\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	bool hasNormals, hasTexCoords;
+	if (!loadObj(options.input, &vertices, &indices, &hasNormals, &hasTexCoords)) {
+		return 1;
+	}
+
+	double start = nowSeconds();
+	double acmrBefore = computeAcmr(indices, vertices.size(), options.cacheSize);
+	optimizeVertexCache(&indices, vertices.size());
+	optimizeVertexFetch(&vertices, &indices);
+	double acmrAfter = computeAcmr(indices, vertices.size(), options.cacheSize);
+	double optimizeSeconds = nowSeconds() - start;
+
+	if (vertices.size() > 65536) {
+		fprintf(stderr, "%zu vertices do not fit 16 bit indices; split the mesh\n", vertices.size());
+		return 1;
+	}
+
+	size_t fileSize = 0;
+	if (!writeMesh(&options, vertices, indices, hasNormals, hasTexCoords, &fileSize)) {
+		return 1;
+	}
+
+	size_t floatVertexSize = (3 + (hasNormals ? 3 : 0) + (hasTexCoords ? 2 : 0)) * sizeof(float);
+	size_t rawSize = vertices.size() * floatVertexSize + indices.size() * sizeof(uint32_t);
+	printf("%s: %zu vertices, %zu triangles\n", options.input, vertices.size(), indices.size() / 3);
+	printf("ACMR (FIFO %d): %.3f -> %.3f\n", options.cacheSize, acmrBefore, acmrAfter);
+	printf("size: %zu bytes as floats/uint32 -> %zu bytes (%.1f%%)\n", rawSize, fileSize, 100.0 * fileSize / rawSize);
+	printf("optimised in %.2f ms\n", optimizeSeconds * 1e3);
+	return 0;
+}
@@ -0,0 +1,2773 @@
+// Offline GLSL ES optimiser: turns the readable shaders in jni/shaders into minified sources in
+// generated headers that the renderers include, so less text is compiled on every window init.
+//
+// Build on the host with:   c++ -O2 -o shader_tool tools/shader_tool.cpp
+// Usage:                    shader_tool [--check] [--report] input.vert [input.frag] output.h
+//
+// Steps: substitute literal #defines and inline constants, fold constant arithmetic, remove unused
+// locals, globals and functions (and, given both stages, varyings the fragment stage never reads),
+// lower precision where the range of values allows it, rename locals and functions to one or two
+// letters and drop comments and whitespace.
+//
+// Ranges come from literals, built-ins and "// range: lo hi" comments on attribute, uniform and
+// varying declarations; texture reads are taken to be normalized, within [0, 1]. Fragment values
+// within [-2, 2] that never reach a texture coordinate, divisor or index become lowp, in both stages
+// for varyings; vertex outputs the fragment stage reads at mediump are written at mediump.
+// Conditional compilation is not supported, and functions with control flow are only folded and
+// renamed.
+//
+// The header holds a static char array per stage and <NAME>_SOURCE_HASH, the 64-bit FNV-1a of the
+// optimised sources, for keying cached program binaries. It also records a hash of the inputs:
+// --check compares that with the sources and fails if the header is stale, without writing it.
+// --report prints each stage's size and estimated ALU cost before and after.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// bump when the output changes for the same input, so --check sees older headers as stale
+#define SHADER_TOOL_VERSION 1
+
+// within lowp's guaranteed range, and representable at mediump's
+#define LOWP_LIMIT 2.0
+#define MEDIUMP_LIMIT 16384.0
+
+enum TokenType {
+	TOKEN_IDENTIFIER,
+	TOKEN_NUMBER,
+	TOKEN_OPERATOR,
+	TOKEN_DIRECTIVE
+};
+
+struct Token {
+	TokenType type;
+	std::string text;
+	int line;
+};
+
+// an interval holding every component of a value
+struct Range {
+	bool known;
+	double lo;
+	double hi;
+};
+
+enum NodeKind {
+	NODE_NUMBER,
+	NODE_IDENTIFIER,
+	NODE_UNARY,
+	NODE_POSTFIX,
+	NODE_BINARY,
+	NODE_TERNARY,
+	NODE_CALL,
+	NODE_FIELD,
+	NODE_INDEX
+};
+
+struct Node {
+	NodeKind kind;
+	std::string text; // literal, identifier, operator, called function or field
+	std::vector<Node*> children;
+};
+
+enum StatementKind {
+	STATEMENT_DECLARATION,
+	STATEMENT_ASSIGNMENT,
+	STATEMENT_EXPRESSION,
+	STATEMENT_RETURN,
+	STATEMENT_OPAQUE
+};
+
+struct Statement {
+	StatementKind kind;
+	bool constant;
+	std::string precision;
+	std::string type;
+	std::string name; // declared variable, or the variable an assignment writes
+	Node* target;
+	std::string op;
+	Node* value;
+	std::vector<Token> tokens; // opaque statements, copied through renamed
+	bool removed;
+};
+
+struct Parameter {
+	std::vector<std::string> qualifiers;
+	std::string type;
+	std::string name;
+};
+
+enum GlobalKind {
+	GLOBAL_DIRECTIVE,
+	GLOBAL_PRECISION,
+	GLOBAL_VARIABLE,
+	GLOBAL_FUNCTION,
+	GLOBAL_OPAQUE
+};
+
+struct Global {
+	GlobalKind kind;
+	std::vector<Token> tokens; // directives, precision statements and opaque declarations
+	std::vector<std::string> qualifiers; // storage, interpolation and layout tokens
+	std::string precision;
+	std::string type; // of a variable, or a function's return type
+	std::string name;
+	std::vector<Token> arraySize;
+	Node* value;
+	Range range;
+	std::vector<Parameter> parameters;
+	std::vector<Statement> body;
+	bool opaqueBody;
+	bool removed;
+};
+
+struct Shader {
+	const char* path;
+	bool fragment;
+	std::string text;
+	std::vector<Token> tokens;
+	std::map<int, Range> rangeComments; // by line
+	std::vector<Global> globals;
+	std::set<std::string> identifiers; // everything in the source, which new names must avoid
+	std::vector<std::string> lowered; // for the report
+};
+
+struct Cost {
+	int32_t alu;
+	int32_t textures;
+	int32_t byPrecision[4]; // alu at none, lowp, mediump and highp
+};
+
+struct Options {
+	bool check;
+	bool report;
+	const char* inputs[2];
+	int32_t inputCount;
+	const char* output;
+};
+
+static std::deque<Node> nodes;
+
+static const char* const keywords[] = {
+	"attribute", "const", "uniform", "varying", "break", "continue", "do", "for", "while", "if", "else",
+	"in", "out", "inout", "true", "false", "lowp", "mediump", "highp", "precision", "invariant", "discard",
+	"return", "struct", "layout", "centroid", "flat", "smooth", "switch", "case", "default", "asm",
+	"class", "union", "enum", "typedef", "template", "this", "packed", "goto", "inline", "noinline",
+	"volatile", "public", "static", "extern", "external", "interface", "long", "short", "double", "half",
+	"fixed", "unsigned", "superp", "input", "output", "sizeof", "cast", "namespace", "using", "main"
+};
+
+static const char* const typeNames[] = {
+	"void", "bool", "int", "uint", "float", "vec2", "vec3", "vec4", "bvec2", "bvec3", "bvec4", "ivec2",
+	"ivec3", "ivec4", "uvec2", "uvec3", "uvec4", "mat2", "mat3", "mat4", "mat2x2", "mat2x3", "mat2x4",
+	"mat3x2", "mat3x3", "mat3x4", "mat4x2", "mat4x3", "mat4x4", "sampler2D", "samplerCube", "sampler3D",
+	"samplerExternalOES", "sampler2DShadow", "samplerCubeShadow", "sampler2DArray", "sampler2DArrayShadow",
+	"isampler2D", "isampler3D", "isamplerCube", "isampler2DArray", "usampler2D", "usampler3D",
+	"usamplerCube", "usampler2DArray"
+};
+
+static const char* const builtinFunctions[] = {
+	"radians", "degrees", "sin", "cos", "tan", "asin", "acos", "atan", "sinh", "cosh", "tanh", "asinh",
+	"acosh", "atanh", "pow", "exp", "log", "exp2", "log2", "sqrt", "inversesqrt", "abs", "sign", "floor",
+	"trunc", "round", "roundEven", "ceil", "fract", "mod", "modf", "min", "max", "clamp", "mix", "step",
+	"smoothstep", "isnan", "isinf", "floatBitsToInt", "floatBitsToUint", "intBitsToFloat",
+	"uintBitsToFloat", "packSnorm2x16", "unpackSnorm2x16", "packUnorm2x16", "unpackUnorm2x16",
+	"packHalf2x16", "unpackHalf2x16", "length", "distance", "dot", "cross", "normalize", "faceforward",
+	"reflect", "refract", "matrixCompMult", "outerProduct", "transpose", "determinant", "inverse",
+	"lessThan", "lessThanEqual", "greaterThan", "greaterThanEqual", "equal", "notEqual", "any", "all",
+	"not", "texture2D", "texture2DProj", "texture2DLod", "texture2DProjLod", "textureCube",
+	"textureCubeLod", "texture2DLodEXT", "texture2DProjLodEXT", "textureCubeLodEXT", "texture",
+	"textureProj", "textureLod", "textureOffset", "texelFetch", "texelFetchOffset", "textureProjOffset",
+	"textureLodOffset", "textureProjLod", "textureProjLodOffset", "textureGrad", "textureGradOffset",
+	"textureProjGrad", "textureProjGradOffset", "textureSize", "dFdx", "dFdy", "fwidth"
+};
+
+static bool inList(const char* const* list, size_t count, const std::string& name) {
+	for (size_t i = 0; i < count; ++i) {
+		if (name == list[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool isKeyword(const std::string& name) {
+	return inList(keywords, sizeof(keywords) / sizeof(keywords[0]), name);
+}
+
+static bool isTypeName(const std::string& name) {
+	return inList(typeNames, sizeof(typeNames) / sizeof(typeNames[0]), name);
+}
+
+static bool isBuiltinFunction(const std::string& name) {
+	return inList(builtinFunctions, sizeof(builtinFunctions) / sizeof(builtinFunctions[0]), name);
+}
+
+static bool isPrecision(const std::string& name) {
+	return name == "lowp" || name == "mediump" || name == "highp";
+}
+
+static bool isTextureFunction(const std::string& name) {
+	return name.compare(0, 7, "texture") == 0 || name == "texelFetch";
+}
+
+static bool isSamplerType(const std::string& type) {
+	return type.find("sampler") != std::string::npos;
+}
+
+static int32_t precisionLevel(const std::string& precision) {
+	return precision == "lowp" ? 1 : precision == "mediump" ? 2 : precision == "highp" ? 3 : 0;
+}
+
+static int32_t components(const std::string& type) {
+	if (type.size() == 4 && type.compare(0, 3, "mat") == 0) {
+		return (type[3] - '0') * (type[3] - '0');
+	}
+	if (type.size() == 6 && type.compare(0, 3, "mat") == 0) {
+		return (type[3] - '0') * (type[5] - '0');
+	}
+	if (!type.empty() && isdigit((unsigned char)type[type.size() - 1]) && type.find("vec") != std::string::npos) {
+		return type[type.size() - 1] - '0';
+	}
+	return 1;
+}
+
+static uint64_t fnv1a(uint64_t hash, const std::string& text) {
+	for (size_t i = 0; i < text.size(); ++i) {
+		hash = (hash ^ (uint8_t)text[i]) * 1099511628211ull;
+	}
+	return (hash ^ 0xff) * 1099511628211ull;
+}
+
+// Ranges
+
+static Range unknownRange() {
+	Range range = { false, -HUGE_VAL, HUGE_VAL };
+	return range;
+}
+
+static Range makeRange(double lo, double hi) {
+	Range range = { true, lo, hi };
+	return range;
+}
+
+// what a variable holds before anything is written to it, for unions to widen
+static Range emptyRange() {
+	return makeRange(HUGE_VAL, -HUGE_VAL);
+}
+
+static bool rangeWithin(Range range, double limit) {
+	return range.known && range.lo >= -limit && range.hi <= limit;
+}
+
+static Range rangeUnion(Range a, Range b) {
+	if (!a.known || !b.known) {
+		return unknownRange();
+	}
+	return makeRange(fmin(a.lo, b.lo), fmax(a.hi, b.hi));
+}
+
+static bool rangeEmpty(Range range) {
+	return range.known && range.lo > range.hi;
+}
+
+static Range rangeArithmetic(const std::string& op, Range a, Range b) {
+	if (!a.known || !b.known) {
+		return unknownRange();
+	}
+	if (rangeEmpty(a) || rangeEmpty(b)) {
+		return emptyRange();
+	}
+	if (op == "+") {
+		return makeRange(a.lo + b.lo, a.hi + b.hi);
+	}
+	if (op == "-") {
+		return makeRange(a.lo - b.hi, a.hi - b.lo);
+	}
+	if (op == "/") {
+		if (b.lo <= 0.0 && b.hi >= 0.0) {
+			return unknownRange();
+		}
+		b = makeRange(1.0 / b.hi, 1.0 / b.lo);
+	} else if (op != "*") {
+		return unknownRange();
+	}
+	double products[4] = { a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi };
+	Range range = makeRange(products[0], products[0]);
+	for (int32_t i = 1; i < 4; ++i) {
+		range.lo = fmin(range.lo, products[i]);
+		range.hi = fmax(range.hi, products[i]);
+	}
+	return range;
+}
+
+// Tokens
+
+static const char* const operators[] = {
+	"<<=", ">>=", "++", "--", "<=", ">=", "==", "!=", "&&", "||", "^^", "+=", "-=", "*=", "/=", "%=", "&=",
+	"|=", "^=", "<<", ">>"
+};
+
+static void addToken(Shader* shader, TokenType type, const std::string& text, int line) {
+	Token token = { type, text, line };
+	shader->tokens.push_back(token);
+}
+
+static bool tokenize(Shader* shader) {
+	const char* s = shader->text.c_str();
+	int line = 1;
+	bool lineStart = true;
+	while (*s) {
+		if (*s == '\n') {
+			++line;
+			lineStart = true;
+			++s;
+		} else if (isspace((unsigned char)*s)) {
+			++s;
+		} else if (s[0] == '/' && s[1] == '/') {
+			const char* end = strchr(s, '\n');
+			if (!end) {
+				end = s + strlen(s);
+			}
+			std::string comment(s + 2, end);
+			double lo, hi;
+			if (sscanf(comment.c_str(), " range: %lf %lf", &lo, &hi) == 2) {
+				shader->rangeComments[line] = makeRange(lo, hi);
+			}
+			s = end;
+		} else if (s[0] == '/' && s[1] == '*') {
+			const char* end = strstr(s + 2, "*/");
+			if (!end) {
+				fprintf(stderr, "%s:%d: unterminated comment\n", shader->path, line);
+				return false;
+			}
+			for (; s < end; ++s) {
+				line += *s == '\n';
+			}
+			s = end + 2;
+		} else if (*s == '#' && lineStart) {
+			std::string text;
+			int directiveLine = line;
+			while (*s && *s != '\n') {
+				if (s[0] == '\\' && s[1] == '\n') {
+					s += 2;
+					++line;
+					continue;
+				}
+				if (s[0] == '/' && (s[1] == '/' || s[1] == '*')) {
+					break;
+				}
+				text += *s++;
+			}
+			while (!text.empty() && isspace((unsigned char)text[text.size() - 1])) {
+				text.erase(text.size() - 1);
+			}
+			addToken(shader, TOKEN_DIRECTIVE, text, directiveLine);
+		} else if (isdigit((unsigned char)s[0]) || (s[0] == '.' && isdigit((unsigned char)s[1]))) {
+			const char* start = s;
+			if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+				s += 2;
+				while (isxdigit((unsigned char)*s)) {
+					++s;
+				}
+			} else {
+				while (isdigit((unsigned char)*s) || *s == '.') {
+					++s;
+				}
+				if ((*s == 'e' || *s == 'E') && (isdigit((unsigned char)s[1]) ||
+					((s[1] == '+' || s[1] == '-') && isdigit((unsigned char)s[2])))) {
+					s += 2;
+					while (isdigit((unsigned char)*s)) {
+						++s;
+					}
+				}
+			}
+			if (*s == 'u' || *s == 'U' || *s == 'f' || *s == 'F') {
+				++s;
+			}
+			addToken(shader, TOKEN_NUMBER, std::string(start, s), line);
+			lineStart = false;
+		} else if (isalpha((unsigned char)*s) || *s == '_') {
+			const char* start = s;
+			while (isalnum((unsigned char)*s) || *s == '_') {
+				++s;
+			}
+			addToken(shader, TOKEN_IDENTIFIER, std::string(start, s), line);
+			shader->identifiers.insert(std::string(start, s));
+			lineStart = false;
+		} else {
+			std::string op(s, 1);
+			for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i) {
+				if (strncmp(s, operators[i], strlen(operators[i])) == 0) {
+					op = operators[i];
+					break;
+				}
+			}
+			addToken(shader, TOKEN_OPERATOR, op, line);
+			s += op.size();
+			lineStart = false;
+		}
+	}
+	return true;
+}
+
+// Replaces identifiers #defined to a literal, dropping those directives; anything conditional is refused.
+static bool substituteDefines(Shader* shader) {
+	std::map<std::string, std::vector<Token> > defines;
+	std::vector<Token> tokens;
+	for (size_t i = 0; i < shader->tokens.size(); ++i) {
+		const Token& token = shader->tokens[i];
+		if (token.type == TOKEN_DIRECTIVE) {
+			char keyword[32] = "";
+			sscanf(token.text.c_str(), "# %31[a-z]", keyword);
+			if (strcmp(keyword, "define") == 0) {
+				Shader body;
+				body.path = shader->path;
+				char name[128];
+				int length = 0;
+				if (sscanf(token.text.c_str(), "# define %127[A-Za-z0-9_]%n", name, &length) != 1 ||
+					token.text[length] == '(') {
+					fprintf(stderr, "%s:%d: only object-like #defines are supported\n", shader->path, token.line);
+					return false;
+				}
+				body.text = token.text.substr(length);
+				tokenize(&body);
+				std::vector<Token> expanded;
+				for (size_t j = 0; j < body.tokens.size(); ++j) {
+					body.tokens[j].line = token.line;
+					std::map<std::string, std::vector<Token> >::const_iterator inner = defines.find(body.tokens[j].text);
+					if (body.tokens[j].type == TOKEN_IDENTIFIER && inner != defines.end()) {
+						expanded.insert(expanded.end(), inner->second.begin(), inner->second.end());
+					} else {
+						expanded.push_back(body.tokens[j]);
+					}
+				}
+				defines[name] = expanded;
+				continue;
+			}
+			if (strcmp(keyword, "version") != 0 && strcmp(keyword, "extension") != 0 && strcmp(keyword, "pragma") != 0) {
+				fprintf(stderr, "%s:%d: unsupported directive %s\n", shader->path, token.line, token.text.c_str());
+				return false;
+			}
+			tokens.push_back(token);
+			continue;
+		}
+		std::map<std::string, std::vector<Token> >::const_iterator define = defines.end();
+		if (token.type == TOKEN_IDENTIFIER) {
+			define = defines.find(token.text);
+		}
+		if (define == defines.end()) {
+			tokens.push_back(token);
+			continue;
+		}
+		// parenthesised, since the body is an expression
+		Token open = { TOKEN_OPERATOR, "(", token.line };
+		Token close = { TOKEN_OPERATOR, ")", token.line };
+		tokens.push_back(open);
+		tokens.insert(tokens.end(), define->second.begin(), define->second.end());
+		tokens.push_back(close);
+	}
+	shader->tokens = tokens;
+	return true;
+}
+
+// Expressions
+
+static Node* newNode(NodeKind kind, const std::string& text) {
+	nodes.push_back(Node());
+	Node* node = &nodes.back();
+	node->kind = kind;
+	node->text = text;
+	return node;
+}
+
+static Node* copyNode(const Node* node) {
+	Node* copy = newNode(node->kind, node->text);
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		copy->children.push_back(copyNode(node->children[i]));
+	}
+	return copy;
+}
+
+static int32_t binaryPrecedence(const std::string& op) {
+	static const char* const levels[][4] = {
+		{ "||" }, { "^^" }, { "&&" }, { "|" }, { "^" }, { "&" }, { "==", "!=" }, { "<", ">", "<=", ">=" },
+		{ "<<", ">>" }, { "+", "-" }, { "*", "/", "%" }
+	};
+	for (int32_t level = 0; level < (int32_t)(sizeof(levels) / sizeof(levels[0])); ++level) {
+		for (int32_t i = 0; i < 4 && levels[level][i]; ++i) {
+			if (op == levels[level][i]) {
+				return level + 2;
+			}
+		}
+	}
+	return 0;
+}
+
+#define PRECEDENCE_TERNARY 1
+#define PRECEDENCE_UNARY 13
+#define PRECEDENCE_POSTFIX 14
+
+static bool isAssignment(const std::string& op) {
+	return op == "=" || op == "+=" || op == "-=" || op == "*=" || op == "/=" || op == "%=" || op == "<<=" ||
+		op == ">>=" || op == "&=" || op == "|=" || op == "^=";
+}
+
+struct Parser {
+	Shader* shader;
+	const std::vector<Token>* tokens;
+	size_t pos;
+	bool failed;
+};
+
+static const Token* peek(Parser* parser, size_t ahead = 0) {
+	static const Token end = { TOKEN_OPERATOR, "", 0 };
+	size_t pos = parser->pos + ahead;
+	return pos < parser->tokens->size() ? &(*parser->tokens)[pos] : &end;
+}
+
+static bool accept(Parser* parser, const char* text) {
+	if (peek(parser)->type != TOKEN_DIRECTIVE && peek(parser)->text == text) {
+		parser->pos++;
+		return true;
+	}
+	return false;
+}
+
+static void expect(Parser* parser, const char* text) {
+	if (!accept(parser, text)) {
+		parser->failed = true;
+	}
+}
+
+static Node* parseExpression(Parser* parser, int32_t minPrecedence);
+
+static Node* parsePrimary(Parser* parser) {
+	const Token* token = peek(parser);
+	if (token->type == TOKEN_NUMBER) {
+		parser->pos++;
+		return newNode(NODE_NUMBER, token->text);
+	}
+	if (token->type == TOKEN_IDENTIFIER && (!isKeyword(token->text) || token->text == "true" || token->text == "false")) {
+		parser->pos++;
+		if (!accept(parser, "(")) {
+			return newNode(NODE_IDENTIFIER, token->text);
+		}
+		Node* call = newNode(NODE_CALL, token->text);
+		if (accept(parser, ")")) {
+			return call;
+		}
+		do {
+			call->children.push_back(parseExpression(parser, PRECEDENCE_TERNARY));
+		} while (!parser->failed && accept(parser, ","));
+		expect(parser, ")");
+		return call;
+	}
+	if (accept(parser, "(")) {
+		Node* inner = parseExpression(parser, PRECEDENCE_TERNARY);
+		expect(parser, ")");
+		return inner;
+	}
+	parser->failed = true;
+	return newNode(NODE_NUMBER, "0");
+}
+
+static Node* parseUnary(Parser* parser) {
+	const Token* token = peek(parser);
+	if (token->type == TOKEN_OPERATOR && (token->text == "-" || token->text == "+" || token->text == "!" ||
+		token->text == "~" || token->text == "++" || token->text == "--")) {
+		parser->pos++;
+		Node* node = newNode(NODE_UNARY, token->text);
+		node->children.push_back(parseUnary(parser));
+		return node;
+	}
+	Node* node = parsePrimary(parser);
+	while (!parser->failed) {
+		if (accept(parser, ".")) {
+			if (peek(parser)->type != TOKEN_IDENTIFIER) {
+				parser->failed = true;
+				break;
+			}
+			Node* field = newNode(NODE_FIELD, peek(parser)->text);
+			parser->pos++;
+			field->children.push_back(node);
+			node = field;
+		} else if (accept(parser, "[")) {
+			Node* index = newNode(NODE_INDEX, "");
+			index->children.push_back(node);
+			index->children.push_back(parseExpression(parser, PRECEDENCE_TERNARY));
+			expect(parser, "]");
+			node = index;
+		} else if (peek(parser)->text == "++" || peek(parser)->text == "--") {
+			Node* postfix = newNode(NODE_POSTFIX, peek(parser)->text);
+			parser->pos++;
+			postfix->children.push_back(node);
+			node = postfix;
+		} else {
+			break;
+		}
+	}
+	return node;
+}
+
+static Node* parseExpression(Parser* parser, int32_t minPrecedence) {
+	Node* left = parseUnary(parser);
+	while (!parser->failed) {
+		const Token* token = peek(parser);
+		if (token->type != TOKEN_OPERATOR) {
+			break;
+		}
+		if (token->text == "?" && minPrecedence <= PRECEDENCE_TERNARY) {
+			parser->pos++;
+			Node* ternary = newNode(NODE_TERNARY, "?");
+			ternary->children.push_back(left);
+			ternary->children.push_back(parseExpression(parser, PRECEDENCE_TERNARY));
+			expect(parser, ":");
+			ternary->children.push_back(parseExpression(parser, PRECEDENCE_TERNARY));
+			left = ternary;
+			continue;
+		}
+		int32_t precedence = binaryPrecedence(token->text);
+		if (!precedence || precedence < minPrecedence) {
+			break;
+		}
+		parser->pos++;
+		Node* binary = newNode(NODE_BINARY, token->text);
+		binary->children.push_back(left);
+		binary->children.push_back(parseExpression(parser, precedence + 1));
+		left = binary;
+	}
+	return left;
+}
+
+// Statements and declarations
+
+static void copyGroup(Parser* parser, std::vector<Token>* out, const char* open, const char* close) {
+	int32_t depth = 0;
+	do {
+		const Token* token = peek(parser);
+		if (token->text.empty()) {
+			parser->failed = true;
+			return;
+		}
+		if (token->type == TOKEN_OPERATOR && token->text == open) {
+			++depth;
+		} else if (token->type == TOKEN_OPERATOR && token->text == close) {
+			--depth;
+		}
+		out->push_back(*token);
+		parser->pos++;
+	} while (depth > 0);
+}
+
+// Copies one statement, with whatever it nests, for passing through untouched.
+static void copyStatement(Parser* parser, std::vector<Token>* out) {
+	const Token* token = peek(parser);
+	if (token->text == "{") {
+		copyGroup(parser, out, "{", "}");
+	} else if (token->text == "if" || token->text == "for" || token->text == "while" || token->text == "switch") {
+		bool isIf = token->text == "if";
+		out->push_back(*token);
+		parser->pos++;
+		copyGroup(parser, out, "(", ")");
+		copyStatement(parser, out);
+		if (isIf && peek(parser)->text == "else") {
+			out->push_back(*peek(parser));
+			parser->pos++;
+			copyStatement(parser, out);
+		}
+	} else if (token->text == "do") {
+		out->push_back(*token);
+		parser->pos++;
+		copyStatement(parser, out);
+		copyStatement(parser, out);
+	} else {
+		int32_t depth = 0;
+		while (!parser->failed) {
+			token = peek(parser);
+			if (token->text.empty()) {
+				parser->failed = true;
+				break;
+			}
+			out->push_back(*token);
+			parser->pos++;
+			if (token->text == "(" || token->text == "[") {
+				++depth;
+			} else if (token->text == ")" || token->text == "]") {
+				--depth;
+			} else if (token->text == ";" && depth == 0) {
+				break;
+			}
+		}
+	}
+}
+
+static std::string rootName(const Node* node) {
+	while (node->kind == NODE_FIELD || node->kind == NODE_INDEX) {
+		node = node->children[0];
+	}
+	return node->kind == NODE_IDENTIFIER ? node->text : std::string();
+}
+
+static bool parseStatement(Parser* parser, std::vector<Statement>* body) {
+	size_t start = parser->pos;
+	const Token* token = peek(parser);
+	Statement statement;
+	statement.kind = STATEMENT_EXPRESSION;
+	statement.constant = false;
+	statement.target = NULL;
+	statement.value = NULL;
+	statement.removed = false;
+
+	bool structured = token->text != "{" && token->text != "if" && token->text != "for" && token->text != "while" &&
+		token->text != "do" && token->text != "switch" && token->text != "discard" && token->text != "break" &&
+		token->text != "continue" && token->type != TOKEN_DIRECTIVE;
+	if (structured && accept(parser, "return")) {
+		statement.kind = STATEMENT_RETURN;
+		if (!accept(parser, ";")) {
+			statement.value = parseExpression(parser, PRECEDENCE_TERNARY);
+			expect(parser, ";");
+		}
+		if (!parser->failed) {
+			body->push_back(statement);
+			return true;
+		}
+	} else if (structured && (token->text == "const" || isPrecision(token->text) ||
+		(token->type == TOKEN_IDENTIFIER && peek(parser, 1)->type == TOKEN_IDENTIFIER))) {
+		statement.kind = STATEMENT_DECLARATION;
+		statement.constant = accept(parser, "const");
+		if (isPrecision(peek(parser)->text)) {
+			statement.precision = peek(parser)->text;
+			parser->pos++;
+		}
+		statement.type = peek(parser)->text;
+		parser->pos++;
+		std::vector<Statement> declarations;
+		do {
+			if (peek(parser)->type != TOKEN_IDENTIFIER || peek(parser, 1)->text == "[") {
+				parser->failed = true;
+				break;
+			}
+			Statement declaration = statement;
+			declaration.name = peek(parser)->text;
+			parser->pos++;
+			if (accept(parser, "=")) {
+				declaration.value = parseExpression(parser, PRECEDENCE_TERNARY);
+			}
+			declarations.push_back(declaration);
+		} while (!parser->failed && accept(parser, ","));
+		expect(parser, ";");
+		if (!parser->failed) {
+			body->insert(body->end(), declarations.begin(), declarations.end());
+			return true;
+		}
+	} else if (structured) {
+		Node* expression = parseExpression(parser, PRECEDENCE_TERNARY);
+		if (!parser->failed && peek(parser)->type == TOKEN_OPERATOR && isAssignment(peek(parser)->text)) {
+			statement.kind = STATEMENT_ASSIGNMENT;
+			statement.op = peek(parser)->text;
+			statement.target = expression;
+			statement.name = rootName(expression);
+			parser->pos++;
+			statement.value = parseExpression(parser, PRECEDENCE_TERNARY);
+			if (statement.name.empty()) {
+				parser->failed = true;
+			}
+		} else {
+			statement.value = expression;
+		}
+		expect(parser, ";");
+		if (!parser->failed) {
+			body->push_back(statement);
+			return true;
+		}
+	}
+
+	// anything else is passed through as it is
+	parser->pos = start;
+	parser->failed = false;
+	statement = Statement();
+	statement.kind = STATEMENT_OPAQUE;
+	statement.constant = false;
+	statement.target = NULL;
+	statement.value = NULL;
+	statement.removed = false;
+	copyStatement(parser, &statement.tokens);
+	body->push_back(statement);
+	return false;
+}
+
+static Global newGlobal(GlobalKind kind) {
+	Global global;
+	global.kind = kind;
+	global.value = NULL;
+	global.range = unknownRange();
+	global.opaqueBody = false;
+	global.removed = false;
+	return global;
+}
+
+static bool isQualifier(const std::string& text) {
+	return text == "attribute" || text == "uniform" || text == "varying" || text == "in" || text == "out" ||
+		text == "const" || text == "invariant" || text == "flat" || text == "smooth" || text == "centroid";
+}
+
+static bool parseShader(Shader* shader) {
+	Parser parser = { shader, &shader->tokens, 0, false };
+	while (parser.pos < shader->tokens.size()) {
+		size_t start = parser.pos;
+		const Token* token = peek(&parser);
+		if (token->type == TOKEN_DIRECTIVE) {
+			Global global = newGlobal(GLOBAL_DIRECTIVE);
+			global.tokens.push_back(*token);
+			shader->globals.push_back(global);
+			parser.pos++;
+			continue;
+		}
+		if (token->text == "precision") {
+			Global global = newGlobal(GLOBAL_PRECISION);
+			copyStatement(&parser, &global.tokens);
+			shader->globals.push_back(global);
+			continue;
+		}
+		if (accept(&parser, ";")) {
+			continue;
+		}
+
+		Global global = newGlobal(GLOBAL_VARIABLE);
+		while (isQualifier(peek(&parser)->text) || peek(&parser)->text == "layout") {
+			if (accept(&parser, "layout")) {
+				std::vector<Token> layout;
+				copyGroup(&parser, &layout, "(", ")");
+				std::string text = "layout";
+				for (size_t i = 0; i < layout.size(); ++i) {
+					text += layout[i].text;
+				}
+				global.qualifiers.push_back(text);
+			} else {
+				global.qualifiers.push_back(peek(&parser)->text);
+				parser.pos++;
+			}
+		}
+		if (isPrecision(peek(&parser)->text)) {
+			global.precision = peek(&parser)->text;
+			parser.pos++;
+		}
+		if (peek(&parser)->text == "struct" || peek(&parser, 1)->text == "{" || peek(&parser)->text == ";") {
+			// structs and uniform blocks
+			parser.pos = start;
+			Global opaque = newGlobal(GLOBAL_OPAQUE);
+			while (!parser.failed && peek(&parser)->text != "{" && peek(&parser)->text != ";") {
+				opaque.tokens.push_back(*peek(&parser));
+				parser.pos++;
+			}
+			if (peek(&parser)->text == "{") {
+				copyGroup(&parser, &opaque.tokens, "{", "}");
+			}
+			copyStatement(&parser, &opaque.tokens);
+			shader->globals.push_back(opaque);
+			if (parser.failed) {
+				break;
+			}
+			continue;
+		}
+		if (peek(&parser)->type != TOKEN_IDENTIFIER || peek(&parser, 1)->type != TOKEN_IDENTIFIER) {
+			fprintf(stderr, "%s:%d: expected a declaration at '%s'\n", shader->path, peek(&parser)->line, peek(&parser)->text.c_str());
+			return false;
+		}
+		global.type = peek(&parser)->text;
+		parser.pos++;
+
+		if (peek(&parser, 1)->text == "(") {
+			global.kind = GLOBAL_FUNCTION;
+			global.name = peek(&parser)->text;
+			parser.pos += 2;
+			while (!parser.failed && !accept(&parser, ")")) {
+				Parameter parameter;
+				while (isQualifier(peek(&parser)->text) || peek(&parser)->text == "inout" || isPrecision(peek(&parser)->text)) {
+					parameter.qualifiers.push_back(peek(&parser)->text);
+					parser.pos++;
+				}
+				parameter.type = peek(&parser)->text;
+				parser.pos++;
+				if (peek(&parser)->type == TOKEN_IDENTIFIER) {
+					parameter.name = peek(&parser)->text;
+					parser.pos++;
+				}
+				if (parameter.type != "void") {
+					global.parameters.push_back(parameter);
+				}
+				if (peek(&parser)->text == "[" || (!accept(&parser, ",") && peek(&parser)->text != ")")) {
+					parser.failed = true;
+				}
+			}
+			if (parser.failed) {
+				fprintf(stderr, "%s:%d: could not parse the parameters of %s\n", shader->path, token->line, global.name.c_str());
+				return false;
+			}
+			if (peek(&parser)->text == ";") {
+				// a prototype
+				parser.pos = start;
+				Global opaque = newGlobal(GLOBAL_OPAQUE);
+				copyStatement(&parser, &opaque.tokens);
+				shader->globals.push_back(opaque);
+				continue;
+			}
+			expect(&parser, "{");
+			while (!parser.failed && peek(&parser)->text != "}") {
+				if (peek(&parser)->text.empty()) {
+					parser.failed = true;
+					break;
+				}
+				if (!parseStatement(&parser, &global.body)) {
+					global.opaqueBody = true;
+				}
+			}
+			expect(&parser, "}");
+			if (parser.failed) {
+				fprintf(stderr, "%s:%d: could not parse the body of %s\n", shader->path, token->line, global.name.c_str());
+				return false;
+			}
+			shader->globals.push_back(global);
+			continue;
+		}
+
+		do {
+			if (peek(&parser)->type != TOKEN_IDENTIFIER) {
+				parser.failed = true;
+				break;
+			}
+			Global variable = global;
+			variable.name = peek(&parser)->text;
+			std::map<int, Range>::const_iterator range = shader->rangeComments.find(peek(&parser)->line);
+			if (range != shader->rangeComments.end()) {
+				variable.range = range->second;
+			}
+			parser.pos++;
+			if (peek(&parser)->text == "[") {
+				copyGroup(&parser, &variable.arraySize, "[", "]");
+			}
+			if (accept(&parser, "=")) {
+				variable.value = parseExpression(&parser, PRECEDENCE_TERNARY);
+			}
+			shader->globals.push_back(variable);
+		} while (!parser.failed && accept(&parser, ","));
+		expect(&parser, ";");
+		if (parser.failed) {
+			fprintf(stderr, "%s:%d: could not parse the declaration of %s\n", shader->path, token->line, global.name.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool loadShader(Shader* shader, const char* path) {
+	shader->path = path;
+	const char* extension = strrchr(path, '.');
+	if (!extension || (strcmp(extension, ".vert") != 0 && strcmp(extension, ".frag") != 0)) {
+		fprintf(stderr, "%s: expected a .vert or .frag file\n", path);
+		return false;
+	}
+	shader->fragment = strcmp(extension, ".frag") == 0;
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		shader->text.append(buffer, read);
+	}
+	fclose(file);
+	return tokenize(shader) && substituteDefines(shader) && parseShader(shader);
+}
+
+// Global roles
+
+static bool hasQualifier(const Global* global, const char* qualifier) {
+	for (size_t i = 0; i < global->qualifiers.size(); ++i) {
+		if (global->qualifiers[i] == qualifier) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool isAttribute(const Shader* shader, const Global* global) {
+	return hasQualifier(global, "attribute") || (!shader->fragment && hasQualifier(global, "in"));
+}
+
+static bool isVaryingOut(const Shader* shader, const Global* global) {
+	return !shader->fragment && (hasQualifier(global, "varying") || hasQualifier(global, "out"));
+}
+
+static bool isVaryingIn(const Shader* shader, const Global* global) {
+	return shader->fragment && (hasQualifier(global, "varying") || hasQualifier(global, "in"));
+}
+
+static bool isInterface(const Shader* shader, const Global* global) {
+	return isAttribute(shader, global) || isVaryingOut(shader, global) || isVaryingIn(shader, global) ||
+		hasQualifier(global, "uniform") || hasQualifier(global, "out");
+}
+
+static std::string scalarType(const std::string& type) {
+	if (type.find("ivec") == 0 || type == "int") {
+		return "int";
+	}
+	if (type.find("uvec") == 0 || type == "uint") {
+		return "uint";
+	}
+	if (type.find("bvec") == 0 || type == "bool") {
+		return "bool";
+	}
+	return isSamplerType(type) ? type : "float";
+}
+
+// What a declaration of type gets without a precision qualifier; empty if it has none.
+static std::string defaultPrecision(const Shader* shader, const std::string& type) {
+	std::string base = scalarType(type);
+	for (size_t i = 0; i < shader->globals.size(); ++i) {
+		const Global* global = &shader->globals[i];
+		if (global->kind == GLOBAL_PRECISION && global->tokens.size() >= 3 && global->tokens[2].text == base) {
+			return global->tokens[1].text;
+		}
+	}
+	if (base == "sampler2D" || base == "samplerCube") {
+		return "lowp";
+	}
+	if (isSamplerType(base) || base == "bool") {
+		return "";
+	}
+	if (base == "float") {
+		return shader->fragment ? "" : "highp";
+	}
+	return shader->fragment ? "mediump" : "highp";
+}
+
+// Walking
+
+static void collectIdentifiers(const Node* node, std::vector<const Node*>* out) {
+	if (!node) {
+		return;
+	}
+	if (node->kind == NODE_IDENTIFIER) {
+		out->push_back(node);
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		collectIdentifiers(node->children[i], out);
+	}
+}
+
+static void countReads(const Node* node, std::map<std::string, int32_t>* reads) {
+	std::vector<const Node*> identifiers;
+	collectIdentifiers(node, &identifiers);
+	for (size_t i = 0; i < identifiers.size(); ++i) {
+		(*reads)[identifiers[i]->text]++;
+	}
+}
+
+static void countTokenReads(const std::vector<Token>& tokens, std::map<std::string, int32_t>* reads) {
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		if (tokens[i].type == TOKEN_IDENTIFIER && (i == 0 || tokens[i - 1].text != ".")) {
+			(*reads)[tokens[i].text]++;
+		}
+	}
+}
+
+// Reads of each name in a statement; writes to a whole variable don't count, partial ones do.
+static void countStatementReads(const Statement* statement, std::map<std::string, int32_t>* reads) {
+	if (statement->kind == STATEMENT_OPAQUE) {
+		countTokenReads(statement->tokens, reads);
+		return;
+	}
+	countReads(statement->value, reads);
+	if (statement->kind == STATEMENT_ASSIGNMENT) {
+		if (statement->target->kind == NODE_IDENTIFIER) {
+			if (statement->op != "=") {
+				(*reads)[statement->name]++;
+			}
+		} else {
+			countReads(statement->target, reads);
+		}
+	}
+}
+
+static bool hasSideEffects(const Shader* shader, const Node* node) {
+	if (!node) {
+		return false;
+	}
+	if (node->kind == NODE_POSTFIX || (node->kind == NODE_UNARY && (node->text == "++" || node->text == "--"))) {
+		return true;
+	}
+	if (node->kind == NODE_CALL && !isTypeName(node->text) && !isBuiltinFunction(node->text)) {
+		// user functions may write out parameters and globals; constructors of structs are named like them
+		bool isStruct = false;
+		for (size_t i = 0; i < shader->globals.size(); ++i) {
+			const Global* global = &shader->globals[i];
+			isStruct |= global->kind == GLOBAL_OPAQUE && global->tokens.size() > 1 && global->tokens[0].text == "struct" &&
+				global->tokens[1].text == node->text;
+		}
+		if (!isStruct) {
+			return true;
+		}
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		if (hasSideEffects(shader, node->children[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Folding
+
+static bool isFloatLiteral(const std::string& text) {
+	if (text.size() > 1 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+		return false;
+	}
+	return text.find_first_of(".eEfF") != std::string::npos;
+}
+
+// a number, possibly negated
+static bool literalValue(const Node* node, double* value, bool* isFloat) {
+	if (node->kind == NODE_UNARY && node->text == "-" && literalValue(node->children[0], value, isFloat)) {
+		*value = -*value;
+		return true;
+	}
+	if (node->kind != NODE_NUMBER || node->text.find_first_of("uU") != std::string::npos) {
+		return false;
+	}
+	*isFloat = isFloatLiteral(node->text);
+	*value = *isFloat ? strtod(node->text.c_str(), NULL) : (double)strtoll(node->text.c_str(), NULL, 0);
+	return true;
+}
+
+// Shortest text reading back as the same float, without a leading zero.
+static std::string formatFloat(double value) {
+	float target = (float)value;
+	char text[32];
+	for (int32_t digits = 1; digits <= 9; ++digits) {
+		snprintf(text, sizeof(text), "%.*g", digits, value);
+		if (strtof(text, NULL) == target) {
+			break;
+		}
+	}
+	std::string result = text;
+	if (result.find_first_of(".e") == std::string::npos) {
+		result += ".";
+	}
+	if (result.compare(0, 2, "0.") == 0 && result.size() > 2) {
+		result.erase(0, 1);
+	}
+	return result;
+}
+
+static Node* literalNode(double value, bool isFloat) {
+	char text[32];
+	std::string number;
+	if (isFloat) {
+		number = formatFloat(fabs(value));
+	} else {
+		snprintf(text, sizeof(text), "%lld", (long long)fabs(value));
+		number = text;
+	}
+	Node* node = newNode(NODE_NUMBER, number);
+	if (value < 0.0) {
+		Node* negate = newNode(NODE_UNARY, "-");
+		negate->children.push_back(node);
+		return negate;
+	}
+	return node;
+}
+
+static bool isVectorConstructor(const std::string& name) {
+	return name == "vec2" || name == "vec3" || name == "vec4" || name == "ivec2" || name == "ivec3" || name == "ivec4" ||
+		name == "uvec2" || name == "uvec3" || name == "uvec4";
+}
+
+// A constructor of literals, or a literal: something to inline wherever a constant is used.
+static bool isConstantValue(const Node* node) {
+	double value;
+	bool isFloat;
+	if (literalValue(node, &value, &isFloat)) {
+		return true;
+	}
+	if (node->kind != NODE_CALL || !isVectorConstructor(node->text)) {
+		return false;
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		if (!literalValue(node->children[i], &value, &isFloat)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int32_t swizzleIndex(char c) {
+	const char* sets[] = { "xyzw", "rgba", "stpq" };
+	for (int32_t i = 0; i < 3; ++i) {
+		const char* found = strchr(sets[i], c);
+		if (found && c) {
+			return (int32_t)(found - sets[i]);
+		}
+	}
+	return -1;
+}
+
+static bool isSwizzle(const std::string& field) {
+	if (field.empty() || field.size() > 4) {
+		return false;
+	}
+	for (size_t i = 0; i < field.size(); ++i) {
+		if (swizzleIndex(field[i]) < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool sameNode(const Node* a, const Node* b) {
+	if (a->kind != b->kind || a->text != b->text || a->children.size() != b->children.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a->children.size(); ++i) {
+		if (!sameNode(a->children[i], b->children[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static Node* fold(Node* node, bool* changed) {
+	if (!node) {
+		return NULL;
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		node->children[i] = fold(node->children[i], changed);
+	}
+	double a, b;
+	bool aFloat, bFloat;
+	if (node->kind == NODE_UNARY && node->text == "+") {
+		*changed = true;
+		return node->children[0];
+	}
+	if (node->kind == NODE_UNARY && node->text == "-" && node->children[0]->kind == NODE_UNARY &&
+		node->children[0]->text == "-") {
+		*changed = true;
+		return node->children[0]->children[0];
+	}
+	if (node->kind == NODE_BINARY) {
+		Node* left = node->children[0];
+		Node* right = node->children[1];
+		bool leftLiteral = literalValue(left, &a, &aFloat);
+		bool rightLiteral = literalValue(right, &b, &bFloat);
+		const std::string& op = node->text;
+		if (leftLiteral && rightLiteral && aFloat == bFloat) {
+			double result;
+			bool folded = true;
+			if (op == "+") {
+				result = a + b;
+			} else if (op == "-") {
+				result = a - b;
+			} else if (op == "*") {
+				result = a * b;
+			} else if (op == "/" && b != 0.0 && (aFloat || fmod(a, b) == 0.0)) {
+				result = a / b;
+			} else {
+				folded = false;
+			}
+			if (folded) {
+				*changed = true;
+				return literalNode(result, aFloat);
+			}
+		}
+		// identities that keep the other operand's type
+		if ((op == "*" && rightLiteral && b == 1.0) || (op == "/" && rightLiteral && b == 1.0) ||
+			((op == "+" || op == "-") && rightLiteral && b == 0.0)) {
+			*changed = true;
+			return left;
+		}
+		if ((op == "*" && leftLiteral && a == 1.0) || (op == "+" && leftLiteral && a == 0.0)) {
+			*changed = true;
+			return right;
+		}
+	}
+	if (node->kind == NODE_FIELD && isSwizzle(node->text) && isConstantValue(node->children[0])) {
+		// a component of a constant vector
+		Node* vector = node->children[0];
+		std::vector<Node*> picked;
+		for (size_t i = 0; i < node->text.size(); ++i) {
+			size_t index = vector->kind == NODE_CALL && vector->children.size() > 1 ? (size_t)swizzleIndex(node->text[i]) : 0;
+			Node* component = vector->kind == NODE_CALL ? vector->children[index < vector->children.size() ? index : 0] : vector;
+			picked.push_back(copyNode(component));
+		}
+		*changed = true;
+		if (picked.size() == 1) {
+			return picked[0];
+		}
+		Node* constructor = newNode(NODE_CALL, (vector->text[0] == 'v' ? "vec" : vector->text.substr(0, 4)) + std::string(1, '0' + picked.size()));
+		constructor->children = picked;
+		return constructor;
+	}
+	if (node->kind == NODE_CALL && isVectorConstructor(node->text) && node->children.size() > 1 &&
+		(int32_t)node->children.size() == components(node->text) && isConstantValue(node)) {
+		bool uniform = true;
+		for (size_t i = 1; i < node->children.size(); ++i) {
+			uniform &= sameNode(node->children[i], node->children[0]);
+		}
+		if (uniform) {
+			node->children.resize(1);
+			*changed = true;
+		}
+	}
+	if (node->kind == NODE_CALL && node->children.size() >= 1 && (node->text == "abs" || node->text == "sqrt" ||
+		node->text == "floor" || node->text == "ceil" || node->text == "min" || node->text == "max" || node->text == "clamp")) {
+		double values[3];
+		bool isFloat = true;
+		for (size_t i = 0; i < node->children.size(); ++i) {
+			bool argumentFloat;
+			if (i >= 3 || !literalValue(node->children[i], &values[i], &argumentFloat) || !argumentFloat) {
+				return node;
+			}
+		}
+		double result;
+		if (node->text == "abs") {
+			result = fabs(values[0]);
+		} else if (node->text == "sqrt") {
+			if (values[0] < 0.0) {
+				return node;
+			}
+			result = sqrt(values[0]);
+		} else if (node->text == "floor") {
+			result = floor(values[0]);
+		} else if (node->text == "ceil") {
+			result = ceil(values[0]);
+		} else if (node->text == "min" && node->children.size() == 2) {
+			result = fmin(values[0], values[1]);
+		} else if (node->text == "max" && node->children.size() == 2) {
+			result = fmax(values[0], values[1]);
+		} else if (node->text == "clamp" && node->children.size() == 3) {
+			result = fmin(fmax(values[0], values[1]), values[2]);
+		} else {
+			return node;
+		}
+		*changed = true;
+		return literalNode(result, isFloat);
+	}
+	return node;
+}
+
+static Node* substitute(Node* node, const std::string& name, const Node* value, bool* changed) {
+	if (!node) {
+		return NULL;
+	}
+	if (node->kind == NODE_IDENTIFIER && node->text == name) {
+		*changed = true;
+		return copyNode(value);
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		node->children[i] = substitute(node->children[i], name, value, changed);
+	}
+	return node;
+}
+
+static bool declaresName(const Global* function, const std::string& name) {
+	for (size_t i = 0; i < function->parameters.size(); ++i) {
+		if (function->parameters[i].name == name) {
+			return true;
+		}
+	}
+	for (size_t i = 0; i < function->body.size(); ++i) {
+		const Statement* statement = &function->body[i];
+		if (statement->kind == STATEMENT_DECLARATION && statement->name == name) {
+			return true;
+		}
+		for (size_t t = 0; t < statement->tokens.size(); ++t) {
+			if (statement->tokens[t].text == name) {
+				// may be a declaration in a nested block
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Inlines constants and variables only ever given a literal, then folds.
+static bool propagateConstants(Shader* shader) {
+	bool changed = false;
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		Global* global = &shader->globals[g];
+		if (global->removed) {
+			continue;
+		}
+		if (global->kind == GLOBAL_VARIABLE) {
+			global->value = fold(global->value, &changed);
+			if (!hasQualifier(global, "const") || !global->value || !isConstantValue(global->value) || !global->arraySize.empty()) {
+				continue;
+			}
+			for (size_t f = 0; f < shader->globals.size(); ++f) {
+				Global* other = &shader->globals[f];
+				if (other->removed || f == g) {
+					continue;
+				}
+				if (other->kind == GLOBAL_VARIABLE) {
+					other->value = substitute(other->value, global->name, global->value, &changed);
+				} else if (other->kind == GLOBAL_FUNCTION && !declaresName(other, global->name)) {
+					for (size_t i = 0; i < other->body.size(); ++i) {
+						other->body[i].value = substitute(other->body[i].value, global->name, global->value, &changed);
+						if (other->body[i].target) {
+							other->body[i].target = substitute(other->body[i].target, global->name, global->value, &changed);
+						}
+					}
+				}
+			}
+			continue;
+		}
+		if (global->kind != GLOBAL_FUNCTION) {
+			continue;
+		}
+		std::vector<Statement>& body = global->body;
+		for (size_t i = 0; i < body.size(); ++i) {
+			body[i].value = fold(body[i].value, &changed);
+			body[i].target = fold(body[i].target, &changed);
+		}
+		if (global->opaqueBody) {
+			continue;
+		}
+		for (size_t i = 0; i < body.size(); ++i) {
+			Statement* declaration = &body[i];
+			if (declaration->removed || declaration->kind != STATEMENT_DECLARATION || !declaration->value ||
+				!isConstantValue(declaration->value)) {
+				continue;
+			}
+			bool written = false;
+			for (size_t j = 0; j < body.size(); ++j) {
+				written |= !body[j].removed && body[j].kind == STATEMENT_ASSIGNMENT && body[j].name == declaration->name;
+			}
+			if (written) {
+				continue;
+			}
+			for (size_t j = i + 1; j < body.size(); ++j) {
+				body[j].value = substitute(body[j].value, declaration->name, declaration->value, &changed);
+				if (body[j].target) {
+					body[j].target = substitute(body[j].target, declaration->name, declaration->value, &changed);
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+// Dead code
+
+static bool removeDeadLocals(Shader* shader, Global* function) {
+	if (function->opaqueBody) {
+		return false;
+	}
+	std::set<std::string> locals;
+	for (size_t i = 0; i < function->parameters.size(); ++i) {
+		const Parameter& parameter = function->parameters[i];
+		bool output = false;
+		for (size_t q = 0; q < parameter.qualifiers.size(); ++q) {
+			output |= parameter.qualifiers[q] == "out" || parameter.qualifiers[q] == "inout";
+		}
+		if (!output) {
+			locals.insert(parameter.name);
+		}
+	}
+	for (size_t i = 0; i < function->body.size(); ++i) {
+		if (function->body[i].kind == STATEMENT_DECLARATION) {
+			locals.insert(function->body[i].name);
+		}
+	}
+	bool changed = false;
+	bool removed = true;
+	while (removed) {
+		removed = false;
+		std::map<std::string, int32_t> reads;
+		for (size_t i = 0; i < function->body.size(); ++i) {
+			if (!function->body[i].removed) {
+				countStatementReads(&function->body[i], &reads);
+			}
+		}
+		for (size_t i = 0; i < function->body.size(); ++i) {
+			Statement* statement = &function->body[i];
+			if (statement->removed || (statement->kind != STATEMENT_DECLARATION && statement->kind != STATEMENT_ASSIGNMENT) ||
+				!locals.count(statement->name) || reads[statement->name] > 0 || hasSideEffects(shader, statement->value)) {
+				continue;
+			}
+			statement->removed = true;
+			removed = true;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+static void countGlobalReads(const Shader* shader, std::map<std::string, int32_t>* reads) {
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		if (global->removed) {
+			continue;
+		}
+		if (global->kind == GLOBAL_OPAQUE) {
+			countTokenReads(global->tokens, reads);
+		} else if (global->kind == GLOBAL_VARIABLE) {
+			countReads(global->value, reads);
+			countTokenReads(global->arraySize, reads);
+		} else if (global->kind == GLOBAL_FUNCTION) {
+			for (size_t i = 0; i < global->body.size(); ++i) {
+				const Statement* statement = &global->body[i];
+				if (statement->removed) {
+					continue;
+				}
+				countStatementReads(statement, reads);
+				if (statement->kind == STATEMENT_ASSIGNMENT) {
+					// writes keep globals too, other than the varyings pruned separately
+					(*reads)[statement->name]++;
+				}
+			}
+		}
+	}
+}
+
+static void collectCalls(const Node* node, std::set<std::string>* calls) {
+	if (!node) {
+		return;
+	}
+	if (node->kind == NODE_CALL) {
+		calls->insert(node->text);
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		collectCalls(node->children[i], calls);
+	}
+}
+
+static bool removeUnusedGlobals(Shader* shader) {
+	bool changed = false;
+	// functions not reachable from main
+	std::set<std::string> reachable;
+	std::vector<std::string> pending(1, "main");
+	while (!pending.empty()) {
+		std::string name = pending.back();
+		pending.pop_back();
+		if (reachable.count(name)) {
+			continue;
+		}
+		reachable.insert(name);
+		for (size_t g = 0; g < shader->globals.size(); ++g) {
+			const Global* function = &shader->globals[g];
+			if (function->removed || function->kind != GLOBAL_FUNCTION || function->name != name) {
+				continue;
+			}
+			std::set<std::string> calls;
+			for (size_t i = 0; i < function->body.size(); ++i) {
+				const Statement* statement = &function->body[i];
+				if (statement->removed) {
+					continue;
+				}
+				collectCalls(statement->value, &calls);
+				collectCalls(statement->target, &calls);
+				for (size_t t = 0; t < statement->tokens.size(); ++t) {
+					calls.insert(statement->tokens[t].text);
+				}
+			}
+			pending.insert(pending.end(), calls.begin(), calls.end());
+		}
+	}
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		Global* global = &shader->globals[g];
+		if (!global->removed && global->kind == GLOBAL_FUNCTION && !reachable.count(global->name)) {
+			global->removed = true;
+			changed = true;
+		}
+	}
+
+	std::map<std::string, int32_t> reads;
+	countGlobalReads(shader, &reads);
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		Global* global = &shader->globals[g];
+		if (global->removed || global->kind != GLOBAL_VARIABLE || reads[global->name] > 0 ||
+			isVaryingOut(shader, global) || (shader->fragment && hasQualifier(global, "out")) ||
+			hasSideEffects(shader, global->value)) {
+			continue;
+		}
+		global->removed = true;
+		changed = true;
+	}
+	return changed;
+}
+
+static void optimizeStage(Shader* shader) {
+	bool changed = true;
+	while (changed) {
+		changed = propagateConstants(shader);
+		for (size_t g = 0; g < shader->globals.size(); ++g) {
+			Global* global = &shader->globals[g];
+			if (!global->removed && global->kind == GLOBAL_FUNCTION) {
+				changed |= removeDeadLocals(shader, global);
+			}
+		}
+		changed |= removeUnusedGlobals(shader);
+	}
+}
+
+// Removes vertex outputs the fragment stage doesn't read, with the statements writing them.
+static void pruneVaryings(Shader* vertex, const Shader* fragment) {
+	std::map<std::string, int32_t> reads;
+	countGlobalReads(fragment, &reads);
+	for (size_t g = 0; g < vertex->globals.size(); ++g) {
+		Global* varying = &vertex->globals[g];
+		if (varying->removed || varying->kind != GLOBAL_VARIABLE || !isVaryingOut(vertex, varying) ||
+			reads[varying->name] > 0 || varying->name.compare(0, 3, "gl_") == 0) {
+			continue;
+		}
+		bool removable = true;
+		for (size_t f = 0; f < vertex->globals.size(); ++f) {
+			Global* function = &vertex->globals[f];
+			if (function->removed || function->kind != GLOBAL_FUNCTION) {
+				continue;
+			}
+			for (size_t i = 0; i < function->body.size(); ++i) {
+				const Statement* statement = &function->body[i];
+				if (statement->removed) {
+					continue;
+				}
+				std::map<std::string, int32_t> statementReads;
+				countStatementReads(statement, &statementReads);
+				bool writes = statement->kind == STATEMENT_ASSIGNMENT && statement->name == varying->name;
+				if (statementReads[varying->name] > 0 || (writes && hasSideEffects(vertex, statement->value))) {
+					removable = false;
+				}
+			}
+		}
+		if (!removable) {
+			continue;
+		}
+		for (size_t f = 0; f < vertex->globals.size(); ++f) {
+			Global* function = &vertex->globals[f];
+			for (size_t i = 0; function->kind == GLOBAL_FUNCTION && i < function->body.size(); ++i) {
+				Statement* statement = &function->body[i];
+				if (statement->kind == STATEMENT_ASSIGNMENT && statement->name == varying->name) {
+					statement->removed = true;
+				}
+			}
+		}
+		varying->removed = true;
+		vertex->lowered.push_back(varying->name + " removed");
+	}
+}
+
+// Types, ranges and precision
+
+typedef std::map<std::string, std::string> TypeScope;
+
+static void globalTypes(const Shader* shader, TypeScope* types) {
+	(*types)["gl_Position"] = "vec4";
+	(*types)["gl_PointSize"] = "float";
+	(*types)["gl_FragCoord"] = "vec4";
+	(*types)["gl_PointCoord"] = "vec2";
+	(*types)["gl_FragColor"] = "vec4";
+	(*types)["gl_FragDepth"] = "float";
+	(*types)["gl_FrontFacing"] = "bool";
+	(*types)["gl_VertexID"] = "int";
+	(*types)["gl_InstanceID"] = "int";
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		if (!global->removed && global->kind == GLOBAL_VARIABLE) {
+			(*types)[global->name] = global->type;
+		}
+		if (global->removed || global->kind != GLOBAL_OPAQUE) {
+			continue;
+		}
+		// members of uniform blocks
+		for (size_t i = 2; i < global->tokens.size(); ++i) {
+			if (global->tokens[i].text == ";" && global->tokens[i - 1].type == TOKEN_IDENTIFIER &&
+				global->tokens[i - 2].type == TOKEN_IDENTIFIER) {
+				(*types)[global->tokens[i - 1].text] = global->tokens[i - 2].text;
+			}
+		}
+	}
+}
+
+static std::string returnType(const Shader* shader, const std::string& name) {
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		if (shader->globals[g].kind == GLOBAL_FUNCTION && shader->globals[g].name == name) {
+			return shader->globals[g].type;
+		}
+	}
+	return "float";
+}
+
+static std::string typeOf(const Shader* shader, const TypeScope& types, const Node* node) {
+	switch (node->kind) {
+	case NODE_NUMBER:
+		return isFloatLiteral(node->text) ? "float" : node->text.find_first_of("uU") != std::string::npos ? "uint" : "int";
+	case NODE_IDENTIFIER: {
+		TypeScope::const_iterator type = types.find(node->text);
+		return type != types.end() ? type->second : "float";
+	}
+	case NODE_FIELD: {
+		std::string base = typeOf(shader, types, node->children[0]);
+		if (!isSwizzle(node->text) || base.find("vec") == std::string::npos) {
+			return "float";
+		}
+		std::string scalar = scalarType(base);
+		if (node->text.size() == 1) {
+			return scalar;
+		}
+		std::string prefix = scalar == "int" ? "ivec" : scalar == "uint" ? "uvec" : scalar == "bool" ? "bvec" : "vec";
+		return prefix + std::string(1, '0' + node->text.size());
+	}
+	case NODE_INDEX: {
+		std::string base = typeOf(shader, types, node->children[0]);
+		if (base.compare(0, 3, "mat") == 0) {
+			return "vec" + std::string(1, base[3]);
+		}
+		return base.find("vec") != std::string::npos ? scalarType(base) : base;
+	}
+	case NODE_CALL:
+		if (isTypeName(node->text)) {
+			return node->text;
+		}
+		if (isTextureFunction(node->text)) {
+			return node->text == "textureSize" ? "ivec2" : "vec4";
+		}
+		if (node->text == "dot" || node->text == "length" || node->text == "distance" || node->text == "determinant") {
+			return "float";
+		}
+		if (node->text == "cross") {
+			return "vec3";
+		}
+		if ((node->text == "step" || node->text == "smoothstep") && !node->children.empty()) {
+			return typeOf(shader, types, node->children.back());
+		}
+		if (node->text == "any" || node->text == "all") {
+			return "bool";
+		}
+		if (isBuiltinFunction(node->text)) {
+			return node->children.empty() ? "float" : typeOf(shader, types, node->children[0]);
+		}
+		return returnType(shader, node->text);
+	case NODE_BINARY: {
+		int32_t precedence = binaryPrecedence(node->text);
+		if (precedence <= binaryPrecedence("<")) {
+			return "bool";
+		}
+		std::string left = typeOf(shader, types, node->children[0]);
+		std::string right = typeOf(shader, types, node->children[1]);
+		if (left.compare(0, 3, "mat") == 0 && right.find("vec") != std::string::npos) {
+			return right;
+		}
+		if (right.compare(0, 3, "mat") == 0 && left.find("vec") != std::string::npos) {
+			return left;
+		}
+		return components(right) > components(left) ? right : left;
+	}
+	case NODE_TERNARY:
+		return typeOf(shader, types, node->children[1]);
+	default:
+		return node->text == "!" ? "bool" : typeOf(shader, types, node->children[0]);
+	}
+}
+
+typedef std::map<std::string, Range> RangeScope;
+
+static Range rangeOf(const Shader* shader, const TypeScope& types, const RangeScope& ranges, const Node* node) {
+	double value;
+	bool isFloat;
+	if (literalValue(node, &value, &isFloat)) {
+		return makeRange(value, value);
+	}
+	switch (node->kind) {
+	case NODE_IDENTIFIER: {
+		if (node->text == "gl_PointCoord") {
+			return makeRange(0.0, 1.0);
+		}
+		RangeScope::const_iterator range = ranges.find(node->text);
+		return range != ranges.end() ? range->second : unknownRange();
+	}
+	case NODE_FIELD:
+	case NODE_INDEX:
+		return rangeOf(shader, types, ranges, node->children[0]);
+	case NODE_UNARY:
+		if (node->text == "-") {
+			Range range = rangeOf(shader, types, ranges, node->children[0]);
+			return range.known ? makeRange(-range.hi, -range.lo) : range;
+		}
+		return unknownRange();
+	case NODE_BINARY:
+		return rangeArithmetic(node->text, rangeOf(shader, types, ranges, node->children[0]), rangeOf(shader, types, ranges, node->children[1]));
+	case NODE_TERNARY:
+		return rangeUnion(rangeOf(shader, types, ranges, node->children[1]), rangeOf(shader, types, ranges, node->children[2]));
+	case NODE_CALL: {
+		const std::string& name = node->text;
+		std::vector<Range> arguments;
+		for (size_t i = 0; i < node->children.size(); ++i) {
+			arguments.push_back(rangeOf(shader, types, ranges, node->children[i]));
+		}
+		if (isVectorConstructor(name) || name == "float") {
+			Range range = emptyRange();
+			for (size_t i = 0; i < arguments.size(); ++i) {
+				range = rangeUnion(range, arguments[i]);
+			}
+			return range;
+		}
+		if (isTextureFunction(name)) {
+			return name == "textureSize" ? unknownRange() : makeRange(0.0, 1.0);
+		}
+		if (name == "sin" || name == "cos" || name == "normalize") {
+			return makeRange(-1.0, 1.0);
+		}
+		if (name == "fract" || name == "step" || name == "smoothstep") {
+			return makeRange(0.0, 1.0);
+		}
+		if (arguments.empty() || !arguments[0].known) {
+			return unknownRange();
+		}
+		Range first = arguments[0];
+		if (name == "clamp" && arguments.size() == 3 && arguments[1].known && arguments[2].known) {
+			return makeRange(fmax(first.lo, arguments[1].lo), fmin(first.hi, arguments[2].hi));
+		}
+		if ((name == "min" || name == "max") && arguments.size() == 2 && arguments[1].known) {
+			if (name == "min") {
+				return makeRange(fmin(first.lo, arguments[1].lo), fmin(first.hi, arguments[1].hi));
+			}
+			return makeRange(fmax(first.lo, arguments[1].lo), fmax(first.hi, arguments[1].hi));
+		}
+		if (name == "mix" && arguments.size() == 3 && rangeWithin(arguments[2], 1.0) && arguments[2].lo >= 0.0) {
+			return rangeUnion(first, arguments[1]);
+		}
+		if (name == "abs") {
+			double magnitude = fmax(fabs(first.lo), fabs(first.hi));
+			return makeRange(first.lo >= 0.0 ? first.lo : first.hi <= 0.0 ? -first.hi : 0.0, magnitude);
+		}
+		if (name == "sqrt" && first.lo >= 0.0) {
+			return makeRange(sqrt(first.lo), sqrt(first.hi));
+		}
+		if (name == "floor" || name == "ceil") {
+			return makeRange(floor(first.lo), ceil(first.hi));
+		}
+		if (name == "dot" && arguments.size() == 2) {
+			Range product = rangeArithmetic("*", first, arguments[1]);
+			double count = components(typeOf(shader, types, node->children[0]));
+			return product.known ? makeRange(fmin(product.lo, product.lo * count), fmax(product.hi, product.hi * count)) : product;
+		}
+		if (name == "length") {
+			double magnitude = fmax(fabs(first.lo), fabs(first.hi));
+			return makeRange(0.0, magnitude * sqrt((double)components(typeOf(shader, types, node->children[0]))));
+		}
+		return unknownRange();
+	}
+	default:
+		return unknownRange();
+	}
+}
+
+// Adds the identifiers in node to names; with onlyCritical, only those reaching a texture
+// coordinate, index, divisor or exponential, where lowp's eight bits aren't enough.
+static void collectCritical(const Node* node, bool critical, std::set<std::string>* names) {
+	if (!node) {
+		return;
+	}
+	if (node->kind == NODE_IDENTIFIER && critical) {
+		names->insert(node->text);
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		bool child = critical;
+		if (node->kind == NODE_CALL && isTextureFunction(node->text) && i > 0) {
+			child = true;
+		} else if (node->kind == NODE_INDEX && i == 1) {
+			child = true;
+		} else if (node->kind == NODE_BINARY && node->text == "/" && i == 1) {
+			child = true;
+		} else if (node->kind == NODE_CALL && (node->text == "pow" || node->text == "exp" || node->text == "exp2" ||
+			node->text == "log" || node->text == "log2" || node->text == "inversesqrt" || !isBuiltinFunction(node->text)) &&
+			!isTypeName(node->text)) {
+			child = true;
+		} else if (node->kind == NODE_BINARY && binaryPrecedence(node->text) <= binaryPrecedence("<")) {
+			// comparisons and conditions
+			child = true;
+		} else if (node->kind == NODE_TERNARY && i == 0) {
+			child = true;
+		}
+		collectCritical(node->children[i], child, names);
+	}
+}
+
+static bool hasOnlyMain(const Shader* shader) {
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		if (!global->removed && global->kind == GLOBAL_FUNCTION && (global->name != "main" || global->opaqueBody)) {
+			return false;
+		}
+		if (!global->removed && global->kind == GLOBAL_OPAQUE && !global->tokens.empty() && global->tokens[0].text != "layout" &&
+			global->tokens[0].text != "uniform") {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Ranges of every value main stores: the union over all its writes.
+static void analyzeRanges(const Shader* shader, const RangeScope& inputs, RangeScope* stored) {
+	TypeScope types;
+	globalTypes(shader, &types);
+	RangeScope current = inputs;
+	const Global* main = NULL;
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		if (global->removed || global->kind != GLOBAL_VARIABLE || inputs.count(global->name)) {
+			continue;
+		}
+		if (isAttribute(shader, global) || hasQualifier(global, "uniform") || isVaryingIn(shader, global)) {
+			current[global->name] = global->range;
+		} else {
+			current[global->name] = global->value ? rangeOf(shader, types, current, global->value) : emptyRange();
+			(*stored)[global->name] = current[global->name];
+		}
+	}
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		if (!shader->globals[g].removed && shader->globals[g].kind == GLOBAL_FUNCTION && shader->globals[g].name == "main") {
+			main = &shader->globals[g];
+		}
+	}
+	if (!main) {
+		return;
+	}
+	for (size_t i = 0; i < main->body.size(); ++i) {
+		const Statement* statement = &main->body[i];
+		if (statement->removed) {
+			continue;
+		}
+		if (statement->kind == STATEMENT_DECLARATION) {
+			types[statement->name] = statement->type;
+			Range range = statement->value ? rangeOf(shader, types, current, statement->value) : emptyRange();
+			current[statement->name] = range;
+			(*stored)[statement->name] = range;
+		} else if (statement->kind == STATEMENT_ASSIGNMENT) {
+			Range value = rangeOf(shader, types, current, statement->value);
+			Range range = value;
+			if (statement->op != "=") {
+				range = rangeArithmetic(statement->op.substr(0, statement->op.size() - 1), rangeOf(shader, types, current, statement->target), value);
+			}
+			if (statement->target->kind != NODE_IDENTIFIER && current.count(statement->name)) {
+				// a partial write keeps the rest of the value
+				range = rangeUnion(range, current[statement->name]);
+			}
+			current[statement->name] = range;
+			RangeScope::iterator previous = stored->find(statement->name);
+			(*stored)[statement->name] = previous != stored->end() ? rangeUnion(previous->second, range) : range;
+		}
+	}
+}
+
+// Names whose values reach somewhere lowp isn't precise enough, following stores back to their sources.
+static void analyzeCritical(const Shader* shader, std::set<std::string>* critical) {
+	std::vector<const Statement*> statements;
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		for (size_t i = 0; !global->removed && global->kind == GLOBAL_FUNCTION && i < global->body.size(); ++i) {
+			if (!global->body[i].removed) {
+				statements.push_back(&global->body[i]);
+			}
+		}
+	}
+	for (size_t i = 0; i < statements.size(); ++i) {
+		collectCritical(statements[i]->value, false, critical);
+		collectCritical(statements[i]->target, false, critical);
+		if (statements[i]->kind == STATEMENT_ASSIGNMENT && statements[i]->op == "/=") {
+			collectCritical(statements[i]->value, true, critical);
+		}
+		if (statements[i]->kind == STATEMENT_RETURN) {
+			collectCritical(statements[i]->value, true, critical);
+		}
+	}
+	bool grown = true;
+	while (grown) {
+		grown = false;
+		for (size_t i = 0; i < statements.size(); ++i) {
+			const Statement* statement = statements[i];
+			if ((statement->kind == STATEMENT_DECLARATION || statement->kind == STATEMENT_ASSIGNMENT) &&
+				critical->count(statement->name)) {
+				size_t before = critical->size();
+				collectCritical(statement->value, true, critical);
+				grown |= critical->size() != before;
+			}
+		}
+	}
+}
+
+static bool canLower(const std::string& type) {
+	return scalarType(type) == "float" && type.compare(0, 3, "mat") != 0;
+}
+
+// Lowers precision in the fragment stage and, given it, the varyings the vertex stage writes.
+static void lowerPrecision(Shader* vertex, Shader* fragment) {
+	bool vertexAnalyzable = !vertex || hasOnlyMain(vertex);
+	RangeScope vertexStored;
+	if (vertex && vertexAnalyzable) {
+		analyzeRanges(vertex, RangeScope(), &vertexStored);
+	}
+	RangeScope varyings;
+	std::map<std::string, std::string> varyingPrecision;
+	if (fragment && hasOnlyMain(fragment)) {
+		for (size_t g = 0; g < fragment->globals.size(); ++g) {
+			const Global* global = &fragment->globals[g];
+			if (global->removed || global->kind != GLOBAL_VARIABLE || !isVaryingIn(fragment, global)) {
+				continue;
+			}
+			if (vertex) {
+				varyings[global->name] = vertexAnalyzable && vertexStored.count(global->name) ? vertexStored[global->name] : unknownRange();
+			} else {
+				varyings[global->name] = global->range;
+			}
+		}
+		RangeScope stored;
+		analyzeRanges(fragment, varyings, &stored);
+		std::set<std::string> critical;
+		analyzeCritical(fragment, &critical);
+		for (size_t g = 0; g < fragment->globals.size(); ++g) {
+			Global* global = &fragment->globals[g];
+			if (global->removed || global->kind != GLOBAL_VARIABLE || !isVaryingIn(fragment, global)) {
+				continue;
+			}
+			if (global->precision.empty() && canLower(global->type) && rangeWithin(varyings[global->name], LOWP_LIMIT) &&
+				!critical.count(global->name)) {
+				global->precision = "lowp";
+				fragment->lowered.push_back(global->name + " lowp");
+			}
+			varyingPrecision[global->name] = global->precision.empty() ? defaultPrecision(fragment, global->type) : global->precision;
+		}
+		for (size_t g = 0; g < fragment->globals.size(); ++g) {
+			Global* function = &fragment->globals[g];
+			for (size_t i = 0; !function->removed && function->kind == GLOBAL_FUNCTION && i < function->body.size(); ++i) {
+				Statement* statement = &function->body[i];
+				if (statement->removed || statement->kind != STATEMENT_DECLARATION || statement->constant ||
+					!statement->precision.empty() || !canLower(statement->type) || critical.count(statement->name) ||
+					!rangeWithin(stored[statement->name], LOWP_LIMIT) || rangeEmpty(stored[statement->name])) {
+					continue;
+				}
+				statement->precision = "lowp";
+				fragment->lowered.push_back(statement->name + " lowp");
+			}
+		}
+	}
+	if (!vertex || !fragment || !vertexAnalyzable) {
+		return;
+	}
+	for (size_t g = 0; g < vertex->globals.size(); ++g) {
+		Global* global = &vertex->globals[g];
+		if (global->removed || global->kind != GLOBAL_VARIABLE || !isVaryingOut(vertex, global) || !global->precision.empty() ||
+			!canLower(global->type) || !varyingPrecision.count(global->name)) {
+			continue;
+		}
+		// the fragment stage reads no more precision than it declares
+		const std::string& precision = varyingPrecision[global->name];
+		if ((precision == "lowp" || precision == "mediump") && rangeWithin(vertexStored[global->name], precision == "lowp" ? LOWP_LIMIT : MEDIUMP_LIMIT)) {
+			global->precision = precision;
+			vertex->lowered.push_back(global->name + " " + precision);
+		}
+	}
+}
+
+// Renaming
+
+static std::string shortName(int32_t index) {
+	static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	std::string name;
+	name += letters[index % 52];
+	for (index /= 52; index > 0; index /= 52) {
+		name += letters[(index - 1) % 52];
+	}
+	return name;
+}
+
+static void renameNode(Node* node, const std::map<std::string, std::string>& names) {
+	if (!node) {
+		return;
+	}
+	if (node->kind == NODE_IDENTIFIER || node->kind == NODE_CALL) {
+		std::map<std::string, std::string>::const_iterator name = names.find(node->text);
+		if (name != names.end()) {
+			node->text = name->second;
+		}
+	}
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		renameNode(node->children[i], names);
+	}
+}
+
+static void renameTokens(std::vector<Token>* tokens, const std::map<std::string, std::string>& names) {
+	for (size_t i = 0; i < tokens->size(); ++i) {
+		Token* token = &(*tokens)[i];
+		std::map<std::string, std::string>::const_iterator name = names.find(token->text);
+		if (token->type == TOKEN_IDENTIFIER && (i == 0 || (*tokens)[i - 1].text != ".") && name != names.end()) {
+			token->text = name->second;
+		}
+	}
+}
+
+// Shortens the names of locals, parameters, functions and non-interface globals; interface names
+// are kept so the app's attribute and uniform lookups, and other programs sharing a stage, still match.
+static void renameIdentifiers(Shader* shader) {
+	std::vector<std::string> order;
+	std::set<std::string> renamed;
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		Global* global = &shader->globals[g];
+		if (global->removed) {
+			continue;
+		}
+		if ((global->kind == GLOBAL_VARIABLE && !isInterface(shader, global)) || (global->kind == GLOBAL_FUNCTION && global->name != "main")) {
+			if (renamed.insert(global->name).second) {
+				order.push_back(global->name);
+			}
+		}
+		for (size_t i = 0; global->kind == GLOBAL_FUNCTION && i < global->parameters.size(); ++i) {
+			if (!global->parameters[i].name.empty() && renamed.insert(global->parameters[i].name).second) {
+				order.push_back(global->parameters[i].name);
+			}
+		}
+		for (size_t i = 0; global->kind == GLOBAL_FUNCTION && i < global->body.size(); ++i) {
+			if (global->body[i].kind == STATEMENT_DECLARATION && !global->body[i].removed && renamed.insert(global->body[i].name).second) {
+				order.push_back(global->body[i].name);
+			}
+		}
+	}
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		// struct types, block members and interface names are referred to by name, even where shadowed
+		const Global* global = &shader->globals[g];
+		for (size_t i = 0; global->kind == GLOBAL_OPAQUE && i < global->tokens.size(); ++i) {
+			renamed.erase(global->tokens[i].text);
+		}
+		if (global->kind == GLOBAL_VARIABLE && isInterface(shader, global)) {
+			renamed.erase(global->name);
+		}
+	}
+	std::map<std::string, std::string> names;
+	int32_t next = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if (!renamed.count(order[i])) {
+			continue;
+		}
+		std::string name;
+		do {
+			name = shortName(next++);
+		} while (isKeyword(name) || isTypeName(name) || isBuiltinFunction(name) ||
+			(shader->identifiers.count(name) && !renamed.count(name)));
+		names[order[i]] = name;
+	}
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		Global* global = &shader->globals[g];
+		if (global->removed) {
+			continue;
+		}
+		if (names.count(global->name) && global->kind != GLOBAL_OPAQUE) {
+			global->name = names[global->name];
+		}
+		renameNode(global->value, names);
+		renameTokens(&global->arraySize, names);
+		for (size_t i = 0; i < global->parameters.size(); ++i) {
+			if (names.count(global->parameters[i].name)) {
+				global->parameters[i].name = names[global->parameters[i].name];
+			}
+		}
+		for (size_t i = 0; i < global->body.size(); ++i) {
+			Statement* statement = &global->body[i];
+			if (names.count(statement->name)) {
+				statement->name = names[statement->name];
+			}
+			renameNode(statement->value, names);
+			renameNode(statement->target, names);
+			renameTokens(&statement->tokens, names);
+		}
+	}
+}
+
+// Output
+
+struct Writer {
+	std::string text;
+	std::string last;
+};
+
+static bool isWordChar(char c) {
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+static void write(Writer* writer, const std::string& token) {
+	if (!writer->text.empty() && writer->text[writer->text.size() - 1] != '\n' && !writer->last.empty()) {
+		char a = writer->last[writer->last.size() - 1];
+		char b = token[0];
+		bool space = (isWordChar(a) && isWordChar(b)) || ((a == '+' || a == '-') && b == a) ||
+			(strchr("+-*/%<>=!&|^", a) && b == '=') || (a == '&' && b == '&') || (a == '|' && b == '|') ||
+			(a == '^' && b == '^') || ((a == '<' || a == '>') && b == a);
+		if (space) {
+			writer->text += ' ';
+		}
+	}
+	writer->text += token;
+	writer->last = token;
+}
+
+static void writeDirective(Writer* writer, const std::string& text) {
+	if (!writer->text.empty() && writer->text[writer->text.size() - 1] != '\n') {
+		writer->text += '\n';
+	}
+	// one space between words
+	bool space = false;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (isspace((unsigned char)text[i])) {
+			space = true;
+			continue;
+		}
+		if (space && writer->text[writer->text.size() - 1] != '\n' && text[i - 1] != '#') {
+			writer->text += ' ';
+		}
+		space = false;
+		writer->text += text[i];
+	}
+	writer->text += '\n';
+	writer->last.clear();
+}
+
+static int32_t nodePrecedence(const Node* node) {
+	switch (node->kind) {
+	case NODE_BINARY:
+		return binaryPrecedence(node->text);
+	case NODE_TERNARY:
+		return PRECEDENCE_TERNARY;
+	case NODE_UNARY:
+		return PRECEDENCE_UNARY;
+	default:
+		return PRECEDENCE_POSTFIX;
+	}
+}
+
+static void writeNode(Writer* writer, const Node* node, int32_t minPrecedence) {
+	bool parenthesize = nodePrecedence(node) < minPrecedence;
+	if (parenthesize) {
+		write(writer, "(");
+	}
+	switch (node->kind) {
+	case NODE_NUMBER: {
+		double value = 0.0;
+		bool isFloat = false;
+		bool literal = literalValue(node, &value, &isFloat);
+		write(writer, literal && isFloat && node->text.find_first_of("fF") == std::string::npos ? formatFloat(value) : node->text);
+		break;
+	}
+	case NODE_IDENTIFIER:
+		write(writer, node->text);
+		break;
+	case NODE_UNARY:
+		write(writer, node->text);
+		writeNode(writer, node->children[0], PRECEDENCE_UNARY);
+		break;
+	case NODE_POSTFIX:
+		writeNode(writer, node->children[0], PRECEDENCE_POSTFIX);
+		write(writer, node->text);
+		break;
+	case NODE_BINARY: {
+		int32_t precedence = binaryPrecedence(node->text);
+		writeNode(writer, node->children[0], precedence);
+		write(writer, node->text);
+		writeNode(writer, node->children[1], precedence + 1);
+		break;
+	}
+	case NODE_TERNARY:
+		writeNode(writer, node->children[0], PRECEDENCE_TERNARY + 1);
+		write(writer, "?");
+		writeNode(writer, node->children[1], PRECEDENCE_TERNARY);
+		write(writer, ":");
+		writeNode(writer, node->children[2], PRECEDENCE_TERNARY);
+		break;
+	case NODE_CALL:
+		write(writer, node->text);
+		write(writer, "(");
+		for (size_t i = 0; i < node->children.size(); ++i) {
+			if (i) {
+				write(writer, ",");
+			}
+			writeNode(writer, node->children[i], PRECEDENCE_TERNARY);
+		}
+		write(writer, ")");
+		break;
+	case NODE_FIELD:
+		writeNode(writer, node->children[0], PRECEDENCE_POSTFIX);
+		write(writer, ".");
+		write(writer, node->text);
+		break;
+	case NODE_INDEX:
+		writeNode(writer, node->children[0], PRECEDENCE_POSTFIX);
+		write(writer, "[");
+		writeNode(writer, node->children[1], PRECEDENCE_TERNARY);
+		write(writer, "]");
+		break;
+	}
+	if (parenthesize) {
+		write(writer, ")");
+	}
+}
+
+static void writeTokens(Writer* writer, const std::vector<Token>& tokens) {
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		if (tokens[i].type == TOKEN_NUMBER && isFloatLiteral(tokens[i].text) && tokens[i].text.find_first_of("fF") == std::string::npos) {
+			write(writer, formatFloat(strtod(tokens[i].text.c_str(), NULL)));
+		} else {
+			write(writer, tokens[i].text);
+		}
+	}
+}
+
+static void writeStatement(Writer* writer, const Statement* statement) {
+	switch (statement->kind) {
+	case STATEMENT_DECLARATION:
+		if (statement->constant) {
+			write(writer, "const");
+		}
+		if (!statement->precision.empty()) {
+			write(writer, statement->precision);
+		}
+		write(writer, statement->type);
+		write(writer, statement->name);
+		if (statement->value) {
+			write(writer, "=");
+			writeNode(writer, statement->value, PRECEDENCE_TERNARY);
+		}
+		break;
+	case STATEMENT_ASSIGNMENT:
+		writeNode(writer, statement->target, PRECEDENCE_UNARY);
+		write(writer, statement->op);
+		writeNode(writer, statement->value, PRECEDENCE_TERNARY);
+		break;
+	case STATEMENT_RETURN:
+		write(writer, "return");
+		if (statement->value) {
+			writeNode(writer, statement->value, PRECEDENCE_TERNARY);
+		}
+		break;
+	case STATEMENT_EXPRESSION:
+		writeNode(writer, statement->value, PRECEDENCE_TERNARY);
+		break;
+	case STATEMENT_OPAQUE:
+		writeTokens(writer, statement->tokens);
+		return;
+	}
+	write(writer, ";");
+}
+
+static std::string writeShader(const Shader* shader) {
+	Writer writer;
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		if (global->removed) {
+			continue;
+		}
+		switch (global->kind) {
+		case GLOBAL_DIRECTIVE:
+			writeDirective(&writer, global->tokens[0].text);
+			break;
+		case GLOBAL_PRECISION:
+		case GLOBAL_OPAQUE:
+			writeTokens(&writer, global->tokens);
+			break;
+		case GLOBAL_VARIABLE:
+			for (size_t i = 0; i < global->qualifiers.size(); ++i) {
+				write(&writer, global->qualifiers[i]);
+			}
+			if (!global->precision.empty()) {
+				write(&writer, global->precision);
+			}
+			write(&writer, global->type);
+			write(&writer, global->name);
+			writeTokens(&writer, global->arraySize);
+			if (global->value) {
+				write(&writer, "=");
+				writeNode(&writer, global->value, PRECEDENCE_TERNARY);
+			}
+			write(&writer, ";");
+			break;
+		case GLOBAL_FUNCTION:
+			write(&writer, global->type);
+			write(&writer, global->name);
+			write(&writer, "(");
+			for (size_t i = 0; i < global->parameters.size(); ++i) {
+				const Parameter& parameter = global->parameters[i];
+				if (i) {
+					write(&writer, ",");
+				}
+				for (size_t q = 0; q < parameter.qualifiers.size(); ++q) {
+					write(&writer, parameter.qualifiers[q]);
+				}
+				write(&writer, parameter.type);
+				if (!parameter.name.empty()) {
+					write(&writer, parameter.name);
+				}
+			}
+			write(&writer, ")");
+			write(&writer, "{");
+			for (size_t i = 0; i < global->body.size(); ++i) {
+				if (!global->body[i].removed) {
+					writeStatement(&writer, &global->body[i]);
+				}
+			}
+			write(&writer, "}");
+			break;
+		}
+	}
+	if (!writer.text.empty() && writer.text[writer.text.size() - 1] != '\n') {
+		writer.text += '\n';
+	}
+	return writer.text;
+}
+
+// Cost estimate: one per component for arithmetic, four for division and transcendental built-ins,
+// by the precision the operation runs at (the highest of its operands').
+
+static int32_t estimateNode(const Shader* shader, const TypeScope& types, const std::map<std::string, int32_t>& precisions,
+	const Node* node, Cost* cost) {
+	int32_t precision = 0;
+	for (size_t i = 0; i < node->children.size(); ++i) {
+		int32_t child = estimateNode(shader, types, precisions, node->children[i], cost);
+		precision = child > precision ? child : precision;
+	}
+	int32_t operations = 0;
+	int32_t count = components(typeOf(shader, types, node));
+	if (node->kind == NODE_IDENTIFIER) {
+		std::map<std::string, int32_t>::const_iterator found = precisions.find(node->text);
+		return found != precisions.end() ? found->second : 0;
+	}
+	if (node->kind == NODE_BINARY) {
+		std::string left = typeOf(shader, types, node->children[0]);
+		std::string right = typeOf(shader, types, node->children[1]);
+		if (node->text == "*" && left.compare(0, 3, "mat") == 0 && right.compare(0, 3, "mat") != 0) {
+			operations = components(left);
+		} else {
+			operations = node->text == "/" ? 4 * count : count;
+		}
+	} else if (node->kind == NODE_TERNARY || (node->kind == NODE_UNARY && node->text != "-" && node->text != "+") ||
+		node->kind == NODE_POSTFIX) {
+		operations = count;
+	} else if (node->kind == NODE_CALL) {
+		const std::string& name = node->text;
+		int32_t argument = node->children.empty() ? 1 : components(typeOf(shader, types, node->children[0]));
+		if (isTextureFunction(name)) {
+			cost->textures++;
+			std::map<std::string, int32_t>::const_iterator sampler = precisions.end();
+			if (!node->children.empty() && node->children[0]->kind == NODE_IDENTIFIER) {
+				sampler = precisions.find(node->children[0]->text);
+			}
+			// results come at the sampler's precision
+			return sampler != precisions.end() ? sampler->second : precision;
+		}
+		if (name == "dot") {
+			operations = argument;
+		} else if (name == "length") {
+			operations = argument + 4;
+		} else if (name == "distance") {
+			operations = 2 * argument + 4;
+		} else if (name == "normalize") {
+			operations = 2 * argument + 4;
+		} else if (name == "cross") {
+			operations = 6;
+		} else if (name == "clamp" || name == "mix") {
+			operations = 2 * count;
+		} else if (name == "smoothstep") {
+			operations = 6 * count;
+		} else if (name == "sqrt" || name == "inversesqrt" || name == "sin" || name == "cos" || name == "tan" ||
+			name == "exp" || name == "exp2" || name == "log" || name == "log2" || name == "pow" || name == "asin" ||
+			name == "acos" || name == "atan") {
+			operations = 4 * count;
+		} else if (isBuiltinFunction(name)) {
+			operations = count;
+		}
+	}
+	if (operations) {
+		cost->alu += operations;
+		cost->byPrecision[precision] += operations;
+	}
+	return precision;
+}
+
+static Cost estimateCost(const Shader* shader) {
+	Cost cost;
+	memset(&cost, 0, sizeof(cost));
+	TypeScope types;
+	globalTypes(shader, &types);
+	std::map<std::string, int32_t> precisions;
+	for (TypeScope::const_iterator type = types.begin(); type != types.end(); ++type) {
+		precisions[type->first] = precisionLevel(defaultPrecision(shader, type->second));
+	}
+	precisions["gl_PointCoord"] = precisionLevel("mediump");
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* global = &shader->globals[g];
+		if (!global->removed && global->kind == GLOBAL_VARIABLE && !global->precision.empty()) {
+			precisions[global->name] = precisionLevel(global->precision);
+		}
+	}
+	std::string floatPrecision = defaultPrecision(shader, "float");
+	for (size_t g = 0; g < shader->globals.size(); ++g) {
+		const Global* function = &shader->globals[g];
+		if (function->removed || function->kind != GLOBAL_FUNCTION) {
+			continue;
+		}
+		TypeScope scope = types;
+		std::map<std::string, int32_t> scopePrecisions = precisions;
+		for (size_t i = 0; i < function->parameters.size(); ++i) {
+			scope[function->parameters[i].name] = function->parameters[i].type;
+			scopePrecisions[function->parameters[i].name] = precisionLevel(defaultPrecision(shader, function->parameters[i].type));
+		}
+		for (size_t i = 0; i < function->body.size(); ++i) {
+			const Statement* statement = &function->body[i];
+			if (statement->removed) {
+				continue;
+			}
+			if (statement->kind == STATEMENT_DECLARATION) {
+				scope[statement->name] = statement->type;
+				scopePrecisions[statement->name] = precisionLevel(statement->precision.empty() ?
+					defaultPrecision(shader, statement->type) : statement->precision);
+			}
+			if (statement->value) {
+				estimateNode(shader, scope, scopePrecisions, statement->value, &cost);
+			}
+			if (statement->kind == STATEMENT_ASSIGNMENT && statement->op != "=") {
+				int32_t operations = components(typeOf(shader, scope, statement->target));
+				std::map<std::string, int32_t>::const_iterator precision = scopePrecisions.find(statement->name);
+				cost.alu += operations;
+				cost.byPrecision[precision != scopePrecisions.end() ? precision->second : precisionLevel(floatPrecision)] += operations;
+			}
+		}
+	}
+	return cost;
+}
+
+// Header
+
+static std::string baseName(const char* path) {
+	const char* slash = strrchr(path, '/');
+	std::string name = slash ? slash + 1 : path;
+	size_t dot = name.rfind('.');
+	return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static std::string camelCase(const std::string& name) {
+	std::string result;
+	bool upper = false;
+	for (size_t i = 0; i < name.size(); ++i) {
+		if (name[i] == '_') {
+			upper = true;
+		} else {
+			result += upper ? (char)toupper((unsigned char)name[i]) : name[i];
+			upper = false;
+		}
+	}
+	return result;
+}
+
+static std::string upperCase(const std::string& name) {
+	std::string result;
+	for (size_t i = 0; i < name.size(); ++i) {
+		result += (char)toupper((unsigned char)name[i]);
+	}
+	return result;
+}
+
+static void writeStringLiteral(FILE* file, const std::string& source) {
+	// split at newlines, and long lines after a statement or brace
+	size_t column = 0;
+	fputs("\t\"", file);
+	for (size_t i = 0; i < source.size(); ++i) {
+		if (source[i] == '\n') {
+			fputs("\\n\"", file);
+			if (i + 1 < source.size()) {
+				fputs("\n\t\"", file);
+			}
+			column = 0;
+			continue;
+		}
+		if (source[i] == '"' || source[i] == '\\') {
+			fputc('\\', file);
+		}
+		fputc(source[i], file);
+		++column;
+		if (column >= 80 && strchr(";{}", source[i]) && i + 2 < source.size() && source[i + 1] != '\n' && source[i + 2] != '\n') {
+			fputs("\"\n\t\"", file);
+			column = 0;
+		}
+	}
+	fputs(";\n", file);
+}
+
+static uint64_t inputHash(Shader* const* shaders, int32_t count) {
+	char version[32];
+	snprintf(version, sizeof(version), "shader_tool %d", SHADER_TOOL_VERSION);
+	uint64_t hash = fnv1a(14695981039346656037ull, version);
+	for (int32_t i = 0; i < count; ++i) {
+		hash = fnv1a(hash, shaders[i]->text);
+	}
+	return hash;
+}
+
+static bool writeHeader(const Options* options, Shader* const* shaders, const std::string* outputs, int32_t count, uint64_t input) {
+	std::string name = baseName(options->output);
+	uint64_t hash = 14695981039346656037ull;
+	for (int32_t i = 0; i < count; ++i) {
+		hash = fnv1a(hash, outputs[i]);
+	}
+	FILE* file = fopen(options->output, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not create %s\n", options->output);
+		return false;
+	}
+	fprintf(file, "// Generated by tools/shader_tool.cpp from ");
+	for (int32_t i = 0; i < count; ++i) {
+		fprintf(file, "%s%s", i ? " and " : "", (baseName(shaders[i]->path) + strrchr(shaders[i]->path, '.')).c_str());
+	}
+	fprintf(file, "; do not edit.\n");
+	fprintf(file, "// input hash 0x%016llx\n\n", (unsigned long long)input);
+	fprintf(file, "#pragma once\n\n");
+	fprintf(file, "#define %s_SOURCE_HASH 0x%016llxull\n", upperCase(name).c_str(), (unsigned long long)hash);
+	for (int32_t i = 0; i < count; ++i) {
+		fprintf(file, "\nstatic const char %s%s[] =\n", camelCase(name).c_str(), shaders[i]->fragment ? "FragmentShader" : "VertexShader");
+		writeStringLiteral(file, outputs[i]);
+	}
+	bool succeeded = !ferror(file);
+	return fclose(file) == 0 && succeeded;
+}
+
+static bool checkHeader(const char* path, uint64_t input) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "%s is missing\n", path);
+		return false;
+	}
+	char line[256];
+	unsigned long long recorded = 0;
+	bool found = false;
+	while (!found && fgets(line, sizeof(line), file)) {
+		found = sscanf(line, "// input hash 0x%llx", &recorded) == 1;
+	}
+	fclose(file);
+	if (!found || recorded != input) {
+		fprintf(stderr, "%s is out of date; run shader_tool again\n", path);
+		return false;
+	}
+	return true;
+}
+
+static void printCost(const char* label, const Cost* cost) {
+	printf("%s ALU %3d (highp %3d mediump %3d lowp %3d) texture %d", label, cost->alu, cost->byPrecision[3],
+		cost->byPrecision[2] + cost->byPrecision[0], cost->byPrecision[1], cost->textures);
+}
+
+static bool parseOptions(int argc, char** argv, Options* options) {
+	memset(options, 0, sizeof(Options));
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--check") == 0) {
+			options->check = true;
+		} else if (strcmp(argv[i], "--report") == 0) {
+			options->report = true;
+		} else if (argv[i][0] == '-') {
+			return false;
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() < 2 || paths.size() > 3) {
+		return false;
+	}
+	options->inputCount = (int32_t)paths.size() - 1;
+	for (int32_t i = 0; i < options->inputCount; ++i) {
+		options->inputs[i] = paths[i];
+	}
+	options->output = paths.back();
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, &options)) {
+		fprintf(stderr, "Usage: %s [--check] [--report] input.vert [input.frag] output.h\n", argv[0]);
+		return 1;
+	}
+
+	Shader shaders[2];
+	Shader originals[2];
+	Shader* vertex = NULL;
+	Shader* fragment = NULL;
+	for (int32_t i = 0; i < options.inputCount; ++i) {
+		if (!loadShader(&shaders[i], options.inputs[i]) || !loadShader(&originals[i], options.inputs[i])) {
+			return 1;
+		}
+		Shader** stage = shaders[i].fragment ? &fragment : &vertex;
+		if (*stage) {
+			fprintf(stderr, "Expected at most one vertex and one fragment shader\n");
+			return 1;
+		}
+		*stage = &shaders[i];
+	}
+	Shader* ordered[2];
+	int32_t count = 0;
+	if (vertex) {
+		ordered[count++] = vertex;
+	}
+	if (fragment) {
+		ordered[count++] = fragment;
+	}
+	uint64_t input = inputHash(ordered, count);
+	if (options.check) {
+		return checkHeader(options.output, input) ? 0 : 1;
+	}
+
+	if (fragment) {
+		optimizeStage(fragment);
+	}
+	if (vertex) {
+		if (fragment) {
+			pruneVaryings(vertex, fragment);
+		}
+		optimizeStage(vertex);
+	}
+	lowerPrecision(vertex, fragment);
+
+	std::string outputs[2];
+	Cost after[2];
+	for (int32_t i = 0; i < count; ++i) {
+		after[i] = estimateCost(ordered[i]);
+		renameIdentifiers(ordered[i]);
+		outputs[i] = writeShader(ordered[i]);
+	}
+	if (!writeHeader(&options, ordered, outputs, count, input)) {
+		return 1;
+	}
+
+	for (int32_t i = 0; i < count; ++i) {
+		const Shader* shader = ordered[i];
+		printf("%s: %zu -> %zu bytes", shader->path, shader->text.size(), outputs[i].size());
+		for (size_t l = 0; l < shader->lowered.size(); ++l) {
+			printf("%s%s", l ? ", " : "; ", shader->lowered[l].c_str());
+		}
+		printf("\n");
+		if (options.report) {
+			const Shader* original = &originals[&shaders[0] == shader ? 0 : 1];
+			Cost before = estimateCost(original);
+			printCost("  before", &before);
+			printf("\n");
+			printCost("  after ", &after[i]);
+			printf("\n");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,240 @@
+// Replays recorded touch traces through the pointer predictor in jni/touch_predictor.cpp, to
+// measure and tune it on the host.
+//
+// Build on the host with:   c++ -O2 -o touch_replay tools/touch_replay.cpp jni/touch_predictor.cpp
+// Usage:                    touch_replay [options] trace.txt
+//                           touch_replay [options] --synthetic
+// Options:                  --order N --gain G --max-speed PX_PER_S --window MS --horizon MS
+//                           --frame MS --latency FRAMES --sweep
+//
+// A trace has one sample per line, "touch <down|move|up> <nanoseconds> <x> <y>"; anything before
+// "touch " on a line is ignored, so logcat output of a build with -DTOUCH_TRACE works as is.
+// Frames are simulated at a fixed interval: each frame consumes the samples that arrived before
+// it started, as the app does, and predicts the pointer at start + latency frames. --sweep
+// searches order and gain for the lowest mean error.
+
+#include "../jni/touch_predictor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+enum TouchAction {
+	TOUCH_DOWN,
+	TOUCH_MOVE,
+	TOUCH_UP
+};
+
+struct TraceSample {
+	TouchAction action;
+	int64_t nanoseconds;
+	float x, y;
+};
+
+struct Options {
+	TouchPredictorConfig config;
+	int64_t frameNanoseconds;
+	float latencyFrames;
+	bool sweep;
+	bool synthetic;
+	const char* input;
+};
+
+static double nowSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool loadTrace(const char* path, std::vector<TraceSample>* samples) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+	char line[512];
+	while (fgets(line, sizeof(line), file)) {
+		const char* p = strstr(line, "touch ");
+		char action[16];
+		long long nanoseconds;
+		TraceSample sample;
+		if (!p || sscanf(p, "touch %15s %lld %f %f", action, &nanoseconds, &sample.x, &sample.y) != 4) {
+			continue;
+		}
+		if (strcmp(action, "down") == 0) {
+			sample.action = TOUCH_DOWN;
+		} else if (strcmp(action, "up") == 0) {
+			sample.action = TOUCH_UP;
+		} else {
+			sample.action = TOUCH_MOVE;
+		}
+		sample.nanoseconds = nanoseconds;
+		samples->push_back(sample);
+	}
+	fclose(file);
+	return true;
+}
+
+// Strokes of varying speed sampled at 120 Hz with a little jitter, similar to a touchscreen's
+// batched reports: a circle, a fast fling that decelerates, and a zigzag.
+static void makeSyntheticTrace(std::vector<TraceSample>* samples) {
+	const int64_t interval = 8333333;
+	uint32_t random = 1;
+	int64_t t = 0;
+	for (int stroke = 0; stroke < 3; ++stroke) {
+		int count = 120;
+		for (int i = 0; i < count; ++i) {
+			float s = static_cast<float>(i) / (count - 1);
+			float x, y;
+			if (stroke == 0) {
+				x = 540.0f + 300.0f * cosf(s * 6.2831853f);
+				y = 960.0f + 300.0f * sinf(s * 6.2831853f);
+			} else if (stroke == 1) {
+				float eased = 1.0f - (1.0f - s) * (1.0f - s);
+				x = 100.0f + 900.0f * eased;
+				y = 1600.0f - 1200.0f * eased;
+			} else {
+				x = 100.0f + 800.0f * s;
+				y = 960.0f + 200.0f * (fmodf(s * 6.0f, 2.0f) < 1.0f ? fmodf(s * 6.0f, 1.0f) : 1.0f - fmodf(s * 6.0f, 1.0f));
+			}
+			random = random * 1664525u + 1013904223u;
+			float jitter = ((random >> 16) & 0xff) / 255.0f - 0.5f;
+			TraceSample sample = { i == 0 ? TOUCH_DOWN : (i == count - 1 ? TOUCH_UP : TOUCH_MOVE), t, x + jitter, y - jitter };
+			samples->push_back(sample);
+			t += interval;
+		}
+		t += 500000000;
+	}
+}
+
+static TouchPredictionStats replay(const std::vector<TraceSample>& samples, const Options* options,
+	const TouchPredictorConfig* config, uint64_t* predictions) {
+	TouchPredictor predictor;
+	initTouchPredictor(&predictor, config);
+	TouchPredictionStats total;
+	memset(&total, 0, sizeof(total));
+	*predictions = 0;
+
+	bool active = false;
+	size_t next = 0;
+	int64_t latency = static_cast<int64_t>(options->frameNanoseconds * options->latencyFrames);
+	int64_t frame = samples.empty() ? 0 : samples[0].nanoseconds;
+	while (next < samples.size()) {
+		for (; next < samples.size() && samples[next].nanoseconds <= frame; ++next) {
+			const TraceSample* sample = &samples[next];
+			if (sample->action == TOUCH_DOWN) {
+				resetTouchPredictor(&predictor);
+				active = true;
+			}
+			if (active) {
+				addTouchSample(&predictor, sample->x, sample->y, sample->nanoseconds);
+			}
+			if (sample->action == TOUCH_UP) {
+				active = false;
+			}
+		}
+		float x, y;
+		if (active && predictTouch(&predictor, frame + latency, &x, &y)) {
+			++*predictions;
+		}
+		frame += options->frameNanoseconds;
+	}
+	return predictor.stats;
+}
+
+static void printStats(const char* label, const TouchPredictionStats* stats) {
+	double rms = stats->count ? sqrt(stats->errorSquaredSum / stats->count) : 0.0;
+	printf("%-28s error mean %6.2f px  rms %6.2f px  max %6.1f px   without prediction mean %6.2f px  max %6.1f px  (%u scored)\n",
+		label, meanTouchPredictionError(stats), rms, stats->maxError,
+		meanTouchBaselineError(stats), stats->maxBaselineError, stats->count);
+}
+
+static bool parseOptions(int argc, char** argv, Options* options) {
+	memset(options, 0, sizeof(Options));
+	options->config = defaultTouchPredictorConfig;
+	options->frameNanoseconds = 16666667;
+	options->latencyFrames = 2.0f;
+	for (int i = 1; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--order") == 0 && hasValue) {
+			options->config.order = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--gain") == 0 && hasValue) {
+			options->config.gain = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--max-speed") == 0 && hasValue) {
+			options->config.maxSpeed = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--window") == 0 && hasValue) {
+			options->config.fitWindowNanoseconds = static_cast<int64_t>(atof(argv[++i]) * 1e6);
+		} else if (strcmp(argv[i], "--horizon") == 0 && hasValue) {
+			options->config.maxHorizonNanoseconds = static_cast<int64_t>(atof(argv[++i]) * 1e6);
+		} else if (strcmp(argv[i], "--frame") == 0 && hasValue) {
+			options->frameNanoseconds = static_cast<int64_t>(atof(argv[++i]) * 1e6);
+		} else if (strcmp(argv[i], "--latency") == 0 && hasValue) {
+			options->latencyFrames = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--sweep") == 0) {
+			options->sweep = true;
+		} else if (strcmp(argv[i], "--synthetic") == 0) {
+			options->synthetic = true;
+		} else if (!options->input && argv[i][0] != '-') {
+			options->input = argv[i];
+		} else {
+			return false;
+		}
+	}
+	return (options->input || options->synthetic) && options->frameNanoseconds > 0 &&
+		options->config.order >= 0 && options->config.order <= 2;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, &options)) {
+		fprintf(stderr, "Usage: %s [--order N] [--gain G] [--max-speed PX_PER_S] [--window MS] [--horizon MS] "
+			"[--frame MS] [--latency FRAMES] [--sweep] (trace.txt | --synthetic)\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<TraceSample> samples;
+	if (options.synthetic) {
+		makeSyntheticTrace(&samples);
+	} else if (!loadTrace(options.input, &samples)) {
+		return 1;
+	}
+	if (samples.empty()) {
+		fprintf(stderr, "No samples in trace\n");
+		return 1;
+	}
+
+	uint64_t predictions;
+	double start = nowSeconds();
+	TouchPredictionStats stats = replay(samples, &options, &options.config, &predictions);
+	double seconds = nowSeconds() - start;
+	printf("%zu samples, %llu predicted frames, %.0f ns per frame\n", samples.size(),
+		static_cast<unsigned long long>(predictions), predictions ? seconds * 1e9 / predictions : 0.0);
+	char label[64];
+	snprintf(label, sizeof(label), "order %d gain %.2f", options.config.order, options.config.gain);
+	printStats(label, &stats);
+
+	if (options.sweep) {
+		TouchPredictorConfig best = options.config;
+		float bestError = meanTouchPredictionError(&stats);
+		for (int order = 0; order <= 2; ++order) {
+			for (int g = 1; g <= 10; ++g) {
+				TouchPredictorConfig config = options.config;
+				config.order = order;
+				config.gain = g * 0.1f;
+				TouchPredictionStats candidate = replay(samples, &options, &config, &predictions);
+				if (meanTouchPredictionError(&candidate) < bestError) {
+					bestError = meanTouchPredictionError(&candidate);
+					best = config;
+				}
+			}
+		}
+		TouchPredictionStats bestStats = replay(samples, &options, &best, &predictions);
+		snprintf(label, sizeof(label), "best: order %d gain %.2f", best.order, best.gain);
+		printStats(label, &bestStats);
+	}
+	return 0;
+}